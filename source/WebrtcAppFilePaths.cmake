@@ -16,10 +16,18 @@ set( WEBRTC_APP_SOURCES
      "${CMAKE_CURRENT_LIST_DIR}/src/AppCommon.c"
      "${CMAKE_CURRENT_LIST_DIR}/src/AppCredential.c"
      "${CMAKE_CURRENT_LIST_DIR}/src/AppDataChannel.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/AppInterfaceFilter.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/AppLockProfiler.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/AppMemory.c"
      "${CMAKE_CURRENT_LIST_DIR}/src/AppMessageQueue.c"
      "${CMAKE_CURRENT_LIST_DIR}/src/AppMetrics.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/AppMetricsRegistry.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/AppPacer.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/AppRecorder.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/AppReplay.c"
      "${CMAKE_CURRENT_LIST_DIR}/src/AppRtspSrc.c"
      "${CMAKE_CURRENT_LIST_DIR}/src/AppSignaling.c"
+     "${CMAKE_CURRENT_LIST_DIR}/src/AppTrace.c"
      "${CMAKE_CURRENT_LIST_DIR}/src/AppWebRTC.c" )
 
 # WebRTC App library Public Include directories.
@@ -13,6 +13,7 @@
  * permissions and limitations under the License.
  */
 #define LOG_CLASS "AppCommon"
+#include <time.h>
 #include "AppCommon.h"
 #include "AppCredential.h"
 #include "AppDataChannel.h"
@@ -21,9 +22,19 @@
 #include "AppSignaling.h"
 #include "AppWebRTC.h"
 #include "AppHashTableWrap.h"
+#include "AppLockProfiler.h"
 #include "AppTimerWrap.h"
 
+// order the copy of the published stats before the check of their generation.
+#define APP_STATS_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
 static PAppConfiguration gAppConfiguration = NULL; //!< for the system-level signal handler
+static DOUBLE gAppProbeRttBounds[] = {0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1, 2}; //!< the buckets of the probe rtt in seconds.
+// the names of the session setup events, in the order of APP_SESSION_EVENT.
+static PCHAR gAppSessionEventNames[APP_SESSION_EVENT_COUNT] = {
+    "offer_received", "peer_connection_created", "remote_description_set", "answer_sent",     "first_candidate",
+    "gathering_done", "ice_checking",            "connected",              "first_key_frame", "first_audio_frame",
+};
 
 STATUS createStreamingSession(PAppConfiguration pAppConfiguration, PCHAR peerId, PStreamingSession* ppStreamingSession);
 STATUS freeStreamingSession(PStreamingSession* ppStreamingSession);
@@ -38,45 +49,284 @@ static VOID sigIntHandler(INT32 sigNum)
     }
 }
 
-static STATUS onMediaSinkHook(PVOID udata, PFrame pFrame)
+#ifdef APP_LOCK_PROFILING
+static VOID sigUsr1Handler(INT32 sigNum)
+{
+    UNUSED_PARAM(sigNum);
+    if (gAppConfiguration != NULL) {
+        ATOMIC_STORE_BOOL(&gAppConfiguration->dumpLockProfile, TRUE);
+        CVAR_BROADCAST(gAppConfiguration->cvar);
+    }
+}
+#endif
+
+static VOID sigUsr2Handler(INT32 sigNum)
+{
+    UNUSED_PARAM(sigNum);
+    if (gAppConfiguration != NULL) {
+        ATOMIC_STORE_BOOL(&gAppConfiguration->dumpTrace, TRUE);
+        CVAR_BROADCAST(gAppConfiguration->cvar);
+    }
+}
+
+static VOID observeAppLatency(PAppMetricsRegistry pRegistry, UINT32 metricId, UINT64 startTime, UINT64 endTime)
+{
+    // The wall clock can step back.
+    observeAppMetric(pRegistry, metricId, endTime > startTime ? (DOUBLE) (endTime - startTime) / HUNDREDS_OF_NANOS_IN_A_SECOND : 0);
+}
+
+static VOID registerAppTrackMetrics(PAppMetricsRegistry pRegistry, PCHAR pTrack, PAppTrackMetrics pTrackMetrics)
+{
+    pTrackMetrics->mapMetricId = MAX_UINT32;
+    pTrackMetrics->writeMetricId = MAX_UINT32;
+    pTrackMetrics->sinkMetricId = MAX_UINT32;
+    pTrackMetrics->ptsLagMetricId = MAX_UINT32;
+    pTrackMetrics->clockOffsetMetricId = MAX_UINT32;
+    pTrackMetrics->clockOffsetValid = FALSE;
+
+    registerAppMetric(pRegistry, "webrtc_app_frame_map_seconds", "The latency from the appsink callback to the mapped buffer.",
+                      APP_METRIC_TYPE_SUMMARY, "track", pTrack, NULL, 0, &pTrackMetrics->mapMetricId);
+    registerAppMetric(pRegistry, "webrtc_app_frame_write_seconds", "The latency of writeFrame.", APP_METRIC_TYPE_SUMMARY, "track", pTrack, NULL, 0,
+                      &pTrackMetrics->writeMetricId);
+    registerAppMetric(pRegistry, "webrtc_app_frame_sink_seconds", "The latency from the appsink callback to the frame written to all the sessions.",
+                      APP_METRIC_TYPE_SUMMARY, "track", pTrack, NULL, 0, &pTrackMetrics->sinkMetricId);
+    registerAppMetric(pRegistry, "webrtc_app_frame_pts_lag_seconds", "The lag of the appsink callback behind the running time of the frame.",
+                      APP_METRIC_TYPE_SUMMARY, "track", pTrack, NULL, 0, &pTrackMetrics->ptsLagMetricId);
+    registerAppMetric(pRegistry, "webrtc_app_frame_clock_offset_seconds", "The wall clock minus the running time of the frame.",
+                      APP_METRIC_TYPE_GAUGE, "track", pTrack, NULL, 0, &pTrackMetrics->clockOffsetMetricId);
+}
+
+/**
+ * @brief the monotonic time in 100ns. The timeline of the session setup does not follow the steps of the wall clock.
+ */
+static UINT64 getAppMonotonicTime()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (UINT64) now.tv_sec * HUNDREDS_OF_NANOS_IN_A_SECOND + (UINT64) now.tv_nsec / DEFAULT_TIME_UNIT_IN_NANOS;
+}
+
+/**
+ * @brief log the timeline of the session setup as one json record, in milliseconds since the offer. The events which do not
+ *        happen are null. It is reported once per session.
+ */
+static VOID reportAppSessionTimeline(PStreamingSession pStreamingSession)
+{
+    CHAR record[APP_SESSION_TIMELINE_RECORD_LEN];
+    UINT64 offerTime = pStreamingSession->timeline[APP_SESSION_EVENT_OFFER_RECEIVED];
+    INT32 len;
+    UINT32 i, offset = 0;
+
+    if (offerTime == 0 || ATOMIC_EXCHANGE_BOOL(&pStreamingSession->timelineReported, TRUE)) {
+        return;
+    }
+
+    len = SNPRINTF(record, SIZEOF(record), "{\"session\":\"%s\"", pStreamingSession->peerId);
+    for (i = 0; i < APP_SESSION_EVENT_COUNT && len > 0 && offset + (UINT32) len < SIZEOF(record); i++) {
+        offset += (UINT32) len;
+        if (pStreamingSession->timeline[i] == 0) {
+            len = SNPRINTF(record + offset, SIZEOF(record) - offset, ",\"%s\":null", gAppSessionEventNames[i]);
+        } else {
+            len = SNPRINTF(record + offset, SIZEOF(record) - offset, ",\"%s\":%.1f", gAppSessionEventNames[i],
+                           (DOUBLE) (pStreamingSession->timeline[i] - offerTime) / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+        }
+    }
+    if (len > 0 && offset + (UINT32) len + 1 < SIZEOF(record)) {
+        offset += (UINT32) len;
+        STRCPY(record + offset, "}");
+        DLOGI("session timeline %s", record);
+    }
+}
+
+/**
+ * @brief stamp the first occurrence of the setup event, and observe its latency since the offer. The timeline is reported
+ *        once every event happens, otherwise when the session is freed.
+ */
+static VOID markAppSessionEvent(PStreamingSession pStreamingSession, APP_SESSION_EVENT event)
+{
+    PAppConfiguration pAppConfiguration = pStreamingSession->pAppConfiguration;
+    UINT64 offerTime = pStreamingSession->timeline[APP_SESSION_EVENT_OFFER_RECEIVED];
+    UINT32 i;
+
+    if (pStreamingSession->timeline[event] != 0) {
+        return;
+    }
+    pStreamingSession->timeline[event] = getAppMonotonicTime();
+    if (offerTime == 0) {
+        return;
+    }
+    observeAppLatency(pAppConfiguration->pMetricsRegistry, pAppConfiguration->setupMetricIds[event], offerTime, pStreamingSession->timeline[event]);
+
+    for (i = 0; i < APP_SESSION_EVENT_COUNT && pStreamingSession->timeline[i] != 0; i++) {
+    }
+    if (i == APP_SESSION_EVENT_COUNT) {
+        reportAppSessionTimeline(pStreamingSession);
+    }
+}
+
+/**
+ * @brief record the clock offset of the frame. The smallest offset is the frame which waited the least before the appsink, so
+ *        the offset above it is the lag of the frame. A jump beyond APP_METRICS_FRAME_PTS_LAG_RESET means the running time
+ *        restarted, e.g. the rtsp source reconnected, so the baseline starts over.
+ */
+static VOID recordAppClockOffset(PAppMetricsRegistry pRegistry, PAppTrackMetrics pTrackMetrics, INT64 clockOffset)
+{
+    if (!pTrackMetrics->clockOffsetValid || clockOffset < pTrackMetrics->minClockOffset ||
+        clockOffset - pTrackMetrics->minClockOffset > APP_METRICS_FRAME_PTS_LAG_RESET) {
+        pTrackMetrics->minClockOffset = clockOffset;
+        pTrackMetrics->clockOffsetValid = TRUE;
+    }
+    setAppMetric(pRegistry, pTrackMetrics->clockOffsetMetricId, (DOUBLE) clockOffset / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    observeAppMetric(pRegistry, pTrackMetrics->ptsLagMetricId,
+                     (DOUBLE) (clockOffset - pTrackMetrics->minClockOffset) / HUNDREDS_OF_NANOS_IN_A_SECOND);
+}
+
+/**
+ * @brief write a frame to the transceiver of its track and record the latencies of the session. It runs on the media thread,
+ *        or on the thread of the pacer with pacing.
+ */
+static STATUS writeStreamingSessionFrame(PVOID udata, PFrame pFrame, UINT64 entryTime)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PStreamingSession pStreamingSession = (PStreamingSession) udata;
+    PAppConfiguration pAppConfiguration = pStreamingSession->pAppConfiguration;
+    PRtcRtpTransceiver pRtcRtpTransceiver = NULL;
+    PAppTrackMetrics pTrackMetrics;
+    UINT64 writeStartTime, writeEndTime;
+    // the packets the sdk keeps for the retransmissions are the bulk of the memory of a session.
+    UINT32 prevMemorySession = setAppMemorySession(pStreamingSession->memorySessionId);
+
+    if (pFrame->trackId == DEFAULT_AUDIO_TRACK_ID) {
+        pRtcRtpTransceiver = pStreamingSession->pAudioRtcRtpTransceiver;
+        pTrackMetrics = &pAppConfiguration->audioMetrics;
+    } else {
+        pRtcRtpTransceiver = pStreamingSession->pVideoRtcRtpTransceiver;
+        pTrackMetrics = &pAppConfiguration->videoMetrics;
+    }
+    writeStartTime = GETTIME();
+    appTraceBegin("writeFrame");
+    retStatus = writeFrame(pRtcRtpTransceiver, pFrame);
+    appTraceEnd("writeFrame");
+    writeEndTime = GETTIME();
+    if (retStatus != STATUS_SUCCESS) {
+        // STATUS_SRTP_NOT_READY_YET
+        DLOGW("writeFrame() failed with 0x%08x", retStatus);
+    } else {
+        markAppSessionEvent(pStreamingSession,
+                            pFrame->trackId == DEFAULT_AUDIO_TRACK_ID ? APP_SESSION_EVENT_FIRST_AUDIO_FRAME : APP_SESSION_EVENT_FIRST_KEY_FRAME);
+        if (pFrame->trackId == DEFAULT_VIDEO_TRACK_ID && pStreamingSession->pAppDataChannelProbe != NULL) {
+            setAppDataChannelProbeFrame(pStreamingSession->pAppDataChannelProbe, pFrame->presentationTs);
+        }
+    }
+    observeAppLatency(pAppConfiguration->pMetricsRegistry, pTrackMetrics->writeMetricId, writeStartTime, writeEndTime);
+    observeAppLatency(pAppConfiguration->pMetricsRegistry, pStreamingSession->writeFrameMetricId, writeStartTime, writeEndTime);
+    observeAppLatency(pAppConfiguration->pMetricsRegistry, pStreamingSession->frameDelayMetricId, entryTime, writeEndTime);
+    setAppMemorySession(prevMemorySession);
+
+    return retStatus;
+}
+
+static BOOL admitSendBudgetFrame(PStreamingSession pStreamingSession, PFrame pFrame, UINT64 currentTime)
+{
+    DOUBLE rate = (DOUBLE) ATOMIC_LOAD(&pStreamingSession->sendBudget) / 8;
+    DOUBLE burst = rate * APP_SESSION_SEND_BUDGET_BURST / HUNDREDS_OF_NANOS_IN_A_SECOND;
+    DOUBLE maxDebt = rate * APP_SESSION_SEND_BUDGET_MAX_DEBT / HUNDREDS_OF_NANOS_IN_A_SECOND;
+
+    if (rate <= 0) {
+        return TRUE;
+    }
+    // The bucket holds a burst of the budget so a key frame fits, and a frame admitted over it puts the video in debt. The video
+    // keeps flowing through a bounded debt, only a link far behind the budget loses frames.
+    if (pStreamingSession->sendRefillTime == 0) {
+        pStreamingSession->sendTokens = burst;
+    } else if (currentTime > pStreamingSession->sendRefillTime) {
+        pStreamingSession->sendTokens =
+            MIN(burst, pStreamingSession->sendTokens + rate * (currentTime - pStreamingSession->sendRefillTime) / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    }
+    pStreamingSession->sendRefillTime = MAX(currentTime, pStreamingSession->sendRefillTime);
+    if (pStreamingSession->sendTokens < -maxDebt) {
+        ATOMIC_INCREMENT(&pStreamingSession->sendBudgetDropped);
+        return FALSE;
+    }
+    pStreamingSession->sendTokens -= pFrame->size;
+    return TRUE;
+}
+
+static STATUS onMediaSinkHook(PVOID udata, PFrame pFrame, PMediaFrameTiming pTiming)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PAppConfiguration pAppConfiguration = (PAppConfiguration) udata;
     PStreamingSession pStreamingSession = NULL;
-    PRtcRtpTransceiver pRtcRtpTransceiver = NULL;
+    PAppTrackMetrics pTrackMetrics;
+    PAppPacerFrame pAppPacerFrame = NULL;
+    UINT64 entryTime;
     UINT32 i;
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_MEDIA);
 
+    setAppTraceThreadName("gst-streaming");
+    appTraceBegin("onMediaSinkHook");
     CHK(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG);
 
-    MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
+    entryTime = pTiming != NULL ? pTiming->sinkEntryTime : GETTIME();
+    pTrackMetrics = pFrame->trackId == DEFAULT_AUDIO_TRACK_ID ? &pAppConfiguration->audioMetrics : &pAppConfiguration->videoMetrics;
+    if (pTiming != NULL) {
+        observeAppLatency(pAppConfiguration->pMetricsRegistry, pTrackMetrics->mapMetricId, entryTime, pTiming->mappedTime);
+        recordAppClockOffset(pAppConfiguration->pMetricsRegistry, pTrackMetrics, pTiming->clockOffset);
+    }
+    // The replay and the recorder keep every frame, the sessions below pick theirs.
+    if (pAppConfiguration->pAppReplay != NULL) {
+        CHK_LOG_ERR((appendAppReplayFrame(pAppConfiguration->pAppReplay, pFrame)));
+    }
+    if (pAppConfiguration->pAppRecorder != NULL) {
+        CHK_LOG_ERR((appendAppRecorderFrame(pAppConfiguration->pAppRecorder, pFrame)));
+    }
+    APP_MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
     for (i = 0; i < pAppConfiguration->streamingSessionCount; ++i) {
         pStreamingSession = pAppConfiguration->streamingSessionList[i];
+        // A channel without a track of the camera sets up its sessions without the transceiver of the track.
+        if ((pFrame->trackId == DEFAULT_AUDIO_TRACK_ID ? pStreamingSession->pAudioRtcRtpTransceiver : pStreamingSession->pVideoRtcRtpTransceiver) ==
+            NULL) {
+            continue;
+        }
         if (pFrame->trackId == DEFAULT_VIDEO_TRACK_ID) {
             if (pStreamingSession->firstKeyFrame == FALSE && pFrame->flags != FRAME_FLAG_KEY_FRAME) {
                 continue;
-            } else {
-                pStreamingSession->firstKeyFrame = TRUE;
             }
+            // A frame dropped over the debt of the budget is a gap for the decoder, the video waits for the next key frame.
+            if (!admitSendBudgetFrame(pStreamingSession, pFrame, entryTime)) {
+                pStreamingSession->firstKeyFrame = FALSE;
+                continue;
+            }
+            pStreamingSession->firstKeyFrame = TRUE;
         }
 
         pFrame->index = (UINT32) ATOMIC_INCREMENT(&pStreamingSession->frameIndex);
 
-        if (pFrame->trackId == DEFAULT_AUDIO_TRACK_ID) {
-            pRtcRtpTransceiver = pStreamingSession->pAudioRtcRtpTransceiver;
-        } else {
-            pRtcRtpTransceiver = pStreamingSession->pVideoRtcRtpTransceiver;
+        // With pacing, the frame is copied once for the queues of all the sessions, on the first session which queues it.
+        // Without the copy, the sessions write it here.
+        if (pAppPacerFrame == NULL && pAppConfiguration->pAppPacer != NULL && pStreamingSession->pPacerFlow != NULL) {
+            CHK_LOG_ERR((createAppPacerFrame(pAppConfiguration->pAppPacer, pFrame, entryTime, &pAppPacerFrame)));
         }
-        retStatus = writeFrame(pRtcRtpTransceiver, pFrame);
-        if (retStatus != STATUS_SUCCESS) {
-            // STATUS_SRTP_NOT_READY_YET
-            DLOGW("writeFrame() failed with 0x%08x", retStatus);
-            retStatus = STATUS_SUCCESS;
+        if (pAppPacerFrame != NULL && pStreamingSession->pPacerFlow != NULL) {
+            // A full queue means the link is far behind the camera, the viewer waits for the next key frame instead of a gap.
+            if (queueAppPacerFrame(pAppConfiguration->pAppPacer, pStreamingSession->pPacerFlow, pAppPacerFrame, pFrame->index) ==
+                STATUS_APP_PACER_QUEUE_FULL) {
+                pStreamingSession->firstKeyFrame = FALSE;
+            }
+        } else {
+            writeStreamingSessionFrame(pStreamingSession, pFrame, entryTime);
         }
     }
-    MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
+    APP_MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
+    observeAppLatency(pAppConfiguration->pMetricsRegistry, pTrackMetrics->sinkMetricId, entryTime, GETTIME());
 
 CleanUp:
 
+    releaseAppPacerFrame(&pAppPacerFrame);
+
+    appTraceEnd("onMediaSinkHook");
+    setAppMemoryTag(prevTag);
     if (pAppConfiguration != NULL && ATOMIC_LOAD_BOOL(&pAppConfiguration->terminateApp)) {
         retStatus = STATUS_APP_COMMON_SHUTDOWN_MEDIA;
     }
@@ -89,12 +339,12 @@ static STATUS onMediaEosHook(PVOID udata)
     PAppConfiguration pAppConfiguration = (PAppConfiguration) udata;
     UINT32 i;
     // close all the streaming session.
-    MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
+    APP_MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
     for (i = 0; i < pAppConfiguration->streamingSessionCount; ++i) {
         DLOGD("terminate the streaming session(%d)", i);
         ATOMIC_STORE_BOOL(&pAppConfiguration->streamingSessionList[i]->terminateFlag, TRUE);
     }
-    MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+    APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
     CVAR_BROADCAST(pAppConfiguration->cvar);
     return retStatus;
 }
@@ -104,6 +354,7 @@ static VOID onConnectionStateChange(UINT64 userData, RTC_PEER_CONNECTION_STATE n
     STATUS retStatus = STATUS_SUCCESS;
     PStreamingSession pStreamingSession = (PStreamingSession) userData;
     PAppConfiguration pAppConfiguration;
+    UINT32 prevMemorySession = setAppMemorySession(pStreamingSession != NULL ? pStreamingSession->memorySessionId : APP_MEMORY_NO_SESSION);
 
     CHK((pStreamingSession != NULL) && (pStreamingSession->pAppConfiguration != NULL), STATUS_INTERNAL_ERROR);
 
@@ -111,7 +362,14 @@ static VOID onConnectionStateChange(UINT64 userData, RTC_PEER_CONNECTION_STATE n
     DLOGI("New connection state %u", newState);
 
     switch (newState) {
+        case RTC_PEER_CONNECTION_STATE_CONNECTING:
+            // the sdk does not report the ice and dtls states apart, connecting is the start of the connectivity checks.
+            markAppSessionEvent(pStreamingSession, APP_SESSION_EVENT_ICE_CHECKING);
+            ATOMIC_STORE_BOOL(&pAppConfiguration->peerConnectionConnected, FALSE);
+            CVAR_BROADCAST(pAppConfiguration->cvar);
+            break;
         case RTC_PEER_CONNECTION_STATE_CONNECTED:
+            markAppSessionEvent(pStreamingSession, APP_SESSION_EVENT_CONNECTED);
             ATOMIC_STORE_BOOL(&pAppConfiguration->peerConnectionConnected, TRUE);
             CVAR_BROADCAST(pAppConfiguration->cvar);
             if (STATUS_FAILED(retStatus = logSelectedIceCandidatesInformation(pStreamingSession->pPeerConnection))) {
@@ -134,6 +392,7 @@ static VOID onConnectionStateChange(UINT64 userData, RTC_PEER_CONNECTION_STATE n
 
 CleanUp:
 
+    setAppMemorySession(prevMemorySession);
     CHK_LOG_ERR((retStatus));
 }
 
@@ -174,23 +433,29 @@ static VOID onBandwidthEstimationHandler(UINT64 userData, DOUBLE maxiumBitrate)
 static VOID onSenderBandwidthEstimationHandler(UINT64 userData, UINT32 txBytes, UINT32 rxBytes, UINT32 txPacketsCnt, UINT32 rxPacketsCnt,
                                                UINT64 duration)
 {
-    UNUSED_PARAM(userData);
-    UNUSED_PARAM(duration);
-    UNUSED_PARAM(rxBytes);
-    UNUSED_PARAM(txBytes);
-    UINT32 lostPacketsCnt = txPacketsCnt - rxPacketsCnt;
-    UINT32 percentLost = lostPacketsCnt * 100 / txPacketsCnt;
-    UINT32 bitrate = 1024;
+    PStreamingSession pStreamingSession = (PStreamingSession) userData;
+    UINT32 percentLost;
+    DOUBLE bitrate;
+
+    if (pStreamingSession == NULL || txPacketsCnt == 0 || duration == 0) {
+        return;
+    }
+    percentLost = rxPacketsCnt >= txPacketsCnt ? 0 : (txPacketsCnt - rxPacketsCnt) * 100 / txPacketsCnt;
+    // The twcc feedback tells the bytes the viewer received, their rate is what the path delivers now.
+    bitrate = (DOUBLE) rxBytes * 8 * HUNDREDS_OF_NANOS_IN_A_SECOND / duration;
     if (percentLost < 2) {
-        // increase encoder bitrate by 2 percent
-        bitrate *= 1.02f;
+        // increase the bitrate by 2 percent
+        bitrate *= 1.02;
     } else if (percentLost > 5) {
-        // decrease encoder bitrate by packet loss percent
-        bitrate *= (1.0f - percentLost / 100.0f);
+        // decrease the bitrate by the packet loss percent
+        bitrate *= 1.0 - percentLost / 100.0;
     }
     // otherwise keep bitrate the same
+    bitrate = MIN(MAX(bitrate, APP_SESSION_SEND_BUDGET_MIN), APP_SESSION_SEND_BUDGET_MAX);
+    // The pacer flow goes away before the peer connection, the stats timer hands the estimate to it.
+    ATOMIC_STORE(&pStreamingSession->twccBitrate, (SIZE_T) bitrate);
 
-    DLOGS("received sender bitrate estimation: suggested bitrate %u sent: %u bytes %u packets received: %u bytes %u packets in %lu msec, ", bitrate,
+    DLOGS("received sender bitrate estimation: suggested bitrate %lf sent: %u bytes %u packets received: %u bytes %u packets in %lu msec, ", bitrate,
           txBytes, txPacketsCnt, rxBytes, rxPacketsCnt, duration / 10000ULL);
 }
 
@@ -224,9 +489,18 @@ static STATUS respondWithAnswer(PStreamingSession pStreamingSession)
     message.correlationId[0] = '\0';
 
     CHK_STATUS((sendAppSignalingMessage(&pStreamingSession->pAppConfiguration->appSignaling, &message)));
+    markAppSessionEvent(pStreamingSession, APP_SESSION_EVENT_ANSWER_SENT);
+    DLOGD("time taken to send answer %" PRIu64 " ms",
+          (pStreamingSession->timeline[APP_SESSION_EVENT_ANSWER_SENT] - pStreamingSession->timeline[APP_SESSION_EVENT_OFFER_RECEIVED]) /
+              HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
 
 CleanUp:
 
+    // The viewer never gets the answer, so the main loop frees the session instead of waiting for the ice timeout.
+    if (STATUS_FAILED(retStatus) && pStreamingSession != NULL) {
+        ATOMIC_STORE_BOOL(&pStreamingSession->terminateFlag, TRUE);
+        CVAR_BROADCAST(pStreamingSession->pAppConfiguration->cvar);
+    }
     CHK_LOG_ERR((retStatus));
     return retStatus;
 }
@@ -238,11 +512,13 @@ static STATUS handleOffer(PAppConfiguration pAppConfiguration, PStreamingSession
     NullableBool canTrickle;
     BOOL mediaThreadStarted;
 
+    appTraceBegin("handleOffer");
     MEMSET(&offerSessionDescriptionInit, 0x00, SIZEOF(RtcSessionDescriptionInit));
     MEMSET(&pStreamingSession->answerSessionDescriptionInit, 0x00, SIZEOF(RtcSessionDescriptionInit));
 
     CHK_STATUS((deserializeSessionDescriptionInit(pSignalingMessage->payload, pSignalingMessage->payloadLen, &offerSessionDescriptionInit)));
     CHK_STATUS((setRemoteDescription(pStreamingSession->pPeerConnection, &offerSessionDescriptionInit)));
+    markAppSessionEvent(pStreamingSession, APP_SESSION_EVENT_REMOTE_DESCRIPTION_SET);
     canTrickle = canTrickleIceCandidates(pStreamingSession->pPeerConnection);
     // cannot be null after setRemoteDescription
     CHECK(!NULLABLE_CHECK_EMPTY(canTrickle));
@@ -253,7 +529,6 @@ static STATUS handleOffer(PAppConfiguration pAppConfiguration, PStreamingSession
     if (pStreamingSession->remoteCanTrickleIce) {
         CHK_STATUS((createAnswer(pStreamingSession->pPeerConnection, &pStreamingSession->answerSessionDescriptionInit)));
         CHK_STATUS((respondWithAnswer(pStreamingSession)));
-        DLOGD("time taken to send answer %" PRIu64 " ms", (GETTIME() - pStreamingSession->offerReceiveTime) / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
     }
 
     mediaThreadStarted = ATOMIC_EXCHANGE_BOOL(&pAppConfiguration->mediaThreadStarted, TRUE);
@@ -263,6 +538,7 @@ static STATUS handleOffer(PAppConfiguration pAppConfiguration, PStreamingSession
 
 CleanUp:
 
+    appTraceEnd("handleOffer");
     CHK_LOG_ERR((retStatus));
 
     return retStatus;
@@ -273,128 +549,730 @@ static VOID onIceCandidateHandler(UINT64 userData, PCHAR candidateJson)
     STATUS retStatus = STATUS_SUCCESS;
     PStreamingSession pStreamingSession = (PStreamingSession) userData;
     SignalingMessage message;
+    UINT32 prevMemorySession = setAppMemorySession(pStreamingSession != NULL ? pStreamingSession->memorySessionId : APP_MEMORY_NO_SESSION);
 
     CHK(pStreamingSession != NULL, STATUS_APP_COMMON_NULL_ARG);
 
     if (candidateJson == NULL) {
         DLOGD("ice candidate gathering finished");
         ATOMIC_STORE_BOOL(&pStreamingSession->candidateGatheringDone, TRUE);
+        markAppSessionEvent(pStreamingSession, APP_SESSION_EVENT_GATHERING_DONE);
+        if (pStreamingSession->pAppConfiguration->interfaceFilter.enabled) {
+            DLOGI("host candidates: %u before the interface filter, %u after", pStreamingSession->interfaceFilterSession.candidateCount,
+                  pStreamingSession->interfaceFilterSession.acceptedCount);
+        }
 
         // if application is master and non-trickle ice, send answer now.
         if (getAppSignalingRole(&pStreamingSession->pAppConfiguration->appSignaling) == SIGNALING_CHANNEL_ROLE_TYPE_MASTER &&
             !pStreamingSession->remoteCanTrickleIce) {
             CHK_STATUS((createAnswer(pStreamingSession->pPeerConnection, &pStreamingSession->answerSessionDescriptionInit)));
             CHK_STATUS((respondWithAnswer(pStreamingSession)));
-            DLOGD("time taken to send answer %" PRIu64 " ms", (GETTIME() - pStreamingSession->offerReceiveTime) / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
         }
 
-    } else if (pStreamingSession->remoteCanTrickleIce && ATOMIC_LOAD_BOOL(&pStreamingSession->peerIdReceived)) {
-        message.version = SIGNALING_MESSAGE_CURRENT_VERSION;
-        message.messageType = SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE;
-        STRNCPY(message.peerClientId, pStreamingSession->peerId, MAX_SIGNALING_CLIENT_ID_LEN);
-        message.payloadLen = (UINT32) STRNLEN(candidateJson, MAX_SIGNALING_MESSAGE_LEN);
-        STRNCPY(message.payload, candidateJson, message.payloadLen);
-        message.correlationId[0] = '\0';
-        CHK_STATUS((sendAppSignalingMessage(&pStreamingSession->pAppConfiguration->appSignaling, &message)));
+    } else {
+        markAppSessionEvent(pStreamingSession, APP_SESSION_EVENT_FIRST_CANDIDATE);
+        if (pStreamingSession->remoteCanTrickleIce && ATOMIC_LOAD_BOOL(&pStreamingSession->peerIdReceived)) {
+            message.version = SIGNALING_MESSAGE_CURRENT_VERSION;
+            message.messageType = SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE;
+            STRNCPY(message.peerClientId, pStreamingSession->peerId, MAX_SIGNALING_CLIENT_ID_LEN);
+            message.payloadLen = (UINT32) STRNLEN(candidateJson, MAX_SIGNALING_MESSAGE_LEN);
+            STRNCPY(message.payload, candidateJson, message.payloadLen);
+            message.correlationId[0] = '\0';
+            CHK_STATUS((sendAppSignalingMessage(&pStreamingSession->pAppConfiguration->appSignaling, &message)));
+        }
     }
 
 CleanUp:
 
+    setAppMemorySession(prevMemorySession);
     CHK_LOG_ERR((retStatus));
 }
 
+/**
+ * @brief the result of a ping of the gateway, it is called on the sctp thread of the session.
+ */
+static VOID onSessionProbe(PVOID udata, UINT64 roundTripTime, INT64 clockOffset)
+{
+    PStreamingSession pStreamingSession = (PStreamingSession) udata;
+    PAppMetricsRegistry pRegistry = pStreamingSession->pAppConfiguration->pMetricsRegistry;
+
+    DLOGD("The probe of %s: rtt %" PRIu64 " ms, clock offset %" PRId64 " ms", pStreamingSession->peerId,
+          roundTripTime / HUNDREDS_OF_NANOS_IN_A_MILLISECOND, clockOffset / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    observeAppMetric(pRegistry, pStreamingSession->probeRttMetricId, (DOUBLE) roundTripTime / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    setAppGauge(pRegistry, "webrtc_app_session_probe_clock_offset_seconds", "The monotonic clock of the viewer minus the one of the gateway.",
+                "session", pStreamingSession->peerId, (DOUBLE) clockOffset / HUNDREDS_OF_NANOS_IN_A_SECOND);
+}
+
+/**
+ * @brief any message of the viewer on the replay channel asks for the replay, the replay timer serves it.
+ */
+static STATUS serveAppReplaysCallback(UINT32 timerId, UINT64 currentTime, UINT64 userData);
+
+/**
+ * @brief arm the replay timer unless it runs already, it serves the replays until none is requested or in progress.
+ */
+static VOID armAppReplayTimer(PAppConfiguration pAppConfiguration)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 timerId = MAX_UINT32;
+
+    if (ATOMIC_LOAD_BOOL(&pAppConfiguration->terminateApp) || ATOMIC_EXCHANGE_BOOL(&pAppConfiguration->replayTimerArmed, TRUE)) {
+        return;
+    }
+    if (STATUS_FAILED(retStatus = appTimeQueueAdd(pAppConfiguration->timerQueueHandle, APP_REPLAY_SERVE_PERIOD, APP_REPLAY_SERVE_PERIOD,
+                                                  serveAppReplaysCallback, (UINT64) pAppConfiguration, &timerId))) {
+        DLOGW("Failed to add serveAppReplaysCallback to the timer queue (code 0x%08x), the replay waits for the next request", retStatus);
+        ATOMIC_STORE_BOOL(&pAppConfiguration->replayTimerArmed, FALSE);
+        return;
+    }
+    // The timer keeps running until it takes its own id back, so the id published here is never the one of a stopped timer.
+    ATOMIC_STORE(&pAppConfiguration->replayTimerId, (SIZE_T) timerId);
+}
+
+static VOID onSessionReplayRequest(UINT64 userData, PRtcDataChannel pDataChannel, BOOL isBinary, PBYTE pMessage,
+                                   UINT32 pMessageLen)
+{
+    PStreamingSession pStreamingSession = (PStreamingSession) userData;
+
+    UNUSED_PARAM(pDataChannel);
+    UNUSED_PARAM(isBinary);
+    UNUSED_PARAM(pMessage);
+    UNUSED_PARAM(pMessageLen);
+    ATOMIC_STORE_BOOL(&pStreamingSession->replayRequested, TRUE);
+    armAppReplayTimer(pStreamingSession->pAppConfiguration);
+}
+
+/**
+ * @brief the first data channel opened by the viewer carries the outbound messages of the session, the one named
+ *        APP_DATA_CHANNEL_PROBE_NAME carries the probes and the one named APP_REPLAY_DATA_CHANNEL_NAME the replay. The sdk
+ *        opens the data channels on the thread of its sctp association one after another, so they are published without a race.
+ */
+static VOID onSessionDataChannel(UINT64 userData, PRtcDataChannel pRtcDataChannel)
+{
+    PStreamingSession pStreamingSession = (PStreamingSession) userData;
+    PAppDataChannel pAppDataChannel = NULL;
+    PAppDataChannelProbe pAppDataChannelProbe = NULL;
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_SESSION);
+    UINT32 prevMemorySession = setAppMemorySession(pStreamingSession->memorySessionId);
+
+    if (pRtcDataChannel != NULL && STRCMP(pRtcDataChannel->name, APP_DATA_CHANNEL_PROBE_NAME) == 0) {
+        if (pStreamingSession->pAppDataChannelProbe == NULL &&
+            STATUS_SUCCEEDED(createAppDataChannelProbe(pRtcDataChannel, onSessionProbe, pStreamingSession, &pAppDataChannelProbe))) {
+            pStreamingSession->pAppDataChannelProbe = pAppDataChannelProbe;
+        }
+    } else if (pRtcDataChannel != NULL && STRCMP(pRtcDataChannel->name, APP_REPLAY_DATA_CHANNEL_NAME) == 0) {
+        if (pStreamingSession->pAppConfiguration->pAppReplay == NULL) {
+            DLOGW("The replay is disabled, the replay channel of %s is ignored", pStreamingSession->peerId);
+        } else if (pStreamingSession->pReplayDataChannel == NULL &&
+                   STATUS_SUCCEEDED(dataChannelOnMessage(pRtcDataChannel, userData, onSessionReplayRequest))) {
+            pStreamingSession->pReplayDataChannel = pRtcDataChannel;
+        }
+    } else {
+        onDataChannel(userData, pRtcDataChannel);
+        if (pStreamingSession->pAppDataChannel == NULL && STATUS_SUCCEEDED(createAppDataChannel(pRtcDataChannel, &pAppDataChannel))) {
+            pStreamingSession->pAppDataChannel = pAppDataChannel;
+        }
+    }
+    setAppMemorySession(prevMemorySession);
+    setAppMemoryTag(prevTag);
+}
+
+/**
+ * @brief take a reference of every streaming session under the list lock only, so the slow calls into the peer connections
+ *        do not hold the object lock and block the offers, the ice candidates and the reaper.
+ *
+ * @param[in] pAppConfiguration the context of the app.
+ * @param[out] pSessions the sessions, APP_MAX_CONCURRENT_STREAMING_SESSION of them. Release each with releaseStreamingSession.
+ *
+ * @return the number of sessions.
+ */
+static UINT32 snapshotStreamingSessions(PAppConfiguration pAppConfiguration, PStreamingSession* pSessions)
+{
+    UINT32 i, sessionCount;
+
+    APP_MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
+    sessionCount = pAppConfiguration->streamingSessionCount;
+    for (i = 0; i < sessionCount; ++i) {
+        pSessions[i] = pAppConfiguration->streamingSessionList[i];
+        ATOMIC_INCREMENT(&pSessions[i]->refCount);
+    }
+    APP_MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
+
+    return sessionCount;
+}
+
+/**
+ * @brief drop a reference of the streaming session, the last one closes the peer connection and frees the session.
+ */
+static VOID releaseStreamingSession(PStreamingSession pStreamingSession)
+{
+    PAppConfiguration pAppConfiguration = pStreamingSession->pAppConfiguration;
+    UINT32 memorySessionId = pStreamingSession->memorySessionId;
+
+    if (ATOMIC_DECREMENT(&pStreamingSession->refCount) != 1) {
+        return;
+    }
+
+    // The pacer may be writing to the session, the flow is removed before the peer connection is closed.
+    if (pStreamingSession->pPacerFlow != NULL) {
+        CHK_LOG_ERR((removeAppPacerFlow(pAppConfiguration->pAppPacer, &pStreamingSession->pPacerFlow)));
+    }
+    CHK_LOG_ERR((closePeerConnection(pStreamingSession->pPeerConnection)));
+    CHK_LOG_ERR((freePeerConnection(&pStreamingSession->pPeerConnection)));
+    CHK_LOG_ERR((freeAppInterfaceFilterSession(&pStreamingSession->interfaceFilterSession)));
+    if (pStreamingSession->pAppDataChannel != NULL) {
+        CHK_LOG_ERR((freeAppDataChannel(&pStreamingSession->pAppDataChannel)));
+    }
+    if (pStreamingSession->pAppDataChannelProbe != NULL) {
+        CHK_LOG_ERR((freeAppDataChannelProbe(&pStreamingSession->pAppDataChannelProbe)));
+    }
+    reportAppSessionTimeline(pStreamingSession);
+    if (pAppConfiguration->pMetricsRegistry != NULL) {
+        CHK_LOG_ERR((removeAppMetrics(pAppConfiguration->pMetricsRegistry, "session", pStreamingSession->peerId)));
+    }
+    MEMFREE(pStreamingSession);
+    // whatever the session still holds is logged, and its slot waits for it.
+    CHK_LOG_ERR((closeAppMemorySession(memorySessionId)));
+}
+
+/**
+ * @brief ping the viewers which open the probe channel.
+ */
+static STATUS probeAppSessionsCallback(UINT32 timerId, UINT64 currentTime, UINT64 userData)
+{
+    UNUSED_PARAM(timerId);
+    UNUSED_PARAM(currentTime);
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
+    PStreamingSession sessions[APP_MAX_CONCURRENT_STREAMING_SESSION];
+    UINT32 i, sessionCount;
+
+    CHK(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG);
+    setAppTraceThreadName("timer-queue");
+
+    sessionCount = snapshotStreamingSessions(pAppConfiguration, sessions);
+    for (i = 0; i < sessionCount; ++i) {
+        if (sessions[i]->pAppDataChannelProbe != NULL && !ATOMIC_LOAD_BOOL(&sessions[i]->terminateFlag)) {
+            sendAppDataChannelProbe(sessions[i]->pAppDataChannelProbe);
+        }
+    }
+    for (i = 0; i < sessionCount; ++i) {
+        releaseStreamingSession(sessions[i]);
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+static BOOL hasAppReplayRequest(PAppConfiguration pAppConfiguration)
+{
+    PStreamingSession sessions[APP_MAX_CONCURRENT_STREAMING_SESSION];
+    UINT32 i, sessionCount;
+    BOOL requested = FALSE;
+
+    sessionCount = snapshotStreamingSessions(pAppConfiguration, sessions);
+    for (i = 0; i < sessionCount; ++i) {
+        requested = requested ||
+            (sessions[i]->pReplayDataChannel != NULL && !ATOMIC_LOAD_BOOL(&sessions[i]->terminateFlag) &&
+             ATOMIC_LOAD_BOOL(&sessions[i]->replayRequested));
+        releaseStreamingSession(sessions[i]);
+    }
+    return requested;
+}
+
+/**
+ * @brief start the replays the viewers ask for, and send the next chunks of the ones in progress. The replays are read
+ *        without a lock, so the media threads keep appending at their pace. The timer stops once no replay is left.
+ */
+static STATUS serveAppReplaysCallback(UINT32 timerId, UINT64 currentTime, UINT64 userData)
+{
+    UNUSED_PARAM(currentTime);
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
+    PStreamingSession sessions[APP_MAX_CONCURRENT_STREAMING_SESSION];
+    PStreamingSession pStreamingSession;
+    UINT32 i, sessionCount;
+    BOOL serving = FALSE;
+    SIZE_T expected;
+
+    CHK(pAppConfiguration != NULL && pAppConfiguration->pAppReplay != NULL, STATUS_APP_COMMON_NULL_ARG);
+    setAppTraceThreadName("timer-queue");
+    // freeApp takes the id and cancels the timer, a timer armed after it stops here.
+    CHK(!ATOMIC_LOAD_BOOL(&pAppConfiguration->terminateApp), STATUS_TIMER_QUEUE_STOP_SCHEDULING);
+
+    sessionCount = snapshotStreamingSessions(pAppConfiguration, sessions);
+    for (i = 0; i < sessionCount; ++i) {
+        pStreamingSession = sessions[i];
+        if (pStreamingSession->pReplayDataChannel == NULL || ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag)) {
+            continue;
+        }
+        if (ATOMIC_EXCHANGE_BOOL(&pStreamingSession->replayRequested, FALSE)) {
+            DLOGI("Replaying the last frames to %s", pStreamingSession->peerId);
+            CHK_LOG_ERR((seekAppReplay(pAppConfiguration->pAppReplay, &pStreamingSession->replayCursor)));
+        }
+        CHK_LOG_ERR((serveAppReplay(pAppConfiguration->pAppReplay, &pStreamingSession->replayCursor, pStreamingSession->pReplayDataChannel,
+                                    APP_REPLAY_SERVE_BUDGET)));
+        serving = serving || pStreamingSession->replayCursor.active;
+    }
+    for (i = 0; i < sessionCount; ++i) {
+        releaseStreamingSession(sessions[i]);
+    }
+
+    // The timer stops only once it takes its id back from armAppReplayTimer, a timer whose id is not published yet or is taken
+    // by freeApp keeps running. A request between the scan and the disarm saw the timer armed and did not arm it, so the
+    // sessions are checked again.
+    expected = (SIZE_T) timerId;
+    if (!serving && ATOMIC_COMPARE_EXCHANGE(&pAppConfiguration->replayTimerId, &expected, (SIZE_T) MAX_UINT32)) {
+        ATOMIC_STORE_BOOL(&pAppConfiguration->replayTimerArmed, FALSE);
+        if (!hasAppReplayRequest(pAppConfiguration) || ATOMIC_EXCHANGE_BOOL(&pAppConfiguration->replayTimerArmed, TRUE)) {
+            retStatus = STATUS_TIMER_QUEUE_STOP_SCHEDULING;
+        } else {
+            ATOMIC_STORE(&pAppConfiguration->replayTimerId, (SIZE_T) timerId);
+        }
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+/**
+ * @brief send the batches queued to the data channels of the sessions, the messages of a period leave in one batch.
+ */
+static STATUS flushAppDataChannelsCallback(UINT32 timerId, UINT64 currentTime, UINT64 userData)
+{
+    UNUSED_PARAM(timerId);
+    UNUSED_PARAM(currentTime);
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
+    PStreamingSession sessions[APP_MAX_CONCURRENT_STREAMING_SESSION];
+    UINT32 i, sessionCount;
+    UINT32 prevMemorySession = setAppMemorySession(APP_MEMORY_NO_SESSION);
+
+    CHK(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG);
+    setAppTraceThreadName("timer-queue");
+
+    sessionCount = snapshotStreamingSessions(pAppConfiguration, sessions);
+    for (i = 0; i < sessionCount; ++i) {
+        if (sessions[i]->pAppDataChannel == NULL || ATOMIC_LOAD_BOOL(&sessions[i]->terminateFlag)) {
+            continue;
+        }
+        // A slow viewer keeps its refused batches for the next period, the other sessions are not held.
+        setAppMemorySession(sessions[i]->memorySessionId);
+        flushAppDataChannel(sessions[i]->pAppDataChannel);
+    }
+    for (i = 0; i < sessionCount; ++i) {
+        releaseStreamingSession(sessions[i]);
+    }
+
+CleanUp:
+
+    setAppMemorySession(prevMemorySession);
+    return retStatus;
+}
+
+/**
+ * @brief probe the turn servers with the ice server stats of the live sessions, so the next peer connection uses the
+ *        closest turn servers.
+ */
+static STATUS probeTurnServersCallback(UINT32 timerId, UINT64 currentTime, UINT64 userData)
+{
+    UNUSED_PARAM(timerId);
+    UNUSED_PARAM(currentTime);
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
+    PStreamingSession sessions[APP_MAX_CONCURRENT_STREAMING_SESSION];
+    RtcIceServerStats iceServerStats;
+    PAppIceServerProbe pProbe;
+    UINT32 i, j, sessionCount;
+    UINT64 rtt, requests, responses, roundTripTime;
+
+    CHK_WARN(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG, "probeTurnServersCallback(): Passed argument is NULL");
+
+    sessionCount = snapshotStreamingSessions(pAppConfiguration, sessions);
+    for (i = 0; i < sessionCount; ++i) {
+        // The index 0 is the stun server.
+        for (j = 1; j < sessions[i]->iceUriCount; j++) {
+            if (STATUS_FAILED(getIceServerStats(sessions[i]->pPeerConnection, j, &iceServerStats))) {
+                continue;
+            }
+            // The totals are since the start of the session, so the rtt is averaged over the responses since the previous probe
+            // and the ranking follows the changes of the route.
+            pProbe = &sessions[i]->iceProbes[j];
+            requests = iceServerStats.totalRequestsSent - MIN(pProbe->totalRequestsSent, iceServerStats.totalRequestsSent);
+            responses = iceServerStats.totalResponsesReceived - MIN(pProbe->totalResponsesReceived, iceServerStats.totalResponsesReceived);
+            roundTripTime = iceServerStats.totalRoundTripTime - MIN(pProbe->totalRoundTripTime, iceServerStats.totalRoundTripTime);
+            pProbe->totalRequestsSent = iceServerStats.totalRequestsSent;
+            pProbe->totalResponsesReceived = iceServerStats.totalResponsesReceived;
+            pProbe->totalRoundTripTime = iceServerStats.totalRoundTripTime;
+            if (requests == 0) {
+                continue;
+            }
+            rtt = responses == 0 ? APP_TURN_SERVER_UNREACHABLE_RTT : roundTripTime / responses;
+            reportAppSignalingTurnRtt(&pAppConfiguration->appSignaling, iceServerStats.url, rtt);
+            setAppGauge(pAppConfiguration->pMetricsRegistry, "webrtc_app_turn_rtt_seconds", "The round trip time to the turn server.", "url",
+                        iceServerStats.url, (DOUBLE) rtt / HUNDREDS_OF_NANOS_IN_A_SECOND);
+        }
+    }
+    for (i = 0; i < sessionCount; ++i) {
+        releaseStreamingSession(sessions[i]);
+    }
+
+CleanUp:
+
+    return STATUS_SUCCESS;
+}
+
+static VOID setAppMetricsCounter(PAppMetricsRegistry pRegistry, PCHAR pName, PCHAR pHelp, DOUBLE value)
+{
+    UINT32 metricId;
+
+    if (STATUS_SUCCEEDED(registerAppMetric(pRegistry, pName, pHelp, APP_METRIC_TYPE_COUNTER, NULL, NULL, NULL, 0, &metricId))) {
+        setAppMetric(pRegistry, metricId, value);
+    }
+}
+
+static VOID setAppSessionCounter(PAppMetricsRegistry pRegistry, PCHAR pName, PCHAR pHelp, PCHAR pPeerId, DOUBLE value)
+{
+    UINT32 metricId;
+
+    if (STATUS_SUCCEEDED(registerAppMetric(pRegistry, pName, pHelp, APP_METRIC_TYPE_COUNTER, "session", pPeerId, NULL, 0, &metricId))) {
+        setAppMetric(pRegistry, metricId, value);
+    }
+}
+
+static VOID setAppMediaTrackGauges(PAppMetricsRegistry pRegistry, PCHAR pTrack, PMediaTrackStats pTrackStats)
+{
+    if (pTrackStats->frameCount == 0) {
+        return;
+    }
+    setAppGauge(pRegistry, "webrtc_app_media_fps", "The frame rate of the track derived from the timestamps.", "track", pTrack, pTrackStats->fps);
+    setAppGauge(pRegistry, "webrtc_app_media_frame_gap_seconds", "The time since the last frame of the track.", "track", pTrack,
+                (DOUBLE) pTrackStats->frameGap / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    setAppGauge(pRegistry, "webrtc_app_media_max_frame_gap_seconds", "The longest time between two frames of the track in this pipeline.",
+                "track", pTrack, (DOUBLE) pTrackStats->maxFrameGap / HUNDREDS_OF_NANOS_IN_A_SECOND);
+}
+
+/**
+ * @brief collect the metrics which are only available as snapshots, so the exporter serves fresh values.
+ */
+static STATUS collectAppMetricsCallback(UINT32 timerId, UINT64 currentTime, UINT64 userData)
+{
+    UNUSED_PARAM(timerId);
+    UNUSED_PARAM(currentTime);
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
+    PAppMetricsRegistry pRegistry;
+    AppSignalingSendStats sendStats;
+    AppSignalingReconnectStats reconnectStats;
+    SignalingClientMetrics signalingClientMetrics;
+    MediaReconnectStats mediaReconnectStats;
+    MediaWatchdogStats mediaWatchdogStats;
+    UINT32 sessionCount;
+
+    setAppTraceThreadName("timer-queue");
+    appTraceBegin("collectAppMetricsCallback");
+    CHK_WARN(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG, "collectAppMetricsCallback(): Passed argument is NULL");
+    pRegistry = pAppConfiguration->pMetricsRegistry;
+
+    APP_MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
+    sessionCount = pAppConfiguration->streamingSessionCount;
+    APP_MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
+    setAppGauge(pRegistry, "webrtc_app_sessions", "The number of streaming sessions.", NULL, NULL, sessionCount);
+    reportAppMemory(pRegistry);
+
+    if (STATUS_SUCCEEDED(getAppSignalingSendStats(&pAppConfiguration->appSignaling, &sendStats))) {
+        setAppMetricsCounter(pRegistry, "webrtc_app_signaling_messages_sent_total", "The number of signaling messages sent.", sendStats.sentCount);
+        setAppMetricsCounter(pRegistry, "webrtc_app_signaling_messages_failed_total", "The number of signaling messages rejected by the client.",
+                             sendStats.failedCount);
+        setAppMetricsCounter(pRegistry, "webrtc_app_signaling_messages_dropped_total", "The number of signaling messages dropped.",
+                             sendStats.droppedCount);
+        setAppGauge(pRegistry, "webrtc_app_signaling_queue_depth", "The depth of the signaling send queue.", NULL, NULL, sendStats.queueDepth);
+        setAppGauge(pRegistry, "webrtc_app_signaling_send_latency_seconds", "The moving average of the signaling send latency.", NULL, NULL,
+                    (DOUBLE) sendStats.avgSendLatency / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    }
+
+    if (STATUS_SUCCEEDED(getAppSignalingReconnectStats(&pAppConfiguration->appSignaling, &reconnectStats))) {
+        setAppMetricsCounter(pRegistry, "webrtc_app_signaling_restarts_total", "The number of signaling client re-creations.",
+                             reconnectStats.restartCount);
+        setAppMetricsCounter(pRegistry, "webrtc_app_signaling_restart_failures_total", "The number of failed signaling client re-creations.",
+                             reconnectStats.failedCount);
+    }
+
+    if (STATUS_SUCCEEDED(getAppSignalingMetrics(&pAppConfiguration->appSignaling, &signalingClientMetrics))) {
+        logSignalingClientStats(&signalingClientMetrics);
+        setAppMetricsCounter(pRegistry, "webrtc_app_signaling_api_errors_total", "The number of signaling api errors.",
+                             signalingClientMetrics.signalingClientStats.numberOfErrors);
+        setAppMetricsCounter(pRegistry, "webrtc_app_signaling_runtime_errors_total", "The number of signaling runtime errors.",
+                             signalingClientMetrics.signalingClientStats.numberOfRuntimeErrors);
+        setAppGauge(pRegistry, "webrtc_app_signaling_cp_api_latency_seconds", "The moving average of the control plane api latency.", NULL, NULL,
+                    (DOUBLE) signalingClientMetrics.signalingClientStats.cpApiCallLatency / HUNDREDS_OF_NANOS_IN_A_SECOND);
+        setAppGauge(pRegistry, "webrtc_app_signaling_dp_api_latency_seconds", "The moving average of the data plane api latency.", NULL, NULL,
+                    (DOUBLE) signalingClientMetrics.signalingClientStats.dpApiCallLatency / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    }
+
+    if (pAppConfiguration->pMediaContext != NULL &&
+        STATUS_SUCCEEDED(getMediaSourceReconnectStats(pAppConfiguration->pMediaContext, &mediaReconnectStats))) {
+        setAppMetricsCounter(pRegistry, "webrtc_app_media_reconnects_total", "The number of rebuilt rtsp pipelines which delivered the media again.",
+                             mediaReconnectStats.reconnectCount);
+        setAppMetricsCounter(pRegistry, "webrtc_app_media_reconnect_failures_total", "The number of rebuilt rtsp pipelines which failed.",
+                             mediaReconnectStats.failedCount);
+        setAppMetricsCounter(pRegistry, "webrtc_app_media_downtime_seconds_total", "The time without the media of the camera.",
+                             (DOUBLE) mediaReconnectStats.downtime / HUNDREDS_OF_NANOS_IN_A_SECOND);
+        setAppGauge(pRegistry, "webrtc_app_media_lost", "1 while the camera is lost and the pipeline is being rebuilt.", NULL, NULL,
+                    mediaReconnectStats.lost ? 1 : 0);
+    }
+
+    if (pAppConfiguration->pMediaContext != NULL &&
+        STATUS_SUCCEEDED(getMediaSourceWatchdogStats(pAppConfiguration->pMediaContext, &mediaWatchdogStats))) {
+        setAppMetricsCounter(pRegistry, "webrtc_app_media_stalls_total", "The number of rtsp pipelines restarted by the watchdog.",
+                             mediaWatchdogStats.stallCount);
+        setAppMediaTrackGauges(pRegistry, "video", &mediaWatchdogStats.video);
+        setAppMediaTrackGauges(pRegistry, "audio", &mediaWatchdogStats.audio);
+    }
+
+#ifdef APP_LOCK_PROFILING
+    exportAppLockProfile(pRegistry);
+#endif
+
+CleanUp:
+
+    appTraceEnd("collectAppMetricsCallback");
+    return STATUS_SUCCESS;
+}
+
+static DOUBLE getAppCounterRate(UINT64 current, UINT64 previous, DOUBLE duration)
+{
+    // The counters of a transceiver restart when it is recreated.
+    return current >= previous ? (DOUBLE) (current - previous) / duration : 0;
+}
+
+static VOID getAppTrackRtpStats(PStreamingSession pStreamingSession, PRtcRtpTransceiver pRtcRtpTransceiver, PAppRtpQualityStats pTrackStats,
+                                PAppRtpQualityStats pPrevTrackStats)
+{
+    // A transceiver which misses a sample keeps its counters, so it adds nothing now and no spike when it reports again.
+    MEMSET(pTrackStats, 0x00, SIZEOF(AppRtpQualityStats));
+    if (pRtcRtpTransceiver == NULL || STATUS_FAILED(getRtpQualityStats(pStreamingSession->pPeerConnection, pRtcRtpTransceiver, pTrackStats))) {
+        MEMCPY(pTrackStats, pPrevTrackStats, SIZEOF(AppRtpQualityStats));
+        pTrackStats->fractionLost = 0;
+        pTrackStats->jitter = 0;
+        pTrackStats->roundTripTime = 0;
+        pTrackStats->remoteReported = FALSE;
+    }
+}
+
+static VOID addAppTrackRtpStats(PAppSessionStats pSessionStats, PAppRtpQualityStats pTrackStats, PAppRtpQualityStats pPrevTrackStats,
+                                DOUBLE duration)
+{
+    PAppRtpQualityStats pStats = &pSessionStats->rtpStats;
+
+    pSessionStats->nackRate += getAppCounterRate(pTrackStats->nackCount, pPrevTrackStats->nackCount, duration);
+    pSessionStats->pliRate += getAppCounterRate(pTrackStats->pliCount, pPrevTrackStats->pliCount, duration);
+    pSessionStats->retransmittedBitrate +=
+        getAppCounterRate(pTrackStats->retransmittedBytesSent, pPrevTrackStats->retransmittedBytesSent, duration) * 8.0;
+    pStats->packetsSent += pTrackStats->packetsSent;
+    pStats->bytesSent += pTrackStats->bytesSent;
+    pStats->retransmittedPacketsSent += pTrackStats->retransmittedPacketsSent;
+    pStats->retransmittedBytesSent += pTrackStats->retransmittedBytesSent;
+    pStats->nackCount += pTrackStats->nackCount;
+    pStats->pliCount += pTrackStats->pliCount;
+    pStats->firCount += pTrackStats->firCount;
+    pStats->packetsLost += pTrackStats->packetsLost;
+    pStats->fractionLost = MAX(pStats->fractionLost, pTrackStats->fractionLost);
+    pStats->jitter = MAX(pStats->jitter, pTrackStats->jitter);
+    pStats->roundTripTime = MAX(pStats->roundTripTime, pTrackStats->roundTripTime);
+    pStats->remoteReported = pStats->remoteReported || pTrackStats->remoteReported;
+}
+
+static VOID updateSendBudget(PAppSessionStats pStats, PAppSessionStats pPrevStats)
+{
+    DOUBLE nackRatio = pStats->packetsSentRate > 0 ? pStats->nackRate / pStats->packetsSentRate : 0;
+    DOUBLE budget = pPrevStats->sendBudget > 0 ? pPrevStats->sendBudget : APP_SESSION_SEND_BUDGET_MAX;
+
+    if (pStats->packetsDiscardedRate > 0) {
+        // The packets do not leave the gateway, so the link of the viewer is not to blame and the budget is kept.
+        pStats->linkState = APP_SESSION_LINK_STATE_GATEWAY_OVERLOADED;
+    } else if (pStats->rtpStats.fractionLost > APP_SESSION_LOSSY_FRACTION_LOST || nackRatio > APP_SESSION_LOSSY_NACK_RATIO) {
+        // The viewer loses the packets, the budget backs off below the bitrate which gets through. The media hook holds the video
+        // to the budget, so it keeps backing off while the loss lasts.
+        pStats->linkState = APP_SESSION_LINK_STATE_LOSSY;
+        budget = MIN(budget, pStats->outgoingBitrate) * (1.0 - MIN(MAX(pStats->rtpStats.fractionLost, nackRatio), 1.0) / 2);
+    } else {
+        pStats->linkState = APP_SESSION_LINK_STATE_GOOD;
+        budget *= APP_SESSION_SEND_BUDGET_INCREASE;
+    }
+    pStats->sendBudget = MIN(MAX(budget, APP_SESSION_SEND_BUDGET_MIN), APP_SESSION_SEND_BUDGET_MAX);
+}
+
 static STATUS getIceCandidatePairStatsCallback(UINT32 timerId, UINT64 currentTime, UINT64 userData)
 {
     UNUSED_PARAM(timerId);
     UNUSED_PARAM(currentTime);
     STATUS retStatus = STATUS_SUCCESS;
     PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
-    UINT32 i;
-    UINT64 currentMeasureDuration = 0;
-    DOUBLE averagePacketsDiscardedOnSend = 0.0;
-    DOUBLE averageNumberOfPacketsSentPerSecond = 0.0;
-    DOUBLE averageNumberOfPacketsReceivedPerSecond = 0.0;
-    DOUBLE outgoingBitrate = 0.0;
-    DOUBLE incomingBitrate = 0.0;
+    PStreamingSession sessions[APP_MAX_CONCURRENT_STREAMING_SESSION];
+    PStreamingSession pStreamingSession;
+    UINT32 i, sessionCount;
+    DOUBLE currentMeasureDuration = 0;
     RtcStats rtcIceCandidatePairMetrics;
-    BOOL locked = FALSE;
-
+    PRtcIceCandidatePairStats pPairStats = &rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats;
+    AppSessionStats prevStats;
+    PAppSessionStats pStats;
+    PAppMetricsRegistry pRegistry;
+    PCHAR pPeerId;
+    AppDataChannelStats dataChannelStats;
+    AppPacerFlowStats pacerStats;
+    SIZE_T twccBitrate;
+    PAppMemoryStats pMemoryStats;
+
+    setAppTraceThreadName("timer-queue");
+    appTraceBegin("getIceCandidatePairStatsCallback");
     CHK_WARN(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG, "getPeriodicStats(): Passed argument is NULL");
+    pRegistry = pAppConfiguration->pMetricsRegistry;
 
     rtcIceCandidatePairMetrics.requestedTypeOfStats = RTC_STATS_TYPE_CANDIDATE_PAIR;
 
-    // We need to execute this under the object lock due to race conditions that it could pose
-    MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
-    locked = TRUE;
+    // The references keep the sessions alive without the object lock, the reaper frees them after the last release.
+    sessionCount = snapshotStreamingSessions(pAppConfiguration, sessions);
+    for (i = 0; i < sessionCount; ++i) {
+        pStreamingSession = sessions[i];
+        if (ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag) ||
+            STATUS_FAILED(rtcPeerConnectionGetMetrics(pStreamingSession->pPeerConnection, NULL, &rtcIceCandidatePairMetrics))) {
+            continue;
+        }
+        getStreamingSessionStats(pStreamingSession, &prevStats);
+        currentMeasureDuration = (DOUBLE) (rtcIceCandidatePairMetrics.timestamp - prevStats.timestamp) / HUNDREDS_OF_NANOS_IN_A_SECOND;
+        DLOGD("Current duration: %lf seconds", currentMeasureDuration);
+
+        if (currentMeasureDuration > 0) {
+            DLOGD("Selected local candidate ID: %s", pPairStats->localCandidateId);
+            DLOGD("Selected remote candidate ID: %s", pPairStats->remoteCandidateId);
+            // TODO: Display state as a string for readability
+            DLOGD("Ice Candidate Pair state: %d", pPairStats->state);
+            DLOGD("Nomination state: %s", pPairStats->nominated ? "nominated" : "not nominated");
+
+            // This timer is the only writer, the buffer which is not published is free to fill. A reader still copying it from
+            // the generation before sees the generation move and retries.
+            pStats = &pStreamingSession->stats[(pStreamingSession->statsGeneration + 1) % ARRAY_SIZE(pStreamingSession->stats)];
+            pStats->timestamp = rtcIceCandidatePairMetrics.timestamp;
+            pStats->packetsSent = pPairStats->packetsSent;
+            pStats->packetsReceived = pPairStats->packetsReceived;
+            pStats->bytesSent = pPairStats->bytesSent;
+            pStats->bytesReceived = pPairStats->bytesReceived;
+            pStats->packetsDiscardedOnSend = pPairStats->packetsDiscardedOnSend;
+            pStats->roundTripTime = pPairStats->currentRoundTripTime;
+
+            pStats->packetsSentRate = (DOUBLE) (pStats->packetsSent - prevStats.packetsSent) / (DOUBLE) currentMeasureDuration;
+            DLOGD("Packet send rate: %lf pkts/sec", pStats->packetsSentRate);
+
+            pStats->packetsReceivedRate = (DOUBLE) (pStats->packetsReceived - prevStats.packetsReceived) / (DOUBLE) currentMeasureDuration;
+            DLOGD("Packet receive rate: %lf pkts/sec", pStats->packetsReceivedRate);
+
+            pStats->outgoingBitrate = (DOUBLE) ((pStats->bytesSent - prevStats.bytesSent) * 8.0) / currentMeasureDuration;
+            DLOGD("Outgoing bit rate: %lf bps", pStats->outgoingBitrate);
+
+            pStats->incomingBitrate = (DOUBLE) ((pStats->bytesReceived - prevStats.bytesReceived) * 8.0) / currentMeasureDuration;
+            DLOGD("Incoming bit rate: %lf bps", pStats->incomingBitrate);
+
+            pStats->packetsDiscardedRate =
+                (DOUBLE) (pStats->packetsDiscardedOnSend - prevStats.packetsDiscardedOnSend) / (DOUBLE) currentMeasureDuration;
+            DLOGD("Packet discard rate: %lf pkts/sec", pStats->packetsDiscardedRate);
+
+            DLOGD("Current STUN request round trip time: %lf sec", pStats->roundTripTime);
+            DLOGD("Number of STUN responses received: %llu", pPairStats->responsesReceived);
+
+            // The rtp stats are best effort, a transceiver may not send yet. The rates are taken per transceiver.
+            getAppTrackRtpStats(pStreamingSession, pStreamingSession->pVideoRtcRtpTransceiver, &pStats->videoRtpStats, &prevStats.videoRtpStats);
+            getAppTrackRtpStats(pStreamingSession, pStreamingSession->pAudioRtcRtpTransceiver, &pStats->audioRtpStats, &prevStats.audioRtpStats);
+            MEMSET(&pStats->rtpStats, 0x00, SIZEOF(AppRtpQualityStats));
+            pStats->nackRate = 0;
+            pStats->pliRate = 0;
+            pStats->retransmittedBitrate = 0;
+            addAppTrackRtpStats(pStats, &pStats->videoRtpStats, &prevStats.videoRtpStats, currentMeasureDuration);
+            addAppTrackRtpStats(pStats, &pStats->audioRtpStats, &prevStats.audioRtpStats, currentMeasureDuration);
+            updateSendBudget(pStats, &prevStats);
+            ATOMIC_STORE(&pStreamingSession->sendBudget, (SIZE_T) pStats->sendBudget);
+            DLOGD("Nack rate: %lf /sec, pli rate: %lf /sec, fraction lost: %lf, jitter: %lf sec, send budget: %lf bps", pStats->nackRate,
+                  pStats->pliRate, pStats->rtpStats.fractionLost, pStats->rtpStats.jitter, pStats->sendBudget);
+
+            ATOMIC_STORE(&pStreamingSession->statsGeneration, pStreamingSession->statsGeneration + 1);
+
+            pPeerId = pStreamingSession->peerId;
+            setAppGauge(pRegistry, "webrtc_app_session_outgoing_bitrate_bps", "The outgoing bitrate of the session.", "session", pPeerId,
+                        pStats->outgoingBitrate);
+            setAppGauge(pRegistry, "webrtc_app_session_incoming_bitrate_bps", "The incoming bitrate of the session.", "session", pPeerId,
+                        pStats->incomingBitrate);
+            setAppGauge(pRegistry, "webrtc_app_session_packets_sent_rate", "The packets sent per second of the session.", "session", pPeerId,
+                        pStats->packetsSentRate);
+            setAppGauge(pRegistry, "webrtc_app_session_packets_received_rate", "The packets received per second of the session.", "session",
+                        pPeerId, pStats->packetsReceivedRate);
+            setAppGauge(pRegistry, "webrtc_app_session_packets_discarded_rate", "The packets discarded on send per second of the session.",
+                        "session", pPeerId, pStats->packetsDiscardedRate);
+            setAppGauge(pRegistry, "webrtc_app_session_rtt_seconds", "The current round trip time of the selected candidate pair.", "session",
+                        pPeerId, pStats->roundTripTime);
+            setAppGauge(pRegistry, "webrtc_app_session_nack_rate", "The nacks received per second of the session.", "session", pPeerId,
+                        pStats->nackRate);
+            setAppGauge(pRegistry, "webrtc_app_session_pli_rate", "The picture loss indications received per second of the session.", "session",
+                        pPeerId, pStats->pliRate);
+            setAppGauge(pRegistry, "webrtc_app_session_retransmitted_bitrate_bps", "The retransmitted bitrate of the session.", "session", pPeerId,
+                        pStats->retransmittedBitrate);
+            setAppGauge(pRegistry, "webrtc_app_session_fraction_lost", "The fraction lost of the latest receiver report of the session.", "session",
+                        pPeerId, pStats->rtpStats.fractionLost);
+            setAppGauge(pRegistry, "webrtc_app_session_jitter_seconds", "The interarrival jitter reported by the viewer of the session.", "session",
+                        pPeerId, pStats->rtpStats.jitter);
+            setAppGauge(pRegistry, "webrtc_app_session_rtcp_rtt_seconds", "The round trip time of the receiver reports of the session.", "session",
+                        pPeerId, pStats->rtpStats.roundTripTime);
+            setAppGauge(pRegistry, "webrtc_app_session_send_budget_bps", "The bitrate the session may send.", "session", pPeerId,
+                        pStats->sendBudget);
+            setAppGauge(pRegistry, "webrtc_app_session_link_state", "The link state of the session, 0 good, 1 lossy link, 2 overloaded gateway.",
+                        "session", pPeerId, pStats->linkState);
+            setAppSessionCounter(pRegistry, "webrtc_app_session_send_budget_dropped_frames_total",
+                                 "The video frames of the session dropped over the debt of the send budget.", pPeerId,
+                                 (DOUBLE) ATOMIC_LOAD(&pStreamingSession->sendBudgetDropped));
+            if (STATUS_SUCCEEDED(getAppMemorySessionStats(pStreamingSession->memorySessionId, &pMemoryStats))) {
+                setAppGauge(pRegistry, "webrtc_app_session_memory_live_bytes", "The bytes charged to the session and not yet freed.", "session",
+                            pPeerId, (DOUBLE) ATOMIC_LOAD(&pMemoryStats->liveBytes));
+            }
 
-    for (i = 0; i < pAppConfiguration->streamingSessionCount; ++i) {
-        if (STATUS_SUCCEEDED(
-                rtcPeerConnectionGetMetrics(pAppConfiguration->streamingSessionList[i]->pPeerConnection, NULL, &rtcIceCandidatePairMetrics))) {
-            currentMeasureDuration = (rtcIceCandidatePairMetrics.timestamp - pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevTs) /
-                HUNDREDS_OF_NANOS_IN_A_SECOND;
-            DLOGD("Current duration: %" PRIu64 " seconds", currentMeasureDuration);
-
-            if (currentMeasureDuration > 0) {
-                DLOGD("Selected local candidate ID: %s", rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.localCandidateId);
-                DLOGD("Selected remote candidate ID: %s", rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.remoteCandidateId);
-                // TODO: Display state as a string for readability
-                DLOGD("Ice Candidate Pair state: %d", rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.state);
-                DLOGD("Nomination state: %s",
-                      rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.nominated ? "nominated" : "not nominated");
-                averageNumberOfPacketsSentPerSecond =
-                    (DOUBLE)(rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsSent -
-                             pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsSent) /
-                    (DOUBLE) currentMeasureDuration;
-                DLOGD("Packet send rate: %lf pkts/sec", averageNumberOfPacketsSentPerSecond);
-
-                averageNumberOfPacketsReceivedPerSecond =
-                    (DOUBLE)(rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsReceived -
-                             pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsReceived) /
-                    (DOUBLE) currentMeasureDuration;
-                DLOGD("Packet receive rate: %lf pkts/sec", averageNumberOfPacketsReceivedPerSecond);
-
-                outgoingBitrate = (DOUBLE)((rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.bytesSent -
-                                            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesSent) *
-                                           8.0) /
-                    currentMeasureDuration;
-                DLOGD("Outgoing bit rate: %lf bps", outgoingBitrate);
-
-                incomingBitrate = (DOUBLE)((rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.bytesReceived -
-                                            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesReceived) *
-                                           8.0) /
-                    currentMeasureDuration;
-                DLOGD("Incoming bit rate: %lf bps", incomingBitrate);
-
-                averagePacketsDiscardedOnSend = (DOUBLE)(rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsDiscardedOnSend -
-                                                         pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevPacketsDiscardedOnSend) /
-                    (DOUBLE) currentMeasureDuration;
-                DLOGD("Packet discard rate: %lf pkts/sec", averagePacketsDiscardedOnSend);
-
-                DLOGD("Current STUN request round trip time: %lf sec",
-                      rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.currentRoundTripTime);
-                DLOGD("Number of STUN responses received: %llu", rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.responsesReceived);
-
-                pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevTs = rtcIceCandidatePairMetrics.timestamp;
-                pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsSent =
-                    rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsSent;
-                pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsReceived =
-                    rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsReceived;
-                pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesSent =
-                    rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.bytesSent;
-                pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesReceived =
-                    rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.bytesReceived;
-                pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevPacketsDiscardedOnSend =
-                    rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsDiscardedOnSend;
+            // The pacer spreads the frames of the session at a multiple of its twcc estimate.
+            if (pStreamingSession->pPacerFlow != NULL) {
+                twccBitrate = ATOMIC_LOAD(&pStreamingSession->twccBitrate);
+                if (twccBitrate > 0) {
+                    setAppPacerFlowBitrate(pAppConfiguration->pAppPacer, pStreamingSession->pPacerFlow, (DOUBLE) twccBitrate);
+                }
+                setAppGauge(pRegistry, "webrtc_app_session_twcc_bitrate_bps", "The bitrate the twcc feedback of the session estimates.", "session",
+                            pPeerId, (DOUBLE) twccBitrate);
+                getAppPacerFlowStats(pAppConfiguration->pAppPacer, pStreamingSession->pPacerFlow, &pacerStats);
+                setAppGauge(pRegistry, "webrtc_app_session_pacer_queued_bytes", "The bytes waiting in the pacer queue of the session.", "session",
+                            pPeerId, (DOUBLE) pacerStats.queuedBytes);
+                setAppGauge(pRegistry, "webrtc_app_session_pacer_queue_delay_seconds",
+                            "The time the last frame of the session waited in the pacer queue.", "session", pPeerId,
+                            (DOUBLE) pacerStats.queueDelay / HUNDREDS_OF_NANOS_IN_A_SECOND);
+                setAppSessionCounter(pRegistry, "webrtc_app_session_pacer_dropped_frames_total",
+                                     "The frames of the session dropped by a full pacer queue.", pPeerId, (DOUBLE) pacerStats.framesDropped);
+                setAppSessionCounter(pRegistry, "webrtc_app_session_pacer_late_frames_total",
+                                     "The frames of the session written over the budget after the max delay.", pPeerId,
+                                     (DOUBLE) pacerStats.framesLate);
+            }
+
+            if (pStreamingSession->pAppDataChannel != NULL) {
+                getAppDataChannelStats(pStreamingSession->pAppDataChannel, &dataChannelStats);
+                setAppGauge(pRegistry, "webrtc_app_session_data_channel_buffered_bytes", "The bytes queued to the data channel of the session.",
+                            "session", pPeerId, (DOUBLE) dataChannelStats.bufferedAmount);
+                setAppGauge(pRegistry, "webrtc_app_session_data_channel_dropped_messages",
+                            "The messages to the data channel of the session dropped by the backpressure.", "session", pPeerId,
+                            (DOUBLE) dataChannelStats.messagesDropped);
             }
         }
     }
+    for (i = 0; i < sessionCount; ++i) {
+        releaseStreamingSession(sessions[i]);
+    }
 
 CleanUp:
 
-    if (locked) {
-        MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
-    }
-
+    appTraceEnd("getIceCandidatePairStatsCallback");
     return retStatus;
 }
 
@@ -403,13 +1281,19 @@ static STATUS onSignalingMessageReceived(UINT64 userData, PReceivedSignalingMess
     STATUS retStatus = STATUS_SUCCESS;
     PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
     BOOL peerConnectionFound = FALSE, locked = FALSE, startStats = FALSE;
+    UINT64 offerTime;
     UINT32 clientIdHashKey;
     UINT64 hashValue = 0;
     PPendingMessageQueue pPendingMsgQ = NULL;
     PStreamingSession pStreamingSession = NULL;
+    // the peer connections and the candidates are charged to the sessions, the queues charge their own nodes.
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_SESSION);
+    UINT32 prevMemorySession = setAppMemorySession(APP_MEMORY_NO_SESSION);
 
+    setAppTraceThreadName("signaling-callback");
+    appTraceBegin("onSignalingMessageReceived");
     CHK(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG);
-    MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
+    APP_MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
     locked = TRUE;
     // find the corresponding streaming session.
     clientIdHashKey = COMPUTE_CRC32((PBYTE) pReceivedSignalingMessage->signalingMessage.peerClientId,
@@ -419,6 +1303,7 @@ static STATUS onSignalingMessageReceived(UINT64 userData, PReceivedSignalingMess
     if (peerConnectionFound) {
         CHK_STATUS((appHashTableGet(pAppConfiguration->pRemoteRtcPeerConnections, clientIdHashKey, &hashValue)));
         pStreamingSession = (PStreamingSession) hashValue;
+        setAppMemorySession(pStreamingSession->memorySessionId);
     }
 
     switch (pReceivedSignalingMessage->signalingMessage.messageType) {
@@ -441,11 +1326,14 @@ static STATUS onSignalingMessageReceived(UINT64 userData, PReceivedSignalingMess
                 CHK_STATUS((getPendingMsgQByHashVal(pAppConfiguration->pRemotePeerPendingSignalingMessages, clientIdHashKey, TRUE, &pPendingMsgQ)));
                 CHK(FALSE, retStatus);
             }
+            offerTime = getAppMonotonicTime();
             CHK_STATUS((createStreamingSession(pAppConfiguration, pReceivedSignalingMessage->signalingMessage.peerClientId, &pStreamingSession)));
-            pStreamingSession->offerReceiveTime = GETTIME();
-            MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
+            pStreamingSession->timeline[APP_SESSION_EVENT_OFFER_RECEIVED] = offerTime;
+            setAppMemorySession(pStreamingSession->memorySessionId);
+            markAppSessionEvent(pStreamingSession, APP_SESSION_EVENT_PEER_CONNECTION_CREATED);
+            APP_MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
             pAppConfiguration->streamingSessionList[pAppConfiguration->streamingSessionCount++] = pStreamingSession;
-            MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
+            APP_MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
 
             CHK_STATUS((handleOffer(pAppConfiguration, pStreamingSession, &pReceivedSignalingMessage->signalingMessage)));
             CHK_STATUS((appHashTablePut(pAppConfiguration->pRemoteRtcPeerConnections, clientIdHashKey, (UINT64) pStreamingSession)));
@@ -479,7 +1367,7 @@ static STATUS onSignalingMessageReceived(UINT64 userData, PReceivedSignalingMess
             break;
     }
 
-    MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+    APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
     locked = FALSE;
 
     if (startStats &&
@@ -493,45 +1381,42 @@ static STATUS onSignalingMessageReceived(UINT64 userData, PReceivedSignalingMess
         // Reset the returned status
         retStatus = STATUS_SUCCESS;
     }
+    // The data channel timer lives with the stats timer, from the first session to the last one.
+    if (startStats &&
+        STATUS_FAILED(retStatus = appTimeQueueAdd(pAppConfiguration->timerQueueHandle, APP_DATA_CHANNEL_FLUSH_PERIOD, APP_DATA_CHANNEL_FLUSH_PERIOD,
+                                                  flushAppDataChannelsCallback, (UINT64) pAppConfiguration,
+                                                  &pAppConfiguration->dataChannelTimerId))) {
+        DLOGW("Failed to add flushAppDataChannelsCallback to the timer queue (code 0x%08x), the data channels do not send", retStatus);
+        retStatus = STATUS_SUCCESS;
+    }
 
 CleanUp:
 
     if (locked) {
-        MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+        APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
     }
+    appTraceEnd("onSignalingMessageReceived");
+    setAppMemorySession(prevMemorySession);
+    setAppMemoryTag(prevTag);
 
     CHK_LOG_ERR((retStatus));
     return retStatus;
 }
 
-static STATUS pregenerateCertTimerCallback(UINT32 timerId, UINT64 currentTime, UINT64 userData)
-{
-    UNUSED_PARAM(timerId);
-    UNUSED_PARAM(currentTime);
-    STATUS retStatus = STATUS_SUCCESS;
-    PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
-
-    CHK_WARN(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG, "pregenerateCertTimerCallback(): Passed argument is NULL");
-
-    MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
-    generateCertRoutine(&pAppConfiguration->appCredential);
-    MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
-
-CleanUp:
-    return retStatus;
-}
-
 PVOID mediaSenderRoutine(PVOID userData)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PAppConfiguration pAppConfiguration = (PAppConfiguration) userData;
     TID mediaSourceTid = INVALID_TID_VALUE;
 
-    MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
-    while (!ATOMIC_LOAD_BOOL(&pAppConfiguration->peerConnectionConnected) && !ATOMIC_LOAD_BOOL(&pAppConfiguration->terminateApp)) {
-        CVAR_WAIT(pAppConfiguration->cvar, pAppConfiguration->appConfigurationObjLock, 5 * HUNDREDS_OF_NANOS_IN_A_SECOND);
+    setAppTraceThreadName("media-sender");
+    APP_MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
+    // The recorder takes the media without a viewer.
+    while (!ATOMIC_LOAD_BOOL(&pAppConfiguration->peerConnectionConnected) && pAppConfiguration->pAppRecorder == NULL &&
+           !ATOMIC_LOAD_BOOL(&pAppConfiguration->terminateApp)) {
+        APP_CVAR_WAIT(pAppConfiguration->cvar, pAppConfiguration->appConfigurationObjLock, 5 * HUNDREDS_OF_NANOS_IN_A_SECOND);
     }
-    MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+    APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
 
     CHK(!ATOMIC_LOAD_BOOL(&pAppConfiguration->terminateApp), retStatus);
 
@@ -551,7 +1436,8 @@ CleanUp:
     return NULL;
 }
 
-static STATUS initializePeerConnection(PAppConfiguration pAppConfiguration, PRtcPeerConnection* ppRtcPeerConnection)
+static STATUS initializePeerConnection(PAppConfiguration pAppConfiguration, PAppInterfaceFilterSession pFilterSession, PUINT32 pIceUriCount,
+                                       PRtcPeerConnection* ppRtcPeerConnection)
 {
     ENTERS();
     STATUS retStatus = STATUS_SUCCESS;
@@ -562,15 +1448,25 @@ static STATUS initializePeerConnection(PAppConfiguration pAppConfiguration, PRtc
 
     MEMSET(&configuration, 0x00, SIZEOF(RtcConfiguration));
 
-    // Set this to custom callback to enable filtering of interfaces
-    configuration.kvsRtcConfiguration.iceSetInterfaceFilterFunc = NULL;
+    // Skip the interfaces which are not reachable by the viewers, e.g. the bridges of the containers. It saves the host candidates
+    // and their connectivity checks.
+    if (pAppConfiguration->interfaceFilter.enabled) {
+        CHK_STATUS((initAppInterfaceFilterSession(pFilterSession, &pAppConfiguration->interfaceFilter)));
+        configuration.kvsRtcConfiguration.iceSetInterfaceFilterFunc = appInterfaceFilterFunc;
+        configuration.kvsRtcConfiguration.filterCustomData = (UINT64) pFilterSession;
+    } else {
+        configuration.kvsRtcConfiguration.iceSetInterfaceFilterFunc = NULL;
+    }
 
     // Set the ICE mode explicitly
     configuration.iceTransportPolicy = ICE_TRANSPORT_POLICY_ALL;
 
     CHK_STATUS((queryAppSignalingServer(&pAppConfiguration->appSignaling, configuration.iceServers, &uriCount)));
 
-    pAppConfiguration->iceUriCount = uriCount + 1;
+    *pIceUriCount = uriCount + 1;
+
+    // The pool only holds ECDSA certs, so the sdk generates the RSA cert on demand.
+    configuration.kvsRtcConfiguration.generateRSACertificate = (pAppConfiguration->appCredential.certKeyType == APP_CERT_KEY_TYPE_RSA);
 
     CHK_STATUS((popGeneratedCert(&pAppConfiguration->appCredential, &pRtcCertificate)));
 
@@ -602,11 +1498,20 @@ STATUS createStreamingSession(PAppConfiguration pAppConfiguration, PCHAR peerId,
     RtcRtpTransceiverInit audioRtpTransceiverInit;
     RtcRtpTransceiverInit videoRtpTransceiverInit;
     RTC_CODEC codec;
+    STATUS videoStatus, audioStatus;
+    UINT32 memorySessionId = APP_MEMORY_NO_SESSION, prevMemorySession;
     MEMSET(&videoTrack, 0x00, SIZEOF(RtcMediaStreamTrack));
     MEMSET(&audioTrack, 0x00, SIZEOF(RtcMediaStreamTrack));
 
+    // The session and its peer connection are charged to the session, so are the sdk calls and callbacks made for it.
+    if (STATUS_FAILED(openAppMemorySession(&memorySessionId))) {
+        DLOGW("The memory of the session %s is not counted", peerId);
+    }
+    prevMemorySession = setAppMemorySession(memorySessionId);
+
     pStreamingSession = (PStreamingSession) MEMCALLOC(1, SIZEOF(StreamingSession));
     CHK(pStreamingSession != NULL, STATUS_NOT_ENOUGH_MEMORY);
+    pStreamingSession->memorySessionId = memorySessionId;
 
     CHK_STATUS((isMediaSourceReady(pAppConfiguration->pMediaContext)));
 
@@ -614,54 +1519,81 @@ STATUS createStreamingSession(PAppConfiguration pAppConfiguration, PCHAR peerId,
     ATOMIC_STORE_BOOL(&pStreamingSession->peerIdReceived, TRUE);
 
     pStreamingSession->pAppConfiguration = pAppConfiguration;
-    pStreamingSession->rtcMetricsHistory.prevTs = GETTIME();
+    // the reference of the session list.
+    pStreamingSession->refCount = 1;
+    pStreamingSession->stats[0].timestamp = GETTIME();
+    pStreamingSession->frameDelayMetricId = MAX_UINT32;
+    pStreamingSession->writeFrameMetricId = MAX_UINT32;
+    registerAppMetric(pAppConfiguration->pMetricsRegistry, "webrtc_app_session_frame_delay_seconds",
+                      "The latency from the appsink callback to the frame written to the session.", APP_METRIC_TYPE_SUMMARY, "session", peerId,
+                      NULL, 0, &pStreamingSession->frameDelayMetricId);
+    registerAppMetric(pAppConfiguration->pMetricsRegistry, "webrtc_app_session_write_frame_seconds", "The latency of writeFrame of the session.",
+                      APP_METRIC_TYPE_SUMMARY, "session", peerId, NULL, 0, &pStreamingSession->writeFrameMetricId);
+    pStreamingSession->probeRttMetricId = MAX_UINT32;
+    registerAppMetric(pAppConfiguration->pMetricsRegistry, "webrtc_app_session_probe_rtt_seconds",
+                      "The round trip time of the pings over the probe channel of the session.", APP_METRIC_TYPE_HISTOGRAM, "session", peerId,
+                      gAppProbeRttBounds, ARRAY_SIZE(gAppProbeRttBounds), &pStreamingSession->probeRttMetricId);
     // if we're the viewer, we control the trickle ice mode
     pStreamingSession->remoteCanTrickleIce = FALSE;
 
     ATOMIC_STORE_BOOL(&pStreamingSession->terminateFlag, FALSE);
     ATOMIC_STORE_BOOL(&pStreamingSession->candidateGatheringDone, FALSE);
 
-    CHK_STATUS((initializePeerConnection(pAppConfiguration, &pStreamingSession->pPeerConnection)));
+    CHK_STATUS((initializePeerConnection(pAppConfiguration, &pStreamingSession->interfaceFilterSession, &pStreamingSession->iceUriCount,
+                                         &pStreamingSession->pPeerConnection)));
     CHK_STATUS((peerConnectionOnIceCandidate(pStreamingSession->pPeerConnection, (UINT64) pStreamingSession, onIceCandidateHandler)));
     CHK_STATUS((peerConnectionOnConnectionStateChange(pStreamingSession->pPeerConnection, (UINT64) pStreamingSession, onConnectionStateChange)));
-    CHK_STATUS((peerConnectionOnDataChannel(pStreamingSession->pPeerConnection, (UINT64) pStreamingSession, onDataChannel)));
-
-    // Add a SendRecv Transceiver of type video
-    CHK_STATUS((queryMediaVideoCap(pAppConfiguration->pMediaContext, &codec)));
-    CHK_STATUS((addSupportedCodec(pStreamingSession->pPeerConnection, codec)));
-    videoTrack.kind = MEDIA_STREAM_TRACK_KIND_VIDEO;
-    videoTrack.codec = codec;
-    videoRtpTransceiverInit.direction = RTC_RTP_TRANSCEIVER_DIRECTION_SENDONLY;
-    STRCPY(videoTrack.streamId, APP_VIDEO_TRACK_STREAM_ID);
-    STRCPY(videoTrack.trackId, APP_VIDEO_TRACK_ID);
-    CHK_STATUS(
-        (addTransceiver(pStreamingSession->pPeerConnection, &videoTrack, &videoRtpTransceiverInit, &pStreamingSession->pVideoRtcRtpTransceiver)));
-
-    CHK_STATUS(
-        (transceiverOnBandwidthEstimation(pStreamingSession->pVideoRtcRtpTransceiver, (UINT64) pStreamingSession, onBandwidthEstimationHandler)));
-
-    // Add a SendRecv Transceiver of type audio
-    CHK_STATUS((queryMediaAudioCap(pAppConfiguration->pMediaContext, &codec)));
-    CHK_STATUS((addSupportedCodec(pStreamingSession->pPeerConnection, codec)));
-    audioTrack.kind = MEDIA_STREAM_TRACK_KIND_AUDIO;
-    audioTrack.codec = codec;
-    audioRtpTransceiverInit.direction = RTC_RTP_TRANSCEIVER_DIRECTION_SENDONLY;
-    STRCPY(audioTrack.streamId, APP_AUDIO_TRACK_STREAM_ID);
-    STRCPY(audioTrack.trackId, APP_AUDIO_TRACK_ID);
-    CHK_STATUS(
-        (addTransceiver(pStreamingSession->pPeerConnection, &audioTrack, &audioRtpTransceiverInit, &pStreamingSession->pAudioRtcRtpTransceiver)));
+    CHK_STATUS((peerConnectionOnDataChannel(pStreamingSession->pPeerConnection, (UINT64) pStreamingSession, onSessionDataChannel)));
+
+    // Add a SendRecv Transceiver of type video, the channels without the video of the media source have no video transceiver.
+    videoStatus = queryMediaVideoCap(pAppConfiguration->pMediaContext, &codec);
+    CHK(videoStatus == STATUS_SUCCESS || videoStatus == STATUS_MEDIA_NOT_EXISTED, videoStatus);
+    if (videoStatus == STATUS_SUCCESS) {
+        CHK_STATUS((addSupportedCodec(pStreamingSession->pPeerConnection, codec)));
+        videoTrack.kind = MEDIA_STREAM_TRACK_KIND_VIDEO;
+        videoTrack.codec = codec;
+        videoRtpTransceiverInit.direction = RTC_RTP_TRANSCEIVER_DIRECTION_SENDONLY;
+        STRCPY(videoTrack.streamId, APP_VIDEO_TRACK_STREAM_ID);
+        STRCPY(videoTrack.trackId, APP_VIDEO_TRACK_ID);
+        CHK_STATUS(
+            (addTransceiver(pStreamingSession->pPeerConnection, &videoTrack, &videoRtpTransceiverInit, &pStreamingSession->pVideoRtcRtpTransceiver)));
+
+        CHK_STATUS(
+            (transceiverOnBandwidthEstimation(pStreamingSession->pVideoRtcRtpTransceiver, (UINT64) pStreamingSession, onBandwidthEstimationHandler)));
+    }
 
-    CHK_STATUS(
-        (transceiverOnBandwidthEstimation(pStreamingSession->pAudioRtcRtpTransceiver, (UINT64) pStreamingSession, onBandwidthEstimationHandler)));
+    // Add a SendRecv Transceiver of type audio, likewise.
+    audioStatus = queryMediaAudioCap(pAppConfiguration->pMediaContext, &codec);
+    CHK(audioStatus == STATUS_SUCCESS || audioStatus == STATUS_MEDIA_NOT_EXISTED, audioStatus);
+    if (audioStatus == STATUS_SUCCESS) {
+        CHK_STATUS((addSupportedCodec(pStreamingSession->pPeerConnection, codec)));
+        audioTrack.kind = MEDIA_STREAM_TRACK_KIND_AUDIO;
+        audioTrack.codec = codec;
+        audioRtpTransceiverInit.direction = RTC_RTP_TRANSCEIVER_DIRECTION_SENDONLY;
+        STRCPY(audioTrack.streamId, APP_AUDIO_TRACK_STREAM_ID);
+        STRCPY(audioTrack.trackId, APP_AUDIO_TRACK_ID);
+        CHK_STATUS(
+            (addTransceiver(pStreamingSession->pPeerConnection, &audioTrack, &audioRtpTransceiverInit, &pStreamingSession->pAudioRtcRtpTransceiver)));
+
+        CHK_STATUS(
+            (transceiverOnBandwidthEstimation(pStreamingSession->pAudioRtcRtpTransceiver, (UINT64) pStreamingSession, onBandwidthEstimationHandler)));
+    }
+    CHK(videoStatus == STATUS_SUCCESS || audioStatus == STATUS_SUCCESS, STATUS_MEDIA_NOT_EXISTED);
     // twcc bandwidth estimation
     CHK_STATUS((peerConnectionOnSenderBandwidthEstimation(pStreamingSession->pPeerConnection, (UINT64) pStreamingSession,
                                                           onSenderBandwidthEstimationHandler)));
+    if (pAppConfiguration->pAppPacer != NULL) {
+        CHK_STATUS((addAppPacerFlow(pAppConfiguration->pAppPacer, writeStreamingSessionFrame, pStreamingSession, &pStreamingSession->pPacerFlow)));
+    }
 
 CleanUp:
 
+    setAppMemorySession(prevMemorySession);
     if (STATUS_FAILED(retStatus) && pStreamingSession != NULL) {
         freeStreamingSession(&pStreamingSession);
         pStreamingSession = NULL;
+    } else if (STATUS_FAILED(retStatus)) {
+        closeAppMemorySession(memorySessionId);
     }
 
     *ppStreamingSession = pStreamingSession;
@@ -685,17 +1617,20 @@ STATUS freeStreamingSession(PStreamingSession* ppStreamingSession)
     // De-initialize the session stats timer if there are no active sessions
     // NOTE: we need to perform this under the lock which might be acquired by
     // the running thread but it's OK as it's re-entrant
-    MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
+    APP_MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
     if (pAppConfiguration->iceCandidatePairStatsTimerId != MAX_UINT32 && pAppConfiguration->streamingSessionCount == 0) {
         CHK_LOG_ERR(
             (appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->iceCandidatePairStatsTimerId, (UINT64) pAppConfiguration)));
         pAppConfiguration->iceCandidatePairStatsTimerId = MAX_UINT32;
     }
-    MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+    if (pAppConfiguration->dataChannelTimerId != MAX_UINT32 && pAppConfiguration->streamingSessionCount == 0) {
+        CHK_LOG_ERR((appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->dataChannelTimerId, (UINT64) pAppConfiguration)));
+        pAppConfiguration->dataChannelTimerId = MAX_UINT32;
+    }
+    APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
 
-    CHK_LOG_ERR((closePeerConnection(pStreamingSession->pPeerConnection)));
-    CHK_LOG_ERR((freePeerConnection(&pStreamingSession->pPeerConnection)));
-    MEMFREE(pStreamingSession);
+    // the stats snapshots may still hold the session, the last reference frees it.
+    releaseStreamingSession(pStreamingSession);
 
 CleanUp:
 
@@ -704,13 +1639,66 @@ CleanUp:
     return retStatus;
 }
 
+STATUS getStreamingSessionStats(PStreamingSession pStreamingSession, PAppSessionStats pStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    SIZE_T generation;
+
+    CHK((pStreamingSession != NULL) && (pStats != NULL), STATUS_APP_COMMON_NULL_ARG);
+    // The writer refills the buffer of the previous generation once it publishes the next one, so the copy is only
+    // whole if the generation does not move while it is taken.
+    do {
+        generation = ATOMIC_LOAD(&pStreamingSession->statsGeneration);
+        *pStats = pStreamingSession->stats[generation % ARRAY_SIZE(pStreamingSession->stats)];
+        APP_STATS_FENCE();
+    } while (ATOMIC_LOAD(&pStreamingSession->statsGeneration) != generation);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS sendAppSessionsData(PAppConfiguration pAppConfiguration, UINT32 size, AppDataChannelWriter writer, PVOID udata)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PStreamingSession sessions[APP_MAX_CONCURRENT_STREAMING_SESSION];
+    PAppDataChannel pAppDataChannel;
+    UINT32 i, sessionCount = 0;
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_SESSION);
+    UINT32 prevMemorySession = setAppMemorySession(APP_MEMORY_NO_SESSION);
+
+    CHK(pAppConfiguration != NULL && writer != NULL, STATUS_APP_COMMON_NULL_ARG);
+
+    sessionCount = snapshotStreamingSessions(pAppConfiguration, sessions);
+    for (i = 0; i < sessionCount; ++i) {
+        pAppDataChannel = sessions[i]->pAppDataChannel;
+        if (pAppDataChannel == NULL || ATOMIC_LOAD_BOOL(&sessions[i]->terminateFlag)) {
+            continue;
+        }
+        setAppMemorySession(sessions[i]->memorySessionId);
+        // A slow viewer only loses its own messages, the data channel timer sends the batches.
+        if (STATUS_FAILED(writeAppDataChannelMessage(pAppDataChannel, size, writer, udata))) {
+            DLOGV("The data channel of %s skips the message", sessions[i]->peerId);
+        }
+    }
+
+CleanUp:
+
+    for (i = 0; i < sessionCount; ++i) {
+        releaseStreamingSession(sessions[i]);
+    }
+    setAppMemorySession(prevMemorySession);
+    setAppMemoryTag(prevTag);
+    return retStatus;
+}
+
 static STATUS gatherIceServerStats(PStreamingSession pStreamingSession)
 {
     ENTERS();
     STATUS retStatus = STATUS_SUCCESS;
     UINT32 j = 0;
 
-    for (; j < pStreamingSession->pAppConfiguration->iceUriCount; j++) {
+    for (; j < pStreamingSession->iceUriCount; j++) {
         CHK_STATUS((logIceServerStats(pStreamingSession->pPeerConnection, j)));
     }
 CleanUp:
@@ -718,37 +1706,133 @@ CleanUp:
     return retStatus;
 }
 
+/**
+ * @brief start the recorder configured by the environment, the codecs of the tracks are the ones of the media source.
+ *
+ * @param[in] pAppConfiguration the context of the app.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+static STATUS initAppRecorder(PAppConfiguration pAppConfiguration)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    AppRecorderConfig config;
+    PCHAR pValue = GETENV(APP_RECORDER_DIR);
+    UINT32 value;
+    STATUS videoStatus, audioStatus;
+
+    MEMSET(&config, 0x00, SIZEOF(AppRecorderConfig));
+    CHK(pValue != NULL && STRLEN(pValue) <= MAX_PATH_LEN, STATUS_APP_RECORDER_INVALID_ARG);
+    STRNCPY(config.directory, pValue, MAX_PATH_LEN);
+    // The duration is in seconds and the size in megabytes, 0 turns the rotation off.
+    config.segmentDuration = APP_RECORDER_DEFAULT_DURATION;
+    if ((pValue = GETENV(APP_RECORDER_SEGMENT_DURATION)) != NULL) {
+        CHK(STRTOUI32(pValue, NULL, 10, &value) == STATUS_SUCCESS, STATUS_APP_RECORDER_INVALID_ARG);
+        config.segmentDuration = (UINT64) value * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    }
+    config.segmentSize = APP_RECORDER_DEFAULT_SIZE;
+    if ((pValue = GETENV(APP_RECORDER_SEGMENT_SIZE)) != NULL) {
+        CHK(STRTOUI32(pValue, NULL, 10, &value) == STATUS_SUCCESS, STATUS_APP_RECORDER_INVALID_ARG);
+        config.segmentSize = (UINT64) value * 1024 * 1024;
+    }
+    config.directIo = GETENV(APP_RECORDER_DIRECT_IO) != NULL;
+    config.preallocate = GETENV(APP_RECORDER_PREALLOCATE) != NULL;
+
+    CHK_STATUS((isMediaSourceReady(pAppConfiguration->pMediaContext)));
+    // A channel with one track of the media source records it alone.
+    videoStatus = queryMediaVideoCap(pAppConfiguration->pMediaContext, &config.videoCodec);
+    CHK(videoStatus == STATUS_SUCCESS || videoStatus == STATUS_MEDIA_NOT_EXISTED, videoStatus);
+    audioStatus = queryMediaAudioCap(pAppConfiguration->pMediaContext, &config.audioCodec);
+    CHK(audioStatus == STATUS_SUCCESS || audioStatus == STATUS_MEDIA_NOT_EXISTED, audioStatus);
+    CHK(videoStatus == STATUS_SUCCESS || audioStatus == STATUS_SUCCESS, STATUS_MEDIA_NOT_EXISTED);
+    config.audioOnly = videoStatus == STATUS_MEDIA_NOT_EXISTED;
+    config.videoOnly = audioStatus == STATUS_MEDIA_NOT_EXISTED;
+    CHK_STATUS((createAppRecorder(&config, &pAppConfiguration->pAppRecorder)));
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        DLOGW("Failed to start the recorder(0x%08x), the recording is disabled", retStatus);
+    }
+    return retStatus;
+}
+
+/**
+ * @brief start the pacer of the sessions, the rate is in percent of the send budget of each session.
+ *
+ * @param[in] pAppConfiguration the context of the app.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+static STATUS initAppPacer(PAppConfiguration pAppConfiguration)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pValue = GETENV(APP_PACER_RATE);
+    UINT32 value;
+
+    CHK(pValue != NULL && STRTOUI32(pValue, NULL, 10, &value) == STATUS_SUCCESS, STATUS_APP_PACER_INVALID_ARG);
+    CHK_STATUS((createAppPacer(value, &pAppConfiguration->pAppPacer)));
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        DLOGW("Failed to start the pacer(0x%08x), the sessions write the frames on the media thread", retStatus);
+    }
+    return retStatus;
+}
+
 STATUS initApp(BOOL trickleIce, BOOL useTurn, PAppConfiguration* ppAppConfiguration)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PAppConfiguration pAppConfiguration = NULL;
     PAppSignaling pAppSignaling = NULL;
-    PCHAR pChannel = NULL;
+    PCHAR pChannel = NULL, pValue;
+    UINT32 i, probeInterval, replayDuration;
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_APP);
 
     SET_LOGGER_LOG_LEVEL(getLogLevel());
     signal(SIGINT, sigIntHandler);
+#ifdef APP_LOCK_PROFILING
+    signal(SIGUSR1, sigUsr1Handler);
+#endif
+    signal(SIGUSR2, sigUsr2Handler);
 
     CHK(ppAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG);
     CHK((pChannel = GETENV(APP_WEBRTC_CHANNEL)) != NULL, STATUS_APP_COMMON_CHANNEL_NAME);
     CHK(NULL != (pAppConfiguration = (PAppConfiguration) MEMCALLOC(1, SIZEOF(AppConfiguration))), STATUS_APP_COMMON_NOT_ENOUGH_MEMORY);
+    CHK_STATUS((initAppTrace(GETENV(APP_TRACE_FILE))));
 
     pAppSignaling = &pAppConfiguration->appSignaling;
     pAppSignaling->signalingClientHandle = INVALID_SIGNALING_CLIENT_HANDLE_VALUE;
     pAppConfiguration->mediaSenderTid = INVALID_TID_VALUE;
     pAppConfiguration->timerQueueHandle = INVALID_TIMER_QUEUE_HANDLE_VALUE;
     pAppConfiguration->iceCandidatePairStatsTimerId = MAX_UINT32;
-    pAppConfiguration->pregenerateCertTimerId = MAX_UINT32;
+    pAppConfiguration->turnProbeTimerId = MAX_UINT32;
+    pAppConfiguration->metricsTimerId = MAX_UINT32;
+    pAppConfiguration->probeTimerId = MAX_UINT32;
+    pAppConfiguration->replayTimerId = MAX_UINT32;
+    pAppConfiguration->dataChannelTimerId = MAX_UINT32;
 
     DLOGD("initializing the app with channel(%s)", pChannel);
 
     setupFileLogging(&pAppConfiguration->enableFileLogging);
     CHK_STATUS((createCredential(&pAppConfiguration->appCredential)));
+    CHK_STATUS((initAppInterfaceFilter(&pAppConfiguration->interfaceFilter)));
 
     pAppConfiguration->appConfigurationObjLock = MUTEX_CREATE(TRUE);
     CHK(IS_VALID_MUTEX_VALUE(pAppConfiguration->appConfigurationObjLock), STATUS_APP_COMMON_INVALID_MUTEX);
     pAppConfiguration->cvar = CVAR_CREATE();
     pAppConfiguration->streamingSessionListReadLock = MUTEX_CREATE(FALSE);
     CHK(IS_VALID_MUTEX_VALUE(pAppConfiguration->streamingSessionListReadLock), STATUS_APP_COMMON_INVALID_MUTEX);
+    CHK_STATUS((createAppMetricsRegistry(pChannel, &pAppConfiguration->pMetricsRegistry)));
+    registerAppTrackMetrics(pAppConfiguration->pMetricsRegistry, "video", &pAppConfiguration->videoMetrics);
+    registerAppTrackMetrics(pAppConfiguration->pMetricsRegistry, "audio", &pAppConfiguration->audioMetrics);
+    for (i = 0; i < APP_SESSION_EVENT_COUNT; i++) {
+        pAppConfiguration->setupMetricIds[i] = MAX_UINT32;
+        registerAppMetric(pAppConfiguration->pMetricsRegistry, "webrtc_app_session_setup_seconds",
+                          "The latency of the session setup events since the offer.", APP_METRIC_TYPE_SUMMARY, "event", gAppSessionEventNames[i],
+                          NULL, 0, &pAppConfiguration->setupMetricIds[i]);
+    }
     CHK(appTimerQueueCreate(&pAppConfiguration->timerQueueHandle) == STATUS_SUCCESS, STATUS_APP_COMMON_TIMER);
 
     pAppConfiguration->trickleIce = trickleIce;
@@ -774,40 +1858,86 @@ STATUS initApp(BOOL trickleIce, BOOL useTurn, PAppConfiguration* ppAppConfigurat
     pAppSignaling->clientInfo.cacheFilePath = NULL; // Use the default path
     STRCPY(pAppSignaling->clientInfo.clientId, APP_MASTER_CLIENT_ID);
 
+    setAppMemoryTag(APP_MEMORY_TAG_SIGNALING);
     CHK_STATUS((initAppSignaling(pAppSignaling, onSignalingMessageReceived, onSignalingClientStateChanged, onSignalingClientError,
                                  (UINT64) pAppConfiguration, useTurn)));
+    setAppMemoryTag(APP_MEMORY_TAG_APP);
+
+    if (useTurn && pAppSignaling->turnProbeInterval != 0 &&
+        STATUS_FAILED(appTimeQueueAdd(pAppConfiguration->timerQueueHandle, pAppSignaling->turnProbeInterval, pAppSignaling->turnProbeInterval,
+                                      probeTurnServersCallback, (UINT64) pAppConfiguration, &pAppConfiguration->turnProbeTimerId))) {
+        DLOGW("Failed to add probeTurnServersCallback to the timer queue, the turn servers are not ranked");
+    }
+
+    // The exporter is opt-in, the metrics are still recorded without it.
+    if (GETENV(APP_METRICS_ENDPOINT) != NULL &&
+        STATUS_SUCCEEDED(startAppMetricsExporter(pAppConfiguration->pMetricsRegistry, GETENV(APP_METRICS_ENDPOINT))) &&
+        STATUS_FAILED(appTimeQueueAdd(pAppConfiguration->timerQueueHandle, APP_METRICS_COLLECT_PERIOD, APP_METRICS_COLLECT_PERIOD,
+                                      collectAppMetricsCallback, (UINT64) pAppConfiguration, &pAppConfiguration->metricsTimerId))) {
+        DLOGW("Failed to add collectAppMetricsCallback to the timer queue, the signaling metrics are not exported");
+    }
+
+    // The viewers may always ping the gateway, the gateway pings them only with an interval in seconds.
+    if ((pValue = GETENV(APP_DATA_CHANNEL_PROBE_INTERVAL)) != NULL) {
+        if (STRTOUI32(pValue, NULL, 10, &probeInterval) != STATUS_SUCCESS || probeInterval == 0) {
+            DLOGW("Invalid interval of the probe(%s), the viewers are not pinged", pValue);
+        } else if (STATUS_FAILED(appTimeQueueAdd(pAppConfiguration->timerQueueHandle, (UINT64) probeInterval * HUNDREDS_OF_NANOS_IN_A_SECOND,
+                                                 (UINT64) probeInterval * HUNDREDS_OF_NANOS_IN_A_SECOND, probeAppSessionsCallback,
+                                                 (UINT64) pAppConfiguration, &pAppConfiguration->probeTimerId))) {
+            DLOGW("Failed to add probeAppSessionsCallback to the timer queue, the viewers are not pinged");
+        }
+    }
+
+    // The replay keeps the frames of the last duration in seconds, it is off without one.
+    if ((pValue = GETENV(APP_REPLAY_DURATION)) != NULL) {
+        if (STRTOUI32(pValue, NULL, 10, &replayDuration) != STATUS_SUCCESS || replayDuration == 0) {
+            DLOGW("Invalid duration of the replay(%s), the replay is disabled", pValue);
+        } else if (STATUS_FAILED(createAppReplay(APP_REPLAY_CAPACITY, (UINT64) replayDuration * HUNDREDS_OF_NANOS_IN_A_SECOND,
+                                                 &pAppConfiguration->pAppReplay))) {
+            DLOGW("Failed to set up the replay, the replay is disabled");
+        }
+    }
 
     ATOMIC_STORE_BOOL(&pAppConfiguration->sigInt, FALSE);
     ATOMIC_STORE_BOOL(&pAppConfiguration->mediaThreadStarted, FALSE);
     ATOMIC_STORE_BOOL(&pAppConfiguration->terminateApp, FALSE);
     ATOMIC_STORE_BOOL(&pAppConfiguration->restartSignalingClient, FALSE);
     ATOMIC_STORE_BOOL(&pAppConfiguration->peerConnectionConnected, FALSE);
-
-    pAppConfiguration->iceUriCount = 0;
+    ATOMIC_STORE_BOOL(&pAppConfiguration->dumpTrace, FALSE);
+    ATOMIC_STORE_BOOL(&pAppConfiguration->replayTimerArmed, FALSE);
 
     CHK_STATUS((createConnectionMsqQ(&pAppConfiguration->pRemotePeerPendingSignalingMessages)));
     CHK_STATUS(
         (appHashTableCreateWithParams(APP_HASH_TABLE_BUCKET_COUNT, APP_HASH_TABLE_BUCKET_LENGTH, &pAppConfiguration->pRemoteRtcPeerConnections)));
 
     // the initialization of media source.
+    setAppMemoryTag(APP_MEMORY_TAG_MEDIA);
     CHK_STATUS((initMediaSource(&pAppConfiguration->pMediaContext)));
     CHK_STATUS((linkMeidaSinkHook(pAppConfiguration->pMediaContext, onMediaSinkHook, pAppConfiguration)));
     CHK_STATUS((linkMeidaEosHook(pAppConfiguration->pMediaContext, onMediaEosHook, pAppConfiguration)));
     pAppConfiguration->mediaSource = runMediaSource;
     DLOGD("The intialization of the media source is completed successfully");
+    if (GETENV(APP_RECORDER_DIR) != NULL) {
+        initAppRecorder(pAppConfiguration);
+    }
+    if (GETENV(APP_PACER_RATE) != NULL) {
+        initAppPacer(pAppConfiguration);
+    }
 
     // Initalize KVS WebRTC. This must be done before anything else, and must only be done once.
+    setAppMemoryTag(APP_MEMORY_TAG_SDK);
     CHK_STATUS((initWebRtc(pAppConfiguration)));
     DLOGD("The initialization of WebRTC  is completed successfully");
+    setAppMemoryTag(APP_MEMORY_TAG_APP);
     gAppConfiguration = pAppConfiguration;
 
-    // Start the cert pre-gen timer callback
+    // Start the cert pre-gen worker
     if (APP_PRE_GENERATE_CERT) {
-        CHK_LOG_ERR((retStatus = appTimeQueueAdd(pAppConfiguration->timerQueueHandle, 0, APP_PRE_GENERATE_CERT_PERIOD, pregenerateCertTimerCallback,
-                                                 (UINT64) pAppConfiguration, &pAppConfiguration->pregenerateCertTimerId)));
+        CHK_STATUS((startCertGenerationWorker(&pAppConfiguration->appCredential)));
     }
 CleanUp:
 
+    setAppMemoryTag(prevTag);
     if (STATUS_FAILED(retStatus) && pAppConfiguration != NULL) {
         freeApp(&pAppConfiguration);
     }
@@ -822,6 +1952,11 @@ CleanUp:
 STATUS runApp(PAppConfiguration pAppConfiguration)
 {
     STATUS retStatus = STATUS_SUCCESS;
+
+    // The recording starts with the app, the media of the viewers starts with the first offer.
+    if (pAppConfiguration->pAppRecorder != NULL && !ATOMIC_EXCHANGE_BOOL(&pAppConfiguration->mediaThreadStarted, TRUE)) {
+        THREAD_CREATE(&pAppConfiguration->mediaSenderTid, mediaSenderRoutine, (PVOID) pAppConfiguration);
+    }
     retStatus = connectAppSignaling(&pAppConfiguration->appSignaling);
     if (retStatus != STATUS_SUCCESS) {
         DLOGD("operation returned status code: 0x%08x ", retStatus);
@@ -836,7 +1971,8 @@ STATUS freeApp(PAppConfiguration* ppAppConfiguration)
     STATUS retStatus = STATUS_SUCCESS;
     PAppConfiguration pAppConfiguration = NULL;
     UINT32 i;
-    BOOL locked = FALSE;
+    SIZE_T replayTimerId;
+    BOOL locked = FALSE, listLocked = FALSE;
 
     CHK(ppAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG);
     pAppConfiguration = *ppAppConfiguration;
@@ -849,6 +1985,39 @@ STATUS freeApp(PAppConfiguration* ppAppConfiguration)
         THREAD_JOIN(pAppConfiguration->mediaSenderTid, NULL);
     }
 
+    // The stats timer snapshots the sessions under the list locks, so stop it before the sessions and the locks are freed.
+    if (IS_VALID_TIMER_QUEUE_HANDLE(pAppConfiguration->timerQueueHandle) && pAppConfiguration->iceCandidatePairStatsTimerId != MAX_UINT32) {
+        retStatus =
+            appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->iceCandidatePairStatsTimerId, (UINT64) pAppConfiguration);
+        if (STATUS_FAILED(retStatus)) {
+            DLOGE("Failed to cancel stats timer with: 0x%08x", retStatus);
+        }
+        pAppConfiguration->iceCandidatePairStatsTimerId = MAX_UINT32;
+    }
+
+    // The probe uses the signaling context and the session list, so stop it before both are released.
+    if (IS_VALID_TIMER_QUEUE_HANDLE(pAppConfiguration->timerQueueHandle) && pAppConfiguration->turnProbeTimerId != MAX_UINT32) {
+        CHK_LOG_ERR((appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->turnProbeTimerId, (UINT64) pAppConfiguration)));
+        pAppConfiguration->turnProbeTimerId = MAX_UINT32;
+    }
+    if (IS_VALID_TIMER_QUEUE_HANDLE(pAppConfiguration->timerQueueHandle) && pAppConfiguration->metricsTimerId != MAX_UINT32) {
+        CHK_LOG_ERR((appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->metricsTimerId, (UINT64) pAppConfiguration)));
+        pAppConfiguration->metricsTimerId = MAX_UINT32;
+    }
+    if (IS_VALID_TIMER_QUEUE_HANDLE(pAppConfiguration->timerQueueHandle) && pAppConfiguration->probeTimerId != MAX_UINT32) {
+        CHK_LOG_ERR((appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->probeTimerId, (UINT64) pAppConfiguration)));
+        pAppConfiguration->probeTimerId = MAX_UINT32;
+    }
+    // The replay timer clears its id when it stops, so the id is taken atomically from it.
+    replayTimerId = ATOMIC_EXCHANGE(&pAppConfiguration->replayTimerId, (SIZE_T) MAX_UINT32);
+    if (IS_VALID_TIMER_QUEUE_HANDLE(pAppConfiguration->timerQueueHandle) && replayTimerId != MAX_UINT32) {
+        CHK_LOG_ERR((appTimerQueueCancel(pAppConfiguration->timerQueueHandle, (UINT32) replayTimerId, (UINT64) pAppConfiguration)));
+    }
+    if (IS_VALID_TIMER_QUEUE_HANDLE(pAppConfiguration->timerQueueHandle) && pAppConfiguration->dataChannelTimerId != MAX_UINT32) {
+        CHK_LOG_ERR((appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->dataChannelTimerId, (UINT64) pAppConfiguration)));
+        pAppConfiguration->dataChannelTimerId = MAX_UINT32;
+    }
+
     freeAppSignaling(&pAppConfiguration->appSignaling);
     freeConnectionMsgQ(&pAppConfiguration->pRemotePeerPendingSignalingMessages);
 
@@ -856,10 +2025,15 @@ STATUS freeApp(PAppConfiguration* ppAppConfiguration)
     appHashTableFree(pAppConfiguration->pRemoteRtcPeerConnections);
 
     if (IS_VALID_MUTEX_VALUE(pAppConfiguration->appConfigurationObjLock)) {
-        MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
+        APP_MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
         locked = TRUE;
     }
 
+    // Empty the list under its lock, so the stats snapshots do not take the sessions being freed.
+    if (IS_VALID_MUTEX_VALUE(pAppConfiguration->streamingSessionListReadLock)) {
+        APP_MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
+        listLocked = TRUE;
+    }
     for (i = 0; i < pAppConfiguration->streamingSessionCount; ++i) {
         retStatus = gatherIceServerStats(pAppConfiguration->streamingSessionList[i]);
         if (STATUS_FAILED(retStatus)) {
@@ -867,17 +2041,23 @@ STATUS freeApp(PAppConfiguration* ppAppConfiguration)
         }
         freeStreamingSession(&pAppConfiguration->streamingSessionList[i]);
     }
+    pAppConfiguration->streamingSessionCount = 0;
+    if (listLocked) {
+        APP_MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
+    }
 
     if (locked) {
-        MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+        APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
     }
     deinitWebRtc(pAppConfiguration);
     detroyMediaSource(&pAppConfiguration->pMediaContext);
+    freeAppReplay(&pAppConfiguration->pAppReplay);
+    freeAppRecorder(&pAppConfiguration->pAppRecorder);
 
     if (IS_VALID_CVAR_VALUE(pAppConfiguration->cvar) && IS_VALID_MUTEX_VALUE(pAppConfiguration->appConfigurationObjLock)) {
         CVAR_BROADCAST(pAppConfiguration->cvar);
-        MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
-        MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+        APP_MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
+        APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
     }
 
     if (IS_VALID_MUTEX_VALUE(pAppConfiguration->appConfigurationObjLock)) {
@@ -893,32 +2073,18 @@ STATUS freeApp(PAppConfiguration* ppAppConfiguration)
     }
 
     if (IS_VALID_TIMER_QUEUE_HANDLE(pAppConfiguration->timerQueueHandle)) {
-        if (pAppConfiguration->iceCandidatePairStatsTimerId != MAX_UINT32) {
-            retStatus =
-                appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->iceCandidatePairStatsTimerId, (UINT64) pAppConfiguration);
-            if (STATUS_FAILED(retStatus)) {
-                DLOGE("Failed to cancel stats timer with: 0x%08x", retStatus);
-            }
-            pAppConfiguration->iceCandidatePairStatsTimerId = MAX_UINT32;
-        }
-
-        if (pAppConfiguration->pregenerateCertTimerId != MAX_UINT32) {
-            retStatus =
-                appTimerQueueCancel(pAppConfiguration->timerQueueHandle, pAppConfiguration->pregenerateCertTimerId, (UINT64) pAppConfiguration);
-            if (STATUS_FAILED(retStatus)) {
-                DLOGE("Failed to cancel certificate pre-generation timer with: 0x%08x", retStatus);
-            }
-            pAppConfiguration->pregenerateCertTimerId = MAX_UINT32;
-        }
-
         appTimerQueueFree(&pAppConfiguration->timerQueueHandle);
     }
+    // the last references of the sessions are gone with the timers.
+    freeAppPacer(&pAppConfiguration->pAppPacer);
 
     destroyCredential(&pAppConfiguration->appCredential);
+    freeAppMetricsRegistry(&pAppConfiguration->pMetricsRegistry);
 
     if (pAppConfiguration->enableFileLogging) {
         closeFileLogging();
     }
+    deinitAppTrace();
 
     MEMFREE(*ppAppConfiguration);
     *ppAppConfiguration = NULL;
@@ -938,18 +2104,20 @@ STATUS pollApp(PAppConfiguration pAppConfiguration)
     BOOL locked = FALSE, peerConnectionFound = FALSE;
 
     CHK(pAppConfiguration != NULL, STATUS_APP_COMMON_NULL_ARG);
+    setAppTraceThreadName("main");
 
     while (!ATOMIC_LOAD_BOOL(&pAppConfiguration->sigInt)) {
         // Keep the main set of operations interlocked until cvar wait which would atomically unlock
-        MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
+        APP_MUTEX_LOCK(pAppConfiguration->appConfigurationObjLock);
         locked = TRUE;
+        appTraceBegin("pollApp");
 
         // scan and cleanup terminated streaming session
         for (i = 0; i < pAppConfiguration->streamingSessionCount; ++i) {
             if (ATOMIC_LOAD_BOOL(&pAppConfiguration->streamingSessionList[i]->terminateFlag)) {
                 pStreamingSession = pAppConfiguration->streamingSessionList[i];
 
-                MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
+                APP_MUTEX_LOCK(pAppConfiguration->streamingSessionListReadLock);
 
                 // swap with last element and decrement count
                 pAppConfiguration->streamingSessionCount--;
@@ -967,25 +2135,40 @@ STATUS pollApp(PAppConfiguration pAppConfiguration)
                 if (pAppConfiguration->streamingSessionCount == 0) {
                     shutdownMediaSource(pAppConfiguration->pMediaContext);
                 }
-                MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
+                APP_MUTEX_UNLOCK(pAppConfiguration->streamingSessionListReadLock);
 
                 freeStreamingSession(&pStreamingSession);
             }
         }
 
-        // Check if we need to re-create the signaling client on-the-fly
-        if (ATOMIC_LOAD_BOOL(&pAppConfiguration->restartSignalingClient) && STATUS_SUCCEEDED(restartAppSignaling(&pAppConfiguration->appSignaling))) {
+        // Hand the re-creation of the signaling client to its reconnect thread, so this loop never waits for the network.
+        if (ATOMIC_LOAD_BOOL(&pAppConfiguration->restartSignalingClient) &&
+            STATUS_SUCCEEDED(requestAppSignalingRestart(&pAppConfiguration->appSignaling))) {
             // Re-set the variable again
             ATOMIC_STORE_BOOL(&pAppConfiguration->restartSignalingClient, FALSE);
         }
-        CHK_STATUS((checkAppSignaling(&pAppConfiguration->appSignaling)));
+
+        // Without the exporter nobody collects the metrics, so only log the memory.
+        if (pAppConfiguration->metricsTimerId == MAX_UINT32) {
+            reportAppMemory(NULL);
+        }
 
         // Check if any lingering pending message queues
         CHK_STATUS((removeExpiredPendingMsgQ(pAppConfiguration->pRemotePeerPendingSignalingMessages, APP_PENDING_MESSAGE_CLEANUP_DURATION)));
+        appTraceEnd("pollApp");
         // periodically wake up and clean up terminated streaming session
-        CVAR_WAIT(pAppConfiguration->cvar, pAppConfiguration->appConfigurationObjLock, APP_CLEANUP_WAIT_PERIOD);
-        MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+        APP_CVAR_WAIT(pAppConfiguration->cvar, pAppConfiguration->appConfigurationObjLock, APP_CLEANUP_WAIT_PERIOD);
+        APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
         locked = FALSE;
+
+        // The dumps write the files and the logs without the lock, so the signaling callbacks do not wait for the disk.
+        if (ATOMIC_EXCHANGE_BOOL(&pAppConfiguration->dumpLockProfile, FALSE)) {
+            dumpAppLockProfile();
+        }
+
+        if (ATOMIC_EXCHANGE_BOOL(&pAppConfiguration->dumpTrace, FALSE)) {
+            dumpAppTrace(NULL);
+        }
     }
 
 CleanUp:
@@ -993,7 +2176,7 @@ CleanUp:
     CHK_LOG_ERR((retStatus));
 
     if (locked) {
-        MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
+        APP_MUTEX_UNLOCK(pAppConfiguration->appConfigurationObjLock);
     }
 
     LEAVES();
@@ -16,6 +16,16 @@
 #include "AppCredential.h"
 #include "AppCredentialWrap.h"
 #include "AppQueueWrap.h"
+#include "AppMemory.h"
+#include "AppTrace.h"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
 
 static STATUS traverseDirectoryPEMFileScan(UINT64 userData, DIR_ENTRY_TYPES entryType, PCHAR fullPath, PCHAR fileName)
 {
@@ -61,29 +71,277 @@ CleanUp:
     return retStatus;
 }
 
+typedef struct {
+    UINT64 seq[APP_CERT_CACHE_MAX_FILES];
+    UINT32 count;
+    PCHAR pCertCacheDir;
+} CertCacheScan, *PCertCacheScan;
+
+static STATUS getCertCachePath(PAppCredential pAppCredential, UINT64 seq, PCHAR pPath)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(SNPRINTF(pPath, MAX_PATH_LEN + 1, "%s%c" APP_CERT_CACHE_FILE_PREFIX "%020" PRIu64 APP_CERT_CACHE_FILE_EXTENSION,
+                 pAppCredential->certCacheDir, FPATHSEPARATOR, seq) <= MAX_PATH_LEN,
+        STATUS_APP_CREDENTIAL_CERT_CACHE);
+
+CleanUp:
+    return retStatus;
+}
+
+/**
+ * @brief keep the sequence numbers of the cached certs in the same order as the pool. The caller needs to hold the generateCertLock.
+ */
+static VOID pushCertCacheSeq(PAppCredential pAppCredential, UINT64 seq)
+{
+    if (pAppCredential->certCacheRingCount < APP_CERT_POOL_MAX_DEPTH) {
+        pAppCredential->certCacheSeqRing[(pAppCredential->certCacheRingHead + pAppCredential->certCacheRingCount) % APP_CERT_POOL_MAX_DEPTH] = seq;
+        pAppCredential->certCacheRingCount++;
+    }
+}
+
+static UINT64 popCertCacheSeq(PAppCredential pAppCredential)
+{
+    UINT64 seq = 0;
+
+    if (pAppCredential->certCacheRingCount > 0) {
+        seq = pAppCredential->certCacheSeqRing[pAppCredential->certCacheRingHead];
+        pAppCredential->certCacheRingHead = (pAppCredential->certCacheRingHead + 1) % APP_CERT_POOL_MAX_DEPTH;
+        pAppCredential->certCacheRingCount--;
+    }
+    return seq;
+}
+
+static VOID removeCachedCert(PAppCredential pAppCredential, UINT64 seq)
+{
+    CHAR path[MAX_PATH_LEN + 1];
+
+    if (seq != 0 && getCertCachePath(pAppCredential, seq, path) == STATUS_SUCCESS && unlink(path) != 0 && errno != ENOENT) {
+        DLOGW("Failed to remove the cached cert %s, errno:%d", path, errno);
+    }
+}
+
+static STATUS traverseDirectoryCertCacheScan(UINT64 userData, DIR_ENTRY_TYPES entryType, PCHAR fullPath, PCHAR fileName)
+{
+    PCertCacheScan pScan = (PCertCacheScan) userData;
+    UINT32 prefixLen = STRLEN(APP_CERT_CACHE_FILE_PREFIX), extLen = STRLEN(APP_CERT_CACHE_FILE_EXTENSION);
+    UINT32 fileNameLen = STRLEN(fileName);
+    UINT64 seq;
+
+    if (entryType != DIR_ENTRY_TYPE_FILE || fileNameLen <= prefixLen + extLen || STRNCMP(fileName, APP_CERT_CACHE_FILE_PREFIX, prefixLen) != 0) {
+        return STATUS_SUCCESS;
+    }
+
+    if (STRCMP(&fileName[fileNameLen - extLen], APP_CERT_CACHE_FILE_EXTENSION) != 0) {
+        // The leftover of an interrupted save.
+        unlink(fullPath);
+        return STATUS_SUCCESS;
+    }
+
+    if (STRTOUI64(&fileName[prefixLen], &fileName[fileNameLen - extLen], 10, &seq) != STATUS_SUCCESS || seq == 0) {
+        return STATUS_SUCCESS;
+    }
+
+    if (pScan->count < APP_CERT_CACHE_MAX_FILES) {
+        pScan->seq[pScan->count++] = seq;
+    } else {
+        unlink(fullPath);
+    }
+    return STATUS_SUCCESS;
+}
+
+/**
+ * @brief prepare the directory of the cert cache. The cache is per channel, so the processes of different channels never share a cert.
+ */
+static STATUS initCertCache(PAppCredential pAppCredential)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pCertCacheDir, pChannel, pValue;
+    struct stat dirStat;
+    UINT64 ttl;
+
+    pAppCredential->certCacheDir[0] = '\0';
+    pAppCredential->certCacheTtl = APP_CERT_CACHE_DEFAULT_TTL;
+    pAppCredential->certCacheSeq = 0;
+    pAppCredential->certCacheRingHead = 0;
+    pAppCredential->certCacheRingCount = 0;
+
+    CHK((pCertCacheDir = GETENV(APP_CERT_CACHE_DIR)) != NULL && pCertCacheDir[0] != '\0', retStatus);
+#ifndef KVS_USE_OPENSSL
+    DLOGW("The cert cache needs the openssl build of the sdk, it is disabled");
+    CHK(FALSE, retStatus);
+#endif
+    // The cache only holds the certs of the pool.
+    CHK(pAppCredential->certKeyType == APP_CERT_KEY_TYPE_ECDSA && pAppCredential->certPoolDepth != 0, retStatus);
+
+    if ((pValue = GETENV(APP_CERT_CACHE_TTL)) != NULL) {
+        if (STRTOUI64(pValue, NULL, 10, &ttl) == STATUS_SUCCESS && ttl != 0) {
+            pAppCredential->certCacheTtl = ttl;
+        } else {
+            DLOGW("Invalid ttl of the cert cache(%s), use the default ttl %u", pValue, APP_CERT_CACHE_DEFAULT_TTL);
+        }
+    }
+
+    CHK(mkdir(pCertCacheDir, S_IRWXU) == 0 || errno == EEXIST, STATUS_APP_CREDENTIAL_CERT_CACHE);
+    if ((pChannel = GETENV(APP_WEBRTC_CHANNEL)) != NULL) {
+        CHK(SNPRINTF(pAppCredential->certCacheDir, SIZEOF(pAppCredential->certCacheDir), "%s%c%s", pCertCacheDir, FPATHSEPARATOR, pChannel) <=
+                MAX_PATH_LEN,
+            STATUS_APP_CREDENTIAL_CERT_CACHE);
+        CHK(mkdir(pAppCredential->certCacheDir, S_IRWXU) == 0 || errno == EEXIST, STATUS_APP_CREDENTIAL_CERT_CACHE);
+    } else {
+        CHK(STRLEN(pCertCacheDir) <= MAX_PATH_LEN, STATUS_APP_CREDENTIAL_CERT_CACHE);
+        STRNCPY(pAppCredential->certCacheDir, pCertCacheDir, MAX_PATH_LEN);
+    }
+
+    // The private keys are in the cache, so only the owner can access it.
+    CHK(lstat(pAppCredential->certCacheDir, &dirStat) == 0 && S_ISDIR(dirStat.st_mode) && dirStat.st_uid == geteuid(),
+        STATUS_APP_CREDENTIAL_CERT_CACHE);
+    if ((dirStat.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+        CHK(chmod(pAppCredential->certCacheDir, S_IRWXU) == 0, STATUS_APP_CREDENTIAL_CERT_CACHE);
+    }
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        DLOGW("The cert cache is disabled, errno:%d", errno);
+        pAppCredential->certCacheDir[0] = '\0';
+    }
+
+    return retStatus;
+}
+
+/**
+ * @brief load the cached certs into the pool from the oldest one. The expired, unsafe or unreadable certs are removed.
+ */
+static STATUS loadCertCache(PAppCredential pAppCredential)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CertCacheScan scan;
+    CHAR path[MAX_PATH_LEN + 1];
+    struct stat fileStat;
+    PRtcCertificate pRtcCertificate = NULL;
+    UINT32 i, j, loadedCount = 0;
+    UINT64 seq, curTime = (UINT64) time(NULL);
+    BOOL valid;
+    APP_MEMORY_TAG prevTag;
+
+    CHK(pAppCredential->certCacheDir[0] != '\0', retStatus);
+
+    MEMSET(&scan, 0x00, SIZEOF(CertCacheScan));
+    CHK_STATUS((traverseDirectory(pAppCredential->certCacheDir, (UINT64) &scan, FALSE, traverseDirectoryCertCacheScan)));
+
+    // Sort by the sequence number, so the oldest cert is used first.
+    for (i = 1; i < scan.count; i++) {
+        seq = scan.seq[i];
+        for (j = i; j > 0 && scan.seq[j - 1] > seq; j--) {
+            scan.seq[j] = scan.seq[j - 1];
+        }
+        scan.seq[j] = seq;
+    }
+
+    prevTag = setAppMemoryTag(APP_MEMORY_TAG_CERTIFICATE);
+    MUTEX_LOCK(pAppCredential->generateCertLock);
+    for (i = 0; i < scan.count; i++) {
+        seq = scan.seq[i];
+        pAppCredential->certCacheSeq = MAX(pAppCredential->certCacheSeq, seq);
+        if (getCertCachePath(pAppCredential, seq, path) != STATUS_SUCCESS) {
+            continue;
+        }
+
+        valid = loadedCount < pAppCredential->certPoolDepth && lstat(path, &fileStat) == 0 && S_ISREG(fileStat.st_mode) &&
+            fileStat.st_uid == geteuid() && (fileStat.st_mode & (S_IRWXG | S_IRWXO)) == 0 && curTime >= (UINT64) fileStat.st_mtime &&
+            curTime - (UINT64) fileStat.st_mtime < pAppCredential->certCacheTtl &&
+            loadAppRtcCertificate(path, &pRtcCertificate) == STATUS_SUCCESS;
+
+        if (valid && appQueueEnqueue(pAppCredential->generatedCertificates, (UINT64) pRtcCertificate) == STATUS_SUCCESS) {
+            pushCertCacheSeq(pAppCredential, seq);
+            pAppCredential->certStats.cacheLoadedCount++;
+            loadedCount++;
+        } else {
+            if (pRtcCertificate != NULL) {
+                freeRtcCertificate(pRtcCertificate);
+            }
+            removeCachedCert(pAppCredential, seq);
+            pAppCredential->certStats.cacheEvictedCount++;
+        }
+        pRtcCertificate = NULL;
+    }
+    MUTEX_UNLOCK(pAppCredential->generateCertLock);
+    setAppMemoryTag(prevTag);
+
+    DLOGI("%u certs are loaded from the cert cache %s", loadedCount, pAppCredential->certCacheDir);
+
+CleanUp:
+
+    CHK_LOG_ERR((retStatus));
+    return retStatus;
+}
+
 STATUS generateCertRoutine(PAppCredential pAppCredential)
 {
     STATUS retStatus = STATUS_SUCCESS;
     BOOL locked = FALSE;
     UINT32 certCount;
+    UINT64 startTime, generationTime, seq = 0;
+    CHAR path[MAX_PATH_LEN + 1];
     PRtcCertificate pRtcCertificate = NULL;
+    PAppCertStats pCertStats;
+    APP_MEMORY_TAG prevTag;
 
+    appTraceBegin("generateCertRoutine");
     CHK(pAppCredential != NULL, STATUS_APP_CREDENTIAL_NULL_ARG);
+    pCertStats = &pAppCredential->certStats;
 
     MUTEX_LOCK(pAppCredential->generateCertLock);
     locked = TRUE;
 
     // Quick check if there is anything that needs to be done.
     CHK_STATUS((appQueueGetCount(pAppCredential->generatedCertificates, &certCount)));
-    CHK(certCount <= MAX_RTCCONFIGURATION_CERTIFICATES, retStatus);
+    CHK(certCount < pAppCredential->certPoolDepth && pAppCredential->certKeyType == APP_CERT_KEY_TYPE_ECDSA, retStatus);
+
+    if (pAppCredential->certCacheDir[0] != '\0') {
+        seq = ++pAppCredential->certCacheSeq;
+    }
+
+    // Generate the certificate with the keypair. The lock is released, so popGeneratedCert never waits for the keygen.
+    MUTEX_UNLOCK(pAppCredential->generateCertLock);
+    locked = FALSE;
+
+    startTime = GETTIME();
+    prevTag = setAppMemoryTag(APP_MEMORY_TAG_CERTIFICATE);
+    retStatus = createRtcCertificate(&pRtcCertificate);
+    setAppMemoryTag(prevTag);
+    generationTime = GETTIME() - startTime;
+
+    // Persist the cert, so it can warm up the pool after a restart.
+    if (STATUS_SUCCEEDED(retStatus) && seq != 0) {
+        if (getCertCachePath(pAppCredential, seq, path) != STATUS_SUCCESS || saveAppRtcCertificate(pRtcCertificate, path) != STATUS_SUCCESS) {
+            DLOGW("Failed to save the cert into the cert cache");
+            seq = 0;
+        }
+    }
+
+    MUTEX_LOCK(pAppCredential->generateCertLock);
+    locked = TRUE;
 
-    // Generate the certificate with the keypair
-    CHK(createRtcCertificate(&pRtcCertificate) == STATUS_SUCCESS, STATUS_APP_CREDENTIAL_CERT_CREATE);
+    if (STATUS_FAILED(retStatus)) {
+        pCertStats->failedCount++;
+    } else {
+        pCertStats->generatedCount++;
+        pCertStats->totalGenerationTime += generationTime;
+        pCertStats->maxGenerationTime = MAX(pCertStats->maxGenerationTime, generationTime);
+    }
+    CHK(retStatus == STATUS_SUCCESS, STATUS_APP_CREDENTIAL_CERT_CREATE);
 
     // Add to the stack queue
     CHK(appQueueEnqueue(pAppCredential->generatedCertificates, (UINT64) pRtcCertificate) == STATUS_SUCCESS, STATUS_APP_CREDENTIAL_CERT_STACK);
+    pushCertCacheSeq(pAppCredential, seq);
+    if (seq != 0) {
+        pCertStats->cacheSavedCount++;
+        seq = 0;
+    }
 
-    DLOGV("New certificate has been pre-generated and added to the queue");
+    DLOGV("New certificate has been pre-generated in %" PRIu64 " ms and added to the queue", generationTime / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
 
     // Reset it so it won't be freed on exit
     pRtcCertificate = NULL;
@@ -97,9 +355,14 @@ CleanUp:
         freeRtcCertificate(pRtcCertificate);
     }
 
+    if (seq != 0) {
+        removeCachedCert(pAppCredential, seq);
+    }
+
     if (locked) {
         MUTEX_UNLOCK(pAppCredential->generateCertLock);
     }
+    appTraceEnd("generateCertRoutine");
 
     return retStatus;
 }
@@ -124,9 +387,17 @@ STATUS popGeneratedCert(PAppCredential pAppCredential, PRtcCertificate* ppRtcCer
 
     if (retStatus == STATUS_NOT_FOUND) {
         retStatus = STATUS_SUCCESS;
+        pAppCredential->certStats.poolMisses++;
     } else {
         // Use the pre-generated cert and get rid of it to not reuse again
         pRtcCertificate = (PRtcCertificate) data;
+        pAppCredential->certStats.poolHits++;
+        // The cert is used once, so drop its cached copy.
+        removeCachedCert(pAppCredential, popCertCacheSeq(pAppCredential));
+        // Let the worker refill the pool.
+        if (IS_VALID_CVAR_VALUE(pAppCredential->generateCertCvar)) {
+            CVAR_SIGNAL(pAppCredential->generateCertCvar);
+        }
     }
 
     *ppRtcCertificate = pRtcCertificate;
@@ -140,6 +411,91 @@ CleanUp:
     return retStatus;
 }
 
+static PVOID generateCertWorkerRoutine(PVOID args)
+{
+    PAppCredential pAppCredential = (PAppCredential) args;
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 certCount = 0;
+
+#if defined(__linux__)
+    // The keygen is cpu-bound, so keep it behind the media, ice and signaling threads.
+    if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), APP_CERT_WORKER_NICE) != 0) {
+        DLOGW("Failed to lower the priority of the certificate worker, errno:%d", errno);
+    }
+#endif
+    setAppTraceThreadName("cert-worker");
+
+    while (!ATOMIC_LOAD_BOOL(&pAppCredential->terminateCertWorker)) {
+        retStatus = generateCertRoutine(pAppCredential);
+
+        MUTEX_LOCK(pAppCredential->generateCertLock);
+        if (STATUS_FAILED(retStatus)) {
+            DLOGW("Failed to pre-generate the certificate: 0x%08x", retStatus);
+            CVAR_WAIT(pAppCredential->generateCertCvar, pAppCredential->generateCertLock, APP_PRE_GENERATE_CERT_PERIOD);
+        } else {
+            // Sleep until a cert is consumed.
+            while (!ATOMIC_LOAD_BOOL(&pAppCredential->terminateCertWorker) &&
+                   STATUS_SUCCEEDED(appQueueGetCount(pAppCredential->generatedCertificates, &certCount)) &&
+                   certCount >= pAppCredential->certPoolDepth) {
+                CVAR_WAIT(pAppCredential->generateCertCvar, pAppCredential->generateCertLock, INFINITE_TIME_VALUE);
+            }
+        }
+        MUTEX_UNLOCK(pAppCredential->generateCertLock);
+    }
+
+    return NULL;
+}
+
+STATUS startCertGenerationWorker(PAppCredential pAppCredential)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pAppCredential != NULL, STATUS_APP_CREDENTIAL_NULL_ARG);
+    CHK(IS_VALID_MUTEX_VALUE(pAppCredential->generateCertLock), STATUS_APP_CREDENTIAL_INVALID_MUTEX);
+    CHK(IS_VALID_CVAR_VALUE(pAppCredential->generateCertCvar), STATUS_APP_CREDENTIAL_INVALID_CVAR);
+    CHK(pAppCredential->generateCertTid == INVALID_TID_VALUE, retStatus);
+
+    if (pAppCredential->certKeyType != APP_CERT_KEY_TYPE_ECDSA || pAppCredential->certPoolDepth == 0) {
+        DLOGI("The pool of certificates is disabled, certificates are generated on demand");
+        CHK(FALSE, retStatus);
+    }
+
+    ATOMIC_STORE_BOOL(&pAppCredential->terminateCertWorker, FALSE);
+    CHK(THREAD_CREATE(&pAppCredential->generateCertTid, generateCertWorkerRoutine, (PVOID) pAppCredential) == STATUS_SUCCESS,
+        STATUS_APP_CREDENTIAL_CERT_WORKER);
+    DLOGI("The certificate worker is started with the pool depth %u", pAppCredential->certPoolDepth);
+
+CleanUp:
+
+    CHK_LOG_ERR((retStatus));
+    return retStatus;
+}
+
+/**
+ * @brief load the depth of the cert pool and the key type from the environmental variables.
+ */
+static VOID loadCertPoolConfig(PAppCredential pAppCredential)
+{
+    PCHAR pValue;
+    UINT32 certPoolDepth;
+
+    pAppCredential->certPoolDepth = APP_CERT_POOL_DEFAULT_DEPTH;
+    pAppCredential->certKeyType = APP_CERT_KEY_TYPE_ECDSA;
+
+    if ((pValue = GETENV(APP_CERT_POOL_DEPTH)) != NULL) {
+        if (STRTOUI32(pValue, NULL, 10, &certPoolDepth) == STATUS_SUCCESS && certPoolDepth <= APP_CERT_POOL_MAX_DEPTH) {
+            pAppCredential->certPoolDepth = certPoolDepth;
+        } else {
+            DLOGW("Invalid depth of the cert pool(%s), use the default depth %u", pValue, APP_CERT_POOL_DEFAULT_DEPTH);
+        }
+    }
+
+    // The certs of the pool are generated by createRtcCertificate which creates the ECDSA P-256 keys.
+    if ((pValue = GETENV(APP_CERT_KEY_TYPE)) != NULL && STRCMPI(pValue, APP_CERT_KEY_TYPE_RSA_STRING) == 0) {
+        pAppCredential->certKeyType = APP_CERT_KEY_TYPE_RSA;
+    }
+}
+
 STATUS createCredential(PAppCredential pAppCredential)
 {
     STATUS retStatus = STATUS_SUCCESS;
@@ -152,6 +508,12 @@ STATUS createCredential(PAppCredential pAppCredential)
     pAppCredential->pCredentialProvider = NULL;
     pAppCredential->generateCertLock = INVALID_MUTEX_VALUE;
     pAppCredential->generatedCertificates = NULL;
+    pAppCredential->certCacheDir[0] = '\0';
+    pAppCredential->generateCertCvar = INVALID_CVAR_VALUE;
+    pAppCredential->generateCertTid = INVALID_TID_VALUE;
+    ATOMIC_STORE_BOOL(&pAppCredential->terminateCertWorker, FALSE);
+    MEMSET(&pAppCredential->certStats, 0, SIZEOF(AppCertStats));
+    loadCertPoolConfig(pAppCredential);
 
     CHK_STATUS((searchSslCert(pAppCredential)));
 
@@ -178,8 +540,15 @@ STATUS createCredential(PAppCredential pAppCredential)
 
     pAppCredential->generateCertLock = MUTEX_CREATE(FALSE);
     CHK(IS_VALID_MUTEX_VALUE(pAppCredential->generateCertLock), STATUS_APP_CREDENTIAL_INVALID_MUTEX);
+    pAppCredential->generateCertCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pAppCredential->generateCertCvar), STATUS_APP_CREDENTIAL_INVALID_CVAR);
     CHK(appQueueCreate(&pAppCredential->generatedCertificates) == STATUS_SUCCESS, STATUS_APP_CREDENTIAL_PREGENERATED_CERT_QUEUE);
 
+    // The failure of the cert cache is not fatal, the pool is filled by the worker.
+    if (STATUS_SUCCEEDED(initCertCache(pAppCredential))) {
+        loadCertCache(pAppCredential);
+    }
+
 CleanUp:
 
     if (STATUS_FAILED(retStatus)) {
@@ -198,6 +567,32 @@ STATUS destroyCredential(PAppCredential pAppCredential)
     UINT64 data;
     CHK(pAppCredential != NULL, STATUS_APP_CREDENTIAL_NULL_ARG);
 
+    if (pAppCredential->generateCertTid != INVALID_TID_VALUE) {
+        ATOMIC_STORE_BOOL(&pAppCredential->terminateCertWorker, TRUE);
+        MUTEX_LOCK(pAppCredential->generateCertLock);
+        CVAR_BROADCAST(pAppCredential->generateCertCvar);
+        MUTEX_UNLOCK(pAppCredential->generateCertLock);
+        THREAD_JOIN(pAppCredential->generateCertTid, NULL);
+        pAppCredential->generateCertTid = INVALID_TID_VALUE;
+    }
+
+    if (pAppCredential->certStats.generatedCount != 0 || pAppCredential->certStats.poolHits != 0 || pAppCredential->certStats.poolMisses != 0) {
+        DLOGI("Certificate pool: generated %" PRIu64 ", failed %" PRIu64 ", avg %" PRIu64 " ms, max %" PRIu64 " ms, hits %" PRIu64
+              ", misses %" PRIu64,
+              pAppCredential->certStats.generatedCount, pAppCredential->certStats.failedCount,
+              pAppCredential->certStats.generatedCount == 0
+                  ? 0
+                  : pAppCredential->certStats.totalGenerationTime / pAppCredential->certStats.generatedCount / HUNDREDS_OF_NANOS_IN_A_MILLISECOND,
+              pAppCredential->certStats.maxGenerationTime / HUNDREDS_OF_NANOS_IN_A_MILLISECOND, pAppCredential->certStats.poolHits,
+              pAppCredential->certStats.poolMisses);
+    }
+
+    if (pAppCredential->certCacheDir[0] != '\0') {
+        DLOGI("Certificate cache: loaded %" PRIu64 ", saved %" PRIu64 ", evicted %" PRIu64 ", %u kept for the next start",
+              pAppCredential->certStats.cacheLoadedCount, pAppCredential->certStats.cacheSavedCount, pAppCredential->certStats.cacheEvictedCount,
+              pAppCredential->certCacheRingCount);
+    }
+
     if (pAppCredential->generatedCertificates != NULL) {
         appQueueGetIterator(pAppCredential->generatedCertificates, &iterator);
         while (IS_VALID_ITERATOR(iterator)) {
@@ -226,6 +621,11 @@ STATUS destroyCredential(PAppCredential pAppCredential)
         pAppCredential->generateCertLock = INVALID_MUTEX_VALUE;
     }
 
+    if (IS_VALID_CVAR_VALUE(pAppCredential->generateCertCvar)) {
+        CVAR_FREE(pAppCredential->generateCertCvar);
+        pAppCredential->generateCertCvar = INVALID_CVAR_VALUE;
+    }
+
 CleanUp:
     if (pAppCredential != NULL) {
         pAppCredential->credentialType = APP_CREDENTIAL_TYPE_NA;
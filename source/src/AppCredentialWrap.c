@@ -14,6 +14,11 @@
  */
 #define LOG_CLASS "AppCredentialWrap"
 #include "AppCredentialWrap.h"
+#include <fcntl.h>
+#ifdef KVS_USE_OPENSSL
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#endif
 
 STATUS createAppStaticCredentialProvider(PCHAR accessKeyId, UINT32 accessKeyIdLen, PCHAR secretKey, UINT32 secretKeyLen, PCHAR sessionToken,
                                          UINT32 sessionTokenLen, UINT64 expiration, PAwsCredentialProvider* ppCredentialProvider)
@@ -47,3 +52,111 @@ STATUS freeAppEcsCredentialProvider(PAwsCredentialProvider* ppCredentialProvider
 {
     return freeEcsCredentialProvider(ppCredentialProvider);
 }
+
+#ifdef KVS_USE_OPENSSL
+STATUS saveAppRtcCertificate(PRtcCertificate pRtcCertificate, PCHAR pPath)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR tmpPath[MAX_PATH_LEN + 1] = {0};
+    INT32 fd = -1;
+    FILE* fp = NULL;
+
+    CHK(pRtcCertificate != NULL && pPath != NULL, STATUS_NULL_ARG);
+    // Only the certs generated by the sdk, i.e. X509 and EVP_PKEY objects, are supported.
+    CHK(pRtcCertificate->pCertificate != NULL && pRtcCertificate->pPrivateKey != NULL && pRtcCertificate->certificateSize == 0 &&
+            pRtcCertificate->privateKeySize == 0,
+        STATUS_INVALID_ARG);
+    CHK(SNPRINTF(tmpPath, SIZEOF(tmpPath), "%s.tmp", pPath) < (INT32) SIZEOF(tmpPath), STATUS_PATH_TOO_LONG);
+
+    // Write into a temporary file and rename it, so the reader never sees a partial file.
+    unlink(tmpPath);
+    CHK((fd = open(tmpPath, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR)) >= 0, STATUS_OPEN_FILE_FAILED);
+    CHK((fp = fdopen(fd, "w")) != NULL, STATUS_OPEN_FILE_FAILED);
+    fd = -1;
+
+    CHK(PEM_write_X509(fp, (X509*) pRtcCertificate->pCertificate) == 1, STATUS_WRITE_TO_FILE_FAILED);
+    CHK(PEM_write_PrivateKey(fp, (EVP_PKEY*) pRtcCertificate->pPrivateKey, NULL, NULL, 0, NULL, NULL) == 1, STATUS_WRITE_TO_FILE_FAILED);
+    CHK(fflush(fp) == 0 && fsync(fileno(fp)) == 0, STATUS_WRITE_TO_FILE_FAILED);
+    CHK(fclose(fp) == 0, STATUS_WRITE_TO_FILE_FAILED);
+    fp = NULL;
+    CHK(rename(tmpPath, pPath) == 0, STATUS_WRITE_TO_FILE_FAILED);
+
+CleanUp:
+
+    if (fp != NULL) {
+        fclose(fp);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (STATUS_FAILED(retStatus) && tmpPath[0] != '\0') {
+        unlink(tmpPath);
+    }
+
+    return retStatus;
+}
+
+STATUS loadAppRtcCertificate(PCHAR pPath, PRtcCertificate* ppRtcCertificate)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    FILE* fp = NULL;
+    X509* pCert = NULL;
+    EVP_PKEY* pKey = NULL;
+    PRtcCertificate pRtcCertificate = NULL;
+
+    CHK(pPath != NULL && ppRtcCertificate != NULL, STATUS_NULL_ARG);
+    *ppRtcCertificate = NULL;
+
+    CHK((fp = FOPEN(pPath, "r")) != NULL, STATUS_OPEN_FILE_FAILED);
+    CHK((pCert = PEM_read_X509(fp, NULL, NULL, NULL)) != NULL, STATUS_READ_FILE_FAILED);
+    CHK((pKey = PEM_read_PrivateKey(fp, NULL, NULL, NULL)) != NULL, STATUS_READ_FILE_FAILED);
+    CHK(X509_check_private_key(pCert, pKey) == 1, STATUS_INVALID_ARG);
+    // The cert must stay valid for the lifetime of the session.
+    CHK(X509_cmp_current_time(X509_get_notAfter(pCert)) > 0, STATUS_INVALID_ARG);
+
+    CHK(NULL != (pRtcCertificate = (PRtcCertificate) MEMCALLOC(1, SIZEOF(RtcCertificate))), STATUS_NOT_ENOUGH_MEMORY);
+    // Same layout as createRtcCertificate, so freeRtcCertificate releases it.
+    pRtcCertificate->pCertificate = (PBYTE) pCert;
+    pRtcCertificate->certificateSize = 0;
+    pRtcCertificate->pPrivateKey = (PBYTE) pKey;
+    pRtcCertificate->privateKeySize = 0;
+    pCert = NULL;
+    pKey = NULL;
+    *ppRtcCertificate = pRtcCertificate;
+
+CleanUp:
+
+    if (fp != NULL) {
+        FCLOSE(fp);
+    }
+
+    if (pCert != NULL) {
+        X509_free(pCert);
+    }
+
+    if (pKey != NULL) {
+        EVP_PKEY_free(pKey);
+    }
+
+    return retStatus;
+}
+#else
+// The certs of the mbedtls build of the sdk are not X509 and EVP_PKEY objects, so they are not cached.
+STATUS saveAppRtcCertificate(PRtcCertificate pRtcCertificate, PCHAR pPath)
+{
+    UNUSED_PARAM(pRtcCertificate);
+    UNUSED_PARAM(pPath);
+    return STATUS_INVALID_OPERATION;
+}
+
+STATUS loadAppRtcCertificate(PCHAR pPath, PRtcCertificate* ppRtcCertificate)
+{
+    UNUSED_PARAM(pPath);
+    if (ppRtcCertificate != NULL) {
+        *ppRtcCertificate = NULL;
+    }
+    return STATUS_INVALID_OPERATION;
+}
+#endif
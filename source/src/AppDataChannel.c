@@ -13,7 +13,41 @@
  * permissions and limitations under the License.
  */
 #define LOG_CLASS "AppDataChannel"
+#include <time.h>
 #include "AppDataChannel.h"
+#include "AppLockProfiler.h"
+
+static UINT64 getAppDataChannelTime()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (UINT64) now.tv_sec * HUNDREDS_OF_NANOS_IN_A_SECOND + (UINT64) now.tv_nsec / DEFAULT_TIME_UNIT_IN_NANOS;
+}
+
+static VOID putAppDataChannelUint32(PBYTE pBuffer, UINT32 value)
+{
+    pBuffer[0] = (BYTE) (value >> 24);
+    pBuffer[1] = (BYTE) (value >> 16);
+    pBuffer[2] = (BYTE) (value >> 8);
+    pBuffer[3] = (BYTE) value;
+}
+
+static VOID putAppDataChannelUint64(PBYTE pBuffer, UINT64 value)
+{
+    putAppDataChannelUint32(pBuffer, (UINT32) (value >> 32));
+    putAppDataChannelUint32(pBuffer + 4, (UINT32) value);
+}
+
+static UINT32 getAppDataChannelUint32(PBYTE pBuffer)
+{
+    return ((UINT32) pBuffer[0] << 24) | ((UINT32) pBuffer[1] << 16) | ((UINT32) pBuffer[2] << 8) | (UINT32) pBuffer[3];
+}
+
+static UINT64 getAppDataChannelUint64(PBYTE pBuffer)
+{
+    return ((UINT64) getAppDataChannelUint32(pBuffer) << 32) | getAppDataChannelUint32(pBuffer + 4);
+}
 
 static VOID onDataChannelMessage(UINT64 userData, PRtcDataChannel pDataChannel, BOOL isBinary, PBYTE pMessage, UINT32 pMessageLen)
 {
@@ -31,3 +65,315 @@ VOID onDataChannel(UINT64 userData, PRtcDataChannel pRtcDataChannel)
     DLOGI("New DataChannel has been opened %s \n", pRtcDataChannel->name);
     dataChannelOnMessage(pRtcDataChannel, userData, onDataChannelMessage);
 }
+
+static STATUS copyAppDataChannelMessage(PVOID udata, PBYTE pBuffer, UINT32 size)
+{
+    MEMCPY(pBuffer, udata, size);
+    return STATUS_SUCCESS;
+}
+
+STATUS createAppDataChannel(PRtcDataChannel pRtcDataChannel, PAppDataChannel* ppAppDataChannel)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppDataChannel pAppDataChannel = NULL;
+
+    CHK(pRtcDataChannel != NULL && ppAppDataChannel != NULL, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+    CHK(NULL != (pAppDataChannel = (PAppDataChannel) MEMCALLOC(1, SIZEOF(AppDataChannel))), STATUS_APP_DATA_CHANNEL_NOT_ENOUGH_MEMORY);
+    pAppDataChannel->pRtcDataChannel = pRtcDataChannel;
+    pAppDataChannel->lock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pAppDataChannel->lock), STATUS_APP_DATA_CHANNEL_INVALID_MUTEX);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        freeAppDataChannel(&pAppDataChannel);
+    }
+    if (ppAppDataChannel != NULL) {
+        *ppAppDataChannel = pAppDataChannel;
+    }
+    return retStatus;
+}
+
+STATUS freeAppDataChannel(PAppDataChannel* ppAppDataChannel)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppDataChannel pAppDataChannel;
+    UINT32 i;
+
+    CHK(ppAppDataChannel != NULL, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+    pAppDataChannel = *ppAppDataChannel;
+    CHK(pAppDataChannel != NULL, retStatus);
+
+    if (pAppDataChannel->stats.bufferedAmount != 0) {
+        DLOGW("Dropping %" PRIu64 " bytes queued to the data channel", pAppDataChannel->stats.bufferedAmount);
+    }
+    for (i = 0; i < APP_DATA_CHANNEL_QUEUE_DEPTH; i++) {
+        SAFE_MEMFREE(pAppDataChannel->batches[i]);
+    }
+    if (IS_VALID_MUTEX_VALUE(pAppDataChannel->lock)) {
+        MUTEX_FREE(pAppDataChannel->lock);
+    }
+    SAFE_MEMFREE(*ppAppDataChannel);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS writeAppDataChannelMessage(PAppDataChannel pAppDataChannel, UINT32 size, AppDataChannelWriter writer, PVOID udata)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 index, len, frameLen = APP_DATA_CHANNEL_HEADER_LEN + size;
+    PBYTE pFrame;
+    BOOL locked = FALSE;
+
+    CHK(pAppDataChannel != NULL && writer != NULL, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+    CHK(frameLen <= APP_DATA_CHANNEL_BATCH_SIZE, STATUS_APP_DATA_CHANNEL_MESSAGE_TOO_LARGE);
+
+    APP_MUTEX_LOCK(pAppDataChannel->lock);
+    locked = TRUE;
+
+    // The queue refuses the messages from the high watermark until it drains below the low one, so the producers do not
+    // bounce on the watermark.
+    if (!pAppDataChannel->backpressure && pAppDataChannel->stats.bufferedAmount + frameLen > APP_DATA_CHANNEL_HIGH_WATERMARK) {
+        pAppDataChannel->backpressure = TRUE;
+        pAppDataChannel->stats.backpressureCount++;
+    }
+    // Coalesce into the newest batch, or open the next one of the ring. The batch in flight is not touched.
+    index = (pAppDataChannel->head + pAppDataChannel->count + APP_DATA_CHANNEL_QUEUE_DEPTH - 1) % APP_DATA_CHANNEL_QUEUE_DEPTH;
+    if (pAppDataChannel->count == 0 || pAppDataChannel->batchLens[index] + frameLen > APP_DATA_CHANNEL_BATCH_SIZE ||
+        (pAppDataChannel->flushing && index == pAppDataChannel->head)) {
+        if (pAppDataChannel->count == APP_DATA_CHANNEL_QUEUE_DEPTH && !pAppDataChannel->backpressure) {
+            pAppDataChannel->backpressure = TRUE;
+            pAppDataChannel->stats.backpressureCount++;
+        }
+        index = (pAppDataChannel->head + pAppDataChannel->count) % APP_DATA_CHANNEL_QUEUE_DEPTH;
+    }
+    if (pAppDataChannel->backpressure) {
+        pAppDataChannel->stats.messagesDropped++;
+        CHK(FALSE, STATUS_APP_DATA_CHANNEL_BACKPRESSURE);
+    }
+    if (pAppDataChannel->batches[index] == NULL) {
+        pAppDataChannel->batches[index] = (PBYTE) MEMALLOC(APP_DATA_CHANNEL_BATCH_SIZE);
+        CHK(pAppDataChannel->batches[index] != NULL, STATUS_APP_DATA_CHANNEL_NOT_ENOUGH_MEMORY);
+    }
+
+    len = pAppDataChannel->batchLens[index];
+    pFrame = pAppDataChannel->batches[index] + len;
+    CHK_STATUS((writer(udata, pFrame + APP_DATA_CHANNEL_HEADER_LEN, size)));
+    putAppDataChannelUint32(pFrame, size);
+    if (len == 0) {
+        pAppDataChannel->count++;
+    }
+    pAppDataChannel->batchLens[index] = len + frameLen;
+    pAppDataChannel->stats.bufferedAmount += frameLen;
+    pAppDataChannel->stats.messagesQueued++;
+
+CleanUp:
+
+    if (locked) {
+        APP_MUTEX_UNLOCK(pAppDataChannel->lock);
+    }
+    return retStatus;
+}
+
+STATUS sendAppDataChannelMessage(PAppDataChannel pAppDataChannel, PBYTE pMessage, UINT32 size)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pMessage != NULL || size == 0, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+    retStatus = writeAppDataChannelMessage(pAppDataChannel, size, copyAppDataChannelMessage, pMessage);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS flushAppDataChannel(PAppDataChannel pAppDataChannel)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PBYTE pBatch;
+    UINT32 len;
+    BOOL locked = FALSE, flushing = FALSE, sent;
+
+    CHK(pAppDataChannel != NULL, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+
+    APP_MUTEX_LOCK(pAppDataChannel->lock);
+    locked = TRUE;
+    // One flush sends at a time so the batches leave in order, the flush in progress takes the batches queued meanwhile.
+    CHK(!pAppDataChannel->flushing, retStatus);
+    pAppDataChannel->flushing = flushing = TRUE;
+
+    while (pAppDataChannel->count > 0) {
+        // The head batch is sent out of the lock, the producers coalesce into the next one in the meantime.
+        pBatch = pAppDataChannel->batches[pAppDataChannel->head];
+        len = pAppDataChannel->batchLens[pAppDataChannel->head];
+        APP_MUTEX_UNLOCK(pAppDataChannel->lock);
+        sent = STATUS_SUCCEEDED(dataChannelSend(pAppDataChannel->pRtcDataChannel, TRUE, pBatch, len));
+        APP_MUTEX_LOCK(pAppDataChannel->lock);
+        // The sdk does not expose the buffered amount of the sctp association, a refused send is its backpressure.
+        if (!sent) {
+            pAppDataChannel->stats.sendFailures++;
+            CHK(FALSE, STATUS_APP_DATA_CHANNEL_SEND);
+        }
+        pAppDataChannel->stats.batchesSent++;
+        pAppDataChannel->stats.bytesSent += len;
+        pAppDataChannel->stats.bufferedAmount -= len;
+        pAppDataChannel->batchLens[pAppDataChannel->head] = 0;
+        pAppDataChannel->head = (pAppDataChannel->head + 1) % APP_DATA_CHANNEL_QUEUE_DEPTH;
+        pAppDataChannel->count--;
+    }
+
+CleanUp:
+
+    if (locked) {
+        if (flushing) {
+            pAppDataChannel->flushing = FALSE;
+        }
+        if (pAppDataChannel->backpressure && pAppDataChannel->stats.bufferedAmount <= APP_DATA_CHANNEL_LOW_WATERMARK &&
+            pAppDataChannel->count < APP_DATA_CHANNEL_QUEUE_DEPTH) {
+            pAppDataChannel->backpressure = FALSE;
+        }
+        APP_MUTEX_UNLOCK(pAppDataChannel->lock);
+    }
+    return retStatus;
+}
+
+STATUS getAppDataChannelStats(PAppDataChannel pAppDataChannel, PAppDataChannelStats pStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pAppDataChannel != NULL && pStats != NULL, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+    APP_MUTEX_LOCK(pAppDataChannel->lock);
+    *pStats = pAppDataChannel->stats;
+    APP_MUTEX_UNLOCK(pAppDataChannel->lock);
+
+CleanUp:
+
+    return retStatus;
+}
+
+/**
+ * @brief fill a probe message, the frame is the one of this side.
+ */
+static VOID putAppDataChannelProbe(PAppDataChannelProbe pAppDataChannelProbe, PBYTE pBuffer, APP_DATA_CHANNEL_PROBE_TYPE type, UINT32 sequence,
+                                   UINT64 originTime, UINT64 receiveTime)
+{
+    MEMSET(pBuffer, 0x00, APP_DATA_CHANNEL_PROBE_LEN);
+    pBuffer[0] = (BYTE) type;
+    putAppDataChannelUint32(pBuffer + 4, sequence);
+    putAppDataChannelUint64(pBuffer + 8, originTime);
+    putAppDataChannelUint64(pBuffer + 16, receiveTime);
+    MUTEX_LOCK(pAppDataChannelProbe->lock);
+    putAppDataChannelUint64(pBuffer + 32, pAppDataChannelProbe->framePts);
+    putAppDataChannelUint64(pBuffer + 40, pAppDataChannelProbe->frameTime);
+    MUTEX_UNLOCK(pAppDataChannelProbe->lock);
+    // the transmit time is taken last, so the hold time of the remote side does not count in its round trip time.
+    putAppDataChannelUint64(pBuffer + 24, getAppDataChannelTime());
+}
+
+static VOID onDataChannelProbeMessage(UINT64 userData, PRtcDataChannel pDataChannel, BOOL isBinary, PBYTE pMessage, UINT32 pMessageLen)
+{
+    PAppDataChannelProbe pAppDataChannelProbe = (PAppDataChannelProbe) userData;
+    BYTE pong[APP_DATA_CHANNEL_PROBE_LEN];
+    UINT64 receiveTime = getAppDataChannelTime(), originTime, remoteReceiveTime, remoteTransmitTime;
+
+    UNUSED_PARAM(isBinary);
+    if (pAppDataChannelProbe == NULL || pMessage == NULL || pMessageLen < APP_DATA_CHANNEL_PROBE_LEN) {
+        DLOGW("Dropping the invalid probe message of %u bytes", pMessageLen);
+        return;
+    }
+
+    originTime = getAppDataChannelUint64(pMessage + 8);
+    if (pMessage[0] == APP_DATA_CHANNEL_PROBE_PING) {
+        putAppDataChannelProbe(pAppDataChannelProbe, pong, APP_DATA_CHANNEL_PROBE_PONG, getAppDataChannelUint32(pMessage + 4), originTime,
+                               receiveTime);
+        CHK_LOG_ERR((dataChannelSend(pDataChannel, TRUE, pong, APP_DATA_CHANNEL_PROBE_LEN)));
+    } else if (pMessage[0] == APP_DATA_CHANNEL_PROBE_PONG && pAppDataChannelProbe->hook != NULL) {
+        remoteReceiveTime = getAppDataChannelUint64(pMessage + 16);
+        remoteTransmitTime = getAppDataChannelUint64(pMessage + 24);
+        if (originTime > receiveTime || remoteReceiveTime > remoteTransmitTime ||
+            receiveTime - originTime < remoteTransmitTime - remoteReceiveTime) {
+            DLOGW("Dropping the pong of %u with the inconsistent times", getAppDataChannelUint32(pMessage + 4));
+            return;
+        }
+        // The offset assumes the path is symmetric, as ntp does.
+        pAppDataChannelProbe->hook(pAppDataChannelProbe->udata, (receiveTime - originTime) - (remoteTransmitTime - remoteReceiveTime),
+                                   (((INT64) remoteReceiveTime - (INT64) originTime) + ((INT64) remoteTransmitTime - (INT64) receiveTime)) / 2);
+    }
+}
+
+STATUS createAppDataChannelProbe(PRtcDataChannel pRtcDataChannel, AppDataChannelProbeHook hook, PVOID udata,
+                                 PAppDataChannelProbe* ppAppDataChannelProbe)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppDataChannelProbe pAppDataChannelProbe = NULL;
+
+    CHK(pRtcDataChannel != NULL && ppAppDataChannelProbe != NULL, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+    CHK(NULL != (pAppDataChannelProbe = (PAppDataChannelProbe) MEMCALLOC(1, SIZEOF(AppDataChannelProbe))),
+        STATUS_APP_DATA_CHANNEL_NOT_ENOUGH_MEMORY);
+    pAppDataChannelProbe->pRtcDataChannel = pRtcDataChannel;
+    pAppDataChannelProbe->hook = hook;
+    pAppDataChannelProbe->udata = udata;
+    pAppDataChannelProbe->lock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pAppDataChannelProbe->lock), STATUS_APP_DATA_CHANNEL_INVALID_MUTEX);
+    CHK_STATUS((dataChannelOnMessage(pRtcDataChannel, (UINT64) pAppDataChannelProbe, onDataChannelProbeMessage)));
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        freeAppDataChannelProbe(&pAppDataChannelProbe);
+    }
+    if (ppAppDataChannelProbe != NULL) {
+        *ppAppDataChannelProbe = pAppDataChannelProbe;
+    }
+    return retStatus;
+}
+
+STATUS freeAppDataChannelProbe(PAppDataChannelProbe* ppAppDataChannelProbe)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppDataChannelProbe pAppDataChannelProbe;
+
+    CHK(ppAppDataChannelProbe != NULL, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+    pAppDataChannelProbe = *ppAppDataChannelProbe;
+    CHK(pAppDataChannelProbe != NULL, retStatus);
+
+    if (IS_VALID_MUTEX_VALUE(pAppDataChannelProbe->lock)) {
+        MUTEX_FREE(pAppDataChannelProbe->lock);
+    }
+    SAFE_MEMFREE(*ppAppDataChannelProbe);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS sendAppDataChannelProbe(PAppDataChannelProbe pAppDataChannelProbe)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    BYTE ping[APP_DATA_CHANNEL_PROBE_LEN];
+    UINT64 now = getAppDataChannelTime();
+
+    CHK(pAppDataChannelProbe != NULL, STATUS_APP_DATA_CHANNEL_NULL_ARG);
+    putAppDataChannelProbe(pAppDataChannelProbe, ping, APP_DATA_CHANNEL_PROBE_PING, ++pAppDataChannelProbe->sequence, now, 0);
+    CHK(STATUS_SUCCEEDED(dataChannelSend(pAppDataChannelProbe->pRtcDataChannel, TRUE, ping, APP_DATA_CHANNEL_PROBE_LEN)),
+        STATUS_APP_DATA_CHANNEL_SEND);
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID setAppDataChannelProbeFrame(PAppDataChannelProbe pAppDataChannelProbe, UINT64 framePts)
+{
+    UINT64 now = getAppDataChannelTime();
+
+    if (pAppDataChannelProbe == NULL) {
+        return;
+    }
+    MUTEX_LOCK(pAppDataChannelProbe->lock);
+    pAppDataChannelProbe->framePts = framePts;
+    pAppDataChannelProbe->frameTime = now;
+    MUTEX_UNLOCK(pAppDataChannelProbe->lock);
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define LOG_CLASS "AppInterfaceFilter"
+#include "AppInterfaceFilter.h"
+#include <arpa/inet.h>
+#include <fnmatch.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+
+/**
+ * @brief parse one rule. The rule is a cidr if it has a '/', otherwise it is a glob of the interface name.
+ */
+static STATUS parseAppInterfaceRule(PCHAR pRuleStr, UINT32 ruleLen, PAppInterfaceRule pRule)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR address[APP_INTERFACE_FILTER_PATTERN_LEN + 1];
+    PCHAR pSlash;
+    UINT32 maxPrefixLen;
+
+    CHK(ruleLen <= APP_INTERFACE_FILTER_PATTERN_LEN, STATUS_APP_INTERFACE_FILTER_INVALID_RULE);
+    MEMSET(pRule, 0x00, SIZEOF(AppInterfaceRule));
+    STRNCPY(pRule->pattern, pRuleStr, ruleLen);
+    pRule->pattern[ruleLen] = '\0';
+
+    if ((pSlash = STRCHR(pRule->pattern, '/')) != NULL) {
+        pRule->isCidr = TRUE;
+        STRNCPY(address, pRule->pattern, pSlash - pRule->pattern);
+        address[pSlash - pRule->pattern] = '\0';
+        if (inet_pton(AF_INET, address, pRule->address) == 1) {
+            pRule->family = AF_INET;
+            maxPrefixLen = 32;
+        } else if (inet_pton(AF_INET6, address, pRule->address) == 1) {
+            pRule->family = AF_INET6;
+            maxPrefixLen = 128;
+        } else {
+            CHK(FALSE, STATUS_APP_INTERFACE_FILTER_INVALID_RULE);
+        }
+        CHK(STRTOUI32(pSlash + 1, NULL, 10, &pRule->prefixLen) == STATUS_SUCCESS && pRule->prefixLen <= maxPrefixLen,
+            STATUS_APP_INTERFACE_FILTER_INVALID_RULE);
+    }
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        DLOGE("Invalid interface rule: %.*s", ruleLen, pRuleStr);
+    }
+
+    return retStatus;
+}
+
+/**
+ * @brief parse a comma separated list of rules.
+ */
+static STATUS parseAppInterfaceRules(PCHAR pList, PAppInterfaceRule pRules, PUINT32 pRuleCount)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pCur = pList, pEnd;
+    UINT32 ruleLen;
+
+    *pRuleCount = 0;
+    CHK(pList != NULL, retStatus);
+
+    while (*pCur != '\0') {
+        while (*pCur == ',' || *pCur == ' ') {
+            pCur++;
+        }
+        if (*pCur == '\0') {
+            break;
+        }
+
+        pEnd = pCur;
+        while (*pEnd != '\0' && *pEnd != ',') {
+            pEnd++;
+        }
+        ruleLen = (UINT32) (pEnd - pCur);
+        while (ruleLen > 0 && pCur[ruleLen - 1] == ' ') {
+            ruleLen--;
+        }
+
+        CHK(*pRuleCount < APP_INTERFACE_FILTER_MAX_RULES, STATUS_APP_INTERFACE_FILTER_TOO_MANY_RULES);
+        CHK_STATUS((parseAppInterfaceRule(pCur, ruleLen, &pRules[*pRuleCount])));
+        (*pRuleCount)++;
+        pCur = pEnd;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+static BOOL isAddressInCidr(struct sockaddr* pAddr, PAppInterfaceRule pRule)
+{
+    PBYTE pAddress;
+    UINT32 fullBytes = pRule->prefixLen / 8, remainingBits = pRule->prefixLen % 8;
+    BYTE mask;
+
+    if (pAddr == NULL || pAddr->sa_family != pRule->family) {
+        return FALSE;
+    }
+
+    if (pRule->family == AF_INET) {
+        pAddress = (PBYTE) &((struct sockaddr_in*) pAddr)->sin_addr;
+    } else {
+        pAddress = (PBYTE) &((struct sockaddr_in6*) pAddr)->sin6_addr;
+    }
+    if (MEMCMP(pAddress, pRule->address, fullBytes) != 0) {
+        return FALSE;
+    }
+    if (remainingBits != 0) {
+        mask = (BYTE) (0xFF << (8 - remainingBits));
+        return (pAddress[fullBytes] & mask) == (pRule->address[fullBytes] & mask);
+    }
+    return TRUE;
+}
+
+static BOOL matchAppInterfaceRules(PAppInterfaceFilterSession pFilterSession, PAppInterfaceRule pRules, UINT32 ruleCount, PCHAR pInterfaceName)
+{
+    struct ifaddrs* pIfAddr;
+    UINT32 i;
+
+    for (i = 0; i < ruleCount; i++) {
+        if (!pRules[i].isCidr) {
+            if (fnmatch(pRules[i].pattern, pInterfaceName, 0) == 0) {
+                return TRUE;
+            }
+            continue;
+        }
+
+        // The sdk only passes the name, so look up the addresses of the interface once per gathering.
+        if (pFilterSession->pIfAddrs == NULL && getifaddrs((struct ifaddrs**) &pFilterSession->pIfAddrs) != 0) {
+            DLOGW("Failed to get the addresses of the interfaces");
+            pFilterSession->pIfAddrs = NULL;
+            continue;
+        }
+        for (pIfAddr = (struct ifaddrs*) pFilterSession->pIfAddrs; pIfAddr != NULL; pIfAddr = pIfAddr->ifa_next) {
+            if (STRCMP(pIfAddr->ifa_name, pInterfaceName) == 0 && isAddressInCidr(pIfAddr->ifa_addr, &pRules[i])) {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+STATUS setAppInterfaceFilterRules(PAppInterfaceFilter pInterfaceFilter, PCHAR pAllowList, PCHAR pDenyList)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pInterfaceFilter != NULL, STATUS_APP_INTERFACE_FILTER_NULL_ARG);
+    MEMSET(pInterfaceFilter, 0x00, SIZEOF(AppInterfaceFilter));
+
+    CHK_STATUS((parseAppInterfaceRules(pAllowList, pInterfaceFilter->allowRules, &pInterfaceFilter->allowCount)));
+    CHK_STATUS((parseAppInterfaceRules(pDenyList, pInterfaceFilter->denyRules, &pInterfaceFilter->denyCount)));
+    pInterfaceFilter->enabled = pInterfaceFilter->allowCount != 0 || pInterfaceFilter->denyCount != 0;
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && pInterfaceFilter != NULL) {
+        MEMSET(pInterfaceFilter, 0x00, SIZEOF(AppInterfaceFilter));
+    }
+
+    return retStatus;
+}
+
+STATUS initAppInterfaceFilter(PAppInterfaceFilter pInterfaceFilter)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pAllowList = GETENV(APP_INTERFACE_ALLOW_LIST);
+    PCHAR pDenyList = GETENV(APP_INTERFACE_DENY_LIST);
+
+    // Skip the virtual interfaces of the containers by default. An empty deny list turns it off.
+    if (pAllowList == NULL && pDenyList == NULL) {
+        pDenyList = APP_INTERFACE_FILTER_DEFAULT_DENY_LIST;
+    }
+
+    CHK_STATUS((setAppInterfaceFilterRules(pInterfaceFilter, pAllowList, pDenyList)));
+    DLOGI("Interface filter: allow(%s), deny(%s)", pAllowList == NULL ? "" : pAllowList, pDenyList == NULL ? "" : pDenyList);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS initAppInterfaceFilterSession(PAppInterfaceFilterSession pFilterSession, PAppInterfaceFilter pInterfaceFilter)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pFilterSession != NULL && pInterfaceFilter != NULL, STATUS_APP_INTERFACE_FILTER_NULL_ARG);
+    pFilterSession->pInterfaceFilter = pInterfaceFilter;
+    pFilterSession->pIfAddrs = NULL;
+    pFilterSession->candidateCount = 0;
+    pFilterSession->acceptedCount = 0;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS freeAppInterfaceFilterSession(PAppInterfaceFilterSession pFilterSession)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pFilterSession != NULL, STATUS_APP_INTERFACE_FILTER_NULL_ARG);
+    if (pFilterSession->pIfAddrs != NULL) {
+        freeifaddrs((struct ifaddrs*) pFilterSession->pIfAddrs);
+        pFilterSession->pIfAddrs = NULL;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+BOOL appInterfaceFilterFunc(UINT64 customData, PCHAR pInterfaceName)
+{
+    PAppInterfaceFilterSession pFilterSession = (PAppInterfaceFilterSession) customData;
+    PAppInterfaceFilter pInterfaceFilter;
+    BOOL accepted = TRUE;
+
+    if (pFilterSession == NULL || pInterfaceName == NULL || (pInterfaceFilter = pFilterSession->pInterfaceFilter) == NULL) {
+        return TRUE;
+    }
+
+    pFilterSession->candidateCount++;
+    if (pInterfaceFilter->allowCount != 0) {
+        accepted = matchAppInterfaceRules(pFilterSession, pInterfaceFilter->allowRules, pInterfaceFilter->allowCount, pInterfaceName);
+    }
+    if (accepted && pInterfaceFilter->denyCount != 0) {
+        accepted = !matchAppInterfaceRules(pFilterSession, pInterfaceFilter->denyRules, pInterfaceFilter->denyCount, pInterfaceName);
+    }
+
+    if (accepted) {
+        pFilterSession->acceptedCount++;
+    } else {
+        DLOGV("Skip the interface %s", pInterfaceName);
+    }
+    return accepted;
+}
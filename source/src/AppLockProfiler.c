@@ -0,0 +1,296 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define LOG_CLASS "AppLockProfiler"
+#include "AppLockProfiler.h"
+
+static AppLockStats gAppLockStats[APP_LOCK_PROFILER_MAX_LOCKS]; //!< the profiled locks, a slot is claimed by its first lock.
+
+/**
+ * @brief the bucket of the duration, bucket i holds the durations below 2^i microseconds.
+ */
+static UINT32 getAppLockBucket(UINT64 duration)
+{
+    UINT64 micros = duration / HUNDREDS_OF_NANOS_IN_A_MICROSECOND;
+    UINT32 bucket = 0;
+
+    while (micros > 0 && bucket < APP_LOCK_PROFILER_BUCKET_COUNT - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief the upper end of the bucket holding the quantile, in seconds, capped at the longest duration.
+ */
+static DOUBLE getAppLockQuantile(PUINT64 pBuckets, UINT64 count, UINT64 maxDuration, DOUBLE quantile)
+{
+    UINT64 rank, cumulative = 0;
+    UINT32 i;
+
+    if (count == 0) {
+        return 0;
+    }
+    // the nearest rank, rounded up so a single slow acquisition shows in the p99 of a few.
+    rank = (UINT64) (quantile * count);
+    rank += (DOUBLE) rank < quantile * count || rank == 0 ? 1 : 0;
+    for (i = 0; i < APP_LOCK_PROFILER_BUCKET_COUNT - 1; i++) {
+        cumulative += pBuckets[i];
+        if (cumulative >= rank) {
+            break;
+        }
+    }
+    return (DOUBLE) MIN(((UINT64) 1 << i) * HUNDREDS_OF_NANOS_IN_A_MICROSECOND, maxDuration) / HUNDREDS_OF_NANOS_IN_A_SECOND;
+}
+
+/**
+ * @brief find the slot of the mutex, or claim a free one. NULL if the table is full or the slot is being claimed.
+ */
+static PAppLockStats getAppLockSlot(MUTEX mutex, PCHAR pName)
+{
+    PAppLockStats pStats = NULL;
+    PCHAR pCur;
+    SIZE_T expected;
+    UINT32 i;
+
+    // The slots are claimed in order and never released, so the first free slot ends the search.
+    for (i = 0; i < APP_LOCK_PROFILER_MAX_LOCKS; i++) {
+        pStats = &gAppLockStats[i];
+        expected = 0;
+        if (pName != NULL && ATOMIC_LOAD(&pStats->key) == 0 && ATOMIC_COMPARE_EXCHANGE(&pStats->key, &expected, (SIZE_T) mutex)) {
+            // keep the member name only, e.g. pAppConfiguration->appConfigurationObjLock
+            for (pCur = pName + STRLEN(pName); pCur > pName && pCur[-1] != '>' && pCur[-1] != '.'; pCur--) {
+            }
+            STRNCPY(pStats->name, pCur, APP_LOCK_PROFILER_NAME_LEN);
+            pStats->name[APP_LOCK_PROFILER_NAME_LEN] = '\0';
+            ATOMIC_STORE_BOOL(&pStats->ready, TRUE);
+            return pStats;
+        }
+        expected = ATOMIC_LOAD(&pStats->key);
+        if (expected == (SIZE_T) mutex) {
+            return ATOMIC_LOAD_BOOL(&pStats->ready) ? pStats : NULL;
+        } else if (expected == 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static VOID recordAppLockSite(PAppLockStats pStats, PCHAR pFunction, UINT32 line, UINT64 waitTime)
+{
+    PAppLockSite pSite = NULL;
+    UINT32 i;
+
+    for (i = 0; i < pStats->siteCount; i++) {
+        if (pStats->sites[i].line == line && pStats->sites[i].pFunction == pFunction) {
+            pSite = &pStats->sites[i];
+            break;
+        }
+    }
+    if (pSite == NULL) {
+        if (pStats->siteCount == APP_LOCK_PROFILER_MAX_SITES) {
+            pStats->droppedSiteCount++;
+            return;
+        }
+        pSite = &pStats->sites[pStats->siteCount++];
+        pSite->pFunction = pFunction;
+        pSite->line = line;
+    }
+    pSite->count++;
+    pSite->waitTime += waitTime;
+    pSite->maxWait = MAX(pSite->maxWait, waitTime);
+}
+
+static VOID recordAppLockHold(PAppLockStats pStats)
+{
+    UINT64 now = GETTIME();
+    // The wall clock can step back.
+    UINT64 holdTime = now > pStats->acquireTime ? now - pStats->acquireTime : 0;
+
+    pStats->holdCount++;
+    pStats->holdTime += holdTime;
+    pStats->maxHold = MAX(pStats->maxHold, holdTime);
+    pStats->holdBuckets[getAppLockBucket(holdTime)]++;
+}
+
+VOID appLockProfilerLock(MUTEX mutex, PCHAR pName, PCHAR pFunction, UINT32 line)
+{
+    PAppLockStats pStats = getAppLockSlot(mutex, pName);
+    UINT64 startTime, endTime, waitTime = 0;
+    BOOL contended = FALSE;
+
+    if (pStats == NULL) {
+        MUTEX_LOCK(mutex);
+        return;
+    }
+
+    if (!MUTEX_TRYLOCK(mutex)) {
+        contended = TRUE;
+        startTime = GETTIME();
+        MUTEX_LOCK(mutex);
+        endTime = GETTIME();
+        waitTime = endTime > startTime ? endTime - startTime : 0;
+    }
+
+    // The lock is held from here, so only this thread updates its stats.
+    if (pStats->depth++ == 0) {
+        pStats->acquireTime = GETTIME();
+    }
+    pStats->acquireCount++;
+    pStats->contendedCount += contended ? 1 : 0;
+    pStats->waitTime += waitTime;
+    pStats->maxWait = MAX(pStats->maxWait, waitTime);
+    pStats->waitBuckets[getAppLockBucket(waitTime)]++;
+    recordAppLockSite(pStats, pFunction, line, waitTime);
+}
+
+VOID appLockProfilerUnlock(MUTEX mutex)
+{
+    PAppLockStats pStats = getAppLockSlot(mutex, NULL);
+
+    if (pStats != NULL && pStats->depth > 0 && --pStats->depth == 0) {
+        recordAppLockHold(pStats);
+    }
+    MUTEX_UNLOCK(mutex);
+}
+
+STATUS appLockProfilerWait(CVAR cvar, MUTEX mutex, PCHAR pName, UINT64 timeout)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppLockStats pStats = getAppLockSlot(mutex, pName);
+    UINT32 depth = 0;
+
+    if (pStats != NULL && pStats->depth > 0) {
+        depth = pStats->depth;
+        pStats->depth = 0;
+        recordAppLockHold(pStats);
+    }
+
+    retStatus = CVAR_WAIT(cvar, mutex, timeout);
+
+    if (pStats != NULL && depth > 0) {
+        pStats->depth = depth;
+        pStats->acquireTime = GETTIME();
+    }
+    return retStatus;
+}
+
+STATUS getAppLockStats(MUTEX mutex, PAppLockStats* ppStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppLockStats pStats = NULL;
+
+    CHK(ppStats != NULL, STATUS_APP_LOCK_PROFILER_NULL_ARG);
+    CHK((pStats = getAppLockSlot(mutex, NULL)) != NULL, STATUS_APP_LOCK_PROFILER_NOT_FOUND);
+
+CleanUp:
+
+    if (ppStats != NULL) {
+        *ppStats = pStats;
+    }
+    return retStatus;
+}
+
+STATUS dumpAppLockProfile()
+{
+    PAppLockStats pStats;
+    PAppLockSite pSite;
+    BOOL reported[APP_LOCK_PROFILER_MAX_SITES];
+    UINT32 i, j, k, top;
+
+    for (i = 0; i < APP_LOCK_PROFILER_MAX_LOCKS; i++) {
+        pStats = &gAppLockStats[i];
+        if (!ATOMIC_LOAD_BOOL(&pStats->ready)) {
+            continue;
+        }
+        DLOGI("lock %s: %" PRIu64 " acquisitions, %" PRIu64 " contended, wait p50 %.6lf s p99 %.6lf s max %.6lf s, "
+              "hold p50 %.6lf s p99 %.6lf s max %.6lf s",
+              pStats->name, pStats->acquireCount, pStats->contendedCount,
+              getAppLockQuantile(pStats->waitBuckets, pStats->acquireCount, pStats->maxWait, 0.5),
+              getAppLockQuantile(pStats->waitBuckets, pStats->acquireCount, pStats->maxWait, 0.99),
+              (DOUBLE) pStats->maxWait / HUNDREDS_OF_NANOS_IN_A_SECOND,
+              getAppLockQuantile(pStats->holdBuckets, pStats->holdCount, pStats->maxHold, 0.5),
+              getAppLockQuantile(pStats->holdBuckets, pStats->holdCount, pStats->maxHold, 0.99),
+              (DOUBLE) pStats->maxHold / HUNDREDS_OF_NANOS_IN_A_SECOND);
+
+        // the call sites with the longest total wait first.
+        MEMSET(reported, 0x00, SIZEOF(reported));
+        for (k = 0; k < APP_LOCK_PROFILER_TOP_SITES; k++) {
+            top = pStats->siteCount;
+            for (j = 0; j < pStats->siteCount; j++) {
+                if (!reported[j] && (top == pStats->siteCount || pStats->sites[j].waitTime > pStats->sites[top].waitTime)) {
+                    top = j;
+                }
+            }
+            if (top == pStats->siteCount || pStats->sites[top].waitTime == 0) {
+                break;
+            }
+            reported[top] = TRUE;
+            pSite = &pStats->sites[top];
+            DLOGI("    %s:%u waited %.6lf s in %" PRIu64 " acquisitions, max %.6lf s", pSite->pFunction, pSite->line,
+                  (DOUBLE) pSite->waitTime / HUNDREDS_OF_NANOS_IN_A_SECOND, pSite->count, (DOUBLE) pSite->maxWait / HUNDREDS_OF_NANOS_IN_A_SECOND);
+        }
+        if (pStats->droppedSiteCount > 0) {
+            DLOGI("    %u acquisitions from the call sites beyond the first %u", pStats->droppedSiteCount, APP_LOCK_PROFILER_MAX_SITES);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static VOID setAppLockCounter(PAppMetricsRegistry pRegistry, PCHAR pName, PCHAR pHelp, PCHAR pLock, DOUBLE value)
+{
+    UINT32 metricId;
+
+    if (STATUS_SUCCEEDED(registerAppMetric(pRegistry, pName, pHelp, APP_METRIC_TYPE_COUNTER, "lock", pLock, NULL, 0, &metricId))) {
+        setAppMetric(pRegistry, metricId, value);
+    }
+}
+
+STATUS exportAppLockProfile(PAppMetricsRegistry pRegistry)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppLockStats pStats;
+    UINT32 i;
+
+    CHK(pRegistry != NULL, STATUS_APP_LOCK_PROFILER_NULL_ARG);
+
+    for (i = 0; i < APP_LOCK_PROFILER_MAX_LOCKS; i++) {
+        pStats = &gAppLockStats[i];
+        if (!ATOMIC_LOAD_BOOL(&pStats->ready)) {
+            continue;
+        }
+        setAppLockCounter(pRegistry, "webrtc_app_lock_acquisitions_total", "The number of acquisitions of the lock.", pStats->name,
+                          pStats->acquireCount);
+        setAppLockCounter(pRegistry, "webrtc_app_lock_contended_total", "The number of acquisitions which waited for another owner.",
+                          pStats->name, pStats->contendedCount);
+        setAppLockCounter(pRegistry, "webrtc_app_lock_wait_seconds_total", "The total wait for the lock.", pStats->name,
+                          (DOUBLE) pStats->waitTime / HUNDREDS_OF_NANOS_IN_A_SECOND);
+        setAppLockCounter(pRegistry, "webrtc_app_lock_hold_seconds_total", "The total hold time of the lock.", pStats->name,
+                          (DOUBLE) pStats->holdTime / HUNDREDS_OF_NANOS_IN_A_SECOND);
+        setAppGauge(pRegistry, "webrtc_app_lock_wait_p99_seconds", "The 99th percentile of the wait for the lock.", "lock", pStats->name,
+                    getAppLockQuantile(pStats->waitBuckets, pStats->acquireCount, pStats->maxWait, 0.99));
+        setAppGauge(pRegistry, "webrtc_app_lock_hold_p99_seconds", "The 99th percentile of the hold time of the lock.", "lock", pStats->name,
+                    getAppLockQuantile(pStats->holdBuckets, pStats->holdCount, pStats->maxHold, 0.99));
+        setAppGauge(pRegistry, "webrtc_app_lock_wait_max_seconds", "The longest wait for the lock.", "lock", pStats->name,
+                    (DOUBLE) pStats->maxWait / HUNDREDS_OF_NANOS_IN_A_SECOND);
+        setAppGauge(pRegistry, "webrtc_app_lock_hold_max_seconds", "The longest hold time of the lock.", "lock", pStats->name,
+                    (DOUBLE) pStats->maxHold / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    }
+
+CleanUp:
+
+    return retStatus;
+}
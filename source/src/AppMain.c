@@ -20,6 +20,8 @@ INT32 main(INT32 argc, CHAR* argv[])
     STATUS retStatus = STATUS_SUCCESS;
     PAppConfiguration pAppConfiguration = NULL;
     SET_INSTRUMENTED_ALLOCATORS();
+    // charge every allocation to its subsystem on top of the instrumented allocators.
+    initAppMemory();
 
     printf("[WebRTC] Starting\n");
 
@@ -58,7 +60,10 @@ CleanUp:
     }
     printf("[WebRTC] cleanup done\n");
 
-    RESET_INSTRUMENTED_ALLOCATORS();
+    // the instrumented allocators stay under the tagged ones while their blocks are live.
+    if (STATUS_SUCCEEDED(deinitAppMemory())) {
+        RESET_INSTRUMENTED_ALLOCATORS();
+    }
     // https://www.gnu.org/software/libc/manual/html_node/Exit-Status.html
     // We can only return with 0 - 127. Some platforms treat exit code >= 128
     // to be a success code, which might give an unintended behaviour.
@@ -0,0 +1,381 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define LOG_CLASS "AppMemory"
+#include "AppMemory.h"
+
+/**
+ * Every block starts with this header, so its size, subsystem and session are known when it is freed. The header keeps the
+ * 16 bytes alignment of the chained allocators.
+ */
+typedef struct {
+    UINT16 tag;     //!< the subsystem charged for the block.
+    UINT16 session; //!< the session charged for the block, APP_MEMORY_NO_SESSION for none.
+    UINT32 offset;  //!< the distance from the start of the chained block to the returned pointer.
+    UINT64 size;    //!< the size requested by the caller.
+} AppMemoryHeader, *PAppMemoryHeader;
+
+typedef struct {
+    volatile SIZE_T open; //!< 1 while a session holds the slot.
+    AppMemoryStats stats; //!< the blocks charged to the session, the slot is reused once they are all freed.
+} AppMemorySession, *PAppMemorySession;
+
+#define APP_MEMORY_HEADER_SIZE ((UINT32) SIZEOF(AppMemoryHeader))
+#define APP_MEMORY_GET_HEADER(p) ((PAppMemoryHeader) ((PBYTE) (p) - APP_MEMORY_HEADER_SIZE))
+
+// the names of the subsystems, in the order of APP_MEMORY_TAG.
+static PCHAR gAppMemoryTagNames[APP_MEMORY_TAG_COUNT] = {
+    "sdk", "app", "signaling", "pending_queue", "session", "certificate", "media",
+};
+static AppMemoryStats gAppMemoryStats[APP_MEMORY_TAG_COUNT];
+static AppMemorySession gAppMemorySessions[APP_MEMORY_SESSION_SLOTS]; //!< the session of id i is at i - 1.
+static volatile ATOMIC_BOOL gAppMemoryInitialized = FALSE;
+static UINT64 gAppMemoryLogTime = 0; //!< the time of the last log line.
+static __thread APP_MEMORY_TAG gAppMemoryTag = APP_MEMORY_TAG_SDK;
+static __thread UINT32 gAppMemorySession = APP_MEMORY_NO_SESSION;
+
+// the allocators replaced by initAppMemory.
+static memAlloc gAppMemoryAlloc = NULL;
+static memAlignAlloc gAppMemoryAlignAlloc = NULL;
+static memCalloc gAppMemoryCalloc = NULL;
+static memRealloc gAppMemoryRealloc = NULL;
+static memFree gAppMemoryFree = NULL;
+
+static VOID chargeAppMemoryStats(PAppMemoryStats pStats, SIZE_T size)
+{
+    ATOMIC_ADD(&pStats->liveBytes, size);
+    ATOMIC_ADD(&pStats->allocBytes, size);
+    ATOMIC_INCREMENT(&pStats->allocCount);
+}
+
+static VOID releaseAppMemoryStats(PAppMemoryStats pStats, SIZE_T size)
+{
+    ATOMIC_SUBTRACT(&pStats->liveBytes, size);
+    ATOMIC_INCREMENT(&pStats->freeCount);
+}
+
+static PVOID chargeAppMemory(PBYTE pBlock, UINT32 offset, APP_MEMORY_TAG tag, UINT32 session, SIZE_T size)
+{
+    PAppMemoryHeader pHeader;
+
+    if (pBlock == NULL) {
+        return NULL;
+    }
+    pHeader = (PAppMemoryHeader) (pBlock + offset - APP_MEMORY_HEADER_SIZE);
+    pHeader->tag = (UINT16) tag;
+    pHeader->session = (UINT16) session;
+    pHeader->offset = offset;
+    pHeader->size = (UINT64) size;
+    chargeAppMemoryStats(&gAppMemoryStats[tag], size);
+    if (session != APP_MEMORY_NO_SESSION) {
+        chargeAppMemoryStats(&gAppMemorySessions[session - 1].stats, size);
+    }
+    return pBlock + offset;
+}
+
+static PBYTE releaseAppMemory(PVOID ptr)
+{
+    PAppMemoryHeader pHeader = APP_MEMORY_GET_HEADER(ptr);
+
+    releaseAppMemoryStats(&gAppMemoryStats[pHeader->tag], (SIZE_T) pHeader->size);
+    if (pHeader->session != APP_MEMORY_NO_SESSION) {
+        releaseAppMemoryStats(&gAppMemorySessions[pHeader->session - 1].stats, (SIZE_T) pHeader->size);
+    }
+    return (PBYTE) ptr - pHeader->offset;
+}
+
+static PVOID appMemoryAlloc(SIZE_T size)
+{
+    return chargeAppMemory((PBYTE) gAppMemoryAlloc(size + APP_MEMORY_HEADER_SIZE), APP_MEMORY_HEADER_SIZE, gAppMemoryTag, gAppMemorySession,
+                           size);
+}
+
+static PVOID appMemoryAlignAlloc(SIZE_T size, SIZE_T alignment)
+{
+    // a power of two alignment above the header size is also a multiple of it.
+    UINT32 offset = (UINT32) MAX(alignment, APP_MEMORY_HEADER_SIZE);
+
+    return chargeAppMemory((PBYTE) gAppMemoryAlignAlloc(size + offset, alignment), offset, gAppMemoryTag, gAppMemorySession, size);
+}
+
+static PVOID appMemoryCalloc(SIZE_T num, SIZE_T size)
+{
+    if (size != 0 && num > ((SIZE_T) -1 - APP_MEMORY_HEADER_SIZE) / size) {
+        return NULL;
+    }
+    return chargeAppMemory((PBYTE) gAppMemoryCalloc(1, num * size + APP_MEMORY_HEADER_SIZE), APP_MEMORY_HEADER_SIZE, gAppMemoryTag,
+                           gAppMemorySession, num * size);
+}
+
+static PVOID appMemoryRealloc(PVOID ptr, SIZE_T size)
+{
+    PAppMemoryHeader pHeader;
+    APP_MEMORY_TAG tag;
+    UINT32 session;
+    PBYTE pBlock;
+    PVOID pNew;
+
+    if (ptr == NULL) {
+        return appMemoryAlloc(size);
+    }
+
+    // the block stays with the subsystem and the session which allocated it.
+    pHeader = APP_MEMORY_GET_HEADER(ptr);
+    tag = (APP_MEMORY_TAG) pHeader->tag;
+    session = pHeader->session;
+    if (pHeader->offset != APP_MEMORY_HEADER_SIZE) {
+        // an aligned block can not be moved by realloc, the offset is its alignment.
+        pNew = chargeAppMemory((PBYTE) gAppMemoryAlignAlloc(size + pHeader->offset, pHeader->offset), pHeader->offset, tag, session, size);
+        if (pNew != NULL) {
+            MEMCPY(pNew, ptr, MIN(size, (SIZE_T) pHeader->size));
+            gAppMemoryFree(releaseAppMemory(ptr));
+        }
+        return pNew;
+    }
+
+    pBlock = (PBYTE) gAppMemoryRealloc((PBYTE) ptr - APP_MEMORY_HEADER_SIZE, size + APP_MEMORY_HEADER_SIZE);
+    if (pBlock == NULL) {
+        return NULL;
+    }
+    // the old block is gone, so release it through the header copied into the new one.
+    releaseAppMemory(pBlock + APP_MEMORY_HEADER_SIZE);
+    return chargeAppMemory(pBlock, APP_MEMORY_HEADER_SIZE, tag, session, size);
+}
+
+static VOID appMemoryFree(PVOID ptr)
+{
+    if (ptr != NULL) {
+        gAppMemoryFree(releaseAppMemory(ptr));
+    }
+}
+
+STATUS initAppMemory()
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(!ATOMIC_EXCHANGE_BOOL(&gAppMemoryInitialized, TRUE), STATUS_APP_MEMORY_INITIALIZED);
+
+    MEMSET(gAppMemoryStats, 0x00, SIZEOF(gAppMemoryStats));
+    MEMSET(gAppMemorySessions, 0x00, SIZEOF(gAppMemorySessions));
+    gAppMemoryLogTime = GETTIME();
+    gAppMemoryAlloc = globalMemAlloc;
+    gAppMemoryAlignAlloc = globalMemAlignAlloc;
+    gAppMemoryCalloc = globalMemCalloc;
+    gAppMemoryRealloc = globalMemRealloc;
+    gAppMemoryFree = globalMemFree;
+
+    globalMemAlloc = appMemoryAlloc;
+    globalMemAlignAlloc = appMemoryAlignAlloc;
+    globalMemCalloc = appMemoryCalloc;
+    globalMemRealloc = appMemoryRealloc;
+    globalMemFree = appMemoryFree;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS deinitAppMemory()
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT64 liveCount, totalLiveCount = 0;
+    UINT32 i;
+
+    CHK(ATOMIC_LOAD_BOOL(&gAppMemoryInitialized), STATUS_APP_MEMORY_NOT_INITIALIZED);
+
+    for (i = 0; i < APP_MEMORY_TAG_COUNT; i++) {
+        liveCount = (UINT64) (ATOMIC_LOAD(&gAppMemoryStats[i].allocCount) - ATOMIC_LOAD(&gAppMemoryStats[i].freeCount));
+        if (liveCount != 0) {
+            DLOGW("%s still holds %" PRIu64 " bytes in %" PRIu64 " allocations", gAppMemoryTagNames[i], (UINT64) gAppMemoryStats[i].liveBytes,
+                  liveCount);
+        }
+        totalLiveCount += liveCount;
+    }
+    // The restored allocators would free a live block at its pointer instead of its header.
+    CHK_WARN(totalLiveCount == 0, STATUS_APP_MEMORY_BLOCKS_LIVE, "The tagged allocators stay installed for %" PRIu64 " live blocks",
+             totalLiveCount);
+    CHK(ATOMIC_EXCHANGE_BOOL(&gAppMemoryInitialized, FALSE), STATUS_APP_MEMORY_NOT_INITIALIZED);
+
+    globalMemAlloc = gAppMemoryAlloc;
+    globalMemAlignAlloc = gAppMemoryAlignAlloc;
+    globalMemCalloc = gAppMemoryCalloc;
+    globalMemRealloc = gAppMemoryRealloc;
+    globalMemFree = gAppMemoryFree;
+
+CleanUp:
+
+    return retStatus;
+}
+
+APP_MEMORY_TAG setAppMemoryTag(APP_MEMORY_TAG tag)
+{
+    APP_MEMORY_TAG prevTag = gAppMemoryTag;
+
+    if (tag < APP_MEMORY_TAG_COUNT) {
+        gAppMemoryTag = tag;
+    }
+    return prevTag;
+}
+
+PVOID callocAppMemory(APP_MEMORY_TAG tag, SIZE_T num, SIZE_T size)
+{
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(tag);
+    PVOID ptr = MEMCALLOC(num, size);
+
+    setAppMemoryTag(prevTag);
+    return ptr;
+}
+
+STATUS openAppMemorySession(PUINT32 pSessionId)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMemorySession pSession;
+    SIZE_T expected;
+    UINT32 i;
+
+    CHK(pSessionId != NULL, STATUS_APP_MEMORY_NULL_ARG);
+    *pSessionId = APP_MEMORY_NO_SESSION;
+
+    for (i = 0; i < ARRAY_SIZE(gAppMemorySessions); i++) {
+        pSession = &gAppMemorySessions[i];
+        expected = 0;
+        // a block of the session before would be released from the counters of the new one.
+        if (ATOMIC_LOAD(&pSession->open) == 0 && ATOMIC_LOAD(&pSession->stats.allocCount) == ATOMIC_LOAD(&pSession->stats.freeCount) &&
+            ATOMIC_COMPARE_EXCHANGE(&pSession->open, &expected, 1)) {
+            MEMSET(&pSession->stats, 0x00, SIZEOF(AppMemoryStats));
+            *pSessionId = i + 1;
+            break;
+        }
+    }
+    CHK(*pSessionId != APP_MEMORY_NO_SESSION, STATUS_APP_MEMORY_NO_SESSION_SLOT);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS closeAppMemorySession(UINT32 sessionId)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMemoryStats pStats;
+    UINT64 liveCount;
+
+    CHK(sessionId != APP_MEMORY_NO_SESSION, retStatus);
+    CHK(sessionId <= ARRAY_SIZE(gAppMemorySessions), STATUS_APP_MEMORY_INVALID_SESSION);
+
+    pStats = &gAppMemorySessions[sessionId - 1].stats;
+    liveCount = (UINT64) (ATOMIC_LOAD(&pStats->allocCount) - ATOMIC_LOAD(&pStats->freeCount));
+    if (liveCount != 0) {
+        DLOGI("session %u still holds %" PRIu64 " bytes in %" PRIu64 " allocations", sessionId, (UINT64) ATOMIC_LOAD(&pStats->liveBytes),
+              liveCount);
+    }
+    ATOMIC_STORE(&gAppMemorySessions[sessionId - 1].open, 0);
+
+CleanUp:
+
+    return retStatus;
+}
+
+UINT32 setAppMemorySession(UINT32 sessionId)
+{
+    UINT32 prevSession = gAppMemorySession;
+
+    if (sessionId <= ARRAY_SIZE(gAppMemorySessions)) {
+        gAppMemorySession = sessionId;
+    }
+    return prevSession;
+}
+
+STATUS getAppMemorySessionStats(UINT32 sessionId, PAppMemoryStats* ppStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(ppStats != NULL, STATUS_APP_MEMORY_NULL_ARG);
+    CHK(sessionId != APP_MEMORY_NO_SESSION && sessionId <= ARRAY_SIZE(gAppMemorySessions), STATUS_APP_MEMORY_INVALID_SESSION);
+
+    *ppStats = &gAppMemorySessions[sessionId - 1].stats;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS getAppMemoryStats(APP_MEMORY_TAG tag, PAppMemoryStats* ppStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(ppStats != NULL, STATUS_APP_MEMORY_NULL_ARG);
+    CHK(tag < APP_MEMORY_TAG_COUNT, STATUS_APP_MEMORY_INVALID_TAG);
+
+    *ppStats = &gAppMemoryStats[tag];
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS reportAppMemory(PAppMetricsRegistry pRegistry)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMemoryStats pStats;
+    CHAR record[APP_MEMORY_RECORD_LEN + 1];
+    UINT64 now = GETTIME();
+    UINT64 liveBytes, sessionBytes = 0, maxSessionBytes = 0;
+    SIZE_T allocBytes;
+    UINT32 i, recordLen = 0, sessionCount = 0;
+    UINT32 metricId;
+
+    for (i = 0; i < APP_MEMORY_TAG_COUNT; i++) {
+        pStats = &gAppMemoryStats[i];
+        allocBytes = ATOMIC_LOAD(&pStats->allocBytes);
+        if (pStats->lastReportTime != 0 && now > pStats->lastReportTime) {
+            pStats->allocRate = (DOUBLE) (allocBytes - pStats->lastAllocBytes) * HUNDREDS_OF_NANOS_IN_A_SECOND / (now - pStats->lastReportTime);
+        }
+        pStats->lastAllocBytes = allocBytes;
+        pStats->lastReportTime = now;
+
+        if (recordLen < APP_MEMORY_RECORD_LEN) {
+            recordLen += SNPRINTF(record + recordLen, APP_MEMORY_RECORD_LEN + 1 - recordLen, "%s%s %" PRIu64 " B (%.0lf B/s)", i == 0 ? "" : ", ",
+                                  gAppMemoryTagNames[i], (UINT64) ATOMIC_LOAD(&pStats->liveBytes), pStats->allocRate);
+        }
+
+        if (pRegistry != NULL) {
+            setAppGauge(pRegistry, "webrtc_app_memory_live_bytes", "The bytes allocated and not yet freed.", "subsystem", gAppMemoryTagNames[i],
+                        (DOUBLE) ATOMIC_LOAD(&pStats->liveBytes));
+            setAppGauge(pRegistry, "webrtc_app_memory_allocation_rate_bytes", "The bytes allocated per second since the last collection.",
+                        "subsystem", gAppMemoryTagNames[i], pStats->allocRate);
+            if (STATUS_SUCCEEDED(registerAppMetric(pRegistry, "webrtc_app_memory_allocations_total", "The number of allocations.",
+                                                   APP_METRIC_TYPE_COUNTER, "subsystem", gAppMemoryTagNames[i], NULL, 0, &metricId))) {
+                setAppMetric(pRegistry, metricId, (DOUBLE) ATOMIC_LOAD(&pStats->allocCount));
+            }
+        }
+    }
+
+    if (now >= gAppMemoryLogTime + APP_MEMORY_LOG_PERIOD) {
+        gAppMemoryLogTime = now;
+        // the sessions hold what is charged to them across the subsystems, the sdk included.
+        for (i = 0; i < ARRAY_SIZE(gAppMemorySessions); i++) {
+            if (ATOMIC_LOAD(&gAppMemorySessions[i].open) != 0) {
+                liveBytes = (UINT64) ATOMIC_LOAD(&gAppMemorySessions[i].stats.liveBytes);
+                sessionBytes += liveBytes;
+                maxSessionBytes = MAX(maxSessionBytes, liveBytes);
+                sessionCount++;
+            }
+        }
+        DLOGI("memory: %s, %u sessions, %" PRIu64 " B per session, %" PRIu64 " B at most", record, sessionCount,
+              sessionCount == 0 ? (UINT64) 0 : sessionBytes / sessionCount, maxSessionBytes);
+    }
+
+    return retStatus;
+}
@@ -15,12 +15,14 @@
 #define LOG_CLASS "AppMessageQueue"
 #include "AppMessageQueue.h"
 #include "AppQueueWrap.h"
+#include "AppMemory.h"
 
 STATUS createPendingMsgQ(PConnectionMsgQ pConnectionMsgQ, UINT64 hashValue, PPendingMessageQueue* ppPendingMessageQueue)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PStackQueue pConnection = NULL;
     PPendingMessageQueue pPendingMessageQueue = NULL;
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_PENDING_QUEUE);
 
     CHK((pConnectionMsgQ != NULL) && (ppPendingMessageQueue != NULL), STATUS_APP_MSGQ_NULL_ARG);
     pConnection = pConnectionMsgQ->pMsqQueue;
@@ -33,6 +35,7 @@ STATUS createPendingMsgQ(PConnectionMsgQ pConnectionMsgQ, UINT64 hashValue, PPen
     CHK(appQueueEnqueue(pConnection, (UINT64) pPendingMessageQueue) == STATUS_SUCCESS, STATUS_APP_MSGQ_PUSH_CONN_MSQ);
 
 CleanUp:
+    setAppMemoryTag(prevTag);
     if (STATUS_FAILED(retStatus) && pPendingMessageQueue != NULL) {
         freePendingMsgQ(pPendingMessageQueue);
         pPendingMessageQueue = NULL;
@@ -49,6 +52,7 @@ STATUS pushMsqIntoPendingMsgQ(PPendingMessageQueue pPendingMsgQ, PReceivedSignal
 {
     STATUS retStatus = STATUS_SUCCESS;
     PReceivedSignalingMessage pReceivedSignalingMessageCopy = NULL;
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_PENDING_QUEUE);
 
     CHK((pPendingMsgQ != NULL) && (pMsg != NULL), STATUS_APP_MSGQ_NULL_ARG);
     CHK(NULL != (pReceivedSignalingMessageCopy = (PReceivedSignalingMessage) MEMCALLOC(1, SIZEOF(ReceivedSignalingMessage))),
@@ -57,6 +61,7 @@ STATUS pushMsqIntoPendingMsgQ(PPendingMessageQueue pPendingMsgQ, PReceivedSignal
     CHK(appQueueEnqueue(pPendingMsgQ->messageQueue, (UINT64) pReceivedSignalingMessageCopy) == STATUS_SUCCESS, STATUS_APP_MSGQ_PUSH_PENDING_MSQ);
 
 CleanUp:
+    setAppMemoryTag(prevTag);
     if (STATUS_FAILED(retStatus)) {
         SAFE_MEMFREE(pReceivedSignalingMessageCopy);
     }
@@ -118,6 +123,7 @@ STATUS createConnectionMsqQ(PConnectionMsgQ* ppConnectionMsgQ)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PConnectionMsgQ pConnectionMsgQ = NULL;
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_PENDING_QUEUE);
 
     CHK(ppConnectionMsgQ != NULL, STATUS_APP_MSGQ_NULL_ARG);
     pConnectionMsgQ = MEMCALLOC(1, SIZEOF(ConnectionMsgQ));
@@ -126,6 +132,8 @@ STATUS createConnectionMsqQ(PConnectionMsgQ* ppConnectionMsgQ)
 
 CleanUp:
 
+    setAppMemoryTag(prevTag);
+
     if (STATUS_FAILED(retStatus) && pConnectionMsgQ != NULL) {
         freeConnectionMsgQ(&pConnectionMsgQ);
     }
@@ -62,28 +62,74 @@ STATUS closeFileLogging(VOID)
     return retStatus;
 }
 
-STATUS logIceServerStats(PRtcPeerConnection pRtcPeerConnection, UINT32 index)
+STATUS getIceServerStats(PRtcPeerConnection pRtcPeerConnection, UINT32 index, PRtcIceServerStats pRtcIceServerStats)
 {
-    ENTERS();
     STATUS retStatus = STATUS_SUCCESS;
     RtcStats rtcmetrics;
-    CHK(pRtcPeerConnection != NULL, STATUS_APP_METRICS_NULL_ARG);
+    CHK(pRtcPeerConnection != NULL && pRtcIceServerStats != NULL, STATUS_APP_METRICS_NULL_ARG);
 
     rtcmetrics.requestedTypeOfStats = RTC_STATS_TYPE_ICE_SERVER;
     rtcmetrics.rtcStatsObject.iceServerStats.iceServerIndex = index;
     CHK(rtcPeerConnectionGetMetrics(pRtcPeerConnection, NULL, &rtcmetrics) == STATUS_SUCCESS, STATUS_APP_METRICS_ICE_SERVER);
-    DLOGD("ICE Server URL: %s", rtcmetrics.rtcStatsObject.iceServerStats.url);
-    DLOGD("ICE Server port: %d", rtcmetrics.rtcStatsObject.iceServerStats.port);
-    DLOGD("ICE Server protocol: %s", rtcmetrics.rtcStatsObject.iceServerStats.protocol);
-    DLOGD("Total requests sent:%" PRIu64, rtcmetrics.rtcStatsObject.iceServerStats.totalRequestsSent);
-    DLOGD("Total responses received: %" PRIu64, rtcmetrics.rtcStatsObject.iceServerStats.totalResponsesReceived);
-    DLOGD("Total round trip time: %" PRIu64 "ms", rtcmetrics.rtcStatsObject.iceServerStats.totalRoundTripTime / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    MEMCPY(pRtcIceServerStats, &rtcmetrics.rtcStatsObject.iceServerStats, SIZEOF(RtcIceServerStats));
+
+CleanUp:
+    return retStatus;
+}
+
+STATUS logIceServerStats(PRtcPeerConnection pRtcPeerConnection, UINT32 index)
+{
+    ENTERS();
+    STATUS retStatus = STATUS_SUCCESS;
+    RtcIceServerStats iceServerStats;
+
+    CHK_STATUS((getIceServerStats(pRtcPeerConnection, index, &iceServerStats)));
+    DLOGD("ICE Server URL: %s", iceServerStats.url);
+    DLOGD("ICE Server port: %d", iceServerStats.port);
+    DLOGD("ICE Server protocol: %s", iceServerStats.protocol);
+    DLOGD("Total requests sent:%" PRIu64, iceServerStats.totalRequestsSent);
+    DLOGD("Total responses received: %" PRIu64, iceServerStats.totalResponsesReceived);
+    DLOGD("Total round trip time: %" PRIu64 "ms", iceServerStats.totalRoundTripTime / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
 
 CleanUp:
     LEAVES();
     return retStatus;
 }
 
+STATUS getRtpQualityStats(PRtcPeerConnection pRtcPeerConnection, PRtcRtpTransceiver pRtcRtpTransceiver, PAppRtpQualityStats pQualityStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    RtcStats rtcMetrics;
+    PRtcOutboundRtpStreamStats pOutboundStats = &rtcMetrics.rtcStatsObject.outboundRtpStreamStats;
+    PRtcRemoteInboundRtpStreamStats pRemoteInboundStats = &rtcMetrics.rtcStatsObject.remoteInboundRtpStreamStats;
+
+    CHK(pRtcPeerConnection != NULL && pRtcRtpTransceiver != NULL && pQualityStats != NULL, STATUS_APP_METRICS_NULL_ARG);
+
+    rtcMetrics.requestedTypeOfStats = RTC_STATS_TYPE_OUTBOUND_RTP;
+    CHK(rtcPeerConnectionGetMetrics(pRtcPeerConnection, pRtcRtpTransceiver, &rtcMetrics) == STATUS_SUCCESS, STATUS_APP_METRICS_OUTBOUND_RTP);
+    pQualityStats->packetsSent += pOutboundStats->sent.packetsSent;
+    pQualityStats->bytesSent += pOutboundStats->sent.bytesSent;
+    pQualityStats->retransmittedPacketsSent += pOutboundStats->retransmittedPacketsSent;
+    pQualityStats->retransmittedBytesSent += pOutboundStats->retransmittedBytesSent;
+    pQualityStats->nackCount += pOutboundStats->nackCount;
+    pQualityStats->pliCount += pOutboundStats->pliCount;
+    pQualityStats->firCount += pOutboundStats->firCount;
+
+    // The remote inbound stats stay empty until the first receiver report of the viewer.
+    rtcMetrics.requestedTypeOfStats = RTC_STATS_TYPE_REMOTE_INBOUND_RTP;
+    CHK(rtcPeerConnectionGetMetrics(pRtcPeerConnection, pRtcRtpTransceiver, &rtcMetrics) == STATUS_SUCCESS, STATUS_APP_METRICS_REMOTE_INBOUND_RTP);
+    if (pRemoteInboundStats->reportsReceived > 0) {
+        pQualityStats->remoteReported = TRUE;
+        pQualityStats->packetsLost += pRemoteInboundStats->received.packetsLost;
+        pQualityStats->fractionLost = MAX(pQualityStats->fractionLost, pRemoteInboundStats->fractionLost);
+        pQualityStats->jitter = MAX(pQualityStats->jitter, pRemoteInboundStats->received.jitter);
+        pQualityStats->roundTripTime = MAX(pQualityStats->roundTripTime, pRemoteInboundStats->roundTripTime);
+    }
+
+CleanUp:
+    return retStatus;
+}
+
 STATUS logSelectedIceCandidatesInformation(PRtcPeerConnection pRtcPeerConnection)
 {
     ENTERS();
@@ -0,0 +1,813 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define LOG_CLASS "AppMetricsRegistry"
+#include "AppMetricsRegistry.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef struct {
+    PCHAR pBuffer; //!< NULL to measure the text only.
+    UINT32 size;   //!< the size of the buffer.
+    UINT32 length; //!< the length of the text, it can exceed the size.
+} AppMetricsWriter, *PAppMetricsWriter;
+
+typedef struct {
+    INT32 fd;          //!< the connection of the scraper, -1 for a free slot.
+    UINT64 deadline;   //!< the time the request line must be read by.
+    CHAR request[256]; //!< the request read so far.
+    UINT32 length;     //!< the length of the request read so far.
+} AppMetricsClient, *PAppMetricsClient;
+
+// The values are updated from the media threads without the lock of the registry, which only guards the slots, so a scrape
+// never stalls a frame. The counts are relaxed atomics, the doubles are swapped in whole.
+#define APP_METRIC_LOAD(p)      __atomic_load_n((p), __ATOMIC_RELAXED)
+#define APP_METRIC_INCREMENT(p) __atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+
+// The id of a metric is its slot in the low bits and the generation of the slot in the high bits.
+#define APP_METRIC_ID_SLOT_BITS         16
+#define APP_METRIC_ID_SLOT_MASK         ((1 << APP_METRIC_ID_SLOT_BITS) - 1)
+#define APP_METRIC_ID(slot, generation) ((((generation) & APP_METRIC_ID_SLOT_MASK) << APP_METRIC_ID_SLOT_BITS) | (slot))
+
+static DOUBLE loadAppMetricDouble(PDOUBLE pValue)
+{
+    DOUBLE value;
+
+    __atomic_load(pValue, &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+static VOID addAppMetricDouble(PDOUBLE pValue, DOUBLE delta)
+{
+    DOUBLE expected, desired;
+
+    __atomic_load(pValue, &expected, __ATOMIC_RELAXED);
+    do {
+        desired = expected + delta;
+    } while (!__atomic_compare_exchange(pValue, &expected, &desired, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static VOID writeAppMetrics(PAppMetricsWriter pWriter, const CHAR* pFormat, ...)
+{
+    va_list args;
+    INT32 len;
+    PCHAR pCur = NULL;
+    UINT32 remaining = 0;
+
+    if (pWriter->pBuffer != NULL && pWriter->length < pWriter->size) {
+        pCur = pWriter->pBuffer + pWriter->length;
+        remaining = pWriter->size - pWriter->length;
+    }
+
+    va_start(args, pFormat);
+    len = vsnprintf(pCur, remaining, pFormat, args);
+    va_end(args);
+
+    if (len > 0) {
+        pWriter->length += (UINT32) len;
+    }
+}
+
+/**
+ * @brief render the labels of a metric, escaping the values as the text format requires.
+ */
+static STATUS buildAppMetricLabels(PCHAR pChannel, PCHAR pLabelName, PCHAR pLabelValue, PCHAR pLabels)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pValues[2] = {pChannel, pLabelValue};
+    PCHAR pNames[2] = {(PCHAR) "channel", pLabelName};
+    PCHAR pCur;
+    UINT32 i, len = 0;
+
+    for (i = 0; i < ARRAY_SIZE(pNames) && pNames[i] != NULL; i++) {
+        CHK(pValues[i] != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+        len += SNPRINTF(pLabels + len, APP_METRICS_LABELS_LEN + 1 - len, "%s%s=\"", i == 0 ? "" : ",", pNames[i]);
+        CHK(len < APP_METRICS_LABELS_LEN, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+        for (pCur = pValues[i]; *pCur != '\0'; pCur++) {
+            // the longest escape takes 2 chars, and the closing quote takes one more.
+            CHK(len + 3 < APP_METRICS_LABELS_LEN, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+            if (*pCur == '\\' || *pCur == '"') {
+                pLabels[len++] = '\\';
+                pLabels[len++] = *pCur;
+            } else if (*pCur == '\n') {
+                pLabels[len++] = '\\';
+                pLabels[len++] = 'n';
+            } else {
+                pLabels[len++] = *pCur;
+            }
+        }
+        pLabels[len++] = '"';
+        pLabels[len] = '\0';
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+/**
+ * @brief get the metric of the id. It does not need the lock, the slot is published once it is set up. An id of a removed
+ *        metric has an old generation and is refused, and the summary buckets live until the registry is freed, so an update
+ *        racing with the removal still lands in valid memory.
+ */
+static PAppMetric getAppMetric(PAppMetricsRegistry pRegistry, UINT32 metricId)
+{
+    UINT32 slot = metricId & APP_METRIC_ID_SLOT_MASK;
+    PAppMetric pMetric;
+
+    if (slot >= APP_METRIC_LOAD(&pRegistry->metricCount)) {
+        return NULL;
+    }
+    pMetric = &pRegistry->metrics[slot];
+    if (!__atomic_load_n(&pMetric->used, __ATOMIC_ACQUIRE) ||
+        APP_METRIC_ID(slot, __atomic_load_n(&pMetric->generation, __ATOMIC_ACQUIRE)) != metricId) {
+        return NULL;
+    }
+    return pMetric;
+}
+
+/**
+ * @brief get the log-linear bucket of a value, the way the hdr histogram does. The values below APP_METRICS_HDR_SUB_BUCKETS
+ *        get a bucket each, and every further power of two is split into APP_METRICS_HDR_SUB_BUCKETS / 2 linear buckets.
+ */
+static UINT32 getAppMetricHdrIndex(UINT64 value)
+{
+    UINT32 msb = 0, shift;
+    UINT64 remaining;
+
+    value = MIN(value, ((UINT64) 1 << APP_METRICS_HDR_VALUE_BITS) - 1);
+    if (value < APP_METRICS_HDR_SUB_BUCKETS) {
+        return (UINT32) value;
+    }
+    for (remaining = value; remaining > 1; remaining >>= 1) {
+        msb++;
+    }
+    shift = msb - (APP_METRICS_HDR_SUB_BUCKET_BITS - 1);
+    return APP_METRICS_HDR_SUB_BUCKETS + (shift - 1) * (APP_METRICS_HDR_SUB_BUCKETS / 2) + (UINT32) (value >> shift) -
+        APP_METRICS_HDR_SUB_BUCKETS / 2;
+}
+
+/**
+ * @brief get the highest value of a log-linear bucket.
+ */
+static UINT64 getAppMetricHdrUpperValue(UINT32 index)
+{
+    UINT32 shift;
+    UINT64 subBucket;
+
+    if (index < APP_METRICS_HDR_SUB_BUCKETS) {
+        return index;
+    }
+    shift = (index - APP_METRICS_HDR_SUB_BUCKETS) / (APP_METRICS_HDR_SUB_BUCKETS / 2) + 1;
+    subBucket = (index - APP_METRICS_HDR_SUB_BUCKETS) % (APP_METRICS_HDR_SUB_BUCKETS / 2) + APP_METRICS_HDR_SUB_BUCKETS / 2;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+/**
+ * @brief get a quantile of a summary. The observations may go on meanwhile, the buckets only lag the count.
+ */
+static DOUBLE getAppMetricHdrQuantile(PAppMetric pMetric, DOUBLE quantile)
+{
+    UINT64 rank, count, cumulativeCount = 0;
+    UINT32 i;
+
+    if ((count = APP_METRIC_LOAD(&pMetric->count)) == 0) {
+        return 0;
+    }
+    // The rank of the quantile, rounded up.
+    rank = (UINT64) (quantile * count);
+    if ((DOUBLE) rank < quantile * count || rank == 0) {
+        rank++;
+    }
+    for (i = 0; i < APP_METRICS_HDR_BUCKET_COUNT - 1; i++) {
+        cumulativeCount += APP_METRIC_LOAD(&pMetric->pHdrCounts[i]);
+        if (cumulativeCount >= rank) {
+            break;
+        }
+    }
+    return getAppMetricHdrUpperValue(i) * APP_METRICS_HDR_UNIT;
+}
+
+static VOID renderAppMetric(PAppMetricsWriter pWriter, PAppMetric pMetric)
+{
+    UINT64 cumulativeCount = 0;
+    UINT32 i;
+    static const DOUBLE quantiles[] = {0.5, 0.99, 0.999};
+
+    if (pMetric->type == APP_METRIC_TYPE_COUNTER || pMetric->type == APP_METRIC_TYPE_GAUGE) {
+        writeAppMetrics(pWriter, "%s{%s} %.15g\n", pMetric->name, pMetric->labels, loadAppMetricDouble(&pMetric->value));
+        return;
+    }
+
+    if (pMetric->type == APP_METRIC_TYPE_SUMMARY) {
+        for (i = 0; i < ARRAY_SIZE(quantiles); i++) {
+            writeAppMetrics(pWriter, "%s{%s,quantile=\"%g\"} %.15g\n", pMetric->name, pMetric->labels, quantiles[i],
+                            getAppMetricHdrQuantile(pMetric, quantiles[i]));
+        }
+        writeAppMetrics(pWriter, "%s_sum{%s} %.15g\n", pMetric->name, pMetric->labels, loadAppMetricDouble(&pMetric->sum));
+        writeAppMetrics(pWriter, "%s_count{%s} %" PRIu64 "\n", pMetric->name, pMetric->labels, APP_METRIC_LOAD(&pMetric->count));
+        return;
+    }
+
+    // The +Inf bucket and the count are the sum of the buckets read, so they agree with the buckets while observations go on.
+    for (i = 0; i < pMetric->boundCount; i++) {
+        cumulativeCount += APP_METRIC_LOAD(&pMetric->bucketCounts[i]);
+        writeAppMetrics(pWriter, "%s_bucket{%s,le=\"%g\"} %" PRIu64 "\n", pMetric->name, pMetric->labels, pMetric->bounds[i], cumulativeCount);
+    }
+    cumulativeCount += APP_METRIC_LOAD(&pMetric->bucketCounts[pMetric->boundCount]);
+    writeAppMetrics(pWriter, "%s_bucket{%s,le=\"+Inf\"} %" PRIu64 "\n", pMetric->name, pMetric->labels, cumulativeCount);
+    writeAppMetrics(pWriter, "%s_sum{%s} %.15g\n", pMetric->name, pMetric->labels, loadAppMetricDouble(&pMetric->sum));
+    writeAppMetrics(pWriter, "%s_count{%s} %" PRIu64 "\n", pMetric->name, pMetric->labels, cumulativeCount);
+}
+
+STATUS createAppMetricsRegistry(PCHAR pChannel, PAppMetricsRegistry* ppRegistry)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMetricsRegistry pRegistry = NULL;
+
+    CHK(pChannel != NULL && ppRegistry != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    CHK(NULL != (pRegistry = (PAppMetricsRegistry) MEMCALLOC(1, SIZEOF(AppMetricsRegistry))), STATUS_APP_METRICS_REGISTRY_NOT_ENOUGH_MEMORY);
+
+    STRNCPY(pRegistry->channel, pChannel, MAX_CHANNEL_NAME_LEN);
+    pRegistry->listenFd = -1;
+    pRegistry->exporterTid = INVALID_TID_VALUE;
+    ATOMIC_STORE_BOOL(&pRegistry->terminateExporter, FALSE);
+    pRegistry->lock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pRegistry->lock), STATUS_APP_METRICS_REGISTRY_INVALID_MUTEX);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        freeAppMetricsRegistry(&pRegistry);
+    }
+    if (ppRegistry != NULL) {
+        *ppRegistry = pRegistry;
+    }
+
+    return retStatus;
+}
+
+STATUS freeAppMetricsRegistry(PAppMetricsRegistry* ppRegistry)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMetricsRegistry pRegistry;
+    UINT32 i;
+
+    CHK(ppRegistry != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    pRegistry = *ppRegistry;
+    CHK(pRegistry != NULL, retStatus);
+
+    ATOMIC_STORE_BOOL(&pRegistry->terminateExporter, TRUE);
+    if (pRegistry->exporterTid != INVALID_TID_VALUE) {
+        THREAD_JOIN(pRegistry->exporterTid, NULL);
+    }
+    if (pRegistry->listenFd >= 0) {
+        close(pRegistry->listenFd);
+    }
+    if (pRegistry->unixPath[0] != '\0') {
+        unlink(pRegistry->unixPath);
+    }
+    // the removed slots past the count keep their buckets too.
+    for (i = 0; i < APP_METRICS_REGISTRY_MAX_COUNT; i++) {
+        SAFE_MEMFREE(pRegistry->metrics[i].pHdrCounts);
+    }
+    if (IS_VALID_MUTEX_VALUE(pRegistry->lock)) {
+        MUTEX_FREE(pRegistry->lock);
+    }
+    SAFE_MEMFREE(*ppRegistry);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS registerAppMetric(PAppMetricsRegistry pRegistry, PCHAR pName, PCHAR pHelp, APP_METRIC_TYPE type, PCHAR pLabelName, PCHAR pLabelValue,
+                         PDOUBLE pBounds, UINT32 boundCount, PUINT32 pMetricId)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR labels[APP_METRICS_LABELS_LEN + 1];
+    PAppMetric pMetric = NULL;
+    PUINT32 pHdrCounts;
+    UINT32 i, generation, freeSlot = MAX_UINT32;
+    BOOL locked = FALSE;
+
+    CHK(pRegistry != NULL && pName != NULL && pHelp != NULL && pMetricId != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    CHK(STRLEN(pName) <= APP_METRICS_NAME_LEN, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+    if (type == APP_METRIC_TYPE_HISTOGRAM) {
+        CHK(pBounds != NULL && boundCount != 0 && boundCount <= APP_METRICS_MAX_BUCKETS, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+        for (i = 1; i < boundCount; i++) {
+            CHK(pBounds[i - 1] < pBounds[i], STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+        }
+    }
+    CHK_STATUS((buildAppMetricLabels(pRegistry->channel, pLabelName, pLabelValue, labels)));
+
+    MUTEX_LOCK(pRegistry->lock);
+    locked = TRUE;
+
+    for (i = 0; i < pRegistry->metricCount; i++) {
+        if (!pRegistry->metrics[i].used) {
+            freeSlot = MIN(freeSlot, i);
+        } else if (STRCMP(pRegistry->metrics[i].name, pName) == 0 && STRCMP(pRegistry->metrics[i].labels, labels) == 0) {
+            CHK(pRegistry->metrics[i].type == type, STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH);
+            *pMetricId = APP_METRIC_ID(i, pRegistry->metrics[i].generation);
+            CHK(FALSE, STATUS_SUCCESS);
+        }
+    }
+
+    if (freeSlot == MAX_UINT32) {
+        CHK(pRegistry->metricCount < APP_METRICS_REGISTRY_MAX_COUNT, STATUS_APP_METRICS_REGISTRY_FULL);
+        freeSlot = pRegistry->metricCount;
+        __atomic_store_n(&pRegistry->metricCount, freeSlot + 1, __ATOMIC_RELAXED);
+    }
+
+    pMetric = &pRegistry->metrics[freeSlot];
+    // A stale update may still hold the buckets of the slot, they are reused instead of freed.
+    pHdrCounts = pMetric->pHdrCounts;
+    generation = pMetric->generation;
+    MEMSET(pMetric, 0x00, SIZEOF(AppMetric));
+    pMetric->pHdrCounts = pHdrCounts;
+    pMetric->generation = generation;
+    pMetric->type = type;
+    STRNCPY(pMetric->name, pName, APP_METRICS_NAME_LEN);
+    pMetric->pHelp = pHelp;
+    STRNCPY(pMetric->labels, labels, APP_METRICS_LABELS_LEN);
+    if (type == APP_METRIC_TYPE_HISTOGRAM) {
+        pMetric->boundCount = boundCount;
+        MEMCPY(pMetric->bounds, pBounds, boundCount * SIZEOF(DOUBLE));
+    } else if (type == APP_METRIC_TYPE_SUMMARY) {
+        if (pMetric->pHdrCounts == NULL) {
+            pMetric->pHdrCounts = (PUINT32) MEMCALLOC(APP_METRICS_HDR_BUCKET_COUNT, SIZEOF(UINT32));
+            CHK(pMetric->pHdrCounts != NULL, STATUS_APP_METRICS_REGISTRY_NOT_ENOUGH_MEMORY);
+        } else {
+            MEMSET(pMetric->pHdrCounts, 0x00, APP_METRICS_HDR_BUCKET_COUNT * SIZEOF(UINT32));
+        }
+    }
+    // publish the slot to the lock-free updates once it is set up.
+    __atomic_store_n(&pMetric->used, TRUE, __ATOMIC_RELEASE);
+    *pMetricId = APP_METRIC_ID(freeSlot, generation);
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pRegistry->lock);
+    }
+
+    return retStatus;
+}
+
+STATUS setAppMetric(PAppMetricsRegistry pRegistry, UINT32 metricId, DOUBLE value)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMetric pMetric;
+
+    CHK(pRegistry != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    CHK((pMetric = getAppMetric(pRegistry, metricId)) != NULL, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+    CHK(pMetric->type == APP_METRIC_TYPE_COUNTER || pMetric->type == APP_METRIC_TYPE_GAUGE, STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH);
+    __atomic_store(&pMetric->value, &value, __ATOMIC_RELAXED);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS addAppMetric(PAppMetricsRegistry pRegistry, UINT32 metricId, DOUBLE delta)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMetric pMetric;
+
+    CHK(pRegistry != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    CHK((pMetric = getAppMetric(pRegistry, metricId)) != NULL, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+    CHK(pMetric->type == APP_METRIC_TYPE_COUNTER || pMetric->type == APP_METRIC_TYPE_GAUGE, STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH);
+    CHK(pMetric->type != APP_METRIC_TYPE_COUNTER || delta >= 0, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+    addAppMetricDouble(&pMetric->value, delta);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS observeAppMetric(PAppMetricsRegistry pRegistry, UINT32 metricId, DOUBLE value)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMetric pMetric;
+    UINT32 i;
+
+    CHK(pRegistry != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    CHK((pMetric = getAppMetric(pRegistry, metricId)) != NULL, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+    CHK(pMetric->type == APP_METRIC_TYPE_HISTOGRAM || pMetric->type == APP_METRIC_TYPE_SUMMARY, STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH);
+    // the bucket goes first so that a scrape never sees more observations in the count than in the buckets.
+    if (pMetric->type == APP_METRIC_TYPE_SUMMARY) {
+        APP_METRIC_INCREMENT(&pMetric->pHdrCounts[getAppMetricHdrIndex(value <= 0 ? 0 : (UINT64) (value / APP_METRICS_HDR_UNIT + 0.5))]);
+    } else {
+        for (i = 0; i < pMetric->boundCount && value > pMetric->bounds[i]; i++) {
+        }
+        APP_METRIC_INCREMENT(&pMetric->bucketCounts[i]);
+    }
+    addAppMetricDouble(&pMetric->sum, value);
+    APP_METRIC_INCREMENT(&pMetric->count);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS getAppMetricQuantile(PAppMetricsRegistry pRegistry, UINT32 metricId, DOUBLE quantile, PDOUBLE pValue)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppMetric pMetric;
+
+    CHK(pRegistry != NULL && pValue != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    CHK(quantile >= 0 && quantile <= 1, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+    CHK((pMetric = getAppMetric(pRegistry, metricId)) != NULL, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+    CHK(pMetric->type == APP_METRIC_TYPE_SUMMARY, STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH);
+    *pValue = getAppMetricHdrQuantile(pMetric, quantile);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS setAppGauge(PAppMetricsRegistry pRegistry, PCHAR pName, PCHAR pHelp, PCHAR pLabelName, PCHAR pLabelValue, DOUBLE value)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 metricId;
+
+    CHK_STATUS((registerAppMetric(pRegistry, pName, pHelp, APP_METRIC_TYPE_GAUGE, pLabelName, pLabelValue, NULL, 0, &metricId)));
+    CHK_STATUS((setAppMetric(pRegistry, metricId, value)));
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS removeAppMetrics(PAppMetricsRegistry pRegistry, PCHAR pLabelName, PCHAR pLabelValue)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR labels[APP_METRICS_LABELS_LEN + 1];
+    UINT32 i;
+    BOOL locked = FALSE;
+
+    CHK(pRegistry != NULL && pLabelName != NULL && pLabelValue != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    // A metric carries at most one label besides the channel, so the rendered labels match exactly.
+    CHK_STATUS((buildAppMetricLabels(pRegistry->channel, pLabelName, pLabelValue, labels)));
+
+    MUTEX_LOCK(pRegistry->lock);
+    locked = TRUE;
+
+    for (i = 0; i < pRegistry->metricCount; i++) {
+        if (pRegistry->metrics[i].used && STRCMP(pRegistry->metrics[i].labels, labels) == 0) {
+            // The old ids are refused from now on, the buckets stay for a reuse of the slot.
+            __atomic_store_n(&pRegistry->metrics[i].used, FALSE, __ATOMIC_RELEASE);
+            __atomic_store_n(&pRegistry->metrics[i].generation, pRegistry->metrics[i].generation + 1, __ATOMIC_RELEASE);
+        }
+    }
+    while (pRegistry->metricCount > 0 && !pRegistry->metrics[pRegistry->metricCount - 1].used) {
+        __atomic_store_n(&pRegistry->metricCount, pRegistry->metricCount - 1, __ATOMIC_RELAXED);
+    }
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pRegistry->lock);
+    }
+
+    return retStatus;
+}
+
+STATUS renderAppMetrics(PAppMetricsRegistry pRegistry, PCHAR pBuffer, PUINT32 pBufferLen)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    AppMetricsWriter writer;
+    PAppMetric pMetric;
+    UINT32 i, j;
+    BOOL locked = FALSE;
+    static const PCHAR typeNames[] = {(PCHAR) "counter", (PCHAR) "gauge", (PCHAR) "histogram", (PCHAR) "summary"};
+
+    CHK(pRegistry != NULL && pBufferLen != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    writer.pBuffer = pBuffer;
+    writer.size = pBuffer == NULL ? 0 : *pBufferLen;
+    writer.length = 0;
+
+    MUTEX_LOCK(pRegistry->lock);
+    locked = TRUE;
+
+    // The text format wants the samples of a family together, so render each family at its first metric.
+    for (i = 0; i < pRegistry->metricCount; i++) {
+        pMetric = &pRegistry->metrics[i];
+        if (!pMetric->used) {
+            continue;
+        }
+        for (j = 0; j < i; j++) {
+            if (pRegistry->metrics[j].used && STRCMP(pRegistry->metrics[j].name, pMetric->name) == 0) {
+                break;
+            }
+        }
+        if (j < i) {
+            continue;
+        }
+
+        writeAppMetrics(&writer, "# HELP %s %s\n# TYPE %s %s\n", pMetric->name, pMetric->pHelp, pMetric->name, typeNames[pMetric->type]);
+        for (j = i; j < pRegistry->metricCount; j++) {
+            if (pRegistry->metrics[j].used && STRCMP(pRegistry->metrics[j].name, pMetric->name) == 0) {
+                renderAppMetric(&writer, &pRegistry->metrics[j]);
+            }
+        }
+    }
+
+    MUTEX_UNLOCK(pRegistry->lock);
+    locked = FALSE;
+
+    // include the null terminator.
+    writer.length++;
+    if (pBuffer != NULL) {
+        if (*pBufferLen > 0) {
+            pBuffer[MIN(writer.length, *pBufferLen) - 1] = '\0';
+        }
+        CHK(writer.length <= *pBufferLen, STATUS_APP_METRICS_REGISTRY_BUFFER_TOO_SMALL);
+    }
+    *pBufferLen = writer.length;
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pRegistry->lock);
+    }
+
+    return retStatus;
+}
+
+/**
+ * @brief write all the bytes to the socket.
+ */
+static STATUS sendAppMetricsResponse(INT32 fd, PCHAR pData, UINT32 len)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    ssize_t sent;
+
+    while (len > 0) {
+        sent = send(fd, pData, len, MSG_NOSIGNAL);
+        CHK(sent > 0, STATUS_APP_METRICS_REGISTRY_SOCKET);
+        pData += sent;
+        len -= (UINT32) sent;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+/**
+ * @brief serve one scrape. Only the request line is looked at, the headers are ignored.
+ */
+static VOID serveAppMetricsScrape(PAppMetricsRegistry pRegistry, INT32 fd, PCHAR pRequest)
+{
+    CHAR header[128];
+    PCHAR pBody = NULL;
+    UINT32 bodyLen = 0, i;
+
+    if (STRNCMP(pRequest, "GET / ", 6) != 0 && STRNCMP(pRequest, "GET /metrics ", 13) != 0 && STRNCMP(pRequest, "GET /metrics?", 13) != 0) {
+        SNPRINTF(header, SIZEOF(header), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        sendAppMetricsResponse(fd, header, (UINT32) STRLEN(header));
+        return;
+    }
+
+    // The metrics can grow between the size query and the rendering, so retry a few times.
+    for (i = 0; i < 3; i++) {
+        SAFE_MEMFREE(pBody);
+        if (STATUS_FAILED(renderAppMetrics(pRegistry, NULL, &bodyLen)) || (pBody = (PCHAR) MEMALLOC(bodyLen)) == NULL) {
+            break;
+        }
+        if (STATUS_SUCCEEDED(renderAppMetrics(pRegistry, pBody, &bodyLen))) {
+            break;
+        }
+    }
+
+    if (pBody == NULL || i == 3) {
+        SNPRINTF(header, SIZEOF(header), "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        sendAppMetricsResponse(fd, header, (UINT32) STRLEN(header));
+    } else {
+        // drop the null terminator.
+        bodyLen--;
+        SNPRINTF(header, SIZEOF(header),
+                 "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %u\r\nConnection: close\r\n\r\n", bodyLen);
+        if (STATUS_SUCCEEDED(sendAppMetricsResponse(fd, header, (UINT32) STRLEN(header)))) {
+            sendAppMetricsResponse(fd, pBody, bodyLen);
+        }
+    }
+
+    SAFE_MEMFREE(pBody);
+}
+
+static VOID closeAppMetricsClient(PAppMetricsClient pClient)
+{
+    close(pClient->fd);
+    pClient->fd = -1;
+}
+
+/**
+ * @brief read what the scraper sent so far without blocking, and serve the scrape once the request line is complete.
+ */
+static VOID readAppMetricsClient(PAppMetricsRegistry pRegistry, PAppMetricsClient pClient)
+{
+    ssize_t len;
+
+    len = recv(pClient->fd, pClient->request + pClient->length, SIZEOF(pClient->request) - 1 - pClient->length, MSG_DONTWAIT);
+    if (len <= 0) {
+        if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            closeAppMetricsClient(pClient);
+        }
+        return;
+    }
+    pClient->length += (UINT32) len;
+    pClient->request[pClient->length] = '\0';
+
+    if (STRCHR(pClient->request, '\n') != NULL || pClient->length == SIZEOF(pClient->request) - 1) {
+        serveAppMetricsScrape(pRegistry, pClient->fd, pClient->request);
+        closeAppMetricsClient(pClient);
+    }
+}
+
+static VOID acceptAppMetricsClient(PAppMetricsRegistry pRegistry, PAppMetricsClient pClients)
+{
+    struct timeval timeout = {APP_METRICS_EXPORTER_IO_TIMEOUT_S, 0};
+    INT32 fd;
+    UINT32 i;
+
+    if ((fd = accept(pRegistry->listenFd, NULL, NULL)) < 0) {
+        return;
+    }
+    for (i = 0; i < APP_METRICS_EXPORTER_MAX_CLIENTS && pClients[i].fd >= 0; i++) {
+    }
+    if (i == APP_METRICS_EXPORTER_MAX_CLIENTS) {
+        DLOGW("Too many metrics scrapers, the new connection is closed");
+        close(fd);
+        return;
+    }
+    // The response is written out at once, a scraper which does not read it is given up after the timeout.
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, SIZEOF(timeout));
+    pClients[i].fd = fd;
+    pClients[i].deadline = GETTIME() + APP_METRICS_EXPORTER_IO_TIMEOUT_S * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    pClients[i].length = 0;
+    pClients[i].request[0] = '\0';
+}
+
+/**
+ * @brief the exporter thread. It polls the listening socket and the connected scrapers together, so an idle connection
+ *        only holds its own slot until its deadline instead of the other scrapes.
+ */
+static PVOID appMetricsExporterRoutine(PVOID args)
+{
+    PAppMetricsRegistry pRegistry = (PAppMetricsRegistry) args;
+    AppMetricsClient clients[APP_METRICS_EXPORTER_MAX_CLIENTS];
+    struct pollfd pollFds[APP_METRICS_EXPORTER_MAX_CLIENTS + 1];
+    UINT32 clientIndexes[APP_METRICS_EXPORTER_MAX_CLIENTS + 1];
+    UINT32 i, pollCount;
+    UINT64 curTime;
+
+    for (i = 0; i < APP_METRICS_EXPORTER_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+
+    while (!ATOMIC_LOAD_BOOL(&pRegistry->terminateExporter)) {
+        pollFds[0].fd = pRegistry->listenFd;
+        pollFds[0].events = POLLIN;
+        pollFds[0].revents = 0;
+        pollCount = 1;
+        for (i = 0; i < APP_METRICS_EXPORTER_MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0) {
+                pollFds[pollCount].fd = clients[i].fd;
+                pollFds[pollCount].events = POLLIN;
+                pollFds[pollCount].revents = 0;
+                clientIndexes[pollCount++] = i;
+            }
+        }
+
+        // wake up periodically to check the termination and the deadlines.
+        if (poll(pollFds, pollCount, APP_METRICS_EXPORTER_POLL_TIMEOUT_MS) > 0) {
+            for (i = 1; i < pollCount; i++) {
+                if (pollFds[i].revents != 0) {
+                    readAppMetricsClient(pRegistry, &clients[clientIndexes[i]]);
+                }
+            }
+            if ((pollFds[0].revents & POLLIN) != 0) {
+                acceptAppMetricsClient(pRegistry, clients);
+            }
+        }
+
+        curTime = GETTIME();
+        for (i = 0; i < APP_METRICS_EXPORTER_MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0 && curTime >= clients[i].deadline) {
+                closeAppMetricsClient(&clients[i]);
+            }
+        }
+    }
+
+    for (i = 0; i < APP_METRICS_EXPORTER_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            closeAppMetricsClient(&clients[i]);
+        }
+    }
+
+    return NULL;
+}
+
+STATUS startAppMetricsExporter(PAppMetricsRegistry pRegistry, PCHAR pEndpoint)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    struct sockaddr_un unixAddr;
+    struct sockaddr_in inetAddr;
+    struct sockaddr* pAddr;
+    socklen_t addrLen;
+    CHAR host[INET_ADDRSTRLEN];
+    PCHAR pPort;
+    UINT32 port;
+    INT32 optVal = 1;
+    struct stat pathStat;
+
+    CHK(pRegistry != NULL && pEndpoint != NULL, STATUS_APP_METRICS_REGISTRY_NULL_ARG);
+    CHK(pRegistry->listenFd < 0, STATUS_APP_METRICS_REGISTRY_INVALID_ARG);
+
+    if (STRNCMP(pEndpoint, APP_METRICS_EXPORTER_UNIX_PREFIX, STRLEN(APP_METRICS_EXPORTER_UNIX_PREFIX)) == 0) {
+        pEndpoint += STRLEN(APP_METRICS_EXPORTER_UNIX_PREFIX);
+        CHK(pEndpoint[0] != '\0' && STRLEN(pEndpoint) < SIZEOF(unixAddr.sun_path), STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT);
+        MEMSET(&unixAddr, 0x00, SIZEOF(unixAddr));
+        unixAddr.sun_family = AF_UNIX;
+        STRNCPY(unixAddr.sun_path, pEndpoint, SIZEOF(unixAddr.sun_path) - 1);
+        pAddr = (struct sockaddr*) &unixAddr;
+        addrLen = SIZEOF(unixAddr);
+        // A previous run may have left the socket behind, anything else at the path is not ours to remove.
+        if (lstat(pEndpoint, &pathStat) == 0) {
+            CHK(S_ISSOCK(pathStat.st_mode), STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT);
+            unlink(pEndpoint);
+        }
+    } else {
+        if ((pPort = STRCHR(pEndpoint, ':')) != NULL) {
+            CHK(pPort - pEndpoint < INET_ADDRSTRLEN, STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT);
+            STRNCPY(host, pEndpoint, pPort - pEndpoint);
+            host[pPort - pEndpoint] = '\0';
+            pPort++;
+        } else {
+            STRNCPY(host, APP_METRICS_EXPORTER_DEFAULT_HOST, INET_ADDRSTRLEN);
+            pPort = pEndpoint;
+        }
+        CHK(STRTOUI32(pPort, NULL, 10, &port) == STATUS_SUCCESS && port != 0 && port <= 0xFFFF, STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT);
+        MEMSET(&inetAddr, 0x00, SIZEOF(inetAddr));
+        inetAddr.sin_family = AF_INET;
+        inetAddr.sin_port = htons((UINT16) port);
+        CHK(inet_pton(AF_INET, host, &inetAddr.sin_addr) == 1, STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT);
+        pAddr = (struct sockaddr*) &inetAddr;
+        addrLen = SIZEOF(inetAddr);
+    }
+
+    CHK((pRegistry->listenFd = socket(pAddr->sa_family, SOCK_STREAM, 0)) >= 0, STATUS_APP_METRICS_REGISTRY_SOCKET);
+    if (pAddr->sa_family == AF_INET) {
+        setsockopt(pRegistry->listenFd, SOL_SOCKET, SO_REUSEADDR, &optVal, SIZEOF(optVal));
+    }
+    CHK(bind(pRegistry->listenFd, pAddr, addrLen) == 0, STATUS_APP_METRICS_REGISTRY_SOCKET);
+    if (pAddr->sa_family == AF_UNIX) {
+        STRNCPY(pRegistry->unixPath, pEndpoint, MAX_PATH_LEN);
+        // Only the owner may scrape, and nobody can connect before the listen below.
+        CHK(chmod(pEndpoint, S_IRUSR | S_IWUSR) == 0, STATUS_APP_METRICS_REGISTRY_SOCKET);
+    }
+    CHK(listen(pRegistry->listenFd, APP_METRICS_EXPORTER_BACKLOG) == 0, STATUS_APP_METRICS_REGISTRY_SOCKET);
+
+    ATOMIC_STORE_BOOL(&pRegistry->terminateExporter, FALSE);
+    CHK(THREAD_CREATE(&pRegistry->exporterTid, appMetricsExporterRoutine, (PVOID) pRegistry) == STATUS_SUCCESS,
+        STATUS_APP_METRICS_REGISTRY_EXPORTER_THREAD);
+    DLOGI("Metrics are served on %s", pEndpoint);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && pRegistry != NULL) {
+        DLOGW("Failed to serve the metrics on %s: 0x%08x", pEndpoint == NULL ? "" : pEndpoint, retStatus);
+        if (pRegistry->listenFd >= 0) {
+            close(pRegistry->listenFd);
+            pRegistry->listenFd = -1;
+        }
+        if (pRegistry->unixPath[0] != '\0') {
+            unlink(pRegistry->unixPath);
+            pRegistry->unixPath[0] = '\0';
+        }
+        pRegistry->exporterTid = INVALID_TID_VALUE;
+    }
+
+    return retStatus;
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define LOG_CLASS "AppPacer"
+#include "AppPacer.h"
+#include "AppLockProfiler.h"
+#include "AppTrace.h"
+
+/**
+ * @brief the bytes a bucket may hold, a fraction of the frame interval at its rate.
+ */
+static DOUBLE getAppPacerBurst(PAppPacer pAppPacer, DOUBLE rate)
+{
+    UINT64 frameInterval = pAppPacer->frameInterval != 0 ? pAppPacer->frameInterval : APP_PACER_DEFAULT_INTERVAL;
+
+    return rate * frameInterval / HUNDREDS_OF_NANOS_IN_A_SECOND / APP_PACER_BURST_FRACTION;
+}
+
+static VOID refillAppPacerFlow(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, UINT64 curTime)
+{
+    DOUBLE tokens;
+
+    if (curTime > pAppPacerFlow->refillTime) {
+        tokens = pAppPacerFlow->tokens + pAppPacerFlow->stats.rate * (curTime - pAppPacerFlow->refillTime) / HUNDREDS_OF_NANOS_IN_A_SECOND;
+        pAppPacerFlow->tokens = MIN(tokens, getAppPacerBurst(pAppPacer, pAppPacerFlow->stats.rate));
+        pAppPacerFlow->refillTime = curTime;
+    }
+}
+
+static VOID refillAppPacer(PAppPacer pAppPacer, UINT64 curTime)
+{
+    DOUBLE tokens;
+
+    if (curTime > pAppPacer->refillTime) {
+        tokens = pAppPacer->tokens + pAppPacer->rate * (curTime - pAppPacer->refillTime) / HUNDREDS_OF_NANOS_IN_A_SECOND;
+        pAppPacer->tokens = MIN(tokens, getAppPacerBurst(pAppPacer, pAppPacer->rate));
+        pAppPacer->refillTime = curTime;
+    }
+}
+
+/**
+ * @brief set the shared rate to the sum of the rates of the flows, the caller holds the lock of the pacer.
+ */
+static VOID updateAppPacerRate(PAppPacer pAppPacer)
+{
+    DOUBLE rate = 0;
+    UINT32 i;
+
+    refillAppPacer(pAppPacer, GETTIME());
+    for (i = 0; i < pAppPacer->flowCount; i++) {
+        rate += pAppPacer->flows[i]->stats.rate;
+    }
+    pAppPacer->rate = rate;
+    pAppPacer->tokens = MIN(pAppPacer->tokens, getAppPacerBurst(pAppPacer, rate));
+}
+
+/**
+ * @brief the time a bucket in debt needs to be refilled, 0 if it is not in debt.
+ */
+static UINT64 getAppPacerDebtTime(DOUBLE tokens, DOUBLE rate)
+{
+    return tokens >= 0 || rate <= 0 ? 0 : (UINT64) (-tokens * HUNDREDS_OF_NANOS_IN_A_SECOND / rate) + 1;
+}
+
+static VOID popAppPacerEntry(PAppPacerFlow pAppPacerFlow, PAppPacerEntry pEntry)
+{
+    *pEntry = pAppPacerFlow->queue[pAppPacerFlow->head];
+    pAppPacerFlow->head = (pAppPacerFlow->head + 1) % APP_PACER_QUEUE_DEPTH;
+    pAppPacerFlow->count--;
+    pAppPacerFlow->stats.queuedBytes -= pEntry->pPacerFrame->frame.size;
+}
+
+/**
+ * @brief pick the next frame to write. The flows are checked from the cursor, the first one with a frame is written when neither
+ *        its bucket nor the shared one is in debt, or when its frame waited for APP_PACER_MAX_DELAY.
+ *
+ * @param[in] pAppPacer the pacer.
+ * @param[in] curTime the current time.
+ * @param[out] ppAppPacerFlow the flow of the frame, NULL if no flow may write now.
+ * @param[out] pWakeTime the time a flow may write, if none may now.
+ */
+static VOID pickAppPacerFlow(PAppPacer pAppPacer, UINT64 curTime, PAppPacerFlow* ppAppPacerFlow, PUINT64 pWakeTime)
+{
+    PAppPacerFlow pAppPacerFlow;
+    PAppPacerEntry pHead;
+    UINT64 wakeTime = curTime + APP_PACER_IDLE_PERIOD, lateTime, refillTime;
+    UINT32 i, index;
+
+    *ppAppPacerFlow = NULL;
+    refillAppPacer(pAppPacer, curTime);
+    for (i = 0; i < pAppPacer->flowCount; i++) {
+        index = (pAppPacer->cursor + i) % pAppPacer->flowCount;
+        pAppPacerFlow = pAppPacer->flows[index];
+        refillAppPacerFlow(pAppPacer, pAppPacerFlow, curTime);
+        if (pAppPacerFlow->count == 0) {
+            continue;
+        }
+        pHead = &pAppPacerFlow->queue[pAppPacerFlow->head];
+        lateTime = pHead->queuedTime + APP_PACER_MAX_DELAY;
+        if ((pAppPacerFlow->tokens >= 0 && pAppPacer->tokens >= 0) || curTime >= lateTime) {
+            *ppAppPacerFlow = pAppPacerFlow;
+            pAppPacer->cursor = (index + 1) % pAppPacer->flowCount;
+            return;
+        }
+        refillTime = curTime +
+            MAX(getAppPacerDebtTime(pAppPacerFlow->tokens, pAppPacerFlow->stats.rate), getAppPacerDebtTime(pAppPacer->tokens, pAppPacer->rate));
+        wakeTime = MIN(wakeTime, MIN(refillTime, lateTime));
+    }
+    *pWakeTime = wakeTime;
+}
+
+static PVOID appPacerRoutine(PVOID userData)
+{
+    PAppPacer pAppPacer = (PAppPacer) userData;
+    PAppPacerFlow pAppPacerFlow;
+    AppPacerEntry entry;
+    Frame frame;
+    UINT64 curTime, wakeTime;
+    BOOL late;
+    STATUS writeStatus;
+
+    setAppTraceThreadName("pacer");
+    APP_MUTEX_LOCK(pAppPacer->lock);
+    while (!ATOMIC_LOAD_BOOL(&pAppPacer->terminatePacer)) {
+        curTime = GETTIME();
+        pickAppPacerFlow(pAppPacer, curTime, &pAppPacerFlow, &wakeTime);
+        if (pAppPacerFlow == NULL) {
+            APP_CVAR_WAIT(pAppPacer->cvar, pAppPacer->lock, wakeTime - curTime);
+            continue;
+        }
+
+        popAppPacerEntry(pAppPacerFlow, &entry);
+        late = pAppPacerFlow->tokens < 0 || pAppPacer->tokens < 0;
+        // The copies of a key frame for the sessions come at once, the shared bucket spaces them instead of one burst.
+        pAppPacerFlow->tokens -= entry.pPacerFrame->frame.size;
+        pAppPacer->tokens -= entry.pPacerFrame->frame.size;
+        pAppPacer->pWritingFlow = pAppPacerFlow;
+        APP_MUTEX_UNLOCK(pAppPacer->lock);
+
+        // The sdk sends the packets of the frame in writeFrame, the lock is not held so the producers and the other flows go on.
+        frame = entry.pPacerFrame->frame;
+        frame.index = entry.index;
+        appTraceBegin("pacerWrite");
+        writeStatus = pAppPacerFlow->writer(pAppPacerFlow->udata, &frame, entry.pPacerFrame->entryTime);
+        appTraceEnd("pacerWrite");
+        releaseAppPacerFrame(&entry.pPacerFrame);
+
+        APP_MUTEX_LOCK(pAppPacer->lock);
+        pAppPacer->pWritingFlow = NULL;
+        if (STATUS_SUCCEEDED(writeStatus)) {
+            pAppPacerFlow->stats.framesSent++;
+            pAppPacerFlow->stats.bytesSent += frame.size;
+        }
+        if (late) {
+            pAppPacerFlow->stats.framesLate++;
+        }
+        pAppPacerFlow->stats.queueDelay = curTime - entry.queuedTime;
+        CVAR_BROADCAST(pAppPacer->cvar);
+    }
+    APP_MUTEX_UNLOCK(pAppPacer->lock);
+
+    return NULL;
+}
+
+STATUS createAppPacer(UINT32 ratePercent, PAppPacer* ppAppPacer)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppPacer pAppPacer = NULL;
+
+    CHK(ppAppPacer != NULL, STATUS_APP_PACER_NULL_ARG);
+    CHK(ratePercent != 0, STATUS_APP_PACER_INVALID_ARG);
+    CHK(NULL != (pAppPacer = (PAppPacer) MEMCALLOC(1, SIZEOF(AppPacer))), STATUS_APP_PACER_NOT_ENOUGH_MEMORY);
+    pAppPacer->ratePercent = ratePercent;
+    pAppPacer->refillTime = GETTIME();
+    pAppPacer->pacerTid = INVALID_TID_VALUE;
+    ATOMIC_STORE_BOOL(&pAppPacer->terminatePacer, FALSE);
+    pAppPacer->lock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pAppPacer->lock), STATUS_APP_PACER_INVALID_MUTEX);
+    pAppPacer->cvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pAppPacer->cvar), STATUS_APP_PACER_INVALID_CVAR);
+    CHK(THREAD_CREATE(&pAppPacer->pacerTid, appPacerRoutine, (PVOID) pAppPacer) == STATUS_SUCCESS, STATUS_APP_PACER_THREAD);
+    DLOGI("Pacing the sessions at %u%% of their send budget", ratePercent);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && pAppPacer != NULL) {
+        pAppPacer->pacerTid = INVALID_TID_VALUE;
+        freeAppPacer(&pAppPacer);
+    }
+    if (ppAppPacer != NULL) {
+        *ppAppPacer = pAppPacer;
+    }
+
+    return retStatus;
+}
+
+STATUS freeAppPacer(PAppPacer* ppAppPacer)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppPacer pAppPacer;
+
+    CHK(ppAppPacer != NULL, STATUS_APP_PACER_NULL_ARG);
+    pAppPacer = *ppAppPacer;
+    CHK(pAppPacer != NULL, retStatus);
+
+    if (pAppPacer->pacerTid != INVALID_TID_VALUE) {
+        APP_MUTEX_LOCK(pAppPacer->lock);
+        ATOMIC_STORE_BOOL(&pAppPacer->terminatePacer, TRUE);
+        CVAR_BROADCAST(pAppPacer->cvar);
+        APP_MUTEX_UNLOCK(pAppPacer->lock);
+        THREAD_JOIN(pAppPacer->pacerTid, NULL);
+    }
+    if (pAppPacer->flowCount != 0) {
+        DLOGW("%u flows are not removed from the pacer", pAppPacer->flowCount);
+    }
+    if (IS_VALID_CVAR_VALUE(pAppPacer->cvar)) {
+        CVAR_FREE(pAppPacer->cvar);
+    }
+    if (IS_VALID_MUTEX_VALUE(pAppPacer->lock)) {
+        MUTEX_FREE(pAppPacer->lock);
+    }
+    SAFE_MEMFREE(*ppAppPacer);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS addAppPacerFlow(PAppPacer pAppPacer, AppPacerWriter writer, PVOID udata, PAppPacerFlow* ppAppPacerFlow)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppPacerFlow pAppPacerFlow = NULL;
+    BOOL locked = FALSE;
+
+    CHK(pAppPacer != NULL && writer != NULL && ppAppPacerFlow != NULL, STATUS_APP_PACER_NULL_ARG);
+    CHK(NULL != (pAppPacerFlow = (PAppPacerFlow) MEMCALLOC(1, SIZEOF(AppPacerFlow))), STATUS_APP_PACER_NOT_ENOUGH_MEMORY);
+    pAppPacerFlow->writer = writer;
+    pAppPacerFlow->udata = udata;
+    pAppPacerFlow->stats.rate = (DOUBLE) APP_SESSION_SEND_BUDGET_MAX / 8 * pAppPacer->ratePercent / 100;
+    pAppPacerFlow->refillTime = GETTIME();
+
+    APP_MUTEX_LOCK(pAppPacer->lock);
+    locked = TRUE;
+    CHK(pAppPacer->flowCount < APP_PACER_MAX_FLOWS, STATUS_APP_PACER_TOO_MANY_FLOWS);
+    pAppPacerFlow->tokens = getAppPacerBurst(pAppPacer, pAppPacerFlow->stats.rate);
+    pAppPacer->flows[pAppPacer->flowCount++] = pAppPacerFlow;
+    updateAppPacerRate(pAppPacer);
+
+CleanUp:
+
+    if (locked) {
+        APP_MUTEX_UNLOCK(pAppPacer->lock);
+    }
+    if (STATUS_FAILED(retStatus)) {
+        SAFE_MEMFREE(pAppPacerFlow);
+    }
+    if (ppAppPacerFlow != NULL) {
+        *ppAppPacerFlow = pAppPacerFlow;
+    }
+
+    return retStatus;
+}
+
+STATUS removeAppPacerFlow(PAppPacer pAppPacer, PAppPacerFlow* ppAppPacerFlow)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppPacerFlow pAppPacerFlow;
+    AppPacerEntry entry;
+    UINT32 i;
+
+    CHK(pAppPacer != NULL && ppAppPacerFlow != NULL, STATUS_APP_PACER_NULL_ARG);
+    pAppPacerFlow = *ppAppPacerFlow;
+    CHK(pAppPacerFlow != NULL, retStatus);
+
+    APP_MUTEX_LOCK(pAppPacer->lock);
+    while (pAppPacer->pWritingFlow == pAppPacerFlow) {
+        APP_CVAR_WAIT(pAppPacer->cvar, pAppPacer->lock, INFINITE_TIME_VALUE);
+    }
+    for (i = 0; i < pAppPacer->flowCount; i++) {
+        if (pAppPacer->flows[i] == pAppPacerFlow) {
+            pAppPacer->flows[i] = pAppPacer->flows[--pAppPacer->flowCount];
+            break;
+        }
+    }
+    pAppPacer->cursor = 0;
+    updateAppPacerRate(pAppPacer);
+    while (pAppPacerFlow->count != 0) {
+        popAppPacerEntry(pAppPacerFlow, &entry);
+        releaseAppPacerFrame(&entry.pPacerFrame);
+    }
+    APP_MUTEX_UNLOCK(pAppPacer->lock);
+    SAFE_MEMFREE(*ppAppPacerFlow);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS setAppPacerFlowBitrate(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, DOUBLE bitrate)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pAppPacer != NULL && pAppPacerFlow != NULL, STATUS_APP_PACER_NULL_ARG);
+    CHK(bitrate > 0, STATUS_APP_PACER_INVALID_ARG);
+    APP_MUTEX_LOCK(pAppPacer->lock);
+    refillAppPacerFlow(pAppPacer, pAppPacerFlow, GETTIME());
+    pAppPacerFlow->stats.rate = bitrate / 8 * pAppPacer->ratePercent / 100;
+    // a lower rate shrinks the bucket, the tokens of the old rate must not let a burst through.
+    pAppPacerFlow->tokens = MIN(pAppPacerFlow->tokens, getAppPacerBurst(pAppPacer, pAppPacerFlow->stats.rate));
+    updateAppPacerRate(pAppPacer);
+    APP_MUTEX_UNLOCK(pAppPacer->lock);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS createAppPacerFrame(PAppPacer pAppPacer, PFrame pFrame, UINT64 entryTime, PAppPacerFrame* ppAppPacerFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppPacerFrame pAppPacerFrame = NULL;
+
+    CHK(pAppPacer != NULL && pFrame != NULL && ppAppPacerFrame != NULL, STATUS_APP_PACER_NULL_ARG);
+    CHK(NULL != (pAppPacerFrame = (PAppPacerFrame) MEMALLOC(SIZEOF(AppPacerFrame) + pFrame->size)), STATUS_APP_PACER_NOT_ENOUGH_MEMORY);
+    ATOMIC_STORE(&pAppPacerFrame->refCount, 1);
+    pAppPacerFrame->frame = *pFrame;
+    pAppPacerFrame->frame.frameData = (PBYTE) (pAppPacerFrame + 1);
+    pAppPacerFrame->entryTime = entryTime;
+    MEMCPY(pAppPacerFrame->frame.frameData, pFrame->frameData, pFrame->size);
+
+    // The media source sets the duration to its estimate of the frame interval, the bucket sizes read it under the lock of the pacer.
+    if (pFrame->trackId == DEFAULT_VIDEO_TRACK_ID && pFrame->duration != 0) {
+        APP_MUTEX_LOCK(pAppPacer->lock);
+        pAppPacer->frameInterval = pFrame->duration;
+        APP_MUTEX_UNLOCK(pAppPacer->lock);
+    }
+
+CleanUp:
+
+    if (ppAppPacerFrame != NULL) {
+        *ppAppPacerFrame = pAppPacerFrame;
+    }
+
+    return retStatus;
+}
+
+STATUS releaseAppPacerFrame(PAppPacerFrame* ppAppPacerFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(ppAppPacerFrame != NULL, STATUS_APP_PACER_NULL_ARG);
+    CHK(*ppAppPacerFrame != NULL, retStatus);
+    if (ATOMIC_DECREMENT(&(*ppAppPacerFrame)->refCount) == 1) {
+        MEMFREE(*ppAppPacerFrame);
+    }
+    *ppAppPacerFrame = NULL;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS queueAppPacerFrame(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, PAppPacerFrame pAppPacerFrame, UINT32 index)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppPacerEntry pEntry;
+    BOOL locked = FALSE;
+
+    CHK(pAppPacer != NULL && pAppPacerFlow != NULL && pAppPacerFrame != NULL, STATUS_APP_PACER_NULL_ARG);
+    APP_MUTEX_LOCK(pAppPacer->lock);
+    locked = TRUE;
+    if (pAppPacerFlow->count == APP_PACER_QUEUE_DEPTH) {
+        pAppPacerFlow->stats.framesDropped++;
+        CHK(FALSE, STATUS_APP_PACER_QUEUE_FULL);
+    }
+    pEntry = &pAppPacerFlow->queue[(pAppPacerFlow->head + pAppPacerFlow->count) % APP_PACER_QUEUE_DEPTH];
+    ATOMIC_INCREMENT(&pAppPacerFrame->refCount);
+    pEntry->pPacerFrame = pAppPacerFrame;
+    pEntry->index = index;
+    pEntry->queuedTime = GETTIME();
+    pAppPacerFlow->count++;
+    pAppPacerFlow->stats.framesQueued++;
+    pAppPacerFlow->stats.queuedBytes += pAppPacerFrame->frame.size;
+    CVAR_BROADCAST(pAppPacer->cvar);
+
+CleanUp:
+
+    if (locked) {
+        APP_MUTEX_UNLOCK(pAppPacer->lock);
+    }
+
+    return retStatus;
+}
+
+STATUS getAppPacerFlowStats(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, PAppPacerFlowStats pStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pAppPacer != NULL && pAppPacerFlow != NULL && pStats != NULL, STATUS_APP_PACER_NULL_ARG);
+    APP_MUTEX_LOCK(pAppPacer->lock);
+    *pStats = pAppPacerFlow->stats;
+    APP_MUTEX_UNLOCK(pAppPacer->lock);
+
+CleanUp:
+
+    return retStatus;
+}
@@ -0,0 +1,725 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define LOG_CLASS "AppRecorder"
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // O_DIRECT and fallocate
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "AppRecorder.h"
+#include "AppTrace.h"
+
+#define APP_RECORDER_PART_EXTENSION ".part"
+#define APP_RECORDER_MUXING_APP     "kvsWebrtcApp"
+#define APP_RECORDER_HEADER_LEN     1024
+#define APP_RECORDER_BLOCK_LEN      32
+#define APP_RECORDER_UNKNOWN_SIZE   0x00FFFFFFFFFFFFFFULL //!< the size of 8 bytes with all the bits set.
+#define APP_RECORDER_MIN_TIMECODE   (-32768)             //!< the timecode of a block is an int16 relative to its cluster.
+#define APP_RECORDER_MAX_TIMECODE   32767
+#define APP_RECORDER_H264_NALU_SPS  7
+#define APP_RECORDER_H264_NALU_PPS  8
+
+/**
+ * The elements of Matroska used by the recorder.
+ */
+#define APP_RECORDER_ID_EBML                 0x1A45DFA3
+#define APP_RECORDER_ID_EBML_VERSION         0x4286
+#define APP_RECORDER_ID_EBML_READ_VERSION    0x42F7
+#define APP_RECORDER_ID_EBML_MAX_ID_LENGTH   0x42F2
+#define APP_RECORDER_ID_EBML_MAX_SIZE_LENGTH 0x42F3
+#define APP_RECORDER_ID_DOC_TYPE             0x4282
+#define APP_RECORDER_ID_DOC_TYPE_VERSION     0x4287
+#define APP_RECORDER_ID_DOC_TYPE_READ        0x4285
+#define APP_RECORDER_ID_SEGMENT              0x18538067
+#define APP_RECORDER_ID_INFO                 0x1549A966
+#define APP_RECORDER_ID_TIMECODE_SCALE       0x2AD7B1
+#define APP_RECORDER_ID_MUXING_APP           0x4D80
+#define APP_RECORDER_ID_WRITING_APP          0x5741
+#define APP_RECORDER_ID_TRACKS               0x1654AE6B
+#define APP_RECORDER_ID_TRACK_ENTRY          0xAE
+#define APP_RECORDER_ID_TRACK_NUMBER         0xD7
+#define APP_RECORDER_ID_TRACK_UID            0x73C5
+#define APP_RECORDER_ID_TRACK_TYPE           0x83
+#define APP_RECORDER_ID_FLAG_LACING          0x9C
+#define APP_RECORDER_ID_CODEC_ID             0x86
+#define APP_RECORDER_ID_CODEC_PRIVATE        0x63A2
+#define APP_RECORDER_ID_AUDIO                0xE1
+#define APP_RECORDER_ID_SAMPLING_FREQUENCY   0xB5
+#define APP_RECORDER_ID_CHANNELS             0x9F
+#define APP_RECORDER_ID_CLUSTER              0x1F43B675
+#define APP_RECORDER_ID_TIMECODE             0xE7
+#define APP_RECORDER_ID_SIMPLE_BLOCK         0xA3
+
+#define APP_RECORDER_TRACK_TYPE_VIDEO 1
+#define APP_RECORDER_TRACK_TYPE_AUDIO 2
+#define APP_RECORDER_FLAG_KEY_FRAME   0x80
+
+static UINT32 getAppRecorderVintLen(UINT64 value)
+{
+    UINT32 len = 1;
+
+    // The value of all the bits set is reserved for the unknown size.
+    while (len < 8 && value >= (1ULL << (7 * len)) - 1) {
+        len++;
+    }
+    return len;
+}
+
+static VOID putAppRecorderId(PBYTE pBuffer, PUINT32 pLen, UINT32 id)
+{
+    UINT32 len = id > 0xFFFFFF ? 4 : (id > 0xFFFF ? 3 : (id > 0xFF ? 2 : 1)), i;
+
+    for (i = 0; i < len; i++) {
+        pBuffer[*pLen + i] = (BYTE) (id >> (8 * (len - 1 - i)));
+    }
+    *pLen += len;
+}
+
+static VOID putAppRecorderSize(PBYTE pBuffer, PUINT32 pLen, UINT64 size, UINT32 len)
+{
+    UINT32 i;
+
+    for (i = 0; i < len; i++) {
+        pBuffer[*pLen + i] = (BYTE) (size >> (8 * (len - 1 - i)));
+    }
+    pBuffer[*pLen] |= (BYTE) (0x80 >> (len - 1));
+    *pLen += len;
+}
+
+static VOID putAppRecorderUint(PBYTE pBuffer, PUINT32 pLen, UINT32 id, UINT64 value)
+{
+    UINT32 len = 1, i;
+
+    while (len < 8 && (value >> (8 * len)) != 0) {
+        len++;
+    }
+    putAppRecorderId(pBuffer, pLen, id);
+    putAppRecorderSize(pBuffer, pLen, len, 1);
+    for (i = 0; i < len; i++) {
+        pBuffer[*pLen + i] = (BYTE) (value >> (8 * (len - 1 - i)));
+    }
+    *pLen += len;
+}
+
+static VOID putAppRecorderBinary(PBYTE pBuffer, PUINT32 pLen, UINT32 id, PBYTE pData, UINT32 dataLen)
+{
+    putAppRecorderId(pBuffer, pLen, id);
+    putAppRecorderSize(pBuffer, pLen, dataLen, getAppRecorderVintLen(dataLen));
+    MEMCPY(pBuffer + *pLen, pData, dataLen);
+    *pLen += dataLen;
+}
+
+static VOID putAppRecorderFloat(PBYTE pBuffer, PUINT32 pLen, UINT32 id, DOUBLE value)
+{
+    UINT64 bits;
+    UINT32 i;
+
+    MEMCPY(&bits, &value, SIZEOF(bits));
+    putAppRecorderId(pBuffer, pLen, id);
+    putAppRecorderSize(pBuffer, pLen, SIZEOF(bits), 1);
+    for (i = 0; i < SIZEOF(bits); i++) {
+        pBuffer[*pLen + i] = (BYTE) (bits >> (8 * (SIZEOF(bits) - 1 - i)));
+    }
+    *pLen += SIZEOF(bits);
+}
+
+/**
+ * @brief open a master element, its size is written by endAppRecorderMaster once its children are in the buffer.
+ *
+ * @return the position of the size.
+ */
+static UINT32 beginAppRecorderMaster(PBYTE pBuffer, PUINT32 pLen, UINT32 id)
+{
+    UINT32 position;
+
+    putAppRecorderId(pBuffer, pLen, id);
+    position = *pLen;
+    *pLen += 8;
+    return position;
+}
+
+static VOID endAppRecorderMaster(PBYTE pBuffer, UINT32 len, UINT32 position)
+{
+    putAppRecorderSize(pBuffer, &position, len - position - 8, 8);
+}
+
+/**
+ * @brief find the next nal unit of the annex-b byte stream.
+ *
+ * @param[in] pData the byte stream.
+ * @param[in] len the length of the byte stream.
+ * @param[in, out] pOffset the offset of the search, it is moved after the nal unit.
+ * @param[out] ppNalu the nal unit without its start code.
+ * @param[out] pNaluLen the length of the nal unit.
+ *
+ * @return TRUE if a nal unit is found.
+ */
+static BOOL getAppRecorderNalu(PBYTE pData, UINT32 len, PUINT32 pOffset, PBYTE* ppNalu, PUINT32 pNaluLen)
+{
+    UINT32 i = *pOffset, start, end;
+
+    while (i + 3 <= len && !(pData[i] == 0 && pData[i + 1] == 0 && pData[i + 2] == 1)) {
+        i++;
+    }
+    if (i + 3 > len) {
+        return FALSE;
+    }
+    start = i + 3;
+    for (i = start; i + 3 <= len && !(pData[i] == 0 && pData[i + 1] == 0 && pData[i + 2] == 1); i++) {
+    }
+    end = i + 3 <= len ? i : len;
+    // The zero byte of a 4-byte start code is not a part of the nal unit before it.
+    while (end > start && pData[end - 1] == 0) {
+        end--;
+    }
+    *ppNalu = pData + start;
+    *pNaluLen = end - start;
+    *pOffset = i + 3 <= len ? i : len;
+    return TRUE;
+}
+
+/**
+ * @brief the length of the frame once its start codes are replaced by the 4-byte lengths of the nal units.
+ */
+static UINT32 getAppRecorderAvcLen(PBYTE pData, UINT32 len)
+{
+    UINT32 offset = 0, naluLen, avcLen = 0;
+    PBYTE pNalu;
+
+    while (getAppRecorderNalu(pData, len, &offset, &pNalu, &naluLen)) {
+        avcLen += 4 + naluLen;
+    }
+    return avcLen;
+}
+
+static VOID captureAppRecorderParameterSets(PAppRecorder pAppRecorder, PBYTE pData, UINT32 len)
+{
+    UINT32 offset = 0, naluLen;
+    PBYTE pNalu;
+
+    while (getAppRecorderNalu(pData, len, &offset, &pNalu, &naluLen)) {
+        if (naluLen < 4 || naluLen > APP_RECORDER_PARAMETER_SET_LEN) {
+            continue;
+        }
+        if ((pNalu[0] & 0x1F) == APP_RECORDER_H264_NALU_SPS) {
+            MEMCPY(pAppRecorder->sps, pNalu, naluLen);
+            pAppRecorder->spsLen = naluLen;
+        } else if ((pNalu[0] & 0x1F) == APP_RECORDER_H264_NALU_PPS) {
+            MEMCPY(pAppRecorder->pps, pNalu, naluLen);
+            pAppRecorder->ppsLen = naluLen;
+        }
+    }
+}
+
+static STATUS writeAppRecorderBuffer(PAppRecorder pAppRecorder, UINT32 len)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 offset = 0;
+    ssize_t written;
+
+    while (offset < len) {
+        written = write(pAppRecorder->fd, pAppRecorder->pWriteBuffer + offset, len - offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        CHK(written > 0, STATUS_APP_RECORDER_WRITE_FILE);
+        offset += (UINT32) written;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+/**
+ * @brief copy the bytes into the write buffer, the buffer is written when it is full. So the file is written in large
+ *        aligned writes until the segment is closed.
+ */
+static STATUS appendAppRecorderBytes(PAppRecorder pAppRecorder, PBYTE pData, UINT32 len)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 copyLen;
+
+    pAppRecorder->segmentBytes += len;
+    while (len > 0) {
+        copyLen = MIN(len, APP_RECORDER_WRITE_SIZE - pAppRecorder->writeLen);
+        MEMCPY(pAppRecorder->pWriteBuffer + pAppRecorder->writeLen, pData, copyLen);
+        pAppRecorder->writeLen += copyLen;
+        pData += copyLen;
+        len -= copyLen;
+        if (pAppRecorder->writeLen == APP_RECORDER_WRITE_SIZE) {
+            CHK_STATUS((writeAppRecorderBuffer(pAppRecorder, APP_RECORDER_WRITE_SIZE)));
+            pAppRecorder->writeLen = 0;
+        }
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+static STATUS appendAppRecorderAvc(PAppRecorder pAppRecorder, PBYTE pData, UINT32 len)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 offset = 0, naluLen;
+    BYTE naluLenBytes[4];
+    PBYTE pNalu;
+
+    while (getAppRecorderNalu(pData, len, &offset, &pNalu, &naluLen)) {
+        naluLenBytes[0] = (BYTE) (naluLen >> 24);
+        naluLenBytes[1] = (BYTE) (naluLen >> 16);
+        naluLenBytes[2] = (BYTE) (naluLen >> 8);
+        naluLenBytes[3] = (BYTE) naluLen;
+        CHK_STATUS((appendAppRecorderBytes(pAppRecorder, naluLenBytes, SIZEOF(naluLenBytes))));
+        CHK_STATUS((appendAppRecorderBytes(pAppRecorder, pNalu, naluLen)));
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+static VOID putAppRecorderVideoTrack(PAppRecorder pAppRecorder, PBYTE pBuffer, PUINT32 pLen)
+{
+    BYTE avcC[11 + 2 * APP_RECORDER_PARAMETER_SET_LEN];
+    UINT32 avcCLen = 0, track;
+
+    track = beginAppRecorderMaster(pBuffer, pLen, APP_RECORDER_ID_TRACK_ENTRY);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_TRACK_NUMBER, APP_RECORDER_TRACK_VIDEO);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_TRACK_UID, APP_RECORDER_TRACK_VIDEO);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_TRACK_TYPE, APP_RECORDER_TRACK_TYPE_VIDEO);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_FLAG_LACING, 0);
+    if (pAppRecorder->config.videoCodec == RTC_CODEC_VP8) {
+        putAppRecorderBinary(pBuffer, pLen, APP_RECORDER_ID_CODEC_ID, (PBYTE) "V_VP8", STRLEN("V_VP8"));
+    } else {
+        putAppRecorderBinary(pBuffer, pLen, APP_RECORDER_ID_CODEC_ID, (PBYTE) "V_MPEG4/ISO/AVC", STRLEN("V_MPEG4/ISO/AVC"));
+        // AVCDecoderConfigurationRecord of one sps and one pps, with the nal units prefixed by 4-byte lengths.
+        avcC[avcCLen++] = 1;
+        avcC[avcCLen++] = pAppRecorder->sps[1];
+        avcC[avcCLen++] = pAppRecorder->sps[2];
+        avcC[avcCLen++] = pAppRecorder->sps[3];
+        avcC[avcCLen++] = 0xFF;
+        avcC[avcCLen++] = 0xE1;
+        avcC[avcCLen++] = (BYTE) (pAppRecorder->spsLen >> 8);
+        avcC[avcCLen++] = (BYTE) pAppRecorder->spsLen;
+        MEMCPY(avcC + avcCLen, pAppRecorder->sps, pAppRecorder->spsLen);
+        avcCLen += pAppRecorder->spsLen;
+        avcC[avcCLen++] = 1;
+        avcC[avcCLen++] = (BYTE) (pAppRecorder->ppsLen >> 8);
+        avcC[avcCLen++] = (BYTE) pAppRecorder->ppsLen;
+        MEMCPY(avcC + avcCLen, pAppRecorder->pps, pAppRecorder->ppsLen);
+        avcCLen += pAppRecorder->ppsLen;
+        putAppRecorderBinary(pBuffer, pLen, APP_RECORDER_ID_CODEC_PRIVATE, avcC, avcCLen);
+    }
+    endAppRecorderMaster(pBuffer, *pLen, track);
+}
+
+static VOID putAppRecorderAudioTrack(PAppRecorder pAppRecorder, PBYTE pBuffer, PUINT32 pLen)
+{
+    // OpusHead of 2 channels at 48kHz.
+    BYTE opusHead[] = {'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, 2, 0, 0, 0x80, 0xBB, 0, 0, 0, 0, 0};
+    // WAVEFORMATEX of 1 channel of 8-bit samples at 8kHz, the format tag is 7 for mu-law and 6 for a-law.
+    BYTE waveFormat[] = {7, 0, 1, 0, 0x40, 0x1F, 0, 0, 0x40, 0x1F, 0, 0, 1, 0, 8, 0, 0, 0};
+    UINT32 track, audio;
+    BOOL opus = pAppRecorder->config.audioCodec == RTC_CODEC_OPUS;
+
+    track = beginAppRecorderMaster(pBuffer, pLen, APP_RECORDER_ID_TRACK_ENTRY);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_TRACK_NUMBER, APP_RECORDER_TRACK_AUDIO);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_TRACK_UID, APP_RECORDER_TRACK_AUDIO);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_TRACK_TYPE, APP_RECORDER_TRACK_TYPE_AUDIO);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_FLAG_LACING, 0);
+    if (opus) {
+        putAppRecorderBinary(pBuffer, pLen, APP_RECORDER_ID_CODEC_ID, (PBYTE) "A_OPUS", STRLEN("A_OPUS"));
+        putAppRecorderBinary(pBuffer, pLen, APP_RECORDER_ID_CODEC_PRIVATE, opusHead, SIZEOF(opusHead));
+    } else {
+        if (pAppRecorder->config.audioCodec == RTC_CODEC_ALAW) {
+            waveFormat[0] = 6;
+        }
+        putAppRecorderBinary(pBuffer, pLen, APP_RECORDER_ID_CODEC_ID, (PBYTE) "A_MS/ACM", STRLEN("A_MS/ACM"));
+        putAppRecorderBinary(pBuffer, pLen, APP_RECORDER_ID_CODEC_PRIVATE, waveFormat, SIZEOF(waveFormat));
+    }
+    audio = beginAppRecorderMaster(pBuffer, pLen, APP_RECORDER_ID_AUDIO);
+    putAppRecorderFloat(pBuffer, pLen, APP_RECORDER_ID_SAMPLING_FREQUENCY, opus ? 48000.0 : 8000.0);
+    putAppRecorderUint(pBuffer, pLen, APP_RECORDER_ID_CHANNELS, opus ? 2 : 1);
+    endAppRecorderMaster(pBuffer, *pLen, audio);
+    endAppRecorderMaster(pBuffer, *pLen, track);
+}
+
+static STATUS writeAppRecorderHeader(PAppRecorder pAppRecorder)
+{
+    BYTE header[APP_RECORDER_HEADER_LEN];
+    UINT32 len = 0, master;
+
+    master = beginAppRecorderMaster(header, &len, APP_RECORDER_ID_EBML);
+    putAppRecorderUint(header, &len, APP_RECORDER_ID_EBML_VERSION, 1);
+    putAppRecorderUint(header, &len, APP_RECORDER_ID_EBML_READ_VERSION, 1);
+    putAppRecorderUint(header, &len, APP_RECORDER_ID_EBML_MAX_ID_LENGTH, 4);
+    putAppRecorderUint(header, &len, APP_RECORDER_ID_EBML_MAX_SIZE_LENGTH, 8);
+    putAppRecorderBinary(header, &len, APP_RECORDER_ID_DOC_TYPE, (PBYTE) "matroska", STRLEN("matroska"));
+    putAppRecorderUint(header, &len, APP_RECORDER_ID_DOC_TYPE_VERSION, 4);
+    putAppRecorderUint(header, &len, APP_RECORDER_ID_DOC_TYPE_READ, 2);
+    endAppRecorderMaster(header, len, master);
+
+    // The segment and its clusters are of unknown size, so nothing is written back into the file and a segment cut short
+    // by a crash is still playable.
+    putAppRecorderId(header, &len, APP_RECORDER_ID_SEGMENT);
+    putAppRecorderSize(header, &len, APP_RECORDER_UNKNOWN_SIZE, 8);
+
+    master = beginAppRecorderMaster(header, &len, APP_RECORDER_ID_INFO);
+    putAppRecorderUint(header, &len, APP_RECORDER_ID_TIMECODE_SCALE, HUNDREDS_OF_NANOS_IN_A_MILLISECOND * DEFAULT_TIME_UNIT_IN_NANOS);
+    putAppRecorderBinary(header, &len, APP_RECORDER_ID_MUXING_APP, (PBYTE) APP_RECORDER_MUXING_APP, STRLEN(APP_RECORDER_MUXING_APP));
+    putAppRecorderBinary(header, &len, APP_RECORDER_ID_WRITING_APP, (PBYTE) APP_RECORDER_MUXING_APP, STRLEN(APP_RECORDER_MUXING_APP));
+    endAppRecorderMaster(header, len, master);
+
+    master = beginAppRecorderMaster(header, &len, APP_RECORDER_ID_TRACKS);
+    if (!pAppRecorder->config.audioOnly) {
+        putAppRecorderVideoTrack(pAppRecorder, header, &len);
+    }
+    if (!pAppRecorder->config.videoOnly) {
+        putAppRecorderAudioTrack(pAppRecorder, header, &len);
+    }
+    endAppRecorderMaster(header, len, master);
+
+    return appendAppRecorderBytes(pAppRecorder, header, len);
+}
+
+static STATUS closeAppRecorderSegment(PAppRecorder pAppRecorder)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR partPath[MAX_PATH_LEN + 1];
+    INT32 flags;
+
+    CHK(pAppRecorder->fd >= 0, retStatus);
+
+    if (pAppRecorder->writeLen != 0) {
+        // The tail is not a multiple of the blocks, so it is written through the page cache.
+        if (pAppRecorder->directIo && (flags = fcntl(pAppRecorder->fd, F_GETFL)) >= 0) {
+            fcntl(pAppRecorder->fd, F_SETFL, flags & ~O_DIRECT);
+        }
+        CHK_STATUS((writeAppRecorderBuffer(pAppRecorder, pAppRecorder->writeLen)));
+    }
+    // Release the preallocated blocks after the end of the segment.
+    if (pAppRecorder->config.preallocate) {
+        CHK(ftruncate(pAppRecorder->fd, (off_t) pAppRecorder->segmentBytes) == 0, STATUS_APP_RECORDER_WRITE_FILE);
+    }
+
+CleanUp:
+
+    if (pAppRecorder->fd >= 0) {
+        close(pAppRecorder->fd);
+        pAppRecorder->fd = -1;
+        // The segment is kept even if its tail is lost, everything before it is playable.
+        SNPRINTF(partPath, SIZEOF(partPath), "%s" APP_RECORDER_PART_EXTENSION, pAppRecorder->path);
+        if (rename(partPath, pAppRecorder->path) != 0) {
+            DLOGW("Failed to rename %s, errno(%d)", partPath, errno);
+        }
+        DLOGI("The segment %s is closed with %" PRIu64 " bytes", pAppRecorder->path, pAppRecorder->segmentBytes);
+    }
+    pAppRecorder->writeLen = 0;
+    pAppRecorder->clusterOpen = FALSE;
+    CHK_LOG_ERR((retStatus));
+    return retStatus;
+}
+
+static STATUS openAppRecorderSegment(PAppRecorder pAppRecorder, UINT64 basePts)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR partPath[MAX_PATH_LEN + 1], timeString[32];
+    INT32 flags = O_WRONLY | O_CREAT | O_TRUNC;
+    time_t now = time(NULL);
+    struct tm utc;
+
+    gmtime_r(&now, &utc);
+    strftime(timeString, SIZEOF(timeString), "%Y%m%dT%H%M%SZ", &utc);
+    CHK(SNPRINTF(pAppRecorder->path, SIZEOF(pAppRecorder->path), "%s%c%s-%u.mkv", pAppRecorder->config.directory, FPATHSEPARATOR,
+                 timeString, pAppRecorder->segmentIndex) < (INT32) SIZEOF(pAppRecorder->path) &&
+            SNPRINTF(partPath, SIZEOF(partPath), "%s" APP_RECORDER_PART_EXTENSION, pAppRecorder->path) < (INT32) SIZEOF(partPath),
+        STATUS_APP_RECORDER_INVALID_ARG);
+
+    pAppRecorder->directIo = FALSE;
+    if (pAppRecorder->config.directIo) {
+        if ((pAppRecorder->fd = open(partPath, flags | O_DIRECT, S_IRUSR | S_IWUSR | S_IRGRP)) >= 0) {
+            pAppRecorder->directIo = TRUE;
+        } else {
+            DLOGW("O_DIRECT is refused on %s, errno(%d), the segment is written through the page cache", partPath, errno);
+        }
+    }
+    if (pAppRecorder->fd < 0) {
+        CHK((pAppRecorder->fd = open(partPath, flags, S_IRUSR | S_IWUSR | S_IRGRP)) >= 0, STATUS_APP_RECORDER_OPEN_FILE);
+    }
+    if (pAppRecorder->config.preallocate && pAppRecorder->config.segmentSize != 0 &&
+        fallocate(pAppRecorder->fd, 0, 0, (off_t) pAppRecorder->config.segmentSize) != 0) {
+        DLOGW("Failed to preallocate %s, errno(%d)", partPath, errno);
+    }
+
+    pAppRecorder->segmentIndex++;
+    pAppRecorder->segmentBytes = 0;
+    pAppRecorder->segmentStartTime = GETTIME();
+    pAppRecorder->segmentBasePts = basePts;
+    pAppRecorder->clusterOpen = FALSE;
+    CHK_STATUS((writeAppRecorderHeader(pAppRecorder)));
+    DLOGI("The segment %s is opened", pAppRecorder->path);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && pAppRecorder->fd >= 0) {
+        close(pAppRecorder->fd);
+        pAppRecorder->fd = -1;
+        unlink(partPath);
+        pAppRecorder->writeLen = 0;
+    }
+    return retStatus;
+}
+
+static STATUS writeAppRecorderBlock(PAppRecorder pAppRecorder, PAppReplayFrame pFrame, PBYTE pData)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    BYTE header[APP_RECORDER_BLOCK_LEN];
+    UINT32 len = 0, blockLen;
+    UINT64 timecode = 0;
+    INT64 relative;
+    BOOL video = pFrame->trackId == DEFAULT_VIDEO_TRACK_ID, avc = video && pAppRecorder->config.videoCodec != RTC_CODEC_VP8;
+    BOOL keyFrame = video && (pFrame->flags & FRAME_FLAG_KEY_FRAME) != 0;
+
+    if (pFrame->presentationTs > pAppRecorder->segmentBasePts) {
+        timecode = (pFrame->presentationTs - pAppRecorder->segmentBasePts) / HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+    }
+    relative = (INT64) timecode - (INT64) pAppRecorder->clusterTimecode;
+    // A cluster starts on each video key frame so the players seek to it, and when the timecode of the block overflows.
+    if (!pAppRecorder->clusterOpen || keyFrame || relative < APP_RECORDER_MIN_TIMECODE || relative > APP_RECORDER_MAX_TIMECODE) {
+        putAppRecorderId(header, &len, APP_RECORDER_ID_CLUSTER);
+        putAppRecorderSize(header, &len, APP_RECORDER_UNKNOWN_SIZE, 8);
+        putAppRecorderUint(header, &len, APP_RECORDER_ID_TIMECODE, timecode);
+        pAppRecorder->clusterTimecode = timecode;
+        pAppRecorder->clusterOpen = TRUE;
+        relative = 0;
+    }
+
+    blockLen = 4 + (avc ? getAppRecorderAvcLen(pData, pFrame->size) : pFrame->size);
+    putAppRecorderId(header, &len, APP_RECORDER_ID_SIMPLE_BLOCK);
+    putAppRecorderSize(header, &len, blockLen, getAppRecorderVintLen(blockLen));
+    header[len++] = (BYTE) (0x80 | (video ? APP_RECORDER_TRACK_VIDEO : APP_RECORDER_TRACK_AUDIO));
+    header[len++] = (BYTE) ((UINT16) relative >> 8);
+    header[len++] = (BYTE) relative;
+    header[len++] = keyFrame || !video ? APP_RECORDER_FLAG_KEY_FRAME : 0;
+
+    CHK_STATUS((appendAppRecorderBytes(pAppRecorder, header, len)));
+    if (avc) {
+        CHK_STATUS((appendAppRecorderAvc(pAppRecorder, pData, pFrame->size)));
+    } else {
+        CHK_STATUS((appendAppRecorderBytes(pAppRecorder, pData, pFrame->size)));
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+static STATUS recordAppRecorderFrame(PAppRecorder pAppRecorder, PAppReplayFrame pFrame, PBYTE pData)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    BOOL video = pFrame->trackId == DEFAULT_VIDEO_TRACK_ID, avc = video && pAppRecorder->config.videoCodec != RTC_CODEC_VP8;
+    BOOL keyFrame = video && (pFrame->flags & FRAME_FLAG_KEY_FRAME) != 0;
+    // Without the video track every audio frame is a point to start a segment at.
+    BOOL segmentStart = pAppRecorder->config.audioOnly ? !video : keyFrame;
+    UINT64 now;
+
+    // The frames of a track missing in the header are not recorded.
+    CHK(video ? !pAppRecorder->config.audioOnly : !pAppRecorder->config.videoOnly, retStatus);
+    if (keyFrame && avc) {
+        captureAppRecorderParameterSets(pAppRecorder, pData, pFrame->size);
+    }
+    if (segmentStart && pAppRecorder->fd >= 0) {
+        now = GETTIME();
+        if ((pAppRecorder->config.segmentSize != 0 && pAppRecorder->segmentBytes >= pAppRecorder->config.segmentSize) ||
+            (pAppRecorder->config.segmentDuration != 0 && now - pAppRecorder->segmentStartTime >= pAppRecorder->config.segmentDuration)) {
+            closeAppRecorderSegment(pAppRecorder);
+        }
+    }
+    if (pAppRecorder->fd < 0) {
+        // A segment starts with a key frame, or any audio frame without the video track, and the track of h264 needs the
+        // parameter sets.
+        if (!segmentStart || (avc && (pAppRecorder->spsLen == 0 || pAppRecorder->ppsLen == 0))) {
+            pAppRecorder->framesDropped++;
+            CHK(FALSE, retStatus);
+        }
+        CHK_STATUS((openAppRecorderSegment(pAppRecorder, pFrame->presentationTs)));
+    }
+    CHK_STATUS((writeAppRecorderBlock(pAppRecorder, pFrame, pData)));
+    pAppRecorder->framesWritten++;
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        DLOGW("Failed to record the frame(0x%08x), the segment is closed until the next key frame", retStatus);
+        closeAppRecorderSegment(pAppRecorder);
+    }
+    return retStatus;
+}
+
+/**
+ * @brief read the next frame of the queue into the frame buffer.
+ *
+ * @param[in] pAppRecorder the recorder.
+ * @param[out] pRead a frame is read, FALSE at the end of the queue.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success, STATUS_APP_REPLAY_OVERRUN if the live path overwrites
+ *         the frame before it is read.
+ */
+static STATUS readAppRecorderFrame(PAppRecorder pAppRecorder, PBOOL pRead)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 size, filled = 0;
+    PBYTE pBuffer;
+
+    *pRead = FALSE;
+    do {
+        CHK_STATUS((readAppReplay(pAppRecorder->pQueue, &pAppRecorder->cursor, pAppRecorder->pFrameBuffer + filled,
+                                  pAppRecorder->frameBufferSize - filled, &size)));
+        CHK(pAppRecorder->cursor.active, retStatus);
+        filled += size;
+        if (pAppRecorder->cursor.frame.size > pAppRecorder->frameBufferSize) {
+            CHK(NULL != (pBuffer = (PBYTE) MEMREALLOC(pAppRecorder->pFrameBuffer, pAppRecorder->cursor.frame.size)),
+                STATUS_APP_RECORDER_NOT_ENOUGH_MEMORY);
+            pAppRecorder->pFrameBuffer = pBuffer;
+            pAppRecorder->frameBufferSize = pAppRecorder->cursor.frame.size;
+        }
+    } while (pAppRecorder->cursor.offset < pAppRecorder->cursor.frame.size);
+    *pRead = TRUE;
+
+CleanUp:
+
+    return retStatus;
+}
+
+static PVOID appRecorderWriterRoutine(PVOID userData)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppRecorder pAppRecorder = (PAppRecorder) userData;
+    BOOL terminate, read, progressed;
+
+    setAppTraceThreadName("recorder");
+    do {
+        // The flag is loaded before the queue is drained, so the frames appended before the termination are written.
+        terminate = ATOMIC_LOAD_BOOL(&pAppRecorder->terminateWriter);
+        progressed = FALSE;
+        followAppReplay(pAppRecorder->pQueue, &pAppRecorder->cursor);
+        while (TRUE) {
+            retStatus = readAppRecorderFrame(pAppRecorder, &read);
+            if (retStatus == STATUS_APP_REPLAY_OVERRUN) {
+                DLOGW("The writes fall behind the live frames, the recording skips to the oldest key frame in the queue");
+                pAppRecorder->framesDropped++;
+                seekAppReplay(pAppRecorder->pQueue, &pAppRecorder->cursor);
+                continue;
+            }
+            if (STATUS_FAILED(retStatus) || !read) {
+                break;
+            }
+            recordAppRecorderFrame(pAppRecorder, &pAppRecorder->cursor.frame, pAppRecorder->pFrameBuffer);
+            progressed = TRUE;
+        }
+        if (!progressed && !terminate) {
+            THREAD_SLEEP(APP_RECORDER_POLL_PERIOD);
+        }
+    } while (!terminate);
+
+    closeAppRecorderSegment(pAppRecorder);
+    DLOGI("The recording is stopped, %" PRIu64 " frames are written and %" PRIu64 " are dropped", pAppRecorder->framesWritten,
+          pAppRecorder->framesDropped);
+    return NULL;
+}
+
+STATUS createAppRecorder(PAppRecorderConfig pConfig, PAppRecorder* ppAppRecorder)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppRecorder pAppRecorder = NULL;
+
+    CHK(pConfig != NULL && ppAppRecorder != NULL, STATUS_APP_RECORDER_NULL_ARG);
+    CHK(pConfig->directory[0] != '\0', STATUS_APP_RECORDER_INVALID_ARG);
+    CHK(!pConfig->videoOnly || !pConfig->audioOnly, STATUS_APP_RECORDER_INVALID_ARG);
+    CHK(access(pConfig->directory, W_OK) == 0, STATUS_APP_RECORDER_OPEN_FILE);
+    CHK(NULL != (pAppRecorder = (PAppRecorder) MEMCALLOC(1, SIZEOF(AppRecorder))), STATUS_APP_RECORDER_NOT_ENOUGH_MEMORY);
+    pAppRecorder->config = *pConfig;
+    pAppRecorder->fd = -1;
+    pAppRecorder->writerTid = INVALID_TID_VALUE;
+    ATOMIC_STORE_BOOL(&pAppRecorder->terminateWriter, FALSE);
+
+    // The queue has no time cap, the writer follows its head.
+    CHK_STATUS((createAppReplay(APP_RECORDER_QUEUE_CAPACITY, MAX_INT64, &pAppRecorder->pQueue)));
+    CHK_STATUS((seekAppReplay(pAppRecorder->pQueue, &pAppRecorder->cursor)));
+    CHK(NULL != (pAppRecorder->pFrameBuffer = (PBYTE) MEMALLOC(APP_RECORDER_FRAME_BUFFER_SIZE)), STATUS_APP_RECORDER_NOT_ENOUGH_MEMORY);
+    pAppRecorder->frameBufferSize = APP_RECORDER_FRAME_BUFFER_SIZE;
+    // O_DIRECT needs the buffer aligned on the blocks of the file system, so it is allocated by posix_memalign and freed by free.
+    CHK(posix_memalign((PVOID*) &pAppRecorder->pWriteBuffer, APP_RECORDER_WRITE_ALIGNMENT, APP_RECORDER_WRITE_SIZE) == 0,
+        STATUS_APP_RECORDER_NOT_ENOUGH_MEMORY);
+
+    CHK(THREAD_CREATE(&pAppRecorder->writerTid, appRecorderWriterRoutine, (PVOID) pAppRecorder) == STATUS_SUCCESS,
+        STATUS_APP_RECORDER_WRITER_THREAD);
+    DLOGI("Recording into %s", pConfig->directory);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && pAppRecorder != NULL) {
+        pAppRecorder->writerTid = INVALID_TID_VALUE;
+        freeAppRecorder(&pAppRecorder);
+    }
+    if (ppAppRecorder != NULL) {
+        *ppAppRecorder = pAppRecorder;
+    }
+
+    return retStatus;
+}
+
+STATUS freeAppRecorder(PAppRecorder* ppAppRecorder)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppRecorder pAppRecorder;
+
+    CHK(ppAppRecorder != NULL, STATUS_APP_RECORDER_NULL_ARG);
+    pAppRecorder = *ppAppRecorder;
+    CHK(pAppRecorder != NULL, retStatus);
+
+    ATOMIC_STORE_BOOL(&pAppRecorder->terminateWriter, TRUE);
+    if (pAppRecorder->writerTid != INVALID_TID_VALUE) {
+        THREAD_JOIN(pAppRecorder->writerTid, NULL);
+    }
+    closeAppRecorderSegment(pAppRecorder);
+    freeAppReplay(&pAppRecorder->pQueue);
+    SAFE_MEMFREE(pAppRecorder->pFrameBuffer);
+    if (pAppRecorder->pWriteBuffer != NULL) {
+        free(pAppRecorder->pWriteBuffer);
+    }
+    SAFE_MEMFREE(*ppAppRecorder);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS appendAppRecorderFrame(PAppRecorder pAppRecorder, PFrame pFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pAppRecorder != NULL, STATUS_APP_RECORDER_NULL_ARG);
+    CHK_STATUS((appendAppReplayFrame(pAppRecorder->pQueue, pFrame)));
+
+CleanUp:
+
+    return retStatus;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define LOG_CLASS "AppReplay"
+#include <sys/mman.h>
+#include "AppReplay.h"
+
+/**
+ * The readers copy the bytes without the lock and check the reserved position after the copy, the fences keep the copies
+ * of the writer and the readers on their side of the positions.
+ */
+#define APP_REPLAY_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define APP_REPLAY_RECORD_LEN(size) ((SIZEOF(AppReplayFrame) + (size) + 7) & ~7)
+
+static VOID putAppReplayUint32(PBYTE pBuffer, UINT32 value)
+{
+    pBuffer[0] = (BYTE) (value >> 24);
+    pBuffer[1] = (BYTE) (value >> 16);
+    pBuffer[2] = (BYTE) (value >> 8);
+    pBuffer[3] = (BYTE) value;
+}
+
+static VOID putAppReplayUint64(PBYTE pBuffer, UINT64 value)
+{
+    putAppReplayUint32(pBuffer, (UINT32) (value >> 32));
+    putAppReplayUint32(pBuffer + 4, (UINT32) value);
+}
+
+/**
+ * @brief the record at the position is not overwritten yet.
+ */
+static BOOL isAppReplayPositionValid(PAppReplay pAppReplay, SIZE_T position)
+{
+    APP_REPLAY_FENCE();
+    return (SIZE_T) (ATOMIC_LOAD(&pAppReplay->reserved) - position) <= pAppReplay->capacity;
+}
+
+STATUS createAppReplay(UINT32 capacity, UINT64 duration, PAppReplay* ppAppReplay)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppReplay pAppReplay = NULL;
+    PVOID pBuffer;
+
+    CHK(ppAppReplay != NULL, STATUS_APP_REPLAY_NULL_ARG);
+    // The positions wrap around, their distances must not.
+    CHK(capacity >= APP_REPLAY_RECORD_LEN(0) && capacity <= MAX_INT32 && duration != 0, STATUS_APP_REPLAY_INVALID_ARG);
+    CHK(NULL != (pAppReplay = (PAppReplay) MEMCALLOC(1, SIZEOF(AppReplay))), STATUS_APP_REPLAY_NOT_ENOUGH_MEMORY);
+    pAppReplay->capacity = (capacity + 7) & ~7;
+    pAppReplay->duration = duration;
+    pAppReplay->writeLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pAppReplay->writeLock), STATUS_APP_REPLAY_INVALID_MUTEX);
+
+    // The pages are committed as the ring fills up.
+    pBuffer = mmap(NULL, pAppReplay->capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    CHK(pBuffer != MAP_FAILED, STATUS_APP_REPLAY_NOT_ENOUGH_MEMORY);
+    pAppReplay->pBuffer = (PBYTE) pBuffer;
+    DLOGI("The replay keeps %u bytes of the last %" PRIu64 " seconds", pAppReplay->capacity, duration / HUNDREDS_OF_NANOS_IN_A_SECOND);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        freeAppReplay(&pAppReplay);
+    }
+    if (ppAppReplay != NULL) {
+        *ppAppReplay = pAppReplay;
+    }
+    return retStatus;
+}
+
+STATUS freeAppReplay(PAppReplay* ppAppReplay)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppReplay pAppReplay;
+
+    CHK(ppAppReplay != NULL, STATUS_APP_REPLAY_NULL_ARG);
+    pAppReplay = *ppAppReplay;
+    CHK(pAppReplay != NULL, retStatus);
+
+    if (pAppReplay->pBuffer != NULL) {
+        munmap(pAppReplay->pBuffer, pAppReplay->capacity);
+    }
+    if (IS_VALID_MUTEX_VALUE(pAppReplay->writeLock)) {
+        MUTEX_FREE(pAppReplay->writeLock);
+    }
+    SAFE_MEMFREE(*ppAppReplay);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS appendAppReplayFrame(PAppReplay pAppReplay, PFrame pFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    AppReplayFrame record;
+    PAppReplayKeyFrame pKeyFrame;
+    SIZE_T head, keyFrameCount;
+    UINT32 offset, gap = 0, recordLen;
+    BOOL locked = FALSE;
+
+    CHK(pAppReplay != NULL && pFrame != NULL && (pFrame->frameData != NULL || pFrame->size == 0), STATUS_APP_REPLAY_NULL_ARG);
+    // The empty frames carry nothing to replay, and a chunk of frameSize 0 ends the replay.
+    CHK(pFrame->size != 0, retStatus);
+    // A frame of more than half of the ring would evict the key frame it depends on.
+    CHK(pFrame->size <= pAppReplay->capacity / 2, STATUS_APP_REPLAY_FRAME_TOO_LARGE);
+    recordLen = APP_REPLAY_RECORD_LEN(pFrame->size);
+
+    MUTEX_LOCK(pAppReplay->writeLock);
+    locked = TRUE;
+
+    // A record does not wrap around, the tail of the ring which does not fit it is skipped.
+    head = pAppReplay->head;
+    offset = (UINT32) (head % pAppReplay->capacity);
+    if (pAppReplay->capacity - offset < recordLen) {
+        gap = pAppReplay->capacity - offset;
+    }
+    // The bytes are reserved before they are overwritten, so the readers of the old records see the overrun.
+    ATOMIC_STORE(&pAppReplay->reserved, head + gap + recordLen);
+    APP_REPLAY_FENCE();
+    if (gap >= SIZEOF(AppReplayFrame)) {
+        ((PAppReplayFrame) (pAppReplay->pBuffer + offset))->size = APP_REPLAY_PADDING;
+    }
+    if (gap != 0) {
+        offset = 0;
+    }
+
+    record.size = pFrame->size;
+    record.flags = (UINT32) pFrame->flags;
+    record.trackId = pFrame->trackId;
+    record.presentationTs = pFrame->presentationTs;
+    record.decodingTs = pFrame->decodingTs;
+    *(PAppReplayFrame) (pAppReplay->pBuffer + offset) = record;
+    MEMCPY(pAppReplay->pBuffer + offset + SIZEOF(AppReplayFrame), pFrame->frameData, pFrame->size);
+    APP_REPLAY_FENCE();
+
+    if (pFrame->trackId == DEFAULT_VIDEO_TRACK_ID && (pFrame->flags & FRAME_FLAG_KEY_FRAME) != 0) {
+        keyFrameCount = pAppReplay->keyFrameCount;
+        pKeyFrame = &pAppReplay->keyFrames[keyFrameCount % APP_REPLAY_MAX_KEY_FRAMES];
+        pKeyFrame->position = head + gap;
+        pKeyFrame->appendTime = GETTIME();
+        APP_REPLAY_FENCE();
+        ATOMIC_STORE(&pAppReplay->keyFrameCount, keyFrameCount + 1);
+    }
+    ATOMIC_STORE(&pAppReplay->head, head + gap + recordLen);
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pAppReplay->writeLock);
+    }
+    return retStatus;
+}
+
+STATUS seekAppReplay(PAppReplay pAppReplay, PAppReplayCursor pCursor)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    AppReplayKeyFrame keyFrame;
+    SIZE_T keyFrameCount, index;
+    UINT64 now = GETTIME();
+    UINT32 i;
+
+    CHK(pAppReplay != NULL && pCursor != NULL, STATUS_APP_REPLAY_NULL_ARG);
+
+    MEMSET(pCursor, 0x00, SIZEOF(AppReplayCursor));
+    pCursor->end = ATOMIC_LOAD(&pAppReplay->head);
+    pCursor->position = pCursor->end;
+    pCursor->active = TRUE;
+
+    // Walk from the newest key frame to the oldest one within the caps. The slot of the key frame is not reused while the
+    // count is less than APP_REPLAY_MAX_KEY_FRAMES ahead of it.
+    keyFrameCount = ATOMIC_LOAD(&pAppReplay->keyFrameCount);
+    for (i = 1; i <= keyFrameCount && i < APP_REPLAY_MAX_KEY_FRAMES; i++) {
+        index = keyFrameCount - i;
+        keyFrame = pAppReplay->keyFrames[index % APP_REPLAY_MAX_KEY_FRAMES];
+        APP_REPLAY_FENCE();
+        if ((SIZE_T) (ATOMIC_LOAD(&pAppReplay->keyFrameCount) - index) >= APP_REPLAY_MAX_KEY_FRAMES ||
+            !isAppReplayPositionValid(pAppReplay, keyFrame.position) || keyFrame.appendTime + pAppReplay->duration < now) {
+            break;
+        }
+        pCursor->position = keyFrame.position;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS followAppReplay(PAppReplay pAppReplay, PAppReplayCursor pCursor)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pAppReplay != NULL && pCursor != NULL, STATUS_APP_REPLAY_NULL_ARG);
+    pCursor->end = ATOMIC_LOAD(&pAppReplay->head);
+    pCursor->active = TRUE;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS readAppReplay(PAppReplay pAppReplay, PAppReplayCursor pCursor, PBYTE pBuffer, UINT32 bufferSize, PUINT32 pSize)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 offset, len;
+
+    CHK(pAppReplay != NULL && pCursor != NULL && pSize != NULL && (pBuffer != NULL || bufferSize == 0), STATUS_APP_REPLAY_NULL_ARG);
+    *pSize = 0;
+    CHK(pCursor->active, retStatus);
+
+    if (pCursor->inFrame && pCursor->offset == pCursor->frame.size) {
+        pCursor->position += APP_REPLAY_RECORD_LEN(pCursor->frame.size);
+        pCursor->inFrame = FALSE;
+        pCursor->offset = 0;
+    }
+    while (!pCursor->inFrame) {
+        if (pCursor->position == pCursor->end) {
+            pCursor->active = FALSE;
+            CHK(FALSE, retStatus);
+        }
+        offset = (UINT32) (pCursor->position % pAppReplay->capacity);
+        if (pAppReplay->capacity - offset < SIZEOF(AppReplayFrame)) {
+            pCursor->position += pAppReplay->capacity - offset;
+            continue;
+        }
+        MEMCPY(&pCursor->frame, pAppReplay->pBuffer + offset, SIZEOF(AppReplayFrame));
+        CHK(isAppReplayPositionValid(pAppReplay, pCursor->position), STATUS_APP_REPLAY_OVERRUN);
+        if (pCursor->frame.size == APP_REPLAY_PADDING) {
+            pCursor->position += pAppReplay->capacity - offset;
+        } else {
+            pCursor->inFrame = TRUE;
+        }
+    }
+
+    offset = (UINT32) (pCursor->position % pAppReplay->capacity);
+    len = MIN(bufferSize, pCursor->frame.size - pCursor->offset);
+    MEMCPY(pBuffer, pAppReplay->pBuffer + offset + SIZEOF(AppReplayFrame) + pCursor->offset, len);
+    CHK(isAppReplayPositionValid(pAppReplay, pCursor->position), STATUS_APP_REPLAY_OVERRUN);
+    pCursor->offset += len;
+    *pSize = len;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS serveAppReplay(PAppReplay pAppReplay, PAppReplayCursor pCursor, PRtcDataChannel pRtcDataChannel, UINT32 budget)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    AppReplayCursor cursor;
+    PBYTE pChunk = NULL;
+    UINT32 size, len, sent = 0;
+
+    CHK(pAppReplay != NULL && pCursor != NULL && pRtcDataChannel != NULL, STATUS_APP_REPLAY_NULL_ARG);
+    CHK(pCursor->active, retStatus);
+    CHK(NULL != (pChunk = (PBYTE) MEMALLOC(APP_REPLAY_CHUNK_HEADER_LEN + APP_REPLAY_CHUNK_SIZE)), STATUS_APP_REPLAY_NOT_ENOUGH_MEMORY);
+
+    while (sent < budget && pCursor->active) {
+        cursor = *pCursor;
+        CHK_STATUS((readAppReplay(pAppReplay, pCursor, pChunk + APP_REPLAY_CHUNK_HEADER_LEN, APP_REPLAY_CHUNK_SIZE, &size)));
+        MEMSET(pChunk, 0x00, APP_REPLAY_CHUNK_HEADER_LEN);
+        if (pCursor->active) {
+            putAppReplayUint32(pChunk, pCursor->frame.size);
+            putAppReplayUint32(pChunk + 4, pCursor->offset - size);
+            putAppReplayUint32(pChunk + 8, pCursor->frame.flags);
+            putAppReplayUint32(pChunk + 12, (UINT32) pCursor->frame.trackId);
+            putAppReplayUint64(pChunk + 16, pCursor->frame.presentationTs);
+            putAppReplayUint64(pChunk + 24, pCursor->frame.decodingTs);
+        }
+        len = APP_REPLAY_CHUNK_HEADER_LEN + size;
+        // The sdk does not expose the buffered amount of the sctp association, the refused chunk is read again next time.
+        if (STATUS_FAILED(dataChannelSend(pRtcDataChannel, TRUE, pChunk, len))) {
+            *pCursor = cursor;
+            break;
+        }
+        sent += len;
+    }
+
+CleanUp:
+
+    // The cursor is lost once the reads fail, the viewer asks again.
+    if (STATUS_FAILED(retStatus) && pChunk != NULL) {
+        DLOGW("Failed to serve the replay(0x%08x), it ends early", retStatus);
+        pCursor->active = FALSE;
+    }
+    SAFE_MEMFREE(pChunk);
+    return retStatus;
+}
@@ -15,6 +15,7 @@
 #define LOG_CLASS "AppRtspSrc"
 #include "AppRtspSrc.h"
 #include "AppRtspSrcWrap.h"
+#include "AppLockProfiler.h"
 
 #define GST_ELEMENT_FACTORY_NAME_RTSPSRC        "rtspsrc"
 #define GST_ELEMENT_FACTORY_NAME_QUEUE          "queue"
@@ -31,6 +32,7 @@
 #define GST_SIGNAL_CALLBACK_PAD_ADDED    "pad-added"
 #define GST_SIGNAL_CALLBACK_PAD_REMOVED  "pad-removed"
 #define GST_SIGNAL_CALLBACK_NO_MORE_PADS "no-more-pads"
+#define GST_SIGNAL_CALLBACK_SELECT_STREAM "select-stream"
 #define GST_SIGNAL_CALLBACK_MSG_ERROR    "message::error"
 #define GST_SIGNAL_CALLBACK_MSG_EOS      "message::eos"
 
@@ -70,8 +72,28 @@ typedef struct {
     CHAR url[MAX_URI_CHAR_LEN];                 //!< the rtsp url.
     CHAR username[APP_MEDIA_RTSP_USERNAME_LEN]; //!< the username to login the rtsp url.
     CHAR password[APP_MEDIA_RTSP_PASSWORD_LEN]; //!< the password to login the rtsp url.
+    BOOL selectVideo;                           //!< set up the video stream of the camera.
+    BOOL selectAudio;                           //!< set up the audio stream of the camera.
 } RtspServerConfiguration, *PRtspServerConfiguration;
 
+#define MEDIA_WATCH_VIDEO  0
+#define MEDIA_WATCH_AUDIO  1
+#define MEDIA_WATCH_TRACKS 2
+
+typedef struct {
+    UINT64 frameCount;    //!< the frames of the track.
+    BOOL seen;            //!< the track delivered a frame in the current pipeline.
+    UINT64 lastArrival;   //!< the time the last frame comes.
+    UINT64 maxFrameGap;   //!< the longest time between two frames of the same pipeline.
+} MediaTrackWatch, *PMediaTrackWatch;
+
+typedef struct {
+    BOOL seen;            //!< the track delivered a frame.
+    UINT64 lastDts;       //!< the decoding timestamp of the last frame in 100ns.
+    UINT64 lastPts;       //!< the latest presentation timestamp of the track in 100ns, the b-frames do not lower it.
+    UINT64 frameInterval; //!< the moving average of the decoding timestamp deltas in 100ns, the only estimate of the track.
+} MediaTrackTiming, *PMediaTrackTiming;
+
 typedef struct {
     MUTEX codecConfLock;
     RtspServerConfiguration rtspServerConf; //!< the configuration of rtsp camera.
@@ -84,14 +106,41 @@ typedef struct {
     MediaSinkHook mediaSinkHook;
     PVOID mediaEosHookUserdata;
     MediaEosHook mediaEosHook;
+    // for the runner of the pipeline.
+    MUTEX runLock;
+    CVAR runCvar;
+    BOOL running; //!< the pipeline is running.
+    // for the reconnection of the camera.
+    UINT32 reconnectRetries;            //!< the failed rebuilds before giving up, 0 disables the reconnection.
+    volatile ATOMIC_BOOL stopRtspSrc;   //!< the pipeline is stopped on purpose and it is not rebuilt.
+    volatile ATOMIC_BOOL mediaLost;     //!< the camera is lost, the first frame of the rebuilt pipeline ends the downtime.
+    volatile ATOMIC_BOOL awaitKeyFrame; //!< drop the video until a key frame after a rebuild.
+    UINT64 mediaLostTime;               //!< the time the camera is lost.
+    MediaReconnectStats reconnectStats; //!< protected by runLock.
+    // for the watchdog of the stalled pipelines.
+    MUTEX watchLock;
+    CVAR watchCvar;
+    TID watchdogTid;
+    volatile ATOMIC_BOOL terminateWatchdog;
+    UINT64 stallTimeout;                            //!< the shortest gap of frames which is a stall, 0 disables the watchdog.
+    MediaTrackWatch trackWatch[MEDIA_WATCH_TRACKS]; //!< protected by watchLock.
+    BOOL pipelinePlaying;                           //!< the pipeline is watched.
+    BOOL pipelineStalled;                           //!< the watchdog is closing the pipeline.
+    UINT64 pipelineStartTime;                       //!< the time the pipeline starts.
+    UINT64 stallCount;                              //!< the pipelines restarted by the watchdog.
+    // for the timestamps of the frames.
+    MUTEX timingLock;
+    MediaTrackTiming trackTiming[MEDIA_WATCH_TRACKS]; //!< protected by timingLock.
+    INT64 timestampOffset;                            //!< added to the running times of the pipeline, in 100ns.
+    BOOL rebaseTimestamps;                            //!< the next frame is the first one of a new pipeline.
 } RtspSrcContext, *PRtspSrcContext;
 
 static void updateCodecStatus(PRtspSrcContext pRtspSrcContext, STATUS retStatus)
 {
     PCodecConfiguration pGstConfiguration = &pRtspSrcContext->codecConfiguration;
-    MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
     pGstConfiguration->codecStatus = retStatus;
-    MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
 }
 /**
  * @brief quitting the main loop of gstreamer.
@@ -105,15 +154,26 @@ static STATUS closeGstRtspSrc(PRtspSrcContext pRtspSrcContext)
     STATUS retStatus = STATUS_SUCCESS;
 
     DLOGD("closing the gst rtspsrc.");
-    MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
     PCodecConfiguration pGstConfiguration = &pRtspSrcContext->codecConfiguration;
     if (pGstConfiguration->mainLoop != NULL) {
         app_g_main_loop_quit(pGstConfiguration->mainLoop);
     }
     ATOMIC_STORE_BOOL(&pRtspSrcContext->shutdownRtspSrc, FALSE);
-    MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
     return retStatus;
 }
+/**
+ * @brief pass the end of the stream to the eos hook.
+ *
+ * @param[in] pRtspSrcContext the context of rtspsrc.
+ */
+static VOID notifyMediaEos(PRtspSrcContext pRtspSrcContext)
+{
+    if (pRtspSrcContext->mediaEosHook != NULL) {
+        CHK_LOG_ERR((pRtspSrcContext->mediaEosHook(pRtspSrcContext->mediaEosHookUserdata)));
+    }
+}
 /**
  * @brief the callback is invoked when the error happens on the bus.
  *
@@ -173,8 +233,9 @@ static void onMsgEosFromBus(GstBus* bus, GstMessage* msg, gpointer* udata)
     CHK((bus != NULL) && (msg != NULL) && (udata != NULL), STATUS_MEDIA_NULL_ARG);
     pGstConfiguration = &pRtspSrcContext->codecConfiguration;
     closeGstRtspSrc(pRtspSrcContext);
-    if (pRtspSrcContext->mediaEosHook != NULL) {
-        retStatus = pRtspSrcContext->mediaEosHook(pRtspSrcContext->mediaEosHookUserdata);
+    // The supervisor rebuilds the pipeline and keeps the sessions, they only hear of the eos when it gives up.
+    if (pRtspSrcContext->reconnectRetries == 0) {
+        notifyMediaEos(pRtspSrcContext);
     }
 
 CleanUp:
@@ -185,6 +246,135 @@ CleanUp:
 
     return;
 }
+/**
+ * @brief the first frame of a rebuilt pipeline ends the downtime.
+ *
+ * @param[in] pRtspSrcContext the context of rtspsrc.
+ */
+static VOID markMediaSourceRecovered(PRtspSrcContext pRtspSrcContext)
+{
+    PMediaReconnectStats pReconnectStats = &pRtspSrcContext->reconnectStats;
+    UINT64 downtime;
+
+    APP_MUTEX_LOCK(pRtspSrcContext->runLock);
+    if (ATOMIC_EXCHANGE_BOOL(&pRtspSrcContext->mediaLost, FALSE)) {
+        downtime = GETTIME() - pRtspSrcContext->mediaLostTime;
+        pReconnectStats->reconnectCount++;
+        pReconnectStats->downtime += downtime;
+        pReconnectStats->attempt = 0;
+        DLOGI("media source reconnected after %" PRIu64 " ms", downtime / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    }
+    APP_MUTEX_UNLOCK(pRtspSrcContext->runLock);
+}
+/**
+ * @brief feed a frame of the track to the watchdog.
+ *
+ * @param[in] pRtspSrcContext the context of rtspsrc.
+ * @param[in] trackid the track of the frame.
+ * @param[in] arrival the time the frame comes.
+ */
+static VOID watchMediaFrame(PRtspSrcContext pRtspSrcContext, UINT64 trackid, UINT64 arrival)
+{
+    PMediaTrackWatch pTrackWatch =
+        &pRtspSrcContext->trackWatch[trackid == DEFAULT_VIDEO_TRACK_ID ? MEDIA_WATCH_VIDEO : MEDIA_WATCH_AUDIO];
+
+    APP_MUTEX_LOCK(pRtspSrcContext->watchLock);
+    if (pTrackWatch->seen) {
+        pTrackWatch->maxFrameGap = MAX(pTrackWatch->maxFrameGap, arrival - pTrackWatch->lastArrival);
+    }
+    pTrackWatch->seen = TRUE;
+    pTrackWatch->lastArrival = arrival;
+    pTrackWatch->frameCount++;
+    APP_MUTEX_UNLOCK(pRtspSrcContext->watchLock);
+}
+/**
+ * @brief get the frame interval of the track which stampMediaFrame estimates, 0 before two frames.
+ *
+ * @param[in] pRtspSrcContext the context of rtspsrc.
+ * @param[in] index the index of the track, MEDIA_WATCH_VIDEO or MEDIA_WATCH_AUDIO.
+ *
+ * @return the frame interval in 100ns.
+ */
+static UINT64 getMediaFrameInterval(PRtspSrcContext pRtspSrcContext, UINT32 index)
+{
+    UINT64 frameInterval;
+
+    APP_MUTEX_LOCK(pRtspSrcContext->timingLock);
+    frameInterval = pRtspSrcContext->trackTiming[index].frameInterval;
+    APP_MUTEX_UNLOCK(pRtspSrcContext->timingLock);
+    return frameInterval;
+}
+/**
+ * @brief set the timestamps and the duration of the frame. The timestamps are the running times of the buffer, they carry
+ *        the rtp timestamps of the camera through the jitter buffer, so the sdk maps them back into the same rtp clock. The
+ *        decoding timestamp is the one of the buffer when the depayloader sets it, the b-frames come in decoding order with
+ *        the presentation timestamps out of order. The running times of a rebuilt pipeline are shifted by an offset, so the
+ *        timestamps never go back for the viewers.
+ *
+ * @param[in] pRtspSrcContext the context of rtspsrc.
+ * @param[in] trackid the track of the frame.
+ * @param[in] segment the segment of the sample.
+ * @param[in] buffer the buffer of the frame.
+ * @param[in] pts the running time of the presentation timestamp in ns.
+ * @param[out] pFrame the frame.
+ */
+static VOID stampMediaFrame(PRtspSrcContext pRtspSrcContext, UINT64 trackid, GstSegment* segment, GstBuffer* buffer, GstClockTime pts,
+                            PFrame pFrame)
+{
+    PMediaTrackTiming pTrackTiming =
+        &pRtspSrcContext->trackTiming[trackid == DEFAULT_VIDEO_TRACK_ID ? MEDIA_WATCH_VIDEO : MEDIA_WATCH_AUDIO];
+    PMediaTrackTiming pOtherTiming;
+    GstClockTime dts = pts;
+    UINT64 delta, resumeTs = 0;
+    BOOL resume = FALSE;
+    UINT32 i;
+
+    if (GST_BUFFER_DTS_IS_VALID(buffer)) {
+        dts = app_gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_DTS(buffer));
+        // a dts before the segment has no running time, and a frame is not decoded after it is presented.
+        if (!GST_CLOCK_TIME_IS_VALID(dts) || dts > pts) {
+            dts = pts;
+        }
+    }
+    APP_MUTEX_LOCK(pRtspSrcContext->timingLock);
+    // The running times of a new pipeline start over. Its first frame goes on after the latest frame of the old one, and one
+    // offset for all the tracks keeps them in sync.
+    if (pRtspSrcContext->rebaseTimestamps) {
+        pRtspSrcContext->rebaseTimestamps = FALSE;
+        for (i = 0; i < MEDIA_WATCH_TRACKS; i++) {
+            pOtherTiming = &pRtspSrcContext->trackTiming[i];
+            if (pOtherTiming->seen) {
+                resumeTs = MAX(resumeTs, pOtherTiming->lastPts + MAX(pOtherTiming->frameInterval, 1));
+                resume = TRUE;
+            }
+        }
+        if (resume) {
+            pRtspSrcContext->timestampOffset = (INT64) resumeTs - (INT64) (pts / DEFAULT_TIME_UNIT_IN_NANOS);
+            DLOGI("the timestamps of the new pipeline resume at %" PRIu64 " ms", resumeTs / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+        }
+    }
+    pFrame->presentationTs = (UINT64) ((INT64) (pts / DEFAULT_TIME_UNIT_IN_NANOS) + pRtspSrcContext->timestampOffset);
+    pFrame->decodingTs = (UINT64) ((INT64) (dts / DEFAULT_TIME_UNIT_IN_NANOS) + pRtspSrcContext->timestampOffset);
+
+    // The decoding timestamps are monotonic even with b-frames, their deltas are the frame interval. A rebuilt pipeline or a gap
+    // of the camera is not one. The watchdog and the duration of the frames, which the pacer reads, share this estimate.
+    if (pTrackTiming->seen && pFrame->decodingTs > pTrackTiming->lastDts) {
+        delta = pFrame->decodingTs - pTrackTiming->lastDts;
+        if (delta <= HUNDREDS_OF_NANOS_IN_A_SECOND) {
+            pTrackTiming->frameInterval = pTrackTiming->frameInterval == 0 ? delta : (pTrackTiming->frameInterval * 7 + delta) / 8;
+        }
+    }
+    pTrackTiming->seen = TRUE;
+    pTrackTiming->lastDts = pFrame->decodingTs;
+    pTrackTiming->lastPts = MAX(pTrackTiming->lastPts, pFrame->presentationTs);
+    // The depayloaders of the audio set the duration of the buffer, the video ones mostly do not.
+    if (GST_BUFFER_DURATION_IS_VALID(buffer)) {
+        pFrame->duration = GST_BUFFER_DURATION(buffer) / DEFAULT_TIME_UNIT_IN_NANOS;
+    } else {
+        pFrame->duration = pTrackTiming->frameInterval;
+    }
+    APP_MUTEX_UNLOCK(pRtspSrcContext->timingLock);
+}
 /**
  * @brief the callback is invoked when the sample of stream comes.
  *
@@ -206,7 +396,9 @@ static GstFlowReturn onNewSampleFromAppSink(GstElement* sink, gpointer udata, UI
     GstMapInfo info;
     GstSegment* segment;
     GstClockTime buf_pts;
+    MediaFrameTiming timing;
 
+    timing.sinkEntryTime = GETTIME();
     info.data = NULL;
     CHK((sink != NULL) && (pRtspSrcContext != NULL), STATUS_MEDIA_NULL_ARG);
 
@@ -229,19 +421,32 @@ static GstFlowReturn onNewSampleFromAppSink(GstElement* sink, gpointer udata, UI
             DLOGI("frame contains invalid PTS, dropping the frame.");
             goto CleanUp;
         }
+        if (pRtspSrcContext->stallTimeout != 0) {
+            watchMediaFrame(pRtspSrcContext, trackid, timing.sinkEntryTime);
+        }
+        // After a rebuild the sessions resume on a key frame, the delta frames before it can not be decoded.
+        if (trackid == DEFAULT_VIDEO_TRACK_ID && ATOMIC_LOAD_BOOL(&pRtspSrcContext->awaitKeyFrame)) {
+            if (delta) {
+                goto CleanUp;
+            }
+            ATOMIC_STORE_BOOL(&pRtspSrcContext->awaitKeyFrame, FALSE);
+        }
+        if (ATOMIC_LOAD_BOOL(&pRtspSrcContext->mediaLost)) {
+            markMediaSourceRecovered(pRtspSrcContext);
+        }
         if (!(app_gst_buffer_map(buffer, &info, GST_MAP_READ))) {
             DLOGI("media buffer mapping failed");
             goto CleanUp;
         }
+        timing.mappedTime = GETTIME();
+        timing.clockOffset = (INT64) timing.sinkEntryTime - (INT64) (buf_pts / DEFAULT_TIME_UNIT_IN_NANOS);
         frame.trackId = trackid;
-        frame.duration = 0;
         frame.version = FRAME_CURRENT_VERSION;
         frame.size = (UINT32) info.size;
         frame.frameData = (PBYTE) info.data;
-        frame.presentationTs = buf_pts * DEFAULT_TIME_UNIT_IN_NANOS;
-        frame.decodingTs = frame.presentationTs;
+        stampMediaFrame(pRtspSrcContext, trackid, segment, buffer, buf_pts, &frame);
         if (pRtspSrcContext->mediaSinkHook != NULL) {
-            retStatus = pRtspSrcContext->mediaSinkHook(pRtspSrcContext->mediaSinkHookUserdata, &frame);
+            retStatus = pRtspSrcContext->mediaSinkHook(pRtspSrcContext->mediaSinkHookUserdata, &frame, &timing);
         }
     }
 
@@ -257,6 +462,7 @@ CleanUp:
         gstFlowReturn = GST_FLOW_EOS;
     }
     if (pRtspSrcContext != NULL && (gstFlowReturn == GST_FLOW_EOS || ATOMIC_LOAD_BOOL(&pRtspSrcContext->shutdownRtspSrc))) {
+        ATOMIC_STORE_BOOL(&pRtspSrcContext->stopRtspSrc, TRUE);
         closeGstRtspSrc(pRtspSrcContext);
     }
     return gstFlowReturn;
@@ -301,7 +507,7 @@ static STATUS createDummyAppSink(PRtspSrcContext pRtspSrcContext, GstElement** p
     GstElement* pipeline;
     GstElement* dummySink = NULL;
 
-    MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
 
     pipeline = (GstElement*) pRtspSrcContext->codecConfiguration.pipeline;
     SNPRINTF(elementName, APP_MEDIA_GST_ELEMENT_NAME_MAX_LEN, "dummySink%s", name);
@@ -315,7 +521,7 @@ CleanUp:
         app_gst_object_unref(dummySink);
     }
 
-    MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
 
     *ppDummySink = dummySink;
     return retStatus;
@@ -339,7 +545,7 @@ static STATUS createVideoAppSink(PRtspSrcContext pRtspSrcContext, GstElement** p
     GstElement *videoDepay = NULL, *videoFilter = NULL, *videoAppSink = NULL;
     GstCaps* videoCaps = NULL;
 
-    MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
 
     pCodecStreamConf = &pRtspSrcContext->codecConfiguration.videoStream;
     pipeline = (GstElement*) pRtspSrcContext->codecConfiguration.pipeline;
@@ -384,7 +590,7 @@ CleanUp:
         app_gst_object_unref(videoFilter);
         app_gst_object_unref(videoAppSink);
     }
-    MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
 
     *ppVideoQueue = videoQueue;
     return retStatus;
@@ -408,7 +614,7 @@ static STATUS createAudioAppSink(PRtspSrcContext pRtspSrcContext, GstElement** p
     GstElement *audioDepay = NULL, *audioFilter = NULL, *audioAppSink = NULL;
     GstCaps* audioCaps = NULL;
 
-    MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
 
     pCodecStreamConf = &pRtspSrcContext->codecConfiguration.audioStream;
     pipeline = (GstElement*) pRtspSrcContext->codecConfiguration.pipeline;
@@ -454,11 +660,62 @@ CleanUp:
         app_gst_object_unref(audioAppSink);
     }
 
-    MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
 
     *ppAudioQueue = audioQueue;
     return retStatus;
 }
+/**
+ * @brief the channel uses the stream of this media or not.
+ *
+ * @param[in] pRtspSrcContext the context of rtspsrc.
+ * @param[in] media the media of the stream in the sdp.
+ *
+ * @return TRUE if the stream is set up.
+ */
+static BOOL isMediaSelected(PRtspSrcContext pRtspSrcContext, const gchar* media)
+{
+    PRtspServerConfiguration pRtspServerConf = &pRtspSrcContext->rtspServerConf;
+
+    if (media == NULL) {
+        return TRUE;
+    } else if (STRCMP(media, GST_STRUCT_FIELD_MEDIA_VIDEO) == 0) {
+        return pRtspServerConf->selectVideo;
+    } else if (STRCMP(media, GST_STRUCT_FIELD_MEDIA_AUDIO) == 0) {
+        return pRtspServerConf->selectAudio;
+    }
+    return TRUE;
+}
+/**
+ * @brief   the callback is invoked before rtspsrc sets up a stream of the sdp. The streams the channel does not use are not set
+ *          up, so the camera does not send them at all.
+ *
+ * @param[in] element the element.
+ * @param[in] num the index of the stream.
+ * @param[in] caps the caps of the stream.
+ * @param[in] udata the user data.
+ *
+ * @return TRUE to set up the stream.
+ */
+static gboolean onRtspSrcSelectStream(GstElement* element, guint num, GstCaps* caps, gpointer udata)
+{
+    PRtspSrcContext pRtspSrcContext = (PRtspSrcContext) udata;
+    GstStructure* srcPadStructure = NULL;
+    const gchar* media = NULL;
+
+    if (pRtspSrcContext == NULL || caps == NULL || app_gst_caps_get_size(caps) == 0) {
+        return TRUE;
+    }
+    srcPadStructure = app_gst_caps_get_structure(caps, 0);
+    if (app_gst_structure_has_field(srcPadStructure, GST_STRUCT_FIELD_MEDIA) == TRUE) {
+        media = app_gst_structure_get_string(srcPadStructure, GST_STRUCT_FIELD_MEDIA);
+    }
+    if (!isMediaSelected(pRtspSrcContext, media)) {
+        DLOGI("the %s stream %u is not set up", media, num);
+        return FALSE;
+    }
+    return TRUE;
+}
 /**
  * @brief   the callback is invoked when the pad is added.
  *
@@ -495,7 +752,7 @@ static void onRtspSrcPadAddedDiscovery(GstElement* element, GstPad* pad, gpointe
     srcPadCurrentCaps = app_gst_pad_get_current_caps(pad);
     curCapsNum = app_gst_caps_get_size(srcPadCurrentCaps);
 
-    MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
     locked = TRUE;
     for (i = 0; i < curCapsNum; i++) {
         srcPadStructure = app_gst_caps_get_structure(srcPadCurrentCaps, i);
@@ -507,6 +764,10 @@ static void onRtspSrcPadAddedDiscovery(GstElement* element, GstPad* pad, gpointe
             const gchar* encoding_name = app_gst_structure_get_string(srcPadStructure, GST_STRUCT_FIELD_ENCODING);
             DLOGD("media:%s, encoding_name:%s", media, encoding_name);
 
+            if (!isMediaSelected(pRtspSrcContext, media)) {
+                DLOGI("the %s stream is not selected", media);
+                continue;
+            }
             if (STRCMP(media, GST_STRUCT_FIELD_MEDIA_VIDEO) == 0) {
                 video = TRUE;
                 pCodecStreamConf = &pGstConfiguration->videoStream;
@@ -559,7 +820,7 @@ static void onRtspSrcPadAddedDiscovery(GstElement* element, GstPad* pad, gpointe
 
 CleanUp:
     if (locked) {
-        MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+        APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
     }
     if (srcPadName != NULL) {
         app_g_free(srcPadName);
@@ -629,7 +890,7 @@ static void onRtspSrcPadAdded(GstElement* element, GstPad* pad, gpointer udata)
     pGstConfiguration = &pRtspSrcContext->codecConfiguration;
     pipeline = (GstElement*) pGstConfiguration->pipeline;
 
-    MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
     locked = TRUE;
     srcPadName = app_gst_pad_get_name(pad);
     srcPadTemplateCaps = app_gst_pad_get_pad_template_caps(pad);
@@ -660,7 +921,11 @@ static void onRtspSrcPadAdded(GstElement* element, GstPad* pad, gpointer udata)
                 DLOGD("payload type:%d", payloadType);
             }
 
-            if (video == TRUE && pCodecStreamConf->payloadType == payloadType) {
+            // a camera may send a stream it is not asked for, it ends in a dummy sink instead of a depayloader.
+            if (!isMediaSelected(pRtspSrcContext, media_value)) {
+                DLOGW("the %s stream is not selected, and connecting dummy sink", media_value);
+                CHK_STATUS((createDummyAppSink(pRtspSrcContext, &nextElement, srcPadName)));
+            } else if (video == TRUE && pCodecStreamConf->payloadType == payloadType) {
                 DLOGD("connecting video sink");
                 CHK_STATUS((createVideoAppSink(pRtspSrcContext, &nextElement, srcPadName)));
             } else if (audio == TRUE && pCodecStreamConf->payloadType == payloadType) {
@@ -679,7 +944,7 @@ static void onRtspSrcPadAdded(GstElement* element, GstPad* pad, gpointer udata)
 
 CleanUp:
     if (locked) {
-        MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+        APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
     }
     if (srcPadName != NULL) {
         app_g_free(srcPadName);
@@ -741,7 +1006,7 @@ static STATUS initGstRtspSrc(PRtspSrcContext pRtspSrcContext, GstElement* pipeli
     PRtspServerConfiguration pRtspServerConf = NULL;
     GstElement* rtspSource = NULL;
 
-    MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
     rtspSource = app_gst_element_factory_make(GST_ELEMENT_FACTORY_NAME_RTSPSRC, "rtspSource");
     CHK(rtspSource != NULL, STATUS_MEDIA_MISSING_PLUGIN);
     // configure rtspsrc
@@ -757,6 +1022,7 @@ static STATUS initGstRtspSrc(PRtspSrcContext pRtspSrcContext, GstElement* pipeli
     }
 
     // setup the callbacks.
+    app_g_signal_connect(APP_G_OBJECT(rtspSource), GST_SIGNAL_CALLBACK_SELECT_STREAM, G_CALLBACK(onRtspSrcSelectStream), pRtspSrcContext);
     if (enableProbe == FALSE) {
         DLOGD("initializing rtspsrc");
         app_g_signal_connect(APP_G_OBJECT(rtspSource), GST_SIGNAL_CALLBACK_PAD_ADDED, G_CALLBACK(onRtspSrcPadAdded), pRtspSrcContext);
@@ -770,7 +1036,7 @@ static STATUS initGstRtspSrc(PRtspSrcContext pRtspSrcContext, GstElement* pipeli
     app_gst_bin_add_many(APP_GST_BIN(pipeline), rtspSource, NULL);
 
 CleanUp:
-    MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+    APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
     return retStatus;
 }
 /**
@@ -837,7 +1103,8 @@ CleanUp:
 static STATUS latchRtspConfig(PRtspServerConfiguration pRtspServerConf)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    PCHAR pRtspUrl, pRtspUsername, pRtspPassword;
+    PCHAR pRtspUrl, pRtspUsername, pRtspPassword, pRtspTracks, pTrack, pNext;
+    SIZE_T trackLen;
 
     CHK_ERR((pRtspUrl = GETENV(APP_MEDIA_RTSP_URL)) != NULL, STATUS_MEDIA_RTSP_URL, "RTSP_URL must be set");
     STRNCPY(pRtspServerConf->url, pRtspUrl, MAX_URI_CHAR_LEN);
@@ -854,23 +1121,94 @@ static STATUS latchRtspConfig(PRtspServerConfiguration pRtspServerConf)
         MEMSET(pRtspServerConf->username, 0, APP_MEDIA_RTSP_USERNAME_LEN);
         MEMSET(pRtspServerConf->password, 0, APP_MEDIA_RTSP_PASSWORD_LEN);
     }
+
+    // The tracks are a list like "video,audio", a listen-only or a mute channel sets up one stream of the camera.
+    pRtspServerConf->selectVideo = TRUE;
+    pRtspServerConf->selectAudio = TRUE;
+    if ((pRtspTracks = GETENV(APP_MEDIA_RTSP_TRACKS)) != NULL) {
+        pRtspServerConf->selectVideo = FALSE;
+        pRtspServerConf->selectAudio = FALSE;
+        // every token must name a track, a typo must not select a track by a substring.
+        for (pTrack = pRtspTracks; pTrack != NULL; pTrack = pNext == NULL ? NULL : pNext + 1) {
+            pNext = STRCHR(pTrack, ',');
+            trackLen = pNext == NULL ? STRLEN(pTrack) : (SIZE_T) (pNext - pTrack);
+            if (trackLen == STRLEN(GST_STRUCT_FIELD_MEDIA_VIDEO) && STRNCMP(pTrack, GST_STRUCT_FIELD_MEDIA_VIDEO, trackLen) == 0) {
+                pRtspServerConf->selectVideo = TRUE;
+            } else if (trackLen == STRLEN(GST_STRUCT_FIELD_MEDIA_AUDIO) && STRNCMP(pTrack, GST_STRUCT_FIELD_MEDIA_AUDIO, trackLen) == 0) {
+                pRtspServerConf->selectAudio = TRUE;
+            } else {
+                CHK_ERR(FALSE, STATUS_MEDIA_RTSP_TRACKS, "invalid %s: %s", APP_MEDIA_RTSP_TRACKS, pRtspTracks);
+            }
+        }
+    }
 CleanUp:
     return retStatus;
 }
 
-STATUS initMediaSource(PMediaContext* ppMediaContext)
+static VOID freeRtspSrcContext(PRtspSrcContext pRtspSrcContext)
+{
+    if (IS_VALID_MUTEX_VALUE(pRtspSrcContext->codecConfLock)) {
+        MUTEX_FREE(pRtspSrcContext->codecConfLock);
+    }
+    if (IS_VALID_CVAR_VALUE(pRtspSrcContext->runCvar)) {
+        CVAR_FREE(pRtspSrcContext->runCvar);
+    }
+    if (IS_VALID_MUTEX_VALUE(pRtspSrcContext->runLock)) {
+        MUTEX_FREE(pRtspSrcContext->runLock);
+    }
+    if (IS_VALID_CVAR_VALUE(pRtspSrcContext->watchCvar)) {
+        CVAR_FREE(pRtspSrcContext->watchCvar);
+    }
+    if (IS_VALID_MUTEX_VALUE(pRtspSrcContext->watchLock)) {
+        MUTEX_FREE(pRtspSrcContext->watchLock);
+    }
+    if (IS_VALID_MUTEX_VALUE(pRtspSrcContext->timingLock)) {
+        MUTEX_FREE(pRtspSrcContext->timingLock);
+    }
+    MEMFREE(pRtspSrcContext);
+}
+/**
+ * @brief create the context of the ingest.
+ *
+ * @param[in] pRtspServerConf the configuration of the rtsp camera.
+ * @param[out] ppRtspSrcContext the context.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+static STATUS createRtspSrcContext(PRtspServerConfiguration pRtspServerConf, PRtspSrcContext* ppRtspSrcContext)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PRtspSrcContext pRtspSrcContext = NULL;
     PCodecConfiguration pGstConfiguration;
     PCodecStreamConf pVideoStream;
     PCodecStreamConf pAudioStream;
+    PCHAR pValue;
+    UINT32 stallTimeout;
 
-    CHK(ppMediaContext != NULL, STATUS_MEDIA_NULL_ARG);
-    *ppMediaContext = NULL;
     CHK(NULL != (pRtspSrcContext = (PRtspSrcContext) MEMCALLOC(1, SIZEOF(RtspSrcContext))), STATUS_MEDIA_NOT_ENOUGH_MEMORY);
     ATOMIC_STORE_BOOL(&pRtspSrcContext->shutdownRtspSrc, FALSE);
     ATOMIC_STORE_BOOL(&pRtspSrcContext->codecConfigLatched, FALSE);
+    ATOMIC_STORE_BOOL(&pRtspSrcContext->stopRtspSrc, FALSE);
+    ATOMIC_STORE_BOOL(&pRtspSrcContext->mediaLost, FALSE);
+    ATOMIC_STORE_BOOL(&pRtspSrcContext->awaitKeyFrame, FALSE);
+    ATOMIC_STORE_BOOL(&pRtspSrcContext->terminateWatchdog, FALSE);
+    pRtspSrcContext->watchdogTid = INVALID_TID_VALUE;
+    pRtspSrcContext->reconnectRetries = APP_MEDIA_RECONNECT_FOREVER;
+    if ((pValue = GETENV(APP_MEDIA_RTSP_RECONNECT_RETRIES)) != NULL &&
+        STRTOUI32(pValue, NULL, 10, &pRtspSrcContext->reconnectRetries) != STATUS_SUCCESS) {
+        DLOGW("invalid %s: %s, reconnecting forever", APP_MEDIA_RTSP_RECONNECT_RETRIES, pValue);
+        pRtspSrcContext->reconnectRetries = APP_MEDIA_RECONNECT_FOREVER;
+    }
+    pRtspSrcContext->stallTimeout = APP_MEDIA_STALL_TIMEOUT;
+    if ((pValue = GETENV(APP_MEDIA_RTSP_STALL_TIMEOUT)) != NULL) {
+        if (STRTOUI32(pValue, NULL, 10, &stallTimeout) == STATUS_SUCCESS) {
+            pRtspSrcContext->stallTimeout = (UINT64) stallTimeout * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+        } else {
+            DLOGW("invalid %s: %s, using %" PRIu64 " ms", APP_MEDIA_RTSP_STALL_TIMEOUT, pValue,
+                  pRtspSrcContext->stallTimeout / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+        }
+    }
+    MEMCPY(&pRtspSrcContext->rtspServerConf, pRtspServerConf, SIZEOF(RtspServerConfiguration));
 
     pGstConfiguration = &pRtspSrcContext->codecConfiguration;
     pGstConfiguration->codecStatus = STATUS_SUCCESS;
@@ -881,20 +1219,48 @@ STATUS initMediaSource(PMediaContext* ppMediaContext)
 
     pRtspSrcContext->codecConfLock = MUTEX_CREATE(TRUE);
     CHK(IS_VALID_MUTEX_VALUE(pRtspSrcContext->codecConfLock), STATUS_MEDIA_INVALID_MUTEX);
+    pRtspSrcContext->runLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pRtspSrcContext->runLock), STATUS_MEDIA_INVALID_MUTEX);
+    pRtspSrcContext->runCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pRtspSrcContext->runCvar), STATUS_MEDIA_INVALID_CVAR);
+    pRtspSrcContext->watchLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pRtspSrcContext->watchLock), STATUS_MEDIA_INVALID_MUTEX);
+    pRtspSrcContext->watchCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pRtspSrcContext->watchCvar), STATUS_MEDIA_INVALID_CVAR);
+    pRtspSrcContext->timingLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pRtspSrcContext->timingLock), STATUS_MEDIA_INVALID_MUTEX);
     // initialize the gstreamer
     app_gst_init(NULL, NULL);
+    *ppRtspSrcContext = pRtspSrcContext;
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && pRtspSrcContext != NULL) {
+        freeRtspSrcContext(pRtspSrcContext);
+    }
+
+    return retStatus;
+}
+STATUS initMediaSource(PMediaContext* ppMediaContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PRtspSrcContext pRtspSrcContext = NULL;
+    RtspServerConfiguration rtspServerConf;
+
+    CHK(ppMediaContext != NULL, STATUS_MEDIA_NULL_ARG);
+    *ppMediaContext = NULL;
     // latch the configuration of rtsp server.
-    CHK_STATUS((latchRtspConfig(&pRtspSrcContext->rtspServerConf)));
+    MEMSET(&rtspServerConf, 0, SIZEOF(RtspServerConfiguration));
+    CHK_STATUS((latchRtspConfig(&rtspServerConf)));
+    CHK_STATUS((createRtspSrcContext(&rtspServerConf, &pRtspSrcContext)));
     // get the sdp information of rtsp server.
-    CHK_STATUS((discoverMediaSource(pRtspSrcContext)));
+    CHK_STATUS(((STATUS)(ULONG_PTR) discoverMediaSource(pRtspSrcContext)));
     *ppMediaContext = pRtspSrcContext;
 
 CleanUp:
 
-    if (STATUS_FAILED(retStatus)) {
-        if (pRtspSrcContext != NULL) {
-            detroyMediaSource(pRtspSrcContext);
-        }
+    if (STATUS_FAILED(retStatus) && pRtspSrcContext != NULL) {
+        freeRtspSrcContext(pRtspSrcContext);
     }
 
     return retStatus;
@@ -969,18 +1335,22 @@ STATUS linkMeidaEosHook(PMediaContext pMediaContext, MediaEosHook mediaEosHook,
 CleanUp:
     return retStatus;
 }
-
-PVOID runMediaSource(PVOID args)
+/**
+ * @brief run the pipeline of the ingest until it is shut down or it fails.
+ *
+ * @param[in] pRtspSrcContext the context of the ingest.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+static STATUS playMediaSource(PRtspSrcContext pRtspSrcContext)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    PRtspSrcContext pRtspSrcContext = (PRtspSrcContext) args;
     PCodecConfiguration pGstConfiguration = NULL;
     /* init GStreamer */
     GstElement* pipeline = NULL;
     GstBus* bus = NULL;
     PVOID mainLoop = NULL;
 
-    CHK(pRtspSrcContext != NULL, STATUS_MEDIA_NULL_ARG);
     pGstConfiguration = &pRtspSrcContext->codecConfiguration;
     pGstConfiguration->codecStatus = STATUS_SUCCESS;
     DLOGI("media source is starting");
@@ -1021,6 +1391,240 @@ CleanUp:
         app_g_main_loop_unref(pGstConfiguration->mainLoop);
         pGstConfiguration->mainLoop = NULL;
     }
+    return retStatus;
+}
+
+/**
+ * @brief the backoff delay of the next rebuild, it doubles with the failed attempts and it is jittered.
+ *
+ * @param[in] attempt the consecutive failed attempts.
+ *
+ * @return the delay in 100ns.
+ */
+static UINT64 getMediaReconnectDelay(UINT32 attempt)
+{
+    UINT64 delay = APP_MEDIA_RECONNECT_BASE_DELAY;
+    UINT32 i;
+
+    for (i = 0; i < attempt && delay < APP_MEDIA_RECONNECT_MAX_DELAY; i++) {
+        delay *= 2;
+    }
+    delay = MIN(delay, APP_MEDIA_RECONNECT_MAX_DELAY);
+
+    return delay / 2 + (UINT64) RAND() % (delay / 2 + 1);
+}
+/**
+ * @brief check the tracks of the playing pipeline. A track stalls when its frames stop for the stall timeout and for
+ *        APP_MEDIA_STALL_FRAMES of its frame interval, and a pipeline without any frame stalls after the start timeout.
+ *
+ * @param[in] pRtspSrcContext the context of the ingest.
+ * @param[in] curTime the current time.
+ *
+ * @return TRUE if the pipeline is stalled.
+ */
+static BOOL isMediaSourceStalled(PRtspSrcContext pRtspSrcContext, UINT64 curTime)
+{
+    PMediaTrackWatch pTrackWatch;
+    BOOL seen = FALSE;
+    UINT64 timeout;
+    UINT32 i;
+
+    for (i = 0; i < MEDIA_WATCH_TRACKS; i++) {
+        pTrackWatch = &pRtspSrcContext->trackWatch[i];
+        if (!pTrackWatch->seen) {
+            continue;
+        }
+        seen = TRUE;
+        timeout = MAX(pRtspSrcContext->stallTimeout, APP_MEDIA_STALL_FRAMES * getMediaFrameInterval(pRtspSrcContext, i));
+        if (curTime - pTrackWatch->lastArrival > timeout) {
+            DLOGW("the %s track is stalled for %" PRIu64 " ms", i == MEDIA_WATCH_VIDEO ? "video" : "audio",
+                  (curTime - pTrackWatch->lastArrival) / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+            return TRUE;
+        }
+    }
+    if (!seen && curTime - pRtspSrcContext->pipelineStartTime > MAX(pRtspSrcContext->stallTimeout, APP_MEDIA_STALL_START_TIMEOUT)) {
+        DLOGW("no frame since the pipeline started %" PRIu64 " ms ago",
+              (curTime - pRtspSrcContext->pipelineStartTime) / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+        return TRUE;
+    }
+    return FALSE;
+}
+/**
+ * @brief the thread of the watchdog. A camera may stop sending without an error or an eos, the watchdog closes the stalled
+ *        pipeline so the supervisor restarts it.
+ *
+ * @param[in] args the context of the ingest.
+ */
+static PVOID watchMediaSourceRoutine(PVOID args)
+{
+    PRtspSrcContext pRtspSrcContext = (PRtspSrcContext) args;
+    BOOL stalled, newStall;
+
+    APP_MUTEX_LOCK(pRtspSrcContext->watchLock);
+    while (!ATOMIC_LOAD_BOOL(&pRtspSrcContext->terminateWatchdog)) {
+        APP_CVAR_WAIT(pRtspSrcContext->watchCvar, pRtspSrcContext->watchLock, APP_MEDIA_WATCHDOG_PERIOD);
+        if (ATOMIC_LOAD_BOOL(&pRtspSrcContext->terminateWatchdog) || !pRtspSrcContext->pipelinePlaying) {
+            continue;
+        }
+        newStall = !pRtspSrcContext->pipelineStalled && isMediaSourceStalled(pRtspSrcContext, GETTIME());
+        if (newStall) {
+            pRtspSrcContext->pipelineStalled = TRUE;
+            pRtspSrcContext->stallCount++;
+        }
+        stalled = pRtspSrcContext->pipelineStalled;
+        APP_MUTEX_UNLOCK(pRtspSrcContext->watchLock);
+
+        if (newStall) {
+            updateCodecStatus(pRtspSrcContext, STATUS_MEDIA_STALLED);
+        }
+        // the main loop may not run yet when the pipeline stalls, it is closed until the supervisor takes it back.
+        if (stalled) {
+            closeGstRtspSrc(pRtspSrcContext);
+        }
+        APP_MUTEX_LOCK(pRtspSrcContext->watchLock);
+    }
+    APP_MUTEX_UNLOCK(pRtspSrcContext->watchLock);
+
+    return NULL;
+}
+/**
+ * @brief start or stop watching the pipeline, the tracks start over with each pipeline.
+ *
+ * @param[in] pRtspSrcContext the context of the ingest.
+ * @param[in] playing the pipeline is playing.
+ */
+static VOID watchMediaSource(PRtspSrcContext pRtspSrcContext, BOOL playing)
+{
+    UINT32 i;
+
+    APP_MUTEX_LOCK(pRtspSrcContext->watchLock);
+    pRtspSrcContext->pipelinePlaying = playing;
+    pRtspSrcContext->pipelineStalled = FALSE;
+    pRtspSrcContext->pipelineStartTime = GETTIME();
+    for (i = 0; playing && i < MEDIA_WATCH_TRACKS; i++) {
+        pRtspSrcContext->trackWatch[i].seen = FALSE;
+        pRtspSrcContext->trackWatch[i].maxFrameGap = 0;
+    }
+    APP_MUTEX_UNLOCK(pRtspSrcContext->watchLock);
+}
+/**
+ * @brief run the pipeline and rebuild it with backoff when the camera is lost, so the sessions of the channel survive a
+ *        hiccup of the camera. The first pipeline is not rebuilt if it fails to start, it is a problem of the configuration.
+ *
+ * @param[in] pRtspSrcContext the context of the ingest.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+static STATUS superviseMediaSource(PRtspSrcContext pRtspSrcContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    STATUS codecStatus;
+    PMediaReconnectStats pReconnectStats = &pRtspSrcContext->reconnectStats;
+    BOOL rebuilt = FALSE, lost, giveUp = FALSE, fastRestart;
+    UINT64 curTime, deadline;
+
+    ATOMIC_STORE_BOOL(&pRtspSrcContext->stopRtspSrc, FALSE);
+    if (pRtspSrcContext->stallTimeout != 0) {
+        ATOMIC_STORE_BOOL(&pRtspSrcContext->terminateWatchdog, FALSE);
+        if (THREAD_CREATE(&pRtspSrcContext->watchdogTid, watchMediaSourceRoutine, (PVOID) pRtspSrcContext) != STATUS_SUCCESS) {
+            DLOGW("failed to start the watchdog: 0x%08x", STATUS_MEDIA_WATCHDOG_THREAD);
+            pRtspSrcContext->watchdogTid = INVALID_TID_VALUE;
+        }
+    }
+    while (TRUE) {
+        APP_MUTEX_LOCK(pRtspSrcContext->timingLock);
+        pRtspSrcContext->rebaseTimestamps = TRUE;
+        APP_MUTEX_UNLOCK(pRtspSrcContext->timingLock);
+        watchMediaSource(pRtspSrcContext, TRUE);
+        retStatus = playMediaSource(pRtspSrcContext);
+        watchMediaSource(pRtspSrcContext, FALSE);
+        APP_MUTEX_LOCK(pRtspSrcContext->codecConfLock);
+        codecStatus = pRtspSrcContext->codecConfiguration.codecStatus;
+        APP_MUTEX_UNLOCK(pRtspSrcContext->codecConfLock);
+        lost = !ATOMIC_LOAD_BOOL(&pRtspSrcContext->stopRtspSrc) &&
+            (codecStatus == STATUS_MEDIA_BUS_ERROR || codecStatus == STATUS_MEDIA_BUS_EOS || codecStatus == STATUS_MEDIA_STALLED ||
+             (rebuilt && STATUS_FAILED(retStatus)));
+        if (!lost || pRtspSrcContext->reconnectRetries == 0) {
+            // the bus tells the users of an eos, nothing tells them of a stall.
+            if (lost && codecStatus == STATUS_MEDIA_STALLED) {
+                notifyMediaEos(pRtspSrcContext);
+            }
+            break;
+        }
+
+        APP_MUTEX_LOCK(pRtspSrcContext->runLock);
+        curTime = GETTIME();
+        fastRestart = FALSE;
+        if (!ATOMIC_EXCHANGE_BOOL(&pRtspSrcContext->mediaLost, TRUE)) {
+            pRtspSrcContext->mediaLostTime = curTime;
+            pReconnectStats->attempt = 0;
+            // the camera was streaming until it stalled, it is usually back at once.
+            fastRestart = codecStatus == STATUS_MEDIA_STALLED;
+        } else {
+            // the rebuilt pipeline failed before it delivered any frame.
+            pReconnectStats->failedCount++;
+            pReconnectStats->attempt++;
+        }
+        giveUp = pRtspSrcContext->reconnectRetries != APP_MEDIA_RECONNECT_FOREVER && pReconnectStats->attempt >= pRtspSrcContext->reconnectRetries;
+        if (!giveUp) {
+            pReconnectStats->lastDelay = fastRestart ? 0 : getMediaReconnectDelay(pReconnectStats->attempt);
+            deadline = curTime + pReconnectStats->lastDelay;
+            DLOGW("media source lost: 0x%08x, attempt %u, rebuilding in %" PRIu64 " ms", STATUS_FAILED(retStatus) ? retStatus : codecStatus,
+                  pReconnectStats->attempt, pReconnectStats->lastDelay / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+            // shutdownMediaSource() cuts the backoff short.
+            while (!ATOMIC_LOAD_BOOL(&pRtspSrcContext->stopRtspSrc) && (curTime = GETTIME()) < deadline) {
+                APP_CVAR_WAIT(pRtspSrcContext->runCvar, pRtspSrcContext->runLock, deadline - curTime);
+            }
+        }
+        APP_MUTEX_UNLOCK(pRtspSrcContext->runLock);
+        if (giveUp || ATOMIC_LOAD_BOOL(&pRtspSrcContext->stopRtspSrc)) {
+            break;
+        }
+        rebuilt = TRUE;
+        ATOMIC_STORE_BOOL(&pRtspSrcContext->awaitKeyFrame, pRtspSrcContext->codecConfiguration.videoStream.codec != GST_CODEC_INVALID_VALUE);
+    }
+
+    // the downtime ends with the supervisor as well.
+    APP_MUTEX_LOCK(pRtspSrcContext->runLock);
+    if (ATOMIC_EXCHANGE_BOOL(&pRtspSrcContext->mediaLost, FALSE)) {
+        pReconnectStats->downtime += GETTIME() - pRtspSrcContext->mediaLostTime;
+    }
+    APP_MUTEX_UNLOCK(pRtspSrcContext->runLock);
+    ATOMIC_STORE_BOOL(&pRtspSrcContext->awaitKeyFrame, FALSE);
+    if (pRtspSrcContext->watchdogTid != INVALID_TID_VALUE) {
+        APP_MUTEX_LOCK(pRtspSrcContext->watchLock);
+        ATOMIC_STORE_BOOL(&pRtspSrcContext->terminateWatchdog, TRUE);
+        CVAR_BROADCAST(pRtspSrcContext->watchCvar);
+        APP_MUTEX_UNLOCK(pRtspSrcContext->watchLock);
+        THREAD_JOIN(pRtspSrcContext->watchdogTid, NULL);
+        pRtspSrcContext->watchdogTid = INVALID_TID_VALUE;
+    }
+    if (giveUp) {
+        DLOGE("media source is not back after %u attempts, giving up", pReconnectStats->attempt);
+        notifyMediaEos(pRtspSrcContext);
+    }
+
+    return retStatus;
+}
+
+PVOID runMediaSource(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PRtspSrcContext pRtspSrcContext = (PRtspSrcContext) args;
+
+    CHK(pRtspSrcContext != NULL, STATUS_MEDIA_NULL_ARG);
+    APP_MUTEX_LOCK(pRtspSrcContext->runLock);
+    pRtspSrcContext->running = TRUE;
+    APP_MUTEX_UNLOCK(pRtspSrcContext->runLock);
+
+    retStatus = superviseMediaSource(pRtspSrcContext);
+
+    APP_MUTEX_LOCK(pRtspSrcContext->runLock);
+    pRtspSrcContext->running = FALSE;
+    APP_MUTEX_UNLOCK(pRtspSrcContext->runLock);
+
+CleanUp:
+
     return (PVOID)(ULONG_PTR) retStatus;
 }
 
@@ -1029,7 +1633,62 @@ STATUS shutdownMediaSource(PMediaContext pMediaContext)
     STATUS retStatus = STATUS_SUCCESS;
     PRtspSrcContext pRtspSrcContext = (PRtspSrcContext) pMediaContext;
     CHK(pRtspSrcContext != NULL, STATUS_MEDIA_NULL_ARG);
+    APP_MUTEX_LOCK(pRtspSrcContext->runLock);
     ATOMIC_STORE_BOOL(&pRtspSrcContext->shutdownRtspSrc, TRUE);
+    // stop the supervisor in its backoff, there is no frame to close the pipeline then.
+    if (pRtspSrcContext->running) {
+        ATOMIC_STORE_BOOL(&pRtspSrcContext->stopRtspSrc, TRUE);
+        CVAR_BROADCAST(pRtspSrcContext->runCvar);
+    }
+    APP_MUTEX_UNLOCK(pRtspSrcContext->runLock);
+
+CleanUp:
+    return retStatus;
+}
+
+STATUS getMediaSourceReconnectStats(PMediaContext pMediaContext, PMediaReconnectStats pReconnectStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PRtspSrcContext pRtspSrcContext = (PRtspSrcContext) pMediaContext;
+
+    CHK(pRtspSrcContext != NULL && pReconnectStats != NULL, STATUS_MEDIA_NULL_ARG);
+    APP_MUTEX_LOCK(pRtspSrcContext->runLock);
+    *pReconnectStats = pRtspSrcContext->reconnectStats;
+    pReconnectStats->lost = ATOMIC_LOAD_BOOL(&pRtspSrcContext->mediaLost);
+    if (pReconnectStats->lost) {
+        pReconnectStats->downtime += GETTIME() - pRtspSrcContext->mediaLostTime;
+    }
+    APP_MUTEX_UNLOCK(pRtspSrcContext->runLock);
+
+CleanUp:
+    return retStatus;
+}
+
+STATUS getMediaSourceWatchdogStats(PMediaContext pMediaContext, PMediaWatchdogStats pWatchdogStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PRtspSrcContext pRtspSrcContext = (PRtspSrcContext) pMediaContext;
+    PMediaTrackWatch pTrackWatch;
+    PMediaTrackStats pTrackStats;
+    UINT64 curTime, frameInterval;
+    UINT32 i;
+
+    CHK(pRtspSrcContext != NULL && pWatchdogStats != NULL, STATUS_MEDIA_NULL_ARG);
+    MEMSET(pWatchdogStats, 0x00, SIZEOF(MediaWatchdogStats));
+    APP_MUTEX_LOCK(pRtspSrcContext->watchLock);
+    curTime = GETTIME();
+    for (i = 0; i < MEDIA_WATCH_TRACKS; i++) {
+        pTrackWatch = &pRtspSrcContext->trackWatch[i];
+        pTrackStats = i == MEDIA_WATCH_VIDEO ? &pWatchdogStats->video : &pWatchdogStats->audio;
+        pTrackStats->frameCount = pTrackWatch->frameCount;
+        frameInterval = getMediaFrameInterval(pRtspSrcContext, i);
+        pTrackStats->fps = frameInterval == 0 ? 0 : (DOUBLE) HUNDREDS_OF_NANOS_IN_A_SECOND / frameInterval;
+        pTrackStats->frameGap = pTrackWatch->seen ? curTime - pTrackWatch->lastArrival : 0;
+        pTrackStats->maxFrameGap = pTrackWatch->maxFrameGap;
+    }
+    pWatchdogStats->stallCount = pRtspSrcContext->stallCount;
+    pWatchdogStats->stallTimeout = pRtspSrcContext->stallTimeout;
+    APP_MUTEX_UNLOCK(pRtspSrcContext->watchLock);
 
 CleanUp:
     return retStatus;
@@ -1043,11 +1702,7 @@ STATUS detroyMediaSource(PMediaContext* ppMediaContext)
     CHK(ppMediaContext != NULL, STATUS_MEDIA_NULL_ARG);
     pRtspSrcContext = (PRtspSrcContext) *ppMediaContext;
     CHK(pRtspSrcContext != NULL, STATUS_MEDIA_NULL_ARG);
-    if (IS_VALID_MUTEX_VALUE(pRtspSrcContext->codecConfLock)) {
-        MUTEX_FREE(pRtspSrcContext->codecConfLock);
-    }
-
-    MEMFREE(pRtspSrcContext);
+    freeRtspSrcContext(pRtspSrcContext);
     *ppMediaContext = pRtspSrcContext = NULL;
 CleanUp:
     return retStatus;
@@ -14,6 +14,266 @@
  */
 #define LOG_CLASS "AppSignaling"
 #include "AppSignaling.h"
+#include "AppMemory.h"
+
+/**
+ * @brief   pop the oldest message of the send queue. The caller needs to hold the sendQueueLock.
+ *
+ * @param[in] pAppSignaling the context of appSignaling
+ *
+ * @return the node of the message or NULL if the queue is empty.
+ */
+static PAppSignalingSendNode popAppSignalingSendNode(PAppSignaling pAppSignaling)
+{
+    PAppSignalingSendNode pSendNode = pAppSignaling->pSendQueueHead;
+
+    if (pSendNode != NULL) {
+        pAppSignaling->pSendQueueHead = pSendNode->pNext;
+        if (pAppSignaling->pSendQueueHead == NULL) {
+            pAppSignaling->pSendQueueTail = NULL;
+        }
+        pSendNode->pNext = NULL;
+        pAppSignaling->sendStats.queueDepth--;
+    }
+    return pSendNode;
+}
+
+/**
+ * @brief   the sender thread. It drains the send queue so the callers, e.g. the ice agent, never wait for the websocket.
+ */
+static PVOID appSignalingSenderRoutine(PVOID args)
+{
+    PAppSignaling pAppSignaling = (PAppSignaling) args;
+    PAppSignalingSendNode pSendNode;
+    PAppSignalingSendStats pSendStats = &pAppSignaling->sendStats;
+    STATUS sendStatus;
+    UINT64 sentTime, latency;
+
+    setAppMemoryTag(APP_MEMORY_TAG_SIGNALING);
+    MUTEX_LOCK(pAppSignaling->sendQueueLock);
+    while (!ATOMIC_LOAD_BOOL(&pAppSignaling->terminateSender)) {
+        if (pAppSignaling->pSendQueueHead == NULL) {
+            CVAR_WAIT(pAppSignaling->sendQueueCvar, pAppSignaling->sendQueueLock, INFINITE_TIME_VALUE);
+            continue;
+        }
+
+        pSendNode = popAppSignalingSendNode(pAppSignaling);
+        MUTEX_UNLOCK(pAppSignaling->sendQueueLock);
+
+        MUTEX_LOCK(pAppSignaling->signalingSendMessageLock);
+        if (IS_VALID_SIGNALING_CLIENT_HANDLE(pAppSignaling->signalingClientHandle)) {
+            sendStatus = signalingClientSendMessageSync(pAppSignaling->signalingClientHandle, &pSendNode->message);
+        } else {
+            sendStatus = STATUS_APP_SIGNALING_INVALID_HANDLE;
+        }
+        sentTime = GETTIME();
+        MUTEX_UNLOCK(pAppSignaling->signalingSendMessageLock);
+
+        MUTEX_LOCK(pAppSignaling->sendQueueLock);
+        if (STATUS_FAILED(sendStatus)) {
+            DLOGW("Failed to send the signaling message to %s: 0x%08x", pSendNode->message.peerClientId, sendStatus);
+            pSendStats->failedCount++;
+        } else {
+            latency = sentTime - pSendNode->enqueueTime;
+            pSendStats->sentCount++;
+            // moving average with a weight of 1/8 for the newest sample.
+            pSendStats->avgSendLatency = (pSendStats->sentCount == 1) ? latency : (pSendStats->avgSendLatency * 7 + latency) / 8;
+            pSendStats->maxSendLatency = MAX(pSendStats->maxSendLatency, latency);
+        }
+        SAFE_MEMFREE(pSendNode);
+    }
+    MUTEX_UNLOCK(pAppSignaling->sendQueueLock);
+
+    return NULL;
+}
+
+/**
+ * @brief   the backoff delay of the next attempt. It doubles on each consecutive failure up to the reconnectMaxDelay,
+ *          and a random half of it is dropped, so the devices which lost the connection together do not come back
+ *          together. The caller needs to hold the reconnectLock.
+ */
+static UINT64 getAppSignalingReconnectDelay(PAppSignaling pAppSignaling)
+{
+    UINT64 delay = pAppSignaling->reconnectBaseDelay;
+    UINT32 i;
+
+    for (i = 1; i < pAppSignaling->reconnectStats.attempt && delay < pAppSignaling->reconnectMaxDelay; i++) {
+        delay *= 2;
+    }
+    delay = MIN(delay, pAppSignaling->reconnectMaxDelay);
+
+    return delay / 2 + (UINT64) RAND() % (delay / 2 + 1);
+}
+
+/**
+ * @brief   the reconnect thread. It re-creates the signaling client on request and connects it when it falls back to the
+ *          ready state, so neither the main loop nor the media sessions wait for the network.
+ */
+static PVOID appSignalingReconnectRoutine(PVOID args)
+{
+    PAppSignaling pAppSignaling = (PAppSignaling) args;
+    PAppSignalingReconnectStats pReconnectStats = &pAppSignaling->reconnectStats;
+    STATUS retStatus;
+    BOOL restart;
+    UINT64 curTime;
+
+    // the re-created signaling clients are charged to the signaling.
+    setAppMemoryTag(APP_MEMORY_TAG_SIGNALING);
+    MUTEX_LOCK(pAppSignaling->reconnectLock);
+    pAppSignaling->nextReconnectTime = GETTIME() + APP_SIGNALING_RECONNECT_CHECK_PERIOD;
+    while (!ATOMIC_LOAD_BOOL(&pAppSignaling->terminateReconnect)) {
+        // The handle is valid as soon as the client is created, but connectAppSignaling is still fetching and connecting it.
+        if (!pAppSignaling->connectReturned) {
+            CVAR_WAIT(pAppSignaling->reconnectCvar, pAppSignaling->reconnectLock, INFINITE_TIME_VALUE);
+            continue;
+        }
+        curTime = GETTIME();
+        // A request wakes up the idle thread at once, but it never cuts the backoff short.
+        if (curTime < pAppSignaling->nextReconnectTime &&
+            (pReconnectStats->state == APP_SIGNALING_RECONNECT_STATE_BACKOFF || !pAppSignaling->restartRequested)) {
+            CVAR_WAIT(pAppSignaling->reconnectCvar, pAppSignaling->reconnectLock, pAppSignaling->nextReconnectTime - curTime);
+            continue;
+        }
+
+        restart = pAppSignaling->restartRequested;
+        pReconnectStats->state = APP_SIGNALING_RECONNECT_STATE_RUNNING;
+        MUTEX_UNLOCK(pAppSignaling->reconnectLock);
+
+        if (restart) {
+            retStatus = restartAppSignaling(pAppSignaling);
+        } else if (IS_VALID_SIGNALING_CLIENT_HANDLE(pAppSignaling->signalingClientHandle)) {
+            retStatus = checkAppSignaling(pAppSignaling);
+        } else {
+            // connectAppSignaling failed to create the client, only a restart creates it.
+            retStatus = STATUS_SUCCESS;
+        }
+
+        MUTEX_LOCK(pAppSignaling->reconnectLock);
+        curTime = GETTIME();
+        if (STATUS_SUCCEEDED(retStatus)) {
+            if (restart) {
+                // The requests made during the restart are served by this one. Connect the new client right away.
+                pAppSignaling->restartRequested = FALSE;
+                pReconnectStats->restartCount++;
+                pAppSignaling->nextReconnectTime = curTime;
+                DLOGI("Signaling client re-created after %u failed attempts", pReconnectStats->attempt);
+            } else {
+                pAppSignaling->nextReconnectTime = curTime + APP_SIGNALING_RECONNECT_CHECK_PERIOD;
+            }
+            pReconnectStats->attempt = 0;
+            pReconnectStats->state = APP_SIGNALING_RECONNECT_STATE_IDLE;
+        } else {
+            pReconnectStats->failedCount++;
+            pReconnectStats->attempt++;
+            pReconnectStats->lastDelay = getAppSignalingReconnectDelay(pAppSignaling);
+            pAppSignaling->nextReconnectTime = curTime + pReconnectStats->lastDelay;
+            pReconnectStats->state = APP_SIGNALING_RECONNECT_STATE_BACKOFF;
+            DLOGW("Failed to %s the signaling client: 0x%08x, attempt %u, retry in %" PRIu64 " ms", restart ? "re-create" : "connect",
+                  retStatus, pReconnectStats->attempt, pReconnectStats->lastDelay / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+        }
+    }
+    MUTEX_UNLOCK(pAppSignaling->reconnectLock);
+
+    return NULL;
+}
+
+/**
+ * @brief   load the configuration of the turn servers from the environment variables.
+ */
+static VOID loadAppTurnServerConfig(PAppSignaling pAppSignaling)
+{
+    PCHAR pValue;
+    UINT32 value;
+
+    pAppSignaling->maxTurnServer = APP_TURN_SERVER_DEFAULT_COUNT;
+    pAppSignaling->turnProbeInterval = APP_TURN_PROBE_DEFAULT_INTERVAL;
+
+    if ((pValue = GETENV(APP_TURN_SERVER_COUNT)) != NULL) {
+        if (STRTOUI32(pValue, NULL, 10, &value) == STATUS_SUCCESS && value != 0 && value <= MAX_ICE_CONFIG_COUNT) {
+            pAppSignaling->maxTurnServer = value;
+        } else {
+            DLOGW("Invalid number of turn servers(%s), use the default number %u", pValue, APP_TURN_SERVER_DEFAULT_COUNT);
+        }
+    }
+
+    if ((pValue = GETENV(APP_TURN_PROBE_INTERVAL)) != NULL) {
+        // 0 disables the probe.
+        if (STRTOUI32(pValue, NULL, 10, &value) == STATUS_SUCCESS) {
+            pAppSignaling->turnProbeInterval = (UINT64) value * HUNDREDS_OF_NANOS_IN_A_SECOND;
+        } else {
+            DLOGW("Invalid interval of the turn probe(%s), use the default interval", pValue);
+        }
+    }
+}
+
+/**
+ * @brief   sync the list of turn servers with the latest ice configs. The measurements of the servers which are still
+ *          returned are kept. The caller needs to hold the turnServerLock.
+ */
+static VOID refreshAppTurnServers(PAppSignaling pAppSignaling, PIceConfigInfo* ppIceConfigInfos, UINT32 iceConfigCount)
+{
+    AppTurnServer turnServers[MAX_ICE_CONFIG_COUNT];
+    PAppTurnServer pTurnServer;
+    UINT32 i, j;
+
+    MEMSET(turnServers, 0x00, SIZEOF(turnServers));
+    for (i = 0; i < iceConfigCount; i++) {
+        pTurnServer = &turnServers[i];
+        for (j = 0; j < pAppSignaling->turnServerCount; j++) {
+            if (pAppSignaling->turnServers[j].uriCount != 0 && ppIceConfigInfos[i]->uriCount != 0 &&
+                STRNCMP(pAppSignaling->turnServers[j].uris[0], ppIceConfigInfos[i]->uris[0], MAX_ICE_CONFIG_URI_LEN) == 0) {
+                MEMCPY(pTurnServer, &pAppSignaling->turnServers[j], SIZEOF(AppTurnServer));
+                break;
+            }
+        }
+
+        pTurnServer->uriCount = MIN(ppIceConfigInfos[i]->uriCount, MAX_ICE_CONFIG_URI_COUNT);
+        for (j = 0; j < pTurnServer->uriCount; j++) {
+            STRNCPY(pTurnServer->uris[j], ppIceConfigInfos[i]->uris[j], MAX_ICE_CONFIG_URI_LEN);
+        }
+    }
+
+    MEMCPY(pAppSignaling->turnServers, turnServers, SIZEOF(turnServers));
+    pAppSignaling->turnServerCount = iceConfigCount;
+}
+
+/**
+ * @brief   rank the turn servers. The probed ones are ranked by the round trip time, and the servers which are not probed
+ *          yet follow the best of them in the order of the ice configs, so a session still gets the best known server first
+ *          and the next ones get measured. An unreachable best server does not hold them back. The caller needs to hold the
+ *          turnServerLock.
+ */
+static VOID rankAppTurnServers(PAppSignaling pAppSignaling, PUINT32 pRank)
+{
+    PAppTurnServer pTurnServers = pAppSignaling->turnServers;
+    UINT32 measured[MAX_ICE_CONFIG_COUNT];
+    UINT32 unprobed[MAX_ICE_CONFIG_COUNT];
+    UINT32 measuredCount = 0, unprobedCount = 0, rankCount = 0, bestCount;
+    UINT32 i, j;
+
+    for (i = 0; i < pAppSignaling->turnServerCount; i++) {
+        if (pTurnServers[i].sampleCount == 0) {
+            unprobed[unprobedCount++] = i;
+            continue;
+        }
+        for (j = measuredCount; j > 0 && pTurnServers[measured[j - 1]].rtt > pTurnServers[i].rtt; j--) {
+            measured[j] = measured[j - 1];
+        }
+        measured[j] = i;
+        measuredCount++;
+    }
+
+    bestCount = (measuredCount > 0 && pTurnServers[measured[0]].rtt < APP_TURN_SERVER_UNREACHABLE_RTT) ? 1 : 0;
+    for (i = 0; i < bestCount; i++) {
+        pRank[rankCount++] = measured[i];
+    }
+    for (i = 0; i < unprobedCount; i++) {
+        pRank[rankCount++] = unprobed[i];
+    }
+    for (i = bestCount; i < measuredCount; i++) {
+        pRank[rankCount++] = measured[i];
+    }
+}
 
 STATUS initAppSignaling(PAppSignaling pAppSignaling, SignalingClientMessageReceivedFunc onMessageReceived,
                         SignalingClientStateChangedFunc onStateChanged, SignalingClientErrorReportFunc pOnError, UINT64 udata, BOOL useTurn)
@@ -21,6 +281,26 @@ STATUS initAppSignaling(PAppSignaling pAppSignaling, SignalingClientMessageRecei
     STATUS retStatus = STATUS_SUCCESS;
     pAppSignaling->signalingClientHandle = INVALID_SIGNALING_CLIENT_HANDLE_VALUE;
     pAppSignaling->useTurn = useTurn;
+    pAppSignaling->sendQueueLock = INVALID_MUTEX_VALUE;
+    pAppSignaling->sendQueueCvar = INVALID_CVAR_VALUE;
+    pAppSignaling->pSendQueueHead = NULL;
+    pAppSignaling->pSendQueueTail = NULL;
+    pAppSignaling->senderTid = INVALID_TID_VALUE;
+    ATOMIC_STORE_BOOL(&pAppSignaling->terminateSender, FALSE);
+    MEMSET(&pAppSignaling->sendStats, 0, SIZEOF(AppSignalingSendStats));
+    pAppSignaling->turnServerLock = INVALID_MUTEX_VALUE;
+    pAppSignaling->turnServerCount = 0;
+    loadAppTurnServerConfig(pAppSignaling);
+    pAppSignaling->reconnectLock = INVALID_MUTEX_VALUE;
+    pAppSignaling->reconnectCvar = INVALID_CVAR_VALUE;
+    pAppSignaling->reconnectTid = INVALID_TID_VALUE;
+    ATOMIC_STORE_BOOL(&pAppSignaling->terminateReconnect, FALSE);
+    pAppSignaling->restartRequested = FALSE;
+    pAppSignaling->connectReturned = FALSE;
+    pAppSignaling->reconnectBaseDelay = APP_SIGNALING_RECONNECT_BASE_DELAY;
+    pAppSignaling->reconnectMaxDelay = APP_SIGNALING_RECONNECT_MAX_DELAY;
+    MEMSET(&pAppSignaling->reconnectStats, 0, SIZEOF(AppSignalingReconnectStats));
+
     pAppSignaling->signalingSendMessageLock = MUTEX_CREATE(FALSE);
     CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->signalingSendMessageLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
     pAppSignaling->signalingClientCallbacks.version = SIGNALING_CLIENT_CALLBACKS_CURRENT_VERSION;
@@ -29,6 +309,22 @@ STATUS initAppSignaling(PAppSignaling pAppSignaling, SignalingClientMessageRecei
     pAppSignaling->signalingClientCallbacks.errorReportFn = pOnError;
     pAppSignaling->signalingClientCallbacks.customData = (UINT64) udata;
 
+    pAppSignaling->sendQueueLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->sendQueueLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+    pAppSignaling->sendQueueCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pAppSignaling->sendQueueCvar), STATUS_APP_SIGNALING_INVALID_CVAR);
+    CHK(THREAD_CREATE(&pAppSignaling->senderTid, appSignalingSenderRoutine, (PVOID) pAppSignaling) == STATUS_SUCCESS,
+        STATUS_APP_SIGNALING_SENDER_THREAD);
+    pAppSignaling->turnServerLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->turnServerLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+
+    pAppSignaling->reconnectLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->reconnectLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+    pAppSignaling->reconnectCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pAppSignaling->reconnectCvar), STATUS_APP_SIGNALING_INVALID_CVAR);
+    CHK(THREAD_CREATE(&pAppSignaling->reconnectTid, appSignalingReconnectRoutine, (PVOID) pAppSignaling) == STATUS_SUCCESS,
+        STATUS_APP_SIGNALING_RECONNECT_THREAD);
+
 CleanUp:
     return retStatus;
 }
@@ -41,8 +337,11 @@ SIGNALING_CHANNEL_ROLE_TYPE getAppSignalingRole(PAppSignaling pAppSignaling)
 STATUS queryAppSignalingServer(PAppSignaling pAppSignaling, PRtcIceServer pIceServer, PUINT32 pServerNum)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    UINT32 i, j, iceConfigCount, uriCount = 0, maxTurnServer = 1;
+    UINT32 i, j, iceConfigCount, uriCount = 0;
+    PIceConfigInfo pIceConfigInfos[MAX_ICE_CONFIG_COUNT];
     PIceConfigInfo pIceConfigInfo;
+    UINT32 rank[MAX_ICE_CONFIG_COUNT];
+    BOOL locked = FALSE, handleLocked = FALSE;
     *pServerNum = 0;
 
     // Set the  STUN server
@@ -50,17 +349,35 @@ STATUS queryAppSignalingServer(PAppSignaling pAppSignaling, PRtcIceServer pIceSe
     *pServerNum = 1;
 
     if (pAppSignaling->useTurn) {
+        // The reconnect thread can re-create the client at any time, so keep it from freeing the ice configs in use.
+        CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->signalingSendMessageLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+        MUTEX_LOCK(pAppSignaling->signalingSendMessageLock);
+        handleLocked = TRUE;
+
         // Set the URIs from the configuration
         CHK(signalingClientGetIceConfigInfoCount(pAppSignaling->signalingClientHandle, &iceConfigCount) == STATUS_SUCCESS,
             STATUS_APP_SIGNALING_INVALID_INFO_COUNT);
+        iceConfigCount = MIN(iceConfigCount, MAX_ICE_CONFIG_COUNT);
 
-        // signalingClientGetIceConfigInfoCount can return more than one turn server. Use only one to optimize
-        // candidate gathering latency. But user can also choose to use more than 1 turn server.
-        for (uriCount = 0, i = 0; i < maxTurnServer; i++) {
-            CHK(signalingClientGetIceConfigInfo(pAppSignaling->signalingClientHandle, i, &pIceConfigInfo) == STATUS_SUCCESS,
+        for (i = 0; i < iceConfigCount; i++) {
+            CHK(signalingClientGetIceConfigInfo(pAppSignaling->signalingClientHandle, i, &pIceConfigInfos[i]) == STATUS_SUCCESS,
                 STATUS_APP_SIGNALING_INVALID_INFO);
+        }
+
+        CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->turnServerLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+        MUTEX_LOCK(pAppSignaling->turnServerLock);
+        locked = TRUE;
+        refreshAppTurnServers(pAppSignaling, pIceConfigInfos, iceConfigCount);
+        rankAppTurnServers(pAppSignaling, rank);
+        MUTEX_UNLOCK(pAppSignaling->turnServerLock);
+        locked = FALSE;
 
-            for (j = 0; j < pIceConfigInfo->uriCount; j++) {
+        // signalingClientGetIceConfigInfoCount can return more than one turn server. Use only the best maxTurnServer of them
+        // to optimize candidate gathering latency.
+        for (i = 0; i < iceConfigCount && i < pAppSignaling->maxTurnServer; i++) {
+            pIceConfigInfo = pIceConfigInfos[rank[i]];
+
+            for (j = 0; j < pIceConfigInfo->uriCount && uriCount + 1 < MAX_ICE_SERVERS_COUNT; j++) {
                 /*
                  * if pIceServer[uriCount + 1].urls is "turn:ip:port?transport=udp" then ICE will try TURN over UDP
                  * if pIceServer[uriCount + 1].urls is "turn:ip:port?transport=tcp" then ICE will try TURN over TCP/TLS
@@ -82,12 +399,58 @@ STATUS queryAppSignalingServer(PAppSignaling pAppSignaling, PRtcIceServer pIceSe
     *pServerNum = uriCount + 1;
 CleanUp:
 
+    if (locked) {
+        MUTEX_UNLOCK(pAppSignaling->turnServerLock);
+    }
+    if (handleLocked) {
+        MUTEX_UNLOCK(pAppSignaling->signalingSendMessageLock);
+    }
+
+    return retStatus;
+}
+
+STATUS reportAppSignalingTurnRtt(PAppSignaling pAppSignaling, PCHAR pUrl, UINT64 rtt)
+{
+    STATUS retStatus = STATUS_NOT_FOUND;
+    PAppTurnServer pTurnServer;
+    UINT32 i, j;
+    BOOL locked = FALSE;
+
+    CHK((pAppSignaling != NULL) && (pUrl != NULL), STATUS_APP_SIGNALING_NULL_ARG);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->turnServerLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+
+    MUTEX_LOCK(pAppSignaling->turnServerLock);
+    locked = TRUE;
+    for (i = 0; i < pAppSignaling->turnServerCount && retStatus == STATUS_NOT_FOUND; i++) {
+        pTurnServer = &pAppSignaling->turnServers[i];
+        for (j = 0; j < pTurnServer->uriCount; j++) {
+            if (STRNCMP(pTurnServer->uris[j], pUrl, MAX_ICE_CONFIG_URI_LEN) == 0) {
+                // moving average with a weight of 1/4 for the newest sample.
+                pTurnServer->rtt = (pTurnServer->sampleCount == 0) ? rtt : (pTurnServer->rtt * 3 + rtt) / 4;
+                pTurnServer->sampleCount++;
+                pTurnServer->lastProbeTime = GETTIME();
+                DLOGD("TURN server %s: rtt %" PRIu64 " ms, smoothed rtt %" PRIu64 " ms", pUrl, rtt / HUNDREDS_OF_NANOS_IN_A_MILLISECOND,
+                      pTurnServer->rtt / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+                retStatus = STATUS_SUCCESS;
+                break;
+            }
+        }
+    }
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pAppSignaling->turnServerLock);
+    }
+
     return retStatus;
 }
 
 STATUS connectAppSignaling(PAppSignaling pAppSignaling)
 {
     STATUS retStatus = STATUS_SUCCESS;
+    APP_MEMORY_TAG prevTag = setAppMemoryTag(APP_MEMORY_TAG_SIGNALING);
+
     CHK(createSignalingClientSync(&pAppSignaling->clientInfo, &pAppSignaling->channelInfo, &pAppSignaling->signalingClientCallbacks,
                                   pAppSignaling->pAppCredential->pCredentialProvider, &pAppSignaling->signalingClientHandle) == STATUS_SUCCESS,
         STATUS_APP_SIGNALING_CREATE);
@@ -97,6 +460,15 @@ STATUS connectAppSignaling(PAppSignaling pAppSignaling)
     CHK(signalingClientConnectSync(pAppSignaling->signalingClientHandle) == STATUS_SUCCESS, STATUS_APP_SIGNALING_CONNECT);
 
 CleanUp:
+    // Hand the client over to the reconnect thread, it retries a failed connect.
+    if (IS_VALID_MUTEX_VALUE(pAppSignaling->reconnectLock)) {
+        MUTEX_LOCK(pAppSignaling->reconnectLock);
+        pAppSignaling->connectReturned = TRUE;
+        pAppSignaling->nextReconnectTime = GETTIME() + APP_SIGNALING_RECONNECT_CHECK_PERIOD;
+        CVAR_SIGNAL(pAppSignaling->reconnectCvar);
+        MUTEX_UNLOCK(pAppSignaling->reconnectLock);
+    }
+    setAppMemoryTag(prevTag);
     return retStatus;
 }
 
@@ -120,19 +492,153 @@ CleanUp:
     return retStatus;
 }
 
+/**
+ * @brief   send the message on the caller thread. The queued candidates wait behind it, since the sender thread needs the
+ *          signalingSendMessageLock too.
+ */
+static STATUS sendAppSignalingMessageSync(PAppSignaling pAppSignaling, PSignalingMessage pMessage)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    STATUS sendStatus;
+
+    MUTEX_LOCK(pAppSignaling->signalingSendMessageLock);
+    sendStatus = signalingClientSendMessageSync(pAppSignaling->signalingClientHandle, pMessage);
+    MUTEX_UNLOCK(pAppSignaling->signalingSendMessageLock);
+
+    MUTEX_LOCK(pAppSignaling->sendQueueLock);
+    if (STATUS_FAILED(sendStatus)) {
+        pAppSignaling->sendStats.failedCount++;
+    } else {
+        pAppSignaling->sendStats.sentCount++;
+    }
+    MUTEX_UNLOCK(pAppSignaling->sendQueueLock);
+
+    CHK(sendStatus == STATUS_SUCCESS, STATUS_APP_SIGNALING_SEND);
+
+CleanUp:
+
+    return retStatus;
+}
+
 STATUS sendAppSignalingMessage(PAppSignaling pAppSignaling, PSignalingMessage pMessage)
 {
     STATUS retStatus = STATUS_SUCCESS;
     BOOL locked = FALSE;
+    PAppSignalingSendNode pSendNode = NULL;
+    PAppSignalingSendStats pSendStats;
 
     // Validate the input params
     CHK((pAppSignaling != NULL) && (pMessage != NULL), STATUS_APP_SIGNALING_NULL_ARG);
     CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->signalingSendMessageLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->sendQueueLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
     CHK(IS_VALID_SIGNALING_CLIENT_HANDLE(pAppSignaling->signalingClientHandle), STATUS_APP_SIGNALING_INVALID_HANDLE);
 
+    // The session is torn down on a failed offer or answer, so the caller needs the result of the send.
+    if (pMessage->messageType != SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE) {
+        CHK_STATUS((sendAppSignalingMessageSync(pAppSignaling, pMessage)));
+        CHK(FALSE, STATUS_SUCCESS);
+    }
+
+    CHK(NULL != (pSendNode = (PAppSignalingSendNode) callocAppMemory(APP_MEMORY_TAG_SIGNALING, 1, SIZEOF(AppSignalingSendNode))),
+        STATUS_APP_SIGNALING_NOT_ENOUGH_MEMORY);
+    MEMCPY(&pSendNode->message, pMessage, SIZEOF(SignalingMessage));
+    pSendNode->enqueueTime = GETTIME();
+
+    MUTEX_LOCK(pAppSignaling->sendQueueLock);
+    locked = TRUE;
+    pSendStats = &pAppSignaling->sendStats;
+    if (pSendStats->queueDepth >= APP_SIGNALING_SEND_QUEUE_MAX_DEPTH || ATOMIC_LOAD_BOOL(&pAppSignaling->terminateSender)) {
+        pSendStats->droppedCount++;
+        CHK(FALSE, STATUS_APP_SIGNALING_SEND_QUEUE_FULL);
+    }
+
+    if (pAppSignaling->pSendQueueTail == NULL) {
+        pAppSignaling->pSendQueueHead = pSendNode;
+    } else {
+        pAppSignaling->pSendQueueTail->pNext = pSendNode;
+    }
+    pAppSignaling->pSendQueueTail = pSendNode;
+    pSendNode = NULL;
+
+    pSendStats->enqueuedCount++;
+    pSendStats->queueDepth++;
+    pSendStats->maxQueueDepth = MAX(pSendStats->maxQueueDepth, pSendStats->queueDepth);
+    CVAR_SIGNAL(pAppSignaling->sendQueueCvar);
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pAppSignaling->sendQueueLock);
+    }
+    SAFE_MEMFREE(pSendNode);
+
+    CHK_LOG_ERR((retStatus));
+    return retStatus;
+}
+
+STATUS getAppSignalingSendStats(PAppSignaling pAppSignaling, PAppSignalingSendStats pSendStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK((pAppSignaling != NULL) && (pSendStats != NULL), STATUS_APP_SIGNALING_NULL_ARG);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->sendQueueLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+
+    MUTEX_LOCK(pAppSignaling->sendQueueLock);
+    MEMCPY(pSendStats, &pAppSignaling->sendStats, SIZEOF(AppSignalingSendStats));
+    MUTEX_UNLOCK(pAppSignaling->sendQueueLock);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS requestAppSignalingRestart(PAppSignaling pAppSignaling)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pAppSignaling != NULL, STATUS_APP_SIGNALING_NULL_ARG);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->reconnectLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+
+    MUTEX_LOCK(pAppSignaling->reconnectLock);
+    pAppSignaling->restartRequested = TRUE;
+    CVAR_SIGNAL(pAppSignaling->reconnectCvar);
+    MUTEX_UNLOCK(pAppSignaling->reconnectLock);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS getAppSignalingReconnectStats(PAppSignaling pAppSignaling, PAppSignalingReconnectStats pReconnectStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK((pAppSignaling != NULL) && (pReconnectStats != NULL), STATUS_APP_SIGNALING_NULL_ARG);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->reconnectLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+
+    MUTEX_LOCK(pAppSignaling->reconnectLock);
+    MEMCPY(pReconnectStats, &pAppSignaling->reconnectStats, SIZEOF(AppSignalingReconnectStats));
+    MUTEX_UNLOCK(pAppSignaling->reconnectLock);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS getAppSignalingMetrics(PAppSignaling pAppSignaling, PSignalingClientMetrics pSignalingClientMetrics)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    BOOL locked = FALSE;
+
+    CHK((pAppSignaling != NULL) && (pSignalingClientMetrics != NULL), STATUS_APP_SIGNALING_NULL_ARG);
+    CHK(IS_VALID_MUTEX_VALUE(pAppSignaling->signalingSendMessageLock), STATUS_APP_SIGNALING_INVALID_MUTEX);
+
+    // The handle is only swapped under this lock by restartAppSignaling.
     MUTEX_LOCK(pAppSignaling->signalingSendMessageLock);
     locked = TRUE;
-    CHK(signalingClientSendMessageSync(pAppSignaling->signalingClientHandle, pMessage) == STATUS_SUCCESS, STATUS_APP_SIGNALING_SEND);
+    CHK(IS_VALID_SIGNALING_CLIENT_HANDLE(pAppSignaling->signalingClientHandle), STATUS_APP_SIGNALING_INVALID_HANDLE);
+    pSignalingClientMetrics->version = SIGNALING_CLIENT_METRICS_CURRENT_VERSION;
+    CHK_STATUS((signalingClientGetMetrics(pAppSignaling->signalingClientHandle, pSignalingClientMetrics)));
 
 CleanUp:
 
@@ -140,28 +646,112 @@ CleanUp:
         MUTEX_UNLOCK(pAppSignaling->signalingSendMessageLock);
     }
 
-    CHK_LOG_ERR((retStatus));
     return retStatus;
 }
 
 STATUS restartAppSignaling(PAppSignaling pAppSignaling)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    // Check if we need to re-create the signaling client on-the-fly
-    CHK(freeSignalingClient(&pAppSignaling->signalingClientHandle) == STATUS_SUCCESS, STATUS_APP_SIGNALING_RESTART);
+    SIGNALING_CLIENT_HANDLE signalingClientHandle;
+    BOOL locked = FALSE;
+
+    // Detach the handle, so the sender thread and queryAppSignalingServer never use the client being freed. The client is
+    // freed and created without the lock, because freeing it waits for its callbacks, which may wait for these threads.
+    if (IS_VALID_MUTEX_VALUE(pAppSignaling->signalingSendMessageLock)) {
+        MUTEX_LOCK(pAppSignaling->signalingSendMessageLock);
+        locked = TRUE;
+    }
+    signalingClientHandle = pAppSignaling->signalingClientHandle;
+    pAppSignaling->signalingClientHandle = INVALID_SIGNALING_CLIENT_HANDLE_VALUE;
+    if (locked) {
+        MUTEX_UNLOCK(pAppSignaling->signalingSendMessageLock);
+        locked = FALSE;
+    }
+
+    CHK(freeSignalingClient(&signalingClientHandle) == STATUS_SUCCESS, STATUS_APP_SIGNALING_RESTART);
     CHK(createSignalingClientSync(&pAppSignaling->clientInfo, &pAppSignaling->channelInfo, &pAppSignaling->signalingClientCallbacks,
-                                  pAppSignaling->pAppCredential->pCredentialProvider, &pAppSignaling->signalingClientHandle) == STATUS_SUCCESS,
+                                  pAppSignaling->pAppCredential->pCredentialProvider, &signalingClientHandle) == STATUS_SUCCESS,
         STATUS_APP_SIGNALING_RESTART);
 
 CleanUp:
 
+    // Publish the new client, or keep the old one if it could not be freed.
+    if (IS_VALID_MUTEX_VALUE(pAppSignaling->signalingSendMessageLock)) {
+        MUTEX_LOCK(pAppSignaling->signalingSendMessageLock);
+        locked = TRUE;
+    }
+    pAppSignaling->signalingClientHandle = signalingClientHandle;
+    if (locked) {
+        MUTEX_UNLOCK(pAppSignaling->signalingSendMessageLock);
+    }
+
     return retStatus;
 }
 
+/**
+ * @brief   stop the reconnect thread. An attempt in progress is completed first.
+ */
+static VOID stopAppSignalingReconnect(PAppSignaling pAppSignaling)
+{
+    if (!IS_VALID_MUTEX_VALUE(pAppSignaling->reconnectLock)) {
+        return;
+    }
+
+    ATOMIC_STORE_BOOL(&pAppSignaling->terminateReconnect, TRUE);
+    if (pAppSignaling->reconnectTid != INVALID_TID_VALUE) {
+        MUTEX_LOCK(pAppSignaling->reconnectLock);
+        CVAR_BROADCAST(pAppSignaling->reconnectCvar);
+        MUTEX_UNLOCK(pAppSignaling->reconnectLock);
+        THREAD_JOIN(pAppSignaling->reconnectTid, NULL);
+        pAppSignaling->reconnectTid = INVALID_TID_VALUE;
+    }
+
+    DLOGI("Signaling reconnection: restarts %" PRIu64 ", failed attempts %" PRIu64, pAppSignaling->reconnectStats.restartCount,
+          pAppSignaling->reconnectStats.failedCount);
+}
+
+/**
+ * @brief   stop the sender thread and release the messages which are still queued.
+ */
+static VOID stopAppSignalingSender(PAppSignaling pAppSignaling)
+{
+    PAppSignalingSendNode pSendNode;
+
+    if (!IS_VALID_MUTEX_VALUE(pAppSignaling->sendQueueLock)) {
+        return;
+    }
+
+    ATOMIC_STORE_BOOL(&pAppSignaling->terminateSender, TRUE);
+    if (pAppSignaling->senderTid != INVALID_TID_VALUE) {
+        MUTEX_LOCK(pAppSignaling->sendQueueLock);
+        CVAR_BROADCAST(pAppSignaling->sendQueueCvar);
+        MUTEX_UNLOCK(pAppSignaling->sendQueueLock);
+        THREAD_JOIN(pAppSignaling->senderTid, NULL);
+        pAppSignaling->senderTid = INVALID_TID_VALUE;
+    }
+
+    MUTEX_LOCK(pAppSignaling->sendQueueLock);
+    while ((pSendNode = popAppSignalingSendNode(pAppSignaling)) != NULL) {
+        pAppSignaling->sendStats.droppedCount++;
+        SAFE_MEMFREE(pSendNode);
+    }
+    MUTEX_UNLOCK(pAppSignaling->sendQueueLock);
+
+    DLOGI("Signaling send queue: enqueued %" PRIu64 ", sent %" PRIu64 ", failed %" PRIu64 ", dropped %" PRIu64
+          ", max depth %u, avg latency %" PRIu64 " ms, max latency %" PRIu64 " ms",
+          pAppSignaling->sendStats.enqueuedCount, pAppSignaling->sendStats.sentCount, pAppSignaling->sendStats.failedCount,
+          pAppSignaling->sendStats.droppedCount, pAppSignaling->sendStats.maxQueueDepth,
+          pAppSignaling->sendStats.avgSendLatency / HUNDREDS_OF_NANOS_IN_A_MILLISECOND,
+          pAppSignaling->sendStats.maxSendLatency / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+}
+
 STATUS freeAppSignaling(PAppSignaling pAppSignaling)
 {
     STATUS retStatus = STATUS_SUCCESS;
 
+    stopAppSignalingReconnect(pAppSignaling);
+    stopAppSignalingSender(pAppSignaling);
+
     if (pAppSignaling->signalingClientHandle != INVALID_SIGNALING_CLIENT_HANDLE_VALUE) {
         retStatus = freeSignalingClient(&pAppSignaling->signalingClientHandle);
         if (retStatus != STATUS_SUCCESS) {
@@ -171,6 +761,32 @@ STATUS freeAppSignaling(PAppSignaling pAppSignaling)
 
     if (IS_VALID_MUTEX_VALUE(pAppSignaling->signalingSendMessageLock)) {
         MUTEX_FREE(pAppSignaling->signalingSendMessageLock);
+        pAppSignaling->signalingSendMessageLock = INVALID_MUTEX_VALUE;
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pAppSignaling->turnServerLock)) {
+        MUTEX_FREE(pAppSignaling->turnServerLock);
+        pAppSignaling->turnServerLock = INVALID_MUTEX_VALUE;
+    }
+
+    if (IS_VALID_CVAR_VALUE(pAppSignaling->sendQueueCvar)) {
+        CVAR_FREE(pAppSignaling->sendQueueCvar);
+        pAppSignaling->sendQueueCvar = INVALID_CVAR_VALUE;
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pAppSignaling->sendQueueLock)) {
+        MUTEX_FREE(pAppSignaling->sendQueueLock);
+        pAppSignaling->sendQueueLock = INVALID_MUTEX_VALUE;
+    }
+
+    if (IS_VALID_CVAR_VALUE(pAppSignaling->reconnectCvar)) {
+        CVAR_FREE(pAppSignaling->reconnectCvar);
+        pAppSignaling->reconnectCvar = INVALID_CVAR_VALUE;
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pAppSignaling->reconnectLock)) {
+        MUTEX_FREE(pAppSignaling->reconnectLock);
+        pAppSignaling->reconnectLock = INVALID_MUTEX_VALUE;
     }
 
     return retStatus;
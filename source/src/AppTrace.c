@@ -0,0 +1,248 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define LOG_CLASS "AppTrace"
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "AppTrace.h"
+
+// APP_TRACE_RING_SIZE is a power of 2, so the ring is indexed with a mask.
+#define APP_TRACE_RING_MASK (APP_TRACE_RING_SIZE - 1)
+
+// The buffers live as long as the process, so a thread never holds a freed buffer. Only the pages of the claimed buffers are touched.
+// A thread gives its buffer back when it exits, so the threads of the rebuilt pipelines reuse the buffers of the old ones.
+static AppTraceBuffer gAppTraceBuffers[APP_TRACE_MAX_THREADS];
+static volatile SIZE_T gAppTraceBufferCount = 0; //!< the buffers ever claimed, it keeps counting once they all are.
+static pthread_key_t gAppTraceBufferKey;
+static pthread_once_t gAppTraceBufferKeyOnce = PTHREAD_ONCE_INIT;
+static volatile ATOMIC_BOOL gAppTraceEnabled = FALSE;
+static CHAR gAppTracePath[MAX_PATH_LEN + 1];
+static __thread PAppTraceBuffer gpAppTraceBuffer = NULL;
+static __thread BOOL gAppTraceDropped = FALSE; //!< no buffer is left for the thread.
+
+static UINT64 getAppTraceTime()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (UINT64) now.tv_sec * HUNDREDS_OF_NANOS_IN_A_SECOND + (UINT64) now.tv_nsec / DEFAULT_TIME_UNIT_IN_NANOS;
+}
+
+/**
+ * @brief write a string as a json string. The names come from the callers, so the quotes, the backslashes and the control
+ *        characters are escaped.
+ */
+static VOID writeAppTraceString(FILE* fp, PCHAR pString)
+{
+    PCHAR pCur;
+
+    fputc('"', fp);
+    for (pCur = pString; *pCur != '\0'; pCur++) {
+        if (*pCur == '"' || *pCur == '\\') {
+            fputc('\\', fp);
+            fputc(*pCur, fp);
+        } else if ((UINT8) *pCur < 0x20) {
+            fprintf(fp, "\\u%04x", (UINT8) *pCur);
+        } else {
+            fputc(*pCur, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static VOID releaseAppTraceBuffer(PVOID pData)
+{
+    ATOMIC_STORE(&((PAppTraceBuffer) pData)->state, APP_TRACE_BUFFER_RELEASED);
+}
+
+static VOID createAppTraceBufferKey(VOID)
+{
+    // the destructor runs at the exit of every thread holding a buffer.
+    pthread_key_create(&gAppTraceBufferKey, releaseAppTraceBuffer);
+}
+
+static PAppTraceBuffer getAppTraceBuffer()
+{
+    PAppTraceBuffer pBuffer = NULL;
+    SIZE_T index, expected;
+
+    if (gpAppTraceBuffer == NULL && !gAppTraceDropped) {
+        pthread_once(&gAppTraceBufferKeyOnce, createAppTraceBufferKey);
+        // A fresh buffer first, so the events of the exited threads stay for the dump as long as possible.
+        index = ATOMIC_INCREMENT(&gAppTraceBufferCount);
+        if (index < APP_TRACE_MAX_THREADS) {
+            pBuffer = &gAppTraceBuffers[index];
+            ATOMIC_STORE(&pBuffer->state, APP_TRACE_BUFFER_CLAIMING);
+        }
+        for (index = 0; index < APP_TRACE_MAX_THREADS && pBuffer == NULL; index++) {
+            expected = APP_TRACE_BUFFER_RELEASED;
+            if (ATOMIC_COMPARE_EXCHANGE(&gAppTraceBuffers[index].state, &expected, APP_TRACE_BUFFER_CLAIMING)) {
+                pBuffer = &gAppTraceBuffers[index];
+            }
+        }
+
+        if (pBuffer == NULL) {
+            gAppTraceDropped = TRUE;
+        } else {
+            pBuffer->tid = (UINT64) GETTID();
+            pBuffer->threadName[0] = '\0';
+            pBuffer->firstEventCount = pBuffer->eventCount;
+            pthread_setspecific(gAppTraceBufferKey, pBuffer);
+            ATOMIC_STORE(&pBuffer->state, APP_TRACE_BUFFER_OWNED);
+            gpAppTraceBuffer = pBuffer;
+        }
+    }
+    return gpAppTraceBuffer;
+}
+
+static VOID recordAppTraceEvent(PCHAR pName, CHAR phase)
+{
+    PAppTraceBuffer pBuffer;
+    PAppTraceEvent pEvent;
+    SIZE_T eventCount;
+
+    if (!ATOMIC_LOAD_BOOL(&gAppTraceEnabled) || (pBuffer = getAppTraceBuffer()) == NULL) {
+        return;
+    }
+    // Only this thread writes the buffer, the count is published after the event so the dump never reads a partial one.
+    eventCount = pBuffer->eventCount;
+    pEvent = &pBuffer->events[eventCount & APP_TRACE_RING_MASK];
+    pEvent->pName = pName;
+    pEvent->timestamp = getAppTraceTime();
+    pEvent->phase = phase;
+    ATOMIC_STORE(&pBuffer->eventCount, eventCount + 1);
+}
+
+STATUS initAppTrace(PCHAR pPath)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pPath != NULL && pPath[0] != '\0', retStatus);
+    CHK(STRLEN(pPath) <= MAX_PATH_LEN, STATUS_APP_TRACE_PATH_TOO_LONG);
+
+    STRNCPY(gAppTracePath, pPath, MAX_PATH_LEN);
+    ATOMIC_STORE_BOOL(&gAppTraceEnabled, TRUE);
+    DLOGI("Tracing the app threads, send SIGUSR2 to dump the trace into %s", gAppTracePath);
+
+CleanUp:
+
+    CHK_LOG_ERR((retStatus));
+    return retStatus;
+}
+
+STATUS deinitAppTrace()
+{
+    ATOMIC_STORE_BOOL(&gAppTraceEnabled, FALSE);
+    gAppTracePath[0] = '\0';
+    return STATUS_SUCCESS;
+}
+
+VOID appTraceBegin(PCHAR pName)
+{
+    recordAppTraceEvent(pName, 'B');
+}
+
+VOID appTraceEnd(PCHAR pName)
+{
+    recordAppTraceEvent(pName, 'E');
+}
+
+VOID setAppTraceThreadName(PCHAR pName)
+{
+    PAppTraceBuffer pBuffer;
+
+    if (ATOMIC_LOAD_BOOL(&gAppTraceEnabled) && (pBuffer = getAppTraceBuffer()) != NULL && pBuffer->threadName[0] == '\0') {
+        STRNCPY(pBuffer->threadName, pName, APP_TRACE_THREAD_NAME_LEN);
+    }
+}
+
+STATUS dumpAppTrace(PCHAR pPath)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR tmpPath[MAX_PATH_LEN + 1];
+    FILE* fp = NULL;
+    PAppTraceBuffer pBuffer;
+    PAppTraceEvent pCopy = NULL, pEvent;
+    SIZE_T i, j, bufferCount, state, firstCount, startCount, endCount, overwrittenCount;
+    UINT32 eventCount = 0, threadCount = 0;
+    BOOL first = TRUE;
+    INT32 pid = (INT32) getpid();
+
+    pPath = pPath != NULL ? pPath : gAppTracePath;
+    CHK(pPath[0] != '\0', STATUS_APP_TRACE_DISABLED);
+    CHK(SNPRINTF(tmpPath, SIZEOF(tmpPath), "%s.tmp", pPath) < (INT32) SIZEOF(tmpPath), STATUS_APP_TRACE_PATH_TOO_LONG);
+    CHK(NULL != (pCopy = (PAppTraceEvent) MEMALLOC(SIZEOF(gAppTraceBuffers[0].events))), STATUS_APP_TRACE_NOT_ENOUGH_MEMORY);
+    CHK((fp = FOPEN(tmpPath, "w")) != NULL, STATUS_APP_TRACE_OPEN_FILE);
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bufferCount = MIN(ATOMIC_LOAD(&gAppTraceBufferCount), APP_TRACE_MAX_THREADS);
+    for (i = 0; i < bufferCount; i++) {
+        pBuffer = &gAppTraceBuffers[i];
+        state = ATOMIC_LOAD(&pBuffer->state);
+        if (state != APP_TRACE_BUFFER_OWNED && state != APP_TRACE_BUFFER_RELEASED) {
+            continue;
+        }
+        firstCount = pBuffer->firstEventCount;
+
+        // Copy the ring, then drop the events the thread may have overwritten during the copy.
+        endCount = ATOMIC_LOAD(&pBuffer->eventCount);
+        MEMCPY(pCopy, pBuffer->events, SIZEOF(pBuffer->events));
+        overwrittenCount = ATOMIC_LOAD(&pBuffer->eventCount) + 1;
+        // A buffer claimed by another thread meanwhile is skipped, its events would be mixed with the ones of the exited thread.
+        if (ATOMIC_LOAD(&pBuffer->state) == APP_TRACE_BUFFER_CLAIMING || pBuffer->firstEventCount != firstCount) {
+            continue;
+        }
+        startCount = endCount > APP_TRACE_RING_SIZE ? endCount - APP_TRACE_RING_SIZE : 0;
+        startCount = MAX(startCount, overwrittenCount > APP_TRACE_RING_SIZE ? overwrittenCount - APP_TRACE_RING_SIZE : 0);
+        startCount = MAX(startCount, firstCount);
+        threadCount++;
+
+        if (pBuffer->threadName[0] != '\0') {
+            fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%" PRIu64 ",\"args\":{\"name\":", first ? "" : ",", pid,
+                    pBuffer->tid);
+            writeAppTraceString(fp, pBuffer->threadName);
+            fprintf(fp, "}}");
+            first = FALSE;
+        }
+        for (j = startCount; j < endCount; j++) {
+            pEvent = &pCopy[j & APP_TRACE_RING_MASK];
+            fprintf(fp, "%s\n{\"name\":", first ? "" : ",");
+            writeAppTraceString(fp, pEvent->pName);
+            fprintf(fp, ",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%u,\"pid\":%d,\"tid\":%" PRIu64 "}", pEvent->phase,
+                    pEvent->timestamp / HUNDREDS_OF_NANOS_IN_A_MICROSECOND, (UINT32) (pEvent->timestamp % HUNDREDS_OF_NANOS_IN_A_MICROSECOND), pid,
+                    pBuffer->tid);
+            first = FALSE;
+            eventCount++;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    CHK(ferror(fp) == 0, STATUS_APP_TRACE_WRITE_FILE);
+    CHK(FCLOSE(fp) == 0, STATUS_APP_TRACE_WRITE_FILE);
+    fp = NULL;
+    CHK(rename(tmpPath, pPath) == 0, STATUS_APP_TRACE_WRITE_FILE);
+    DLOGI("%u trace events of %u threads are written into %s", eventCount, threadCount, pPath);
+
+CleanUp:
+
+    if (fp != NULL) {
+        FCLOSE(fp);
+        unlink(tmpPath);
+    }
+    SAFE_MEMFREE(pCopy);
+
+    CHK_LOG_ERR((retStatus));
+    return retStatus;
+}
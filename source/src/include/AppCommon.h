@@ -23,38 +23,112 @@ extern "C" {
 #include "AppConfig.h"
 #include "AppError.h"
 #include "AppCredential.h"
+#include "AppDataChannel.h"
+#include "AppInterfaceFilter.h"
+#include "AppMemory.h"
+#include "AppMetrics.h"
+#include "AppMetricsRegistry.h"
+#include "AppPacer.h"
+#include "AppRecorder.h"
+#include "AppReplay.h"
 #include "AppRtspSrc.h"
 #include "AppSignaling.h"
+#include "AppTrace.h"
 #include "AppMessageQueue.h"
 
 typedef struct __StreamingSession StreamingSession;
 typedef struct __StreamingSession* PStreamingSession;
 
+typedef enum {
+    APP_SESSION_LINK_STATE_GOOD,               //!< the viewer receives the packets.
+    APP_SESSION_LINK_STATE_LOSSY,              //!< the viewer reports loss or asks for retransmissions, the network path is bad.
+    APP_SESSION_LINK_STATE_GATEWAY_OVERLOADED, //!< the packets are discarded before they leave the gateway.
+} APP_SESSION_LINK_STATE;
+
 typedef struct {
-    UINT64 prevNumberOfPacketsSent;
-    UINT64 prevNumberOfPacketsReceived;
-    UINT64 prevNumberOfBytesSent;
-    UINT64 prevNumberOfBytesReceived;
-    UINT64 prevPacketsDiscardedOnSend;
-    UINT64 prevTs;
-} RtcMetricsHistory, *PRtcMetricsHistory;
+    UINT64 timestamp;                 //!< the time of the sample of the selected candidate pair.
+    UINT64 packetsSent;               //!< the number of packets sent.
+    UINT64 packetsReceived;           //!< the number of packets received.
+    UINT64 bytesSent;                 //!< the number of bytes sent.
+    UINT64 bytesReceived;             //!< the number of bytes received.
+    UINT64 packetsDiscardedOnSend;    //!< the number of packets discarded on send.
+    DOUBLE packetsSentRate;           //!< the packets sent per second since the previous sample.
+    DOUBLE packetsReceivedRate;       //!< the packets received per second since the previous sample.
+    DOUBLE packetsDiscardedRate;      //!< the packets discarded on send per second since the previous sample.
+    DOUBLE outgoingBitrate;           //!< the outgoing bitrate in bps since the previous sample.
+    DOUBLE incomingBitrate;           //!< the incoming bitrate in bps since the previous sample.
+    DOUBLE roundTripTime;             //!< the current round trip time in seconds.
+    AppRtpQualityStats rtpStats;      //!< the rtp stats of the transceivers, from the rtcp feedback of the viewer.
+    AppRtpQualityStats videoRtpStats; //!< the counters of the video transceiver, kept when it misses a sample.
+    AppRtpQualityStats audioRtpStats; //!< the counters of the audio transceiver, kept when it misses a sample.
+    DOUBLE nackRate;                  //!< the nacks received per second since the previous sample.
+    DOUBLE pliRate;                   //!< the picture loss indications received per second since the previous sample.
+    DOUBLE retransmittedBitrate;      //!< the retransmitted bitrate in bps since the previous sample.
+    DOUBLE sendBudget;                //!< the bitrate in bps the session may send, 0 before the first sample.
+    APP_SESSION_LINK_STATE linkState; //!< the cause of the degradation of the session, if any.
+} AppSessionStats, *PAppSessionStats;
+
+typedef enum {
+    APP_SESSION_EVENT_OFFER_RECEIVED,          //!< the offer is received, the origin of the timeline.
+    APP_SESSION_EVENT_PEER_CONNECTION_CREATED, //!< the peer connection is created.
+    APP_SESSION_EVENT_REMOTE_DESCRIPTION_SET,  //!< the offer is set as the remote description.
+    APP_SESSION_EVENT_ANSWER_SENT,             //!< the answer is queued to the signaling client.
+    APP_SESSION_EVENT_FIRST_CANDIDATE,         //!< the first local candidate is gathered.
+    APP_SESSION_EVENT_GATHERING_DONE,          //!< the gathering of the local candidates is done.
+    APP_SESSION_EVENT_ICE_CHECKING,            //!< the connectivity checks of ice start.
+    APP_SESSION_EVENT_CONNECTED,               //!< the ice and dtls handshakes are done.
+    APP_SESSION_EVENT_FIRST_KEY_FRAME,         //!< the first key frame is written.
+    APP_SESSION_EVENT_FIRST_AUDIO_FRAME,       //!< the first audio frame is written.
+    APP_SESSION_EVENT_COUNT,
+} APP_SESSION_EVENT;
+
+typedef struct {
+    UINT32 mapMetricId;         //!< the latency from the appsink callback to the mapped buffer.
+    UINT32 writeMetricId;       //!< the latency of writeFrame of all the sessions.
+    UINT32 sinkMetricId;        //!< the latency from the appsink callback to the end of the fan-out to the sessions.
+    UINT32 ptsLagMetricId;      //!< the clock offset above the smallest one, the queuing before the appsink.
+    UINT32 clockOffsetMetricId; //!< the offset of the wall clock from the running time of the frames.
+    INT64 minClockOffset;       //!< the smallest clock offset, the baseline of the lag.
+    BOOL clockOffsetValid;      //!< minClockOffset is set.
+} AppTrackMetrics, *PAppTrackMetrics;
+
+typedef struct {
+    UINT64 totalRequestsSent;      //!< the requests sent to the ice server at the previous probe.
+    UINT64 totalResponsesReceived; //!< the responses received from the ice server at the previous probe.
+    UINT64 totalRoundTripTime;     //!< the round trip time of the responses at the previous probe, in 100ns.
+} AppIceServerProbe, *PAppIceServerProbe;
 
 typedef struct {
     volatile ATOMIC_BOOL terminateApp;           //!< terminate this app.
     volatile ATOMIC_BOOL sigInt;                 //!< the flag to indicate the system-level signal.
     volatile ATOMIC_BOOL mediaThreadStarted;     //!< the flag to indicate the status of the media thread.
     volatile ATOMIC_BOOL restartSignalingClient; //!< the flag to indicate we need to re-sync the singal server.
+    volatile ATOMIC_BOOL dumpLockProfile;        //!< the flag to log the lock profile, set by SIGUSR1.
+    volatile ATOMIC_BOOL dumpTrace;              //!< the flag to dump the trace of the threads, set by SIGUSR2.
     volatile ATOMIC_BOOL peerConnectionConnected;
 
-    AppCredential appCredential; //!< the context of app credential.
-    AppSignaling appSignaling;   //!< the context of app signaling.
-    PVOID pMediaContext;         //!< the context of media.
+    AppCredential appCredential;        //!< the context of app credential.
+    AppSignaling appSignaling;          //!< the context of app signaling.
+    AppInterfaceFilter interfaceFilter; //!< the rules of the network interfaces used by ice.
+    PVOID pMediaContext;                //!< the context of media.
 
     TID mediaSenderTid;
     startRoutine mediaSource;
     TIMER_QUEUE_HANDLE timerQueueHandle;
-    UINT32 iceCandidatePairStatsTimerId; //!< the timer id.
-    UINT32 pregenerateCertTimerId;
+    UINT32 iceCandidatePairStatsTimerId;            //!< the timer id.
+    UINT32 turnProbeTimerId;                        //!< the timer id of probing the turn servers.
+    UINT32 metricsTimerId;                          //!< the timer id of collecting the metrics for the exporter.
+    UINT32 probeTimerId;                            //!< the timer id of pinging the viewers over the probe channels.
+    volatile SIZE_T replayTimerId;                  //!< the timer id of serving the replays, MAX_UINT32 while no replay runs.
+    volatile ATOMIC_BOOL replayTimerArmed;          //!< the replay timer is armed by a request and stops once the replays are done.
+    UINT32 dataChannelTimerId;                      //!< the timer id of flushing the data channel queues of the sessions.
+    PAppReplay pAppReplay;                          //!< the pre-roll of the frames, NULL without a replay duration.
+    PAppRecorder pAppRecorder;                      //!< the local recording of the media, NULL without a recording directory.
+    PAppPacer pAppPacer;                            //!< the pacer of the sessions, NULL without a pacing rate.
+    PAppMetricsRegistry pMetricsRegistry;           //!< the metrics served by the exporter.
+    AppTrackMetrics videoMetrics;                   //!< the frame latencies of the video track.
+    AppTrackMetrics audioMetrics;                   //!< the frame latencies of the audio track.
+    UINT32 setupMetricIds[APP_SESSION_EVENT_COUNT]; //!< the latencies of the session setup from the offer, per event.
 
     PConnectionMsgQ pRemotePeerPendingSignalingMessages; //!< stores signaling messages before receiving offer or answer.
     PHashTable pRemoteRtcPeerConnections;
@@ -68,7 +142,6 @@ typedef struct {
     PStreamingSession streamingSessionList[APP_MAX_CONCURRENT_STREAMING_SESSION];
     UINT32 streamingSessionCount;
     MUTEX streamingSessionListReadLock; //!< the lock of streaming session.
-    UINT32 iceUriCount;                 //!< the number of ice server including stun and turn.
 
 } AppConfiguration, *PAppConfiguration;
 
@@ -86,9 +159,30 @@ struct __StreamingSession {
     CHAR peerId[MAX_SIGNALING_CLIENT_ID_LEN +
                 1]; //!< https://docs.aws.amazon.com/kinesisvideostreams-webrtc-dg/latest/devguide/kvswebrtc-websocket-apis3.html
 
-    UINT64 offerReceiveTime;
-    BOOL firstKeyFrame;                  //!< the first key frame of this session is sent or not.
-    RtcMetricsHistory rtcMetricsHistory; //!< the metrics of the previous packet.
+    UINT64 timeline[APP_SESSION_EVENT_COUNT];         //!< the monotonic time of the setup events in 100ns, 0 if it does not happen yet.
+    volatile ATOMIC_BOOL timelineReported;            //!< the timeline is reported.
+    BOOL firstKeyFrame;                               //!< the first key frame of this session is sent or not.
+    volatile SIZE_T sendBudget;                       //!< the bitrate in bps the video of the session may send, 0 without a limit.
+    DOUBLE sendTokens;                                //!< the bytes of the send budget the video may send now, negative in debt.
+    UINT64 sendRefillTime;                            //!< the time the send tokens are refilled, only the media thread uses them.
+    volatile SIZE_T sendBudgetDropped;                //!< the video frames dropped over the debt of the send budget.
+    volatile SIZE_T twccBitrate;                      //!< the bitrate in bps the twcc feedback estimates, 0 before the first report.
+    volatile SIZE_T refCount;                         //!< the references of the session list and the stats snapshots.
+    AppSessionStats stats[2];                         //!< the double-buffered stats, the one at statsGeneration % 2 is published.
+    volatile SIZE_T statsGeneration;                  //!< the number of stats published, the readers retry when it moves under them.
+    UINT32 frameDelayMetricId;                        //!< the latency from the appsink callback to the end of writeFrame of this session.
+    UINT32 writeFrameMetricId;                        //!< the latency of writeFrame of this session.
+    AppInterfaceFilterSession interfaceFilterSession; //!< the interface filter of this peer connection.
+    PAppDataChannel pAppDataChannel;                  //!< the outbound queue of the first data channel of the viewer.
+    PAppDataChannelProbe pAppDataChannelProbe;        //!< the probe channel of the viewer, NULL if it does not open one.
+    UINT32 probeRttMetricId;                          //!< the round trip time of the probes of this session.
+    PRtcDataChannel pReplayDataChannel;               //!< the replay channel of the viewer, NULL if it does not open one.
+    volatile ATOMIC_BOOL replayRequested;             //!< the viewer asks for the replay, the replay timer starts it.
+    AppReplayCursor replayCursor;                     //!< the replay in progress, only the replay timer uses it.
+    PAppPacerFlow pPacerFlow;                         //!< the flow of the session in the pacer, NULL without pacing.
+    UINT32 iceUriCount;                               //!< the ice servers of the peer connection, the stun server and the turn servers.
+    AppIceServerProbe iceProbes[APP_ICE_SERVERS_MAX]; //!< the totals of the ice servers at the previous turn probe.
+    UINT32 memorySessionId;                           //!< the memory charged to the session, APP_MEMORY_NO_SESSION if it is not counted.
     BOOL remoteCanTrickleIce;
 };
 /**
@@ -125,6 +219,29 @@ STATUS freeApp(PAppConfiguration* ppAppConfiguration);
  * @return STATUS code of the execution. STATUS_SUCCESS on success.
  */
 STATUS pollApp(PAppConfiguration pAppConfiguration);
+/**
+ * @brief get the latest stats of the streaming session without any lock. The stats timer is the only writer, it fills the
+ *        buffer which is not published and then publishes it, so the readers never wait.
+ *
+ * @param[in] pStreamingSession the streaming session.
+ * @param[out] pStats the stats.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getStreamingSessionStats(PStreamingSession pStreamingSession, PAppSessionStats pStats);
+/**
+ * @brief send a message to the data channel of every streaming session. The writer fills the message in place in the
+ *        queue of each session, the queues under backpressure skip the message. The data channel timer sends the batches
+ *        every APP_DATA_CHANNEL_FLUSH_PERIOD, so the messages of the period are coalesced.
+ *
+ * @param[in] pAppConfiguration the context of the app.
+ * @param[in] size the size of the message.
+ * @param[in] writer the writer of the message, it is called once per session.
+ * @param[in] udata the user data of the writer.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS sendAppSessionsData(PAppConfiguration pAppConfiguration, UINT32 size, AppDataChannelWriter writer, PVOID udata);
 #ifdef __cplusplus
 }
 #endif
@@ -21,18 +21,116 @@ extern "C" {
 
 #include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
 
+// The benchmarks raise the limit to fan the frames out to more sessions.
+#ifndef APP_MAX_CONCURRENT_STREAMING_SESSION
 #define APP_MAX_CONCURRENT_STREAMING_SESSION 10
+#endif
 #define APP_MASTER_CLIENT_ID                 "ProducerMaster"
 #define APP_VIEWER_CLIENT_ID                 "ConsumerViewer"
 #define APP_CLEANUP_WAIT_PERIOD              (5 * HUNDREDS_OF_NANOS_IN_A_SECOND)
-#define APP_STATS_DURATION                   (60 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_STATS_DURATION                   (5 * HUNDREDS_OF_NANOS_IN_A_SECOND)
 #define APP_PENDING_MESSAGE_CLEANUP_DURATION (20 * HUNDREDS_OF_NANOS_IN_A_SECOND)
 #define APP_PRE_GENERATE_CERT                TRUE
 #define APP_PRE_GENERATE_CERT_PERIOD         (1000 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_CERT_POOL_DEFAULT_DEPTH          MAX_RTCCONFIGURATION_CERTIFICATES
+#define APP_CERT_POOL_MAX_DEPTH              32
+#define APP_CERT_WORKER_NICE                 19
+#define APP_CERT_CACHE_DEFAULT_TTL           (24 * 60 * 60)
+#define APP_CERT_CACHE_MAX_FILES             (2 * APP_CERT_POOL_MAX_DEPTH)
+#define APP_CERT_CACHE_FILE_PREFIX           "dtls-"
+#define APP_CERT_CACHE_FILE_EXTENSION        ".pem"
 #define APP_CA_CERT_PEM_FILE_EXTENSION       ".pem"
 
+#define APP_SIGNALING_SEND_QUEUE_MAX_DEPTH   256
+#define APP_TURN_SERVER_DEFAULT_COUNT        1
+#define APP_ICE_SERVERS_MAX                  (MAX_ICE_SERVERS_COUNT + 1)
+#define APP_TURN_PROBE_DEFAULT_INTERVAL      (30 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_TURN_SERVER_UNREACHABLE_RTT      (5 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_SIGNALING_RECONNECT_CHECK_PERIOD (5 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_SIGNALING_RECONNECT_BASE_DELAY   (1 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_SIGNALING_RECONNECT_MAX_DELAY    (60 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+
+#define APP_INTERFACE_FILTER_MAX_RULES         16
+#define APP_INTERFACE_FILTER_PATTERN_LEN       64
+#define APP_INTERFACE_FILTER_DEFAULT_DENY_LIST ((PCHAR) "docker*,veth*,br-*,virbr*")
+
 #define APP_METRICS_FILE_LOGGING_BUFFER_SIZE (100 * 1024)
 #define APP_METRICS_LOG_FILES_MAX_NUMBER     5
+#define APP_METRICS_REGISTRY_MAX_COUNT       384
+#define APP_METRICS_NAME_LEN                 64
+#define APP_METRICS_LABELS_LEN               512
+#define APP_METRICS_MAX_BUCKETS              16
+#define APP_METRICS_HDR_SUB_BUCKET_BITS      6
+#define APP_METRICS_HDR_VALUE_BITS           32
+#define APP_METRICS_HDR_SUB_BUCKETS          (1 << APP_METRICS_HDR_SUB_BUCKET_BITS)
+#define APP_METRICS_HDR_BUCKET_COUNT         (APP_METRICS_HDR_SUB_BUCKETS * (APP_METRICS_HDR_VALUE_BITS - APP_METRICS_HDR_SUB_BUCKET_BITS + 2) / 2)
+#define APP_METRICS_HDR_UNIT                 0.000001
+#define APP_METRICS_FRAME_PTS_LAG_RESET      (10 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_METRICS_COLLECT_PERIOD           (15 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_METRICS_EXPORTER_BACKLOG         4
+#define APP_METRICS_EXPORTER_POLL_TIMEOUT_MS 500
+#define APP_METRICS_EXPORTER_MAX_CLIENTS     8
+#define APP_METRICS_EXPORTER_IO_TIMEOUT_S    2
+#define APP_METRICS_EXPORTER_DEFAULT_HOST    "127.0.0.1"
+#define APP_METRICS_EXPORTER_UNIX_PREFIX     "unix:"
+#define APP_LOCK_PROFILER_MAX_LOCKS          8
+#define APP_LOCK_PROFILER_MAX_SITES          32
+#define APP_LOCK_PROFILER_BUCKET_COUNT       32
+#define APP_LOCK_PROFILER_NAME_LEN           63
+#define APP_LOCK_PROFILER_TOP_SITES          5
+#define APP_MEMORY_RECORD_LEN                512
+#define APP_MEMORY_LOG_PERIOD                (5 * 60 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_MEMORY_SESSION_SLOTS             (2 * APP_MAX_CONCURRENT_STREAMING_SESSION)
+#define APP_TRACE_MAX_THREADS                32
+#define APP_TRACE_RING_SIZE                  4096
+#define APP_TRACE_THREAD_NAME_LEN            31
+
+#define APP_SESSION_TIMELINE_RECORD_LEN  1024
+#define APP_SESSION_LOSSY_FRACTION_LOST  0.05
+#define APP_SESSION_LOSSY_NACK_RATIO     0.05
+#define APP_SESSION_SEND_BUDGET_MIN      (128 * 1024)
+#define APP_SESSION_SEND_BUDGET_MAX      (20 * 1024 * 1024)
+#define APP_SESSION_SEND_BUDGET_INCREASE 1.05
+#define APP_SESSION_SEND_BUDGET_BURST    (1 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_SESSION_SEND_BUDGET_MAX_DEBT (500 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+
+#define APP_DATA_CHANNEL_BATCH_SIZE     (64 * 1024)
+#define APP_DATA_CHANNEL_QUEUE_DEPTH    32
+#define APP_DATA_CHANNEL_HIGH_WATERMARK (1024 * 1024)
+#define APP_DATA_CHANNEL_LOW_WATERMARK  (256 * 1024)
+#define APP_DATA_CHANNEL_FLUSH_PERIOD   (10 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_DATA_CHANNEL_PROBE_NAME     "kvsProbe"
+
+#define APP_REPLAY_CAPACITY          (32 * 1024 * 1024)
+#define APP_REPLAY_MAX_KEY_FRAMES    256
+#define APP_REPLAY_CHUNK_SIZE        (16 * 1024)
+#define APP_REPLAY_SERVE_PERIOD      (20 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_REPLAY_SERVE_BUDGET      (256 * 1024)
+#define APP_REPLAY_DATA_CHANNEL_NAME "kvsReplay"
+
+#define APP_RECORDER_QUEUE_CAPACITY    (16 * 1024 * 1024)
+#define APP_RECORDER_FRAME_BUFFER_SIZE (512 * 1024)
+#define APP_RECORDER_WRITE_SIZE        (1024 * 1024)
+#define APP_RECORDER_WRITE_ALIGNMENT   4096
+#define APP_RECORDER_POLL_PERIOD       (20 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_RECORDER_PARAMETER_SET_LEN 256
+#define APP_RECORDER_DEFAULT_DURATION  (60 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_RECORDER_DEFAULT_SIZE      (256 * 1024 * 1024)
+
+#define APP_PACER_MAX_FLOWS        APP_MAX_CONCURRENT_STREAMING_SESSION
+#define APP_PACER_QUEUE_DEPTH      64
+#define APP_PACER_MAX_DELAY        (200 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_PACER_BURST_FRACTION   4
+#define APP_PACER_DEFAULT_INTERVAL (33 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_PACER_IDLE_PERIOD      (100 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+
+#define APP_MEDIA_RECONNECT_BASE_DELAY (500 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_MEDIA_RECONNECT_MAX_DELAY  (30 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_MEDIA_RECONNECT_FOREVER    MAX_UINT32
+#define APP_MEDIA_WATCHDOG_PERIOD      (500 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_MEDIA_STALL_TIMEOUT        (3 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_MEDIA_STALL_FRAMES         15
+#define APP_MEDIA_STALL_START_TIMEOUT  (10 * HUNDREDS_OF_NANOS_IN_A_SECOND)
 
 #define APP_HASH_TABLE_BUCKET_COUNT  50
 #define APP_HASH_TABLE_BUCKET_LENGTH 2
@@ -45,9 +143,31 @@ extern "C" {
 #define APP_IOT_CORE_THING_NAME            ((PCHAR) "AWS_IOT_CORE_THING_NAME")
 #define APP_ECS_AUTH_TOKEN                 ((PCHAR) "AWS_CONTAINER_AUTHORIZATION_TOKEN")
 #define APP_ECS_CREDENTIALS_FULL_URI       ((PCHAR) "AWS_CONTAINER_CREDENTIALS_FULL_URI")
+#define APP_CERT_POOL_DEPTH                ((PCHAR) "AWS_WEBRTC_CERT_POOL_DEPTH")
+#define APP_CERT_KEY_TYPE                  ((PCHAR) "AWS_WEBRTC_CERT_KEY_TYPE")
+#define APP_CERT_KEY_TYPE_RSA_STRING       "RSA"
+#define APP_CERT_CACHE_DIR                 ((PCHAR) "AWS_WEBRTC_CERT_CACHE_DIR")
+#define APP_CERT_CACHE_TTL                 ((PCHAR) "AWS_WEBRTC_CERT_CACHE_TTL")
+#define APP_TURN_SERVER_COUNT              ((PCHAR) "AWS_WEBRTC_TURN_SERVER_COUNT")
+#define APP_TURN_PROBE_INTERVAL            ((PCHAR) "AWS_WEBRTC_TURN_PROBE_INTERVAL")
+#define APP_INTERFACE_ALLOW_LIST           ((PCHAR) "AWS_WEBRTC_INTERFACE_ALLOW")
+#define APP_INTERFACE_DENY_LIST            ((PCHAR) "AWS_WEBRTC_INTERFACE_DENY")
+#define APP_METRICS_ENDPOINT               ((PCHAR) "AWS_WEBRTC_METRICS_ENDPOINT")
+#define APP_TRACE_FILE                     ((PCHAR) "AWS_WEBRTC_TRACE_FILE")
+#define APP_DATA_CHANNEL_PROBE_INTERVAL    ((PCHAR) "AWS_WEBRTC_PROBE_INTERVAL")
+#define APP_REPLAY_DURATION                ((PCHAR) "AWS_WEBRTC_REPLAY_DURATION")
+#define APP_RECORDER_DIR                   ((PCHAR) "AWS_WEBRTC_RECORD_DIR")
+#define APP_RECORDER_SEGMENT_DURATION      ((PCHAR) "AWS_WEBRTC_RECORD_SEGMENT_DURATION")
+#define APP_RECORDER_SEGMENT_SIZE          ((PCHAR) "AWS_WEBRTC_RECORD_SEGMENT_SIZE")
+#define APP_RECORDER_DIRECT_IO             ((PCHAR) "AWS_WEBRTC_RECORD_DIRECT_IO")
+#define APP_RECORDER_PREALLOCATE           ((PCHAR) "AWS_WEBRTC_RECORD_PREALLOCATE")
+#define APP_PACER_RATE                     ((PCHAR) "AWS_WEBRTC_PACING_RATE")
 #define APP_MEDIA_RTSP_URL                 ((PCHAR) "AWS_RTSP_URL")
 #define APP_MEDIA_RTSP_USERNAME            ((PCHAR) "AWS_RTSP_USERNAME")
 #define APP_MEDIA_RTSP_PASSWORD            ((PCHAR) "AWS_RTSP_PASSWORD")
+#define APP_MEDIA_RTSP_RECONNECT_RETRIES   ((PCHAR) "AWS_RTSP_RECONNECT_RETRIES")
+#define APP_MEDIA_RTSP_STALL_TIMEOUT       ((PCHAR) "AWS_RTSP_STALL_TIMEOUT")
+#define APP_MEDIA_RTSP_TRACKS              ((PCHAR) "AWS_RTSP_TRACKS")
 #define APP_MEDIA_RTSP_USERNAME_LEN        MAX_CHANNEL_NAME_LEN
 #define APP_MEDIA_RTSP_PASSWORD_LEN        MAX_CHANNEL_NAME_LEN
 #define APP_MEDIA_GST_ELEMENT_NAME_MAX_LEN 256
@@ -24,12 +24,38 @@ extern "C" {
 
 typedef enum { APP_CREDENTIAL_TYPE_NA = 0, APP_CREDENTIAL_TYPE_STATIC, APP_CREDENTIAL_TYPE_IOT_CERT, APP_CREDENTIAL_TYPE_ECS } AppCredentialType;
 
+typedef enum { APP_CERT_KEY_TYPE_ECDSA = 0, APP_CERT_KEY_TYPE_RSA } AppCertKeyType;
+
+typedef struct {
+    UINT64 generatedCount;      //!< the number of certs generated by the pool.
+    UINT64 failedCount;         //!< the number of failed generations.
+    UINT64 totalGenerationTime; //!< the accumulated time of generation, in 100ns.
+    UINT64 maxGenerationTime;   //!< the longest time of generation, in 100ns.
+    UINT64 poolHits;            //!< the number of requests served by the pool.
+    UINT64 poolMisses;          //!< the number of requests left to the on-demand generation of the sdk.
+    UINT64 cacheLoadedCount;    //!< the number of certs loaded from the cert cache.
+    UINT64 cacheSavedCount;     //!< the number of certs saved into the cert cache.
+    UINT64 cacheEvictedCount;   //!< the number of cached certs removed because they were expired, unsafe or unreadable.
+} AppCertStats, *PAppCertStats;
+
 typedef struct {
-    AppCredentialType credentialType;           //!< the type of app credential.
-    PCHAR pCaCertPath;                          //!< the path of rootCA.
-    PAwsCredentialProvider pCredentialProvider; //!< the handler of aws credential provider.
-    MUTEX generateCertLock;                     //!< the lock for the access of generated cert.
-    PStackQueue generatedCertificates;          // Max MAX_RTCCONFIGURATION_CERTIFICATES certificates.
+    AppCredentialType credentialType;                 //!< the type of app credential.
+    PCHAR pCaCertPath;                                //!< the path of rootCA.
+    PAwsCredentialProvider pCredentialProvider;       //!< the handler of aws credential provider.
+    MUTEX generateCertLock;                           //!< the lock for the access of generated cert.
+    PStackQueue generatedCertificates;                //!< the pool of generated certs, up to certPoolDepth.
+    UINT32 certPoolDepth;                             //!< the number of certs kept in the pool.
+    AppCertKeyType certKeyType;                       //!< the key algorithm of the certs.
+    CVAR generateCertCvar;                            //!< wake up the worker when a cert is consumed.
+    TID generateCertTid;                              //!< the worker of generating the certs.
+    volatile ATOMIC_BOOL terminateCertWorker;         //!< stop the worker.
+    AppCertStats certStats;                           //!< the statistics of the pool, protected by generateCertLock.
+    CHAR certCacheDir[MAX_PATH_LEN + 1];              //!< the directory of the cert cache. It is empty when the cache is disabled.
+    UINT64 certCacheTtl;                              //!< the lifetime of the cached certs, in seconds.
+    UINT64 certCacheSeq;                              //!< the sequence number of the latest cached cert.
+    UINT64 certCacheSeqRing[APP_CERT_POOL_MAX_DEPTH]; //!< the sequence numbers of the pooled certs in the pool order. 0 means not cached.
+    UINT32 certCacheRingHead;                         //!< the head of certCacheSeqRing.
+    UINT32 certCacheRingCount;                        //!< the number of entries in certCacheSeqRing.
 } AppCredential, *PAppCredential;
 /**
  * @brief search the ssl cert according to the environmental variable.
@@ -55,6 +81,15 @@ STATUS generateCertRoutine(PAppCredential pAppCredential);
  * @return STATUS code of the execution. STATUS_SUCCESS on success.
  */
 STATUS popGeneratedCert(PAppCredential pAppCredential, PRtcCertificate* ppRtcCertificate);
+/**
+ * @brief start the low-priority worker which keeps the pool of generated certs filled.
+ *        The worker is not started when the key type is RSA, because the pool only holds ECDSA certs.
+ *
+ * @param[in] pAppCredential the context of the app credential.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS startCertGenerationWorker(PAppCredential pAppCredential);
 /**
  * @brief create the app credential according to environmental variables.
  *
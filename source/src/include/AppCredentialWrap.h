@@ -30,6 +30,24 @@ STATUS createAppIotCredentialProvider(PCHAR iotGetCredentialEndpoint, PCHAR cert
 STATUS freeAppIotCredentialProvider(PAwsCredentialProvider* ppCredentialProvider);
 STATUS createAppEcsCredentialProvider(PCHAR ecsCredentialFullUri, PCHAR token, PAwsCredentialProvider* ppCredentialProvider);
 STATUS freeAppEcsCredentialProvider(PAwsCredentialProvider* ppCredentialProvider);
+/**
+ * @brief save the generated cert and its private key into the pem file which is only accessible by the owner.
+ *
+ * @param[in] pRtcCertificate the cert generated by createRtcCertificate.
+ * @param[in] pPath the path of the pem file.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS saveAppRtcCertificate(PRtcCertificate pRtcCertificate, PCHAR pPath);
+/**
+ * @brief load the cert and its private key from the pem file. The cert is released by freeRtcCertificate.
+ *
+ * @param[in] pPath the path of the pem file.
+ * @param[out] ppRtcCertificate the loaded cert.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS loadAppRtcCertificate(PCHAR pPath, PRtcCertificate* ppRtcCertificate);
 
 #ifdef __cplusplus
 }
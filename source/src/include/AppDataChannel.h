@@ -23,7 +23,181 @@ extern "C" {
 #include "AppConfig.h"
 #include "AppError.h"
 
+/**
+ * The outbound messages are coalesced into batches, one batch is one binary sctp message. Each message of a batch is framed
+ * by its length in 4 big-endian bytes, the viewer splits the batch with the lengths.
+ */
+#define APP_DATA_CHANNEL_HEADER_LEN 4
+
+/**
+ * @brief fill a message in place.
+ *
+ * @param[in] udata the user data of the send.
+ * @param[in] pBuffer the space of the message in the batch.
+ * @param[in] size the size of the message.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success, the message is discarded otherwise.
+ */
+typedef STATUS (*AppDataChannelWriter)(PVOID udata, PBYTE pBuffer, UINT32 size);
+
+typedef struct {
+    UINT64 messagesQueued;    //!< the messages coalesced into the batches.
+    UINT64 messagesDropped;   //!< the messages refused by the backpressure.
+    UINT64 batchesSent;       //!< the batches accepted by the sdk.
+    UINT64 bytesSent;         //!< the bytes of the batches accepted by the sdk.
+    UINT64 sendFailures;      //!< the batches refused by the sdk, they are kept for the next flush.
+    UINT64 backpressureCount; //!< the times the queue crosses the high watermark.
+    UINT64 bufferedAmount;    //!< the bytes queued and not accepted by the sdk yet.
+} AppDataChannelStats, *PAppDataChannelStats;
+
+typedef struct {
+    MUTEX lock;                                     //!< the lock of the queue, the producers and the flush take it.
+    PRtcDataChannel pRtcDataChannel;                //!< the data channel opened by the viewer.
+    PBYTE batches[APP_DATA_CHANNEL_QUEUE_DEPTH];    //!< the ring of the batches, each is allocated on its first use.
+    UINT32 batchLens[APP_DATA_CHANNEL_QUEUE_DEPTH]; //!< the bytes of each batch.
+    UINT32 head;                                    //!< the oldest batch.
+    UINT32 count;                                   //!< the batches in the ring, the newest one takes the next messages.
+    BOOL backpressure;                              //!< the queue crossed the high watermark and is not drained below the low one yet.
+    BOOL flushing;                                  //!< a flush is sending the head batch out of the lock, it takes no more messages.
+    AppDataChannelStats stats;
+} AppDataChannel, *PAppDataChannel;
+
+/**
+ * The probe messages are exchanged on the data channel named APP_DATA_CHANNEL_PROBE_NAME. Either side sends a ping and the
+ * other side answers it with a pong, in APP_DATA_CHANNEL_PROBE_LEN big-endian bytes:
+ *
+ *  | type (1) | reserved (3) | sequence (4) | originTime (8) | receiveTime (8) | transmitTime (8) | framePts (8) | frameTime (8) |
+ *
+ * The times are in 100ns of the monotonic clock of each side. The ping carries the originTime of the sender. The pong echoes
+ * the sequence and the originTime, and adds the receiveTime of the ping and the transmitTime of the pong. The gateway fills
+ * framePts with the pts of the last frame sent to the session, and frameTime with the time it was sent, so the viewer maps
+ * the frame it renders to the clock of the gateway for the glass-to-glass latency.
+ */
+#define APP_DATA_CHANNEL_PROBE_LEN 48
+
+typedef enum {
+    APP_DATA_CHANNEL_PROBE_PING = 1,
+    APP_DATA_CHANNEL_PROBE_PONG = 2,
+} APP_DATA_CHANNEL_PROBE_TYPE;
+
+/**
+ * @brief the result of a probe.
+ *
+ * @param[in] udata the user data of the probe.
+ * @param[in] roundTripTime the round trip time without the time the remote side holds the ping, in 100ns.
+ * @param[in] clockOffset the monotonic clock of the remote side minus the local one, in 100ns.
+ */
+typedef VOID (*AppDataChannelProbeHook)(PVOID udata, UINT64 roundTripTime, INT64 clockOffset);
+
+typedef struct {
+    MUTEX lock;                      //!< the lock of the frame, the media thread writes it and the sctp thread reads it.
+    PRtcDataChannel pRtcDataChannel; //!< the probe channel opened by the viewer.
+    AppDataChannelProbeHook hook;    //!< the hook of the results.
+    PVOID udata;                     //!< the user data of the hook.
+    UINT32 sequence;                 //!< the sequence of the last ping.
+    UINT64 framePts;                 //!< the pts of the last frame sent to the session.
+    UINT64 frameTime;                //!< the monotonic time the last frame is sent.
+} AppDataChannelProbe, *PAppDataChannelProbe;
+
+/**
+ * @brief the callback of the data channels opened by the viewer, the incoming messages are logged.
+ *
+ * @param[in] userData the user data of the peer connection.
+ * @param[in] pRtcDataChannel the data channel.
+ */
 VOID onDataChannel(UINT64 userData, PRtcDataChannel pRtcDataChannel);
+/**
+ * @brief create the outbound queue of a data channel.
+ *
+ * @param[in] pRtcDataChannel the open data channel.
+ * @param[out] ppAppDataChannel the queue.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS createAppDataChannel(PRtcDataChannel pRtcDataChannel, PAppDataChannel* ppAppDataChannel);
+/**
+ * @brief free the queue and its batches, the messages which are not sent are dropped.
+ *
+ * @param[in, out] ppAppDataChannel the queue.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS freeAppDataChannel(PAppDataChannel* ppAppDataChannel);
+/**
+ * @brief queue a message without a copy, the writer fills it in place in the batch under the lock of the queue.
+ *
+ * @param[in] pAppDataChannel the queue.
+ * @param[in] size the size of the message.
+ * @param[in] writer the writer of the message.
+ * @param[in] udata the user data of the writer.
+ *
+ * @return STATUS code of the execution. STATUS_APP_DATA_CHANNEL_BACKPRESSURE if the queue is over the high watermark,
+ *         the producer should skip or hold the message until the queue drains.
+ */
+STATUS writeAppDataChannelMessage(PAppDataChannel pAppDataChannel, UINT32 size, AppDataChannelWriter writer, PVOID udata);
+/**
+ * @brief queue a copy of a message.
+ *
+ * @param[in] pAppDataChannel the queue.
+ * @param[in] pMessage the message.
+ * @param[in] size the size of the message.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS sendAppDataChannelMessage(PAppDataChannel pAppDataChannel, PBYTE pMessage, UINT32 size);
+/**
+ * @brief send the queued batches in order. Each batch is sent out of the lock, so the producers keep queueing into the
+ *        next batches. A batch refused by the sdk stays at the head of the queue for the next flush.
+ *
+ * @param[in] pAppDataChannel the queue.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS if the queue is empty, or another flush is sending it.
+ */
+STATUS flushAppDataChannel(PAppDataChannel pAppDataChannel);
+/**
+ * @brief get the stats of the queue.
+ *
+ * @param[in] pAppDataChannel the queue.
+ * @param[out] pStats the stats.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getAppDataChannelStats(PAppDataChannel pAppDataChannel, PAppDataChannelStats pStats);
+/**
+ * @brief answer the pings on the probe channel, and report the pongs of the own pings to the hook.
+ *
+ * @param[in] pRtcDataChannel the probe channel.
+ * @param[in] hook the hook of the results.
+ * @param[in] udata the user data of the hook.
+ * @param[out] ppAppDataChannelProbe the probe.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS createAppDataChannelProbe(PRtcDataChannel pRtcDataChannel, AppDataChannelProbeHook hook, PVOID udata,
+                                 PAppDataChannelProbe* ppAppDataChannelProbe);
+/**
+ * @brief free the probe. The peer connection is freed first, so no message arrives after it.
+ *
+ * @param[in, out] ppAppDataChannelProbe the probe.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS freeAppDataChannelProbe(PAppDataChannelProbe* ppAppDataChannelProbe);
+/**
+ * @brief send a ping, its pong is reported to the hook.
+ *
+ * @param[in] pAppDataChannelProbe the probe.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS sendAppDataChannelProbe(PAppDataChannelProbe pAppDataChannelProbe);
+/**
+ * @brief record the last frame sent to the session, the next probe messages carry it.
+ *
+ * @param[in] pAppDataChannelProbe the probe.
+ * @param[in] framePts the pts of the frame in 100ns.
+ */
+VOID setAppDataChannelProbeFrame(PAppDataChannelProbe pAppDataChannelProbe, UINT64 framePts);
 
 #ifdef __cplusplus
 }
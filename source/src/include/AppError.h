@@ -51,6 +51,9 @@ extern "C" {
 #define STATUS_APP_CREDENTIAL_INVALID_MUTEX           STATUS_APP_CREDENTIAL_BASE + 0x0000000F
 #define STATUS_APP_CREDENTIAL_CERT_CREATE             STATUS_APP_CREDENTIAL_BASE + 0x00000010
 #define STATUS_APP_CREDENTIAL_CERT_STACK              STATUS_APP_CREDENTIAL_BASE + 0x00000011
+#define STATUS_APP_CREDENTIAL_INVALID_CVAR            STATUS_APP_CREDENTIAL_BASE + 0x00000012
+#define STATUS_APP_CREDENTIAL_CERT_WORKER             STATUS_APP_CREDENTIAL_BASE + 0x00000013
+#define STATUS_APP_CREDENTIAL_CERT_CACHE              STATUS_APP_CREDENTIAL_BASE + 0x00000014
 /** 0x73000000 */
 #define STATUS_MEDIA_BASE              STATUS_APP_BASE + 0x03000000
 #define STATUS_MEDIA_NULL_ARG          STATUS_MEDIA_BASE + 0x00000001
@@ -88,6 +91,10 @@ extern "C" {
 #define STATUS_MEDIA_PAD_REMOVED       STATUS_MEDIA_BASE + 0x00000021
 #define STATUS_MEDIA_BUS_ERROR         STATUS_MEDIA_BASE + 0x00000022
 #define STATUS_MEDIA_BUS_EOS           STATUS_MEDIA_BASE + 0x00000023
+#define STATUS_MEDIA_INVALID_CVAR      STATUS_MEDIA_BASE + 0x00000024
+#define STATUS_MEDIA_STALLED           STATUS_MEDIA_BASE + 0x00000026
+#define STATUS_MEDIA_WATCHDOG_THREAD   STATUS_MEDIA_BASE + 0x00000027
+#define STATUS_MEDIA_RTSP_TRACKS       STATUS_MEDIA_BASE + 0x00000028
 /** 0x74000000 */
 #define STATUS_APP_SIGNALING_BASE               STATUS_APP_BASE + 0x04000000
 #define STATUS_APP_SIGNALING_NULL_ARG           STATUS_APP_SIGNALING_BASE + 0x00000001
@@ -104,6 +111,10 @@ extern "C" {
 #define STATUS_APP_SIGNALING_RESTART            STATUS_APP_SIGNALING_BASE + 0x0000000C
 #define STATUS_APP_SIGNALING_SEND               STATUS_APP_SIGNALING_BASE + 0x0000000D
 #define STATUS_APP_SIGNALING_ICE_SERVER_COUNT   STATUS_APP_SIGNALING_BASE + 0x0000000E
+#define STATUS_APP_SIGNALING_SEND_QUEUE_FULL    STATUS_APP_SIGNALING_BASE + 0x0000000F
+#define STATUS_APP_SIGNALING_INVALID_CVAR       STATUS_APP_SIGNALING_BASE + 0x00000010
+#define STATUS_APP_SIGNALING_SENDER_THREAD      STATUS_APP_SIGNALING_BASE + 0x00000011
+#define STATUS_APP_SIGNALING_RECONNECT_THREAD   STATUS_APP_SIGNALING_BASE + 0x00000012
 /** 0x75000000 */
 #define STATUS_APP_WEBRTC_BASE   STATUS_APP_BASE + 0x05000000
 #define STATUS_APP_WEBRTC_INIT   STATUS_APP_WEBRTC_BASE + 0x00000001
@@ -116,6 +127,8 @@ extern "C" {
 #define STATUS_APP_METRICS_ICE_SERVER           STATUS_APP_METRICS_BASE + 0x00000004
 #define STATUS_APP_METRICS_LOCAL_ICE_CANDIDATE  STATUS_APP_METRICS_BASE + 0x00000005
 #define STATUS_APP_METRICS_REMOTE_ICE_CANDIDATE STATUS_APP_METRICS_BASE + 0x00000006
+#define STATUS_APP_METRICS_OUTBOUND_RTP         STATUS_APP_METRICS_BASE + 0x00000007
+#define STATUS_APP_METRICS_REMOTE_INBOUND_RTP   STATUS_APP_METRICS_BASE + 0x00000008
 /** 0x77000000 */
 #define STATUS_APP_MSGQ_BASE               STATUS_APP_BASE + 0x07000000
 #define STATUS_APP_MSGQ_NULL_ARG           STATUS_APP_MSGQ_BASE + 0x00000001
@@ -127,6 +140,77 @@ extern "C" {
 #define STATUS_APP_MSGQ_PUSH_PENDING_MSQ   STATUS_APP_MSGQ_BASE + 0x00000007
 #define STATUS_APP_MSGQ_EMPTY_PENDING_MSQ  STATUS_APP_MSGQ_BASE + 0x00000008
 #define STATUS_APP_MSGQ_POP_PENDING_MSQ    STATUS_APP_MSGQ_BASE + 0x00000009
+/** 0x78000000 */
+#define STATUS_APP_INTERFACE_FILTER_BASE           STATUS_APP_BASE + 0x08000000
+#define STATUS_APP_INTERFACE_FILTER_NULL_ARG       STATUS_APP_INTERFACE_FILTER_BASE + 0x00000001
+#define STATUS_APP_INTERFACE_FILTER_INVALID_RULE   STATUS_APP_INTERFACE_FILTER_BASE + 0x00000002
+#define STATUS_APP_INTERFACE_FILTER_TOO_MANY_RULES STATUS_APP_INTERFACE_FILTER_BASE + 0x00000003
+/** 0x79000000 */
+#define STATUS_APP_METRICS_REGISTRY_BASE              STATUS_APP_BASE + 0x09000000
+#define STATUS_APP_METRICS_REGISTRY_NULL_ARG          STATUS_APP_METRICS_REGISTRY_BASE + 0x00000001
+#define STATUS_APP_METRICS_REGISTRY_NOT_ENOUGH_MEMORY STATUS_APP_METRICS_REGISTRY_BASE + 0x00000002
+#define STATUS_APP_METRICS_REGISTRY_INVALID_MUTEX     STATUS_APP_METRICS_REGISTRY_BASE + 0x00000003
+#define STATUS_APP_METRICS_REGISTRY_INVALID_ARG       STATUS_APP_METRICS_REGISTRY_BASE + 0x00000004
+#define STATUS_APP_METRICS_REGISTRY_FULL              STATUS_APP_METRICS_REGISTRY_BASE + 0x00000005
+#define STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH     STATUS_APP_METRICS_REGISTRY_BASE + 0x00000006
+#define STATUS_APP_METRICS_REGISTRY_BUFFER_TOO_SMALL  STATUS_APP_METRICS_REGISTRY_BASE + 0x00000007
+#define STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT  STATUS_APP_METRICS_REGISTRY_BASE + 0x00000008
+#define STATUS_APP_METRICS_REGISTRY_SOCKET            STATUS_APP_METRICS_REGISTRY_BASE + 0x00000009
+#define STATUS_APP_METRICS_REGISTRY_EXPORTER_THREAD   STATUS_APP_METRICS_REGISTRY_BASE + 0x0000000A
+/** 0x7A000000 */
+#define STATUS_APP_LOCK_PROFILER_BASE      STATUS_APP_BASE + 0x0A000000
+#define STATUS_APP_LOCK_PROFILER_NULL_ARG  STATUS_APP_LOCK_PROFILER_BASE + 0x00000001
+#define STATUS_APP_LOCK_PROFILER_NOT_FOUND STATUS_APP_LOCK_PROFILER_BASE + 0x00000002
+/** 0x7B000000 */
+#define STATUS_APP_MEMORY_BASE            STATUS_APP_BASE + 0x0B000000
+#define STATUS_APP_MEMORY_NULL_ARG        STATUS_APP_MEMORY_BASE + 0x00000001
+#define STATUS_APP_MEMORY_INVALID_TAG     STATUS_APP_MEMORY_BASE + 0x00000002
+#define STATUS_APP_MEMORY_INITIALIZED     STATUS_APP_MEMORY_BASE + 0x00000003
+#define STATUS_APP_MEMORY_NOT_INITIALIZED STATUS_APP_MEMORY_BASE + 0x00000004
+#define STATUS_APP_MEMORY_BLOCKS_LIVE     STATUS_APP_MEMORY_BASE + 0x00000005
+#define STATUS_APP_MEMORY_NO_SESSION_SLOT STATUS_APP_MEMORY_BASE + 0x00000006
+#define STATUS_APP_MEMORY_INVALID_SESSION STATUS_APP_MEMORY_BASE + 0x00000007
+/** 0x7C000000 */
+#define STATUS_APP_TRACE_BASE              STATUS_APP_BASE + 0x0C000000
+#define STATUS_APP_TRACE_DISABLED          STATUS_APP_TRACE_BASE + 0x00000001
+#define STATUS_APP_TRACE_PATH_TOO_LONG     STATUS_APP_TRACE_BASE + 0x00000002
+#define STATUS_APP_TRACE_NOT_ENOUGH_MEMORY STATUS_APP_TRACE_BASE + 0x00000003
+#define STATUS_APP_TRACE_OPEN_FILE         STATUS_APP_TRACE_BASE + 0x00000004
+#define STATUS_APP_TRACE_WRITE_FILE        STATUS_APP_TRACE_BASE + 0x00000005
+/** 0x7D000000 */
+#define STATUS_APP_DATA_CHANNEL_BASE              STATUS_APP_BASE + 0x0D000000
+#define STATUS_APP_DATA_CHANNEL_NULL_ARG          STATUS_APP_DATA_CHANNEL_BASE + 0x00000001
+#define STATUS_APP_DATA_CHANNEL_NOT_ENOUGH_MEMORY STATUS_APP_DATA_CHANNEL_BASE + 0x00000002
+#define STATUS_APP_DATA_CHANNEL_INVALID_MUTEX     STATUS_APP_DATA_CHANNEL_BASE + 0x00000003
+#define STATUS_APP_DATA_CHANNEL_MESSAGE_TOO_LARGE STATUS_APP_DATA_CHANNEL_BASE + 0x00000004
+#define STATUS_APP_DATA_CHANNEL_BACKPRESSURE      STATUS_APP_DATA_CHANNEL_BASE + 0x00000005
+#define STATUS_APP_DATA_CHANNEL_SEND              STATUS_APP_DATA_CHANNEL_BASE + 0x00000006
+/** 0x7E000000 */
+#define STATUS_APP_REPLAY_BASE              STATUS_APP_BASE + 0x0E000000
+#define STATUS_APP_REPLAY_NULL_ARG          STATUS_APP_REPLAY_BASE + 0x00000001
+#define STATUS_APP_REPLAY_NOT_ENOUGH_MEMORY STATUS_APP_REPLAY_BASE + 0x00000002
+#define STATUS_APP_REPLAY_INVALID_MUTEX     STATUS_APP_REPLAY_BASE + 0x00000003
+#define STATUS_APP_REPLAY_INVALID_ARG       STATUS_APP_REPLAY_BASE + 0x00000004
+#define STATUS_APP_REPLAY_FRAME_TOO_LARGE   STATUS_APP_REPLAY_BASE + 0x00000005
+#define STATUS_APP_REPLAY_OVERRUN           STATUS_APP_REPLAY_BASE + 0x00000006
+/** 0x7F000000 */
+#define STATUS_APP_RECORDER_BASE              STATUS_APP_BASE + 0x0F000000
+#define STATUS_APP_RECORDER_NULL_ARG          STATUS_APP_RECORDER_BASE + 0x00000001
+#define STATUS_APP_RECORDER_NOT_ENOUGH_MEMORY STATUS_APP_RECORDER_BASE + 0x00000002
+#define STATUS_APP_RECORDER_INVALID_ARG       STATUS_APP_RECORDER_BASE + 0x00000003
+#define STATUS_APP_RECORDER_OPEN_FILE         STATUS_APP_RECORDER_BASE + 0x00000004
+#define STATUS_APP_RECORDER_WRITE_FILE        STATUS_APP_RECORDER_BASE + 0x00000005
+#define STATUS_APP_RECORDER_WRITER_THREAD     STATUS_APP_RECORDER_BASE + 0x00000006
+/** 0x70100000 */
+#define STATUS_APP_PACER_BASE              STATUS_APP_BASE + 0x00100000
+#define STATUS_APP_PACER_NULL_ARG          STATUS_APP_PACER_BASE + 0x00000001
+#define STATUS_APP_PACER_NOT_ENOUGH_MEMORY STATUS_APP_PACER_BASE + 0x00000002
+#define STATUS_APP_PACER_INVALID_MUTEX     STATUS_APP_PACER_BASE + 0x00000003
+#define STATUS_APP_PACER_INVALID_CVAR      STATUS_APP_PACER_BASE + 0x00000004
+#define STATUS_APP_PACER_INVALID_ARG       STATUS_APP_PACER_BASE + 0x00000005
+#define STATUS_APP_PACER_TOO_MANY_FLOWS    STATUS_APP_PACER_BASE + 0x00000006
+#define STATUS_APP_PACER_QUEUE_FULL        STATUS_APP_PACER_BASE + 0x00000007
+#define STATUS_APP_PACER_THREAD            STATUS_APP_PACER_BASE + 0x00000008
 
 #ifdef __cplusplus
 }
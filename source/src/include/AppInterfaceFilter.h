@@ -0,0 +1,97 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_INTERFACE_FILTER_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_INTERFACE_FILTER_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+#include "AppConfig.h"
+#include "AppError.h"
+
+typedef struct {
+    CHAR pattern[APP_INTERFACE_FILTER_PATTERN_LEN + 1]; //!< the glob of the interface name, or the original text of the cidr.
+    BOOL isCidr;                                        //!< the rule is a cidr instead of a glob.
+    INT32 family;                                       //!< AF_INET or AF_INET6 for the cidr.
+    BYTE address[16];                                   //!< the network address of the cidr.
+    UINT32 prefixLen;                                   //!< the prefix length of the cidr.
+} AppInterfaceRule, *PAppInterfaceRule;
+
+typedef struct {
+    BOOL enabled; //!< FALSE if there is no rule, so the sdk uses all the interfaces.
+    AppInterfaceRule allowRules[APP_INTERFACE_FILTER_MAX_RULES];
+    UINT32 allowCount;
+    AppInterfaceRule denyRules[APP_INTERFACE_FILTER_MAX_RULES];
+    UINT32 denyCount;
+} AppInterfaceFilter, *PAppInterfaceFilter;
+
+typedef struct {
+    PAppInterfaceFilter pInterfaceFilter; //!< the rules shared by all the sessions.
+    PVOID pIfAddrs;                       //!< the snapshot of the interface addresses, loaded on the first cidr rule.
+    UINT32 candidateCount;                //!< the number of host addresses offered by the sdk.
+    UINT32 acceptedCount;                 //!< the number of host addresses accepted by the filter.
+} AppInterfaceFilterSession, *PAppInterfaceFilterSession;
+/**
+ * @brief initialize the interface filter from the environment variables. Each of the allow and deny lists is a comma separated
+ *        list of interface name globs, e.g. "eth*", and cidrs, e.g. "10.0.0.0/8". A cidr matches an interface which has an address
+ *        in it. An interface is used if it matches the allow list, or the allow list is empty, and it does not match the deny list.
+ *
+ * @param[in] pInterfaceFilter the context of the interface filter.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS initAppInterfaceFilter(PAppInterfaceFilter pInterfaceFilter);
+/**
+ * @brief parse the allow and deny lists.
+ *
+ * @param[in] pInterfaceFilter the context of the interface filter.
+ * @param[in] pAllowList the allow list, NULL or empty for no rule.
+ * @param[in] pDenyList the deny list, NULL or empty for no rule.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS setAppInterfaceFilterRules(PAppInterfaceFilter pInterfaceFilter, PCHAR pAllowList, PCHAR pDenyList);
+/**
+ * @brief prepare the filter of one peer connection.
+ *
+ * @param[in] pFilterSession the context of the filter of the peer connection.
+ * @param[in] pInterfaceFilter the context of the interface filter.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS initAppInterfaceFilterSession(PAppInterfaceFilterSession pFilterSession, PAppInterfaceFilter pInterfaceFilter);
+/**
+ * @brief release the filter of one peer connection.
+ *
+ * @param[in] pFilterSession the context of the filter of the peer connection.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS freeAppInterfaceFilterSession(PAppInterfaceFilterSession pFilterSession);
+/**
+ * @brief the callback of IceSetInterfaceFilterFunc. The sdk calls it for each address of each interface.
+ *
+ * @param[in] customData the context of the filter of the peer connection.
+ * @param[in] pInterfaceName the name of the interface.
+ *
+ * @return TRUE if the interface can be used.
+ */
+BOOL appInterfaceFilterFunc(UINT64 customData, PCHAR pInterfaceName);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_INTERFACE_FILTER_INCLUDE__ */
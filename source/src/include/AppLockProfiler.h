@@ -0,0 +1,122 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_LOCK_PROFILER_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_LOCK_PROFILER_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+#include "AppConfig.h"
+#include "AppError.h"
+#include "AppMetricsRegistry.h"
+
+/**
+ * The hot locks are taken through these macros. With APP_LOCK_PROFILING they record the wait and hold times per lock, and
+ * the wait per call site. Otherwise they are the plain MUTEX_LOCK, MUTEX_UNLOCK and CVAR_WAIT.
+ */
+#ifdef APP_LOCK_PROFILING
+#define APP_MUTEX_LOCK(m)      appLockProfilerLock((m), (PCHAR) #m, (PCHAR) __FUNCTION__, __LINE__)
+#define APP_MUTEX_UNLOCK(m)    appLockProfilerUnlock((m))
+#define APP_CVAR_WAIT(c, m, t) appLockProfilerWait((c), (m), (PCHAR) #m, (t))
+#else
+#define APP_MUTEX_LOCK(m)      MUTEX_LOCK(m)
+#define APP_MUTEX_UNLOCK(m)    MUTEX_UNLOCK(m)
+#define APP_CVAR_WAIT(c, m, t) CVAR_WAIT(c, m, t)
+#endif
+
+typedef struct {
+    PCHAR pFunction; //!< the function taking the lock, a static string.
+    UINT32 line;     //!< the line taking the lock.
+    UINT64 count;    //!< the number of acquisitions.
+    UINT64 waitTime; //!< the total wait in 100ns.
+    UINT64 maxWait;  //!< the longest wait in 100ns.
+} AppLockSite, *PAppLockSite;
+
+typedef struct {
+    volatile SIZE_T key;                                   //!< the profiled mutex, 0 for a free slot.
+    volatile ATOMIC_BOOL ready;                            //!< the slot is initialized.
+    CHAR name[APP_LOCK_PROFILER_NAME_LEN + 1];             //!< the name of the lock, e.g. appConfigurationObjLock.
+    UINT64 acquireCount;                                   //!< the number of acquisitions.
+    UINT64 contendedCount;                                 //!< the number of acquisitions which waited for another owner.
+    UINT64 waitTime;                                       //!< the total wait in 100ns.
+    UINT64 maxWait;                                        //!< the longest wait in 100ns.
+    UINT64 holdCount;                                      //!< the number of releases of the outermost acquisition.
+    UINT64 holdTime;                                       //!< the total hold time in 100ns.
+    UINT64 maxHold;                                        //!< the longest hold in 100ns.
+    UINT64 waitBuckets[APP_LOCK_PROFILER_BUCKET_COUNT];    //!< the waits per power of two microseconds.
+    UINT64 holdBuckets[APP_LOCK_PROFILER_BUCKET_COUNT];    //!< the hold times per power of two microseconds.
+    UINT32 depth;                                          //!< the recursion depth of the owner.
+    UINT64 acquireTime;                                    //!< the time the owner took the lock.
+    UINT32 siteCount;                                      //!< the number of call sites.
+    UINT32 droppedSiteCount;                               //!< the acquisitions of the call sites beyond the table.
+    AppLockSite sites[APP_LOCK_PROFILER_MAX_SITES];        //!< the call sites.
+} AppLockStats, *PAppLockStats;
+/**
+ * @brief lock the mutex, recording the wait of this call site and the start of the hold. The stats of a lock are only
+ *        updated by its owner, so they need no other lock.
+ *
+ * @param[in] mutex the mutex.
+ * @param[in] pName the expression of the mutex, the name of the lock is the part after the last member access.
+ * @param[in] pFunction the function taking the lock, a static string.
+ * @param[in] line the line taking the lock.
+ */
+VOID appLockProfilerLock(MUTEX mutex, PCHAR pName, PCHAR pFunction, UINT32 line);
+/**
+ * @brief unlock the mutex, recording the hold time when the outermost acquisition is released.
+ *
+ * @param[in] mutex the mutex.
+ */
+VOID appLockProfilerUnlock(MUTEX mutex);
+/**
+ * @brief wait for the condition variable. The mutex is released during the wait, so the hold ends before it and starts
+ *        again after it. The wait for the condition is not counted as contention.
+ *
+ * @param[in] cvar the condition variable.
+ * @param[in] mutex the mutex.
+ * @param[in] pName the expression of the mutex.
+ * @param[in] timeout the timeout of the wait.
+ *
+ * @return STATUS code of CVAR_WAIT.
+ */
+STATUS appLockProfilerWait(CVAR cvar, MUTEX mutex, PCHAR pName, UINT64 timeout);
+/**
+ * @brief get the stats of a profiled lock. The stats are read while the owner may update them, so they are approximate.
+ *
+ * @param[in] mutex the mutex.
+ * @param[out] ppStats the stats.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getAppLockStats(MUTEX mutex, PAppLockStats* ppStats);
+/**
+ * @brief log the wait and hold percentiles of every profiled lock, and the call sites which waited the longest.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS dumpAppLockProfile();
+/**
+ * @brief export the lock profile to the metrics registry, with the name of the lock as the lock label.
+ *
+ * @param[in] pRegistry the registry.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS exportAppLockProfile(PAppMetricsRegistry pRegistry);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_LOCK_PROFILER_INCLUDE__ */
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_MEMORY_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_MEMORY_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+#include "AppConfig.h"
+#include "AppError.h"
+#include "AppMetricsRegistry.h"
+
+/**
+ * The subsystem an allocation is charged to. A thread charges its allocations to its current tag, and the threads which never
+ * set one, e.g. the threads of the sdk, are charged to APP_MEMORY_TAG_SDK.
+ */
+typedef enum {
+    APP_MEMORY_TAG_SDK,           //!< the internals of the sdk.
+    APP_MEMORY_TAG_APP,           //!< the configuration of the app and its metrics.
+    APP_MEMORY_TAG_SIGNALING,     //!< the signaling client, its send queue and its reconnect thread.
+    APP_MEMORY_TAG_PENDING_QUEUE, //!< the signaling messages pending for their sessions.
+    APP_MEMORY_TAG_SESSION,       //!< the streaming sessions and their peer connections.
+    APP_MEMORY_TAG_CERTIFICATE,   //!< the generated and cached certificates.
+    APP_MEMORY_TAG_MEDIA,         //!< the media source and the frames written to the sessions.
+    APP_MEMORY_TAG_COUNT,
+} APP_MEMORY_TAG;
+
+/**
+ * The session an allocation is charged to besides its subsystem. A thread charges its allocations to its current session,
+ * which the app sets while it works for a session, including in the callbacks the sdk calls with the session.
+ */
+#define APP_MEMORY_NO_SESSION 0
+
+typedef struct {
+    volatile SIZE_T liveBytes;  //!< the bytes allocated and not yet freed.
+    volatile SIZE_T allocCount; //!< the number of allocations.
+    volatile SIZE_T allocBytes; //!< the bytes of all the allocations.
+    volatile SIZE_T freeCount;  //!< the number of frees.
+    SIZE_T lastAllocBytes;      //!< allocBytes of the last report.
+    UINT64 lastReportTime;      //!< the time of the last report.
+    DOUBLE allocRate;           //!< the bytes allocated per second between the last two reports.
+} AppMemoryStats, *PAppMemoryStats;
+/**
+ * @brief chain the tagged allocators in front of the current allocators, e.g. the instrumented allocators of main. It must
+ *        be called before the first allocation to account, since a block is freed through the allocators which allocated it.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS initAppMemory();
+/**
+ * @brief restore the allocators replaced by initAppMemory. A block carries the header of the tagged allocators, so while any
+ *        is live the allocators stay installed for the rest of the process, and the live bytes are logged per subsystem. It
+ *        must be called once the other threads stop allocating.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success, STATUS_APP_MEMORY_BLOCKS_LIVE if the allocators stay.
+ */
+STATUS deinitAppMemory();
+/**
+ * @brief charge the following allocations of the calling thread to the tag.
+ *
+ * @param[in] tag the subsystem.
+ *
+ * @return the previous tag of the calling thread, to restore it.
+ */
+APP_MEMORY_TAG setAppMemoryTag(APP_MEMORY_TAG tag);
+/**
+ * @brief allocate zeroed memory charged to the tag, whatever the current tag of the calling thread.
+ *
+ * @param[in] tag the subsystem.
+ * @param[in] num the number of elements.
+ * @param[in] size the size of an element.
+ *
+ * @return the memory, NULL if it runs out of memory.
+ */
+PVOID callocAppMemory(APP_MEMORY_TAG tag, SIZE_T num, SIZE_T size);
+/**
+ * @brief take the accounting slot of a new session. A slot is reused once the session before frees all its blocks.
+ *
+ * @param[out] pSessionId the id of the session, APP_MEMORY_NO_SESSION if it fails.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS openAppMemorySession(PUINT32 pSessionId);
+/**
+ * @brief give back the slot of a closed session, logging the bytes it still holds.
+ *
+ * @param[in] sessionId the id of the session, APP_MEMORY_NO_SESSION is ignored.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS closeAppMemorySession(UINT32 sessionId);
+/**
+ * @brief charge the following allocations of the calling thread to the session, on top of its tag.
+ *
+ * @param[in] sessionId the id of the session, APP_MEMORY_NO_SESSION for none.
+ *
+ * @return the previous session of the calling thread, to restore it.
+ */
+UINT32 setAppMemorySession(UINT32 sessionId);
+/**
+ * @brief get the stats of a session.
+ *
+ * @param[in] sessionId the id of the session.
+ * @param[out] ppStats the stats.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getAppMemorySessionStats(UINT32 sessionId, PAppMemoryStats* ppStats);
+/**
+ * @brief get the stats of a subsystem.
+ *
+ * @param[in] tag the subsystem.
+ * @param[out] ppStats the stats.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getAppMemoryStats(APP_MEMORY_TAG tag, PAppMemoryStats* ppStats);
+/**
+ * @brief update the allocation rates, log the live bytes and the rate of every subsystem and the live bytes of the open
+ *        sessions, and export the subsystems to the registry with the subsystem label.
+ *
+ * @param[in] pRegistry the registry, NULL to only log.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS reportAppMemory(PAppMetricsRegistry pRegistry);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_MEMORY_INCLUDE__ */
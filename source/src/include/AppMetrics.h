@@ -23,12 +23,39 @@ extern "C" {
 #include "AppConfig.h"
 #include "AppError.h"
 
+typedef struct {
+    UINT64 packetsSent;              //!< the rtp packets sent.
+    UINT64 bytesSent;                //!< the rtp payload bytes sent.
+    UINT64 retransmittedPacketsSent; //!< the packets retransmitted for the nacks.
+    UINT64 retransmittedBytesSent;   //!< the bytes retransmitted for the nacks.
+    UINT64 nackCount;                //!< the nacks received from the viewer.
+    UINT64 pliCount;                 //!< the picture loss indications received from the viewer.
+    UINT64 firCount;                 //!< the full intra requests received from the viewer.
+    INT64 packetsLost;               //!< the packets lost, reported by the receiver reports of the viewer.
+    DOUBLE fractionLost;             //!< the fraction lost of the latest receiver report, from 0 to 1.
+    DOUBLE jitter;                   //!< the interarrival jitter in seconds.
+    DOUBLE roundTripTime;            //!< the round trip time in seconds, computed from the receiver reports.
+    BOOL remoteReported;             //!< a receiver report of the viewer is received.
+} AppRtpQualityStats, *PAppRtpQualityStats;
+
 UINT32 getLogLevel(VOID);
 STATUS setupFileLogging(PBOOL pEnable);
 STATUS closeFileLogging(VOID);
+STATUS getIceServerStats(PRtcPeerConnection pRtcPeerConnection, UINT32 index, PRtcIceServerStats pRtcIceServerStats);
 STATUS logIceServerStats(PRtcPeerConnection pRtcPeerConnection, UINT32 index);
 STATUS logSelectedIceCandidatesInformation(PRtcPeerConnection pRtcPeerConnection);
 STATUS logSignalingClientStats(PSignalingClientMetrics pSignalingClientMetrics);
+/**
+ * @brief gather the outbound and remote inbound rtp stats of the transceiver. The counters are added to pQualityStats and the worst
+ *        loss, jitter and round trip time are kept, so the transceivers of a session can be combined.
+ *
+ * @param[in] pRtcPeerConnection the peer connection.
+ * @param[in] pRtcRtpTransceiver the transceiver.
+ * @param[in, out] pQualityStats the stats of the rtp streams.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getRtpQualityStats(PRtcPeerConnection pRtcPeerConnection, PRtcRtpTransceiver pRtcRtpTransceiver, PAppRtpQualityStats pQualityStats);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_METRICS_REGISTRY_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_METRICS_REGISTRY_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+#include "AppConfig.h"
+#include "AppError.h"
+
+typedef enum {
+    APP_METRIC_TYPE_COUNTER,   //!< the value only goes up, e.g. the number of bytes sent.
+    APP_METRIC_TYPE_GAUGE,     //!< the value goes up and down, e.g. the bitrate.
+    APP_METRIC_TYPE_HISTOGRAM, //!< the distribution of the observations over the buckets.
+    APP_METRIC_TYPE_SUMMARY,   //!< the quantiles of the observations, from a log-linear histogram.
+} APP_METRIC_TYPE;
+
+typedef struct {
+    BOOL used;                                        //!< the slot is taken.
+    APP_METRIC_TYPE type;                             //!< the type of the metric.
+    CHAR name[APP_METRICS_NAME_LEN + 1];              //!< the name of the metric family, e.g. webrtc_app_sessions.
+    PCHAR pHelp;                                      //!< the description of the metric family, a static string.
+    CHAR labels[APP_METRICS_LABELS_LEN + 1];          //!< the rendered labels, e.g. channel="c",session="s".
+    DOUBLE value;                                     //!< the value of the counter or gauge.
+    UINT32 boundCount;                                //!< the number of upper bounds of the histogram.
+    DOUBLE bounds[APP_METRICS_MAX_BUCKETS];           //!< the ascending upper bounds of the buckets.
+    UINT64 bucketCounts[APP_METRICS_MAX_BUCKETS + 1]; //!< the observations per bucket, the last one is +Inf.
+    UINT64 count;                                     //!< the number of observations.
+    DOUBLE sum;                                       //!< the sum of observations.
+    PUINT32 pHdrCounts;                               //!< the log-linear buckets of the summary, APP_METRICS_HDR_BUCKET_COUNT of them.
+    UINT32 generation;                                //!< bumped when the slot is removed, the ids of the old metric are refused.
+} AppMetric, *PAppMetric;
+
+typedef struct {
+    MUTEX lock;                                        //!< protect the slots, the values are updated with atomics.
+    CHAR channel[MAX_CHANNEL_NAME_LEN + 1];            //!< the channel label of all the metrics.
+    AppMetric metrics[APP_METRICS_REGISTRY_MAX_COUNT]; //!< the metrics in the order of registration.
+    UINT32 metricCount;                                //!< the number of slots ever used.
+    INT32 listenFd;                                    //!< the listening socket of the exporter, -1 if it is not started.
+    CHAR unixPath[MAX_PATH_LEN + 1];                   //!< the path of the unix socket, empty for tcp.
+    TID exporterTid;                                   //!< the thread serving the scrapes.
+    volatile ATOMIC_BOOL terminateExporter;            //!< stop the exporter thread.
+} AppMetricsRegistry, *PAppMetricsRegistry;
+/**
+ * @brief create the registry of the metrics of one channel.
+ *
+ * @param[in] pChannel the name of the channel, added as the channel label of every metric.
+ * @param[out] ppRegistry the registry.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS createAppMetricsRegistry(PCHAR pChannel, PAppMetricsRegistry* ppRegistry);
+/**
+ * @brief stop the exporter and free the registry.
+ *
+ * @param[in, out] ppRegistry the registry.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS freeAppMetricsRegistry(PAppMetricsRegistry* ppRegistry);
+/**
+ * @brief register a metric, or look up the one registered with the same name and labels.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[in] pName the name of the metric family.
+ * @param[in] pHelp the description of the metric family. It must outlive the registry.
+ * @param[in] type the type of the metric.
+ * @param[in] pLabelName the name of the label besides the channel, e.g. session. NULL for none.
+ * @param[in] pLabelValue the value of the label.
+ * @param[in] pBounds the ascending upper bounds of the histogram. NULL for the other types.
+ * @param[in] boundCount the number of upper bounds, up to APP_METRICS_MAX_BUCKETS.
+ * @param[out] pMetricId the id of the metric, the slot and its generation. The id is refused once the metric is removed.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS registerAppMetric(PAppMetricsRegistry pRegistry, PCHAR pName, PCHAR pHelp, APP_METRIC_TYPE type, PCHAR pLabelName, PCHAR pLabelValue,
+                         PDOUBLE pBounds, UINT32 boundCount, PUINT32 pMetricId);
+/**
+ * @brief set the value of a counter or gauge.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[in] metricId the id of the metric.
+ * @param[in] value the new value.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS setAppMetric(PAppMetricsRegistry pRegistry, UINT32 metricId, DOUBLE value);
+/**
+ * @brief add to the value of a counter or gauge.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[in] metricId the id of the metric.
+ * @param[in] delta the increment, it can not be negative for the counter.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS addAppMetric(PAppMetricsRegistry pRegistry, UINT32 metricId, DOUBLE delta);
+/**
+ * @brief add an observation to a histogram or summary. The summary keeps the observations at the precision of
+ *        APP_METRICS_HDR_UNIT, e.g. the latencies in seconds at the microsecond. Like setAppMetric and addAppMetric, it
+ *        does not take the lock of the registry, so the caller must not remove the metric meanwhile.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[in] metricId the id of the metric.
+ * @param[in] value the observation.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS observeAppMetric(PAppMetricsRegistry pRegistry, UINT32 metricId, DOUBLE value);
+/**
+ * @brief register a gauge and set it in one go, for the values collected periodically.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[in] pName the name of the metric family.
+ * @param[in] pHelp the description of the metric family.
+ * @param[in] pLabelName the name of the label besides the channel. NULL for none.
+ * @param[in] pLabelValue the value of the label.
+ * @param[in] value the new value.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS setAppGauge(PAppMetricsRegistry pRegistry, PCHAR pName, PCHAR pHelp, PCHAR pLabelName, PCHAR pLabelValue, DOUBLE value);
+/**
+ * @brief remove all the metrics carrying the label, e.g. the ones of a closed session.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[in] pLabelName the name of the label.
+ * @param[in] pLabelValue the value of the label.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS removeAppMetrics(PAppMetricsRegistry pRegistry, PCHAR pLabelName, PCHAR pLabelValue);
+/**
+ * @brief get a quantile of a summary.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[in] metricId the id of the metric.
+ * @param[in] quantile the quantile, from 0 to 1.
+ * @param[out] pValue the value of the quantile, the upper end of its bucket. 0 if there is no observation.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getAppMetricQuantile(PAppMetricsRegistry pRegistry, UINT32 metricId, DOUBLE quantile, PDOUBLE pValue);
+/**
+ * @brief render the metrics in the prometheus text format.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[out] pBuffer the buffer of the text. NULL to query the size.
+ * @param[in, out] pBufferLen the size of the buffer, and the size of the text including the null terminator.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS renderAppMetrics(PAppMetricsRegistry pRegistry, PCHAR pBuffer, PUINT32 pBufferLen);
+/**
+ * @brief serve the metrics over http on a local endpoint. The endpoint is "unix:<path>" for a unix socket, or
+ *        "[<ip>:]<port>" for tcp, bound to the loopback address by default. Any GET of / or /metrics gets the metrics.
+ *
+ * @param[in] pRegistry the registry.
+ * @param[in] pEndpoint the endpoint.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS startAppMetricsExporter(PAppMetricsRegistry pRegistry, PCHAR pEndpoint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_METRICS_REGISTRY_INCLUDE__ */
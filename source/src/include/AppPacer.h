@@ -0,0 +1,193 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_PACER_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_PACER_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+#include "AppConfig.h"
+#include "AppError.h"
+
+/**
+ * The pacer takes writeFrame off the media thread and works per frame, not per packet. The sdk packetizes a frame and sends
+ * all of its packets inside writeFrame, so a key frame still leaves as one burst of packets on its session. The pacer only
+ * decides when each frame of each session is written. Each session is a flow with a token bucket of bytes refilled at its
+ * rate, and a frame is written when the bucket of its flow is not in debt. The bucket holds a fraction of the frame interval,
+ * so a large key frame puts its flow in debt and the next frames of that flow wait for the refill, while the frames of the
+ * other flows are written in between. A key frame comes to all the flows at once, so the flows also share a bucket refilled
+ * at the sum of their rates. It spaces the copies of the key frame between the sessions, one writeFrame after the other,
+ * instead of all of them back to back.
+ */
+/**
+ * @brief write a frame of the flow.
+ *
+ * @param[in] udata the user data of the flow.
+ * @param[in] pFrame the frame, its data is valid until the writer returns.
+ * @param[in] entryTime the time the frame entered the app, in 100ns.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+typedef STATUS (*AppPacerWriter)(PVOID udata, PFrame pFrame, UINT64 entryTime);
+
+/**
+ * A frame shared by the flows, the data is copied once for all of them.
+ */
+typedef struct {
+    volatile SIZE_T refCount; //!< the producer and the queues of the flows.
+    Frame frame;              //!< the frame, its data follows this structure.
+    UINT64 entryTime;         //!< the time the frame entered the app.
+} AppPacerFrame, *PAppPacerFrame;
+
+typedef struct {
+    PAppPacerFrame pPacerFrame; //!< the shared frame.
+    UINT32 index;               //!< the index of the frame in the flow.
+    UINT64 queuedTime;          //!< the time the frame is queued.
+} AppPacerEntry, *PAppPacerEntry;
+
+typedef struct {
+    UINT64 framesQueued;  //!< the frames queued to the flow.
+    UINT64 framesSent;    //!< the frames written.
+    UINT64 framesDropped; //!< the frames refused by a full queue.
+    UINT64 framesLate;    //!< the frames written over the budget because they waited for APP_PACER_MAX_DELAY.
+    UINT64 bytesSent;     //!< the bytes written.
+    UINT64 queuedBytes;   //!< the bytes in the queue.
+    UINT64 queueDelay;    //!< the time the last written frame waited in the queue, in 100ns.
+    DOUBLE rate;          //!< the pacing rate in bytes per second.
+} AppPacerFlowStats, *PAppPacerFlowStats;
+
+typedef struct {
+    AppPacerWriter writer;                      //!< the writer of the frames.
+    PVOID udata;                                //!< the user data of the writer.
+    AppPacerEntry queue[APP_PACER_QUEUE_DEPTH]; //!< the ring of the frames waiting for the budget.
+    UINT32 head;                                //!< the oldest frame.
+    UINT32 count;                               //!< the frames in the ring.
+    DOUBLE tokens;                              //!< the bytes the flow may write now, negative in debt.
+    UINT64 refillTime;                          //!< the time the tokens are refilled.
+    AppPacerFlowStats stats;                    //!< protected by the lock of the pacer.
+} AppPacerFlow, *PAppPacerFlow;
+
+typedef struct {
+    MUTEX lock;                               //!< protect the flows.
+    CVAR cvar;                                //!< wake the pacer for a new frame, and the removers after a write.
+    TID pacerTid;                             //!< the thread of the writes.
+    volatile ATOMIC_BOOL terminatePacer;      //!< stop the pacer.
+    UINT32 ratePercent;                       //!< the pacing rate in percent of the rates of the flows.
+    PAppPacerFlow flows[APP_PACER_MAX_FLOWS]; //!< the flows.
+    UINT32 flowCount;                         //!< the number of flows.
+    UINT32 cursor;                            //!< the flow checked first, it rotates for the fairness.
+    PAppPacerFlow pWritingFlow;               //!< the flow written out of the lock now.
+    DOUBLE rate;                              //!< the rate of the shared bucket, the sum of the rates of the flows.
+    DOUBLE tokens;                            //!< the bytes the flows together may write now, negative in debt.
+    UINT64 refillTime;                        //!< the time the shared tokens are refilled.
+    UINT64 frameInterval;                     //!< the duration of the last video frame in 100ns, 0 before the first one.
+} AppPacer, *PAppPacer;
+
+/**
+ * @brief create the pacer and start its thread.
+ *
+ * @param[in] ratePercent the pacing rate in percent of the bitrate of each flow, e.g. 250 paces at 2.5 times the estimate.
+ * @param[out] ppAppPacer the pacer.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS createAppPacer(UINT32 ratePercent, PAppPacer* ppAppPacer);
+/**
+ * @brief stop the thread and free the pacer. The flows must be removed.
+ *
+ * @param[in, out] ppAppPacer the pacer.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS freeAppPacer(PAppPacer* ppAppPacer);
+/**
+ * @brief add a flow, it starts at APP_SESSION_SEND_BUDGET_MAX until its rate is set.
+ *
+ * @param[in] pAppPacer the pacer.
+ * @param[in] writer the writer of the frames.
+ * @param[in] udata the user data of the writer.
+ * @param[out] ppAppPacerFlow the flow.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS addAppPacerFlow(PAppPacer pAppPacer, AppPacerWriter writer, PVOID udata, PAppPacerFlow* ppAppPacerFlow);
+/**
+ * @brief remove a flow, the frames in its queue are dropped. It waits for the write of the flow in progress, so the user data
+ *        of the writer can be freed when it returns.
+ *
+ * @param[in] pAppPacer the pacer.
+ * @param[in, out] ppAppPacerFlow the flow.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS removeAppPacerFlow(PAppPacer pAppPacer, PAppPacerFlow* ppAppPacerFlow);
+/**
+ * @brief set the bandwidth estimate of a flow.
+ *
+ * @param[in] pAppPacer the pacer.
+ * @param[in] pAppPacerFlow the flow.
+ * @param[in] bitrate the estimate in bits per second.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS setAppPacerFlowBitrate(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, DOUBLE bitrate);
+/**
+ * @brief copy a frame for the flows. The caller releases its reference after the frame is queued.
+ *
+ * @param[in] pAppPacer the pacer.
+ * @param[in] pFrame the frame.
+ * @param[in] entryTime the time the frame entered the app.
+ * @param[out] ppAppPacerFrame the shared frame.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS createAppPacerFrame(PAppPacer pAppPacer, PFrame pFrame, UINT64 entryTime, PAppPacerFrame* ppAppPacerFrame);
+/**
+ * @brief drop a reference of the shared frame, the last one frees it.
+ *
+ * @param[in, out] ppAppPacerFrame the shared frame.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS releaseAppPacerFrame(PAppPacerFrame* ppAppPacerFrame);
+/**
+ * @brief queue a frame to a flow.
+ *
+ * @param[in] pAppPacer the pacer.
+ * @param[in] pAppPacerFlow the flow.
+ * @param[in] pAppPacerFrame the shared frame.
+ * @param[in] index the index of the frame in the flow.
+ *
+ * @return STATUS code of the execution. STATUS_APP_PACER_QUEUE_FULL if the frame is dropped, the flow should skip to the
+ *         next key frame.
+ */
+STATUS queueAppPacerFrame(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, PAppPacerFrame pAppPacerFrame, UINT32 index);
+/**
+ * @brief get the statistics of a flow.
+ *
+ * @param[in] pAppPacer the pacer.
+ * @param[in] pAppPacerFlow the flow.
+ * @param[out] pStats the statistics.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getAppPacerFlowStats(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, PAppPacerFlowStats pStats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_PACER_INCLUDE__ */
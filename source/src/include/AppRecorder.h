@@ -0,0 +1,105 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_RECORDER_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_RECORDER_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+#include "AppConfig.h"
+#include "AppError.h"
+#include "AppReplay.h"
+
+/**
+ * The recorder writes the frames into Matroska segments of <directory>/<utc time>-<index>.mkv. A segment is written as
+ * <name>.mkv.part and renamed when it is closed, it starts with a video key frame and it is rotated on the first key frame
+ * over the size or the duration of the segment. The video is track 1 and the audio is track 2.
+ */
+#define APP_RECORDER_TRACK_VIDEO 1
+#define APP_RECORDER_TRACK_AUDIO 2
+
+typedef struct {
+    CHAR directory[MAX_PATH_LEN + 1]; //!< the directory of the segments.
+    RTC_CODEC videoCodec;             //!< the codec of the video track.
+    RTC_CODEC audioCodec;             //!< the codec of the audio track.
+    UINT64 segmentDuration;           //!< the rotation by time in 100ns, 0 for none.
+    UINT64 segmentSize;               //!< the rotation by size in bytes, 0 for none.
+    BOOL directIo;                    //!< write the segments with O_DIRECT, it falls back to the page cache if the file system refuses it.
+    BOOL preallocate;                 //!< fallocate the segment size when the segment is opened.
+    BOOL videoOnly;                   //!< the channel has no audio track, audioCodec is ignored.
+    BOOL audioOnly;                   //!< the channel has no video track, videoCodec is ignored and any audio frame starts a segment.
+} AppRecorderConfig, *PAppRecorderConfig;
+
+typedef struct {
+    AppRecorderConfig config;                 //!< the configuration.
+    PAppReplay pQueue;                        //!< the frames appended by the live path, the writer follows its head.
+    AppReplayCursor cursor;                   //!< the frame of the writer in the queue.
+    TID writerTid;                            //!< the thread of the writes.
+    volatile ATOMIC_BOOL terminateWriter;     //!< the writer drains the queue and closes the segment.
+    PBYTE pFrameBuffer;                       //!< the frame read from the queue.
+    UINT32 frameBufferSize;                   //!< the size of pFrameBuffer.
+    PBYTE pWriteBuffer;                       //!< the aligned buffer of the writes, it is written when it is full.
+    UINT32 writeLen;                          //!< the bytes in pWriteBuffer.
+    INT32 fd;                                 //!< the segment being written, -1 without one.
+    BOOL directIo;                            //!< the segment is opened with O_DIRECT.
+    CHAR path[MAX_PATH_LEN + 1];              //!< the path of the segment being written.
+    UINT32 segmentIndex;                      //!< the index of the next segment.
+    UINT64 segmentBytes;                      //!< the bytes of the segment.
+    UINT64 segmentStartTime;                  //!< the time the segment is opened.
+    UINT64 segmentBasePts;                    //!< the presentation timestamp of the first frame of the segment.
+    UINT64 clusterTimecode;                   //!< the timecode of the current cluster in milliseconds.
+    BOOL clusterOpen;                         //!< a cluster is opened in the segment.
+    BYTE sps[APP_RECORDER_PARAMETER_SET_LEN]; //!< the last sps of the h264 track.
+    UINT32 spsLen;                            //!< the length of the sps.
+    BYTE pps[APP_RECORDER_PARAMETER_SET_LEN]; //!< the last pps of the h264 track.
+    UINT32 ppsLen;                            //!< the length of the pps.
+    UINT64 framesWritten;                     //!< the frames written into the segments.
+    UINT64 framesDropped;                     //!< the frames overwritten in the queue or skipped before a key frame.
+} AppRecorder, *PAppRecorder;
+
+/**
+ * @brief create the recorder and start its writer.
+ *
+ * @param[in] pConfig the configuration.
+ * @param[out] ppAppRecorder the recorder.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS createAppRecorder(PAppRecorderConfig pConfig, PAppRecorder* ppAppRecorder);
+/**
+ * @brief stop the writer, the queued frames are written and the segment is closed. The appends must be gone.
+ *
+ * @param[in, out] ppAppRecorder the recorder.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS freeAppRecorder(PAppRecorder* ppAppRecorder);
+/**
+ * @brief queue the frame for the writer. It is one copy into the queue and it never waits for the writes, the oldest frames
+ *        are dropped if the writer falls behind.
+ *
+ * @param[in] pAppRecorder the recorder.
+ * @param[in] pFrame the frame.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS appendAppRecorderFrame(PAppRecorder pAppRecorder, PFrame pFrame);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_RECORDER_INCLUDE__ */
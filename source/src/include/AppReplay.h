@@ -0,0 +1,150 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_REPLAY_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_REPLAY_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+#include "AppConfig.h"
+#include "AppError.h"
+
+/**
+ * The replay is served in chunks over the data channel, each chunk is one binary sctp message of
+ *
+ * | frameSize(4) | offset(4) | flags(4) | trackId(4) | presentationTs(8) | decodingTs(8) | bytes of the frame |
+ *
+ * in big-endian. The offset is the one of the bytes in the frame, so the viewer appends the chunks until frameSize. The
+ * timestamps are in 100ns. A chunk of frameSize 0 ends the replay.
+ */
+#define APP_REPLAY_CHUNK_HEADER_LEN 32
+#define APP_REPLAY_PADDING          MAX_UINT32 //!< the size of the record which skips the tail of the ring.
+
+/**
+ * The record of a frame in the ring, followed by the bytes of the frame and padded to 8 bytes.
+ */
+typedef struct {
+    UINT32 size;           //!< the bytes of the frame, APP_REPLAY_PADDING for the tail of the ring which is skipped.
+    UINT32 flags;          //!< FRAME_FLAGS of the frame.
+    UINT64 trackId;        //!< the track of the frame.
+    UINT64 presentationTs; //!< the presentation timestamp of the frame in 100ns.
+    UINT64 decodingTs;     //!< the decoding timestamp of the frame in 100ns.
+} AppReplayFrame, *PAppReplayFrame;
+
+typedef struct {
+    SIZE_T position;   //!< the position of the record of the key frame.
+    UINT64 appendTime; //!< the time of the append, the time cap is applied on it.
+} AppReplayKeyFrame, *PAppReplayKeyFrame;
+
+typedef struct {
+    PBYTE pBuffer;                                          //!< the ring, mapped anonymously so it stays out of the heap.
+    UINT32 capacity;                                        //!< the byte cap of the ring.
+    UINT64 duration;                                        //!< the time cap of the replay in 100ns.
+    MUTEX writeLock;                                        //!< the lock of the appends, the audio and video are appended by two threads.
+    volatile SIZE_T reserved;                               //!< the end of the record being appended, the bytes before it minus the capacity
+                                                            //!< are overwritten.
+    volatile SIZE_T head;                                   //!< the end of the appended records, the positions wrap around.
+    AppReplayKeyFrame keyFrames[APP_REPLAY_MAX_KEY_FRAMES]; //!< the index of the video key frames.
+    volatile SIZE_T keyFrameCount;                          //!< the key frames appended, the newest is at keyFrameCount - 1.
+} AppReplay, *PAppReplay;
+
+typedef struct {
+    SIZE_T position;      //!< the position of the record of the current frame.
+    SIZE_T end;           //!< the head of the ring when the replay is requested or followed, the replay stops there.
+    UINT32 offset;        //!< the bytes of the current frame already read.
+    AppReplayFrame frame; //!< the record of the current frame.
+    BOOL inFrame;         //!< the record of the current frame is read.
+    BOOL active;          //!< the replay is in progress.
+} AppReplayCursor, *PAppReplayCursor;
+/**
+ * @brief create the ring of the replay.
+ *
+ * @param[in] capacity the byte cap of the ring, it is rounded to 8 bytes.
+ * @param[in] duration the time cap of the replay in 100ns.
+ * @param[out] ppAppReplay the replay.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS createAppReplay(UINT32 capacity, UINT64 duration, PAppReplay* ppAppReplay);
+/**
+ * @brief free the replay, the readers must be gone.
+ *
+ * @param[in, out] ppAppReplay the replay.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS freeAppReplay(PAppReplay* ppAppReplay);
+/**
+ * @brief append the frame to the ring, overwriting the oldest ones. The record is one copy into the ring, and it is
+ *        published after the copy.
+ *
+ * @param[in] pAppReplay the replay.
+ * @param[in] pFrame the frame.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS appendAppReplayFrame(PAppReplay pAppReplay, PFrame pFrame);
+/**
+ * @brief place the cursor on the oldest key frame within the byte and time caps, the replay ends at the current head. The
+ *        replay is empty without such a key frame. It does not lock the ring.
+ *
+ * @param[in] pAppReplay the replay.
+ * @param[out] pCursor the cursor.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS seekAppReplay(PAppReplay pAppReplay, PAppReplayCursor pCursor);
+/**
+ * @brief move the end of the replay to the current head, so the cursor goes on with the frames appended since it is placed.
+ *
+ * @param[in] pAppReplay the replay.
+ * @param[in, out] pCursor the cursor, it is active again.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS followAppReplay(PAppReplay pAppReplay, PAppReplayCursor pCursor);
+/**
+ * @brief copy the next bytes of the current frame and advance the cursor. The copy is validated against the appends after
+ *        it, so the reader does not lock the ring.
+ *
+ * @param[in] pAppReplay the replay.
+ * @param[in, out] pCursor the cursor, the record of the frame is in pCursor->frame.
+ * @param[out] pBuffer the bytes.
+ * @param[in] bufferSize the size of pBuffer.
+ * @param[out] pSize the bytes copied, the cursor is inactive at the end of the replay.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success, STATUS_APP_REPLAY_OVERRUN if the appends overwrite the
+ *         frame before it is read.
+ */
+STATUS readAppReplay(PAppReplay pAppReplay, PAppReplayCursor pCursor, PBYTE pBuffer, UINT32 bufferSize, PUINT32 pSize);
+/**
+ * @brief send the replay in chunks over the data channel until the budget is spent, the sdk refuses a chunk or the replay
+ *        ends. The refused chunk is sent again by the next call.
+ *
+ * @param[in] pAppReplay the replay.
+ * @param[in, out] pCursor the cursor, it is inactive after the end of the replay.
+ * @param[in] pRtcDataChannel the data channel of the viewer.
+ * @param[in] budget the bytes of the frames to send.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS serveAppReplay(PAppReplay pAppReplay, PAppReplayCursor pCursor, PRtcDataChannel pRtcDataChannel, UINT32 budget);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_REPLAY_INCLUDE__ */
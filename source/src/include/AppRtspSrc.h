@@ -23,7 +23,36 @@ extern "C" {
 #include "AppConfig.h"
 #include "AppError.h"
 
-typedef STATUS (*MediaSinkHook)(PVOID udata, PFrame pFrame);
+typedef struct {
+    UINT64 sinkEntryTime; //!< the time the appsink callback is entered, in 100ns.
+    UINT64 mappedTime;    //!< the time the buffer of the frame is mapped, in 100ns.
+    INT64 clockOffset;    //!< the time the appsink callback is entered minus the running time of the frame, in 100ns.
+} MediaFrameTiming, *PMediaFrameTiming;
+
+typedef struct {
+    UINT64 reconnectCount; //!< the rebuilt pipelines which delivered the media again.
+    UINT64 failedCount;    //!< the rebuilt pipelines which failed before any frame.
+    UINT32 attempt;        //!< the consecutive failed rebuilds.
+    UINT64 lastDelay;      //!< the latest backoff delay in 100ns.
+    UINT64 downtime;       //!< the total time from the loss of the camera to the first frame of the rebuilt pipeline, in 100ns.
+    BOOL lost;             //!< the camera is lost now.
+} MediaReconnectStats, *PMediaReconnectStats;
+
+typedef struct {
+    UINT64 frameCount;  //!< the frames of the track.
+    DOUBLE fps;         //!< the frame rate derived from the timestamps, 0 before two frames.
+    UINT64 frameGap;    //!< the time since the last frame of the track, in 100ns.
+    UINT64 maxFrameGap; //!< the longest time between two frames of the same pipeline, in 100ns.
+} MediaTrackStats, *PMediaTrackStats;
+
+typedef struct {
+    MediaTrackStats video; //!< the video track.
+    MediaTrackStats audio; //!< the audio track.
+    UINT64 stallCount;     //!< the pipelines restarted by the watchdog.
+    UINT64 stallTimeout;   //!< the shortest gap of frames which is a stall in 100ns, 0 if the watchdog is disabled.
+} MediaWatchdogStats, *PMediaWatchdogStats;
+
+typedef STATUS (*MediaSinkHook)(PVOID udata, PFrame pFrame, PMediaFrameTiming pTiming);
 typedef STATUS (*MediaEosHook)(PVOID udata);
 typedef PVOID PMediaContext;
 /**
@@ -78,7 +107,9 @@ STATUS linkMeidaSinkHook(PMediaContext pMediaContext, MediaSinkHook mediaSinkHoo
  */
 STATUS linkMeidaEosHook(PMediaContext pMediaContext, MediaEosHook mediaEosHook, PVOID udata);
 /**
- * @brief   the main thread of media source.
+ * @brief   the main thread of media source. An error or an eos of the camera rebuilds the pipeline with backoff, the eos
+ *          hook is invoked when it gives up. A watchdog restarts the pipeline when the camera stops sending without an error
+ *          or an eos.
  * @param[in] args the context of the media source.
  *
  * @return STATUS code of the execution. STATUS_SUCCESS on success.
@@ -91,6 +122,22 @@ PVOID runMediaSource(PVOID args);
  * @return STATUS code of the execution. STATUS_SUCCESS on success.
  */
 STATUS shutdownMediaSource(PMediaContext pMediaContext);
+/**
+ * @brief   get the statistics of the reconnection of the camera. The downtime includes the current outage.
+ * @param[in] pMediaContext the context of the media source.
+ * @param[out] pReconnectStats the statistics.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getMediaSourceReconnectStats(PMediaContext pMediaContext, PMediaReconnectStats pReconnectStats);
+/**
+ * @brief   get the state of the watchdog of the stalled pipelines.
+ * @param[in] pMediaContext the context of the media source.
+ * @param[out] pWatchdogStats the state of the tracks and the stalls.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS getMediaSourceWatchdogStats(PMediaContext pMediaContext, PMediaWatchdogStats pWatchdogStats);
 /**
  * @brief   destroy the context of media source.
  * @param[in] PMediaContext the context of the media source.
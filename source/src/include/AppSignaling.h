@@ -23,14 +23,75 @@ extern "C" {
 #include "AppError.h"
 #include "AppCredential.h"
 
+typedef struct __AppSignalingSendNode {
+    struct __AppSignalingSendNode* pNext;
+    UINT64 enqueueTime; //!< the time when the message was queued.
+    SignalingMessage message;
+} AppSignalingSendNode, *PAppSignalingSendNode;
+
+typedef struct {
+    UINT64 enqueuedCount;  //!< the number of messages accepted by the send queue.
+    UINT64 sentCount;      //!< the number of messages sent successfully.
+    UINT64 failedCount;    //!< the number of messages rejected by the signaling client.
+    UINT64 droppedCount;   //!< the number of messages dropped because the queue was full or shutting down.
+    UINT32 queueDepth;     //!< the current depth of the send queue.
+    UINT32 maxQueueDepth;  //!< the high-water mark of the send queue.
+    UINT64 avgSendLatency; //!< the moving average of the latency from enqueue to sent, in 100ns.
+    UINT64 maxSendLatency; //!< the maximum latency from enqueue to sent, in 100ns.
+} AppSignalingSendStats, *PAppSignalingSendStats;
+
+typedef enum {
+    APP_SIGNALING_RECONNECT_STATE_IDLE,    //!< the client is healthy, or not created yet. Its state is checked periodically.
+    APP_SIGNALING_RECONNECT_STATE_BACKOFF, //!< the latest attempt failed, wait for the jittered backoff before the next one.
+    APP_SIGNALING_RECONNECT_STATE_RUNNING, //!< the client is being re-created or connected.
+} APP_SIGNALING_RECONNECT_STATE;
+
+typedef struct {
+    APP_SIGNALING_RECONNECT_STATE state; //!< the current state of the reconnection.
+    UINT64 restartCount;                 //!< the number of times the signaling client was re-created.
+    UINT64 failedCount;                  //!< the number of failed attempts of re-creating or connecting the client.
+    UINT32 attempt;                      //!< the number of consecutive failed attempts.
+    UINT64 lastDelay;                    //!< the latest backoff delay in 100ns.
+} AppSignalingReconnectStats, *PAppSignalingReconnectStats;
+
+typedef struct {
+    CHAR uris[MAX_ICE_CONFIG_URI_COUNT][MAX_ICE_CONFIG_URI_LEN + 1]; //!< the uris of this turn server.
+    UINT32 uriCount;                                                 //!< the number of uris.
+    UINT64 rtt;                                                      //!< the smoothed round trip time in 100ns.
+    UINT64 sampleCount;                                              //!< the number of probes, 0 means it is not probed yet.
+    UINT64 lastProbeTime;                                            //!< the time of the latest probe.
+} AppTurnServer, *PAppTurnServer;
+
 typedef struct {
     PAppCredential pAppCredential; //!< the context of credential
     SIGNALING_CLIENT_HANDLE signalingClientHandle;
     SignalingClientCallbacks signalingClientCallbacks;
     ChannelInfo channelInfo;
     SignalingClientInfo clientInfo;
-    MUTEX signalingSendMessageLock; //!< per signaling client
+    MUTEX signalingSendMessageLock; //!< per signaling client, protect the handle against the restart.
     BOOL useTurn;
+    MUTEX sendQueueLock;                  //!< protect the send queue and its stats.
+    CVAR sendQueueCvar;                   //!< wake up the sender thread.
+    PAppSignalingSendNode pSendQueueHead; //!< the oldest queued message.
+    PAppSignalingSendNode pSendQueueTail; //!< the newest queued message.
+    TID senderTid;                        //!< the thread draining the send queue.
+    volatile ATOMIC_BOOL terminateSender; //!< stop the sender thread.
+    AppSignalingSendStats sendStats;
+    MUTEX turnServerLock;                            //!< protect the list of turn servers.
+    AppTurnServer turnServers[MAX_ICE_CONFIG_COUNT]; //!< the turn servers in the order of the ice configs.
+    UINT32 turnServerCount;                          //!< the number of turn servers.
+    UINT32 maxTurnServer;                            //!< the number of turn servers handed to a peer connection.
+    UINT64 turnProbeInterval;                        //!< the interval of probing the turn servers, in 100ns.
+    MUTEX reconnectLock;                             //!< protect the state of the reconnection.
+    CVAR reconnectCvar;                              //!< wake up the reconnect thread.
+    TID reconnectTid;                                //!< the thread re-creating and connecting the signaling client.
+    volatile ATOMIC_BOOL terminateReconnect;         //!< stop the reconnect thread.
+    BOOL restartRequested;                           //!< the signaling client needs to be re-created.
+    BOOL connectReturned;                            //!< connectAppSignaling returned, the reconnect thread waits for it.
+    UINT64 nextReconnectTime;                        //!< the time of the next check or attempt.
+    UINT64 reconnectBaseDelay;                       //!< the backoff delay of the first failed attempt, in 100ns.
+    UINT64 reconnectMaxDelay;                        //!< the upper bound of the backoff delay, in 100ns.
+    AppSignalingReconnectStats reconnectStats;
 } AppSignaling, *PAppSignaling;
 /**
  * @brief   initialize the context of app signaling
@@ -55,7 +116,9 @@ STATUS initAppSignaling(PAppSignaling pAppSignaling, SignalingClientMessageRecei
  */
 SIGNALING_CHANNEL_ROLE_TYPE getAppSignalingRole(PAppSignaling pAppSignaling);
 /**
- * @brief   query the information of stun/turn servers
+ * @brief   query the information of stun/turn servers. The turn servers are ranked by the measured round trip time and
+ *          the best maxTurnServer of them are returned. The servers which are not probed yet come first, so they get
+ *          measured by the next peer connection.
  *
  * @param[in] pAppSignaling the context of appSignaling
  * @param[in] pIceServer the structure of ice servers
@@ -73,14 +136,79 @@ STATUS queryAppSignalingServer(PAppSignaling pAppSignaling, PRtcIceServer pIceSe
  */
 STATUS connectAppSignaling(PAppSignaling pAppSignaling);
 /**
- * @brief   connect to the signaling server
+ * @brief   report the round trip time of a turn server measured by a peer connection.
+ *
+ * @param[in] pAppSignaling the context of appSignaling
+ * @param[in] pUrl the url of the ice server
+ * @param[in] rtt the round trip time in 100ns
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success, STATUS_NOT_FOUND if the url is not a known turn server.
+ */
+STATUS reportAppSignalingTurnRtt(PAppSignaling pAppSignaling, PCHAR pUrl, UINT64 rtt);
+/**
+ * @brief   connect to the signaling server if the client is ready. It blocks on the network, so only the reconnect thread
+ *          calls it.
  *
  * @param[in] pAppSignaling the context of appSignaling
  *
  * @return STATUS code of the execution. STATUS_SUCCESS on success
  */
 STATUS checkAppSignaling(PAppSignaling pAppSignaling);
+/**
+ * @brief   ask the reconnect thread to re-create the signaling client. It returns immediately. A failed attempt is retried
+ *          with a jittered exponential backoff, and the requests made before the client is re-created are merged.
+ *
+ * @param[in] pAppSignaling the context of appSignaling
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success
+ */
+STATUS requestAppSignalingRestart(PAppSignaling pAppSignaling);
+/**
+ * @brief   get a snapshot of the statistics of the reconnection.
+ *
+ * @param[in] pAppSignaling the context of appSignaling
+ * @param[out] pReconnectStats the statistics of the reconnection
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success
+ */
+STATUS getAppSignalingReconnectStats(PAppSignaling pAppSignaling, PAppSignalingReconnectStats pReconnectStats);
+/**
+ * @brief   get the metrics of the signaling client. It fails while the client is being re-created.
+ *
+ * @param[in] pAppSignaling the context of appSignaling
+ * @param[out] pSignalingClientMetrics the metrics of the signaling client
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success
+ */
+STATUS getAppSignalingMetrics(PAppSignaling pAppSignaling, PSignalingClientMetrics pSignalingClientMetrics);
+/**
+ * @brief   send the signaling message. The offers and the answers are sent synchronously, so their failure is returned to
+ *          the caller. The ice candidates are copied into the queue of the sender thread, so the caller can release them
+ *          right after this call and the ice agent never blocks on the network.
+ *
+ * @param[in] pAppSignaling the context of appSignaling
+ * @param[in] pMessage the signaling message
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success
+ */
 STATUS sendAppSignalingMessage(PAppSignaling pAppSignaling, PSignalingMessage pMessage);
+/**
+ * @brief   get a snapshot of the statistics of the send queue.
+ *
+ * @param[in] pAppSignaling the context of appSignaling
+ * @param[out] pSendStats the statistics of the send queue
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success
+ */
+STATUS getAppSignalingSendStats(PAppSignaling pAppSignaling, PAppSignalingSendStats pSendStats);
+/**
+ * @brief   re-create the signaling client synchronously. The handle is detached under the signalingSendMessageLock, so the
+ *          other threads see an invalid handle instead of a client being freed.
+ *
+ * @param[in] pAppSignaling the context of appSignaling
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success
+ */
 STATUS restartAppSignaling(PAppSignaling pAppSignaling);
 STATUS freeAppSignaling(PAppSignaling pAppSignaling);
 
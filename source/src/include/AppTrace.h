@@ -0,0 +1,95 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_TRACE_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_TRACE_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+#include "AppConfig.h"
+#include "AppError.h"
+
+typedef struct {
+    PCHAR pName;      //!< the name of the span, a static string.
+    UINT64 timestamp; //!< the monotonic time in 100ns.
+    CHAR phase;       //!< 'B' for the begin of the span, 'E' for its end.
+} AppTraceEvent, *PAppTraceEvent;
+
+/**
+ * The states of a trace buffer. The buffer of an exited thread keeps its events for the dump until another thread claims it.
+ */
+typedef enum {
+    APP_TRACE_BUFFER_FREE,     //!< no thread claimed the buffer yet.
+    APP_TRACE_BUFFER_CLAIMING, //!< a thread is taking the buffer, the dump skips it.
+    APP_TRACE_BUFFER_OWNED,    //!< the thread of the buffer records into it.
+    APP_TRACE_BUFFER_RELEASED, //!< the thread of the buffer exited.
+} APP_TRACE_BUFFER_STATE;
+
+typedef struct {
+    volatile SIZE_T state;                          //!< the APP_TRACE_BUFFER_STATE of the buffer.
+    UINT64 tid;                                     //!< the thread owning the buffer.
+    SIZE_T firstEventCount;                         //!< eventCount when the thread claimed the buffer, the events before are of another.
+    CHAR threadName[APP_TRACE_THREAD_NAME_LEN + 1]; //!< the name of the thread in the trace, empty if it is not named.
+    volatile SIZE_T eventCount;                     //!< the number of events recorded, the ring keeps the last APP_TRACE_RING_SIZE.
+    AppTraceEvent events[APP_TRACE_RING_SIZE];      //!< the ring of the events, only written by its thread.
+} AppTraceBuffer, *PAppTraceBuffer;
+/**
+ * @brief start recording the spans. Each thread records into its own ring buffer without a lock, and the buffer is claimed by
+ *        the first event of the thread.
+ *
+ * @param[in] pPath the default path of the dump, NULL to keep the tracer disabled.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS initAppTrace(PCHAR pPath);
+/**
+ * @brief stop recording the spans. The buffers are kept, since the threads may still hold them.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS deinitAppTrace();
+/**
+ * @brief record the begin of a span on the calling thread.
+ *
+ * @param[in] pName the name of the span, a static string.
+ */
+VOID appTraceBegin(PCHAR pName);
+/**
+ * @brief record the end of a span on the calling thread.
+ *
+ * @param[in] pName the name of the span, a static string.
+ */
+VOID appTraceEnd(PCHAR pName);
+/**
+ * @brief name the calling thread in the trace, unless it is already named.
+ *
+ * @param[in] pName the name of the thread.
+ */
+VOID setAppTraceThreadName(PCHAR pName);
+/**
+ * @brief write the events of all the threads as a chrome trace, which perfetto and chrome://tracing load. The events
+ *        overwritten during the dump are skipped.
+ *
+ * @param[in] pPath the path of the trace, NULL for the path of initAppTrace.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS dumpAppTrace(PCHAR pPath);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_TRACE_INCLUDE__ */
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "AppBench.h"
+
+static AppBenchResult gAppBenchResults[APP_BENCH_MAX_RESULTS];
+static UINT32 gAppBenchResultCount = 0;
+
+static UINT64 getAppBenchTime()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (UINT64) now.tv_sec * 1000000000ULL + (UINT64) now.tv_nsec;
+}
+
+static INT32 compareAppBenchElapsed(const VOID* pLeft, const VOID* pRight)
+{
+    UINT64 left = *(const UINT64*) pLeft, right = *(const UINT64*) pRight;
+
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+static STATUS writeAppBenchResults(PCHAR pPath)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    FILE* fp = NULL;
+    PAppBenchResult pResult;
+    UINT32 i;
+
+    CHK((fp = FOPEN(pPath, "w")) != NULL, STATUS_OPEN_FILE_FAILED);
+    fprintf(fp, "{\"benchmarks\":[");
+    for (i = 0; i < gAppBenchResultCount; i++) {
+        pResult = &gAppBenchResults[i];
+        fprintf(fp,
+                "%s\n{\"name\":\"%s\",\"param\":\"%s\",\"value\":%" PRIu64 ",\"ops\":%" PRIu64 ",\"rounds\":%u,"
+                "\"minNsPerOp\":%.1f,\"medianNsPerOp\":%.1f,\"maxNsPerOp\":%.1f}",
+                i == 0 ? "" : ",", pResult->name, pResult->paramName, pResult->param, pResult->opCount, APP_BENCH_ROUNDS, pResult->minNs,
+                pResult->medianNs, pResult->maxNs);
+    }
+    fprintf(fp, "\n]}\n");
+    CHK(ferror(fp) == 0, STATUS_WRITE_TO_FILE_FAILED);
+
+CleanUp:
+
+    if (fp != NULL) {
+        FCLOSE(fp);
+    }
+    return retStatus;
+}
+
+VOID resetAppBench(PAppBench pBench)
+{
+    MEMSET(pBench, 0x00, SIZEOF(AppBench));
+}
+
+VOID startAppBench(PAppBench pBench)
+{
+    pBench->startTime = getAppBenchTime();
+}
+
+VOID stopAppBench(PAppBench pBench, UINT32 round)
+{
+    pBench->elapsed[round] += getAppBenchTime() - pBench->startTime;
+}
+
+STATUS reportAppBench(PAppBench pBench, PCHAR pName, PCHAR pParamName, UINT64 param, UINT64 opCount)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppBenchResult pResult;
+    PCHAR pPath;
+
+    CHK(pBench != NULL && pName != NULL && pParamName != NULL && opCount != 0, STATUS_NULL_ARG);
+    CHK(gAppBenchResultCount < APP_BENCH_MAX_RESULTS, STATUS_NOT_ENOUGH_MEMORY);
+
+    // The rounds are sorted, the slow ones are usually disturbed by the scheduler or a cold cache.
+    qsort(pBench->elapsed, APP_BENCH_ROUNDS, SIZEOF(UINT64), compareAppBenchElapsed);
+    pResult = &gAppBenchResults[gAppBenchResultCount++];
+    STRNCPY(pResult->name, pName, APP_BENCH_NAME_LEN);
+    STRNCPY(pResult->paramName, pParamName, APP_BENCH_NAME_LEN);
+    pResult->param = param;
+    pResult->opCount = opCount;
+    pResult->minNs = (DOUBLE) pBench->elapsed[0] / opCount;
+    pResult->medianNs = (DOUBLE) pBench->elapsed[APP_BENCH_ROUNDS / 2] / opCount;
+    pResult->maxNs = (DOUBLE) pBench->elapsed[APP_BENCH_ROUNDS - 1] / opCount;
+    printf("%-40s %s=%-8" PRIu64 " %12.1f ns/op (min %.1f, max %.1f)\n", pName, pParamName, param, pResult->medianNs, pResult->minNs,
+           pResult->maxNs);
+
+    // Rewrite the file with every result, so it is complete whichever benchmark runs last.
+    if ((pPath = GETENV(APP_BENCH_OUTPUT)) != NULL) {
+        CHK_STATUS((writeAppBenchResults(pPath)));
+    }
+
+CleanUp:
+
+    resetAppBench(pBench);
+    return retStatus;
+}
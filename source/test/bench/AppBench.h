@@ -0,0 +1,78 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#ifndef __KINESIS_VIDEO_WEBRTC_APP_BENCH_INCLUDE__
+#define __KINESIS_VIDEO_WEBRTC_APP_BENCH_INCLUDE__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
+
+#define APP_BENCH_ROUNDS      7  //!< the rounds of a benchmark, the median round is the result.
+#define APP_BENCH_MAX_RESULTS 64 //!< the results of a benchmark executable.
+#define APP_BENCH_OUTPUT      ((PCHAR) "APP_BENCH_OUTPUT")
+#define APP_BENCH_NAME_LEN    63
+
+typedef struct {
+    UINT64 startTime;                 //!< the start of the timed section in ns.
+    UINT64 elapsed[APP_BENCH_ROUNDS]; //!< the timed ns of each round.
+} AppBench, *PAppBench;
+
+typedef struct {
+    CHAR name[APP_BENCH_NAME_LEN + 1];
+    CHAR paramName[APP_BENCH_NAME_LEN + 1];
+    UINT64 param;
+    UINT64 opCount;  //!< the operations of a round.
+    DOUBLE minNs;    //!< the ns per operation of the fastest round.
+    DOUBLE medianNs; //!< the ns per operation of the median round.
+    DOUBLE maxNs;    //!< the ns per operation of the slowest round.
+} AppBenchResult, *PAppBenchResult;
+/**
+ * @brief clear the timings of a benchmark.
+ *
+ * @param[in] pBench the benchmark.
+ */
+VOID resetAppBench(PAppBench pBench);
+/**
+ * @brief start timing the operations.
+ *
+ * @param[in] pBench the benchmark.
+ */
+VOID startAppBench(PAppBench pBench);
+/**
+ * @brief stop timing the operations, the time since startAppBench is added to the round. The untimed sections between the
+ *        calls set up and tear down the operations.
+ *
+ * @param[in] pBench the benchmark.
+ * @param[in] round the round.
+ */
+VOID stopAppBench(PAppBench pBench, UINT32 round);
+/**
+ * @brief print the result of the benchmark, and write all the results of the executable into the json file of APP_BENCH_OUTPUT.
+ *
+ * @param[in] pBench the benchmark.
+ * @param[in] pName the name of the benchmark.
+ * @param[in] pParamName the name of the parameter, e.g. the number of sessions.
+ * @param[in] param the value of the parameter.
+ * @param[in] opCount the operations of a round.
+ *
+ * @return STATUS code of the execution. STATUS_SUCCESS on success.
+ */
+STATUS reportAppBench(PAppBench pBench, PCHAR pName, PCHAR pParamName, UINT64 param, UINT64 opCount);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __KINESIS_VIDEO_WEBRTC_APP_BENCH_INCLUDE__ */
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include "unity.h"
+#include "AppBench.h"
+#include "AppCommon.h"
+#include "mock_Include.h"
+#include "mock_AppSignaling.h"
+#include "mock_AppCredential.h"
+#include "mock_AppMetrics.h"
+#include "mock_AppWebRTC.h"
+#include "mock_AppRtspSrc.h"
+#include "mock_AppHashTableWrap.h"
+#include "mock_AppMessageQueue.h"
+#include "mock_AppTimerWrap.h"
+
+#define APP_COMMON_BENCH_CHANNEL_NAME "AppCommonBenchChannel"
+#define APP_COMMON_BENCH_FRAMES       1000
+#define APP_COMMON_BENCH_FRAME_SIZE   1200
+
+static const UINT32 gSessionCounts[] = {1, 2, 4, 8, 16, 32, 64};
+static ConnectionMsgQ gConnectionMsgQ;
+static HashTable gRemoteRtcPeerConnections;
+static BYTE gFrameData[APP_COMMON_BENCH_FRAME_SIZE];
+static PAppConfiguration gpAppConfiguration = NULL;
+static MediaSinkHook gMediaSinkHook = NULL;
+static PVOID gMediaSinkHookUdata = NULL;
+
+static STATUS appTimerQueueCreate_callback(PTIMER_QUEUE_HANDLE pHandle)
+{
+    *pHandle = 1;
+    return STATUS_SUCCESS;
+}
+
+static STATUS appTimeQueueAdd_callback(TIMER_QUEUE_HANDLE handle, UINT64 start, UINT64 period, TimerCallbackFunc timerCallbackFn, UINT64 customData,
+                                       PUINT32 pIndex)
+{
+    *pIndex = 1;
+    return STATUS_SUCCESS;
+}
+
+static STATUS initAppSignaling_callback(PAppSignaling pAppSignaling, SignalingClientMessageReceivedFunc onMessageReceived,
+                                        SignalingClientStateChangedFunc onStateChanged, SignalingClientErrorReportFunc pOnError, UINT64 udata,
+                                        BOOL useTurn)
+{
+    pAppSignaling->signalingClientHandle = INVALID_SIGNALING_CLIENT_HANDLE_VALUE;
+    pAppSignaling->useTurn = useTurn;
+    pAppSignaling->signalingClientCallbacks.version = SIGNALING_CLIENT_CALLBACKS_CURRENT_VERSION;
+    pAppSignaling->signalingClientCallbacks.messageReceivedFn = onMessageReceived;
+    pAppSignaling->signalingClientCallbacks.stateChangeFn = onStateChanged;
+    pAppSignaling->signalingClientCallbacks.errorReportFn = pOnError;
+    pAppSignaling->signalingClientCallbacks.customData = (UINT64) udata;
+    return STATUS_SUCCESS;
+}
+
+static STATUS createConnectionMsqQ_callback(PConnectionMsgQ* ppConnectionMsgQ)
+{
+    *ppConnectionMsgQ = &gConnectionMsgQ;
+    return STATUS_SUCCESS;
+}
+
+static STATUS appHashTableCreateWithParams_callback(UINT32 bucketCount, UINT32 bucketLength, PHashTable* ppHashTable)
+{
+    *ppHashTable = &gRemoteRtcPeerConnections;
+    return STATUS_SUCCESS;
+}
+
+static STATUS linkMeidaSinkHook_callback(PMediaContext pMediaContext, MediaSinkHook mediaSinkHook, PVOID udata)
+{
+    gMediaSinkHook = mediaSinkHook;
+    gMediaSinkHookUdata = udata;
+    return STATUS_SUCCESS;
+}
+
+/**
+ * The stub of writeFrame, so the benchmark measures the fan-out of the app instead of the packetization of the sdk.
+ */
+static STATUS writeFrame_callback(PRtcRtpTransceiver pRtcRtpTransceiver, PFrame pFrame)
+{
+    return STATUS_SUCCESS;
+}
+
+static VOID addAppCommonBenchSessions(UINT32 sessionCount)
+{
+    PStreamingSession pStreamingSession;
+    UINT32 i;
+
+    for (i = 0; i < sessionCount; i++) {
+        pStreamingSession = (PStreamingSession) MEMCALLOC(1, SIZEOF(StreamingSession));
+        TEST_ASSERT_NOT_NULL(pStreamingSession);
+        SNPRINTF(pStreamingSession->peerId, SIZEOF(pStreamingSession->peerId), "bench-peer-%u", i);
+        pStreamingSession->pAppConfiguration = gpAppConfiguration;
+        pStreamingSession->refCount = 1;
+        pStreamingSession->firstKeyFrame = TRUE;
+        // The transceivers are only passed to the stub of writeFrame.
+        pStreamingSession->pVideoRtcRtpTransceiver = (PRtcRtpTransceiver) pStreamingSession;
+        pStreamingSession->pAudioRtcRtpTransceiver = (PRtcRtpTransceiver) pStreamingSession;
+        // The same metrics as createStreamingSession, they are observed for each frame.
+        registerAppMetric(gpAppConfiguration->pMetricsRegistry, "webrtc_app_session_frame_delay_seconds",
+                          "The latency from the appsink callback to the frame written to the session.", APP_METRIC_TYPE_SUMMARY, "session",
+                          pStreamingSession->peerId, NULL, 0, &pStreamingSession->frameDelayMetricId);
+        registerAppMetric(gpAppConfiguration->pMetricsRegistry, "webrtc_app_session_write_frame_seconds", "The latency of writeFrame of the session.",
+                          APP_METRIC_TYPE_SUMMARY, "session", pStreamingSession->peerId, NULL, 0, &pStreamingSession->writeFrameMetricId);
+        gpAppConfiguration->streamingSessionList[gpAppConfiguration->streamingSessionCount++] = pStreamingSession;
+    }
+}
+
+static VOID freeAppCommonBenchSessions(VOID)
+{
+    PStreamingSession pStreamingSession;
+    UINT32 i;
+
+    for (i = 0; i < gpAppConfiguration->streamingSessionCount; i++) {
+        pStreamingSession = gpAppConfiguration->streamingSessionList[i];
+        removeAppMetrics(gpAppConfiguration->pMetricsRegistry, "session", pStreamingSession->peerId);
+        MEMFREE(pStreamingSession);
+        gpAppConfiguration->streamingSessionList[i] = NULL;
+    }
+    gpAppConfiguration->streamingSessionCount = 0;
+}
+
+/* Called before each test method. */
+void setUp()
+{
+    setenv(APP_WEBRTC_CHANNEL, APP_COMMON_BENCH_CHANNEL_NAME, 1);
+    getLogLevel_IgnoreAndReturn(LOG_LEVEL_WARN);
+    setupFileLogging_IgnoreAndReturn(STATUS_SUCCESS);
+    createCredential_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimerQueueCreate_StubWithCallback(appTimerQueueCreate_callback);
+    initAppSignaling_StubWithCallback(initAppSignaling_callback);
+    createConnectionMsqQ_StubWithCallback(createConnectionMsqQ_callback);
+    appHashTableCreateWithParams_StubWithCallback(appHashTableCreateWithParams_callback);
+    initMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
+    linkMeidaSinkHook_StubWithCallback(linkMeidaSinkHook_callback);
+    linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
+    initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, initApp(TRUE, TRUE, &gpAppConfiguration));
+    TEST_ASSERT_NOT_NULL(gMediaSinkHook);
+    writeFrame_StubWithCallback(writeFrame_callback);
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    freeAppCommonBenchSessions();
+    freeAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
+    freeConnectionMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimerQueueFree_IgnoreAndReturn(STATUS_SUCCESS);
+    appHashTableClear_IgnoreAndReturn(STATUS_SUCCESS);
+    appHashTableFree_IgnoreAndReturn(STATUS_SUCCESS);
+    deinitWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
+    detroyMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimerQueueCancel_IgnoreAndReturn(STATUS_SUCCESS);
+    destroyCredential_IgnoreAndReturn(STATUS_SUCCESS);
+    closeFileLogging_IgnoreAndReturn(STATUS_SUCCESS);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeApp(&gpAppConfiguration));
+}
+
+void test_onMediaSinkHook(void)
+{
+    AppBench bench;
+    Frame frame;
+    UINT32 i, j, round, sessionCount;
+
+    MEMSET(&frame, 0x00, SIZEOF(Frame));
+    frame.frameData = gFrameData;
+    frame.size = SIZEOF(gFrameData);
+    frame.flags = FRAME_FLAG_KEY_FRAME;
+    frame.trackId = DEFAULT_VIDEO_TRACK_ID;
+
+    for (i = 0; i < ARRAY_SIZE(gSessionCounts); i++) {
+        sessionCount = gSessionCounts[i];
+        addAppCommonBenchSessions(sessionCount);
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            startAppBench(&bench);
+            for (j = 0; j < APP_COMMON_BENCH_FRAMES; j++) {
+                frame.presentationTs = (UINT64) j * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+                gMediaSinkHook(gMediaSinkHookUdata, &frame, NULL);
+            }
+            stopAppBench(&bench, round);
+        }
+        freeAppCommonBenchSessions();
+        reportAppBench(&bench, "onMediaSinkHook", "sessions", sessionCount, APP_COMMON_BENCH_FRAMES);
+    }
+}
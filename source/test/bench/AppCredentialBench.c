@@ -0,0 +1,209 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include "unity.h"
+#include "AppBench.h"
+#include "AppCredential.h"
+#include "AppQueueWrap.h"
+#include "mock_Include.h"
+
+#define APP_CREDENTIAL_BENCH_KEYGEN_OPS 8
+#define APP_CREDENTIAL_BENCH_POP_OPS    10000
+#define APP_CREDENTIAL_BENCH_RSA_BITS   2048
+#define APP_CREDENTIAL_BENCH_CERT_DAYS  30
+
+static AppCredential gAppCredential;
+static AppCertKeyType gKeyType = APP_CERT_KEY_TYPE_ECDSA;
+
+/**
+ * The keypair and the self-signed cert are generated as the sdk does, so generateCertRoutine is timed with a real keygen.
+ */
+static STATUS createRtcCertificate_callback(PRtcCertificate* ppRtcCertificate)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PRtcCertificate pRtcCertificate = NULL;
+    EVP_PKEY_CTX* pCtx = NULL;
+    EVP_PKEY* pKey = NULL;
+    X509* pCert = NULL;
+    X509_NAME* pName;
+
+    CHK(NULL != (pRtcCertificate = (PRtcCertificate) MEMCALLOC(1, SIZEOF(RtcCertificate))), STATUS_NOT_ENOUGH_MEMORY);
+    if (gKeyType == APP_CERT_KEY_TYPE_ECDSA) {
+        CHK((pCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL)) != NULL, STATUS_NOT_ENOUGH_MEMORY);
+        CHK(EVP_PKEY_keygen_init(pCtx) == 1 && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pCtx, NID_X9_62_prime256v1) == 1,
+            STATUS_INVALID_OPERATION);
+    } else {
+        CHK((pCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL)) != NULL, STATUS_NOT_ENOUGH_MEMORY);
+        CHK(EVP_PKEY_keygen_init(pCtx) == 1 && EVP_PKEY_CTX_set_rsa_keygen_bits(pCtx, APP_CREDENTIAL_BENCH_RSA_BITS) == 1,
+            STATUS_INVALID_OPERATION);
+    }
+    CHK(EVP_PKEY_keygen(pCtx, &pKey) == 1, STATUS_INVALID_OPERATION);
+
+    CHK((pCert = X509_new()) != NULL, STATUS_NOT_ENOUGH_MEMORY);
+    CHK(X509_set_version(pCert, 2) == 1 && ASN1_INTEGER_set(X509_get_serialNumber(pCert), 1) == 1, STATUS_INVALID_OPERATION);
+    CHK(X509_gmtime_adj(X509_get_notBefore(pCert), 0) != NULL &&
+            X509_gmtime_adj(X509_get_notAfter(pCert), APP_CREDENTIAL_BENCH_CERT_DAYS * 24 * 60 * 60) != NULL,
+        STATUS_INVALID_OPERATION);
+    pName = X509_get_subject_name(pCert);
+    CHK(X509_NAME_add_entry_by_txt(pName, "CN", MBSTRING_ASC, (const unsigned char*) "KVS-WebRTC-Client", -1, -1, 0) == 1 &&
+            X509_set_issuer_name(pCert, pName) == 1 && X509_set_pubkey(pCert, pKey) == 1 && X509_sign(pCert, pKey, EVP_sha256()) != 0,
+        STATUS_INVALID_OPERATION);
+
+    // Same layout as createRtcCertificate, so freeRtcCertificate_callback releases it.
+    pRtcCertificate->pCertificate = (PBYTE) pCert;
+    pRtcCertificate->pPrivateKey = (PBYTE) pKey;
+    pCert = NULL;
+    pKey = NULL;
+    *ppRtcCertificate = pRtcCertificate;
+    pRtcCertificate = NULL;
+
+CleanUp:
+
+    if (pCtx != NULL) {
+        EVP_PKEY_CTX_free(pCtx);
+    }
+    if (pKey != NULL) {
+        EVP_PKEY_free(pKey);
+    }
+    if (pCert != NULL) {
+        X509_free(pCert);
+    }
+    SAFE_MEMFREE(pRtcCertificate);
+    return retStatus;
+}
+
+static STATUS freeRtcCertificate_callback(PRtcCertificate pRtcCertificate)
+{
+    if (pRtcCertificate != NULL) {
+        X509_free((X509*) pRtcCertificate->pCertificate);
+        EVP_PKEY_free((EVP_PKEY*) pRtcCertificate->pPrivateKey);
+        MEMFREE(pRtcCertificate);
+    }
+    return STATUS_SUCCESS;
+}
+
+static VOID freeAppCredentialBenchCerts(VOID)
+{
+    PRtcCertificate pRtcCertificate = NULL;
+
+    do {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, popGeneratedCert(&gAppCredential, &pRtcCertificate));
+        freeRtcCertificate_callback(pRtcCertificate);
+    } while (pRtcCertificate != NULL);
+}
+
+/* Called before each test method. */
+void setUp()
+{
+    MEMSET(&gAppCredential, 0x00, SIZEOF(AppCredential));
+    gAppCredential.generateCertLock = MUTEX_CREATE(FALSE);
+    gAppCredential.generateCertCvar = CVAR_CREATE();
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, appQueueCreate(&gAppCredential.generatedCertificates));
+    gAppCredential.certPoolDepth = 1;
+    createRtcCertificate_StubWithCallback(createRtcCertificate_callback);
+    freeRtcCertificate_StubWithCallback(freeRtcCertificate_callback);
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    freeAppCredentialBenchCerts();
+    appQueueFree(gAppCredential.generatedCertificates);
+    CVAR_FREE(gAppCredential.generateCertCvar);
+    MUTEX_FREE(gAppCredential.generateCertLock);
+}
+
+void test_createRtcCertificate(void)
+{
+    AppBench bench;
+    PRtcCertificate pRtcCertificates[APP_CREDENTIAL_BENCH_KEYGEN_OPS];
+    UINT32 i, round;
+
+    // The keygen of each key type, the rsa certs are always generated on demand by the sdk.
+    for (gKeyType = APP_CERT_KEY_TYPE_ECDSA; gKeyType <= APP_CERT_KEY_TYPE_RSA; gKeyType++) {
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            startAppBench(&bench);
+            for (i = 0; i < APP_CREDENTIAL_BENCH_KEYGEN_OPS; i++) {
+                TEST_ASSERT_EQUAL(STATUS_SUCCESS, createRtcCertificate_callback(&pRtcCertificates[i]));
+            }
+            stopAppBench(&bench, round);
+            for (i = 0; i < APP_CREDENTIAL_BENCH_KEYGEN_OPS; i++) {
+                freeRtcCertificate_callback(pRtcCertificates[i]);
+            }
+        }
+        reportAppBench(&bench, gKeyType == APP_CERT_KEY_TYPE_ECDSA ? "createRtcCertificate.ecdsa" : "createRtcCertificate.rsa", "keyType",
+                       gKeyType, APP_CREDENTIAL_BENCH_KEYGEN_OPS);
+    }
+    gKeyType = APP_CERT_KEY_TYPE_ECDSA;
+}
+
+void test_generateCertRoutine(void)
+{
+    AppBench bench;
+    AppCertKeyType keyType;
+    UINT32 i, round;
+
+    // The pool only keeps the ecdsa certs, so the rsa routine is the cost of the check that skips the keygen.
+    for (keyType = APP_CERT_KEY_TYPE_ECDSA; keyType <= APP_CERT_KEY_TYPE_RSA; keyType++) {
+        gAppCredential.certKeyType = keyType;
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            for (i = 0; i < APP_CREDENTIAL_BENCH_KEYGEN_OPS; i++) {
+                startAppBench(&bench);
+                TEST_ASSERT_EQUAL(STATUS_SUCCESS, generateCertRoutine(&gAppCredential));
+                stopAppBench(&bench, round);
+                freeAppCredentialBenchCerts();
+            }
+        }
+        reportAppBench(&bench, keyType == APP_CERT_KEY_TYPE_ECDSA ? "generateCertRoutine.ecdsa" : "generateCertRoutine.rsa", "keyType",
+                       keyType, APP_CREDENTIAL_BENCH_KEYGEN_OPS);
+    }
+}
+
+void test_popGeneratedCert(void)
+{
+    AppBench bench;
+    PRtcCertificate pRtcCertificate = NULL;
+    UINT32 i, round;
+
+    // A session takes the pooled cert.
+    resetAppBench(&bench);
+    for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+        for (i = 0; i < APP_CREDENTIAL_BENCH_KEYGEN_OPS; i++) {
+            TEST_ASSERT_EQUAL(STATUS_SUCCESS, generateCertRoutine(&gAppCredential));
+            startAppBench(&bench);
+            popGeneratedCert(&gAppCredential, &pRtcCertificate);
+            stopAppBench(&bench, round);
+            TEST_ASSERT_NOT_NULL(pRtcCertificate);
+            freeRtcCertificate_callback(pRtcCertificate);
+        }
+    }
+    reportAppBench(&bench, "popGeneratedCert.hit", "poolDepth", gAppCredential.certPoolDepth, APP_CREDENTIAL_BENCH_KEYGEN_OPS);
+
+    // The pool is drained, and the sdk generates the cert.
+    resetAppBench(&bench);
+    for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+        startAppBench(&bench);
+        for (i = 0; i < APP_CREDENTIAL_BENCH_POP_OPS; i++) {
+            popGeneratedCert(&gAppCredential, &pRtcCertificate);
+        }
+        stopAppBench(&bench, round);
+        TEST_ASSERT_NULL(pRtcCertificate);
+    }
+    reportAppBench(&bench, "popGeneratedCert.miss", "poolDepth", gAppCredential.certPoolDepth, APP_CREDENTIAL_BENCH_POP_OPS);
+}
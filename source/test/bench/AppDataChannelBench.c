@@ -0,0 +1,239 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include "unity.h"
+#include "AppBench.h"
+#include "AppDataChannel.h"
+
+#define APP_DATA_CHANNEL_BENCH_NAME           "bench"
+#define APP_DATA_CHANNEL_BENCH_BYTES          (1024 * 1024)
+#define APP_DATA_CHANNEL_BENCH_FLUSH_EVERY    64
+#define APP_DATA_CHANNEL_BENCH_MAX_CANDIDATES 32
+#define APP_DATA_CHANNEL_BENCH_CANDIDATE_LEN  512
+#define APP_DATA_CHANNEL_BENCH_TIMEOUT        (10 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define APP_DATA_CHANNEL_BENCH_RETRY_DELAY    (1 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define APP_DATA_CHANNEL_BENCH_POLL_DELAY     (50 * HUNDREDS_OF_NANOS_IN_A_MICROSECOND)
+
+typedef struct {
+    PRtcPeerConnection pPeerConnection;
+    MUTEX lock;
+    CHAR candidates[APP_DATA_CHANNEL_BENCH_MAX_CANDIDATES][APP_DATA_CHANNEL_BENCH_CANDIDATE_LEN];
+    UINT32 candidateCount;
+} AppDataChannelBenchPeer, *PAppDataChannelBenchPeer;
+
+static const UINT32 gMessageSizes[] = {64, 256, 1024, 16384};
+static AppDataChannelBenchPeer gOfferer;
+static AppDataChannelBenchPeer gAnswerer;
+static PRtcDataChannel gSendDataChannel;
+static volatile ATOMIC_BOOL gBatched;
+static volatile SIZE_T gReceivedMessages;
+static BYTE gMessage[16384];
+
+/* Called before each test method. */
+void setUp()
+{
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+}
+
+// The candidates are held until both descriptions are set, the main thread adds them to the other peer.
+static VOID onBenchIceCandidate(UINT64 userData, PCHAR candidateJson)
+{
+    PAppDataChannelBenchPeer pPeer = (PAppDataChannelBenchPeer) userData;
+
+    if (candidateJson == NULL) {
+        return;
+    }
+    MUTEX_LOCK(pPeer->lock);
+    if (pPeer->candidateCount < APP_DATA_CHANNEL_BENCH_MAX_CANDIDATES) {
+        STRNCPY(pPeer->candidates[pPeer->candidateCount++], candidateJson, APP_DATA_CHANNEL_BENCH_CANDIDATE_LEN - 1);
+    }
+    MUTEX_UNLOCK(pPeer->lock);
+}
+
+static VOID onBenchMessage(UINT64 userData, PRtcDataChannel pDataChannel, BOOL isBinary, PBYTE pMessage, UINT32 pMessageLen)
+{
+    UINT32 offset = 0, len;
+
+    UNUSED_PARAM(userData);
+    UNUSED_PARAM(pDataChannel);
+    UNUSED_PARAM(isBinary);
+    if (!ATOMIC_LOAD_BOOL(&gBatched)) {
+        ATOMIC_INCREMENT(&gReceivedMessages);
+        return;
+    }
+    while (offset + APP_DATA_CHANNEL_HEADER_LEN <= pMessageLen) {
+        len = ((UINT32) pMessage[offset] << 24) | ((UINT32) pMessage[offset + 1] << 16) | ((UINT32) pMessage[offset + 2] << 8) | pMessage[offset + 3];
+        offset += APP_DATA_CHANNEL_HEADER_LEN + len;
+        ATOMIC_INCREMENT(&gReceivedMessages);
+    }
+}
+
+// The answerer is the app side, it sends into the data channel opened by the offerer.
+static VOID onBenchDataChannel(UINT64 userData, PRtcDataChannel pRtcDataChannel)
+{
+    UNUSED_PARAM(userData);
+    gSendDataChannel = pRtcDataChannel;
+}
+
+static VOID createBenchPeer(PAppDataChannelBenchPeer pPeer)
+{
+    RtcConfiguration configuration;
+
+    MEMSET(&configuration, 0x00, SIZEOF(RtcConfiguration));
+    configuration.iceTransportPolicy = ICE_TRANSPORT_POLICY_ALL;
+    MEMSET(pPeer, 0x00, SIZEOF(AppDataChannelBenchPeer));
+    pPeer->lock = MUTEX_CREATE(FALSE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createPeerConnection(&configuration, &pPeer->pPeerConnection));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, peerConnectionOnIceCandidate(pPeer->pPeerConnection, (UINT64) pPeer, onBenchIceCandidate));
+}
+
+static VOID addBenchCandidates(PAppDataChannelBenchPeer pPeer, PAppDataChannelBenchPeer pRemotePeer)
+{
+    RtcIceCandidateInit iceCandidate;
+    UINT32 i;
+
+    MUTEX_LOCK(pRemotePeer->lock);
+    for (i = 0; i < pRemotePeer->candidateCount; i++) {
+        if (STATUS_SUCCEEDED(deserializeRtcIceCandidateInit(pRemotePeer->candidates[i], STRLEN(pRemotePeer->candidates[i]), &iceCandidate))) {
+            addIceCandidate(pPeer->pPeerConnection, iceCandidate.candidate);
+        }
+    }
+    pRemotePeer->candidateCount = 0;
+    MUTEX_UNLOCK(pRemotePeer->lock);
+}
+
+static VOID connectBenchPeers()
+{
+    RtcSessionDescriptionInit sessionDescriptionInit;
+    PRtcDataChannel pRtcDataChannel = NULL;
+    UINT64 deadline = GETTIME() + APP_DATA_CHANNEL_BENCH_TIMEOUT;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, initKvsWebRtc());
+    createBenchPeer(&gOfferer);
+    createBenchPeer(&gAnswerer);
+    gSendDataChannel = NULL;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, peerConnectionOnDataChannel(gAnswerer.pPeerConnection, 0, onBenchDataChannel));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createDataChannel(gOfferer.pPeerConnection, APP_DATA_CHANNEL_BENCH_NAME, NULL, &pRtcDataChannel));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, dataChannelOnMessage(pRtcDataChannel, 0, onBenchMessage));
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createOffer(gOfferer.pPeerConnection, &sessionDescriptionInit));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setLocalDescription(gOfferer.pPeerConnection, &sessionDescriptionInit));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setRemoteDescription(gAnswerer.pPeerConnection, &sessionDescriptionInit));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAnswer(gAnswerer.pPeerConnection, &sessionDescriptionInit));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setLocalDescription(gAnswerer.pPeerConnection, &sessionDescriptionInit));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setRemoteDescription(gOfferer.pPeerConnection, &sessionDescriptionInit));
+
+    // Trickle the candidates until the answerer sees the data channel.
+    while (gSendDataChannel == NULL && GETTIME() < deadline) {
+        addBenchCandidates(&gOfferer, &gAnswerer);
+        addBenchCandidates(&gAnswerer, &gOfferer);
+        THREAD_SLEEP(APP_DATA_CHANNEL_BENCH_RETRY_DELAY);
+    }
+    TEST_ASSERT_NOT_NULL(gSendDataChannel);
+}
+
+static VOID freeBenchPeer(PAppDataChannelBenchPeer pPeer)
+{
+    closePeerConnection(pPeer->pPeerConnection);
+    freePeerConnection(&pPeer->pPeerConnection);
+    MUTEX_FREE(pPeer->lock);
+}
+
+static VOID waitBenchMessages(UINT32 messageCount)
+{
+    UINT64 deadline = GETTIME() + APP_DATA_CHANNEL_BENCH_TIMEOUT;
+
+    while (ATOMIC_LOAD(&gReceivedMessages) < messageCount && GETTIME() < deadline) {
+        THREAD_SLEEP(APP_DATA_CHANNEL_BENCH_POLL_DELAY);
+    }
+    TEST_ASSERT_EQUAL(messageCount, ATOMIC_LOAD(&gReceivedMessages));
+}
+
+static VOID sendBenchMessagesDirect(UINT32 messageSize, UINT32 messageCount)
+{
+    UINT32 i;
+
+    for (i = 0; i < messageCount; i++) {
+        while (STATUS_FAILED(dataChannelSend(gSendDataChannel, TRUE, gMessage, messageSize))) {
+            THREAD_SLEEP(APP_DATA_CHANNEL_BENCH_RETRY_DELAY);
+        }
+    }
+}
+
+static VOID sendBenchMessagesBatched(PAppDataChannel pAppDataChannel, UINT32 messageSize, UINT32 messageCount)
+{
+    UINT32 i;
+
+    for (i = 0; i < messageCount; i++) {
+        while (sendAppDataChannelMessage(pAppDataChannel, gMessage, messageSize) == STATUS_APP_DATA_CHANNEL_BACKPRESSURE) {
+            if (STATUS_FAILED(flushAppDataChannel(pAppDataChannel))) {
+                THREAD_SLEEP(APP_DATA_CHANNEL_BENCH_RETRY_DELAY);
+            }
+        }
+        if ((i + 1) % APP_DATA_CHANNEL_BENCH_FLUSH_EVERY == 0) {
+            flushAppDataChannel(pAppDataChannel);
+        }
+    }
+    while (STATUS_FAILED(flushAppDataChannel(pAppDataChannel))) {
+        THREAD_SLEEP(APP_DATA_CHANNEL_BENCH_RETRY_DELAY);
+    }
+}
+
+void test_dataChannelSend_loopback(void)
+{
+    AppBench bench;
+    PAppDataChannel pAppDataChannel = NULL;
+    UINT32 i, round, messageSize, messageCount;
+
+    connectBenchPeers();
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppDataChannel(gSendDataChannel, &pAppDataChannel));
+
+    for (i = 0; i < ARRAY_SIZE(gMessageSizes); i++) {
+        messageSize = gMessageSizes[i];
+        messageCount = APP_DATA_CHANNEL_BENCH_BYTES / messageSize;
+
+        // One sctp message per message, as the app sent before the batching.
+        ATOMIC_STORE_BOOL(&gBatched, FALSE);
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            ATOMIC_STORE(&gReceivedMessages, 0);
+            startAppBench(&bench);
+            sendBenchMessagesDirect(messageSize, messageCount);
+            waitBenchMessages(messageCount);
+            stopAppBench(&bench, round);
+        }
+        reportAppBench(&bench, "dataChannelSend.direct", "bytes", messageSize, messageCount);
+
+        // The messages are coalesced into the batches of the queue.
+        ATOMIC_STORE_BOOL(&gBatched, TRUE);
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            ATOMIC_STORE(&gReceivedMessages, 0);
+            startAppBench(&bench);
+            sendBenchMessagesBatched(pAppDataChannel, messageSize, messageCount);
+            waitBenchMessages(messageCount);
+            stopAppBench(&bench, round);
+        }
+        reportAppBench(&bench, "flushAppDataChannel.batched", "bytes", messageSize, messageCount);
+    }
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppDataChannel(&pAppDataChannel));
+    freeBenchPeer(&gOfferer);
+    freeBenchPeer(&gAnswerer);
+    deinitKvsWebRtc();
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include "unity.h"
+#include "AppBench.h"
+#include "AppConfig.h"
+#include "AppHashTableWrap.h"
+#include "mock_Include.h"
+
+#define APP_HASH_TABLE_BENCH_LOOKUPS 10000
+
+static const UINT32 gPeerCounts[] = {10, 100, 1000, 10000};
+static UINT64 gKeys[10000];
+static PHashTable gpHashTable = NULL;
+
+/* Called before each test method. */
+void setUp()
+{
+    CHAR peerId[MAX_SIGNALING_CLIENT_ID_LEN + 1];
+    UINT32 i;
+
+    // The keys are hashed from the peer ids, as the sessions are keyed by the hash of the remote client id.
+    for (i = 0; i < ARRAY_SIZE(gKeys); i++) {
+        SNPRINTF(peerId, SIZEOF(peerId), "bench-peer-%u", i);
+        gKeys[i] = COMPUTE_CRC32((PBYTE) peerId, (UINT32) STRLEN(peerId));
+    }
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    if (gpHashTable != NULL) {
+        appHashTableFree(gpHashTable);
+        gpHashTable = NULL;
+    }
+}
+
+static VOID createAppHashTableBenchPeers(UINT32 peerCount)
+{
+    UINT32 i;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, appHashTableCreateWithParams(APP_HASH_TABLE_BUCKET_COUNT, APP_HASH_TABLE_BUCKET_LENGTH, &gpHashTable));
+    for (i = 0; i < peerCount; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, appHashTablePut(gpHashTable, gKeys[i], i));
+    }
+}
+
+void test_appHashTableGet(void)
+{
+    AppBench bench;
+    UINT64 value = 0;
+    UINT32 i, j, round, peerCount;
+
+    for (i = 0; i < ARRAY_SIZE(gPeerCounts); i++) {
+        peerCount = gPeerCounts[i];
+        createAppHashTableBenchPeers(peerCount);
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            startAppBench(&bench);
+            for (j = 0; j < APP_HASH_TABLE_BENCH_LOOKUPS; j++) {
+                appHashTableGet(gpHashTable, gKeys[j % peerCount], &value);
+            }
+            stopAppBench(&bench, round);
+        }
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, appHashTableFree(gpHashTable));
+        gpHashTable = NULL;
+        reportAppBench(&bench, "appHashTableGet.hit", "peers", peerCount, APP_HASH_TABLE_BENCH_LOOKUPS);
+    }
+}
+
+void test_appHashTableContains(void)
+{
+    AppBench bench;
+    BOOL contains = FALSE;
+    UINT32 i, j, round, peerCount;
+
+    for (i = 0; i < ARRAY_SIZE(gPeerCounts); i++) {
+        peerCount = gPeerCounts[i];
+        createAppHashTableBenchPeers(peerCount);
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            startAppBench(&bench);
+            for (j = 0; j < APP_HASH_TABLE_BENCH_LOOKUPS; j++) {
+                // The keys of the other peers are not in the table, so every lookup walks a whole bucket.
+                appHashTableContains(gpHashTable, ~gKeys[j % peerCount], &contains);
+            }
+            stopAppBench(&bench, round);
+        }
+        TEST_ASSERT_FALSE(contains);
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, appHashTableFree(gpHashTable));
+        gpHashTable = NULL;
+        reportAppBench(&bench, "appHashTableContains.miss", "peers", peerCount, APP_HASH_TABLE_BENCH_LOOKUPS);
+    }
+}
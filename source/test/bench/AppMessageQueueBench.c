@@ -0,0 +1,154 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include "unity.h"
+#include "AppBench.h"
+#include "AppMessageQueue.h"
+#include "mock_Include.h"
+
+#define APP_MESSAGE_QUEUE_BENCH_MAX_LOOKUPS 1000
+#define APP_MESSAGE_QUEUE_BENCH_HASH(i)     ((UINT64) (i) *2654435761ULL + 1)
+
+static const UINT32 gPeerCounts[] = {10, 100, 1000, 10000};
+static ReceivedSignalingMessage gReceivedSignalingMessage;
+static PPendingMessageQueue gPendingMsgQs[10000];
+
+/* Called before each test method. */
+void setUp()
+{
+    gReceivedSignalingMessage.signalingMessage.messageType = SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE;
+    gReceivedSignalingMessage.signalingMessage.payloadLen = 256;
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+}
+
+static VOID createAppMessageQueueBenchPeers(PConnectionMsgQ* ppConnectionMsgQ, UINT32 peerCount)
+{
+    UINT32 i;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createConnectionMsqQ(ppConnectionMsgQ));
+    for (i = 0; i < peerCount; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, createPendingMsgQ(*ppConnectionMsgQ, APP_MESSAGE_QUEUE_BENCH_HASH(i), &gPendingMsgQs[i]));
+    }
+}
+
+void test_createPendingMsgQ(void)
+{
+    AppBench bench;
+    PConnectionMsgQ pConnectionMsgQ = NULL;
+    UINT32 i, j, round, peerCount;
+
+    for (i = 0; i < ARRAY_SIZE(gPeerCounts); i++) {
+        peerCount = gPeerCounts[i];
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            TEST_ASSERT_EQUAL(STATUS_SUCCESS, createConnectionMsqQ(&pConnectionMsgQ));
+            startAppBench(&bench);
+            for (j = 0; j < peerCount; j++) {
+                createPendingMsgQ(pConnectionMsgQ, APP_MESSAGE_QUEUE_BENCH_HASH(j), &gPendingMsgQs[j]);
+            }
+            stopAppBench(&bench, round);
+            TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeConnectionMsgQ(&pConnectionMsgQ));
+        }
+        reportAppBench(&bench, "createPendingMsgQ", "peers", peerCount, peerCount);
+    }
+}
+
+void test_pushMsqIntoPendingMsgQ(void)
+{
+    AppBench bench;
+    PConnectionMsgQ pConnectionMsgQ = NULL;
+    UINT32 i, j, round, peerCount;
+
+    for (i = 0; i < ARRAY_SIZE(gPeerCounts); i++) {
+        peerCount = gPeerCounts[i];
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            createAppMessageQueueBenchPeers(&pConnectionMsgQ, peerCount);
+            startAppBench(&bench);
+            for (j = 0; j < peerCount; j++) {
+                pushMsqIntoPendingMsgQ(gPendingMsgQs[j], &gReceivedSignalingMessage);
+            }
+            stopAppBench(&bench, round);
+            TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeConnectionMsgQ(&pConnectionMsgQ));
+        }
+        reportAppBench(&bench, "pushMsqIntoPendingMsgQ", "peers", peerCount, peerCount);
+    }
+}
+
+void test_getPendingMsgQByHashVal(void)
+{
+    AppBench bench;
+    PConnectionMsgQ pConnectionMsgQ = NULL;
+    PPendingMessageQueue pPendingMsgQ = NULL;
+    UINT32 i, j, round, peerCount, lookupCount;
+
+    for (i = 0; i < ARRAY_SIZE(gPeerCounts); i++) {
+        peerCount = gPeerCounts[i];
+        // The lookup walks the queue, so the lookups are spread over the peers instead of visiting all of them.
+        lookupCount = MIN(peerCount, APP_MESSAGE_QUEUE_BENCH_MAX_LOOKUPS);
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            createAppMessageQueueBenchPeers(&pConnectionMsgQ, peerCount);
+            startAppBench(&bench);
+            for (j = 0; j < lookupCount; j++) {
+                getPendingMsgQByHashVal(pConnectionMsgQ, APP_MESSAGE_QUEUE_BENCH_HASH((UINT64) j * peerCount / lookupCount), FALSE, &pPendingMsgQ);
+            }
+            stopAppBench(&bench, round);
+            TEST_ASSERT_NOT_NULL(pPendingMsgQ);
+            TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeConnectionMsgQ(&pConnectionMsgQ));
+        }
+        reportAppBench(&bench, "getPendingMsgQByHashVal", "peers", peerCount, lookupCount);
+    }
+}
+
+void test_removeExpiredPendingMsgQ(void)
+{
+    AppBench bench;
+    PConnectionMsgQ pConnectionMsgQ = NULL;
+    UINT32 i, j, round, peerCount;
+
+    for (i = 0; i < ARRAY_SIZE(gPeerCounts); i++) {
+        peerCount = gPeerCounts[i];
+
+        // The periodic scan of pollApp when no queue expires.
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            createAppMessageQueueBenchPeers(&pConnectionMsgQ, peerCount);
+            startAppBench(&bench);
+            removeExpiredPendingMsgQ(pConnectionMsgQ, APP_PENDING_MESSAGE_CLEANUP_DURATION);
+            stopAppBench(&bench, round);
+            TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeConnectionMsgQ(&pConnectionMsgQ));
+        }
+        reportAppBench(&bench, "removeExpiredPendingMsgQ.scan", "peers", peerCount, peerCount);
+
+        // Every queue expires and is freed with its message.
+        resetAppBench(&bench);
+        for (round = 0; round < APP_BENCH_ROUNDS; round++) {
+            createAppMessageQueueBenchPeers(&pConnectionMsgQ, peerCount);
+            for (j = 0; j < peerCount; j++) {
+                pushMsqIntoPendingMsgQ(gPendingMsgQs[j], &gReceivedSignalingMessage);
+                gPendingMsgQs[j]->createTime = 0;
+            }
+            startAppBench(&bench);
+            removeExpiredPendingMsgQ(pConnectionMsgQ, APP_PENDING_MESSAGE_CLEANUP_DURATION);
+            stopAppBench(&bench, round);
+            TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeConnectionMsgQ(&pConnectionMsgQ));
+        }
+        reportAppBench(&bench, "removeExpiredPendingMsgQ.expired", "peers", peerCount, peerCount);
+    }
+}
@@ -58,8 +58,15 @@ typedef struct {
     UINT64 getIceCandidatePairStatsCallbackUserData;
     TimerQueueCallback getIceCandidatePairStatsCallback;
 
-    UINT64 pregenerateCertTimerCallbackUserData;
-    TimerQueueCallback pregenerateCertTimerCallback;
+    UINT64 flushAppDataChannelsCallbackUserData;
+    TimerQueueCallback flushAppDataChannelsCallback;
+
+    UINT64 serveAppReplaysCallbackUserData;
+    TimerQueueCallback serveAppReplaysCallback;
+    UINT32 serveAppReplaysTimerCount;
+
+    UINT64 replayOnMessageUData;
+    RtcOnMessage replayOnMessage;
 
     MediaSinkHook mediaSinkHook;
     PVOID mediaSinkHookUdata;
@@ -70,6 +77,9 @@ typedef struct {
     UINT64 rtcOnConnectionStateChangeUData;
     RtcOnConnectionStateChange rtcOnConnectionStateChange;
 
+    UINT64 rtcOnDataChannelUData;
+    RtcOnDataChannel rtcOnDataChannel;
+
     UINT64 rtcOnBandwidthEstimationUData;
     RtcOnBandwidthEstimation rtcOnBandwidthEstimation;
 
@@ -83,6 +93,8 @@ static HashTable mRemoteRtcPeerConnections;
 static RtcStats mRtcIceCandidatePairMetrics;
 static ConnectionMsgQ mConnectionMsgQ;
 static PendingMessageQueue mPendingMsgQ;
+static RtcRtpTransceiver mVideoRtcRtpTransceiver;
+static RtcRtpTransceiver mAudioRtcRtpTransceiver;
 static memCalloc BackGlobalMemCalloc;
 static createMutex BackGlobalCreateMutex;
 
@@ -203,18 +215,26 @@ static STATUS appTimeQueueAdd_getIceCandidatePairStats_callback(TIMER_QUEUE_HAND
                                                                 TimerCallbackFunc timerCallbackFn, UINT64 customData, PUINT32 pIndex)
 {
     PAppCommonMock pAppCommonMock = getAppCommonMock();
-    pAppCommonMock->getIceCandidatePairStatsCallback = timerCallbackFn;
-    pAppCommonMock->getIceCandidatePairStatsCallbackUserData = customData;
+    // the data channel timer is added with the stats timer.
+    if (period == APP_DATA_CHANNEL_FLUSH_PERIOD) {
+        pAppCommonMock->flushAppDataChannelsCallback = timerCallbackFn;
+        pAppCommonMock->flushAppDataChannelsCallbackUserData = customData;
+    } else if (period == APP_REPLAY_SERVE_PERIOD) {
+        // the replay timer is added by the replay requests.
+        pAppCommonMock->serveAppReplaysCallback = timerCallbackFn;
+        pAppCommonMock->serveAppReplaysCallbackUserData = customData;
+        pAppCommonMock->serveAppReplaysTimerCount++;
+    } else {
+        pAppCommonMock->getIceCandidatePairStatsCallback = timerCallbackFn;
+        pAppCommonMock->getIceCandidatePairStatsCallbackUserData = customData;
+    }
     *pIndex = 1;
     return STATUS_SUCCESS;
 }
 
-static STATUS appTimeQueueAdd_pregenerateCertTimer_callback(TIMER_QUEUE_HANDLE handle, UINT64 start, UINT64 period, TimerCallbackFunc timerCallbackFn,
-                                                            UINT64 customData, PUINT32 pIndex)
+static STATUS appTimeQueueAdd_callback(TIMER_QUEUE_HANDLE handle, UINT64 start, UINT64 period, TimerCallbackFunc timerCallbackFn, UINT64 customData,
+                                       PUINT32 pIndex)
 {
-    PAppCommonMock pAppCommonMock = getAppCommonMock();
-    pAppCommonMock->pregenerateCertTimerCallback = timerCallbackFn;
-    pAppCommonMock->pregenerateCertTimerCallbackUserData = customData;
     *pIndex = 1;
     return STATUS_SUCCESS;
 }
@@ -278,48 +298,40 @@ static void prepareRtcMetrics(PAppConfiguration pAppConfiguration)
 {
     PAppCommonMock pAppCommonMock = getAppCommonMock();
     PRtcStats pRtcIceCandidatePairMetrics = pAppCommonMock->pRtcIceCandidatePairMetrics;
+    PStreamingSession pStreamingSession;
+    PAppSessionStats pStats, pPrevStats = NULL;
     UINT32 i;
 
+    // The published stats are the previous sample of each session.
     for (i = 0; i < pAppConfiguration->streamingSessionCount; ++i) {
+        pStreamingSession = pAppConfiguration->streamingSessionList[i];
+        pStats = &pStreamingSession->stats[pStreamingSession->statsGeneration % ARRAY_SIZE(pStreamingSession->stats)];
         if (i == 0) {
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevTs = 10 * HUNDREDS_OF_NANOS_IN_A_SECOND;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsSent = 0;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsReceived = 0;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesSent = 0;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesReceived = 0;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevPacketsDiscardedOnSend = 0;
+            memset(pStats, 0, sizeof(AppSessionStats));
+            pStats->timestamp = 10 * HUNDREDS_OF_NANOS_IN_A_SECOND;
         } else {
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevTs =
-                pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevTs + 1 * HUNDREDS_OF_NANOS_IN_A_SECOND;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsSent =
-                pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevNumberOfPacketsSent + 1;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsReceived =
-                pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevNumberOfPacketsReceived + 1;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesSent =
-                pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevNumberOfBytesSent + 1;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesReceived =
-                pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevNumberOfBytesReceived + 1;
-            pAppConfiguration->streamingSessionList[i]->rtcMetricsHistory.prevPacketsDiscardedOnSend =
-                pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevPacketsDiscardedOnSend + 1;
+            pStats->timestamp = pPrevStats->timestamp + 1 * HUNDREDS_OF_NANOS_IN_A_SECOND;
+            pStats->packetsSent = pPrevStats->packetsSent + 1;
+            pStats->packetsReceived = pPrevStats->packetsReceived + 1;
+            pStats->bytesSent = pPrevStats->bytesSent + 1;
+            pStats->bytesReceived = pPrevStats->bytesReceived + 1;
+            pStats->packetsDiscardedOnSend = pPrevStats->packetsDiscardedOnSend + 1;
         }
+        pPrevStats = pStats;
     }
+    pStreamingSession = pAppConfiguration->streamingSessionList[i / 2];
     memset(pAppCommonMock->pRtcIceCandidatePairMetrics, 0, sizeof(RtcStats));
-    pRtcIceCandidatePairMetrics->timestamp =
-        pAppConfiguration->streamingSessionList[i / 2]->rtcMetricsHistory.prevTs + 1 * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    pStats = &pStreamingSession->stats[pStreamingSession->statsGeneration % ARRAY_SIZE(pStreamingSession->stats)];
+    pRtcIceCandidatePairMetrics->timestamp = pStats->timestamp + 1 * HUNDREDS_OF_NANOS_IN_A_SECOND;
     memcpy(pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.localCandidateId, "local", strlen("local"));
     memcpy(pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.remoteCandidateId, "remote", strlen("remote"));
     pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.state = ICE_CANDIDATE_PAIR_STATE_SUCCEEDED;
     pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.nominated = FALSE;
-    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.packetsSent =
-        pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevNumberOfPacketsSent + 1;
-    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.packetsReceived =
-        pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevNumberOfPacketsReceived + 1;
-    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.bytesSent =
-        pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevNumberOfBytesSent + 1;
-    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.bytesReceived =
-        pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevNumberOfBytesReceived + 1;
-    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.packetsDiscardedOnSend =
-        pAppConfiguration->streamingSessionList[i - 1]->rtcMetricsHistory.prevPacketsDiscardedOnSend + 1;
+    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.packetsSent = pPrevStats->packetsSent + 1;
+    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.packetsReceived = pPrevStats->packetsReceived + 1;
+    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.bytesSent = pPrevStats->bytesSent + 1;
+    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.bytesReceived = pPrevStats->bytesReceived + 1;
+    pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.packetsDiscardedOnSend = pPrevStats->packetsDiscardedOnSend + 1;
     pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.currentRoundTripTime = 10;
     pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.responsesReceived = 10;
 }
@@ -335,6 +347,21 @@ static STATUS rtcPeerConnectionGetMetrics_callback(PRtcPeerConnection pRtcPeerCo
     return STATUS_SUCCESS;
 }
 
+static STATUS getRtpQualityStats_lossy_callback(PRtcPeerConnection pRtcPeerConnection, PRtcRtpTransceiver pRtcRtpTransceiver,
+                                                PAppRtpQualityStats pQualityStats)
+{
+    pQualityStats->nackCount += 100;
+    pQualityStats->fractionLost = 0.2;
+    pQualityStats->remoteReported = TRUE;
+    return STATUS_SUCCESS;
+}
+
+static STATUS getRtpQualityStats_dropout_callback(PRtcPeerConnection pRtcPeerConnection, PRtcRtpTransceiver pRtcRtpTransceiver,
+                                                 PAppRtpQualityStats pQualityStats)
+{
+    return STATUS_APP_METRICS_OUTBOUND_RTP;
+}
+
 static STATUS logIceServerStats_callback(PRtcPeerConnection pRtcPeerConnection, UINT32 index, int NumCalls)
 {
     if (NumCalls % 5 == 0) {
@@ -372,6 +399,14 @@ static STATUS addTransceiver_callback(PRtcPeerConnection pPeerConnection, PRtcMe
     return STATUS_SUCCESS;
 }
 
+static STATUS addTransceiver_track_callback(PRtcPeerConnection pPeerConnection, PRtcMediaStreamTrack pRtcMediaStreamTrack,
+                                            PRtcRtpTransceiverInit pRtcRtpTransceiverInit, PRtcRtpTransceiver* ppRtcRtpTransceiver, int NumCalls)
+{
+    *ppRtcRtpTransceiver =
+        pRtcMediaStreamTrack->kind == MEDIA_STREAM_TRACK_KIND_VIDEO ? &mVideoRtcRtpTransceiver : &mAudioRtcRtpTransceiver;
+    return STATUS_SUCCESS;
+}
+
 static STATUS transceiverOnBandwidthEstimation_return_callback(PRtcRtpTransceiver pRtcRtpTransceiver, UINT64 customData,
                                                                RtcOnBandwidthEstimation rtcOnBandwidthEstimation, int NumCalls)
 {
@@ -397,6 +432,46 @@ static STATUS peerConnectionOnConnectionStateChange_callback(PRtcPeerConnection
     return STATUS_SUCCESS;
 }
 
+static STATUS peerConnectionOnDataChannel_callback(PRtcPeerConnection pRtcPeerConnection, UINT64 customData, RtcOnDataChannel rtcOnDataChannel)
+{
+    PAppCommonMock pAppCommonMock = getAppCommonMock();
+    pAppCommonMock->rtcOnDataChannel = rtcOnDataChannel;
+    pAppCommonMock->rtcOnDataChannelUData = customData;
+    return STATUS_SUCCESS;
+}
+
+static STATUS createAppDataChannel_callback(PRtcDataChannel pRtcDataChannel, PAppDataChannel* ppAppDataChannel)
+{
+    static AppDataChannel appDataChannel;
+    appDataChannel.pRtcDataChannel = pRtcDataChannel;
+    *ppAppDataChannel = &appDataChannel;
+    return STATUS_SUCCESS;
+}
+
+static STATUS createAppDataChannelProbe_callback(PRtcDataChannel pRtcDataChannel, AppDataChannelProbeHook hook, PVOID udata,
+                                                 PAppDataChannelProbe* ppAppDataChannelProbe)
+{
+    static AppDataChannelProbe appDataChannelProbe;
+    appDataChannelProbe.pRtcDataChannel = pRtcDataChannel;
+    appDataChannelProbe.hook = hook;
+    appDataChannelProbe.udata = udata;
+    *ppAppDataChannelProbe = &appDataChannelProbe;
+    return STATUS_SUCCESS;
+}
+
+static STATUS dataChannelOnMessage_replay_callback(PRtcDataChannel pRtcDataChannel, UINT64 customData, RtcOnMessage rtcOnMessage)
+{
+    PAppCommonMock pAppCommonMock = getAppCommonMock();
+    pAppCommonMock->replayOnMessage = rtcOnMessage;
+    pAppCommonMock->replayOnMessageUData = customData;
+    return STATUS_SUCCESS;
+}
+
+static STATUS appCommonUTestWriter(PVOID udata, PBYTE pBuffer, UINT32 size)
+{
+    return STATUS_SUCCESS;
+}
+
 static STATUS transceiverOnBandwidthEstimation_callback(PRtcRtpTransceiver pRtcRtpTransceiver, UINT64 customData,
                                                         RtcOnBandwidthEstimation rtcOnBandwidthEstimation)
 {
@@ -534,21 +609,15 @@ void test_initApp(void)
 
     setenv(DEFAULT_REGION_ENV_VAR, APP_COMMON_UTEST_REGION_ENV_VAR, 1);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_IgnoreAndReturn(STATUS_NULL_ARG);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_APP_CREDENTIAL_CERT_WORKER);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
-    TEST_ASSERT_EQUAL(STATUS_NULL_ARG, retStatus);
+    TEST_ASSERT_EQUAL(STATUS_APP_CREDENTIAL_CERT_WORKER, retStatus);
 
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
-    retStatus = pAppCommonMock->pregenerateCertTimerCallback(0, 0, (UINT64) NULL);
-    TEST_ASSERT_EQUAL(STATUS_APP_COMMON_NULL_ARG, retStatus);
-
-    generateCertRoutine_IgnoreAndReturn(STATUS_SUCCESS);
-    retStatus = pAppCommonMock->pregenerateCertTimerCallback(0, 0, (UINT64) pAppCommonMock->pregenerateCertTimerCallbackUserData);
-    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
-
     appTimerQueueCancel_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = freeApp(&pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
@@ -575,7 +644,8 @@ void test_initApp_setupFileLogging(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -631,7 +701,8 @@ void test_initApp_null_mutex_case1(void)
     setupFileLogging_StubWithCallback(setupFileLogging_callback);
     createCredential_IgnoreAndReturn(STATUS_SUCCESS);
 
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     BackGlobalCreateMutex = globalCreateMutex;
     globalCreateMutex = null_createMutex_case1;
 
@@ -669,7 +740,8 @@ void test_initApp_null_mutex_case2(void)
     setupFileLogging_StubWithCallback(setupFileLogging_callback);
     createCredential_IgnoreAndReturn(STATUS_SUCCESS);
 
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     BackGlobalCreateMutex = globalCreateMutex;
     globalCreateMutex = null_createMutex_case2;
 
@@ -711,7 +783,8 @@ void test_runApp(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -762,7 +835,8 @@ void test_signalingStateChangeFn(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -810,7 +884,8 @@ void test_signalingErrorReportFn(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -875,7 +950,8 @@ void test_signalingMessageReceivedFn_offer_before_candidate_non_trickle(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -932,10 +1008,16 @@ void test_signalingMessageReceivedFn_offer_before_candidate_non_trickle(void)
     TEST_ASSERT_EQUAL(STATUS_NULL_ARG, retStatus);
 
     peerConnectionOnDataChannel_IgnoreAndReturn(STATUS_SUCCESS);
+    // the media source has neither track.
     queryMediaVideoCap_IgnoreAndReturn(STATUS_MEDIA_NOT_EXISTED);
+    queryMediaAudioCap_IgnoreAndReturn(STATUS_MEDIA_NOT_EXISTED);
     retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
     TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_EXISTED, retStatus);
 
+    queryMediaVideoCap_IgnoreAndReturn(STATUS_MEDIA_NOT_READY);
+    retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_READY, retStatus);
+
     queryMediaVideoCap_IgnoreAndReturn(STATUS_SUCCESS);
     addSupportedCodec_IgnoreAndReturn(STATUS_NULL_ARG);
     retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
@@ -952,9 +1034,9 @@ void test_signalingMessageReceivedFn_offer_before_candidate_non_trickle(void)
     TEST_ASSERT_EQUAL(STATUS_NULL_ARG, retStatus);
 
     transceiverOnBandwidthEstimation_IgnoreAndReturn(STATUS_SUCCESS);
-    queryMediaAudioCap_IgnoreAndReturn(STATUS_MEDIA_NOT_EXISTED);
+    queryMediaAudioCap_IgnoreAndReturn(STATUS_MEDIA_NOT_READY);
     retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
-    TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_EXISTED, retStatus);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_READY, retStatus);
 
     queryMediaAudioCap_IgnoreAndReturn(STATUS_SUCCESS);
     addSupportedCodec_StubWithCallback(addSupportedCodec_callback);
@@ -1095,7 +1177,8 @@ void test_signalingMessageReceivedFn_offer_before_candidate_trickle(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -1152,10 +1235,16 @@ void test_signalingMessageReceivedFn_offer_before_candidate_trickle(void)
     TEST_ASSERT_EQUAL(STATUS_NULL_ARG, retStatus);
 
     peerConnectionOnDataChannel_IgnoreAndReturn(STATUS_SUCCESS);
+    // the media source has neither track.
     queryMediaVideoCap_IgnoreAndReturn(STATUS_MEDIA_NOT_EXISTED);
+    queryMediaAudioCap_IgnoreAndReturn(STATUS_MEDIA_NOT_EXISTED);
     retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
     TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_EXISTED, retStatus);
 
+    queryMediaVideoCap_IgnoreAndReturn(STATUS_MEDIA_NOT_READY);
+    retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_READY, retStatus);
+
     queryMediaVideoCap_IgnoreAndReturn(STATUS_SUCCESS);
     addSupportedCodec_IgnoreAndReturn(STATUS_NULL_ARG);
     retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
@@ -1172,9 +1261,9 @@ void test_signalingMessageReceivedFn_offer_before_candidate_trickle(void)
     TEST_ASSERT_EQUAL(STATUS_NULL_ARG, retStatus);
 
     transceiverOnBandwidthEstimation_IgnoreAndReturn(STATUS_SUCCESS);
-    queryMediaAudioCap_IgnoreAndReturn(STATUS_MEDIA_NOT_EXISTED);
+    queryMediaAudioCap_IgnoreAndReturn(STATUS_MEDIA_NOT_READY);
     retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
-    TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_EXISTED, retStatus);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_READY, retStatus);
 
     queryMediaAudioCap_IgnoreAndReturn(STATUS_SUCCESS);
     addSupportedCodec_StubWithCallback(addSupportedCodec_callback);
@@ -1224,9 +1313,11 @@ void test_signalingMessageReceivedFn_offer_before_candidate_trickle(void)
     TEST_ASSERT_EQUAL(STATUS_NULL_ARG, retStatus);
 
     serializeSessionDescriptionInit_IgnoreAndReturn(STATUS_SUCCESS);
-    sendAppSignalingMessage_IgnoreAndReturn(STATUS_APP_SIGNALING_NULL_ARG);
+    sendAppSignalingMessage_IgnoreAndReturn(STATUS_APP_SIGNALING_SEND);
     retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
-    TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_NULL_ARG, retStatus);
+    TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_SEND, retStatus);
+    // the session of a lost answer is left to the main loop.
+    TEST_ASSERT_TRUE(ATOMIC_LOAD_BOOL(&pAppConfiguration->streamingSessionList[pAppConfiguration->streamingSessionCount - 1]->terminateFlag));
 
     sendAppSignalingMessage_IgnoreAndReturn(STATUS_SUCCESS);
     appHashTablePut_IgnoreAndReturn(STATUS_HASH_KEY_ALREADY_PRESENT);
@@ -1307,7 +1398,8 @@ void test_signalingMessageReceivedFn_two_same_offers_coming(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -1396,7 +1488,8 @@ void test_signalingMessageReceivedFn_createStreamingSession_null(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -1488,7 +1581,8 @@ void test_signalingMessageReceivedFn_11_offers_coming(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -1581,7 +1675,8 @@ void test_signalingMessageReceivedFn_offer_with_null_cert(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -1670,7 +1765,8 @@ void test_signalingMessageReceivedFn_freeStreamingSession_case1(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -1755,7 +1851,8 @@ void test_signalingMessageReceivedFn_freeStreamingSession_case2(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -1834,7 +1931,8 @@ void test_getIceCandidatePairStatsCallback_cancel_fail(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -1936,6 +2034,8 @@ void test_getIceCandidatePairStatsCallback(void)
     PAppSignaling pAppSignaling;
     ReceivedSignalingMessage receivedSignalingMessage;
     PReceivedSignalingMessage pReceivedSignalingMessage = &receivedSignalingMessage;
+    AppSessionStats sessionStats;
+    PStreamingSession pStreamingSession;
 
     setenv(APP_WEBRTC_CHANNEL, pAppCommonMock->channelName, 1);
     getLogLevel_IgnoreAndReturn(LOG_LEVEL_WARN);
@@ -1950,7 +2050,8 @@ void test_getIceCandidatePairStatsCallback(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2015,6 +2116,52 @@ void test_getIceCandidatePairStatsCallback(void)
     rtcPeerConnectionGetMetrics_StubWithCallback(rtcPeerConnectionGetMetrics_callback);
     retStatus = pAppCommonMock->getIceCandidatePairStatsCallback(0, 0, pAppCommonMock->getIceCandidatePairStatsCallbackUserData);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    // The new sample is published, and the references of the snapshot are released.
+    retStatus = getStreamingSessionStats(NULL, &sessionStats);
+    TEST_ASSERT_EQUAL(STATUS_APP_COMMON_NULL_ARG, retStatus);
+    retStatus = getStreamingSessionStats(pAppConfiguration->streamingSessionList[0], &sessionStats);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(pAppCommonMock->pRtcIceCandidatePairMetrics->timestamp, sessionStats.timestamp);
+    TEST_ASSERT_EQUAL(10, sessionStats.roundTripTime);
+    TEST_ASSERT_EQUAL(1, pAppConfiguration->streamingSessionList[0]->refCount);
+    // The packets discarded on send blame the gateway instead of the link of the viewer.
+    TEST_ASSERT_EQUAL(APP_SESSION_LINK_STATE_GATEWAY_OVERLOADED, sessionStats.linkState);
+
+    // The loss reported by the viewer backs the send budget off, and the media hook holds the video to it.
+    pStreamingSession = pAppConfiguration->streamingSessionList[0];
+    pStreamingSession->pVideoRtcRtpTransceiver = (PRtcRtpTransceiver) pAppCommonMock;
+    prepareRtcMetrics(pAppConfiguration);
+    pAppCommonMock->pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.packetsDiscardedOnSend = 0;
+    pAppCommonMock->pRtcIceCandidatePairMetrics->rtcStatsObject.iceCandidatePairStats.bytesSent = 10 * 1024 * 1024;
+    getRtpQualityStats_StubWithCallback(getRtpQualityStats_lossy_callback);
+    retStatus = pAppCommonMock->getIceCandidatePairStatsCallback(0, 0, pAppCommonMock->getIceCandidatePairStatsCallbackUserData);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = getStreamingSessionStats(pStreamingSession, &sessionStats);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(APP_SESSION_LINK_STATE_LOSSY, sessionStats.linkState);
+    TEST_ASSERT_EQUAL(100, sessionStats.nackRate);
+    TEST_ASSERT_TRUE(sessionStats.sendBudget < sessionStats.outgoingBitrate);
+    TEST_ASSERT_EQUAL((SIZE_T) sessionStats.sendBudget, ATOMIC_LOAD(&pStreamingSession->sendBudget));
+
+    // A transceiver which misses a sample keeps its counters, so the nacks are not counted again when it reports.
+    pAppCommonMock->pRtcIceCandidatePairMetrics->timestamp += 1 * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    getRtpQualityStats_StubWithCallback(getRtpQualityStats_dropout_callback);
+    retStatus = pAppCommonMock->getIceCandidatePairStatsCallback(0, 0, pAppCommonMock->getIceCandidatePairStatsCallbackUserData);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = getStreamingSessionStats(pStreamingSession, &sessionStats);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(0, sessionStats.nackRate);
+    TEST_ASSERT_EQUAL(100, sessionStats.videoRtpStats.nackCount);
+    TEST_ASSERT_EQUAL(100, sessionStats.rtpStats.nackCount);
+
+    pAppCommonMock->pRtcIceCandidatePairMetrics->timestamp += 1 * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    getRtpQualityStats_StubWithCallback(getRtpQualityStats_lossy_callback);
+    retStatus = pAppCommonMock->getIceCandidatePairStatsCallback(0, 0, pAppCommonMock->getIceCandidatePairStatsCallbackUserData);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = getStreamingSessionStats(pStreamingSession, &sessionStats);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(0, sessionStats.nackRate);
+    pStreamingSession->pVideoRtcRtpTransceiver = NULL;
 
     appHashTableContains_StubWithCallback(appHashTableContains_yes_callback);
     appHashTableGet_IgnoreAndReturn(STATUS_NULL_ARG);
@@ -2065,7 +2212,8 @@ void test_signalingMessageReceivedFn_candidate_non_trickle(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2163,7 +2311,8 @@ void test_signalingMessageReceivedFn_offer_after_candidate_non_trickle(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2263,7 +2412,8 @@ void test_signalingMessageReceivedFn_offer_after_candidate_non_trickl_pic(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2359,7 +2509,8 @@ void test_signalingMessageReceivedFn_answer(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2445,7 +2596,8 @@ void test_onIceCandidateHandler_trickle(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2537,7 +2689,8 @@ void test_onIceCandidateHandler_trickle_error(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2640,7 +2793,8 @@ void test_onIceCandidateHandler_non_trickle(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2730,7 +2884,8 @@ void test_onIceCandidateHandler_non_trickle_error(void)
     linkMeidaSinkHook_IgnoreAndReturn(STATUS_SUCCESS);
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -2824,6 +2979,8 @@ void test_onMediaHook(void)
     PStreamingSession pStreamingSession;
     Frame frame;
     PFrame pFrame = &frame;
+    MediaFrameTiming timing;
+    PAppMetric pMetrics;
 
     setenv(APP_WEBRTC_CHANNEL, pAppCommonMock->channelName, 1);
     getLogLevel_IgnoreAndReturn(LOG_LEVEL_WARN);
@@ -2860,7 +3017,7 @@ void test_onMediaHook(void)
     peerConnectionOnDataChannel_IgnoreAndReturn(STATUS_SUCCESS);
     queryMediaVideoCap_IgnoreAndReturn(STATUS_SUCCESS);
     addSupportedCodec_IgnoreAndReturn(STATUS_SUCCESS);
-    addTransceiver_IgnoreAndReturn(STATUS_SUCCESS);
+    addTransceiver_StubWithCallback(addTransceiver_track_callback);
     transceiverOnBandwidthEstimation_IgnoreAndReturn(STATUS_SUCCESS);
     queryMediaAudioCap_IgnoreAndReturn(STATUS_SUCCESS);
     deserializeSessionDescriptionInit_IgnoreAndReturn(STATUS_SUCCESS);
@@ -2883,13 +3040,18 @@ void test_onMediaHook(void)
     ATOMIC_STORE_BOOL(&pStreamingSession->candidateGatheringDone, FALSE);
     pAppCommonMock->rtcOnIceCandidateHandler((UINT64) pStreamingSession, NULL);
     TEST_ASSERT_EQUAL(ATOMIC_LOAD_BOOL(&pStreamingSession->candidateGatheringDone), TRUE);
+    // The setup events are stamped once, and the answer of non-trickle ice follows the end of the gathering.
+    TEST_ASSERT_NOT_EQUAL(0, pStreamingSession->timeline[APP_SESSION_EVENT_OFFER_RECEIVED]);
+    TEST_ASSERT_NOT_EQUAL(0, pStreamingSession->timeline[APP_SESSION_EVENT_REMOTE_DESCRIPTION_SET]);
+    TEST_ASSERT_TRUE(pStreamingSession->timeline[APP_SESSION_EVENT_ANSWER_SENT] >= pStreamingSession->timeline[APP_SESSION_EVENT_GATHERING_DONE]);
+    TEST_ASSERT_EQUAL(1, pAppConfiguration->pMetricsRegistry->metrics[pAppConfiguration->setupMetricIds[APP_SESSION_EVENT_ANSWER_SENT]].count);
 
-    retStatus = pAppCommonMock->mediaSinkHook(NULL, pFrame);
+    retStatus = pAppCommonMock->mediaSinkHook(NULL, pFrame, NULL);
     TEST_ASSERT_EQUAL(STATUS_APP_COMMON_NULL_ARG, retStatus);
 
     pFrame->flags = FRAME_FLAG_NONE;
     pFrame->trackId = DEFAULT_VIDEO_TRACK_ID;
-    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame);
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     TEST_ASSERT_EQUAL(pStreamingSession->firstKeyFrame, FALSE);
     TEST_ASSERT_EQUAL(pFrame->index, 0);
@@ -2897,41 +3059,91 @@ void test_onMediaHook(void)
     writeFrame_IgnoreAndReturn(STATUS_SRTP_NOT_READY_YET);
     pFrame->flags = FRAME_FLAG_KEY_FRAME;
     pFrame->trackId = DEFAULT_VIDEO_TRACK_ID;
-    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame);
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     TEST_ASSERT_EQUAL(pStreamingSession->firstKeyFrame, TRUE);
     TEST_ASSERT_EQUAL(pFrame->index, 0);
+    TEST_ASSERT_EQUAL(0, pStreamingSession->timeline[APP_SESSION_EVENT_FIRST_KEY_FRAME]);
 
     writeFrame_IgnoreAndReturn(STATUS_SUCCESS);
     pFrame->flags = FRAME_FLAG_KEY_FRAME;
     pFrame->trackId = DEFAULT_VIDEO_TRACK_ID;
-    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame);
+    timing.sinkEntryTime = GETTIME();
+    timing.mappedTime = timing.sinkEntryTime + HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+    timing.clockOffset = 5 * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, &timing);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     TEST_ASSERT_EQUAL(pStreamingSession->firstKeyFrame, TRUE);
     TEST_ASSERT_EQUAL(pFrame->index, 1);
+    // The frame latencies are recorded per track and per session.
+    pMetrics = pAppConfiguration->pMetricsRegistry->metrics;
+    TEST_ASSERT_EQUAL(1, pMetrics[pAppConfiguration->videoMetrics.mapMetricId].count);
+    TEST_ASSERT_EQUAL(5, pMetrics[pAppConfiguration->videoMetrics.clockOffsetMetricId].value);
+    TEST_ASSERT_EQUAL(2, pMetrics[pAppConfiguration->videoMetrics.writeMetricId].count);
+    TEST_ASSERT_EQUAL(2, pMetrics[pStreamingSession->writeFrameMetricId].count);
+    TEST_ASSERT_EQUAL(2, pMetrics[pStreamingSession->frameDelayMetricId].count);
+    TEST_ASSERT_NOT_EQUAL(0, pStreamingSession->timeline[APP_SESSION_EVENT_FIRST_KEY_FRAME]);
 
     pFrame->flags = FRAME_FLAG_KEY_FRAME;
     pFrame->trackId = DEFAULT_AUDIO_TRACK_ID;
-    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame);
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     TEST_ASSERT_EQUAL(pFrame->index, 2);
 
     writeFrame_IgnoreAndReturn(STATUS_SRTP_NOT_READY_YET);
     pFrame->flags = FRAME_FLAG_KEY_FRAME;
     pFrame->trackId = DEFAULT_AUDIO_TRACK_ID;
-    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame);
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     TEST_ASSERT_EQUAL(pFrame->index, 3);
 
     writeFrame_IgnoreAndReturn(STATUS_SUCCESS);
     pFrame->flags = FRAME_FLAG_KEY_FRAME;
     pFrame->trackId = DEFAULT_AUDIO_TRACK_ID;
-    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame);
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     TEST_ASSERT_EQUAL(pFrame->index, 4);
 
+    // The video keeps flowing through a bounded debt of the send budget.
+    ATOMIC_STORE(&pStreamingSession->sendBudget, APP_SESSION_SEND_BUDGET_MIN);
+    pFrame->flags = FRAME_FLAG_KEY_FRAME;
+    pFrame->trackId = DEFAULT_VIDEO_TRACK_ID;
+    pFrame->size = APP_SESSION_SEND_BUDGET_MIN / 8 + 1000;
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(pFrame->index, 5);
+    TEST_ASSERT_TRUE(pStreamingSession->sendTokens < 0);
+
+    pFrame->flags = FRAME_FLAG_NONE;
+    pFrame->size = APP_SESSION_SEND_BUDGET_MIN;
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(pFrame->index, 6);
+    TEST_ASSERT_EQUAL(pStreamingSession->firstKeyFrame, TRUE);
+    TEST_ASSERT_EQUAL(0, ATOMIC_LOAD(&pStreamingSession->sendBudgetDropped));
+
+    // Over the debt, the frame is dropped and the video waits for a key frame the refill admits.
+    pFrame->size = 100;
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(pFrame->index, 6);
+    TEST_ASSERT_EQUAL(pStreamingSession->firstKeyFrame, FALSE);
+
+    pFrame->flags = FRAME_FLAG_KEY_FRAME;
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(pFrame->index, 6);
+    TEST_ASSERT_EQUAL(2, ATOMIC_LOAD(&pStreamingSession->sendBudgetDropped));
+
+    pStreamingSession->sendTokens = 0;
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(pFrame->index, 7);
+    TEST_ASSERT_EQUAL(pStreamingSession->firstKeyFrame, TRUE);
+    ATOMIC_STORE(&pStreamingSession->sendBudget, 0);
+
     ATOMIC_STORE_BOOL(&pAppConfiguration->terminateApp, TRUE);
-    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame);
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
     TEST_ASSERT_EQUAL(STATUS_APP_COMMON_SHUTDOWN_MEDIA, retStatus);
 
     retStatus = pAppCommonMock->mediaEosHook(pAppCommonMock->mediaEosHookUdata);
@@ -2953,6 +3165,126 @@ void test_onMediaHook(void)
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 }
 
+/**
+ * @brief a channel with one track of the camera: the session is set up without the transceiver of the other track, and the
+ *        frames of that track are not written.
+ */
+static VOID verifySingleTrackSession(UINT64 trackId)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppCommonMock pAppCommonMock = getAppCommonMock();
+    PAppConfiguration pAppConfiguration;
+    PAppSignaling pAppSignaling;
+    ReceivedSignalingMessage receivedSignalingMessage;
+    PReceivedSignalingMessage pReceivedSignalingMessage = &receivedSignalingMessage;
+    PStreamingSession pStreamingSession;
+    BOOL hasVideo = trackId == DEFAULT_VIDEO_TRACK_ID;
+    Frame frame;
+    PFrame pFrame = &frame;
+    PAppMetric pMetrics;
+
+    setenv(APP_WEBRTC_CHANNEL, pAppCommonMock->channelName, 1);
+    getLogLevel_IgnoreAndReturn(LOG_LEVEL_WARN);
+    setupFileLogging_IgnoreAndReturn(STATUS_SUCCESS);
+    createCredential_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimerQueueCreate_StubWithCallback(appTimerQueueCreate_callback);
+    initAppSignaling_StubWithCallback(initAppSignaling_callback);
+    createConnectionMsqQ_StubWithCallback(createConnectionMsqQ_success_callback);
+    appHashTableCreateWithParams_StubWithCallback(appHashTableCreateWithParams_callback);
+    initMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
+    linkMeidaSinkHook_StubWithCallback(linkMeidaSinkHook_callback);
+    linkMeidaEosHook_StubWithCallback(linkMeidaEosHook_callback);
+    initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimeQueueAdd_IgnoreAndReturn(STATUS_SUCCESS);
+    signalingClientGetStateString_StubWithCallback(signalingClientGetStateString_callback);
+    retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    connectAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = runApp(pAppConfiguration);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    NullableBool canTrickle = {FALSE, TRUE};
+    canTrickleIceCandidates_IgnoreAndReturn(canTrickle);
+    pAppSignaling = &pAppConfiguration->appSignaling;
+    appHashTableContains_StubWithCallback(appHashTableContains_no_callback);
+    isMediaSourceReady_IgnoreAndReturn(STATUS_SUCCESS);
+    queryAppSignalingServer_StubWithCallback(queryAppSignalingServer_callback);
+    popGeneratedCert_StubWithCallback(popGeneratedCert_existed_callback);
+    freeRtcCertificate_IgnoreAndReturn(STATUS_SUCCESS);
+    createPeerConnection_IgnoreAndReturn(STATUS_SUCCESS);
+    peerConnectionOnIceCandidate_StubWithCallback(peerConnectionOnIceCandidate_callback);
+    peerConnectionOnConnectionStateChange_IgnoreAndReturn(STATUS_SUCCESS);
+    peerConnectionOnDataChannel_IgnoreAndReturn(STATUS_SUCCESS);
+    queryMediaVideoCap_IgnoreAndReturn(hasVideo ? STATUS_SUCCESS : STATUS_MEDIA_NOT_EXISTED);
+    queryMediaAudioCap_IgnoreAndReturn(hasVideo ? STATUS_MEDIA_NOT_EXISTED : STATUS_SUCCESS);
+    addSupportedCodec_IgnoreAndReturn(STATUS_SUCCESS);
+    addTransceiver_StubWithCallback(addTransceiver_track_callback);
+    transceiverOnBandwidthEstimation_IgnoreAndReturn(STATUS_SUCCESS);
+    deserializeSessionDescriptionInit_IgnoreAndReturn(STATUS_SUCCESS);
+    peerConnectionOnSenderBandwidthEstimation_IgnoreAndReturn(STATUS_SUCCESS);
+    setLocalDescription_IgnoreAndReturn(STATUS_SUCCESS);
+    setRemoteDescription_IgnoreAndReturn(STATUS_SUCCESS);
+    createAnswer_IgnoreAndReturn(STATUS_SUCCESS);
+    serializeSessionDescriptionInit_IgnoreAndReturn(STATUS_SUCCESS);
+    sendAppSignalingMessage_IgnoreAndReturn(STATUS_SUCCESS);
+    appHashTablePut_IgnoreAndReturn(STATUS_SUCCESS);
+    getPendingMsgQByHashVal_StubWithCallback(getPendingMsgQByHashVal_callback);
+    handlePendingMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_getIceCandidatePairStats_callback);
+    getAppSignalingRole_IgnoreAndReturn(SIGNALING_CHANNEL_ROLE_TYPE_MASTER);
+    create_signaling_message(pReceivedSignalingMessage, SIGNALING_MESSAGE_TYPE_OFFER, 0);
+    retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    TEST_ASSERT_EQUAL(1, pAppConfiguration->streamingSessionCount);
+    pStreamingSession = pAppConfiguration->streamingSessionList[0];
+    TEST_ASSERT_EQUAL_PTR(hasVideo ? &mVideoRtcRtpTransceiver : NULL, pStreamingSession->pVideoRtcRtpTransceiver);
+    TEST_ASSERT_EQUAL_PTR(hasVideo ? NULL : &mAudioRtcRtpTransceiver, pStreamingSession->pAudioRtcRtpTransceiver);
+
+    // the frame of the track of the channel is written.
+    MEMSET(pFrame, 0x00, SIZEOF(Frame));
+    writeFrame_IgnoreAndReturn(STATUS_SUCCESS);
+    pFrame->flags = FRAME_FLAG_KEY_FRAME;
+    pFrame->trackId = trackId;
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    pMetrics = pAppConfiguration->pMetricsRegistry->metrics;
+    TEST_ASSERT_EQUAL(1, pMetrics[pStreamingSession->writeFrameMetricId].count);
+
+    // the other track has no transceiver, its frame is not written.
+    pFrame->trackId = hasVideo ? DEFAULT_AUDIO_TRACK_ID : DEFAULT_VIDEO_TRACK_ID;
+    retStatus = pAppCommonMock->mediaSinkHook(pAppCommonMock->mediaSinkHookUdata, pFrame, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(1, pMetrics[pStreamingSession->writeFrameMetricId].count);
+    TEST_ASSERT_EQUAL(0, pMetrics[hasVideo ? pAppConfiguration->audioMetrics.writeMetricId : pAppConfiguration->videoMetrics.writeMetricId].count);
+
+    freeAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
+    freeConnectionMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
+    appHashTableClear_IgnoreAndReturn(STATUS_SUCCESS);
+    appHashTableFree_IgnoreAndReturn(STATUS_SUCCESS);
+    logIceServerStats_StubWithCallback(logIceServerStats_callback);
+    appTimerQueueCancel_IgnoreAndReturn(STATUS_SUCCESS);
+    closePeerConnection_IgnoreAndReturn(STATUS_SUCCESS);
+    freePeerConnection_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimerQueueFree_IgnoreAndReturn(STATUS_SUCCESS);
+    deinitWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
+    detroyMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
+    destroyCredential_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = freeApp(&pAppConfiguration);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+}
+
+void test_onMediaHook_video_only(void)
+{
+    verifySingleTrackSession(DEFAULT_VIDEO_TRACK_ID);
+}
+
+void test_onMediaHook_audio_only(void)
+{
+    verifySingleTrackSession(DEFAULT_AUDIO_TRACK_ID);
+}
+
 void test_onConnectionStateChange(void)
 {
     STATUS retStatus = STATUS_SUCCESS;
@@ -3061,6 +3393,159 @@ void test_onConnectionStateChange(void)
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 }
 
+void test_onSessionDataChannel(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppCommonMock pAppCommonMock = getAppCommonMock();
+    PAppConfiguration pAppConfiguration;
+    PAppSignaling pAppSignaling;
+    ReceivedSignalingMessage receivedSignalingMessage;
+    PReceivedSignalingMessage pReceivedSignalingMessage = &receivedSignalingMessage;
+    PStreamingSession pStreamingSession;
+    RtcDataChannel rtcDataChannel;
+    PRtcDataChannel pRtcDataChannel = &rtcDataChannel;
+
+    setenv(APP_WEBRTC_CHANNEL, pAppCommonMock->channelName, 1);
+    getLogLevel_IgnoreAndReturn(LOG_LEVEL_WARN);
+    setupFileLogging_IgnoreAndReturn(STATUS_SUCCESS);
+    createCredential_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimerQueueCreate_StubWithCallback(appTimerQueueCreate_callback);
+    initAppSignaling_StubWithCallback(initAppSignaling_callback);
+    createConnectionMsqQ_StubWithCallback(createConnectionMsqQ_success_callback);
+    appHashTableCreateWithParams_StubWithCallback(appHashTableCreateWithParams_callback);
+    initMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
+    linkMeidaSinkHook_StubWithCallback(linkMeidaSinkHook_callback);
+    linkMeidaEosHook_StubWithCallback(linkMeidaEosHook_callback);
+    initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimeQueueAdd_IgnoreAndReturn(STATUS_SUCCESS);
+    signalingClientGetStateString_StubWithCallback(signalingClientGetStateString_callback);
+    retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    connectAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = runApp(pAppConfiguration);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    runMediaSource_StubWithCallback(runMediaSource_callback);
+    NullableBool canTrickle = {FALSE, TRUE};
+    canTrickleIceCandidates_IgnoreAndReturn(canTrickle);
+    pAppSignaling = &pAppConfiguration->appSignaling;
+    appHashTableContains_StubWithCallback(appHashTableContains_no_callback);
+    isMediaSourceReady_IgnoreAndReturn(STATUS_SUCCESS);
+    queryAppSignalingServer_StubWithCallback(queryAppSignalingServer_callback);
+    popGeneratedCert_StubWithCallback(popGeneratedCert_existed_callback);
+    freeRtcCertificate_IgnoreAndReturn(STATUS_SUCCESS);
+    createPeerConnection_IgnoreAndReturn(STATUS_SUCCESS);
+    peerConnectionOnIceCandidate_StubWithCallback(peerConnectionOnIceCandidate_callback);
+    peerConnectionOnConnectionStateChange_IgnoreAndReturn(STATUS_SUCCESS);
+    peerConnectionOnDataChannel_StubWithCallback(peerConnectionOnDataChannel_callback);
+    queryMediaVideoCap_IgnoreAndReturn(STATUS_SUCCESS);
+    addSupportedCodec_IgnoreAndReturn(STATUS_SUCCESS);
+    addTransceiver_IgnoreAndReturn(STATUS_SUCCESS);
+    transceiverOnBandwidthEstimation_IgnoreAndReturn(STATUS_SUCCESS);
+    queryMediaAudioCap_IgnoreAndReturn(STATUS_SUCCESS);
+    deserializeSessionDescriptionInit_IgnoreAndReturn(STATUS_SUCCESS);
+    peerConnectionOnSenderBandwidthEstimation_IgnoreAndReturn(STATUS_SUCCESS);
+    setLocalDescription_IgnoreAndReturn(STATUS_SUCCESS);
+    setRemoteDescription_IgnoreAndReturn(STATUS_SUCCESS);
+    createAnswer_IgnoreAndReturn(STATUS_SUCCESS);
+    serializeSessionDescriptionInit_IgnoreAndReturn(STATUS_SUCCESS);
+    sendAppSignalingMessage_IgnoreAndReturn(STATUS_SUCCESS);
+    appHashTablePut_IgnoreAndReturn(STATUS_SUCCESS);
+    getPendingMsgQByHashVal_StubWithCallback(getPendingMsgQByHashVal_callback);
+    handlePendingMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_getIceCandidatePairStats_callback);
+    getAppSignalingRole_IgnoreAndReturn(SIGNALING_CHANNEL_ROLE_TYPE_MASTER);
+    create_signaling_message(pReceivedSignalingMessage, SIGNALING_MESSAGE_TYPE_OFFER, 0);
+    retStatus = pAppSignaling->signalingClientCallbacks.messageReceivedFn((UINT64) pAppConfiguration, pReceivedSignalingMessage);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // no data channel is open yet, the message is skipped.
+    TEST_ASSERT_EQUAL(STATUS_APP_COMMON_NULL_ARG, sendAppSessionsData(NULL, 1, appCommonUTestWriter, NULL));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, sendAppSessionsData(pAppConfiguration, 1, appCommonUTestWriter, NULL));
+
+    // the first data channel carries the outbound messages, the next ones are only logged.
+    MEMSET(pRtcDataChannel, 0x00, SIZEOF(RtcDataChannel));
+    pStreamingSession = (PStreamingSession) pAppCommonMock->rtcOnDataChannelUData;
+    onDataChannel_Ignore();
+    createAppDataChannel_StubWithCallback(createAppDataChannel_callback);
+    pAppCommonMock->rtcOnDataChannel(pAppCommonMock->rtcOnDataChannelUData, pRtcDataChannel);
+    TEST_ASSERT_NOT_NULL(pStreamingSession->pAppDataChannel);
+    TEST_ASSERT_EQUAL_PTR(pRtcDataChannel, pStreamingSession->pAppDataChannel->pRtcDataChannel);
+    pAppCommonMock->rtcOnDataChannel(pAppCommonMock->rtcOnDataChannelUData, NULL);
+    TEST_ASSERT_EQUAL_PTR(pRtcDataChannel, pStreamingSession->pAppDataChannel->pRtcDataChannel);
+
+    // the messages are only queued, the data channel timer sends them and retries the refused batches.
+    writeAppDataChannelMessage_ExpectAndReturn(pStreamingSession->pAppDataChannel, 1, appCommonUTestWriter, NULL, STATUS_SUCCESS);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, sendAppSessionsData(pAppConfiguration, 1, appCommonUTestWriter, NULL));
+    writeAppDataChannelMessage_ExpectAndReturn(pStreamingSession->pAppDataChannel, 1, appCommonUTestWriter, NULL,
+                                               STATUS_APP_DATA_CHANNEL_BACKPRESSURE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, sendAppSessionsData(pAppConfiguration, 1, appCommonUTestWriter, NULL));
+    TEST_ASSERT_NOT_NULL(pAppCommonMock->flushAppDataChannelsCallback);
+    TEST_ASSERT_EQUAL(STATUS_APP_COMMON_NULL_ARG, pAppCommonMock->flushAppDataChannelsCallback(0, 0, 0));
+    flushAppDataChannel_ExpectAndReturn(pStreamingSession->pAppDataChannel, STATUS_APP_DATA_CHANNEL_SEND);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, pAppCommonMock->flushAppDataChannelsCallback(0, 0, pAppCommonMock->flushAppDataChannelsCallbackUserData));
+    flushAppDataChannel_ExpectAndReturn(pStreamingSession->pAppDataChannel, STATUS_SUCCESS);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, pAppCommonMock->flushAppDataChannelsCallback(0, 0, pAppCommonMock->flushAppDataChannelsCallbackUserData));
+
+    // the probe channel is answered by its own handler, and the results land in the metrics of the session.
+    STRCPY(pRtcDataChannel->name, APP_DATA_CHANNEL_PROBE_NAME);
+    createAppDataChannelProbe_StubWithCallback(createAppDataChannelProbe_callback);
+    pAppCommonMock->rtcOnDataChannel(pAppCommonMock->rtcOnDataChannelUData, pRtcDataChannel);
+    TEST_ASSERT_NOT_NULL(pStreamingSession->pAppDataChannelProbe);
+    TEST_ASSERT_EQUAL_PTR(pRtcDataChannel, pStreamingSession->pAppDataChannelProbe->pRtcDataChannel);
+    TEST_ASSERT_EQUAL_PTR(pStreamingSession, pStreamingSession->pAppDataChannelProbe->udata);
+    pStreamingSession->pAppDataChannelProbe->hook(pStreamingSession, 20 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND, -HUNDREDS_OF_NANOS_IN_A_SECOND);
+
+    // the replay channel is ignored without a replay, and kept for the replay timer with one.
+    STRCPY(pRtcDataChannel->name, APP_REPLAY_DATA_CHANNEL_NAME);
+    pAppCommonMock->rtcOnDataChannel(pAppCommonMock->rtcOnDataChannelUData, pRtcDataChannel);
+    TEST_ASSERT_NULL(pStreamingSession->pReplayDataChannel);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppReplay(APP_REPLAY_CAPACITY, HUNDREDS_OF_NANOS_IN_A_SECOND, &pAppConfiguration->pAppReplay));
+    dataChannelOnMessage_StubWithCallback(dataChannelOnMessage_replay_callback);
+    pAppCommonMock->rtcOnDataChannel(pAppCommonMock->rtcOnDataChannelUData, pRtcDataChannel);
+    TEST_ASSERT_EQUAL_PTR(pRtcDataChannel, pStreamingSession->pReplayDataChannel);
+
+    // the replay timer is armed by the first request only, and stops itself once the replay is sent.
+    TEST_ASSERT_EQUAL(MAX_UINT32, pAppConfiguration->replayTimerId);
+    TEST_ASSERT_NOT_NULL(pAppCommonMock->replayOnMessage);
+    pAppCommonMock->serveAppReplaysTimerCount = 0;
+    pAppCommonMock->replayOnMessage(pAppCommonMock->replayOnMessageUData, pRtcDataChannel, TRUE, NULL, 0);
+    pAppCommonMock->replayOnMessage(pAppCommonMock->replayOnMessageUData, pRtcDataChannel, TRUE, NULL, 0);
+    TEST_ASSERT_EQUAL(1, pAppCommonMock->serveAppReplaysTimerCount);
+    TEST_ASSERT_TRUE(ATOMIC_LOAD_BOOL(&pAppConfiguration->replayTimerArmed));
+    TEST_ASSERT_EQUAL(1, pAppConfiguration->replayTimerId);
+    dataChannelSend_IgnoreAndReturn(STATUS_SUCCESS);
+    // a timer which does not own the published id keeps running, only the owner takes the id back.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, pAppCommonMock->serveAppReplaysCallback(2, 0, pAppCommonMock->serveAppReplaysCallbackUserData));
+    TEST_ASSERT_TRUE(ATOMIC_LOAD_BOOL(&pAppConfiguration->replayTimerArmed));
+    TEST_ASSERT_EQUAL(1, pAppConfiguration->replayTimerId);
+    TEST_ASSERT_EQUAL(STATUS_TIMER_QUEUE_STOP_SCHEDULING,
+                      pAppCommonMock->serveAppReplaysCallback(1, 0, pAppCommonMock->serveAppReplaysCallbackUserData));
+    TEST_ASSERT_FALSE(ATOMIC_LOAD_BOOL(&pAppConfiguration->replayTimerArmed));
+    TEST_ASSERT_FALSE(ATOMIC_LOAD_BOOL(&pStreamingSession->replayRequested));
+    TEST_ASSERT_EQUAL(MAX_UINT32, pAppConfiguration->replayTimerId);
+    pAppCommonMock->replayOnMessage(pAppCommonMock->replayOnMessageUData, pRtcDataChannel, TRUE, NULL, 0);
+    TEST_ASSERT_EQUAL(2, pAppCommonMock->serveAppReplaysTimerCount);
+
+    freeAppDataChannel_IgnoreAndReturn(STATUS_SUCCESS);
+    freeAppDataChannelProbe_IgnoreAndReturn(STATUS_SUCCESS);
+    freeAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
+    freeConnectionMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
+    appHashTableClear_IgnoreAndReturn(STATUS_SUCCESS);
+    appHashTableFree_IgnoreAndReturn(STATUS_SUCCESS);
+    logIceServerStats_StubWithCallback(logIceServerStats_callback);
+    appTimerQueueCancel_IgnoreAndReturn(STATUS_SUCCESS);
+    closePeerConnection_IgnoreAndReturn(STATUS_SUCCESS);
+    freePeerConnection_IgnoreAndReturn(STATUS_SUCCESS);
+    appTimerQueueFree_IgnoreAndReturn(STATUS_SUCCESS);
+    deinitWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
+    detroyMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
+    destroyCredential_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = freeApp(&pAppConfiguration);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+}
+
 void test_mediaSenderRoutine(void)
 {
     STATUS retStatus = STATUS_SUCCESS;
@@ -3399,6 +3884,15 @@ void test_onSenderBandwidthEstimationHandler(void)
 
     pAppCommonMock->rtcOnBandwidthEstimation(pAppCommonMock->rtcOnBandwidthEstimationUData, 2.3);
 
+    txBytes = 0;
+    rxBytes = 0;
+    txPacketsCnt = 0;
+    rxPacketsCnt = 0;
+    duration = 1 * 10000ULL;
+    pAppCommonMock->rtcOnSenderBandwidthEstimation(pAppCommonMock->rtcOnSenderBandwidthEstimationUData, txBytes, rxBytes, txPacketsCnt, rxPacketsCnt,
+                                                   duration);
+    TEST_ASSERT_EQUAL(0, ATOMIC_LOAD(&pStreamingSession->twccBitrate));
+
     txBytes = 10000;
     rxBytes = 10000;
     txPacketsCnt = 100;
@@ -3406,6 +3900,7 @@ void test_onSenderBandwidthEstimationHandler(void)
     duration = 1 * 10000ULL;
     pAppCommonMock->rtcOnSenderBandwidthEstimation(pAppCommonMock->rtcOnSenderBandwidthEstimationUData, txBytes, rxBytes, txPacketsCnt, rxPacketsCnt,
                                                    duration);
+    TEST_ASSERT_EQUAL(APP_SESSION_SEND_BUDGET_MAX, ATOMIC_LOAD(&pStreamingSession->twccBitrate));
 
     txBytes = 10000;
     rxBytes = 500;
@@ -3414,6 +3909,7 @@ void test_onSenderBandwidthEstimationHandler(void)
     duration = 1 * 10000ULL;
     pAppCommonMock->rtcOnSenderBandwidthEstimation(pAppCommonMock->rtcOnSenderBandwidthEstimationUData, txBytes, rxBytes, txPacketsCnt, rxPacketsCnt,
                                                    duration);
+    TEST_ASSERT_EQUAL(200000, ATOMIC_LOAD(&pStreamingSession->twccBitrate));
 
     txBytes = 10000;
     rxBytes = 500;
@@ -3422,6 +3918,7 @@ void test_onSenderBandwidthEstimationHandler(void)
     duration = 1 * 10000ULL;
     pAppCommonMock->rtcOnSenderBandwidthEstimation(pAppCommonMock->rtcOnSenderBandwidthEstimationUData, txBytes, rxBytes, txPacketsCnt, rxPacketsCnt,
                                                    duration);
+    TEST_ASSERT_EQUAL(4000000, ATOMIC_LOAD(&pStreamingSession->twccBitrate));
 
     freeAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
     freeConnectionMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
@@ -3479,7 +3976,8 @@ static PVOID tstAppMain_case1(PVOID userData)
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     runMediaSource_StubWithCallback(runMediaSource_callback);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     *ppAppConfiguration = pAppConfiguration;
@@ -3558,7 +4056,6 @@ static PVOID tstAppMain_case1(PVOID userData)
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
     // Checking for termination
-    checkAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
     removeExpiredPendingMsgQ_IgnoreAndReturn(STATUS_APP_MSGQ_NULL_ARG);
     shutdownMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
     ATOMIC_STORE_BOOL(&pAppConfiguration->restartSignalingClient, FALSE);
@@ -3646,7 +4143,8 @@ static PVOID tstAppMain_case2(PVOID userData)
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     runMediaSource_StubWithCallback(runMediaSource_callback);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     *ppAppConfiguration = pAppConfiguration;
@@ -3728,12 +4226,11 @@ static PVOID tstAppMain_case2(PVOID userData)
         ATOMIC_STORE_BOOL(&pAppConfiguration->streamingSessionList[i]->terminateFlag, TRUE);
     }
     // Checking for termination
-    checkAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
     removeExpiredPendingMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
     shutdownMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
     appTimerQueueCancel_IgnoreAndReturn(STATUS_NULL_ARG);
     ATOMIC_STORE_BOOL(&pAppConfiguration->restartSignalingClient, TRUE);
-    restartAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
+    requestAppSignalingRestart_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = pollApp(pAppConfiguration);
     if (retStatus != STATUS_SUCCESS) {
         printf("[WebRTC App] pollApp(): operation returned status code: 0x%08x \n", retStatus);
@@ -3818,7 +4315,8 @@ static PVOID tstAppMain_case3(PVOID userData)
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     runMediaSource_StubWithCallback(runMediaSource_callback);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     *ppAppConfiguration = pAppConfiguration;
@@ -3901,7 +4399,6 @@ static PVOID tstAppMain_case3(PVOID userData)
         ATOMIC_STORE_BOOL(&pAppConfiguration->streamingSessionList[i]->terminateFlag, TRUE);
     }
     // Checking for termination
-    checkAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
     removeExpiredPendingMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
     shutdownMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
     appTimerQueueCancel_IgnoreAndReturn(STATUS_SUCCESS);
@@ -3990,7 +4487,8 @@ static PVOID tstAppMain_case4(PVOID userData)
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     runMediaSource_StubWithCallback(runMediaSource_callback);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     *ppAppConfiguration = pAppConfiguration;
@@ -4073,7 +4571,6 @@ static PVOID tstAppMain_case4(PVOID userData)
         ATOMIC_STORE_BOOL(&pAppConfiguration->streamingSessionList[i]->terminateFlag, TRUE);
     }
     // Checking for termination
-    checkAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
     removeExpiredPendingMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
     shutdownMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
     appTimerQueueCancel_IgnoreAndReturn(STATUS_SUCCESS);
@@ -4162,7 +4659,8 @@ static PVOID tstAppMain_case5(PVOID userData)
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     runMediaSource_StubWithCallback(runMediaSource_callback);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     *ppAppConfiguration = pAppConfiguration;
@@ -4243,7 +4741,6 @@ static PVOID tstAppMain_case5(PVOID userData)
         ATOMIC_STORE_BOOL(&pAppConfiguration->streamingSessionList[i]->terminateFlag, TRUE);
     }
     // Checking for termination
-    checkAppSignaling_IgnoreAndReturn(STATUS_SUCCESS);
     removeExpiredPendingMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
     shutdownMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
     appTimerQueueCancel_IgnoreAndReturn(STATUS_SUCCESS);
@@ -4331,7 +4828,8 @@ static PVOID tstAppMain_case6(PVOID userData)
     linkMeidaEosHook_IgnoreAndReturn(STATUS_SUCCESS);
     runMediaSource_StubWithCallback(runMediaSource_callback);
     initWebRtc_IgnoreAndReturn(STATUS_SUCCESS);
-    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_pregenerateCertTimer_callback);
+    appTimeQueueAdd_StubWithCallback(appTimeQueueAdd_callback);
+    startCertGenerationWorker_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = initApp(pAppCommonMock->trickleIce, pAppCommonMock->useTurn, &pAppConfiguration);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     *ppAppConfiguration = pAppConfiguration;
@@ -4412,12 +4910,11 @@ static PVOID tstAppMain_case6(PVOID userData)
         ATOMIC_STORE_BOOL(&pAppConfiguration->streamingSessionList[i]->terminateFlag, TRUE);
     }
     // Checking for termination
-    checkAppSignaling_IgnoreAndReturn(STATUS_APP_SIGNALING_CONNECT);
     removeExpiredPendingMsgQ_IgnoreAndReturn(STATUS_SUCCESS);
     shutdownMediaSource_IgnoreAndReturn(STATUS_SUCCESS);
     appTimerQueueCancel_IgnoreAndReturn(STATUS_SUCCESS);
     ATOMIC_STORE_BOOL(&pAppConfiguration->restartSignalingClient, TRUE);
-    restartAppSignaling_IgnoreAndReturn(STATUS_APP_SIGNALING_RESTART);
+    requestAppSignalingRestart_IgnoreAndReturn(STATUS_APP_SIGNALING_INVALID_MUTEX);
     retStatus = pollApp(pAppConfiguration);
     if (retStatus != STATUS_SUCCESS) {
         printf("[WebRTC App] pollApp(): operation returned status code: 0x%08x \n", retStatus);
@@ -13,6 +13,8 @@
  * permissions and limitations under the License.
  */
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include "unity.h"
 #include "AppCredential.h"
 #include "mock_Include.h"
@@ -33,6 +35,11 @@
 #define APP_CREDENTIAL_UTEST_IOT_CORE_ROLE_ALIAS          "role_alias"
 #define APP_CREDENTIAL_UTEST_ECS_AUTH_TOKEN               "auth_token"
 #define APP_CREDENTIAL_UTEST_ECS_CREDENTIALS_FULL_URI     "credential_uri"
+#define APP_CREDENTIAL_UTEST_CERT_POOL_DEPTH              "8"
+#define APP_CREDENTIAL_UTEST_INVALID_CERT_POOL_DEPTH      "1024"
+#define APP_CREDENTIAL_UTEST_CERT_KEY_TYPE_RSA            "rsa"
+#define APP_CREDENTIAL_UTEST_CERT_CACHE_DIR               "./utest_cert_cache"
+#define APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(seq)         APP_CREDENTIAL_UTEST_CERT_CACHE_DIR "/dtls-0000000000000000000" #seq ".pem"
 
 typedef struct {
     PAppCredential pAppCredential;
@@ -112,6 +119,29 @@ static STATUS appQueueIteratorNext_callback(PStackQueueIterator pIterator, int N
     return STATUS_SUCCESS;
 }
 
+static STATUS loadAppRtcCertificate_callback(PCHAR pPath, PRtcCertificate* ppRtcCertificate, int NumCalls)
+{
+    PAppCredentialMock pAppCredentialMock = getAppCredentialMock();
+    *ppRtcCertificate = pAppCredentialMock->pRtcCertificate;
+    return STATUS_SUCCESS;
+}
+
+static VOID createCachedCert(PCHAR pPath, mode_t mode, time_t mtime)
+{
+    struct timeval times[2];
+    int fd = open(pPath, O_RDWR | O_CREAT, mode);
+    if (fd != -1) {
+        close(fd);
+    }
+    chmod(pPath, mode);
+    if (mtime != 0) {
+        times[0].tv_sec = mtime;
+        times[0].tv_usec = 0;
+        times[1] = times[0];
+        utimes(pPath, times);
+    }
+}
+
 static MUTEX null_createMutex(BOOL reentrant)
 {
     return NULL;
@@ -209,6 +239,14 @@ void test_generatedCert(void)
     appQueueEnqueue_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = generateCertRoutine(pAppCredential);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(2, pAppCredential->certStats.generatedCount);
+    TEST_ASSERT_EQUAL(1, pAppCredential->certStats.failedCount);
+
+    // the pool only holds ECDSA certs.
+    pAppCredential->certKeyType = APP_CERT_KEY_TYPE_RSA;
+    retStatus = generateCertRoutine(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(2, pAppCredential->certStats.generatedCount);
 
     appQueueGetIterator_StubWithCallback(appQueueGetIterator_callback);
     appQueueIteratorGetItem_IgnoreAndReturn(STATUS_SUCCESS);
@@ -255,10 +293,12 @@ void test_popGeneratedCert(void)
     appQueueDequeue_IgnoreAndReturn(STATUS_NOT_FOUND);
     retStatus = popGeneratedCert(pAppCredential, &pRtcCertificate);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(1, pAppCredential->certStats.poolMisses);
 
     appQueueDequeue_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = popGeneratedCert(pAppCredential, &pRtcCertificate);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(1, pAppCredential->certStats.poolHits);
 
     appQueueGetIterator_StubWithCallback(appQueueGetIterator_callback);
     appQueueIteratorGetItem_IgnoreAndReturn(STATUS_SUCCESS);
@@ -405,6 +445,161 @@ void test_createCredential(void)
     unsetenv(APP_ECS_CREDENTIALS_FULL_URI);
 }
 
+void test_certPoolConfig(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppCredentialMock pAppCredentialMock = getAppCredentialMock();
+    PAppCredential pAppCredential = pAppCredentialMock->pAppCredential;
+
+    setenv(CACERT_PATH_ENV_VAR, APP_CREDENTIAL_UTEST_CACERT_PATH_ENV_VAR, 1);
+    setenv(ACCESS_KEY_ENV_VAR, APP_CREDENTIAL_UTEST_ACCESS_KEY_ENV_VAR, 1);
+    setenv(SECRET_KEY_ENV_VAR, APP_CREDENTIAL_UTEST_SECRET_KEY_ENV_VAR, 1);
+    setenv(SESSION_TOKEN_ENV_VAR, APP_CREDENTIAL_UTEST_SESSION_TOKEN_ENV_VAR, 1);
+
+    retStatus = startCertGenerationWorker(NULL);
+    TEST_ASSERT_EQUAL(STATUS_APP_CREDENTIAL_NULL_ARG, retStatus);
+
+    createAppStaticCredentialProvider_IgnoreAndReturn(STATUS_SUCCESS);
+    freeAppStaticCredentialProvider_IgnoreAndReturn(STATUS_SUCCESS);
+    appQueueCreate_StubWithCallback(appQueueCreate_success_callback);
+    appQueueGetIterator_StubWithCallback(appQueueGetIterator_callback);
+    appQueueIteratorGetItem_IgnoreAndReturn(STATUS_SUCCESS);
+    appQueueIteratorNext_StubWithCallback(appQueueIteratorNext_callback);
+    freeRtcCertificate_IgnoreAndReturn(STATUS_SUCCESS);
+    appQueueClear_IgnoreAndReturn(STATUS_SUCCESS);
+    appQueueFree_IgnoreAndReturn(STATUS_SUCCESS);
+
+    // the default configuration.
+    unsetenv(APP_CERT_POOL_DEPTH);
+    unsetenv(APP_CERT_KEY_TYPE);
+    retStatus = createCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(APP_CERT_POOL_DEFAULT_DEPTH, pAppCredential->certPoolDepth);
+    TEST_ASSERT_EQUAL(APP_CERT_KEY_TYPE_ECDSA, pAppCredential->certKeyType);
+
+    // the worker finds the pool full and waits until it is stopped.
+    appQueueGetCount_StubWithCallback(appQueueGetCount_overflow_callback);
+    retStatus = startCertGenerationWorker(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_NOT_EQUAL(INVALID_TID_VALUE, pAppCredential->generateCertTid);
+    retStatus = destroyCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(INVALID_TID_VALUE, pAppCredential->generateCertTid);
+
+    // the customized configuration.
+    setenv(APP_CERT_POOL_DEPTH, APP_CREDENTIAL_UTEST_CERT_POOL_DEPTH, 1);
+    setenv(APP_CERT_KEY_TYPE, APP_CREDENTIAL_UTEST_CERT_KEY_TYPE_RSA, 1);
+    retStatus = createCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(8, pAppCredential->certPoolDepth);
+    TEST_ASSERT_EQUAL(APP_CERT_KEY_TYPE_RSA, pAppCredential->certKeyType);
+
+    // the worker is not needed for RSA.
+    retStatus = startCertGenerationWorker(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(INVALID_TID_VALUE, pAppCredential->generateCertTid);
+    retStatus = destroyCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // the invalid depth falls back to the default one.
+    setenv(APP_CERT_POOL_DEPTH, APP_CREDENTIAL_UTEST_INVALID_CERT_POOL_DEPTH, 1);
+    retStatus = createCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(APP_CERT_POOL_DEFAULT_DEPTH, pAppCredential->certPoolDepth);
+    retStatus = destroyCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    unsetenv(APP_CERT_POOL_DEPTH);
+    unsetenv(APP_CERT_KEY_TYPE);
+    unsetenv(ACCESS_KEY_ENV_VAR);
+    unsetenv(SECRET_KEY_ENV_VAR);
+    unsetenv(SESSION_TOKEN_ENV_VAR);
+}
+
+void test_certCache(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppCredentialMock pAppCredentialMock = getAppCredentialMock();
+    PAppCredential pAppCredential = pAppCredentialMock->pAppCredential;
+    PRtcCertificate pRtcCertificate;
+
+    setenv(CACERT_PATH_ENV_VAR, APP_CREDENTIAL_UTEST_CACERT_PATH_ENV_VAR, 1);
+    setenv(ACCESS_KEY_ENV_VAR, APP_CREDENTIAL_UTEST_ACCESS_KEY_ENV_VAR, 1);
+    setenv(SECRET_KEY_ENV_VAR, APP_CREDENTIAL_UTEST_SECRET_KEY_ENV_VAR, 1);
+    setenv(SESSION_TOKEN_ENV_VAR, APP_CREDENTIAL_UTEST_SESSION_TOKEN_ENV_VAR, 1);
+    setenv(APP_CERT_CACHE_DIR, APP_CREDENTIAL_UTEST_CERT_CACHE_DIR, 1);
+    unsetenv(APP_CERT_CACHE_TTL);
+    unsetenv(APP_WEBRTC_CHANNEL);
+    unsetenv(APP_CERT_POOL_DEPTH);
+    unsetenv(APP_CERT_KEY_TYPE);
+
+    // a valid cert, a cert readable by others and an expired cert.
+    mkdir(APP_CREDENTIAL_UTEST_CERT_CACHE_DIR, S_IRWXU);
+    createCachedCert(APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(1), S_IRUSR | S_IWUSR, 0);
+    createCachedCert(APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(2), S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, 0);
+    createCachedCert(APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(3), S_IRUSR | S_IWUSR, time(NULL) - APP_CERT_CACHE_DEFAULT_TTL - 1);
+
+    createAppStaticCredentialProvider_IgnoreAndReturn(STATUS_SUCCESS);
+    freeAppStaticCredentialProvider_IgnoreAndReturn(STATUS_SUCCESS);
+    appQueueCreate_StubWithCallback(appQueueCreate_success_callback);
+    loadAppRtcCertificate_StubWithCallback(loadAppRtcCertificate_callback);
+    appQueueEnqueue_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = createCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(1, pAppCredential->certStats.cacheLoadedCount);
+    TEST_ASSERT_EQUAL(2, pAppCredential->certStats.cacheEvictedCount);
+    TEST_ASSERT_EQUAL(3, pAppCredential->certCacheSeq);
+    TEST_ASSERT_EQUAL(0, access(APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(1), F_OK));
+    TEST_ASSERT_NOT_EQUAL(0, access(APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(2), F_OK));
+    TEST_ASSERT_NOT_EQUAL(0, access(APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(3), F_OK));
+
+    // the cached copy is removed once the cert is used.
+    appQueueDequeue_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = popGeneratedCert(pAppCredential, &pRtcCertificate);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_NOT_EQUAL(0, access(APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(1), F_OK));
+
+    // the new cert is saved with the next sequence number.
+    appQueueGetCount_StubWithCallback(appQueueGetCount_one_callback);
+    createRtcCertificate_StubWithCallback(createRtcCertificate_callback);
+    saveAppRtcCertificate_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = generateCertRoutine(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(1, pAppCredential->certStats.cacheSavedCount);
+    TEST_ASSERT_EQUAL(4, pAppCredential->certCacheSeq);
+    TEST_ASSERT_EQUAL(1, pAppCredential->certCacheRingCount);
+
+    // the failure of saving is not fatal.
+    saveAppRtcCertificate_IgnoreAndReturn(STATUS_NULL_ARG);
+    retStatus = generateCertRoutine(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(1, pAppCredential->certStats.cacheSavedCount);
+
+    appQueueGetIterator_StubWithCallback(appQueueGetIterator_callback);
+    appQueueIteratorGetItem_IgnoreAndReturn(STATUS_SUCCESS);
+    appQueueIteratorNext_StubWithCallback(appQueueIteratorNext_callback);
+    freeRtcCertificate_IgnoreAndReturn(STATUS_SUCCESS);
+    appQueueClear_IgnoreAndReturn(STATUS_SUCCESS);
+    appQueueFree_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = destroyCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // the cache is disabled if the directory can not be created.
+    setenv(APP_CERT_CACHE_DIR, APP_CREDENTIAL_UTEST_INVALID_CACERT_PATH_ENV_VAR "/cache", 1);
+    retStatus = createCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL('\0', pAppCredential->certCacheDir[0]);
+    retStatus = destroyCredential(pAppCredential);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    remove(APP_CREDENTIAL_UTEST_CERT_CACHE_FILE(1));
+    rmdir(APP_CREDENTIAL_UTEST_CERT_CACHE_DIR);
+    unsetenv(APP_CERT_CACHE_DIR);
+    unsetenv(ACCESS_KEY_ENV_VAR);
+    unsetenv(SECRET_KEY_ENV_VAR);
+    unsetenv(SESSION_TOKEN_ENV_VAR);
+}
+
 void test_createCredential_null_mutex(void)
 {
     STATUS retStatus = STATUS_SUCCESS;
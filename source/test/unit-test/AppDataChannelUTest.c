@@ -41,6 +41,89 @@ static void triggerCallback(UINT64 userData, PRtcDataChannel pDataChannel, BOOL
     return &mRtcDataChannel;
 }
 
+static UINT32 mSentBatches;
+static UINT32 mSentMessages;
+static BOOL mRefuseSend;
+
+static STATUS dataChannelSendCallback(PRtcDataChannel pRtcDataChannel, BOOL isBinary, PBYTE pMessage, UINT32 pMessageLen, int NumCalls)
+{
+    UINT32 offset = 0, len;
+
+    TEST_ASSERT_TRUE(isBinary);
+    if (mRefuseSend) {
+        return STATUS_INTERNAL_ERROR;
+    }
+    // split the batch with the big-endian lengths, the viewer does the same.
+    while (offset < pMessageLen) {
+        len = ((UINT32) pMessage[offset] << 24) | ((UINT32) pMessage[offset + 1] << 16) | ((UINT32) pMessage[offset + 2] << 8) | pMessage[offset + 3];
+        offset += APP_DATA_CHANNEL_HEADER_LEN;
+        TEST_ASSERT_EQUAL(0, MEMCMP(pMessage + offset, APP_DATA_CHANNEL_UTEST_DATA_MESSAGE, MIN(len, STRLEN(APP_DATA_CHANNEL_UTEST_DATA_MESSAGE))));
+        offset += len;
+        mSentMessages++;
+    }
+    TEST_ASSERT_EQUAL(pMessageLen, offset);
+    mSentBatches++;
+    return STATUS_SUCCESS;
+}
+
+static PAppDataChannel mFlushedChannel;
+
+static STATUS dataChannelSendProducerCallback(PRtcDataChannel pRtcDataChannel, BOOL isBinary, PBYTE pMessage, UINT32 pMessageLen, int NumCalls)
+{
+    // the queue is not locked during the send, a producer and a second flush get through.
+    if (NumCalls == 0) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, sendAppDataChannelMessage(mFlushedChannel, (PBYTE) APP_DATA_CHANNEL_UTEST_DATA_MESSAGE,
+                                                                    STRLEN(APP_DATA_CHANNEL_UTEST_DATA_MESSAGE)));
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, flushAppDataChannel(mFlushedChannel));
+    }
+    return dataChannelSendCallback(pRtcDataChannel, isBinary, pMessage, pMessageLen, NumCalls);
+}
+
+static BYTE mProbeMessage[APP_DATA_CHANNEL_PROBE_LEN];
+static UINT64 mProbeRoundTripTime;
+static INT64 mProbeClockOffset;
+static UINT32 mProbeResults;
+
+static UINT64 getProbeUint64(PBYTE pBuffer)
+{
+    UINT64 value = 0;
+    UINT32 i;
+
+    for (i = 0; i < 8; i++) {
+        value = (value << 8) | pBuffer[i];
+    }
+    return value;
+}
+
+static VOID putProbeUint64(PBYTE pBuffer, UINT64 value)
+{
+    UINT32 i;
+
+    for (i = 0; i < 8; i++) {
+        pBuffer[7 - i] = (BYTE) (value >> (8 * i));
+    }
+}
+
+static STATUS dataChannelSendProbeCallback(PRtcDataChannel pRtcDataChannel, BOOL isBinary, PBYTE pMessage, UINT32 pMessageLen, int NumCalls)
+{
+    TEST_ASSERT_EQUAL(APP_DATA_CHANNEL_PROBE_LEN, pMessageLen);
+    MEMCPY(mProbeMessage, pMessage, APP_DATA_CHANNEL_PROBE_LEN);
+    return STATUS_SUCCESS;
+}
+
+static VOID probeHook(PVOID udata, UINT64 roundTripTime, INT64 clockOffset)
+{
+    mProbeRoundTripTime = roundTripTime;
+    mProbeClockOffset = clockOffset;
+    mProbeResults++;
+}
+
+static STATUS writerCallback(PVOID udata, PBYTE pBuffer, UINT32 size)
+{
+    MEMCPY(pBuffer, APP_DATA_CHANNEL_UTEST_DATA_MESSAGE, MIN(size, STRLEN(APP_DATA_CHANNEL_UTEST_DATA_MESSAGE)));
+    return udata == NULL ? STATUS_SUCCESS : STATUS_INVALID_ARG;
+}
+
 static STATUS dataChannelOnMessageCallback(PRtcDataChannel pRtcDataChannel, UINT64 userData, RtcOnMessage rtcOnMessage)
 {
     mRtcOnMessage = rtcOnMessage;
@@ -60,4 +143,174 @@ void test_onDataChannel(void)
     mRtcOnMessage(NULL, pRtcDataChannel, TRUE, NULL, 0);
     mRtcOnMessage(NULL, pRtcDataChannel, FALSE, message, messageLen);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
-}
\ No newline at end of file
+}
+
+void test_createAppDataChannel(void)
+{
+    PAppDataChannel pAppDataChannel = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_NULL_ARG, createAppDataChannel(NULL, &pAppDataChannel));
+    TEST_ASSERT_NULL(pAppDataChannel);
+    TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_NULL_ARG, createAppDataChannel(getContext(), NULL));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppDataChannel(getContext(), &pAppDataChannel));
+    TEST_ASSERT_NOT_NULL(pAppDataChannel);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppDataChannel(&pAppDataChannel));
+    TEST_ASSERT_NULL(pAppDataChannel);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppDataChannel(&pAppDataChannel));
+    TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_NULL_ARG, freeAppDataChannel(NULL));
+}
+
+void test_sendAppDataChannelMessage(void)
+{
+    PAppDataChannel pAppDataChannel = NULL;
+    AppDataChannelStats stats;
+    UINT32 i, messageLen = STRLEN(APP_DATA_CHANNEL_UTEST_DATA_MESSAGE);
+
+    mSentBatches = 0;
+    mSentMessages = 0;
+    mRefuseSend = FALSE;
+    dataChannelSend_StubWithCallback(dataChannelSendCallback);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppDataChannel(getContext(), &pAppDataChannel));
+    TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_NULL_ARG, sendAppDataChannelMessage(pAppDataChannel, NULL, messageLen));
+    TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_NULL_ARG, writeAppDataChannelMessage(pAppDataChannel, messageLen, NULL, NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_MESSAGE_TOO_LARGE,
+                      writeAppDataChannelMessage(pAppDataChannel, APP_DATA_CHANNEL_BATCH_SIZE, writerCallback, NULL));
+    // a failed writer discards its message.
+    TEST_ASSERT_EQUAL(STATUS_INVALID_ARG, writeAppDataChannelMessage(pAppDataChannel, messageLen, writerCallback, pAppDataChannel));
+
+    // the small messages are coalesced into one batch.
+    for (i = 0; i < 100; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, sendAppDataChannelMessage(pAppDataChannel, (PBYTE) APP_DATA_CHANNEL_UTEST_DATA_MESSAGE, messageLen));
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppDataChannelStats(pAppDataChannel, &stats));
+    TEST_ASSERT_EQUAL(100, stats.messagesQueued);
+    TEST_ASSERT_EQUAL(100 * (APP_DATA_CHANNEL_HEADER_LEN + messageLen), stats.bufferedAmount);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, flushAppDataChannel(pAppDataChannel));
+    TEST_ASSERT_EQUAL(1, mSentBatches);
+    TEST_ASSERT_EQUAL(100, mSentMessages);
+
+    // the large messages open the next batches.
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, writeAppDataChannelMessage(pAppDataChannel, APP_DATA_CHANNEL_BATCH_SIZE / 2, writerCallback, NULL));
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, flushAppDataChannel(pAppDataChannel));
+    TEST_ASSERT_EQUAL(4, mSentBatches);
+    TEST_ASSERT_EQUAL(103, mSentMessages);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppDataChannelStats(pAppDataChannel, &stats));
+    TEST_ASSERT_EQUAL(0, stats.bufferedAmount);
+    TEST_ASSERT_EQUAL(4, stats.batchesSent);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppDataChannel(&pAppDataChannel));
+}
+
+void test_flushAppDataChannel_out_of_lock(void)
+{
+    AppDataChannelStats stats;
+    UINT32 messageLen = STRLEN(APP_DATA_CHANNEL_UTEST_DATA_MESSAGE);
+
+    mSentBatches = 0;
+    mSentMessages = 0;
+    mRefuseSend = FALSE;
+    dataChannelSend_StubWithCallback(dataChannelSendProducerCallback);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppDataChannel(getContext(), &mFlushedChannel));
+
+    // the message queued during the send opens the next batch, and the flush in progress sends it after the first one.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, sendAppDataChannelMessage(mFlushedChannel, (PBYTE) APP_DATA_CHANNEL_UTEST_DATA_MESSAGE, messageLen));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, flushAppDataChannel(mFlushedChannel));
+    TEST_ASSERT_EQUAL(2, mSentBatches);
+    TEST_ASSERT_EQUAL(2, mSentMessages);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppDataChannelStats(mFlushedChannel, &stats));
+    TEST_ASSERT_EQUAL(0, stats.bufferedAmount);
+    TEST_ASSERT_EQUAL(2, stats.batchesSent);
+    TEST_ASSERT_FALSE(mFlushedChannel->flushing);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppDataChannel(&mFlushedChannel));
+}
+
+void test_flushAppDataChannel_backpressure(void)
+{
+    PAppDataChannel pAppDataChannel = NULL;
+    AppDataChannelStats stats;
+    UINT32 i, messageSize = APP_DATA_CHANNEL_BATCH_SIZE - APP_DATA_CHANNEL_HEADER_LEN;
+    UINT32 highCount = APP_DATA_CHANNEL_HIGH_WATERMARK / APP_DATA_CHANNEL_BATCH_SIZE;
+
+    mSentBatches = 0;
+    mSentMessages = 0;
+    mRefuseSend = TRUE;
+    dataChannelSend_StubWithCallback(dataChannelSendCallback);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppDataChannel(getContext(), &pAppDataChannel));
+
+    // the refused batches stay queued until the high watermark.
+    for (i = 0; i < highCount; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, writeAppDataChannelMessage(pAppDataChannel, messageSize, writerCallback, NULL));
+        TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_SEND, flushAppDataChannel(pAppDataChannel));
+    }
+    TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_BACKPRESSURE, writeAppDataChannelMessage(pAppDataChannel, 1, writerCallback, NULL));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppDataChannelStats(pAppDataChannel, &stats));
+    TEST_ASSERT_EQUAL(1, stats.messagesDropped);
+    TEST_ASSERT_EQUAL(1, stats.backpressureCount);
+    TEST_ASSERT_EQUAL(highCount, stats.sendFailures);
+    TEST_ASSERT_EQUAL(0, mSentBatches);
+
+    // the queue accepts the messages again once it drains, and the batches are sent in order.
+    mRefuseSend = FALSE;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, flushAppDataChannel(pAppDataChannel));
+    TEST_ASSERT_EQUAL(highCount, mSentBatches);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, writeAppDataChannelMessage(pAppDataChannel, 1, writerCallback, NULL));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppDataChannelStats(pAppDataChannel, &stats));
+    TEST_ASSERT_EQUAL(APP_DATA_CHANNEL_HEADER_LEN + 1, stats.bufferedAmount);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppDataChannel(&pAppDataChannel));
+}
+
+void test_appDataChannelProbe(void)
+{
+    PAppDataChannelProbe pAppDataChannelProbe = NULL;
+    BYTE message[APP_DATA_CHANNEL_PROBE_LEN];
+    UINT64 originTime;
+
+    mProbeResults = 0;
+    dataChannelOnMessage_StubWithCallback(dataChannelOnMessageCallback);
+    dataChannelSend_StubWithCallback(dataChannelSendProbeCallback);
+    TEST_ASSERT_EQUAL(STATUS_APP_DATA_CHANNEL_NULL_ARG, createAppDataChannelProbe(NULL, probeHook, NULL, &pAppDataChannelProbe));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppDataChannelProbe(getContext(), probeHook, NULL, &pAppDataChannelProbe));
+    setAppDataChannelProbeFrame(pAppDataChannelProbe, 12345);
+
+    // the ping carries the origin time and the last frame.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, sendAppDataChannelProbe(pAppDataChannelProbe));
+    TEST_ASSERT_EQUAL(APP_DATA_CHANNEL_PROBE_PING, mProbeMessage[0]);
+    TEST_ASSERT_EQUAL(1, mProbeMessage[7]);
+    TEST_ASSERT_TRUE(getProbeUint64(mProbeMessage + 8) != 0);
+    TEST_ASSERT_EQUAL(12345, getProbeUint64(mProbeMessage + 32));
+    TEST_ASSERT_TRUE(getProbeUint64(mProbeMessage + 40) != 0);
+
+    // the pong of a remote side which answers at once and whose clock is 1000s ahead.
+    originTime = getProbeUint64(mProbeMessage + 8);
+    MEMCPY(message, mProbeMessage, APP_DATA_CHANNEL_PROBE_LEN);
+    message[0] = APP_DATA_CHANNEL_PROBE_PONG;
+    putProbeUint64(message + 16, originTime + 1000 * HUNDREDS_OF_NANOS_IN_A_SECOND);
+    putProbeUint64(message + 24, originTime + 1000 * HUNDREDS_OF_NANOS_IN_A_SECOND);
+    mRtcOnMessage((UINT64) pAppDataChannelProbe, getContext(), TRUE, message, APP_DATA_CHANNEL_PROBE_LEN);
+    TEST_ASSERT_EQUAL(1, mProbeResults);
+    TEST_ASSERT_TRUE(mProbeRoundTripTime < HUNDREDS_OF_NANOS_IN_A_SECOND);
+    TEST_ASSERT_TRUE(mProbeClockOffset > 999 * HUNDREDS_OF_NANOS_IN_A_SECOND && mProbeClockOffset <= 1000 * HUNDREDS_OF_NANOS_IN_A_SECOND);
+
+    // the pong which holds the ping longer than its round trip is dropped, so are the short messages.
+    putProbeUint64(message + 24, originTime + 1010 * HUNDREDS_OF_NANOS_IN_A_SECOND);
+    mRtcOnMessage((UINT64) pAppDataChannelProbe, getContext(), TRUE, message, APP_DATA_CHANNEL_PROBE_LEN);
+    mRtcOnMessage((UINT64) pAppDataChannelProbe, getContext(), TRUE, message, APP_DATA_CHANNEL_PROBE_LEN - 1);
+    TEST_ASSERT_EQUAL(1, mProbeResults);
+
+    // the ping of the viewer is answered with its sequence and origin time.
+    message[0] = APP_DATA_CHANNEL_PROBE_PING;
+    message[7] = 9;
+    putProbeUint64(message + 8, 777);
+    MEMSET(mProbeMessage, 0x00, APP_DATA_CHANNEL_PROBE_LEN);
+    mRtcOnMessage((UINT64) pAppDataChannelProbe, getContext(), TRUE, message, APP_DATA_CHANNEL_PROBE_LEN);
+    TEST_ASSERT_EQUAL(APP_DATA_CHANNEL_PROBE_PONG, mProbeMessage[0]);
+    TEST_ASSERT_EQUAL(9, mProbeMessage[7]);
+    TEST_ASSERT_EQUAL(777, getProbeUint64(mProbeMessage + 8));
+    TEST_ASSERT_TRUE(getProbeUint64(mProbeMessage + 16) <= getProbeUint64(mProbeMessage + 24));
+    TEST_ASSERT_EQUAL(12345, getProbeUint64(mProbeMessage + 32));
+    TEST_ASSERT_EQUAL(1, mProbeResults);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppDataChannelProbe(&pAppDataChannelProbe));
+    TEST_ASSERT_NULL(pAppDataChannelProbe);
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include <sys/socket.h>
+#include "unity.h"
+#include "AppInterfaceFilter.h"
+#include "mock_Include.h"
+
+#define APP_INTERFACE_FILTER_UTEST_LOOPBACK       "lo"
+#define APP_INTERFACE_FILTER_UTEST_LOOPBACK_CIDR  "127.0.0.0/8"
+#define APP_INTERFACE_FILTER_UTEST_OTHER_CIDR     "10.255.255.0/24"
+#define APP_INTERFACE_FILTER_UTEST_DENY_LIST      "docker*, veth*"
+#define APP_INTERFACE_FILTER_UTEST_TOO_MANY_RULES "a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q"
+
+static AppInterfaceFilter mInterfaceFilter;
+static AppInterfaceFilterSession mFilterSession;
+
+/* Called before each test method. */
+void setUp()
+{
+    memset(&mInterfaceFilter, 0, sizeof(AppInterfaceFilter));
+    memset(&mFilterSession, 0, sizeof(AppInterfaceFilterSession));
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    freeAppInterfaceFilterSession(&mFilterSession);
+    unsetenv(APP_INTERFACE_ALLOW_LIST);
+    unsetenv(APP_INTERFACE_DENY_LIST);
+}
+
+void test_initAppInterfaceFilter(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    retStatus = initAppInterfaceFilter(NULL);
+    TEST_ASSERT_EQUAL(STATUS_APP_INTERFACE_FILTER_NULL_ARG, retStatus);
+
+    // the default deny list.
+    retStatus = initAppInterfaceFilter(&mInterfaceFilter);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_TRUE(mInterfaceFilter.enabled);
+    TEST_ASSERT_EQUAL(0, mInterfaceFilter.allowCount);
+    TEST_ASSERT_EQUAL(4, mInterfaceFilter.denyCount);
+
+    // the empty deny list turns the filter off.
+    setenv(APP_INTERFACE_DENY_LIST, "", 1);
+    retStatus = initAppInterfaceFilter(&mInterfaceFilter);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_FALSE(mInterfaceFilter.enabled);
+
+    setenv(APP_INTERFACE_ALLOW_LIST, "eth0, " APP_INTERFACE_FILTER_UTEST_LOOPBACK_CIDR, 1);
+    setenv(APP_INTERFACE_DENY_LIST, APP_INTERFACE_FILTER_UTEST_DENY_LIST, 1);
+    retStatus = initAppInterfaceFilter(&mInterfaceFilter);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(2, mInterfaceFilter.allowCount);
+    TEST_ASSERT_FALSE(mInterfaceFilter.allowRules[0].isCidr);
+    TEST_ASSERT_EQUAL_STRING("eth0", mInterfaceFilter.allowRules[0].pattern);
+    TEST_ASSERT_TRUE(mInterfaceFilter.allowRules[1].isCidr);
+    TEST_ASSERT_EQUAL(8, mInterfaceFilter.allowRules[1].prefixLen);
+    TEST_ASSERT_EQUAL(2, mInterfaceFilter.denyCount);
+    TEST_ASSERT_EQUAL_STRING("veth*", mInterfaceFilter.denyRules[1].pattern);
+}
+
+void test_setAppInterfaceFilterRules_invalid(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, "10.0.0.0/33", NULL);
+    TEST_ASSERT_EQUAL(STATUS_APP_INTERFACE_FILTER_INVALID_RULE, retStatus);
+    TEST_ASSERT_FALSE(mInterfaceFilter.enabled);
+
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, NULL, "10.0.0/8");
+    TEST_ASSERT_EQUAL(STATUS_APP_INTERFACE_FILTER_INVALID_RULE, retStatus);
+
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, NULL, "fd00::/abc");
+    TEST_ASSERT_EQUAL(STATUS_APP_INTERFACE_FILTER_INVALID_RULE, retStatus);
+
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, APP_INTERFACE_FILTER_UTEST_TOO_MANY_RULES, NULL);
+    TEST_ASSERT_EQUAL(STATUS_APP_INTERFACE_FILTER_TOO_MANY_RULES, retStatus);
+
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, NULL, "fd00::/8");
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(AF_INET6, mInterfaceFilter.denyRules[0].family);
+}
+
+void test_appInterfaceFilterFunc_glob(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    retStatus = initAppInterfaceFilterSession(NULL, &mInterfaceFilter);
+    TEST_ASSERT_EQUAL(STATUS_APP_INTERFACE_FILTER_NULL_ARG, retStatus);
+
+    // no filter session accepts everything.
+    TEST_ASSERT_TRUE(appInterfaceFilterFunc((UINT64) NULL, "docker0"));
+
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, NULL, APP_INTERFACE_FILTER_UTEST_DENY_LIST);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = initAppInterfaceFilterSession(&mFilterSession, &mInterfaceFilter);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    TEST_ASSERT_TRUE(appInterfaceFilterFunc((UINT64) &mFilterSession, "eth0"));
+    TEST_ASSERT_FALSE(appInterfaceFilterFunc((UINT64) &mFilterSession, "docker0"));
+    TEST_ASSERT_FALSE(appInterfaceFilterFunc((UINT64) &mFilterSession, "veth1a2b3c"));
+    TEST_ASSERT_EQUAL(3, mFilterSession.candidateCount);
+    TEST_ASSERT_EQUAL(1, mFilterSession.acceptedCount);
+
+    // the allow list rejects the interfaces which do not match it, and the deny list still applies.
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, "eth*,docker*", "docker*");
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_TRUE(appInterfaceFilterFunc((UINT64) &mFilterSession, "eth1"));
+    TEST_ASSERT_FALSE(appInterfaceFilterFunc((UINT64) &mFilterSession, "wlan0"));
+    TEST_ASSERT_FALSE(appInterfaceFilterFunc((UINT64) &mFilterSession, "docker0"));
+}
+
+void test_appInterfaceFilterFunc_cidr(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, APP_INTERFACE_FILTER_UTEST_LOOPBACK_CIDR, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = initAppInterfaceFilterSession(&mFilterSession, &mInterfaceFilter);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    TEST_ASSERT_TRUE(appInterfaceFilterFunc((UINT64) &mFilterSession, APP_INTERFACE_FILTER_UTEST_LOOPBACK));
+    TEST_ASSERT_NOT_NULL(mFilterSession.pIfAddrs);
+
+    retStatus = setAppInterfaceFilterRules(&mInterfaceFilter, APP_INTERFACE_FILTER_UTEST_OTHER_CIDR, NULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_FALSE(appInterfaceFilterFunc((UINT64) &mFilterSession, APP_INTERFACE_FILTER_UTEST_LOOPBACK));
+
+    retStatus = freeAppInterfaceFilterSession(&mFilterSession);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_NULL(mFilterSession.pIfAddrs);
+}
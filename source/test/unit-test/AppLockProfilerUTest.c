@@ -0,0 +1,154 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include "unity.h"
+#include "AppLockProfiler.h"
+#include "mock_Include.h"
+
+#define APP_LOCK_PROFILER_UTEST_CHANNEL "utest-channel"
+#define APP_LOCK_PROFILER_UTEST_HOLD    (20 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+
+typedef struct {
+    MUTEX lock;
+    volatile ATOMIC_BOOL locked;
+} LockProfilerContext, *PLockProfilerContext;
+
+static LockProfilerContext mContext;
+
+/* Called before each test method. */
+void setUp()
+{
+    MEMSET(&mContext, 0x00, SIZEOF(LockProfilerContext));
+    mContext.lock = MUTEX_CREATE(TRUE);
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    MUTEX_FREE(mContext.lock);
+}
+
+static PVOID holdLockRoutine(PVOID userData)
+{
+    PLockProfilerContext pContext = (PLockProfilerContext) userData;
+
+    appLockProfilerLock(pContext->lock, "pContext->lock", (PCHAR) __FUNCTION__, __LINE__);
+    ATOMIC_STORE_BOOL(&pContext->locked, TRUE);
+    THREAD_SLEEP(APP_LOCK_PROFILER_UTEST_HOLD);
+    appLockProfilerUnlock(pContext->lock);
+    return NULL;
+}
+
+void test_appLockProfilerLock(void)
+{
+    PAppLockStats pStats = NULL;
+    UINT64 acquireCount, holdCount;
+    UINT32 i, depth;
+    BOOL siteFound = FALSE;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_LOCK_PROFILER_NULL_ARG, getAppLockStats(mContext.lock, NULL));
+    // the stats of a mutex are created by its first lock.
+    appLockProfilerLock(mContext.lock, "mContext.lock", (PCHAR) __FUNCTION__, __LINE__);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppLockStats(mContext.lock, &pStats));
+    TEST_ASSERT_NOT_NULL(pStats);
+    TEST_ASSERT_EQUAL_STRING("lock", pStats->name);
+    acquireCount = pStats->acquireCount;
+    holdCount = pStats->holdCount;
+    depth = pStats->depth;
+
+    // the hold ends with the outermost unlock.
+    appLockProfilerLock(mContext.lock, "mContext.lock", (PCHAR) __FUNCTION__, __LINE__);
+    TEST_ASSERT_EQUAL(acquireCount + 1, pStats->acquireCount);
+    TEST_ASSERT_EQUAL(depth + 1, pStats->depth);
+    appLockProfilerUnlock(mContext.lock);
+    TEST_ASSERT_EQUAL(holdCount, pStats->holdCount);
+    appLockProfilerUnlock(mContext.lock);
+    TEST_ASSERT_EQUAL(holdCount + 1, pStats->holdCount);
+    TEST_ASSERT_EQUAL(0, pStats->depth);
+    for (i = 0; i < pStats->siteCount; i++) {
+        siteFound = siteFound || STRCMP(pStats->sites[i].pFunction, __FUNCTION__) == 0;
+    }
+    TEST_ASSERT_TRUE(siteFound);
+}
+
+void test_appLockProfilerLock_contended(void)
+{
+    PAppLockStats pStats = NULL;
+    TID tid = INVALID_TID_VALUE;
+    UINT64 contendedCount = 0, maxWait = 0;
+
+    if (STATUS_SUCCEEDED(getAppLockStats(mContext.lock, &pStats))) {
+        contendedCount = pStats->contendedCount;
+        maxWait = pStats->maxWait;
+    }
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, THREAD_CREATE(&tid, holdLockRoutine, (PVOID) &mContext));
+    while (!ATOMIC_LOAD_BOOL(&mContext.locked)) {
+        THREAD_SLEEP(HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    }
+    appLockProfilerLock(mContext.lock, "mContext.lock", (PCHAR) __FUNCTION__, __LINE__);
+    appLockProfilerUnlock(mContext.lock);
+    THREAD_JOIN(tid, NULL);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppLockStats(mContext.lock, &pStats));
+    TEST_ASSERT_EQUAL(contendedCount + 1, pStats->contendedCount);
+    TEST_ASSERT_TRUE(pStats->maxWait >= maxWait && pStats->maxWait > 0);
+    TEST_ASSERT_TRUE(pStats->maxHold > 0);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, dumpAppLockProfile());
+}
+
+void test_appLockProfilerWait(void)
+{
+    CVAR cvar = CVAR_CREATE();
+    PAppLockStats pStats = NULL;
+    UINT64 holdCount;
+
+    appLockProfilerLock(mContext.lock, "mContext.lock", (PCHAR) __FUNCTION__, __LINE__);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppLockStats(mContext.lock, &pStats));
+    holdCount = pStats->holdCount;
+
+    // the wait releases the lock, so it ends the hold and starts a new one.
+    TEST_ASSERT_EQUAL(STATUS_OPERATION_TIMED_OUT, appLockProfilerWait(cvar, mContext.lock, "mContext.lock", HUNDREDS_OF_NANOS_IN_A_MILLISECOND));
+    TEST_ASSERT_EQUAL(holdCount + 1, pStats->holdCount);
+    TEST_ASSERT_EQUAL(1, pStats->depth);
+    appLockProfilerUnlock(mContext.lock);
+    TEST_ASSERT_EQUAL(holdCount + 2, pStats->holdCount);
+
+    CVAR_FREE(cvar);
+}
+
+void test_exportAppLockProfile(void)
+{
+    PAppMetricsRegistry pRegistry = NULL;
+    UINT32 bufferLen = 0;
+    PCHAR pBuffer = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_LOCK_PROFILER_NULL_ARG, exportAppLockProfile(NULL));
+
+    appLockProfilerLock(mContext.lock, "mContext.lock", (PCHAR) __FUNCTION__, __LINE__);
+    appLockProfilerUnlock(mContext.lock);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppMetricsRegistry(APP_LOCK_PROFILER_UTEST_CHANNEL, &pRegistry));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, exportAppLockProfile(pRegistry));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, renderAppMetrics(pRegistry, NULL, &bufferLen));
+    pBuffer = (PCHAR) MEMALLOC(bufferLen);
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, renderAppMetrics(pRegistry, pBuffer, &bufferLen));
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "webrtc_app_lock_acquisitions_total{"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "lock=\"lock\""));
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "webrtc_app_lock_hold_p99_seconds{"));
+
+    MEMFREE(pBuffer);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppMetricsRegistry(&pRegistry));
+}
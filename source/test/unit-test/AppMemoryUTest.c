@@ -0,0 +1,188 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include "unity.h"
+#include "AppMemory.h"
+#include "mock_Include.h"
+
+#define APP_MEMORY_UTEST_CHANNEL "utest-channel"
+
+/* Called before each test method. */
+void setUp()
+{
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, initAppMemory());
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, deinitAppMemory());
+}
+
+void test_initAppMemory(void)
+{
+    PAppMemoryStats pStats = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_MEMORY_INITIALIZED, initAppMemory());
+    TEST_ASSERT_EQUAL(STATUS_APP_MEMORY_NULL_ARG, getAppMemoryStats(APP_MEMORY_TAG_SDK, NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_MEMORY_INVALID_TAG, getAppMemoryStats(APP_MEMORY_TAG_COUNT, &pStats));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMemoryStats(APP_MEMORY_TAG_SDK, &pStats));
+    TEST_ASSERT_NOT_NULL(pStats);
+}
+
+void test_setAppMemoryTag(void)
+{
+    PAppMemoryStats pSessionStats = NULL, pSdkStats = NULL;
+    APP_MEMORY_TAG prevTag;
+    SIZE_T sdkBytes;
+    PBYTE pBuffer;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMemoryStats(APP_MEMORY_TAG_SESSION, &pSessionStats));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMemoryStats(APP_MEMORY_TAG_SDK, &pSdkStats));
+    sdkBytes = pSdkStats->liveBytes;
+
+    prevTag = setAppMemoryTag(APP_MEMORY_TAG_SESSION);
+    TEST_ASSERT_EQUAL(APP_MEMORY_TAG_SDK, prevTag);
+    pBuffer = (PBYTE) MEMALLOC(100);
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(100, pSessionStats->liveBytes);
+    TEST_ASSERT_EQUAL(1, pSessionStats->allocCount);
+
+    // the block stays with the session after the thread changes its tag.
+    TEST_ASSERT_EQUAL(APP_MEMORY_TAG_SESSION, setAppMemoryTag(prevTag));
+    pBuffer = (PBYTE) MEMREALLOC(pBuffer, 300);
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(300, pSessionStats->liveBytes);
+    TEST_ASSERT_EQUAL(400, pSessionStats->allocBytes);
+    TEST_ASSERT_EQUAL(sdkBytes, pSdkStats->liveBytes);
+
+    MEMFREE(pBuffer);
+    TEST_ASSERT_EQUAL(0, pSessionStats->liveBytes);
+    TEST_ASSERT_EQUAL(2, pSessionStats->freeCount);
+}
+
+void test_callocAppMemory(void)
+{
+    PAppMemoryStats pStats = NULL;
+    PUINT64 pBuffer;
+    UINT32 i;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMemoryStats(APP_MEMORY_TAG_CERTIFICATE, &pStats));
+    pBuffer = (PUINT64) callocAppMemory(APP_MEMORY_TAG_CERTIFICATE, 4, SIZEOF(UINT64));
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    for (i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(0, pBuffer[i]);
+    }
+    TEST_ASSERT_EQUAL(4 * SIZEOF(UINT64), pStats->liveBytes);
+    TEST_ASSERT_EQUAL(APP_MEMORY_TAG_SDK, setAppMemoryTag(APP_MEMORY_TAG_SDK));
+
+    MEMFREE(pBuffer);
+    TEST_ASSERT_EQUAL(0, pStats->liveBytes);
+}
+
+void test_appMemoryAlignAlloc(void)
+{
+    PAppMemoryStats pStats = NULL;
+    PBYTE pBuffer;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMemoryStats(APP_MEMORY_TAG_MEDIA, &pStats));
+    setAppMemoryTag(APP_MEMORY_TAG_MEDIA);
+    pBuffer = (PBYTE) MEMALIGNALLOC(256, 64);
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(0, (UINT64) pBuffer % 64);
+    TEST_ASSERT_EQUAL(256, pStats->liveBytes);
+
+    // an aligned block keeps its alignment when it grows.
+    pBuffer = (PBYTE) MEMREALLOC(pBuffer, 512);
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(0, (UINT64) pBuffer % 64);
+    TEST_ASSERT_EQUAL(512, pStats->liveBytes);
+
+    MEMFREE(pBuffer);
+    TEST_ASSERT_EQUAL(0, pStats->liveBytes);
+    setAppMemoryTag(APP_MEMORY_TAG_SDK);
+}
+
+void test_setAppMemorySession(void)
+{
+    PAppMemoryStats pSessionStats = NULL, pSdkStats = NULL;
+    UINT32 sessionId = APP_MEMORY_NO_SESSION, otherSessionId = APP_MEMORY_NO_SESSION;
+    SIZE_T sdkBytes;
+    PBYTE pBuffer;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_MEMORY_NULL_ARG, openAppMemorySession(NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_MEMORY_INVALID_SESSION, getAppMemorySessionStats(APP_MEMORY_NO_SESSION, &pSessionStats));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, openAppMemorySession(&sessionId));
+    TEST_ASSERT_NOT_EQUAL(APP_MEMORY_NO_SESSION, sessionId);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMemorySessionStats(sessionId, &pSessionStats));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMemoryStats(APP_MEMORY_TAG_SDK, &pSdkStats));
+    sdkBytes = pSdkStats->liveBytes;
+
+    // the allocations of the sdk for the session are charged to both.
+    TEST_ASSERT_EQUAL(APP_MEMORY_NO_SESSION, setAppMemorySession(sessionId));
+    pBuffer = (PBYTE) MEMALLOC(100);
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(sessionId, setAppMemorySession(APP_MEMORY_NO_SESSION));
+    TEST_ASSERT_EQUAL(100, pSessionStats->liveBytes);
+    TEST_ASSERT_EQUAL(sdkBytes + 100, pSdkStats->liveBytes);
+
+    // the slot of a closed session is not reused while it holds a block.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, closeAppMemorySession(sessionId));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, openAppMemorySession(&otherSessionId));
+    TEST_ASSERT_NOT_EQUAL(sessionId, otherSessionId);
+    pBuffer = (PBYTE) MEMREALLOC(pBuffer, 200);
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(200, pSessionStats->liveBytes);
+    MEMFREE(pBuffer);
+    TEST_ASSERT_EQUAL(0, pSessionStats->liveBytes);
+    TEST_ASSERT_EQUAL(sdkBytes, pSdkStats->liveBytes);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, closeAppMemorySession(otherSessionId));
+    TEST_ASSERT_EQUAL(STATUS_APP_MEMORY_INVALID_SESSION, closeAppMemorySession(APP_MEMORY_SESSION_SLOTS + 1));
+}
+
+void test_deinitAppMemory_live_blocks(void)
+{
+    PBYTE pBuffer = (PBYTE) MEMALLOC(100);
+
+    // the tagged allocators stay until the block is freed through them.
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(STATUS_APP_MEMORY_BLOCKS_LIVE, deinitAppMemory());
+    TEST_ASSERT_EQUAL(STATUS_APP_MEMORY_INITIALIZED, initAppMemory());
+    MEMFREE(pBuffer);
+}
+
+void test_reportAppMemory(void)
+{
+    PAppMetricsRegistry pRegistry = NULL;
+    PBYTE pBuffer = NULL;
+    PCHAR pRender = NULL;
+    UINT32 renderLen = 0;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppMetricsRegistry(APP_MEMORY_UTEST_CHANNEL, &pRegistry));
+    pBuffer = (PBYTE) callocAppMemory(APP_MEMORY_TAG_SESSION, 1, 1000);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, reportAppMemory(NULL));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, reportAppMemory(pRegistry));
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, renderAppMetrics(pRegistry, NULL, &renderLen));
+    pRender = (PCHAR) MEMALLOC(renderLen);
+    TEST_ASSERT_NOT_NULL(pRender);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, renderAppMetrics(pRegistry, pRender, &renderLen));
+    TEST_ASSERT_NOT_NULL(STRSTR(pRender, "webrtc_app_memory_live_bytes{channel=\"utest-channel\",subsystem=\"session\"} 1000\n"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pRender, "webrtc_app_memory_allocation_rate_bytes{"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pRender, "webrtc_app_memory_allocations_total{channel=\"utest-channel\",subsystem=\"sdk\"}"));
+
+    MEMFREE(pRender);
+    MEMFREE(pBuffer);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppMetricsRegistry(&pRegistry));
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "unity.h"
+#include "AppMetricsRegistry.h"
+#include "mock_Include.h"
+
+#define APP_METRICS_REGISTRY_UTEST_CHANNEL      "utest-channel"
+#define APP_METRICS_REGISTRY_UTEST_SESSION      "utest-session"
+#define APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET  "./utest_metrics.sock"
+#define APP_METRICS_REGISTRY_UTEST_OBSERVATIONS 100000
+
+static PAppMetricsRegistry mpRegistry = NULL;
+
+/* Called before each test method. */
+void setUp()
+{
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppMetricsRegistry(APP_METRICS_REGISTRY_UTEST_CHANNEL, &mpRegistry));
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppMetricsRegistry(&mpRegistry));
+    TEST_ASSERT_NULL(mpRegistry);
+}
+
+static PCHAR renderMetrics(VOID)
+{
+    UINT32 bufferLen = 0;
+    PCHAR pBuffer = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, renderAppMetrics(mpRegistry, NULL, &bufferLen));
+    pBuffer = (PCHAR) MEMALLOC(bufferLen);
+    TEST_ASSERT_NOT_NULL(pBuffer);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, renderAppMetrics(mpRegistry, pBuffer, &bufferLen));
+    TEST_ASSERT_EQUAL(STRLEN(pBuffer) + 1, bufferLen);
+    return pBuffer;
+}
+
+void test_createAppMetricsRegistry(void)
+{
+    PAppMetricsRegistry pRegistry = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_NULL_ARG, createAppMetricsRegistry(NULL, &pRegistry));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_NULL_ARG, createAppMetricsRegistry(APP_METRICS_REGISTRY_UTEST_CHANNEL, NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_NULL_ARG, freeAppMetricsRegistry(NULL));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppMetricsRegistry(&pRegistry));
+}
+
+void test_registerAppMetric(void)
+{
+    DOUBLE bounds[] = {0.1, 1, 10};
+    DOUBLE invalidBounds[] = {1, 0.1};
+    UINT32 metricId = 0, otherMetricId = 0;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_NULL_ARG,
+                      registerAppMetric(mpRegistry, NULL, "help", APP_METRIC_TYPE_COUNTER, NULL, NULL, NULL, 0, &metricId));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ARG,
+                      registerAppMetric(mpRegistry, "histogram", "help", APP_METRIC_TYPE_HISTOGRAM, NULL, NULL, NULL, 0, &metricId));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ARG,
+                      registerAppMetric(mpRegistry, "histogram", "help", APP_METRIC_TYPE_HISTOGRAM, NULL, NULL, invalidBounds, 2, &metricId));
+
+    // The same name and labels get the same metric.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, registerAppMetric(mpRegistry, "counter", "help", APP_METRIC_TYPE_COUNTER, NULL, NULL, NULL, 0, &metricId));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS,
+                      registerAppMetric(mpRegistry, "counter", "help", APP_METRIC_TYPE_COUNTER, NULL, NULL, NULL, 0, &otherMetricId));
+    TEST_ASSERT_EQUAL(metricId, otherMetricId);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS,
+                      registerAppMetric(mpRegistry, "counter", "help", APP_METRIC_TYPE_COUNTER, "session", "s", NULL, 0, &otherMetricId));
+    TEST_ASSERT_NOT_EQUAL(metricId, otherMetricId);
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH,
+                      registerAppMetric(mpRegistry, "counter", "help", APP_METRIC_TYPE_GAUGE, NULL, NULL, NULL, 0, &otherMetricId));
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, addAppMetric(mpRegistry, metricId, 2));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ARG, addAppMetric(mpRegistry, metricId, -1));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH, observeAppMetric(mpRegistry, metricId, 1));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ARG, setAppMetric(mpRegistry, APP_METRICS_REGISTRY_MAX_COUNT, 1));
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS,
+                      registerAppMetric(mpRegistry, "histogram", "help", APP_METRIC_TYPE_HISTOGRAM, NULL, NULL, bounds, 3, &metricId));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_TYPE_MISMATCH, setAppMetric(mpRegistry, metricId, 1));
+}
+
+void test_renderAppMetrics(void)
+{
+    DOUBLE bounds[] = {0.1, 1, 10};
+    UINT32 metricId = 0, bufferLen = 8;
+    CHAR smallBuffer[8];
+    PCHAR pBuffer = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppGauge(mpRegistry, "webrtc_app_sessions", "The sessions.", NULL, NULL, 2));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppGauge(mpRegistry, "webrtc_app_rtt", "The rtt.", "session", "a\"b\\c\nd", 0.25));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppGauge(mpRegistry, "webrtc_app_rtt", "The rtt.", "session", "e", 0.5));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS,
+                      registerAppMetric(mpRegistry, "webrtc_app_latency", "latency", APP_METRIC_TYPE_HISTOGRAM, NULL, NULL, bounds, 3, &metricId));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, observeAppMetric(mpRegistry, metricId, 0.05));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, observeAppMetric(mpRegistry, metricId, 1));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, observeAppMetric(mpRegistry, metricId, 100));
+
+    pBuffer = renderMetrics();
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "# TYPE webrtc_app_sessions gauge\nwebrtc_app_sessions{channel=\"utest-channel\"} 2\n"));
+    // The samples of a family are rendered together, after one help and type.
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer,
+                                "# TYPE webrtc_app_rtt gauge\n"
+                                "webrtc_app_rtt{channel=\"utest-channel\",session=\"a\\\"b\\\\c\\nd\"} 0.25\n"
+                                "webrtc_app_rtt{channel=\"utest-channel\",session=\"e\"} 0.5\n"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer,
+                                "webrtc_app_latency_bucket{channel=\"utest-channel\",le=\"0.1\"} 1\n"
+                                "webrtc_app_latency_bucket{channel=\"utest-channel\",le=\"1\"} 2\n"
+                                "webrtc_app_latency_bucket{channel=\"utest-channel\",le=\"10\"} 2\n"
+                                "webrtc_app_latency_bucket{channel=\"utest-channel\",le=\"+Inf\"} 3\n"
+                                "webrtc_app_latency_sum{channel=\"utest-channel\"} 101.05\n"
+                                "webrtc_app_latency_count{channel=\"utest-channel\"} 3\n"));
+    SAFE_MEMFREE(pBuffer);
+
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_BUFFER_TOO_SMALL, renderAppMetrics(mpRegistry, smallBuffer, &bufferLen));
+    TEST_ASSERT_EQUAL('\0', smallBuffer[7]);
+}
+
+void test_removeAppMetrics(void)
+{
+    PCHAR pBuffer = NULL;
+    UINT32 metricId, newMetricId;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppGauge(mpRegistry, "webrtc_app_sessions", "The sessions.", NULL, NULL, 1));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppGauge(mpRegistry, "webrtc_app_rtt", "The rtt.", "session", APP_METRICS_REGISTRY_UTEST_SESSION, 0.25));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS,
+                      setAppGauge(mpRegistry, "webrtc_app_bitrate", "The bitrate.", "session", APP_METRICS_REGISTRY_UTEST_SESSION, 1000));
+    TEST_ASSERT_EQUAL(3, mpRegistry->metricCount);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppMetrics(mpRegistry, "session", APP_METRICS_REGISTRY_UTEST_SESSION));
+    TEST_ASSERT_EQUAL(1, mpRegistry->metricCount);
+    pBuffer = renderMetrics();
+    TEST_ASSERT_NULL(STRSTR(pBuffer, "webrtc_app_rtt"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "webrtc_app_sessions"));
+    SAFE_MEMFREE(pBuffer);
+
+    // The id of a removed metric is refused, also after its slot is reused by another session.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, registerAppMetric(mpRegistry, "webrtc_app_delay", "The delay.", APP_METRIC_TYPE_SUMMARY, "session",
+                                                        APP_METRICS_REGISTRY_UTEST_SESSION, NULL, 0, &metricId));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, observeAppMetric(mpRegistry, metricId, 1));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppMetrics(mpRegistry, "session", APP_METRICS_REGISTRY_UTEST_SESSION));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ARG, observeAppMetric(mpRegistry, metricId, 1));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, registerAppMetric(mpRegistry, "webrtc_app_delay", "The delay.", APP_METRIC_TYPE_SUMMARY, "session",
+                                                        "other", NULL, 0, &newMetricId));
+    TEST_ASSERT_NOT_EQUAL(metricId, newMetricId);
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ARG, observeAppMetric(mpRegistry, metricId, 1));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, observeAppMetric(mpRegistry, newMetricId, 1));
+    TEST_ASSERT_EQUAL(1, mpRegistry->metrics[newMetricId & 0xFFFF].count);
+}
+
+void test_startAppMetricsExporter(void)
+{
+    struct sockaddr_un addr;
+    CHAR response[1024];
+    PCHAR pRequest = "GET /metrics HTTP/1.0\r\n\r\n";
+    INT32 fd, idleFd;
+    ssize_t len, totalLen = 0;
+    struct stat pathStat;
+    FILE* pFile;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_NULL_ARG, startAppMetricsExporter(mpRegistry, NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT, startAppMetricsExporter(mpRegistry, "unix:"));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT, startAppMetricsExporter(mpRegistry, "70000"));
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT, startAppMetricsExporter(mpRegistry, "localhost:9100"));
+    TEST_ASSERT_EQUAL(-1, mpRegistry->listenFd);
+
+    // A file which is not a socket is left alone.
+    pFile = FOPEN(APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET, "w");
+    TEST_ASSERT_NOT_NULL(pFile);
+    FCLOSE(pFile);
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ENDPOINT,
+                      startAppMetricsExporter(mpRegistry, APP_METRICS_EXPORTER_UNIX_PREFIX APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET));
+    TEST_ASSERT_EQUAL(0, access(APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET, F_OK));
+    TEST_ASSERT_EQUAL(0, unlink(APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET));
+    TEST_ASSERT_EQUAL(-1, mpRegistry->listenFd);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppGauge(mpRegistry, "webrtc_app_sessions", "The sessions.", NULL, NULL, 1));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, startAppMetricsExporter(mpRegistry, APP_METRICS_EXPORTER_UNIX_PREFIX APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET));
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    TEST_ASSERT_TRUE(fd >= 0);
+    MEMSET(&addr, 0x00, SIZEOF(addr));
+    addr.sun_family = AF_UNIX;
+    STRNCPY(addr.sun_path, APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET, SIZEOF(addr.sun_path) - 1);
+
+    // Only the owner may connect.
+    TEST_ASSERT_EQUAL(0, stat(APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET, &pathStat));
+    TEST_ASSERT_TRUE(S_ISSOCK(pathStat.st_mode));
+    TEST_ASSERT_EQUAL(S_IRUSR | S_IWUSR, pathStat.st_mode & 0777);
+
+    // A scraper which connects and sends nothing does not hold up the next one.
+    idleFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    TEST_ASSERT_TRUE(idleFd >= 0);
+    TEST_ASSERT_EQUAL(0, connect(idleFd, (struct sockaddr*) &addr, SIZEOF(addr)));
+
+    TEST_ASSERT_EQUAL(0, connect(fd, (struct sockaddr*) &addr, SIZEOF(addr)));
+    TEST_ASSERT_EQUAL(STRLEN(pRequest), send(fd, pRequest, STRLEN(pRequest), 0));
+    while ((len = recv(fd, response + totalLen, SIZEOF(response) - 1 - totalLen, 0)) > 0) {
+        totalLen += len;
+    }
+    response[totalLen] = '\0';
+    close(fd);
+    close(idleFd);
+
+    TEST_ASSERT_NOT_NULL(STRSTR(response, "HTTP/1.0 200 OK\r\n"));
+    TEST_ASSERT_NOT_NULL(STRSTR(response, "webrtc_app_sessions{channel=\"utest-channel\"} 1\n"));
+
+    // The socket file is removed with the registry.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppMetricsRegistry(&mpRegistry));
+    TEST_ASSERT_NOT_EQUAL(0, access(APP_METRICS_REGISTRY_UTEST_UNIX_SOCKET, F_OK));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppMetricsRegistry(APP_METRICS_REGISTRY_UTEST_CHANNEL, &mpRegistry));
+}
+
+void test_observeAppMetric_summary(void)
+{
+    UINT32 metricId = 0, i;
+    DOUBLE value = 0;
+    PCHAR pBuffer = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS,
+                      registerAppMetric(mpRegistry, "webrtc_app_latency", "latency", APP_METRIC_TYPE_SUMMARY, "track", "video", NULL, 0, &metricId));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMetricQuantile(mpRegistry, metricId, 0.5, &value));
+    TEST_ASSERT_EQUAL(0, value);
+
+    // 1ms to 1s, the quantiles are within the relative error of the log-linear buckets.
+    for (i = 1; i <= 1000; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, observeAppMetric(mpRegistry, metricId, i * 0.001));
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMetricQuantile(mpRegistry, metricId, 0.5, &value));
+    TEST_ASSERT_TRUE(value >= 0.5 && value <= 0.5 * 1.04);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMetricQuantile(mpRegistry, metricId, 0.99, &value));
+    TEST_ASSERT_TRUE(value >= 0.99 && value <= 0.99 * 1.04);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMetricQuantile(mpRegistry, metricId, 0.999, &value));
+    TEST_ASSERT_TRUE(value >= 0.999 && value <= 0.999 * 1.04);
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REGISTRY_INVALID_ARG, getAppMetricQuantile(mpRegistry, metricId, 2, &value));
+
+    // The values below the sub-buckets are exact, and the ones beyond the range land in the last bucket.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppMetrics(mpRegistry, "track", "video"));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS,
+                      registerAppMetric(mpRegistry, "webrtc_app_latency", "latency", APP_METRIC_TYPE_SUMMARY, "track", "audio", NULL, 0, &metricId));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, observeAppMetric(mpRegistry, metricId, 0.000042));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMetricQuantile(mpRegistry, metricId, 1, &value));
+    TEST_ASSERT_EQUAL(42, (UINT32) (value * 1000000 + 0.5));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, observeAppMetric(mpRegistry, metricId, 1000000));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppMetricQuantile(mpRegistry, metricId, 1, &value));
+    TEST_ASSERT_TRUE(value >= 4294 && value < 4295);
+
+    pBuffer = renderMetrics();
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "# TYPE webrtc_app_latency summary\n"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "webrtc_app_latency{channel=\"utest-channel\",track=\"audio\",quantile=\"0.5\"} 4.2e-05\n"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "webrtc_app_latency_count{channel=\"utest-channel\",track=\"audio\"} 2\n"));
+    SAFE_MEMFREE(pBuffer);
+}
+
+static PVOID observeAppMetricRoutine(PVOID args)
+{
+    UINT32 i, metricId = *(PUINT32) args;
+
+    for (i = 0; i < APP_METRICS_REGISTRY_UTEST_OBSERVATIONS; i++) {
+        observeAppMetric(mpRegistry, metricId, 1);
+    }
+    return NULL;
+}
+
+void test_observeAppMetric_concurrent(void)
+{
+    UINT32 metricId = 0, i;
+    pthread_t threads[2];
+    PCHAR pBuffer = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS,
+                      registerAppMetric(mpRegistry, "webrtc_app_latency", "latency", APP_METRIC_TYPE_SUMMARY, "track", "video", NULL, 0, &metricId));
+    for (i = 0; i < ARRAY_SIZE(threads); i++) {
+        TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, observeAppMetricRoutine, &metricId));
+    }
+    // The scrapes go on while the observations do, and no observation is lost.
+    for (i = 0; i < 10; i++) {
+        pBuffer = renderMetrics();
+        SAFE_MEMFREE(pBuffer);
+    }
+    for (i = 0; i < ARRAY_SIZE(threads); i++) {
+        TEST_ASSERT_EQUAL(0, pthread_join(threads[i], NULL));
+    }
+
+    pBuffer = renderMetrics();
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "webrtc_app_latency_count{channel=\"utest-channel\",track=\"video\"} 200000\n"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pBuffer, "webrtc_app_latency_sum{channel=\"utest-channel\",track=\"video\"} 200000\n"));
+    SAFE_MEMFREE(pBuffer);
+}
@@ -49,6 +49,18 @@ static STATUS rtcPeerConnectionGetMetrics_callBack(PRtcPeerConnection pRtcPeerCo
     return STATUS_SUCCESS;
 }
 
+static STATUS rtcPeerConnectionGetMetrics_rtp_callBack(PRtcPeerConnection pRtcPeerConnection, PRtcRtpTransceiver pRtcRtpTransceiver,
+                                                       PRtcStats pRtcMetrics, int NumCalls)
+{
+    PRtcStatsObject pRtcStatsObject = getRtcStatsObject();
+
+    if (pRtcMetrics->requestedTypeOfStats == RTC_STATS_TYPE_REMOTE_INBOUND_RTP && callBackRetStatus != STATUS_SUCCESS) {
+        return callBackRetStatus;
+    }
+    memcpy(&pRtcMetrics->rtcStatsObject, pRtcStatsObject, sizeof(RtcStatsObject));
+    return STATUS_SUCCESS;
+}
+
 /* Called before each test method. */
 void setUp()
 {
@@ -179,6 +191,55 @@ void test_logSelectedIceCandidatesInformation(void)
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 }
 
+void test_getRtpQualityStats(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PRtcPeerConnection pRtcPeerConnection = getPeerConnectionContext();
+    PRtcRtpTransceiver pRtcRtpTransceiver = (PRtcRtpTransceiver) getPeerConnectionContext();
+    PRtcStatsObject pRtcStatsObject = getRtcStatsObject();
+    AppRtpQualityStats qualityStats;
+
+    memset(&qualityStats, 0, sizeof(AppRtpQualityStats));
+    retStatus = getRtpQualityStats(NULL, pRtcRtpTransceiver, &qualityStats);
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_NULL_ARG, retStatus);
+    retStatus = getRtpQualityStats(pRtcPeerConnection, NULL, &qualityStats);
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_NULL_ARG, retStatus);
+
+    rtcPeerConnectionGetMetrics_IgnoreAndReturn(STATUS_NULL_ARG);
+    retStatus = getRtpQualityStats(pRtcPeerConnection, pRtcRtpTransceiver, &qualityStats);
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_OUTBOUND_RTP, retStatus);
+
+    // The outbound stats are kept when the remote inbound stats are not available.
+    memset(pRtcStatsObject, 0, sizeof(RtcStatsObject));
+    pRtcStatsObject->outboundRtpStreamStats.nackCount = 3;
+    pRtcStatsObject->outboundRtpStreamStats.pliCount = 2;
+    pRtcStatsObject->outboundRtpStreamStats.retransmittedBytesSent = 1000;
+    callBackRetStatus = STATUS_NULL_ARG;
+    rtcPeerConnectionGetMetrics_StubWithCallback(rtcPeerConnectionGetMetrics_rtp_callBack);
+    retStatus = getRtpQualityStats(pRtcPeerConnection, pRtcRtpTransceiver, &qualityStats);
+    TEST_ASSERT_EQUAL(STATUS_APP_METRICS_REMOTE_INBOUND_RTP, retStatus);
+    TEST_ASSERT_EQUAL(3, qualityStats.nackCount);
+    TEST_ASSERT_FALSE(qualityStats.remoteReported);
+
+    // The counters of the transceivers are added, and the worst loss is kept.
+    memset(&qualityStats, 0, sizeof(AppRtpQualityStats));
+    pRtcStatsObject->remoteInboundRtpStreamStats.reportsReceived = 1;
+    pRtcStatsObject->remoteInboundRtpStreamStats.fractionLost = 0.1;
+    pRtcStatsObject->remoteInboundRtpStreamStats.roundTripTime = 0.05;
+    callBackRetStatus = STATUS_SUCCESS;
+    retStatus = getRtpQualityStats(pRtcPeerConnection, pRtcRtpTransceiver, &qualityStats);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    pRtcStatsObject->remoteInboundRtpStreamStats.fractionLost = 0.02;
+    retStatus = getRtpQualityStats(pRtcPeerConnection, pRtcRtpTransceiver, &qualityStats);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(6, qualityStats.nackCount);
+    TEST_ASSERT_EQUAL(4, qualityStats.pliCount);
+    TEST_ASSERT_EQUAL(2000, qualityStats.retransmittedBytesSent);
+    TEST_ASSERT_TRUE(qualityStats.remoteReported);
+    TEST_ASSERT_TRUE(qualityStats.fractionLost == 0.1);
+    TEST_ASSERT_TRUE(qualityStats.roundTripTime == 0.05);
+}
+
 static SignalingClientMetrics mSignalingClientMetrics;
 
 PSignalingClientMetrics getSignalingContext(void)
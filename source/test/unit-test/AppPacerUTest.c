@@ -0,0 +1,286 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include "unity.h"
+#include "AppPacer.h"
+#include "mock_Include.h"
+
+#define APP_PACER_UTEST_MAX_WRITES 8
+#define APP_PACER_UTEST_FRAME_SIZE 2000
+#define APP_PACER_UTEST_TIMEOUT    (2 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+
+typedef struct {
+    UINT32 writeCount;
+    UINT64 writeTimes[APP_PACER_UTEST_MAX_WRITES];
+    UINT32 indexes[APP_PACER_UTEST_MAX_WRITES];
+    UINT32 sizes[APP_PACER_UTEST_MAX_WRITES];
+    BYTE firstBytes[APP_PACER_UTEST_MAX_WRITES];
+} AppPacerUTestFlow, *PAppPacerUTestFlow;
+
+static BYTE mFrameData[APP_PACER_UTEST_FRAME_SIZE];
+
+/* Called before each test method. */
+void setUp()
+{
+    UINT32 i;
+
+    for (i = 0; i < APP_PACER_UTEST_FRAME_SIZE; i++) {
+        mFrameData[i] = (BYTE) i;
+    }
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+}
+
+static STATUS appPacerUTestWriter(PVOID udata, PFrame pFrame, UINT64 entryTime)
+{
+    PAppPacerUTestFlow pFlow = (PAppPacerUTestFlow) udata;
+
+    UNUSED_PARAM(entryTime);
+    if (pFlow->writeCount < APP_PACER_UTEST_MAX_WRITES) {
+        pFlow->writeTimes[pFlow->writeCount] = GETTIME();
+        pFlow->indexes[pFlow->writeCount] = pFrame->index;
+        pFlow->sizes[pFlow->writeCount] = pFrame->size;
+        pFlow->firstBytes[pFlow->writeCount] = pFrame->frameData[0];
+        pFlow->writeCount++;
+    }
+    return STATUS_SUCCESS;
+}
+
+static VOID queueFrame(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, UINT32 size, UINT32 index, STATUS expected)
+{
+    Frame frame;
+    PAppPacerFrame pAppPacerFrame = NULL;
+
+    MEMSET(&frame, 0x00, SIZEOF(Frame));
+    frame.trackId = DEFAULT_VIDEO_TRACK_ID;
+    frame.flags = FRAME_FLAG_KEY_FRAME;
+    frame.size = size;
+    frame.frameData = mFrameData;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacerFrame(pAppPacer, &frame, GETTIME(), &pAppPacerFrame));
+    TEST_ASSERT_EQUAL(expected, queueAppPacerFrame(pAppPacer, pAppPacerFlow, pAppPacerFrame, index));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, releaseAppPacerFrame(&pAppPacerFrame));
+    TEST_ASSERT_NULL(pAppPacerFrame);
+}
+
+static VOID waitFramesSent(PAppPacer pAppPacer, PAppPacerFlow pAppPacerFlow, UINT64 framesSent)
+{
+    AppPacerFlowStats stats;
+    UINT64 deadline = GETTIME() + APP_PACER_UTEST_TIMEOUT;
+
+    do {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppPacerFlowStats(pAppPacer, pAppPacerFlow, &stats));
+        if (stats.framesSent >= framesSent) {
+            return;
+        }
+        THREAD_SLEEP(10 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    } while (GETTIME() < deadline);
+    TEST_FAIL_MESSAGE("the frames are not written");
+}
+
+void test_create_free(void)
+{
+    PAppPacer pAppPacer = NULL;
+    PAppPacerFlow pAppPacerFlow = NULL;
+    AppPacerUTestFlow flow;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_PACER_NULL_ARG, createAppPacer(100, NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_PACER_INVALID_ARG, createAppPacer(0, &pAppPacer));
+    TEST_ASSERT_NULL(pAppPacer);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacer(100, &pAppPacer));
+    TEST_ASSERT_NOT_NULL(pAppPacer);
+
+    TEST_ASSERT_EQUAL(STATUS_APP_PACER_NULL_ARG, addAppPacerFlow(pAppPacer, NULL, &flow, &pAppPacerFlow));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, addAppPacerFlow(pAppPacer, appPacerUTestWriter, &flow, &pAppPacerFlow));
+    TEST_ASSERT_EQUAL(STATUS_APP_PACER_INVALID_ARG, setAppPacerFlowBitrate(pAppPacer, pAppPacerFlow, 0));
+    TEST_ASSERT_EQUAL(STATUS_APP_PACER_NULL_ARG, queueAppPacerFrame(pAppPacer, pAppPacerFlow, NULL, 0));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppPacerFlow(pAppPacer, &pAppPacerFlow));
+    TEST_ASSERT_NULL(pAppPacerFlow);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppPacerFlow(pAppPacer, &pAppPacerFlow));
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppPacer(&pAppPacer));
+    TEST_ASSERT_NULL(pAppPacer);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppPacer(&pAppPacer));
+    TEST_ASSERT_EQUAL(STATUS_APP_PACER_NULL_ARG, freeAppPacer(NULL));
+}
+
+void test_pacing(void)
+{
+    PAppPacer pAppPacer = NULL;
+    PAppPacerFlow pAppPacerFlow = NULL;
+    AppPacerUTestFlow flow;
+    AppPacerFlowStats stats;
+
+    MEMSET(&flow, 0x00, SIZEOF(flow));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacer(100, &pAppPacer));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, addAppPacerFlow(pAppPacer, appPacerUTestWriter, &flow, &pAppPacerFlow));
+    // 10000 bytes per second, the large frame leaves a debt of about 190ms.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppPacerFlowBitrate(pAppPacer, pAppPacerFlow, 80000));
+
+    queueFrame(pAppPacer, pAppPacerFlow, APP_PACER_UTEST_FRAME_SIZE, 1, STATUS_SUCCESS);
+    queueFrame(pAppPacer, pAppPacerFlow, 10, 2, STATUS_SUCCESS);
+    waitFramesSent(pAppPacer, pAppPacerFlow, 2);
+
+    TEST_ASSERT_EQUAL(2, flow.writeCount);
+    TEST_ASSERT_EQUAL(1, flow.indexes[0]);
+    TEST_ASSERT_EQUAL(2, flow.indexes[1]);
+    TEST_ASSERT_EQUAL(APP_PACER_UTEST_FRAME_SIZE, flow.sizes[0]);
+    TEST_ASSERT_EQUAL(10, flow.sizes[1]);
+    TEST_ASSERT_TRUE(flow.writeTimes[1] - flow.writeTimes[0] >= 150 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppPacerFlowStats(pAppPacer, pAppPacerFlow, &stats));
+    TEST_ASSERT_EQUAL(2, stats.framesQueued);
+    TEST_ASSERT_EQUAL(2, stats.framesSent);
+    TEST_ASSERT_EQUAL(0, stats.framesLate);
+    TEST_ASSERT_EQUAL(APP_PACER_UTEST_FRAME_SIZE + 10, stats.bytesSent);
+    TEST_ASSERT_EQUAL(0, stats.queuedBytes);
+    TEST_ASSERT_EQUAL_DOUBLE(10000, stats.rate);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppPacerFlow(pAppPacer, &pAppPacerFlow));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppPacer(&pAppPacer));
+}
+
+void test_max_delay(void)
+{
+    PAppPacer pAppPacer = NULL;
+    PAppPacerFlow pAppPacerFlow = NULL;
+    AppPacerUTestFlow flow;
+    AppPacerFlowStats stats;
+
+    MEMSET(&flow, 0x00, SIZEOF(flow));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacer(100, &pAppPacer));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, addAppPacerFlow(pAppPacer, appPacerUTestWriter, &flow, &pAppPacerFlow));
+    // 1000 bytes per second, the debt of 2s is cut short by the max delay.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppPacerFlowBitrate(pAppPacer, pAppPacerFlow, 8000));
+
+    queueFrame(pAppPacer, pAppPacerFlow, APP_PACER_UTEST_FRAME_SIZE, 1, STATUS_SUCCESS);
+    queueFrame(pAppPacer, pAppPacerFlow, 10, 2, STATUS_SUCCESS);
+    waitFramesSent(pAppPacer, pAppPacerFlow, 2);
+
+    TEST_ASSERT_TRUE(flow.writeTimes[1] - flow.writeTimes[0] >= APP_PACER_MAX_DELAY / 2);
+    TEST_ASSERT_TRUE(flow.writeTimes[1] - flow.writeTimes[0] < APP_PACER_UTEST_TIMEOUT);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppPacerFlowStats(pAppPacer, pAppPacerFlow, &stats));
+    TEST_ASSERT_EQUAL(1, stats.framesLate);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppPacerFlow(pAppPacer, &pAppPacerFlow));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppPacer(&pAppPacer));
+}
+
+void test_queue_full(void)
+{
+    PAppPacer pAppPacer = NULL;
+    PAppPacerFlow pAppPacerFlow = NULL;
+    AppPacerUTestFlow flow;
+    AppPacerFlowStats stats;
+    UINT32 i;
+
+    MEMSET(&flow, 0x00, SIZEOF(flow));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacer(100, &pAppPacer));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, addAppPacerFlow(pAppPacer, appPacerUTestWriter, &flow, &pAppPacerFlow));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppPacerFlowBitrate(pAppPacer, pAppPacerFlow, 8000));
+
+    // the first frame puts the flow in debt, the others wait in the queue.
+    queueFrame(pAppPacer, pAppPacerFlow, APP_PACER_UTEST_FRAME_SIZE, 0, STATUS_SUCCESS);
+    waitFramesSent(pAppPacer, pAppPacerFlow, 1);
+    for (i = 0; i < APP_PACER_QUEUE_DEPTH; i++) {
+        queueFrame(pAppPacer, pAppPacerFlow, 10, i + 1, STATUS_SUCCESS);
+    }
+    queueFrame(pAppPacer, pAppPacerFlow, 10, i + 1, STATUS_APP_PACER_QUEUE_FULL);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppPacerFlowStats(pAppPacer, pAppPacerFlow, &stats));
+    TEST_ASSERT_EQUAL(1, stats.framesDropped);
+    TEST_ASSERT_EQUAL(APP_PACER_QUEUE_DEPTH * 10, stats.queuedBytes);
+
+    // the queued frames are dropped with the flow.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppPacerFlow(pAppPacer, &pAppPacerFlow));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppPacer(&pAppPacer));
+}
+
+void test_shared_frame(void)
+{
+    PAppPacer pAppPacer = NULL;
+    PAppPacerFlow pAppPacerFlows[2] = {NULL, NULL};
+    AppPacerUTestFlow flows[2];
+    PAppPacerFrame pAppPacerFrame = NULL;
+    Frame frame;
+    UINT32 i;
+
+    MEMSET(flows, 0x00, SIZEOF(flows));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacer(250, &pAppPacer));
+    for (i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, addAppPacerFlow(pAppPacer, appPacerUTestWriter, &flows[i], &pAppPacerFlows[i]));
+    }
+
+    MEMSET(&frame, 0x00, SIZEOF(Frame));
+    frame.trackId = DEFAULT_AUDIO_TRACK_ID;
+    frame.size = APP_PACER_UTEST_FRAME_SIZE;
+    frame.frameData = mFrameData;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacerFrame(pAppPacer, &frame, GETTIME(), &pAppPacerFrame));
+    TEST_ASSERT_TRUE(pAppPacerFrame->frame.frameData != mFrameData);
+    TEST_ASSERT_EQUAL_MEMORY(mFrameData, pAppPacerFrame->frame.frameData, APP_PACER_UTEST_FRAME_SIZE);
+    // the frame outlives the producer and the source buffer.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, queueAppPacerFrame(pAppPacer, pAppPacerFlows[0], pAppPacerFrame, 7));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, queueAppPacerFrame(pAppPacer, pAppPacerFlows[1], pAppPacerFrame, 9));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, releaseAppPacerFrame(&pAppPacerFrame));
+    mFrameData[0] = 0xFF;
+
+    for (i = 0; i < 2; i++) {
+        waitFramesSent(pAppPacer, pAppPacerFlows[i], 1);
+        TEST_ASSERT_EQUAL(APP_PACER_UTEST_FRAME_SIZE, flows[i].sizes[0]);
+        TEST_ASSERT_EQUAL(0, flows[i].firstBytes[0]);
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppPacerFlow(pAppPacer, &pAppPacerFlows[i]));
+    }
+    TEST_ASSERT_EQUAL(7, flows[0].indexes[0]);
+    TEST_ASSERT_EQUAL(9, flows[1].indexes[0]);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppPacer(&pAppPacer));
+}
+
+void test_key_frame_spacing(void)
+{
+    PAppPacer pAppPacer = NULL;
+    PAppPacerFlow pAppPacerFlows[2] = {NULL, NULL};
+    AppPacerUTestFlow flows[2];
+    PAppPacerFrame pAppPacerFrame = NULL;
+    Frame frame;
+    UINT32 i;
+
+    MEMSET(flows, 0x00, SIZEOF(flows));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacer(100, &pAppPacer));
+    for (i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, addAppPacerFlow(pAppPacer, appPacerUTestWriter, &flows[i], &pAppPacerFlows[i]));
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, setAppPacerFlowBitrate(pAppPacer, pAppPacerFlows[i], 80000));
+    }
+
+    // both flows have tokens, the shared bucket of 20000 bytes per second leaves a debt of about 90ms after the first copy.
+    MEMSET(&frame, 0x00, SIZEOF(Frame));
+    frame.trackId = DEFAULT_VIDEO_TRACK_ID;
+    frame.flags = FRAME_FLAG_KEY_FRAME;
+    frame.size = APP_PACER_UTEST_FRAME_SIZE;
+    frame.frameData = mFrameData;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppPacerFrame(pAppPacer, &frame, GETTIME(), &pAppPacerFrame));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, queueAppPacerFrame(pAppPacer, pAppPacerFlows[0], pAppPacerFrame, 1));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, queueAppPacerFrame(pAppPacer, pAppPacerFlows[1], pAppPacerFrame, 1));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, releaseAppPacerFrame(&pAppPacerFrame));
+
+    for (i = 0; i < 2; i++) {
+        waitFramesSent(pAppPacer, pAppPacerFlows[i], 1);
+    }
+    TEST_ASSERT_TRUE(flows[1].writeTimes[0] - flows[0].writeTimes[0] >= 50 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+
+    for (i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, removeAppPacerFlow(pAppPacer, &pAppPacerFlows[i]));
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppPacer(&pAppPacer));
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#define _GNU_SOURCE // memmem
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "unity.h"
+#include "AppRecorder.h"
+#include "mock_Include.h"
+
+#define APP_RECORDER_UTEST_DIR_TEMPLATE "/tmp/AppRecorderUTestXXXXXX"
+#define APP_RECORDER_UTEST_FILE_SIZE    (64 * 1024)
+
+// sps, pps and the slice of an idr picture, the pps with a 3-byte start code.
+static BYTE mKeyFrame[] = {0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xE0, 0x1F, 0xDA, 0x01, 0x40, 0x16, 0xE8, 0x00, 0x00, 0x01,
+                           0x68, 0xCE, 0x3C, 0x80, 0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x33, 0xFF};
+static BYTE mDeltaFrame[] = {0x00, 0x00, 0x00, 0x01, 0x41, 0x9A, 0x02, 0x04, 0x7F};
+static BYTE mAudioFrame[] = {0xFC, 0xFF, 0xFE, 0x01, 0x02, 0x03};
+static CHAR mDirectory[] = APP_RECORDER_UTEST_DIR_TEMPLATE;
+static BYTE mFile[APP_RECORDER_UTEST_FILE_SIZE];
+
+/* Called before each test method. */
+void setUp()
+{
+    STRCPY(mDirectory, APP_RECORDER_UTEST_DIR_TEMPLATE);
+    TEST_ASSERT_NOT_NULL(mkdtemp(mDirectory));
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    CHAR path[MAX_PATH_LEN + 1];
+    DIR* pDir;
+    struct dirent* pEntry;
+
+    if ((pDir = opendir(mDirectory)) != NULL) {
+        while ((pEntry = readdir(pDir)) != NULL) {
+            if (pEntry->d_name[0] != '.') {
+                SNPRINTF(path, SIZEOF(path), "%s/%s", mDirectory, pEntry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(pDir);
+    }
+    rmdir(mDirectory);
+}
+
+static VOID initConfig(PAppRecorderConfig pConfig, RTC_CODEC videoCodec)
+{
+    MEMSET(pConfig, 0x00, SIZEOF(AppRecorderConfig));
+    STRCPY(pConfig->directory, mDirectory);
+    pConfig->videoCodec = videoCodec;
+    pConfig->audioCodec = RTC_CODEC_OPUS;
+}
+
+static VOID appendFrame(PAppRecorder pAppRecorder, UINT64 trackId, BOOL keyFrame, UINT64 presentationTs, PBYTE pData, UINT32 size)
+{
+    Frame frame;
+
+    MEMSET(&frame, 0x00, SIZEOF(Frame));
+    frame.trackId = trackId;
+    frame.flags = keyFrame ? FRAME_FLAG_KEY_FRAME : FRAME_FLAG_NONE;
+    frame.presentationTs = presentationTs;
+    frame.decodingTs = presentationTs;
+    frame.size = size;
+    frame.frameData = pData;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, appendAppRecorderFrame(pAppRecorder, &frame));
+}
+
+/**
+ * @brief count the segments in the directory and read the last one into mFile.
+ *
+ * @return the segments, the partial ones are counted with MAX_UINT32.
+ */
+static UINT32 readSegments(PUINT32 pFileLen)
+{
+    CHAR path[MAX_PATH_LEN + 1];
+    DIR* pDir;
+    struct dirent* pEntry;
+    FILE* fp;
+    UINT32 count = 0;
+
+    *pFileLen = 0;
+    TEST_ASSERT_NOT_NULL(pDir = opendir(mDirectory));
+    while ((pEntry = readdir(pDir)) != NULL) {
+        if (pEntry->d_name[0] == '.') {
+            continue;
+        }
+        if (STRSTR(pEntry->d_name, ".part") != NULL) {
+            count = MAX_UINT32;
+            break;
+        }
+        count++;
+        SNPRINTF(path, SIZEOF(path), "%s/%s", mDirectory, pEntry->d_name);
+        TEST_ASSERT_NOT_NULL(fp = FOPEN(path, "rb"));
+        *pFileLen = (UINT32) fread(mFile, 1, SIZEOF(mFile), fp);
+        FCLOSE(fp);
+    }
+    closedir(pDir);
+    return count;
+}
+
+static UINT32 countBytes(UINT32 fileLen, PBYTE pBytes, UINT32 len)
+{
+    PBYTE pFound = mFile;
+    UINT32 count = 0;
+
+    while ((pFound = (PBYTE) memmem(pFound, fileLen - (pFound - mFile), pBytes, len)) != NULL) {
+        count++;
+        pFound++;
+    }
+    return count;
+}
+
+void test_createAppRecorder(void)
+{
+    AppRecorderConfig config;
+    PAppRecorder pAppRecorder = NULL;
+
+    initConfig(&config, RTC_CODEC_VP8);
+    TEST_ASSERT_EQUAL(STATUS_APP_RECORDER_NULL_ARG, createAppRecorder(NULL, &pAppRecorder));
+    TEST_ASSERT_EQUAL(STATUS_APP_RECORDER_NULL_ARG, createAppRecorder(&config, NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_RECORDER_NULL_ARG, freeAppRecorder(NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_RECORDER_NULL_ARG, appendAppRecorderFrame(NULL, NULL));
+
+    config.directory[0] = '\0';
+    TEST_ASSERT_EQUAL(STATUS_APP_RECORDER_INVALID_ARG, createAppRecorder(&config, &pAppRecorder));
+    TEST_ASSERT_NULL(pAppRecorder);
+    STRCPY(config.directory, "/nonexistent/AppRecorderUTest");
+    TEST_ASSERT_EQUAL(STATUS_APP_RECORDER_OPEN_FILE, createAppRecorder(&config, &pAppRecorder));
+    TEST_ASSERT_NULL(pAppRecorder);
+
+    initConfig(&config, RTC_CODEC_VP8);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppRecorder(&config, &pAppRecorder));
+    TEST_ASSERT_NOT_NULL(pAppRecorder);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppRecorder(&pAppRecorder));
+    TEST_ASSERT_NULL(pAppRecorder);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppRecorder(&pAppRecorder));
+}
+
+void test_appendAppRecorderFrame_h264(void)
+{
+    AppRecorderConfig config;
+    PAppRecorder pAppRecorder = NULL;
+    UINT32 fileLen;
+    BYTE ebml[] = {0x1A, 0x45, 0xDF, 0xA3};
+    BYTE cluster[] = {0x1F, 0x43, 0xB6, 0x75};
+    // AVCDecoderConfigurationRecord of the sps and the pps of the key frame.
+    BYTE avcC[] = {0x01, 0x42, 0xE0, 0x1F, 0xFF, 0xE1, 0x00, 0x09, 0x67, 0x42, 0xE0, 0x1F,
+                   0xDA, 0x01, 0x40, 0x16, 0xE8, 0x01, 0x00, 0x04, 0x68, 0xCE, 0x3C, 0x80};
+    // The delta frame in a simple block of track 1 at 40ms and the slice of the key frame, the start codes replaced by the
+    // lengths of the nal units.
+    BYTE deltaBlock[] = {0xA3, 0x8D, 0x81, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x05, 0x41, 0x9A, 0x02, 0x04, 0x7F};
+    BYTE keyBlock[] = {0x00, 0x00, 0x00, 0x06, 0x65, 0x88, 0x84, 0x00, 0x33, 0xFF};
+    // The simple block of track 2 at 20ms.
+    BYTE audioBlock[] = {0xA3, 0x8A, 0x82, 0x00, 0x14, 0x80, 0xFC, 0xFF, 0xFE, 0x01, 0x02, 0x03};
+
+    initConfig(&config, RTC_CODEC_H264_PROFILE_42E01F_LEVEL_ASYMMETRY_ALLOWED_PACKETIZATION_MODE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppRecorder(&config, &pAppRecorder));
+
+    // The frames before the first key frame are dropped.
+    appendFrame(pAppRecorder, DEFAULT_AUDIO_TRACK_ID, FALSE, 0, mAudioFrame, SIZEOF(mAudioFrame));
+    appendFrame(pAppRecorder, DEFAULT_VIDEO_TRACK_ID, FALSE, 0, mDeltaFrame, SIZEOF(mDeltaFrame));
+    appendFrame(pAppRecorder, DEFAULT_VIDEO_TRACK_ID, TRUE, 10 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND, mKeyFrame, SIZEOF(mKeyFrame));
+    appendFrame(pAppRecorder, DEFAULT_AUDIO_TRACK_ID, FALSE, 30 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND, mAudioFrame, SIZEOF(mAudioFrame));
+    appendFrame(pAppRecorder, DEFAULT_VIDEO_TRACK_ID, FALSE, 50 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND, mDeltaFrame, SIZEOF(mDeltaFrame));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppRecorder(&pAppRecorder));
+
+    TEST_ASSERT_EQUAL(1, readSegments(&fileLen));
+    TEST_ASSERT_EQUAL(0, MEMCMP(mFile, ebml, SIZEOF(ebml)));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, (PBYTE) "V_MPEG4/ISO/AVC", STRLEN("V_MPEG4/ISO/AVC")));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, (PBYTE) "A_OPUS", STRLEN("A_OPUS")));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, avcC, SIZEOF(avcC)));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, cluster, SIZEOF(cluster)));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, keyBlock, SIZEOF(keyBlock)));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, audioBlock, SIZEOF(audioBlock)));
+    // The delta frame before the key frame is not in the segment.
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, deltaBlock, SIZEOF(deltaBlock)));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, deltaBlock + 6, SIZEOF(deltaBlock) - 6));
+}
+
+void test_appendAppRecorderFrame_rotation(void)
+{
+    AppRecorderConfig config;
+    PAppRecorder pAppRecorder = NULL;
+    UINT32 fileLen, i;
+    BYTE vp8[] = {0x10, 0x02, 0x00, 0x9D, 0x01, 0x2A};
+
+    // Each key frame is over the size of the segment, so it starts a new one.
+    initConfig(&config, RTC_CODEC_VP8);
+    config.segmentSize = 1;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppRecorder(&config, &pAppRecorder));
+    for (i = 0; i < 3; i++) {
+        appendFrame(pAppRecorder, DEFAULT_VIDEO_TRACK_ID, TRUE, i * HUNDREDS_OF_NANOS_IN_A_SECOND, vp8, SIZEOF(vp8));
+        appendFrame(pAppRecorder, DEFAULT_VIDEO_TRACK_ID, FALSE, i * HUNDREDS_OF_NANOS_IN_A_SECOND + 1, vp8, SIZEOF(vp8));
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppRecorder(&pAppRecorder));
+    TEST_ASSERT_EQUAL(3, readSegments(&fileLen));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, (PBYTE) "V_VP8", STRLEN("V_VP8")));
+}
+
+void test_appendAppRecorderFrame_preallocate(void)
+{
+    AppRecorderConfig config;
+    PAppRecorder pAppRecorder = NULL;
+    UINT32 fileLen;
+    BYTE vp8[] = {0x10, 0x02, 0x00, 0x9D, 0x01, 0x2A};
+
+    // The preallocation is released when the segment is closed, and a file system without O_DIRECT falls back to the page cache.
+    initConfig(&config, RTC_CODEC_VP8);
+    config.audioCodec = RTC_CODEC_MULAW;
+    config.segmentSize = 1024 * 1024;
+    config.directIo = TRUE;
+    config.preallocate = TRUE;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppRecorder(&config, &pAppRecorder));
+    appendFrame(pAppRecorder, DEFAULT_VIDEO_TRACK_ID, TRUE, 0, vp8, SIZEOF(vp8));
+    appendFrame(pAppRecorder, DEFAULT_AUDIO_TRACK_ID, FALSE, 0, mAudioFrame, SIZEOF(mAudioFrame));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppRecorder(&pAppRecorder));
+
+    TEST_ASSERT_EQUAL(1, readSegments(&fileLen));
+    TEST_ASSERT_TRUE(fileLen > 0 && fileLen < SIZEOF(mFile));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, (PBYTE) "A_MS/ACM", STRLEN("A_MS/ACM")));
+}
+
+void test_appendAppRecorderFrame_audio_only(void)
+{
+    AppRecorderConfig config;
+    PAppRecorder pAppRecorder = NULL;
+    UINT32 fileLen, i;
+    BYTE vp8[] = {0x10, 0x02, 0x00, 0x9D, 0x01, 0x2A};
+
+    initConfig(&config, RTC_CODEC_VP8);
+    config.audioOnly = TRUE;
+    config.videoOnly = TRUE;
+    TEST_ASSERT_EQUAL(STATUS_APP_RECORDER_INVALID_ARG, createAppRecorder(&config, &pAppRecorder));
+    TEST_ASSERT_NULL(pAppRecorder);
+
+    // Without the video track each audio frame over the size of the segment starts a new one, and the video frames are dropped.
+    config.videoOnly = FALSE;
+    config.segmentSize = 1;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppRecorder(&config, &pAppRecorder));
+    for (i = 0; i < 3; i++) {
+        appendFrame(pAppRecorder, DEFAULT_VIDEO_TRACK_ID, TRUE, i * HUNDREDS_OF_NANOS_IN_A_SECOND, vp8, SIZEOF(vp8));
+        appendFrame(pAppRecorder, DEFAULT_AUDIO_TRACK_ID, FALSE, i * HUNDREDS_OF_NANOS_IN_A_SECOND, mAudioFrame, SIZEOF(mAudioFrame));
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppRecorder(&pAppRecorder));
+    TEST_ASSERT_EQUAL(3, readSegments(&fileLen));
+    TEST_ASSERT_EQUAL(1, countBytes(fileLen, (PBYTE) "A_OPUS", STRLEN("A_OPUS")));
+    TEST_ASSERT_EQUAL(0, countBytes(fileLen, (PBYTE) "V_VP8", STRLEN("V_VP8")));
+    TEST_ASSERT_EQUAL(0, countBytes(fileLen, vp8, SIZEOF(vp8)));
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include "unity.h"
+#include "AppReplay.h"
+#include "mock_Include.h"
+
+#define APP_REPLAY_UTEST_CAPACITY   1024
+#define APP_REPLAY_UTEST_FRAME_SIZE 100
+
+static BYTE mFrameData[APP_REPLAY_UTEST_CAPACITY];
+static RtcDataChannel mRtcDataChannel;
+static UINT32 mChunks;
+static UINT32 mEndChunks;
+static UINT32 mChunkBytes;
+static BOOL mRefuseSend;
+
+/* Called before each test method. */
+void setUp()
+{
+    UINT32 i;
+
+    for (i = 0; i < SIZEOF(mFrameData); i++) {
+        mFrameData[i] = (BYTE) i;
+    }
+    mChunks = 0;
+    mEndChunks = 0;
+    mChunkBytes = 0;
+    mRefuseSend = FALSE;
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+}
+
+static VOID appendFrame(PAppReplay pAppReplay, UINT32 index, UINT64 trackId, BOOL keyFrame)
+{
+    Frame frame;
+
+    MEMSET(&frame, 0x00, SIZEOF(Frame));
+    frame.trackId = trackId;
+    frame.flags = keyFrame ? FRAME_FLAG_KEY_FRAME : FRAME_FLAG_NONE;
+    frame.presentationTs = index;
+    frame.decodingTs = index;
+    frame.size = APP_REPLAY_UTEST_FRAME_SIZE;
+    frame.frameData = mFrameData + index;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, appendAppReplayFrame(pAppReplay, &frame));
+}
+
+/**
+ * @brief read the whole replay, the frame of index i holds the bytes of mFrameData from i.
+ *
+ * @return the index of the first frame.
+ */
+static UINT32 readFrames(PAppReplay pAppReplay, PAppReplayCursor pCursor, PUINT32 pFrameCount)
+{
+    BYTE buffer[APP_REPLAY_UTEST_FRAME_SIZE];
+    UINT32 size, first = MAX_UINT32;
+
+    *pFrameCount = 0;
+    while (TRUE) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, readAppReplay(pAppReplay, pCursor, buffer, SIZEOF(buffer), &size));
+        if (!pCursor->active) {
+            break;
+        }
+        TEST_ASSERT_EQUAL(APP_REPLAY_UTEST_FRAME_SIZE, size);
+        TEST_ASSERT_EQUAL(0, MEMCMP(buffer, mFrameData + pCursor->frame.presentationTs, size));
+        if (first == MAX_UINT32) {
+            first = (UINT32) pCursor->frame.presentationTs;
+            TEST_ASSERT_EQUAL(FRAME_FLAG_KEY_FRAME, pCursor->frame.flags);
+        }
+        (*pFrameCount)++;
+    }
+    return first;
+}
+
+static STATUS dataChannelSendCallback(PRtcDataChannel pRtcDataChannel, BOOL isBinary, PBYTE pMessage, UINT32 pMessageLen, int NumCalls)
+{
+    UINT32 frameSize = ((UINT32) pMessage[0] << 24) | ((UINT32) pMessage[1] << 16) | ((UINT32) pMessage[2] << 8) | pMessage[3];
+
+    TEST_ASSERT_EQUAL_PTR(&mRtcDataChannel, pRtcDataChannel);
+    TEST_ASSERT_TRUE(isBinary);
+    TEST_ASSERT_TRUE(pMessageLen >= APP_REPLAY_CHUNK_HEADER_LEN);
+    if (mRefuseSend) {
+        return STATUS_INTERNAL_ERROR;
+    }
+    if (frameSize == 0) {
+        TEST_ASSERT_EQUAL(APP_REPLAY_CHUNK_HEADER_LEN, pMessageLen);
+        mEndChunks++;
+    } else {
+        TEST_ASSERT_EQUAL(DEFAULT_VIDEO_TRACK_ID, pMessage[15]);
+        TEST_ASSERT_EQUAL(0, MEMCMP(pMessage + APP_REPLAY_CHUNK_HEADER_LEN, mFrameData + pMessage[23] + pMessage[7],
+                                    pMessageLen - APP_REPLAY_CHUNK_HEADER_LEN));
+        mChunkBytes += pMessageLen - APP_REPLAY_CHUNK_HEADER_LEN;
+    }
+    mChunks++;
+    return STATUS_SUCCESS;
+}
+
+void test_createAppReplay(void)
+{
+    PAppReplay pAppReplay = NULL;
+
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_NULL_ARG, createAppReplay(APP_REPLAY_UTEST_CAPACITY, HUNDREDS_OF_NANOS_IN_A_SECOND, NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_INVALID_ARG, createAppReplay(0, HUNDREDS_OF_NANOS_IN_A_SECOND, &pAppReplay));
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_INVALID_ARG, createAppReplay(APP_REPLAY_UTEST_CAPACITY, 0, &pAppReplay));
+    TEST_ASSERT_NULL(pAppReplay);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppReplay(APP_REPLAY_UTEST_CAPACITY + 1, HUNDREDS_OF_NANOS_IN_A_SECOND, &pAppReplay));
+    TEST_ASSERT_EQUAL(APP_REPLAY_UTEST_CAPACITY + 8, pAppReplay->capacity);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppReplay(&pAppReplay));
+    TEST_ASSERT_NULL(pAppReplay);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppReplay(&pAppReplay));
+}
+
+void test_appendAppReplayFrame(void)
+{
+    PAppReplay pAppReplay = NULL;
+    AppReplayCursor cursor;
+    Frame frame;
+    UINT32 i, frameCount;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppReplay(APP_REPLAY_UTEST_CAPACITY, HUNDREDS_OF_NANOS_IN_A_SECOND, &pAppReplay));
+    MEMSET(&frame, 0x00, SIZEOF(Frame));
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_NULL_ARG, appendAppReplayFrame(NULL, &frame));
+    frame.size = APP_REPLAY_UTEST_CAPACITY;
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_NULL_ARG, appendAppReplayFrame(pAppReplay, &frame));
+    frame.frameData = mFrameData;
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_FRAME_TOO_LARGE, appendAppReplayFrame(pAppReplay, &frame));
+
+    // no key frame yet, the replay is empty.
+    appendFrame(pAppReplay, 0, DEFAULT_VIDEO_TRACK_ID, FALSE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, seekAppReplay(pAppReplay, &cursor));
+    readFrames(pAppReplay, &cursor, &frameCount);
+    TEST_ASSERT_EQUAL(0, frameCount);
+
+    // 7 records of 136 bytes fit the ring, the 8th one skips its tail and wraps around, the 9th overwrites the first key frame.
+    for (i = 1; i < 9; i++) {
+        appendFrame(pAppReplay, i, DEFAULT_VIDEO_TRACK_ID, i % 3 == 1);
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, seekAppReplay(pAppReplay, &cursor));
+    TEST_ASSERT_EQUAL(4, readFrames(pAppReplay, &cursor, &frameCount));
+    TEST_ASSERT_EQUAL(5, frameCount);
+
+    // the audio frames are replayed, they are not key frames of the index.
+    appendFrame(pAppReplay, 9, DEFAULT_AUDIO_TRACK_ID, TRUE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, seekAppReplay(pAppReplay, &cursor));
+    TEST_ASSERT_EQUAL(4, readFrames(pAppReplay, &cursor, &frameCount));
+    TEST_ASSERT_EQUAL(6, frameCount);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppReplay(&pAppReplay));
+}
+
+void test_seekAppReplay_duration(void)
+{
+    PAppReplay pAppReplay = NULL;
+    AppReplayCursor cursor;
+    UINT32 frameCount;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppReplay(APP_REPLAY_UTEST_CAPACITY, 100 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND, &pAppReplay));
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_NULL_ARG, seekAppReplay(NULL, &cursor));
+    appendFrame(pAppReplay, 0, DEFAULT_VIDEO_TRACK_ID, TRUE);
+    THREAD_SLEEP(200 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    appendFrame(pAppReplay, 1, DEFAULT_VIDEO_TRACK_ID, TRUE);
+    appendFrame(pAppReplay, 2, DEFAULT_VIDEO_TRACK_ID, FALSE);
+
+    // the first key frame is older than the duration.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, seekAppReplay(pAppReplay, &cursor));
+    TEST_ASSERT_EQUAL(1, readFrames(pAppReplay, &cursor, &frameCount));
+    TEST_ASSERT_EQUAL(2, frameCount);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppReplay(&pAppReplay));
+}
+
+void test_readAppReplay_overrun(void)
+{
+    PAppReplay pAppReplay = NULL;
+    AppReplayCursor cursor;
+    BYTE buffer[APP_REPLAY_UTEST_FRAME_SIZE];
+    UINT32 i, size;
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppReplay(APP_REPLAY_UTEST_CAPACITY, HUNDREDS_OF_NANOS_IN_A_SECOND, &pAppReplay));
+    appendFrame(pAppReplay, 0, DEFAULT_VIDEO_TRACK_ID, TRUE);
+    appendFrame(pAppReplay, 1, DEFAULT_VIDEO_TRACK_ID, FALSE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, seekAppReplay(pAppReplay, &cursor));
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_NULL_ARG, readAppReplay(pAppReplay, &cursor, NULL, SIZEOF(buffer), &size));
+
+    // the reader copies the half of the key frame, and the writer laps it.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, readAppReplay(pAppReplay, &cursor, buffer, APP_REPLAY_UTEST_FRAME_SIZE / 2, &size));
+    TEST_ASSERT_EQUAL(APP_REPLAY_UTEST_FRAME_SIZE / 2, size);
+    TEST_ASSERT_EQUAL(0, MEMCMP(buffer, mFrameData, size));
+    for (i = 2; i < 10; i++) {
+        appendFrame(pAppReplay, i, DEFAULT_VIDEO_TRACK_ID, FALSE);
+    }
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_OVERRUN, readAppReplay(pAppReplay, &cursor, buffer, SIZEOF(buffer), &size));
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppReplay(&pAppReplay));
+}
+
+void test_serveAppReplay(void)
+{
+    PAppReplay pAppReplay = NULL;
+    AppReplayCursor cursor;
+    UINT32 i;
+
+    dataChannelSend_StubWithCallback(dataChannelSendCallback);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, createAppReplay(APP_REPLAY_UTEST_CAPACITY, HUNDREDS_OF_NANOS_IN_A_SECOND, &pAppReplay));
+    for (i = 0; i < 3; i++) {
+        appendFrame(pAppReplay, i, DEFAULT_VIDEO_TRACK_ID, i == 0);
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, seekAppReplay(pAppReplay, &cursor));
+    TEST_ASSERT_EQUAL(STATUS_APP_REPLAY_NULL_ARG, serveAppReplay(pAppReplay, &cursor, NULL, MAX_UINT32));
+
+    // the refused chunk is kept for the next call.
+    mRefuseSend = TRUE;
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, serveAppReplay(pAppReplay, &cursor, &mRtcDataChannel, MAX_UINT32));
+    TEST_ASSERT_TRUE(cursor.active);
+    TEST_ASSERT_EQUAL(0, cursor.offset);
+    mRefuseSend = FALSE;
+
+    // the budget stops the replay after the first frame.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, serveAppReplay(pAppReplay, &cursor, &mRtcDataChannel, APP_REPLAY_UTEST_FRAME_SIZE));
+    TEST_ASSERT_EQUAL(1, mChunks);
+    TEST_ASSERT_TRUE(cursor.active);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, serveAppReplay(pAppReplay, &cursor, &mRtcDataChannel, MAX_UINT32));
+    TEST_ASSERT_EQUAL(4, mChunks);
+    TEST_ASSERT_EQUAL(1, mEndChunks);
+    TEST_ASSERT_EQUAL(3 * APP_REPLAY_UTEST_FRAME_SIZE, mChunkBytes);
+    TEST_ASSERT_FALSE(cursor.active);
+
+    // nothing is sent after the end.
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, serveAppReplay(pAppReplay, &cursor, &mRtcDataChannel, MAX_UINT32));
+    TEST_ASSERT_EQUAL(4, mChunks);
+
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, freeAppReplay(&pAppReplay));
+}
@@ -39,6 +39,7 @@
 #define GST_SIGNAL_CALLBACK_PAD_ADDED    "pad-added"
 #define GST_SIGNAL_CALLBACK_PAD_REMOVED  "pad-removed"
 #define GST_SIGNAL_CALLBACK_NO_MORE_PADS "no-more-pads"
+#define GST_SIGNAL_CALLBACK_SELECT_STREAM "select-stream"
 #define GST_SIGNAL_CALLBACK_MSG_ERROR    "message::error"
 #define GST_SIGNAL_CALLBACK_MSG_EOS      "message::eos"
 
@@ -62,9 +63,15 @@
 #define GST_STRUCT_FIELD_CLOCK_RATE_VIDEO   90000
 #define GST_STRUCT_FIELD_CLOCK_RATE_PCMU    8000
 
+#define APP_RTSPSRC_UTEST_MAX_FRAMES     16
+#define APP_RTSPSRC_UTEST_RTP_INTERVAL   3000                  // 30 fps in the 90khz clock of the video.
+#define APP_RTSPSRC_UTEST_FRAME_NANOS    (1000000000ULL / 30)  // the decoding interval in ns.
+#define APP_RTSPSRC_UTEST_DURATION_NANOS (20 * 1000000ULL)     // the buffer duration of the last frame in ns.
+
 typedef void (*RtspSrcNoMorePads)(GstElement* element, gpointer udata);
 typedef void (*RtspSrcPadAdded)(GstElement* element, GstPad* pad, gpointer udata);
 typedef void (*RtspSrcPadRemoved)(GstElement* element, GstPad* pad, gpointer udata);
+typedef gboolean (*RtspSrcSelectStream)(GstElement* element, guint num, GstCaps* caps, gpointer udata);
 typedef GstFlowReturn (*NewSampleFromAppSink)(GstElement* sink, gpointer udata);
 typedef void (*MsgErrorFromBus)(GstBus* bus, GstMessage* msg, gpointer* udata);
 typedef void (*MsgEosFromBus)(GstBus* bus, GstMessage* msg, gpointer* udata);
@@ -95,6 +102,7 @@ typedef struct {
     RtspSrcNoMorePads noMorePads;
     RtspSrcPadAdded padAdded;
     RtspSrcPadRemoved padRemoved;
+    RtspSrcSelectStream selectStream;
     NewSampleFromAppSink newSampleFromAppSink;
     MsgErrorFromBus msgErrorFromBus;
     MsgEosFromBus msgEosFromBus;
@@ -105,6 +113,10 @@ typedef struct {
     CHAR msgErrorMessage[16];
     GError msgError;
     GstMapInfo mapInfo;
+    UINT32 runCount;
+    volatile BOOL mainLoopQuit;
+    Frame mediaSinkFrames[APP_RTSPSRC_UTEST_MAX_FRAMES];
+    UINT32 mediaSinkFrameCount;
 } GstMock, *PGstMock;
 
 static GstElement mDummyElement;
@@ -142,6 +154,8 @@ void setUp()
     pGstMockElementList->pDummyGType = &mDummyGType;
     memset(pGstMock->msgErrorMessage, 0, 16);
     memcpy(pGstMock->msgErrorMessage, APP_RTSPSRC_UTEST_BUS_MSG_ERROR, strlen(APP_RTSPSRC_UTEST_BUS_MSG_ERROR));
+    // the bus errors end the runs, test_reconnect covers the rebuilds.
+    setenv(APP_MEDIA_RTSP_RECONNECT_RETRIES, "0", 1);
 }
 
 /* Called after each test method. */
@@ -166,6 +180,8 @@ static gulong app_g_signal_connect_callback(gpointer instance, const gchar* deta
         pGstMock->padRemoved = c_handler;
     } else if (strcmp(GST_SIGNAL_CALLBACK_NO_MORE_PADS, detailed_signal) == 0) {
         pGstMock->noMorePads = c_handler;
+    } else if (strcmp(GST_SIGNAL_CALLBACK_SELECT_STREAM, detailed_signal) == 0) {
+        pGstMock->selectStream = (RtspSrcSelectStream) c_handler;
     } else if (strcmp(GST_SIGNAL_CALLBACK_MSG_ERROR, detailed_signal) == 0) {
         pGstMock->msgErrorFromBus = c_handler;
     } else if (strcmp(GST_SIGNAL_CALLBACK_MSG_EOS, detailed_signal) == 0) {
@@ -296,13 +312,24 @@ static GstStateChangeReturn app_gst_element_set_state_callback(GstElement* eleme
     return GST_STATE_CHANGE_SUCCESS;
 }
 
-static STATUS mediaSinkHook_callback(PVOID udata, PFrame pFrame)
+static STATUS mediaSinkHook_callback(PVOID udata, PFrame pFrame, PMediaFrameTiming pTiming)
 {
+    TEST_ASSERT_NOT_NULL(pTiming);
+    TEST_ASSERT_TRUE(pTiming->mappedTime >= pTiming->sinkEntryTime);
     PFrame pUserFrame = (PFrame) udata;
     memcpy(pUserFrame, pFrame, sizeof(Frame));
     return STATUS_SUCCESS;
 }
 
+static STATUS mediaSinkHook_record_callback(PVOID udata, PFrame pFrame, PMediaFrameTiming pTiming)
+{
+    PGstMock pGstMock = (PGstMock) udata;
+    if (pGstMock->mediaSinkFrameCount < APP_RTSPSRC_UTEST_MAX_FRAMES) {
+        memcpy(&pGstMock->mediaSinkFrames[pGstMock->mediaSinkFrameCount++], pFrame, sizeof(Frame));
+    }
+    return STATUS_SUCCESS;
+}
+
 static STATUS mediaEosHook_callback(PVOID udata)
 {
     *(PBOOL*) udata = TRUE;
@@ -819,6 +846,182 @@ static void app_g_main_loop_run_normal_video_only_msg_eos_callback(PVOID loop)
     TEST_ASSERT_EQUAL(TRUE, pGstMock->mediaEosVal);
 }
 
+static guint64 app_gst_segment_to_running_time_callback(const GstSegment* segment, GstFormat format, guint64 position, int NumCalls)
+{
+    return position;
+}
+
+static void app_g_main_loop_run_reconnect_callback(PVOID loop)
+{
+    PGstMock pGstMock = getGstMock();
+    GstBus bus;
+    GstMessage msg;
+    GstElement element;
+    GstPad pad;
+    GstElement sink;
+    GstElement sample;
+    GstBuffer buffer;
+    GstBuffer* pbuffer = &buffer;
+    GstSegment segment;
+    GType dummyGType;
+    GstFlowReturn gstFlowReturn;
+    UINT32 i, frameCount;
+
+    pGstMock->padAdded(&element, &pad, pGstMock->uData);
+    TEST_ASSERT_NOT_NULL(pGstMock->newSampleFromAppSink);
+    memset(pbuffer, 0, sizeof(GstBuffer));
+    app_gst_app_sink_get_type_IgnoreAndReturn(dummyGType);
+    app_gst_app_sink_pull_sample_IgnoreAndReturn(&sample);
+    app_gst_sample_get_buffer_IgnoreAndReturn(pbuffer);
+    app_gst_sample_get_segment_IgnoreAndReturn(&segment);
+    app_gst_segment_to_running_time_StubWithCallback(app_gst_segment_to_running_time_callback);
+    app_gst_buffer_map_StubWithCallback(app_gst_buffer_map_callback);
+    app_gst_buffer_unmap_Ignore();
+    app_gst_sample_unref_Ignore();
+    pGstMock->mapInfo.size = 1024;
+    pGstMock->mapInfo.data = malloc(pGstMock->mapInfo.size);
+
+    if (pGstMock->runCount++ == 0) {
+        // the running times of the first pipeline start at 0.
+        for (i = 0; i < 3; i++) {
+            GST_BUFFER_PTS(pbuffer) = GST_BUFFER_DTS(pbuffer) = i * APP_RTSPSRC_UTEST_FRAME_NANOS;
+            GST_BUFFER_DURATION(pbuffer) = GST_CLOCK_TIME_NONE;
+            gstFlowReturn = pGstMock->newSampleFromAppSink(&sink, pGstMock->uData);
+            TEST_ASSERT_EQUAL(GST_FLOW_OK, gstFlowReturn);
+            GST_BUFFER_FLAG_SET(pbuffer, GST_BUFFER_FLAG_DELTA_UNIT);
+        }
+        free(pGstMock->mapInfo.data);
+        TEST_ASSERT_EQUAL(3, pGstMock->mediaSinkFrameCount);
+
+        // the camera is lost, the sessions are kept and the pipeline is rebuilt.
+        app_g_error_free_Ignore();
+        app_gst_object_get_name_IgnoreAndReturn("error src");
+        app_gst_message_parse_error_StubWithCallback(app_gst_message_parse_error_callback);
+        pGstMock->msgErrorFromBus(&bus, &msg, pGstMock->uData);
+        TEST_ASSERT_EQUAL(FALSE, pGstMock->mediaEosVal);
+        return;
+    }
+
+    // the rebuilt pipeline resumes on a key frame, and its running times start at 0 again.
+    frameCount = pGstMock->mediaSinkFrameCount;
+    GST_BUFFER_PTS(pbuffer) = GST_BUFFER_DTS(pbuffer) = 0;
+    GST_BUFFER_DURATION(pbuffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_FLAG_SET(pbuffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    gstFlowReturn = pGstMock->newSampleFromAppSink(&sink, pGstMock->uData);
+    TEST_ASSERT_EQUAL(GST_FLOW_OK, gstFlowReturn);
+    TEST_ASSERT_EQUAL(frameCount, pGstMock->mediaSinkFrameCount);
+
+    for (i = 1; i < 4; i++) {
+        GST_BUFFER_PTS(pbuffer) = GST_BUFFER_DTS(pbuffer) = i * APP_RTSPSRC_UTEST_FRAME_NANOS;
+        if (i == 1) {
+            GST_BUFFER_FLAG_UNSET(pbuffer, GST_BUFFER_FLAG_DELTA_UNIT);
+        } else {
+            GST_BUFFER_FLAG_SET(pbuffer, GST_BUFFER_FLAG_DELTA_UNIT);
+        }
+        gstFlowReturn = pGstMock->newSampleFromAppSink(&sink, pGstMock->uData);
+        TEST_ASSERT_EQUAL(GST_FLOW_OK, gstFlowReturn);
+        TEST_ASSERT_EQUAL(frameCount + i, pGstMock->mediaSinkFrameCount);
+    }
+    TEST_ASSERT_EQUAL(FRAME_FLAG_KEY_FRAME, pGstMock->mediaSinkFrames[frameCount].flags);
+    TEST_ASSERT_EQUAL(pGstMock->mapInfo.size, pGstMock->mediaSinkFrames[frameCount].size);
+    free(pGstMock->mapInfo.data);
+
+    shutdownMediaSource(pGstMock->uData);
+}
+
+static void app_g_main_loop_quit_callback(PVOID loop, int NumCalls)
+{
+    getGstMock()->mainLoopQuit = TRUE;
+}
+
+static void app_g_main_loop_run_stalled_callback(PVOID loop)
+{
+    PGstMock pGstMock = getGstMock();
+    GstElement element;
+    GstPad pad;
+    GstElement sink;
+    GstElement sample;
+    GstBuffer buffer;
+    GstBuffer* pbuffer = &buffer;
+    GstSegment segment;
+    GType dummyGType;
+    GstFlowReturn gstFlowReturn;
+    UINT32 i;
+
+    pGstMock->padAdded(&element, &pad, pGstMock->uData);
+    TEST_ASSERT_NOT_NULL(pGstMock->newSampleFromAppSink);
+    memset(pbuffer, 0, sizeof(GstBuffer));
+    GST_BUFFER_PTS(pbuffer) = GST_CLOCK_TIME_NONE + 1;
+    app_gst_app_sink_get_type_IgnoreAndReturn(dummyGType);
+    app_gst_app_sink_pull_sample_IgnoreAndReturn(&sample);
+    app_gst_sample_get_buffer_IgnoreAndReturn(pbuffer);
+    app_gst_sample_get_segment_IgnoreAndReturn(&segment);
+    app_gst_segment_to_running_time_IgnoreAndReturn(GST_CLOCK_TIME_NONE + 1);
+    app_gst_buffer_map_StubWithCallback(app_gst_buffer_map_callback);
+    app_gst_buffer_unmap_Ignore();
+    app_gst_sample_unref_Ignore();
+    pGstMock->mapInfo.size = 1024;
+    pGstMock->mapInfo.data = malloc(pGstMock->mapInfo.size);
+    gstFlowReturn = pGstMock->newSampleFromAppSink(&sink, pGstMock->uData);
+    TEST_ASSERT_EQUAL(GST_FLOW_OK, gstFlowReturn);
+    free(pGstMock->mapInfo.data);
+
+    // the camera stops sending without an error or an eos, the watchdog quits the main loop.
+    for (i = 0; i < 50 && !pGstMock->mainLoopQuit; i++) {
+        THREAD_SLEEP(100 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    }
+    TEST_ASSERT_EQUAL(TRUE, pGstMock->mainLoopQuit);
+}
+
+// the rtp timestamps of a gop with b-frames in decoding order, in frame intervals.
+static UINT32 gRtpFrameOrder[] = {0, 3, 1, 2, 6, 4, 5, 9, 7, 8};
+
+static void app_g_main_loop_run_timestamps_callback(PVOID loop)
+{
+    PGstMock pGstMock = getGstMock();
+    GstElement element;
+    GstPad pad;
+    GstElement sink;
+    GstElement sample;
+    GstBuffer buffer;
+    GstBuffer* pbuffer = &buffer;
+    GstSegment segment;
+    GType dummyGType;
+    GstFlowReturn gstFlowReturn;
+    UINT64 rtpTimestamp;
+    UINT32 i;
+
+    pGstMock->padAdded(&element, &pad, pGstMock->uData);
+    TEST_ASSERT_NOT_NULL(pGstMock->newSampleFromAppSink);
+    app_gst_app_sink_get_type_IgnoreAndReturn(dummyGType);
+    app_gst_app_sink_pull_sample_IgnoreAndReturn(&sample);
+    app_gst_sample_get_buffer_IgnoreAndReturn(pbuffer);
+    app_gst_sample_get_segment_IgnoreAndReturn(&segment);
+    app_gst_segment_to_running_time_StubWithCallback(app_gst_segment_to_running_time_callback);
+    app_gst_buffer_map_StubWithCallback(app_gst_buffer_map_callback);
+    app_gst_buffer_unmap_Ignore();
+    app_gst_sample_unref_Ignore();
+    pGstMock->mapInfo.size = 1024;
+    pGstMock->mapInfo.data = malloc(pGstMock->mapInfo.size);
+
+    // the jitter buffer turns the rtp timestamps into the pts, the depayloader sets the dts and no duration of the video.
+    for (i = 0; i < ARRAY_SIZE(gRtpFrameOrder); i++) {
+        memset(pbuffer, 0, sizeof(GstBuffer));
+        rtpTimestamp = (UINT64) gRtpFrameOrder[i] * APP_RTSPSRC_UTEST_RTP_INTERVAL;
+        GST_BUFFER_PTS(pbuffer) = rtpTimestamp * 1000000000ULL / GST_STRUCT_FIELD_CLOCK_RATE_VIDEO + APP_RTSPSRC_UTEST_FRAME_NANOS;
+        GST_BUFFER_DTS(pbuffer) = i * APP_RTSPSRC_UTEST_FRAME_NANOS;
+        GST_BUFFER_DURATION(pbuffer) = i == ARRAY_SIZE(gRtpFrameOrder) - 1 ? APP_RTSPSRC_UTEST_DURATION_NANOS : GST_CLOCK_TIME_NONE;
+        if (i != 0) {
+            GST_BUFFER_FLAG_SET(pbuffer, GST_BUFFER_FLAG_DELTA_UNIT);
+        }
+        gstFlowReturn = pGstMock->newSampleFromAppSink(&sink, pGstMock->uData);
+        TEST_ASSERT_EQUAL(GST_FLOW_OK, gstFlowReturn);
+    }
+    free(pGstMock->mapInfo.data);
+
+    shutdownMediaSource(pGstMock->uData);
+}
+
 static void app_g_main_loop_run_normal_audio_only_pad_added_callback(PVOID loop)
 {
     STATUS retStatus = STATUS_SUCCESS;
@@ -2795,3 +2998,354 @@ void test_audio_only_device_na(void)
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
     TEST_ASSERT_EQUAL(NULL, pMediaContext);
 }
+
+void test_reconnect(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PMediaContext pMediaContext;
+    PGstMock pGstMock = getGstMock();
+    PGstMockElementList pElementList = &pGstMock->elementList;
+    MediaReconnectStats reconnectStats;
+    UINT32 i;
+
+    setenv(APP_MEDIA_RTSP_URL, APP_RTSPSRC_UTEST_RTSP_URL, 1);
+    setenv(APP_MEDIA_RTSP_USERNAME, APP_RTSPSRC_UTEST_RTSP_USERNAME, 1);
+    setenv(APP_MEDIA_RTSP_PASSWORD, APP_RTSPSRC_UTEST_RTSP_PASSWORD, 1);
+    setenv(APP_MEDIA_RTSP_RECONNECT_RETRIES, "3", 1);
+    // step.1: initilaize this media source as video-only device.
+    app_gst_init_Ignore();
+    app_gst_pipeline_new_IgnoreAndReturn(pElementList->pPipeline);
+    app_gst_element_factory_make_StubWithCallback(app_gst_element_factory_make_video_only_callback);
+    app_g_type_check_instance_cast_IgnoreAndReturn(pElementList->pDummyInstance);
+    app_g_object_set_Ignore();
+    app_g_signal_connect_StubWithCallback(app_g_signal_connect_callback);
+    app_gst_bin_get_type_IgnoreAndReturn(pElementList->pDummyGType);
+    app_gst_bin_add_many_Ignore();
+    app_gst_element_get_bus_IgnoreAndReturn(pElementList->pBus);
+    app_gst_bus_add_signal_watch_Ignore();
+    app_gst_element_set_state_IgnoreAndReturn(GST_STATE_CHANGE_SUCCESS);
+    app_g_main_loop_new_IgnoreAndReturn(pGstMock);
+    app_g_main_loop_run_StubWithCallback(app_g_main_loop_run_discovery_callback);
+
+    GstCaps template_caps;
+    GstCaps current_caps;
+    GstStructure srcPadStructure;
+    app_gst_pad_get_name_IgnoreAndReturn("srcPadName");
+    app_gst_pad_get_pad_template_caps_IgnoreAndReturn(&template_caps);
+    app_gst_pad_get_current_caps_IgnoreAndReturn(&current_caps);
+    app_gst_caps_get_size_IgnoreAndReturn(1);
+    app_gst_caps_get_structure_IgnoreAndReturn(&srcPadStructure);
+    app_gst_structure_has_field_StubWithCallback(app_gst_structure_has_field_full_callback);
+    app_gst_structure_get_string_StubWithCallback(app_gst_structure_get_string_video_only_device_h264_callback);
+    app_gst_structure_get_int_StubWithCallback(app_gst_structure_get_int_video_only_callback);
+    app_gst_element_link_filtered_IgnoreAndReturn(TRUE);
+    app_g_free_Ignore();
+    app_gst_caps_unref_Ignore();
+    app_gst_bus_remove_signal_watch_Ignore();
+    app_gst_object_unref_Ignore();
+    app_g_main_loop_unref_Ignore();
+    app_g_main_loop_quit_Ignore();
+    retStatus = initMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    retStatus = getMediaSourceReconnectStats(NULL, &reconnectStats);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NULL_ARG, retStatus);
+    retStatus = getMediaSourceReconnectStats(pMediaContext, NULL);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NULL_ARG, retStatus);
+
+    // step.2: link the hooks.
+    retStatus = linkMeidaSinkHook(pMediaContext, mediaSinkHook_record_callback, pGstMock);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    pGstMock->mediaEosVal = FALSE;
+    retStatus = linkMeidaEosHook(pMediaContext, mediaEosHook_callback, &pGstMock->mediaEosVal);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // step.3: the camera is lost once and the media source runs until it is shut down.
+    app_g_main_loop_run_StubWithCallback(app_g_main_loop_run_reconnect_callback);
+    app_gst_caps_new_simple_StubWithCallback(app_gst_caps_new_simple_video_only_callback);
+    app_gst_element_link_many_IgnoreAndReturn(TRUE);
+    retStatus = (STATUS) runMediaSource(pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(2, pGstMock->runCount);
+    TEST_ASSERT_EQUAL(FALSE, pGstMock->mediaEosVal);
+
+    // the timestamps go on across the rebuilt pipeline, the first frame of it follows the last one of the old pipeline.
+    TEST_ASSERT_EQUAL(6, pGstMock->mediaSinkFrameCount);
+    for (i = 1; i < pGstMock->mediaSinkFrameCount; i++) {
+        TEST_ASSERT_TRUE(pGstMock->mediaSinkFrames[i].presentationTs > pGstMock->mediaSinkFrames[i - 1].presentationTs);
+        TEST_ASSERT_TRUE(pGstMock->mediaSinkFrames[i].decodingTs > pGstMock->mediaSinkFrames[i - 1].decodingTs);
+    }
+    TEST_ASSERT_EQUAL(pGstMock->mediaSinkFrames[2].presentationTs + pGstMock->mediaSinkFrames[2].duration,
+                      pGstMock->mediaSinkFrames[3].presentationTs);
+
+    retStatus = getMediaSourceReconnectStats(pMediaContext, &reconnectStats);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(1, reconnectStats.reconnectCount);
+    TEST_ASSERT_EQUAL(0, reconnectStats.failedCount);
+    TEST_ASSERT_EQUAL(FALSE, reconnectStats.lost);
+    TEST_ASSERT_TRUE(reconnectStats.downtime >= APP_MEDIA_RECONNECT_BASE_DELAY / 2);
+
+    // step.4 destroy the meida source.
+    retStatus = detroyMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(NULL, pMediaContext);
+    unsetenv(APP_MEDIA_RTSP_RECONNECT_RETRIES);
+}
+
+void test_watchdog(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PMediaContext pMediaContext;
+    PGstMock pGstMock = getGstMock();
+    PGstMockElementList pElementList = &pGstMock->elementList;
+    MediaWatchdogStats watchdogStats;
+
+    setenv(APP_MEDIA_RTSP_URL, APP_RTSPSRC_UTEST_RTSP_URL, 1);
+    setenv(APP_MEDIA_RTSP_USERNAME, APP_RTSPSRC_UTEST_RTSP_USERNAME, 1);
+    setenv(APP_MEDIA_RTSP_PASSWORD, APP_RTSPSRC_UTEST_RTSP_PASSWORD, 1);
+    setenv(APP_MEDIA_RTSP_STALL_TIMEOUT, "100", 1);
+    // step.1: initilaize this media source as video-only device.
+    app_gst_init_Ignore();
+    app_gst_pipeline_new_IgnoreAndReturn(pElementList->pPipeline);
+    app_gst_element_factory_make_StubWithCallback(app_gst_element_factory_make_video_only_callback);
+    app_g_type_check_instance_cast_IgnoreAndReturn(pElementList->pDummyInstance);
+    app_g_object_set_Ignore();
+    app_g_signal_connect_StubWithCallback(app_g_signal_connect_callback);
+    app_gst_bin_get_type_IgnoreAndReturn(pElementList->pDummyGType);
+    app_gst_bin_add_many_Ignore();
+    app_gst_element_get_bus_IgnoreAndReturn(pElementList->pBus);
+    app_gst_bus_add_signal_watch_Ignore();
+    app_gst_element_set_state_IgnoreAndReturn(GST_STATE_CHANGE_SUCCESS);
+    app_g_main_loop_new_IgnoreAndReturn(pGstMock);
+    app_g_main_loop_run_StubWithCallback(app_g_main_loop_run_discovery_callback);
+
+    GstCaps template_caps;
+    GstCaps current_caps;
+    GstStructure srcPadStructure;
+    app_gst_pad_get_name_IgnoreAndReturn("srcPadName");
+    app_gst_pad_get_pad_template_caps_IgnoreAndReturn(&template_caps);
+    app_gst_pad_get_current_caps_IgnoreAndReturn(&current_caps);
+    app_gst_caps_get_size_IgnoreAndReturn(1);
+    app_gst_caps_get_structure_IgnoreAndReturn(&srcPadStructure);
+    app_gst_structure_has_field_StubWithCallback(app_gst_structure_has_field_full_callback);
+    app_gst_structure_get_string_StubWithCallback(app_gst_structure_get_string_video_only_device_h264_callback);
+    app_gst_structure_get_int_StubWithCallback(app_gst_structure_get_int_video_only_callback);
+    app_gst_element_link_filtered_IgnoreAndReturn(TRUE);
+    app_g_free_Ignore();
+    app_gst_caps_unref_Ignore();
+    app_gst_bus_remove_signal_watch_Ignore();
+    app_gst_object_unref_Ignore();
+    app_g_main_loop_unref_Ignore();
+    app_g_main_loop_quit_Ignore();
+    retStatus = initMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    retStatus = getMediaSourceWatchdogStats(NULL, &watchdogStats);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NULL_ARG, retStatus);
+    retStatus = getMediaSourceWatchdogStats(pMediaContext, NULL);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NULL_ARG, retStatus);
+
+    // step.2: link the hooks.
+    retStatus = linkMeidaSinkHook(pMediaContext, mediaSinkHook_callback, &pGstMock->mediaSinkFrame);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    pGstMock->mediaEosVal = FALSE;
+    retStatus = linkMeidaEosHook(pMediaContext, mediaEosHook_callback, &pGstMock->mediaEosVal);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // step.3: the pipeline stalls after one frame, it is not rebuilt and the channels see an eos.
+    app_g_main_loop_run_StubWithCallback(app_g_main_loop_run_stalled_callback);
+    app_g_main_loop_quit_StubWithCallback(app_g_main_loop_quit_callback);
+    app_gst_caps_new_simple_StubWithCallback(app_gst_caps_new_simple_video_only_callback);
+    app_gst_element_link_many_IgnoreAndReturn(TRUE);
+    retStatus = (STATUS) runMediaSource(pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(TRUE, pGstMock->mediaEosVal);
+
+    retStatus = getMediaSourceWatchdogStats(pMediaContext, &watchdogStats);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(1, watchdogStats.stallCount);
+    TEST_ASSERT_EQUAL(1, watchdogStats.video.frameCount);
+    TEST_ASSERT_EQUAL(0, watchdogStats.audio.frameCount);
+    TEST_ASSERT_EQUAL(100 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND, watchdogStats.stallTimeout);
+
+    // step.4 destroy the meida source.
+    retStatus = detroyMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(NULL, pMediaContext);
+    unsetenv(APP_MEDIA_RTSP_STALL_TIMEOUT);
+}
+
+void test_frame_timestamps(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PMediaContext pMediaContext;
+    PGstMock pGstMock = getGstMock();
+    PGstMockElementList pElementList = &pGstMock->elementList;
+    PFrame pFrame;
+    INT64 inputRtp, outputRtp, firstRtp, jitter;
+    UINT32 i;
+
+    setenv(APP_MEDIA_RTSP_URL, APP_RTSPSRC_UTEST_RTSP_URL, 1);
+    setenv(APP_MEDIA_RTSP_USERNAME, APP_RTSPSRC_UTEST_RTSP_USERNAME, 1);
+    setenv(APP_MEDIA_RTSP_PASSWORD, APP_RTSPSRC_UTEST_RTSP_PASSWORD, 1);
+    // step.1: initilaize this media source as video-only device.
+    app_gst_init_Ignore();
+    app_gst_pipeline_new_IgnoreAndReturn(pElementList->pPipeline);
+    app_gst_element_factory_make_StubWithCallback(app_gst_element_factory_make_video_only_callback);
+    app_g_type_check_instance_cast_IgnoreAndReturn(pElementList->pDummyInstance);
+    app_g_object_set_Ignore();
+    app_g_signal_connect_StubWithCallback(app_g_signal_connect_callback);
+    app_gst_bin_get_type_IgnoreAndReturn(pElementList->pDummyGType);
+    app_gst_bin_add_many_Ignore();
+    app_gst_element_get_bus_IgnoreAndReturn(pElementList->pBus);
+    app_gst_bus_add_signal_watch_Ignore();
+    app_gst_element_set_state_IgnoreAndReturn(GST_STATE_CHANGE_SUCCESS);
+    app_g_main_loop_new_IgnoreAndReturn(pGstMock);
+    app_g_main_loop_run_StubWithCallback(app_g_main_loop_run_discovery_callback);
+
+    GstCaps template_caps;
+    GstCaps current_caps;
+    GstStructure srcPadStructure;
+    app_gst_pad_get_name_IgnoreAndReturn("srcPadName");
+    app_gst_pad_get_pad_template_caps_IgnoreAndReturn(&template_caps);
+    app_gst_pad_get_current_caps_IgnoreAndReturn(&current_caps);
+    app_gst_caps_get_size_IgnoreAndReturn(1);
+    app_gst_caps_get_structure_IgnoreAndReturn(&srcPadStructure);
+    app_gst_structure_has_field_StubWithCallback(app_gst_structure_has_field_full_callback);
+    app_gst_structure_get_string_StubWithCallback(app_gst_structure_get_string_video_only_device_h264_callback);
+    app_gst_structure_get_int_StubWithCallback(app_gst_structure_get_int_video_only_callback);
+    app_gst_element_link_filtered_IgnoreAndReturn(TRUE);
+    app_g_free_Ignore();
+    app_gst_caps_unref_Ignore();
+    app_gst_bus_remove_signal_watch_Ignore();
+    app_gst_object_unref_Ignore();
+    app_g_main_loop_unref_Ignore();
+    app_g_main_loop_quit_Ignore();
+    retStatus = initMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // step.2: link the hooks.
+    retStatus = linkMeidaSinkHook(pMediaContext, mediaSinkHook_record_callback, pGstMock);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = linkMeidaEosHook(pMediaContext, mediaEosHook_callback, &pGstMock->mediaEosVal);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // step.3: a gop with b-frames goes through the media source.
+    app_g_main_loop_run_StubWithCallback(app_g_main_loop_run_timestamps_callback);
+    app_gst_caps_new_simple_StubWithCallback(app_gst_caps_new_simple_video_only_callback);
+    app_gst_element_link_many_IgnoreAndReturn(TRUE);
+    retStatus = (STATUS) runMediaSource(pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(ARRAY_SIZE(gRtpFrameOrder), pGstMock->mediaSinkFrameCount);
+
+    // the rtp timestamps of the sdk follow the ones of the camera, only the rounding of the clocks is left as jitter.
+    firstRtp = (INT64) (pGstMock->mediaSinkFrames[0].presentationTs * GST_STRUCT_FIELD_CLOCK_RATE_VIDEO / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    for (i = 0; i < pGstMock->mediaSinkFrameCount; i++) {
+        pFrame = &pGstMock->mediaSinkFrames[i];
+        inputRtp = (INT64) gRtpFrameOrder[i] * APP_RTSPSRC_UTEST_RTP_INTERVAL;
+        outputRtp = (INT64) (pFrame->presentationTs * GST_STRUCT_FIELD_CLOCK_RATE_VIDEO / HUNDREDS_OF_NANOS_IN_A_SECOND);
+        jitter = (outputRtp - firstRtp) - inputRtp;
+        TEST_ASSERT_TRUE(jitter >= -1 && jitter <= 1);
+        TEST_ASSERT_TRUE(pFrame->decodingTs == i * APP_RTSPSRC_UTEST_FRAME_NANOS / DEFAULT_TIME_UNIT_IN_NANOS);
+        TEST_ASSERT_TRUE(pFrame->decodingTs <= pFrame->presentationTs);
+        if (i == 0) {
+            // no interval is known yet.
+            TEST_ASSERT_TRUE(pFrame->duration == 0);
+        } else if (i == pGstMock->mediaSinkFrameCount - 1) {
+            TEST_ASSERT_TRUE(pFrame->duration == APP_RTSPSRC_UTEST_DURATION_NANOS / DEFAULT_TIME_UNIT_IN_NANOS);
+        } else {
+            // the interval comes from the decoding timestamps, the b-frames do not disturb it.
+            TEST_ASSERT_TRUE(pFrame->duration + 1 >= APP_RTSPSRC_UTEST_FRAME_NANOS / DEFAULT_TIME_UNIT_IN_NANOS &&
+                             pFrame->duration <= APP_RTSPSRC_UTEST_FRAME_NANOS / DEFAULT_TIME_UNIT_IN_NANOS + 1);
+        }
+    }
+
+    // step.4 destroy the meida source.
+    retStatus = detroyMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(NULL, pMediaContext);
+}
+
+void test_select_tracks(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PMediaContext pMediaContext = NULL;
+    PGstMock pGstMock = getGstMock();
+    PGstMockElementList pElementList = &pGstMock->elementList;
+    RTC_CODEC codec;
+    GstElement element;
+    GstCaps caps;
+
+    setenv(APP_MEDIA_RTSP_URL, APP_RTSPSRC_UTEST_RTSP_URL, 1);
+    setenv(APP_MEDIA_RTSP_USERNAME, APP_RTSPSRC_UTEST_RTSP_USERNAME, 1);
+    setenv(APP_MEDIA_RTSP_PASSWORD, APP_RTSPSRC_UTEST_RTSP_PASSWORD, 1);
+    setenv(APP_MEDIA_RTSP_TRACKS, "none", 1);
+    retStatus = initMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_RTSP_TRACKS, retStatus);
+    TEST_ASSERT_EQUAL(NULL, pMediaContext);
+    // the tokens are matched whole, an unknown one is rejected instead of selecting a track by a substring.
+    setenv(APP_MEDIA_RTSP_TRACKS, "novideo,audio", 1);
+    retStatus = initMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_RTSP_TRACKS, retStatus);
+    TEST_ASSERT_EQUAL(NULL, pMediaContext);
+    setenv(APP_MEDIA_RTSP_TRACKS, "video,", 1);
+    retStatus = initMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_RTSP_TRACKS, retStatus);
+    TEST_ASSERT_EQUAL(NULL, pMediaContext);
+
+    // step.1: a listen-only channel of a video-only device.
+    setenv(APP_MEDIA_RTSP_TRACKS, "audio", 1);
+    app_gst_init_Ignore();
+    app_gst_pipeline_new_IgnoreAndReturn(pElementList->pPipeline);
+    app_gst_element_factory_make_StubWithCallback(app_gst_element_factory_make_video_only_callback);
+    app_g_type_check_instance_cast_IgnoreAndReturn(pElementList->pDummyInstance);
+    app_g_object_set_Ignore();
+    app_g_signal_connect_StubWithCallback(app_g_signal_connect_callback);
+    app_gst_bin_get_type_IgnoreAndReturn(pElementList->pDummyGType);
+    app_gst_bin_add_many_Ignore();
+    app_gst_element_get_bus_IgnoreAndReturn(pElementList->pBus);
+    app_gst_bus_add_signal_watch_Ignore();
+    app_gst_element_set_state_IgnoreAndReturn(GST_STATE_CHANGE_SUCCESS);
+    app_g_main_loop_new_IgnoreAndReturn(pGstMock);
+    app_g_main_loop_run_StubWithCallback(app_g_main_loop_run_discovery_callback);
+
+    GstCaps template_caps;
+    GstCaps current_caps;
+    GstStructure srcPadStructure;
+    app_gst_pad_get_name_IgnoreAndReturn("srcPadName");
+    app_gst_pad_get_pad_template_caps_IgnoreAndReturn(&template_caps);
+    app_gst_pad_get_current_caps_IgnoreAndReturn(&current_caps);
+    app_gst_caps_get_size_IgnoreAndReturn(1);
+    app_gst_caps_get_structure_IgnoreAndReturn(&srcPadStructure);
+    app_gst_structure_has_field_StubWithCallback(app_gst_structure_has_field_full_callback);
+    app_gst_structure_get_string_StubWithCallback(app_gst_structure_get_string_video_only_device_h264_callback);
+    app_gst_structure_get_int_StubWithCallback(app_gst_structure_get_int_video_only_callback);
+    app_gst_element_link_filtered_IgnoreAndReturn(TRUE);
+    app_g_free_Ignore();
+    app_gst_caps_unref_Ignore();
+    app_gst_bus_remove_signal_watch_Ignore();
+    app_gst_object_unref_Ignore();
+    app_g_main_loop_unref_Ignore();
+    app_g_main_loop_quit_Ignore();
+    retStatus = initMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // step.2: the video stream is not discovered, the channel has no track of the media source.
+    retStatus = queryMediaVideoCap(pMediaContext, &codec);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_EXISTED, retStatus);
+    retStatus = queryMediaAudioCap(pMediaContext, &codec);
+    TEST_ASSERT_EQUAL(STATUS_MEDIA_NOT_EXISTED, retStatus);
+
+    // step.3: rtspsrc does not set up the video stream.
+    TEST_ASSERT_NOT_NULL(pGstMock->selectStream);
+    TEST_ASSERT_EQUAL(FALSE, pGstMock->selectStream(&element, 0, &caps, pGstMock->uData));
+    app_gst_structure_get_string_StubWithCallback(app_gst_structure_get_string_audio_only_device_opus_callback);
+    TEST_ASSERT_EQUAL(TRUE, pGstMock->selectStream(&element, 1, &caps, pGstMock->uData));
+    TEST_ASSERT_EQUAL(TRUE, pGstMock->selectStream(&element, 2, NULL, pGstMock->uData));
+
+    // step.4 destroy the meida source.
+    retStatus = detroyMediaSource(&pMediaContext);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(NULL, pMediaContext);
+    unsetenv(APP_MEDIA_RTSP_TRACKS);
+}
@@ -16,15 +16,22 @@
 #include "AppSignaling.h"
 #include "mock_Include.h"
 
-#define APP_SIGNALING_UTEST_TURN_SERVER "turns:12-345-678-89.t-abcdefgh.kinesisvideo.us-west-2.amazonaws.com:443?transport=udp"
-#define APP_SIGNALING_UTEST_USERNAME    "username"
-#define APP_SIGNALING_UTEST_PASSWORD    "password"
-#define APP_SIGNALING_UTEST_HANDLE      0x01
+#define APP_SIGNALING_UTEST_TURN_SERVER   "turns:12-345-678-89.t-abcdefgh.kinesisvideo.us-west-2.amazonaws.com:443?transport=udp"
+#define APP_SIGNALING_UTEST_USERNAME      "username"
+#define APP_SIGNALING_UTEST_PASSWORD      "password"
+#define APP_SIGNALING_UTEST_HANDLE        0x01
+#define APP_SIGNALING_UTEST_PEER_ID       "peerId"
+#define APP_SIGNALING_UTEST_WAIT_COUNT    1000
+#define APP_SIGNALING_UTEST_TURN_SERVER_A "turn:1.2.3.4:443?transport=udp"
+#define APP_SIGNALING_UTEST_TURN_SERVER_B "turn:5.6.7.8:443?transport=udp"
+#define APP_SIGNALING_UTEST_UNKNOWN_URL   "turn:9.9.9.9:443?transport=udp"
 
 static AppCredential mAppCredential;
 static AppSignaling mAppSignaling;
 static IceConfigInfo mIceConfigInfo = {};
+static IceConfigInfo mRankedIceConfigInfos[2] = {};
 static SIGNALING_CLIENT_STATE mSignalingClientState;
+static UINT32 mCreateFailureCount;
 static createMutex BackGlobalCreateMutex;
 
 typedef struct {
@@ -49,9 +56,17 @@ void setUp()
     memset(pAppSigMock, 0, sizeof(AppSigMock));
     pAppSigMock->pAppSignaling = &mAppSignaling;
     pAppSignaling = pAppSigMock->pAppSignaling;
+    memset(pAppSignaling, 0, sizeof(AppSignaling));
     pAppSignaling->pAppCredential = &mAppCredential;
     pAppSignaling->signalingClientHandle = INVALID_SIGNALING_CLIENT_HANDLE_VALUE;
     pAppSignaling->signalingSendMessageLock = INVALID_MUTEX_VALUE;
+    pAppSignaling->sendQueueLock = INVALID_MUTEX_VALUE;
+    pAppSignaling->turnServerLock = INVALID_MUTEX_VALUE;
+    pAppSignaling->sendQueueCvar = INVALID_CVAR_VALUE;
+    pAppSignaling->senderTid = INVALID_TID_VALUE;
+    pAppSignaling->reconnectLock = INVALID_MUTEX_VALUE;
+    pAppSignaling->reconnectCvar = INVALID_CVAR_VALUE;
+    pAppSignaling->reconnectTid = INVALID_TID_VALUE;
 
     pChannelInfo = &pAppSignaling->channelInfo;
     pChannelInfo->channelRoleType = SIGNALING_CHANNEL_ROLE_TYPE_MASTER;
@@ -85,6 +100,19 @@ static STATUS signalingClientGetIceConfigInfo_callback(SIGNALING_CLIENT_HANDLE s
     return STATUS_SUCCESS;
 }
 
+static STATUS signalingClientGetIceConfigInfoCount_ranked_callback(SIGNALING_CLIENT_HANDLE signalingClientHandle, PUINT32 pIceConfigCount)
+{
+    *pIceConfigCount = ARRAY_SIZE(mRankedIceConfigInfos);
+    return STATUS_SUCCESS;
+}
+
+static STATUS signalingClientGetIceConfigInfo_ranked_callback(SIGNALING_CLIENT_HANDLE signalingClientHandle, UINT32 index,
+                                                              PIceConfigInfo* ppIceConfigInfo)
+{
+    *ppIceConfigInfo = &mRankedIceConfigInfos[index];
+    return STATUS_SUCCESS;
+}
+
 static STATUS signalingClientGetCurrentState_callback(SIGNALING_CLIENT_HANDLE signalingClientHandle, PSIGNALING_CLIENT_STATE pState)
 {
     PAppSigMock pAppSigMock = getAppSigMock();
@@ -92,6 +120,28 @@ static STATUS signalingClientGetCurrentState_callback(SIGNALING_CLIENT_HANDLE si
     return STATUS_SUCCESS;
 }
 
+static VOID create_signaling_message(PSignalingMessage pMessage, SIGNALING_MESSAGE_TYPE messageType)
+{
+    memset(pMessage, 0, sizeof(SignalingMessage));
+    pMessage->version = SIGNALING_MESSAGE_CURRENT_VERSION;
+    pMessage->messageType = messageType;
+    strcpy(pMessage->peerClientId, APP_SIGNALING_UTEST_PEER_ID);
+}
+
+/* wait until the sender thread handled the expected number of messages. */
+static VOID wait_send_stats(PAppSignaling pAppSignaling, UINT64 handledCount, PAppSignalingSendStats pSendStats)
+{
+    UINT32 i;
+
+    for (i = 0; i < APP_SIGNALING_UTEST_WAIT_COUNT; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppSignalingSendStats(pAppSignaling, pSendStats));
+        if (pSendStats->sentCount + pSendStats->failedCount >= handledCount) {
+            break;
+        }
+        THREAD_SLEEP(HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    }
+}
+
 static STATUS createSignalingClientSync_callback(PSignalingClientInfo pClientInfo, PChannelInfo pChannelInfo, PSignalingClientCallbacks pCallbacks,
                                                  PAwsCredentialProvider pCredentialProvider, PSIGNALING_CLIENT_HANDLE pSignalingHandle)
 {
@@ -99,14 +149,42 @@ static STATUS createSignalingClientSync_callback(PSignalingClientInfo pClientInf
     return STATUS_SUCCESS;
 }
 
+/* fail the first mCreateFailureCount calls, like a signaling client created during an outage. */
+static STATUS createSignalingClientSync_outage_callback(PSignalingClientInfo pClientInfo, PChannelInfo pChannelInfo,
+                                                        PSignalingClientCallbacks pCallbacks, PAwsCredentialProvider pCredentialProvider,
+                                                        PSIGNALING_CLIENT_HANDLE pSignalingHandle)
+{
+    if (mCreateFailureCount > 0) {
+        mCreateFailureCount--;
+        return STATUS_NULL_ARG;
+    }
+    *pSignalingHandle = APP_SIGNALING_UTEST_HANDLE + 1;
+    return STATUS_SUCCESS;
+}
+
+/* wait until the reconnect thread re-created the signaling client the expected number of times. */
+static VOID wait_reconnect_stats(PAppSignaling pAppSignaling, UINT64 restartCount, PAppSignalingReconnectStats pReconnectStats)
+{
+    UINT32 i;
+
+    for (i = 0; i < APP_SIGNALING_UTEST_WAIT_COUNT; i++) {
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppSignalingReconnectStats(pAppSignaling, pReconnectStats));
+        if (pReconnectStats->restartCount >= restartCount && pReconnectStats->state == APP_SIGNALING_RECONNECT_STATE_IDLE) {
+            break;
+        }
+        THREAD_SLEEP(HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    }
+}
+
 void test_initAppSignaling_null_mutex(void)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PAppSigMock pAppSigMock = getAppSigMock();
     PAppSignaling pAppSignaling = pAppSigMock->pAppSignaling;
     SIGNALING_CHANNEL_ROLE_TYPE channelRoleType = SIGNALING_CHANNEL_ROLE_TYPE_UNKNOWN;
-    PSignalingMessage message;
+    SignalingMessage message;
 
+    create_signaling_message(&message, SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE);
     BackGlobalCreateMutex = globalCreateMutex;
     globalCreateMutex = null_createMutex;
 
@@ -202,6 +280,85 @@ void test_queryAppSignalingServer(void)
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 }
 
+void test_queryAppSignalingServer_rank(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppSigMock pAppSigMock = getAppSigMock();
+    PAppSignaling pAppSignaling = pAppSigMock->pAppSignaling;
+    RtcConfiguration rtcConfiguration;
+    UINT32 uriCount = MAX_ICE_SERVERS_COUNT;
+
+    memset(mRankedIceConfigInfos, 0, sizeof(mRankedIceConfigInfos));
+    mRankedIceConfigInfos[0].uriCount = 1;
+    strcpy(mRankedIceConfigInfos[0].uris[0], APP_SIGNALING_UTEST_TURN_SERVER_A);
+    mRankedIceConfigInfos[1].uriCount = 1;
+    strcpy(mRankedIceConfigInfos[1].uris[0], APP_SIGNALING_UTEST_TURN_SERVER_B);
+    signalingClientGetIceConfigInfoCount_StubWithCallback(signalingClientGetIceConfigInfoCount_ranked_callback);
+    signalingClientGetIceConfigInfo_StubWithCallback(signalingClientGetIceConfigInfo_ranked_callback);
+
+    // the invalid number of turn servers falls back to the default one.
+    setenv(APP_TURN_SERVER_COUNT, "0", 1);
+    retStatus = initAppSignaling(pAppSignaling, NULL, NULL, NULL, NULL, TRUE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(APP_TURN_SERVER_DEFAULT_COUNT, pAppSignaling->maxTurnServer);
+    TEST_ASSERT_EQUAL(APP_TURN_PROBE_DEFAULT_INTERVAL, pAppSignaling->turnProbeInterval);
+
+    retStatus = reportAppSignalingTurnRtt(NULL, APP_SIGNALING_UTEST_TURN_SERVER_A, 0);
+    TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_NULL_ARG, retStatus);
+
+    // the servers which are not probed yet are used in the order of the ice configs.
+    retStatus = queryAppSignalingServer(pAppSignaling, rtcConfiguration.iceServers, &uriCount);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(2, uriCount);
+    TEST_ASSERT_EQUAL_STRING(APP_SIGNALING_UTEST_TURN_SERVER_A, rtcConfiguration.iceServers[1].urls);
+
+    retStatus = reportAppSignalingTurnRtt(pAppSignaling, APP_SIGNALING_UTEST_UNKNOWN_URL, 10 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    TEST_ASSERT_EQUAL(STATUS_NOT_FOUND, retStatus);
+
+    // an unreachable server does not hold back the one which is not probed yet.
+    retStatus = reportAppSignalingTurnRtt(pAppSignaling, APP_SIGNALING_UTEST_TURN_SERVER_A, APP_TURN_SERVER_UNREACHABLE_RTT);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = queryAppSignalingServer(pAppSignaling, rtcConfiguration.iceServers, &uriCount);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL_STRING(APP_SIGNALING_UTEST_TURN_SERVER_B, rtcConfiguration.iceServers[1].urls);
+
+    // the best probed server stays first, the one which is not probed yet follows it.
+    retStatus = reportAppSignalingTurnRtt(pAppSignaling, APP_SIGNALING_UTEST_TURN_SERVER_A, 100 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = queryAppSignalingServer(pAppSignaling, rtcConfiguration.iceServers, &uriCount);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL_STRING(APP_SIGNALING_UTEST_TURN_SERVER_A, rtcConfiguration.iceServers[1].urls);
+
+    // the faster server wins once both are probed, and the measurement survives the refresh of the ice configs.
+    retStatus = reportAppSignalingTurnRtt(pAppSignaling, APP_SIGNALING_UTEST_TURN_SERVER_B, 20 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = queryAppSignalingServer(pAppSignaling, rtcConfiguration.iceServers, &uriCount);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL_STRING(APP_SIGNALING_UTEST_TURN_SERVER_B, rtcConfiguration.iceServers[1].urls);
+    TEST_ASSERT_EQUAL(20 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND, pAppSignaling->turnServers[1].rtt);
+
+    retStatus = freeAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // hand both turn servers to the peer connection.
+    setenv(APP_TURN_SERVER_COUNT, "2", 1);
+    setenv(APP_TURN_PROBE_INTERVAL, "5", 1);
+    retStatus = initAppSignaling(pAppSignaling, NULL, NULL, NULL, NULL, TRUE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(2, pAppSignaling->maxTurnServer);
+    TEST_ASSERT_EQUAL(5 * HUNDREDS_OF_NANOS_IN_A_SECOND, pAppSignaling->turnProbeInterval);
+
+    retStatus = queryAppSignalingServer(pAppSignaling, rtcConfiguration.iceServers, &uriCount);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(3, uriCount);
+
+    retStatus = freeAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    unsetenv(APP_TURN_SERVER_COUNT);
+    unsetenv(APP_TURN_PROBE_INTERVAL);
+}
+
 void test_connectAppSignaling(void)
 {
     STATUS retStatus = STATUS_SUCCESS;
@@ -278,8 +435,10 @@ void test_sendAppSignalingMessage(void)
     STATUS retStatus = STATUS_SUCCESS;
     PAppSigMock pAppSigMock = getAppSigMock();
     PAppSignaling pAppSignaling = pAppSigMock->pAppSignaling;
-    PSignalingMessage message;
+    SignalingMessage message;
+    AppSignalingSendStats sendStats;
 
+    create_signaling_message(&message, SIGNALING_MESSAGE_TYPE_ANSWER);
     retStatus = initAppSignaling(pAppSignaling, NULL, NULL, NULL, NULL, TRUE);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
@@ -292,12 +451,16 @@ void test_sendAppSignalingMessage(void)
     retStatus = sendAppSignalingMessage(pAppSignaling, &message);
     TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_INVALID_HANDLE, retStatus);
 
+    retStatus = getAppSignalingSendStats(pAppSignaling, NULL);
+    TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_NULL_ARG, retStatus);
+
     createSignalingClientSync_StubWithCallback(createSignalingClientSync_callback);
     signalingClientFetchSync_IgnoreAndReturn(STATUS_SUCCESS);
     signalingClientConnectSync_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = connectAppSignaling(pAppSignaling);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 
+    // the answer is sent on the caller thread, so its failure is returned.
     signalingClientSendMessageSync_IgnoreAndReturn(STATUS_NULL_ARG);
     retStatus = sendAppSignalingMessage(pAppSignaling, &message);
     TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_SEND, retStatus);
@@ -305,6 +468,95 @@ void test_sendAppSignalingMessage(void)
     signalingClientSendMessageSync_IgnoreAndReturn(STATUS_SUCCESS);
     retStatus = sendAppSignalingMessage(pAppSignaling, &message);
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppSignalingSendStats(pAppSignaling, &sendStats));
+    TEST_ASSERT_EQUAL(1, sendStats.failedCount);
+    TEST_ASSERT_EQUAL(1, sendStats.sentCount);
+    TEST_ASSERT_EQUAL(0, sendStats.enqueuedCount);
+
+    freeSignalingClient_ExpectAnyArgsAndReturn(STATUS_SUCCESS);
+    retStatus = freeAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+}
+
+void test_sendAppSignalingMessage_candidates(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppSigMock pAppSigMock = getAppSigMock();
+    PAppSignaling pAppSignaling = pAppSigMock->pAppSignaling;
+    SignalingMessage candidate;
+    AppSignalingSendStats sendStats;
+    UINT32 i;
+
+    create_signaling_message(&candidate, SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE);
+    retStatus = initAppSignaling(pAppSignaling, NULL, NULL, NULL, NULL, TRUE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    createSignalingClientSync_StubWithCallback(createSignalingClientSync_callback);
+    signalingClientFetchSync_IgnoreAndReturn(STATUS_SUCCESS);
+    signalingClientConnectSync_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = connectAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // hold the websocket so the candidates pile up, the caller does not wait for it.
+    signalingClientSendMessageSync_IgnoreAndReturn(STATUS_SUCCESS);
+    MUTEX_LOCK(pAppSignaling->signalingSendMessageLock);
+    for (i = 0; i < 3; i++) {
+        retStatus = sendAppSignalingMessage(pAppSignaling, &candidate);
+        TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    }
+    MUTEX_UNLOCK(pAppSignaling->signalingSendMessageLock);
+
+    wait_send_stats(pAppSignaling, 3, &sendStats);
+    TEST_ASSERT_EQUAL(3, sendStats.sentCount);
+    TEST_ASSERT_EQUAL(3, sendStats.enqueuedCount);
+    TEST_ASSERT_EQUAL(0, sendStats.queueDepth);
+    TEST_ASSERT_TRUE(sendStats.maxQueueDepth >= 2);
+
+    // the failure of a candidate is reported by the sender thread, not by the caller.
+    signalingClientSendMessageSync_IgnoreAndReturn(STATUS_NULL_ARG);
+    retStatus = sendAppSignalingMessage(pAppSignaling, &candidate);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    wait_send_stats(pAppSignaling, 4, &sendStats);
+    TEST_ASSERT_EQUAL(1, sendStats.failedCount);
+
+    freeSignalingClient_ExpectAnyArgsAndReturn(STATUS_SUCCESS);
+    retStatus = freeAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+}
+
+void test_sendAppSignalingMessage_queue_full(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppSigMock pAppSigMock = getAppSigMock();
+    PAppSignaling pAppSignaling = pAppSigMock->pAppSignaling;
+    SignalingMessage message;
+    AppSignalingSendStats sendStats;
+    UINT32 i;
+
+    create_signaling_message(&message, SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE);
+    retStatus = initAppSignaling(pAppSignaling, NULL, NULL, NULL, NULL, TRUE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    createSignalingClientSync_StubWithCallback(createSignalingClientSync_callback);
+    signalingClientFetchSync_IgnoreAndReturn(STATUS_SUCCESS);
+    signalingClientConnectSync_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = connectAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // the sender thread can take at most one message while the websocket is held.
+    signalingClientSendMessageSync_IgnoreAndReturn(STATUS_SUCCESS);
+    MUTEX_LOCK(pAppSignaling->signalingSendMessageLock);
+    for (i = 0; i < APP_SIGNALING_SEND_QUEUE_MAX_DEPTH + 2; i++) {
+        retStatus = sendAppSignalingMessage(pAppSignaling, &message);
+        if (retStatus != STATUS_SUCCESS) {
+            break;
+        }
+    }
+    TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_SEND_QUEUE_FULL, retStatus);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppSignalingSendStats(pAppSignaling, &sendStats));
+    TEST_ASSERT_EQUAL(1, sendStats.droppedCount);
+    TEST_ASSERT_EQUAL(APP_SIGNALING_SEND_QUEUE_MAX_DEPTH, sendStats.maxQueueDepth);
+    MUTEX_UNLOCK(pAppSignaling->signalingSendMessageLock);
 
     freeSignalingClient_ExpectAnyArgsAndReturn(STATUS_SUCCESS);
     retStatus = freeAppSignaling(pAppSignaling);
@@ -331,6 +583,92 @@ void test_restartAppSignaling(void)
     TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
 }
 
+void test_requestAppSignalingRestart(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppSigMock pAppSigMock = getAppSigMock();
+    PAppSignaling pAppSignaling = pAppSigMock->pAppSignaling;
+    AppSignalingReconnectStats reconnectStats;
+
+    retStatus = requestAppSignalingRestart(NULL);
+    TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_NULL_ARG, retStatus);
+    retStatus = requestAppSignalingRestart(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_INVALID_MUTEX, retStatus);
+    retStatus = getAppSignalingReconnectStats(pAppSignaling, NULL);
+    TEST_ASSERT_EQUAL(STATUS_APP_SIGNALING_NULL_ARG, retStatus);
+
+    retStatus = initAppSignaling(pAppSignaling, NULL, NULL, NULL, NULL, TRUE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    createSignalingClientSync_StubWithCallback(createSignalingClientSync_callback);
+    signalingClientFetchSync_IgnoreAndReturn(STATUS_SUCCESS);
+    signalingClientConnectSync_IgnoreAndReturn(STATUS_SUCCESS);
+    retStatus = connectAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    // the first two attempts fail during the outage, and the backoff keeps growing between them.
+    MUTEX_LOCK(pAppSignaling->reconnectLock);
+    pAppSignaling->reconnectBaseDelay = HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+    pAppSignaling->reconnectMaxDelay = 4 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+    MUTEX_UNLOCK(pAppSignaling->reconnectLock);
+    mCreateFailureCount = 2;
+    freeSignalingClient_IgnoreAndReturn(STATUS_SUCCESS);
+    createSignalingClientSync_StubWithCallback(createSignalingClientSync_outage_callback);
+    pAppSigMock->signalingClientState = SIGNALING_CLIENT_STATE_READY;
+    signalingClientGetCurrentState_StubWithCallback(signalingClientGetCurrentState_callback);
+
+    // the request never blocks, and the one made before the restart is merged.
+    retStatus = requestAppSignalingRestart(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    retStatus = requestAppSignalingRestart(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+
+    wait_reconnect_stats(pAppSignaling, 1, &reconnectStats);
+    TEST_ASSERT_EQUAL(APP_SIGNALING_RECONNECT_STATE_IDLE, reconnectStats.state);
+    TEST_ASSERT_EQUAL(1, reconnectStats.restartCount);
+    TEST_ASSERT_EQUAL(2, reconnectStats.failedCount);
+    TEST_ASSERT_EQUAL(0, reconnectStats.attempt);
+    TEST_ASSERT_TRUE(reconnectStats.lastDelay >= HUNDREDS_OF_NANOS_IN_A_MILLISECOND / 2);
+    TEST_ASSERT_TRUE(reconnectStats.lastDelay <= 2 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    TEST_ASSERT_EQUAL(APP_SIGNALING_UTEST_HANDLE + 1, pAppSignaling->signalingClientHandle);
+
+    retStatus = freeAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+}
+
+void test_requestAppSignalingRestart_before_connect(void)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PAppSigMock pAppSigMock = getAppSigMock();
+    PAppSignaling pAppSignaling = pAppSigMock->pAppSignaling;
+    AppSignalingReconnectStats reconnectStats;
+
+    retStatus = initAppSignaling(pAppSignaling, NULL, NULL, NULL, NULL, TRUE);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    createSignalingClientSync_StubWithCallback(createSignalingClientSync_callback);
+    signalingClientFetchSync_IgnoreAndReturn(STATUS_SUCCESS);
+    signalingClientConnectSync_IgnoreAndReturn(STATUS_SUCCESS);
+    freeSignalingClient_IgnoreAndReturn(STATUS_SUCCESS);
+    pAppSigMock->signalingClientState = SIGNALING_CLIENT_STATE_READY;
+    signalingClientGetCurrentState_StubWithCallback(signalingClientGetCurrentState_callback);
+
+    // the reconnect thread leaves the client to connectAppSignaling until it returns.
+    retStatus = requestAppSignalingRestart(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    THREAD_SLEEP(20 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, getAppSignalingReconnectStats(pAppSignaling, &reconnectStats));
+    TEST_ASSERT_EQUAL(0, reconnectStats.restartCount);
+    TEST_ASSERT_EQUAL(APP_SIGNALING_RECONNECT_STATE_IDLE, reconnectStats.state);
+
+    // the pending request is served after it.
+    retStatus = connectAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+    wait_reconnect_stats(pAppSignaling, 1, &reconnectStats);
+    TEST_ASSERT_EQUAL(1, reconnectStats.restartCount);
+
+    retStatus = freeAppSignaling(pAppSignaling);
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, retStatus);
+}
+
 void test_freeAppSignaling(void)
 {
     STATUS retStatus = STATUS_SUCCESS;
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "unity.h"
+#include "AppTrace.h"
+#include "mock_Include.h"
+
+#define APP_TRACE_UTEST_FILE      "./utest_trace.json"
+#define APP_TRACE_UTEST_FILE_SIZE (1024 * 1024)
+
+static CHAR gTrace[APP_TRACE_UTEST_FILE_SIZE];
+
+static PCHAR readAppTraceUTestFile()
+{
+    FILE* fp = fopen(APP_TRACE_UTEST_FILE, "r");
+    SIZE_T len;
+
+    TEST_ASSERT_NOT_NULL(fp);
+    len = fread(gTrace, 1, SIZEOF(gTrace) - 1, fp);
+    fclose(fp);
+    gTrace[len] = '\0';
+    return gTrace;
+}
+
+static UINT32 countAppTraceUTestEvents(PCHAR pTrace, PCHAR pName)
+{
+    UINT32 count = 0;
+
+    while ((pTrace = STRSTR(pTrace, pName)) != NULL) {
+        count++;
+        pTrace++;
+    }
+    return count;
+}
+
+static PVOID appTraceUTestRoutine(PVOID args)
+{
+    UNUSED_PARAM(args);
+    setAppTraceThreadName("utest-worker");
+    appTraceBegin("utestWorkerSpan");
+    appTraceEnd("utestWorkerSpan");
+    return NULL;
+}
+
+static PVOID appTraceUTestNamedRoutine(PVOID args)
+{
+    setAppTraceThreadName((PCHAR) args);
+    appTraceBegin("utestNamedSpan");
+    appTraceEnd("utestNamedSpan");
+    return NULL;
+}
+
+/* Called before each test method. */
+void setUp()
+{
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, initAppTrace(APP_TRACE_UTEST_FILE));
+}
+
+/* Called after each test method. */
+void tearDown()
+{
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, deinitAppTrace());
+    unlink(APP_TRACE_UTEST_FILE);
+}
+
+void test_initAppTrace(void)
+{
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, deinitAppTrace());
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, initAppTrace(NULL));
+    TEST_ASSERT_EQUAL(STATUS_APP_TRACE_DISABLED, dumpAppTrace(NULL));
+
+    // the events are dropped while the tracer is disabled, and it can still be dumped into a path.
+    appTraceBegin("utestDisabledSpan");
+    appTraceEnd("utestDisabledSpan");
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, dumpAppTrace(APP_TRACE_UTEST_FILE));
+    TEST_ASSERT_NULL(STRSTR(readAppTraceUTestFile(), "utestDisabledSpan"));
+    TEST_ASSERT_EQUAL(STATUS_APP_TRACE_OPEN_FILE, dumpAppTrace("./utest_no_such_dir/trace.json"));
+}
+
+void test_dumpAppTrace(void)
+{
+    PCHAR pTrace;
+
+    setAppTraceThreadName("utest-main");
+    setAppTraceThreadName("utest-renamed");
+    appTraceBegin("utestSpan");
+    appTraceEnd("utestSpan");
+    appTraceBegin("utest\"Quoted\\Span\n");
+    appTraceEnd("utest\"Quoted\\Span\n");
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, dumpAppTrace(NULL));
+
+    pTrace = readAppTraceUTestFile();
+    TEST_ASSERT_EQUAL(0, STRNCMP(pTrace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", STRLEN("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[")));
+    TEST_ASSERT_NOT_NULL(STRSTR(pTrace, "{\"name\":\"thread_name\",\"ph\":\"M\""));
+    TEST_ASSERT_NOT_NULL(STRSTR(pTrace, "\"args\":{\"name\":\"utest-main\"}"));
+    TEST_ASSERT_NULL(STRSTR(pTrace, "utest-renamed"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pTrace, "{\"name\":\"utestSpan\",\"ph\":\"B\",\"ts\":"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pTrace, "{\"name\":\"utestSpan\",\"ph\":\"E\",\"ts\":"));
+    // the names are escaped into valid json strings.
+    TEST_ASSERT_NOT_NULL(STRSTR(pTrace, "{\"name\":\"utest\\\"Quoted\\\\Span\\u000a\",\"ph\":\"B\",\"ts\":"));
+    TEST_ASSERT_NOT_NULL(STRSTR(pTrace, "\n]}\n"));
+}
+
+void test_appTraceThreads(void)
+{
+    pthread_t thread;
+    PCHAR pTrace;
+
+    TEST_ASSERT_EQUAL(0, pthread_create(&thread, NULL, appTraceUTestRoutine, NULL));
+    TEST_ASSERT_EQUAL(0, pthread_join(thread, NULL));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, dumpAppTrace(NULL));
+
+    pTrace = readAppTraceUTestFile();
+    TEST_ASSERT_NOT_NULL(STRSTR(pTrace, "\"args\":{\"name\":\"utest-worker\"}"));
+    TEST_ASSERT_EQUAL(2, countAppTraceUTestEvents(pTrace, "\"utestWorkerSpan\""));
+}
+
+void test_appTraceRingWrap(void)
+{
+    PCHAR pTrace;
+    UINT32 i;
+
+    // the ring keeps the latest events of the thread, but the oldest one is skipped since the thread may be overwriting it.
+    for (i = 0; i < APP_TRACE_RING_SIZE / 2 + 10; i++) {
+        appTraceBegin("utestWrapSpan");
+        appTraceEnd("utestWrapSpan");
+    }
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, dumpAppTrace(NULL));
+
+    pTrace = readAppTraceUTestFile();
+    TEST_ASSERT_EQUAL(APP_TRACE_RING_SIZE - 1, countAppTraceUTestEvents(pTrace, "\"utestWrapSpan\""));
+    TEST_ASSERT_NULL(STRSTR(pTrace, "\"utestSpan\""));
+}
+
+void test_appTraceThreadsRecycled(void)
+{
+    pthread_t thread;
+    PCHAR pTrace;
+    UINT32 i;
+
+    // the threads of the rebuilt pipelines come and go, the exited ones give their buffers to the next ones.
+    for (i = 0; i < 2 * APP_TRACE_MAX_THREADS; i++) {
+        TEST_ASSERT_EQUAL(0, pthread_create(&thread, NULL, appTraceUTestNamedRoutine, (PVOID) "utest-rebuilt"));
+        TEST_ASSERT_EQUAL(0, pthread_join(thread, NULL));
+    }
+    TEST_ASSERT_EQUAL(0, pthread_create(&thread, NULL, appTraceUTestNamedRoutine, (PVOID) "utest-last"));
+    TEST_ASSERT_EQUAL(0, pthread_join(thread, NULL));
+    TEST_ASSERT_EQUAL(STATUS_SUCCESS, dumpAppTrace(NULL));
+
+    pTrace = readAppTraceUTestFile();
+    TEST_ASSERT_NOT_NULL(STRSTR(pTrace, "\"args\":{\"name\":\"utest-last\"}"));
+    // a reused buffer only shows the events of its last thread.
+    TEST_ASSERT_TRUE(countAppTraceUTestEvents(pTrace, "\"utestNamedSpan\"") <= 2 * APP_TRACE_MAX_THREADS);
+}
@@ -55,6 +55,47 @@ function(create_test test_name
             )
 endfunction()
 
+#function to create the benchmark executable, which is only built by the bench target and is not a ctest test
+function(create_bench bench_name
+                      bench_src
+                      link_list
+                      dep_list
+                      include_list)
+    get_filename_component(bench_src_absolute ${bench_src} ABSOLUTE)
+    add_custom_command(OUTPUT ${bench_name}_runner.c
+                  COMMAND ruby
+                    ${CMOCK_DIR}/vendor/unity/auto/generate_test_runner.rb
+                    ${MODULE_ROOT_DIR}/tools/cmock/project.yml
+                    ${bench_src_absolute}
+                    ${bench_name}_runner.c
+                  DEPENDS ${bench_src}
+        )
+    add_executable(${bench_name} EXCLUDE_FROM_ALL ${bench_src} ${bench_name}_runner.c)
+    set_target_properties(${bench_name} PROPERTIES
+            COMPILE_FLAGS "-O2"
+            RUNTIME_OUTPUT_DIRECTORY "${CMAKE_BINARY_DIR}/bin/bench"
+            INSTALL_RPATH_USE_LINK_PATH TRUE
+            LINK_FLAGS " \
+                -Wl,-rpath,${CMAKE_BINARY_DIR}/lib \
+                -Wl,-rpath,${CMAKE_CURRENT_BINARY_DIR}/lib"
+        )
+    target_include_directories(${bench_name} PUBLIC
+                               ${include_list}
+        )
+
+    # link all libraries sent through parameters
+    foreach(link IN LISTS link_list)
+        target_link_libraries(${bench_name} ${link})
+    endforeach()
+
+    # add dependency to all the dep_list parameter
+    foreach(dependency IN LISTS dep_list)
+        add_dependencies(${bench_name} ${dependency})
+        target_link_libraries(${bench_name} ${dependency})
+    endforeach()
+    target_link_libraries(${bench_name} unity)
+endfunction()
+
 # Run the C preprocessor on target files.
 # Takes a CMAKE list of arguments to pass to the C compiler
 function(preprocess_mock_list mock_name file_list compiler_args)